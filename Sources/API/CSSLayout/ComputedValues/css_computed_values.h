@@ -119,6 +119,9 @@ public:
 	const CSSComputedTextInherit &get_text_inherit() const;
 	int get_text_inherit_generation() const;
 
+	/// \brief Returns true if both objects refer to the same computed values
+	bool operator==(const CSSComputedValues &other) const { return impl == other.impl; }
+
 private:
 	std::shared_ptr<CSSComputedValues_Impl> impl;
 
@@ -0,0 +1,55 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Magnus Norddahl
+*/
+
+#pragma once
+
+#include "../api_csslayout.h"
+
+namespace clan
+{
+/// \addtogroup clanCSSLayout_ComputedValues clanCSSLayout Computed Values
+/// \{
+
+/// \brief Statistics about computed values shared between boxes with identical styles
+class CSSStyleSharingStats
+{
+public:
+	CSSStyleSharingStats() : lookups(0), hits(0) { }
+
+	/// \brief Number of elements that looked for a sibling with the same style
+	int lookups;
+
+	/// \brief Number of elements that reused the computed values of another element
+	int hits;
+
+	/// \brief Returns the fraction of lookups that could reuse computed values
+	float get_hit_rate() const { return lookups > 0 ? hits / (float)lookups : 0.0f; }
+};
+
+/// \}
+}
@@ -51,6 +51,7 @@ class Point;
 class Image;
 class Rect;
 class Canvas;
+class CSSStyleSharingStats;
 
 class CL_API_CSSLAYOUT CSSLayout
 {
@@ -83,6 +84,9 @@ public:
 
 	CSSLayoutElement find_element(const std::string &name);
 
+	/// \brief Returns how many elements reused the computed values of an identically styled element
+	CSSStyleSharingStats get_style_sharing_stats() const;
+
 	// Image on_get_image(Canvas &canvas, const std::string &uri);
 	Callback_2<Image, Canvas &, const std::string &> &func_get_image();
 
@@ -0,0 +1,76 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Magnus Norddahl
+*/
+
+#pragma once
+
+#include "../api_core.h"
+
+namespace clan
+{
+/// \addtogroup clanCore_Crypto clanCore Crypto
+/// \{
+
+/// \brief Selects between the portable and the CPU specific crypto code paths
+///
+/// The AES classes use the AES-NI instructions and SHA1, SHA224 and SHA256 use
+/// the SHA extensions when the processor supports them. AES-GCM in TLSClient also
+/// uses PCLMULQDQ. The portable code is used otherwise.
+class CL_API_CORE CryptoAcceleration
+{
+/// \name Attributes
+/// \{
+
+public:
+	/// \brief Returns true if the AES classes can use the AES-NI instructions
+	static bool is_aes_supported();
+
+	/// \brief Returns true if the SHA-1 and SHA-256 classes can use the SHA extensions
+	static bool is_sha_supported();
+
+	/// \brief Returns true if AES-GCM can calculate GHASH with the carry-less multiplication instruction
+	static bool is_pclmul_supported();
+
+	/// \brief Returns true if supported instructions are used
+	static bool is_enabled();
+
+/// \}
+/// \name Operations
+/// \{
+
+public:
+	/// \brief Enables or disables the CPU specific code paths. Enabled by default.
+	///
+	/// Only objects constructed afterwards are affected. Disabling it is mainly
+	/// useful to verify or compare the implementations.
+	static void set_enabled(bool enable);
+/// \}
+};
+
+}
+
+/// \}
@@ -33,6 +33,7 @@
 
 #include "../api_core.h"
 #include <memory>
+#include <string>
 
 namespace clan
 {
@@ -66,6 +67,14 @@ public:
 
 	/// \brief Returns how much encrypted data is available.
 	int get_encrypted_data_available() const;
+
+	/// \brief Returns true if the handshake resumed an earlier session instead of doing a full RSA key exchange.
+	bool is_session_resumed() const;
+
+	/// \brief Returns true if the server closed the connection with a close_notify alert.
+	///
+	/// No more data will be decrypted. The close_notify sent in reply is added to the encrypted data.
+	bool is_closed() const;
 /// \}
 
 /// \name Operations
@@ -82,6 +91,23 @@ public:
 
 	/// \brief Marks encrypted data as consumed.
 	void encrypted_data_consumed(int size);
+
+	/// \brief Returns where data to be decrypted can be written directly, instead of copying it with decrypt().
+	///
+	/// \param out_size = Number of bytes that fit in the buffer
+	void *get_decrypt_buffer(int &out_size);
+
+	/// \brief Adds data written to the buffer returned by get_decrypt_buffer().
+	void decrypt_buffer_filled(int size);
+
+	/// \brief Sets the name the session is cached under, normally the address and port of the server.
+	///
+	/// Later connections with the same name offer to resume the session, using the session
+	/// id or session ticket (RFC 5077) given by the server. Must be set before any data is added.
+	void set_session_name(const std::string &name);
+
+	/// \brief Forgets all cached sessions.
+	static void clear_session_cache();
 /// \}
 
 /// \name Implementation
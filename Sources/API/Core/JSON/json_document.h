@@ -0,0 +1,154 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Magnus Norddahl
+*/
+
+#pragma once
+
+#include "../api_core.h"
+#include "json_reader.h"
+#include <string>
+#include <memory>
+
+namespace clan
+{
+/// \addtogroup clanCore_JSON clanCore JSON
+/// \{
+
+class IODevice;
+class JsonDocument_Impl;
+
+/// \brief Value in a JsonDocument
+///
+/// Elements are small handles that stay valid as long as their document.
+class CL_API_CORE JsonElement
+{
+public:
+	JsonElement() : document(0), index(-1) { }
+	JsonElement(const JsonDocument_Impl *document, int index) : document(document), index(index) { }
+
+/// \name Attributes
+/// \{
+public:
+	/// \brief Get value type. An element that was not found has type_null.
+	JsonValue::Type get_type() const;
+
+	bool is_null() const { return get_type() == JsonValue::type_null; }
+	bool is_object() const { return get_type() == JsonValue::type_object; }
+	bool is_array() const { return get_type() == JsonValue::type_array; }
+	bool is_string() const { return get_type() == JsonValue::type_string; }
+	bool is_number() const { return get_type() == JsonValue::type_number; }
+	bool is_boolean() const { return get_type() == JsonValue::type_boolean; }
+
+	/// \brief Number of object members or array items, or the length of a string
+	size_t get_size() const;
+
+	/// \brief Array item
+	JsonElement operator[](int index) const;
+
+	/// \brief Object member. Returns a null element if there is no such member.
+	JsonElement operator[](const char *name) const;
+	JsonElement operator[](const std::string &name) const;
+
+	/// \brief Returns true if the object has the member
+	bool has_member(const std::string &name) const;
+
+	/// \brief Name of an object member by position
+	JsonStringView get_member_name(int index) const;
+
+	/// \brief Value of an object member by position
+	JsonElement get_member_value(int index) const;
+
+	/// \brief Text of a string value
+	JsonStringView get_string() const;
+
+	std::string to_string() const;
+	int to_int() const;
+	float to_float() const;
+	double to_double() const;
+	bool to_boolean() const;
+
+	/// \brief Copies the value and everything it contains to a JsonValue
+	JsonValue to_value() const;
+/// \}
+
+/// \name Implementation
+/// \{
+private:
+	JsonElement find_member(const char *name, size_t length) const;
+
+	const JsonDocument_Impl *document;
+	int index;
+/// \}
+};
+
+/// \brief Read only JSON document stored in a few flat arrays
+///
+/// All values are kept in one vector, with the members of each object and the
+/// items of each array next to each other. Strings point into the parsed data
+/// when possible and are otherwise copied to a memory arena owned by the document,
+/// so a document needs far less memory than a tree of JsonValue objects.
+class CL_API_CORE JsonDocument
+{
+/// \name Construction
+/// \{
+public:
+	/// \brief Constructs a document with a null root
+	JsonDocument();
+
+	/// \brief Parses JSON in memory without copying it
+	///
+	/// The data must stay valid as long as the document.
+	JsonDocument(const void *data, size_t size);
+
+	/// \brief Parses JSON read from a device
+	JsonDocument(IODevice &device);
+
+	/// \brief Parses a copy of a JSON string
+	static JsonDocument from_json(const std::string &json);
+
+	~JsonDocument();
+/// \}
+
+/// \name Attributes
+/// \{
+public:
+	/// \brief Returns the top level value
+	JsonElement get_root() const;
+
+	/// \brief Returns the number of bytes used for values and copied strings
+	size_t get_memory_usage() const;
+/// \}
+
+/// \name Implementation
+/// \{
+private:
+	std::shared_ptr<JsonDocument_Impl> impl;
+/// \}
+};
+
+/// \}
+}
@@ -0,0 +1,158 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Magnus Norddahl
+*/
+
+#pragma once
+
+#include "../api_core.h"
+#include "../System/exception.h"
+#include "json_value.h"
+#include <string>
+#include <cstring>
+#include <memory>
+
+namespace clan
+{
+/// \addtogroup clanCore_JSON clanCore JSON
+/// \{
+
+class IODevice;
+class JsonReader_Impl;
+
+/// \brief Reference to UTF-8 text owned by someone else
+class JsonStringView
+{
+public:
+	JsonStringView() : data(0), length(0) { }
+	JsonStringView(const char *data, size_t length) : data(data), length(length) { }
+
+	const char *data;
+	size_t length;
+
+	bool empty() const { return length == 0; }
+
+	/// \brief Copy the text to a string
+	std::string to_string() const { return std::string(data, length); }
+
+	bool operator ==(const char *text) const { return std::strlen(text) == length && std::memcmp(text, data, length) == 0; }
+	bool operator ==(const std::string &text) const { return text.length() == length && std::memcmp(text.data(), data, length) == 0; }
+	bool operator !=(const char *text) const { return !(*this == text); }
+	bool operator !=(const std::string &text) const { return !(*this == text); }
+};
+
+/// \brief Pull parser reading JSON one token at a time
+///
+/// Strings are returned as views into the data being parsed, so nothing is copied
+/// unless a string contains escapes. Throws JsonException on malformed JSON.
+class CL_API_CORE JsonReader
+{
+public:
+	/// \brief Token types returned by next()
+	enum Token
+	{
+		token_end,
+		token_begin_object,
+		token_end_object,
+		token_begin_array,
+		token_end_array,
+		token_member_name,
+		token_string,
+		token_number,
+		token_boolean,
+		token_null
+	};
+
+/// \name Construction
+/// \{
+public:
+	/// \brief Reads JSON from memory, such as a memory mapped file
+	///
+	/// The data must stay valid while the reader is used.
+	JsonReader(const void *data, size_t size);
+
+	/// \brief Reads JSON from a device
+	///
+	/// \param buffer_size = Initial size of the read buffer. It grows to fit the longest token.
+	JsonReader(IODevice &device, int buffer_size = 64 * 1024);
+
+	~JsonReader();
+/// \}
+
+/// \name Attributes
+/// \{
+public:
+	/// \brief Returns the current token
+	Token get_token() const;
+
+	/// \brief Returns the text of a token_member_name or token_string token
+	///
+	/// The view is valid until next() is called, or for as long as the source data
+	/// if is_string_in_source() returns true.
+	JsonStringView get_string() const;
+
+	/// \brief Returns true if the view returned by get_string() points into the source data
+	///
+	/// This is the case for strings without escapes when reading from memory.
+	bool is_string_in_source() const;
+
+	/// \brief Returns the value of a token_number token
+	double get_number() const;
+
+	/// \brief Returns the value of a token_boolean token
+	bool get_boolean() const;
+
+	/// \brief Returns how many objects and arrays enclose the current token
+	int get_depth() const;
+
+	/// \brief Returns the byte offset of the current token in the JSON data
+	size_t get_offset() const;
+/// \}
+
+/// \name Operations
+/// \{
+public:
+	/// \brief Reads the next token
+	///
+	/// Returns token_end after the top level value has been read.
+	Token next();
+
+	/// \brief Skips the rest of the current object or array if the current token begins one
+	void skip();
+/// \}
+
+/// \name Implementation
+/// \{
+private:
+	JsonReader(const JsonReader &);
+	JsonReader &operator =(const JsonReader &);
+
+	std::unique_ptr<JsonReader_Impl> impl;
+/// \}
+};
+
+/// \}
+}
@@ -0,0 +1,100 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Magnus Norddahl
+*/
+
+#pragma once
+
+#include "../api_core.h"
+#include "json_reader.h"
+#include <string>
+#include <memory>
+
+namespace clan
+{
+/// \addtogroup clanCore_JSON clanCore JSON
+/// \{
+
+class IODevice;
+class JsonWriter_Impl;
+
+/// \brief Writes JSON to a device as it is generated
+///
+/// Output is collected in a buffer and written to the device when the buffer is
+/// full, on flush() and when the writer is destroyed. Throws JsonException if
+/// the calls do not form valid JSON.
+class CL_API_CORE JsonWriter
+{
+/// \name Construction
+/// \{
+public:
+	/// \brief Constructs a writer
+	///
+	/// \param buffer_size = Bytes collected before they are written to the device
+	JsonWriter(IODevice &device, int buffer_size = 64 * 1024);
+
+	/// \brief Flushes the buffer
+	~JsonWriter();
+/// \}
+
+/// \name Operations
+/// \{
+public:
+	void begin_object();
+	void end_object();
+	void begin_array();
+	void end_array();
+
+	/// \brief Writes the name of the next object member
+	void write_member_name(const std::string &name);
+	void write_member_name(const JsonStringView &name);
+
+	void write_string(const std::string &value);
+	void write_string(const JsonStringView &value);
+	void write_number(int value);
+	void write_number(double value);
+	void write_boolean(bool value);
+	void write_null();
+
+	/// \brief Writes a value and everything it contains
+	void write_value(const JsonValue &value);
+
+	/// \brief Writes the buffered output to the device
+	void flush();
+/// \}
+
+/// \name Implementation
+/// \{
+private:
+	JsonWriter(const JsonWriter &);
+	JsonWriter &operator =(const JsonWriter &);
+
+	std::unique_ptr<JsonWriter_Impl> impl;
+/// \}
+};
+
+/// \}
+}
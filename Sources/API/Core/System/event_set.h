@@ -0,0 +1,104 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Magnus Norddahl
+*/
+
+#pragma once
+
+#include "../api_core.h"
+#include <vector>
+#include <memory>
+
+namespace clan
+{
+/// \addtogroup clanCore_System clanCore System
+/// \{
+
+class Event;
+class EventSet_Impl;
+
+/// \brief Set of events that stay registered with the operating system between waits.
+///
+/// Event::wait rebuilds its list of OS handles on every call, which costs time
+/// proportional to the number of events. An EventSet registers the events once,
+/// so waiting only costs time proportional to the number of flagged events.
+/// On Linux the set is backed by epoll. Other platforms fall back to Event::wait.
+class CL_API_CORE EventSet
+{
+/// \name Construction
+/// \{
+
+public:
+	/// \brief Constructs an empty event set.
+	EventSet();
+
+	~EventSet();
+
+/// \}
+/// \name Attributes
+/// \{
+
+public:
+	/// \brief Returns the number of events in the set.
+	int get_size() const;
+
+/// \}
+/// \name Operations
+/// \{
+
+public:
+	/// \brief Adds an event to the set.
+	///
+	/// \param event = Event to wait for
+	/// \param id = Value returned by wait when the event is flagged
+	/// \param edge_triggered = Only report the event when its OS handle changes state. Use this only for sockets that are read or written until they would block, never for Event objects created with the Event constructor.
+	void add(const Event &event, int id, bool edge_triggered = false);
+
+	/// \brief Removes an event from the set.
+	void remove(const Event &event);
+
+	/// \brief Removes all events from the set.
+	void clear();
+
+	/// \brief Wait for one or more events in the set to become flagged.
+	///
+	/// \param out_flagged_ids = Receives the ids of the flagged events
+	/// \param timeout = Timeout in milliseconds. -1 waits forever
+	/// \return Number of flagged events. 0 = Timeout
+	int wait(std::vector<int> &out_flagged_ids, int timeout = -1);
+
+/// \}
+/// \name Implementation
+/// \{
+
+private:
+	std::shared_ptr<EventSet_Impl> impl;
+/// \}
+};
+
+}
+
+/// \}
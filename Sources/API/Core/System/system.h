@@ -55,7 +55,7 @@ public:
 	/// \brief Get the current time microseconds.
 	static ubyte64 get_microseconds();
 
-    enum CPU_ExtensionX86 { mmx, mmx_ex, _3d_now, _3d_now_ex, sse, sse2, sse3, ssse3, sse4_a, sse4_1, sse4_2, xop, avx, aes, fma3, fma4 };
+    enum CPU_ExtensionX86 { mmx, mmx_ex, _3d_now, _3d_now_ex, sse, sse2, sse3, ssse3, sse4_a, sse4_1, sse4_2, xop, avx, aes, fma3, fma4, avx2, pclmul, sha };
     enum CPU_ExtensionPPC { altivec };
 
     static bool detect_cpu_extension(CPU_ExtensionX86 ext);
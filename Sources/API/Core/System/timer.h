@@ -30,6 +30,7 @@
 
 #include "../api_core.h"
 #include <memory>
+#include <vector>
 
 namespace clan
 {
@@ -67,10 +68,16 @@ public:
 /// \{
 public:
 	/// \brief Starts the timer. Timeout in milliseconds.
+	///
+	/// Restarting a running one shot timer so it expires later, such as an idle
+	/// timeout being pushed back, does not take any locks.
 	void start(unsigned int timeout, bool repeat=true);
 
 	/// \brief Stop the timer.
 	void stop();
+
+	/// \brief Stops a group of timers at once.
+	static void stop(const std::vector<Timer> &timers);
 /// \}
 
 /// \name Implementation
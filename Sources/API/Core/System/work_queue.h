@@ -30,7 +30,9 @@
 #pragma once
 
 #include "../api_core.h"
+#include "../Signals/callback_v0.h"
 #include <memory>
+#include <vector>
 
 namespace clan
 {
@@ -50,19 +52,95 @@ public:
 	virtual void work_completed() { }
 };
 
+class WorkTask_Impl;
 class WorkQueue_Impl;
 
+/// \brief Handle to a task scheduled on a WorkQueue
+///
+/// A task is finished when its function has returned and all its child
+/// tasks have finished.
+class CL_API_CORE WorkTask
+{
+public:
+	/// \brief Constructs a null instance
+	WorkTask();
+
+	/// \brief Returns true if this object is invalid.
+	bool is_null() const { return !impl; }
+
+	/// \brief Returns true if the task and all its children have finished
+	bool is_finished() const;
+
+private:
+	WorkTask(const std::shared_ptr<WorkTask_Impl> &impl);
+
+	std::shared_ptr<WorkTask_Impl> impl;
+
+	friend class WorkQueue;
+	friend class WorkQueue_Impl;
+};
+
 /// \brief Thread pool for worker threads
+///
+/// Each worker thread owns a work stealing deque. Tasks queued from a worker
+/// go to its own deque and idle workers steal from the others, so many small
+/// tasks can be queued without contending on a shared lock.
+///
+/// A task whose function throws still finishes. The exception is rethrown
+/// by wait_for for the task and for its parents.
+///
+/// The worker threads are started when the first work is queued.
 class CL_API_CORE WorkQueue
 {
 public:
-	/// \brief Constructs a work queue
+	/// \brief Constructs a work queue with one thread less than the number of cores
 	WorkQueue();
+
+	/// \brief Constructs a work queue
+	///
+	/// \param num_threads = Number of worker threads
+	WorkQueue(int num_threads);
+
 	~WorkQueue();
 
+	/// \brief Returns the work queue shared by the whole process
+	///
+	/// Prefer this over constructing a private queue, so that subsystems running
+	/// tasks at the same time do not each bring their own set of threads.
+	/// The shared queue is never destroyed. Items passed to queue() complete on
+	/// the thread that first called get_shared(), so use run() and wait_for()
+	/// on it from other threads.
+	static WorkQueue get_shared();
+
+	/// \brief Returns the number of worker threads
+	int get_num_threads() const;
+
 	void queue(WorkItem *item); // transfers ownership
 
+	/// \brief Runs a function on a worker thread
+	WorkTask run(const Callback_v0 &func);
+
+	/// \brief Runs a function on a worker thread as a child of another task
+	///
+	/// The parent task does not finish before the child has finished.
+	/// The parent must not have finished already.
+	WorkTask run_child(const WorkTask &parent, const Callback_v0 &func);
+
+	/// \brief Runs a function once a task has finished
+	WorkTask run_after(const WorkTask &task, const Callback_v0 &func);
+
+	/// \brief Runs a function once all tasks in a list have finished
+	WorkTask run_after(const std::vector<WorkTask> &tasks, const Callback_v0 &func);
+
+	/// \brief Waits for a task to finish
+	///
+	/// The calling thread runs queued tasks while it waits. If the task or
+	/// one of its children threw an exception, it is rethrown here.
+	void wait_for(const WorkTask &task);
+
 private:
+	WorkQueue(const std::shared_ptr<WorkQueue_Impl> &impl);
+
 	std::shared_ptr<WorkQueue_Impl> impl;
 };
 
@@ -63,6 +63,9 @@ public:
 	/// \brief Log text to console.
 	void log(const std::string &type, const std::string &text);
 
+	/// \brief Log text to console with the time it was logged.
+	void log_at(const std::string &type, const std::string &text, const DateTime &time);
+
 /// \}
 /// \name Implementation
 /// \{
@@ -31,6 +31,7 @@
 
 #include "../api_core.h"
 #include "logger.h"
+#include "../System/cl_platform.h"
 
 namespace clan
 {
@@ -65,12 +66,26 @@ public:
 	/// \brief Log text to file.
 	void log(const std::string &type, const std::string &text);
 
+	/// \brief Log text to the file buffer. The buffer is written by flush().
+	void log_at(const std::string &type, const std::string &text, const DateTime &time);
+
+	/// \brief Write buffered text to file.
+	void flush();
+
 /// \}
 /// \name Implementation
 /// \{
 
 private:
 	File *file;
+
+	/// \brief Log lines not yet written to file
+	std::string buffer;
+
+	/// \brief Second the time text in cached_time was formatted for
+	byte64 cached_second;
+
+	std::string cached_time;
 /// \}
 };
 
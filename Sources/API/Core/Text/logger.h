@@ -39,6 +39,8 @@ namespace clan
 /// \addtogroup clanCore_Text clanCore Text
 /// \{
 
+class DateTime;
+
 /// \brief Logger interface.
 class CL_API_CORE Logger
 {
@@ -46,6 +48,16 @@ class CL_API_CORE Logger
 /// \{
 
 public:
+	/// \brief What log_event does when the asynchronous queue is full
+	enum OverflowPolicy
+	{
+		/// \brief Wait for the writer thread to make room
+		overflow_block,
+
+		/// \brief Discard the record. The number of dropped records is logged later.
+		overflow_drop
+	};
+
 	/// \brief Constructs a logger.
 	Logger();
 
@@ -76,6 +88,29 @@ public:
 	/// \brief Log text.
 	virtual void log(const std::string &type, const std::string &text);
 
+	/// \brief Log text with the time it was logged.
+	///
+	/// Used by the writer thread when logging is asynchronous. The default calls log().
+	virtual void log_at(const std::string &type, const std::string &text, const DateTime &time);
+
+	/// \brief Writes out text buffered by log_at. Called after each batch of records.
+	virtual void flush();
+
+	/// \brief Makes log_event queue records for a background writer thread
+	///
+	/// log_event then returns without waiting for the loggers. Records from one thread
+	/// are written in order, records from different threads may be interleaved
+	/// slightly out of order. Must not be called while other threads are logging.
+	///
+	/// \param policy = What to do when the queue is full
+	/// \param queue_size = Number of records each queue can hold. Threads are spread over several queues.
+	static void enable_async(OverflowPolicy policy = overflow_block, int queue_size = 1024);
+
+	/// \brief Writes all queued records and makes log_event call the loggers directly again
+	///
+	/// Must not be called while other threads are logging.
+	static void disable_async();
+
 /// \}
 /// \name Implementation
 /// \{
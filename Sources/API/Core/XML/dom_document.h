@@ -62,6 +62,9 @@ class DomDocument_Impl;
 ///    also contains the factory methods needed to create these objects. The
 ///    Node objects created have a ownerDocument attribute which associates
 ///    them with the Document within whose context they were created.</p>
+///    <p>Node names and namespace URIs are interned and kept until the
+///    document is destroyed. Value storage outgrown by a node is reused
+///    for later values, but is not returned to the heap before then either.</p>
 class CL_API_CORE DomDocument : public DomNode
 {
 /// \name Construction
@@ -221,6 +224,7 @@ public:
 /// \{
 
 private:
+	DomNode create_node(unsigned int node_index);
 /// \}
 };
 
@@ -0,0 +1,104 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Magnus Norddahl
+*/
+
+
+#pragma once
+
+#include <memory>
+#include "xpath_object.h"
+
+namespace clan
+{
+/// \addtogroup clanCore_XML clanCore XML
+/// \{
+
+class DomNode;
+class XPathExpression_Impl;
+
+/// \brief Compiled XPath expression.
+///
+/// The expression is parsed once, so it can be evaluated any number of times
+/// without reading the expression text again.
+class XPathExpression
+{
+/// \name Construction
+/// \{
+
+public:
+	/// \brief Constructs a null instance.
+	XPathExpression();
+
+	/// \brief Compiles an expression
+	///
+	/// Throws an XPathException if the expression is not valid.
+	///
+	/// \param expression = XPath expression
+	XPathExpression(const std::string &expression);
+
+/// \}
+/// \name Attributes
+/// \{
+
+public:
+	/// \brief Returns true if this object is invalid.
+	bool is_null() const { return !impl; }
+
+	/// \brief Throw an exception if this object is invalid.
+	void throw_if_null() const;
+
+	/// \brief Returns the expression text
+	std::string get_expression() const;
+
+/// \}
+/// \name Operations
+/// \{
+
+public:
+	/// \brief Evaluate
+	///
+	/// \param context_node = Dom Node
+	///
+	/// \return XPath Object
+	XPathObject evaluate(const DomNode &context_node) const;
+
+/// \}
+/// \name Implementation
+/// \{
+
+private:
+	XPathExpression(const std::shared_ptr<XPathExpression_Impl> &impl);
+
+	std::shared_ptr<XPathExpression_Impl> impl;
+
+	friend class XPathEvaluator;
+/// \}
+};
+
+}
+
+/// \}
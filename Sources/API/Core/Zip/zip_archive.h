@@ -33,6 +33,7 @@
 #include "../api_core.h"
 #include <memory>
 #include "zip_file_entry.h"
+#include "../System/databuffer.h"
 #include <vector>
 
 namespace clan
@@ -41,6 +42,7 @@ namespace clan
 /// \{
 
 class IODevice;
+class WorkQueue;
 class ZipArchive_Impl;
 
 /// \brief Zip archive.
@@ -63,7 +65,10 @@ public:
 	/// \brief Constructs a ZipArchive
 	///
 	/// \param filename = String Ref
-	ZipArchive(const std::string &filename);
+	/// \param memory_map = Map the archive into memory instead of reading it through a file.
+	///                     Stored files can then be accessed without copying them, and compressed
+	///                     files are inflated in one go when opened.
+	ZipArchive(const std::string &filename, bool memory_map = false);
 
 	/// \brief Constructs a ZipArchive
 	///
@@ -90,6 +95,18 @@ public:
 	/// \brief Opens a file in the archive.
 	IODevice open_file(const std::string &filename);
 
+	/// \brief Returns the contents of a stored (uncompressed) file without copying it.
+	///
+	/// Only available if the archive is memory mapped. The data is valid as long as the archive exists.
+	/// \return false if the archive is not memory mapped, or the file is compressed or was added after loading
+	bool get_file_view(const std::string &filename, const void *&out_data, int &out_size);
+
+	/// \brief Loads many files at once.
+	///
+	/// Compressed files are inflated in parallel on the work queue.
+	/// \return The contents of the files, in the same order as the filenames
+	std::vector<DataBuffer> load_files(const std::vector<std::string> &filenames, WorkQueue &work_queue);
+
 	/// \brief Get full path to source:
 	std::string get_pathname(const std::string &filename);
 
@@ -205,6 +205,16 @@ public:
 	/// \return The character index. -1 = Not at specified point
 	int get_character_index(Canvas &canvas, const std::string &text, const Point &point);
 
+	/// \brief Rasterize a range of glyphs in advance
+	///
+	/// All glyphs in the range are packed into the font textures in one batch,
+	/// avoiding rasterization stalls the first time the text is drawn.
+	///
+	/// \param canvas = Canvas
+	/// \param first_glyph = First unicode code point in the range
+	/// \param last_glyph = Last unicode code point in the range (inclusive)
+	void prewarm(Canvas &canvas, unsigned int first_glyph, unsigned int last_glyph);
+
 /// \}
 /// \name Implementation
 /// \{
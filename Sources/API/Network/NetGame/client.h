@@ -32,6 +32,7 @@
 #include "../api_network.h"
 
 #include "connection_site.h"	// TODO: Remove
+#include "connection.h"
 #include "../../Core/System/event.h"
 #include "../../Core/Signals/signal_v0.h"
 #include "../../Core/Signals/signal_v1.h"
@@ -58,6 +59,13 @@ public:
 	/// \param port = String
 	void connect(const std::string &server, const std::string &port);
 
+	/// \brief Connect
+	///
+	/// \param server = String
+	/// \param port = String
+	/// \param transport = Protocol the server was started with
+	void connect(const std::string &server, const std::string &port, NetGameTransport transport);
+
 	/// \brief Disconnect
 	void disconnect();
 
@@ -68,6 +76,13 @@ public:
 	///
 	/// \param game_event = Net Game Event
 	void send_event(const NetGameEvent &game_event);
+
+	/// \brief Send event
+	///
+	/// \param game_event = Net Game Event
+	/// \param channel = Delivery guarantee. Only used by UDP connections.
+	void send_event(const NetGameEvent &game_event, NetGameChannel channel);
+
 	Signal_v1<const NetGameEvent &> &sig_event_received();
 
 	/// \brief Sig connected
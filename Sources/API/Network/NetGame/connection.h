@@ -45,6 +45,32 @@ namespace clan
 
 class NetGameConnectionSite;
 class NetGameConnection_Impl;
+class NetGameUDPHost;
+
+/// \brief Protocol a NetGameConnection is carried over
+enum NetGameTransport
+{
+	/// \brief Every event is sent in order over a TCP stream
+	netgame_transport_tcp,
+
+	/// \brief Events are sent over UDP with the reliability chosen per event
+	netgame_transport_udp
+};
+
+/// \brief Delivery guarantee for an event sent over UDP
+///
+/// TCP connections deliver all events reliable and ordered, whatever channel is requested.
+enum NetGameChannel
+{
+	/// \brief Every event arrives, in the order it was sent
+	netgame_channel_reliable_ordered,
+
+	/// \brief Every event arrives, possibly before events sent earlier
+	netgame_channel_reliable_unordered,
+
+	/// \brief Events may be lost. Events older than the last one received are dropped.
+	netgame_channel_unreliable_sequenced
+};
 
 /// \brief NetGameConnection
 class CL_API_NETWORK NetGameConnection
@@ -58,6 +84,13 @@ public:
 	NetGameConnection(NetGameConnectionSite *site, const TCPConnection &connection);
 	NetGameConnection(NetGameConnectionSite *site, const SocketName &socket_name);
 
+	/// \brief Constructs a NetGameConnection to a server
+	///
+	/// \param site = Net Game Connection Site
+	/// \param socket_name = Address of the server
+	/// \param transport = Protocol to connect with
+	NetGameConnection(NetGameConnectionSite *site, const SocketName &socket_name, NetGameTransport transport);
+
 	~NetGameConnection();
 
 	/// \brief Set data
@@ -78,6 +111,12 @@ public:
 	/// \param game_event = Net Game Event
 	void send_event(const NetGameEvent &game_event);
 
+	/// \brief Send event
+	///
+	/// \param game_event = Net Game Event
+	/// \param channel = Delivery guarantee. Only used by UDP connections.
+	void send_event(const NetGameEvent &game_event, NetGameChannel channel);
+
 	/// \brief Disconnects a client
 	void disconnect();
 
@@ -87,11 +126,16 @@ public:
 	SocketName get_remote_name() const;
 
 private:
+	/// \brief Constructs a connection accepted by a UDP server
+	NetGameConnection(NetGameConnection_Impl *impl);
+
 	/// \brief Disallow copy constructors
 	NetGameConnection(NetGameConnection &other);
 	NetGameConnection &operator =(const NetGameConnection &other);
 
 	NetGameConnection_Impl *impl;
+
+	friend class NetGameUDPHost;
 };
 
 }
@@ -209,7 +209,7 @@ public:
 	/// \brief To string
 	///
 	/// \return String
-	std::string to_string() const;
+	const std::string &to_string() const;
 
 	/// \brief To boolean
 	///
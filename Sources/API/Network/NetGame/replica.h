@@ -0,0 +1,113 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Magnus Norddahl
+*/
+
+#pragma once
+
+#include "../api_network.h"
+#include "../../Core/Signals/signal_v1.h"
+#include <memory>
+#include <vector>
+
+namespace clan
+{
+/// \addtogroup clanNetwork_NetGame clanNetwork NetGame
+/// \{
+
+class NetGameEvent;
+class NetGameEventValue;
+class NetGameClient;
+class NetGameReplica_Impl;
+
+/// \brief Client side copy of the objects replicated by a NetGameReplicator
+class CL_API_NETWORK NetGameReplica
+{
+/// \name Construction
+/// \{
+
+public:
+	NetGameReplica();
+
+	~NetGameReplica();
+
+/// \}
+/// \name Attributes
+/// \{
+
+public:
+	/// \brief Returns the number of the last complete snapshot received
+	int get_tick() const;
+
+	/// \brief Returns the IDs of all objects currently replicated
+	std::vector<int> get_object_ids() const;
+
+	/// \brief Returns true if the object is currently replicated
+	bool has_object(int object_id) const;
+
+	/// \brief Returns the application defined type of an object
+	int get_object_type(int object_id) const;
+
+	/// \brief Returns the number of fields of an object
+	int get_field_count(int object_id) const;
+
+	/// \brief Returns the value of an object field
+	const NetGameEventValue &get_field(int object_id, int field) const;
+
+/// \}
+/// \name Operations
+/// \{
+
+public:
+	/// \brief Applies a snapshot received from the server and acknowledges it
+	///
+	/// \return True if the event was a replication event
+	bool process_event(const NetGameEvent &e, NetGameClient &client);
+
+	/// \brief Removes all objects, for example after reconnecting
+	void clear();
+
+	/// \brief Emitted when an object becomes visible. The parameter is the object ID.
+	Signal_v1<int> &sig_object_created();
+
+	/// \brief Emitted when fields of an object change
+	Signal_v1<int> &sig_object_updated();
+
+	/// \brief Emitted when an object is destroyed or no longer visible
+	Signal_v1<int> &sig_object_removed();
+
+/// \}
+/// \name Implementation
+/// \{
+
+private:
+	std::shared_ptr<NetGameReplica_Impl> impl;
+/// \}
+};
+
+}
+
+/// \}
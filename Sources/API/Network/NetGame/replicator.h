@@ -0,0 +1,175 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Magnus Norddahl
+*/
+
+#pragma once
+
+#include "../api_network.h"
+#include "../../Core/Math/point.h"
+#include "../../Core/Signals/callback_2.h"
+#include "../../Core/System/cl_platform.h"
+#include <memory>
+
+namespace clan
+{
+/// \addtogroup clanNetwork_NetGame clanNetwork NetGame
+/// \{
+
+class NetGameEvent;
+class NetGameEventValue;
+class NetGameConnection;
+class NetGameReplicator_Impl;
+
+/// \brief Statistics for the last NetGameReplicator update
+struct NetGameReplicatorStats
+{
+	NetGameReplicatorStats() : tick(0), clients(0), visible_objects(0), objects_sent(0), fields_sent(0), objects_removed(0), events_sent(0), bytes_sent(0), update_time(0) { }
+
+	/// \brief Snapshot number of the update
+	int tick;
+
+	/// \brief Number of clients updated
+	int clients;
+
+	/// \brief Objects visible to the clients, summed over all clients
+	int visible_objects;
+
+	/// \brief Objects created or updated on the clients
+	int objects_sent;
+
+	/// \brief Fields sent to the clients
+	int fields_sent;
+
+	/// \brief Objects removed from the clients
+	int objects_removed;
+
+	/// \brief Number of events sent
+	int events_sent;
+
+	/// \brief Approximate number of bytes sent
+	int bytes_sent;
+
+	/// \brief Time spent in update, in microseconds
+	ubyte64 update_time;
+};
+
+/// \brief Replicates the state of objects from a NetGameServer to the clients that can see them
+///
+/// Each object has a type, a position and up to 32 fields. Every client has an interest set,
+/// defined by a view circle over a grid of cells and optionally a custom filter. Each update sends
+/// a client only the objects it can see, and only the fields that changed since the last snapshot
+/// the client acknowledged. Use NetGameReplica on the client to receive the objects.
+class CL_API_NETWORK NetGameReplicator
+{
+/// \name Construction
+/// \{
+
+public:
+	/// \brief Constructs a replicator
+	///
+	/// \param cell_size = Size of the grid cells objects are sorted into for spatial interest
+	NetGameReplicator(float cell_size = 64.0f);
+
+	~NetGameReplicator();
+
+/// \}
+/// \name Attributes
+/// \{
+
+public:
+	/// \brief Returns the number of the last snapshot sent
+	int get_tick() const;
+
+	/// \brief Returns the number of replicated objects
+	int get_object_count() const;
+
+	/// \brief Returns the value of an object field
+	const NetGameEventValue &get_field(int object_id, int field) const;
+
+	/// \brief Returns the statistics for the last update
+	NetGameReplicatorStats get_stats() const;
+
+/// \}
+/// \name Operations
+/// \{
+
+public:
+	/// \brief Creates a replicated object
+	///
+	/// \param type = Application defined object type, sent to the clients when the object is created
+	/// \param num_fields = Number of fields of the object, up to 32. The fields start out as null values.
+	/// \param position = Position used to decide which clients can see the object
+	///
+	/// \return Object ID. IDs are never reused.
+	int create_object(int type, int num_fields, const Pointf &position);
+
+	/// \brief Destroys a replicated object, removing it from the clients
+	void destroy_object(int object_id);
+
+	/// \brief Moves an object
+	void set_position(int object_id, const Pointf &position);
+
+	/// \brief Sets a field of an object. Setting a field to its current value is not a change.
+	void set_field(int object_id, int field, const NetGameEventValue &value);
+
+	/// \brief Adds a client objects are replicated to
+	///
+	/// The client sees no objects until set_client_view or set_client_filter is called.
+	void add_client(NetGameConnection *connection);
+
+	/// \brief Removes a client
+	void remove_client(NetGameConnection *connection);
+
+	/// \brief Sets the circle a client can see objects within
+	void set_client_view(NetGameConnection *connection, const Pointf &position, float radius);
+
+	/// \brief Sets a filter deciding if a client sees an object
+	///
+	/// The filter is called with the connection and the object ID. If the client has a view, only
+	/// objects within it are tested. Otherwise all objects are tested.
+	void set_client_filter(NetGameConnection *connection, const Callback_2<bool, NetGameConnection *, int> &filter);
+
+	/// \brief Handles the snapshot acknowledgements sent by NetGameReplica
+	///
+	/// \return True if the event was used by the replicator
+	bool process_event(NetGameConnection *connection, const NetGameEvent &e);
+
+	/// \brief Sends a new snapshot to all clients
+	void update();
+
+/// \}
+/// \name Implementation
+/// \{
+
+private:
+	std::shared_ptr<NetGameReplicator_Impl> impl;
+/// \}
+};
+
+}
+
+/// \}
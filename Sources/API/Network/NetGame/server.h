@@ -32,6 +32,7 @@
 #include "../api_network.h"
 
 #include "connection_site.h"	// TODO: Remove
+#include "connection.h"
 #include "../../Core/System/event.h"
 #include "../../Core/Signals/signal_v1.h"
 #include "../../Core/Signals/signal_v2.h"
@@ -63,6 +64,19 @@ public:
 	/// \param port = String
 	void start(const std::string &address, const std::string &port);
 
+	/// \brief Start
+	///
+	/// \param port = String
+	/// \param transport = Protocol clients connect with
+	void start(const std::string &port, NetGameTransport transport);
+
+	/// \brief Start
+	///
+	/// \param address = String
+	/// \param port = String
+	/// \param transport = Protocol clients connect with
+	void start(const std::string &address, const std::string &port, NetGameTransport transport);
+
 	/// \brief Process events
 	void process_events();
 
@@ -74,6 +88,12 @@ public:
 	/// \param game_event = Net Game Event
 	void send_event(const NetGameEvent &game_event);
 
+	/// \brief Send event to all clients
+	///
+	/// \param game_event = Net Game Event
+	/// \param channel = Delivery guarantee. Only used by UDP connections.
+	void send_event(const NetGameEvent &game_event, NetGameChannel channel);
+
 	Signal_v1<NetGameConnection *> &sig_client_connected();
 	Signal_v2<NetGameConnection *, const std::string &> &sig_client_disconnected();
 	Signal_v2<NetGameConnection *, const NetGameEvent &> &sig_event_received();
@@ -140,6 +140,15 @@ public:
 	/// Both timeout and interval must be set to a non-zero value before any of them are used.  They cannot be specified individually.
 	void set_keep_alive(bool enable, int timeout = 0, int interval = 0);
 
+	/// \brief Writes several buffers with a single socket call, without waiting
+	///
+	/// \param buffers = Data of each buffer
+	/// \param sizes = Size of each buffer, in bytes
+	/// \param count = Number of buffers
+	///
+	/// \return Number of bytes written. This can be less than the total if the socket send buffer is full.
+	int write_gather(const void * const *buffers, const int *sizes, int count);
+
 /// \}
 /// \name Implementation
 /// \{
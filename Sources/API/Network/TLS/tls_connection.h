@@ -61,6 +61,8 @@ public:
 /// \{
 
 public:
+	/// \brief Returns true if the handshake resumed an earlier session with the same server
+	bool is_session_resumed() const;
 
 /// \}
 /// \name Operations
@@ -48,8 +48,18 @@ class CL_API_NETWORK HTTPServer
 /// \{
 
 public:
+	/// \brief Constructs a server that starts a thread for each connection
 	HTTPServer();
 
+	/// \brief Constructs a server that runs all connections on one event loop thread
+	///
+	/// Requests are parsed by the event loop and the handlers are called on a
+	/// fixed pool of worker threads. Connections are kept alive between requests
+	/// and pipelined requests are answered in order.
+	///
+	/// \param num_worker_threads = Number of threads calling the request handlers
+	HTTPServer(int num_worker_threads);
+
 	~HTTPServer();
 
 /// \}
@@ -57,6 +67,8 @@ public:
 /// \{
 
 public:
+	/// \brief Returns the largest request body accepted in the event loop mode
+	int get_max_request_size() const;
 
 /// \}
 /// \name Operations
@@ -79,6 +91,14 @@ public:
 	/// \param handler = HTTPRequest Handler
 	void remove_handler(const HTTPRequestHandler &handler);
 
+	/// \brief Set the largest request body accepted in the event loop mode
+	///
+	/// Requests with a larger Content-Length are answered with 413 Payload Too Large
+	/// before any of the body is buffered. Applies to connections accepted afterwards.
+	///
+	/// \param size = Maximum body size in bytes
+	void set_max_request_size(int size);
+
 /// \}
 /// \name Implementation
 /// \{
@@ -30,6 +30,7 @@
 #pragma once
 
 #include "api_swrender.h"
+#include "../Core/Math/rect.h"
 
 namespace clan
 {
@@ -39,6 +40,18 @@ namespace clan
 class PixelThreadContext;
 class PixelPipeline;
 
+/// \brief Thread context state tracked by the pipeline while commands are queued, used for occlusion culling
+struct PixelOcclusionState
+{
+	PixelOcclusionState() : clip_rect_known(false) { }
+
+	/// \brief Clipping rectangle the following commands will run with
+	Rect clip_rect;
+
+	/// \brief False until a command sets the clipping rectangle
+	bool clip_rect_known;
+};
+
 /// \brief Interface for commands participating in the rendering pipeline
 class API_SWRender PixelCommand
 {
@@ -49,6 +62,24 @@ public:
 	/// \brief Called by each rendering thread in the pipeline to run the command
 	virtual void run(PixelThreadContext *context) = 0;
 
+	/// \brief Returns the frame buffer area the command may write to
+	///
+	/// The pipeline uses this to skip the command for screen tiles it does not touch.
+	/// Commands returning false, including all commands changing the thread context state, are run for every tile.
+	virtual bool get_bounds(Rect &out_bounds) const { return false; }
+
+	/// \brief Updates the occlusion state with the thread context state set by the command
+	///
+	/// Returns true if the command only changes thread context state. Commands without bounds returning false
+	/// are assumed to read or replace the frame buffer, and the pipeline never culls a command hidden across them.
+	virtual bool update_occlusion_state(PixelOcclusionState &state) const { return false; }
+
+	/// \brief Returns the frame buffer area the command overwrites with fully opaque pixels
+	///
+	/// In tiled rendering with occlusion culling enabled, commands whose visible area is entirely
+	/// overwritten by later opaque commands in the same tile are skipped.
+	virtual bool get_opaque_rect(const PixelOcclusionState &state, Rect &out_rect) const { return false; }
+
 	void *operator new(size_t s, PixelPipeline *p);
 	void operator delete(void *obj, PixelPipeline *p);
 	void operator delete(void *obj);
@@ -47,6 +47,9 @@ class API_SWRender PixelThreadContext
 public:
 	PixelThreadContext(int core, int num_cores);
 
+	/// \brief Constructs a context rendering all lines of a single screen tile
+	PixelThreadContext(const Rect &tile_rect);
+
 //!Attributes
 public:
 	int core;
@@ -55,6 +58,9 @@ public:
 	PixelBufferData colorbuffer0;
 	Rect clip_rect;
 
+	/// \brief Frame buffer area owned by this context. The clipping rectangle never extends beyond it.
+	Rect tile_rect;
+
 	enum { max_samplers = 6 };
 	PixelBufferData samplers[max_samplers];
 	PixelBuffer pixelbuffer_white;
@@ -64,6 +70,10 @@ public:
 	BlendFunc cur_blend_src_alpha;
 	BlendFunc cur_blend_dest_alpha;
 	Colorf cur_blend_color;
+
+//!Implementation
+private:
+	void init_samplers();
 };
 
 }
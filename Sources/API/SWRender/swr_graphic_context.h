@@ -43,6 +43,26 @@ class PixelCommand;
 class PixelPipeline;
 class GraphicContext_SWRender_Impl;
 
+/// \brief Command and pixel counts of the tiled rendering pipeline
+///
+/// Pixel counts are the areas of the command bounds inside each tile, so a command touching several tiles is counted once per tile.
+struct PixelOverdrawCounters
+{
+	PixelOverdrawCounters() : commands_run(0), commands_culled(0), pixels_drawn(0), pixels_culled(0) { }
+
+	/// \brief Number of times a drawing command was run for a tile
+	ubyte64 commands_run;
+
+	/// \brief Number of times a drawing command was skipped for a tile because later opaque commands hid it
+	ubyte64 commands_culled;
+
+	/// \brief Pixels covered by the commands run
+	ubyte64 pixels_drawn;
+
+	/// \brief Pixels covered by the commands culled
+	ubyte64 pixels_culled;
+};
+
 /// \brief SWRender Graphic Context
 class API_SWRender GraphicContext_SWRender : public GraphicContext
 {
@@ -67,6 +87,11 @@ public:
 	/// \brief Returns the pixel pipeline class needed to allocated PixelCommand objects.
 	PixelPipeline *get_pipeline() const;
 
+	/// \brief Returns the overdraw counters collected since the graphic context was created or the counters were reset
+	///
+	/// Counters are only collected in tiled rendering mode. Waits for the queued commands to finish.
+	PixelOverdrawCounters get_overdraw_counters() const;
+
 //!Operations
 public:
 	void draw_pixels(float x, float y, float zoom_x, float zoom_y, const PixelBuffer &pixel_buffer, const Rect &src_rect, const Colorf &color);
@@ -77,6 +102,9 @@ public:
 	void queue_command(T *command) { queue_command(std::unique_ptr<T>(command)); }
 	void queue_command(std::unique_ptr<PixelCommand> &command);
 
+	/// \brief Sets all overdraw counters to zero
+	void reset_overdraw_counters();
+
 //!Implementation
 private:
 	std::shared_ptr<GraphicContext_SWRender_Impl> impl;
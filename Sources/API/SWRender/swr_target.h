@@ -59,6 +59,12 @@ public:
 	/// This may change after a display window has been created
 	static bool is_current();
 
+	/// \brief Returns true if display windows created from now on render in screen tiles
+	static bool is_tiled_rendering();
+
+	/// \brief Returns true if display windows created from now on skip commands hidden by opaque commands
+	static bool is_occlusion_culling();
+
 /// \}
 /// \name Operations
 /// \{
@@ -67,6 +73,20 @@ public:
 	/// \brief Set this display target to be the current target
 	static void set_current();
 
+	/// \brief Enables rendering in screen tiles for display windows created from now on
+	///
+	/// In tile mode each rendering thread owns a set of horizontal screen tiles and only runs the
+	/// commands overlapping them, instead of every thread running every command for interleaved lines.
+	/// Custom pixel commands must then honour PixelThreadContext::clip_rect and should implement PixelCommand::get_bounds.
+	static void set_tiled_rendering(bool enable);
+
+	/// \brief Enables occlusion culling for display windows created from now on
+	///
+	/// Only has an effect in tiled rendering. Each tile keeps a mask of the pixels overwritten by opaque
+	/// fills and clears, and commands queued earlier in the same batch that are entirely hidden are skipped.
+	/// GraphicContext_SWRender::get_overdraw_counters() reports how much was culled.
+	static void set_occlusion_culling(bool enable);
+
 /// \}
 /// \name Implementation
 /// \{
@@ -65,6 +65,12 @@ public:
 	virtual AxisAlignedBoundingBox get_aabb(SceneCullProxy *proxy) = 0;
 
 	virtual std::vector<SceneItem *> cull(const FrustumPlanes &frustum) = 0;
+
+	/// \brief Finds the potential visible set for a frustum into a buffer owned by the caller
+	///
+	/// The buffer is cleared first. Passing the same buffer every frame avoids allocating a new vector each time.
+	virtual void cull(const FrustumPlanes &frustum, std::vector<SceneItem *> &out_pvs) { out_pvs = cull(frustum); }
+
 	virtual std::vector<SceneItem *> cull(const Vec3f &point) = 0;
 };
 
@@ -32,6 +32,7 @@
 #include "../api_sound.h"
 #include "soundprovider.h"
 #include "../../Core/IOData/file_system.h"
+#include "../../Core/System/cl_platform.h"
 
 namespace clan
 {
@@ -41,7 +42,34 @@ namespace clan
 class InputSourceProvider;
 class SoundProvider_Vorbis_Impl;
 
+/// \brief Decoding statistics shared by all Ogg Vorbis sound providers
+struct SoundProvider_Vorbis_Stats
+{
+	SoundProvider_Vorbis_Stats() : cache_hits(0), cache_misses(0), cache_clips(0), cache_size(0), decode_time(0), underruns(0) { }
+
+	/// \brief Number of sessions that found their clip already decoded
+	int cache_hits;
+
+	/// \brief Number of sessions that decoded a clip and added it to the cache
+	int cache_misses;
+
+	/// \brief Number of decoded clips in the cache
+	int cache_clips;
+
+	/// \brief Size of the decoded clips in the cache, in bytes
+	int cache_size;
+
+	/// \brief Time spent decoding, in microseconds
+	ubyte64 decode_time;
+
+	/// \brief Number of times a streamed session had no prefetched samples and decoded on the mixer thread
+	int underruns;
+};
+
 /// \brief Ogg Vorbis format sound provider.
+///
+/// Short clips are decoded completely when a session starts, and kept in a cache shared by all providers.
+/// Longer or streamed sounds are decoded by a background thread that stays ahead of the playback position.
 class CL_API_SOUND SoundProvider_Vorbis : public SoundProvider
 {
 /// \name Construction
@@ -68,11 +96,37 @@ public:
 
 	virtual ~SoundProvider_Vorbis();
 
+/// \}
+/// \name Attributes
+/// \{
+
+public:
+	/// \brief Returns the decoding statistics for all Ogg Vorbis providers.
+	static SoundProvider_Vorbis_Stats get_stats();
+
 /// \}
 /// \name Operations
 /// \{
 
 public:
+	/// \brief Sets the memory the decoded clip cache may use, in bytes.
+	///
+	/// The least recently used clips are removed when the cache grows beyond this. The default is 16 MB.
+	static void set_cache_budget(int bytes);
+
+	/// \brief Sets the largest decoded clip size added to the cache, in bytes.
+	///
+	/// Sounds longer than this are streamed instead. The default is 1 MB.
+	static void set_cache_max_clip_size(int bytes);
+
+	/// \brief Sets how many samples the background decoder keeps ready for each streamed session.
+	///
+	/// Applies to sessions started afterwards. The default is 16384.
+	static void set_prefetch_length(int samples);
+
+	/// \brief Resets the decoding statistics.
+	static void reset_stats();
+
 	/// \brief Called by SoundBuffer when a new session starts.
 	/** \return The soundbuffer session to be attached to the newly started session.*/
 	virtual SoundProvider_Session *begin_session();
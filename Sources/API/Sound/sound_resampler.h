@@ -0,0 +1,118 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Magnus Norddahl
+*/
+
+#pragma once
+
+#include "api_sound.h"
+#include <memory>
+
+namespace clan
+{
+/// \addtogroup clanSound_Audio_Mixing clanSound Audio Mixing
+/// \{
+
+class SoundResampler_Impl;
+
+/// \brief Methods for converting sound between sample rates
+enum SoundResamplerMode
+{
+	/// \brief Linear interpolation between the two nearest samples
+	resampler_linear,
+
+	/// \brief Band limited interpolation using a windowed sinc polyphase filter
+	resampler_polyphase
+};
+
+/// \brief Converts float channels from one sample rate to another
+///
+/// The caller keeps the input position as a sample index plus a 32 bit fixed point fraction.
+/// An output sample at position p is calculated from the input samples p-input_history to p+input_lookahead,
+/// so those samples must be valid for every output sample produced.
+class CL_API_SOUND SoundResampler
+{
+/// \name Construction
+/// \{
+
+public:
+	/// \brief Constructs a resampler converting between equal sample rates
+	SoundResampler(SoundResamplerMode mode = resampler_polyphase);
+
+	~SoundResampler();
+
+/// \}
+/// \name Attributes
+/// \{
+
+public:
+	/// \brief Number of input samples read before the position
+	static const int input_history = 7;
+
+	/// \brief Number of input samples read after the position
+	static const int input_lookahead = 8;
+
+	/// \brief Returns the resampling method
+	SoundResamplerMode get_mode() const;
+
+/// \}
+/// \name Operations
+/// \{
+
+public:
+	/// \brief Sets the resampling method
+	void set_mode(SoundResamplerMode mode);
+
+	/// \brief Sets the sample rates to convert between
+	///
+	/// The polyphase filter banks for 22050, 44100 and 48000 Hz conversions are calculated in advance.
+	/// Banks for other ratios are calculated on first use and shared between resamplers.
+	void set_frequencies(float input_frequency, int output_frequency);
+
+	/// \brief Resamples a block of samples
+	///
+	/// \param input = Input channels
+	/// \param input_size = Number of valid samples in each input channel
+	/// \param num_channels = Number of input and output channels
+	/// \param position = Input sample of the next output sample. Advanced past the input used.
+	/// \param fraction = Fractional part of the position, in units of 1/2^32 samples
+	/// \param output = Output channels
+	/// \param output_size = Maximum number of samples to write to each output channel
+	/// \return Number of samples written. This is less than output_size when the input runs out.
+	int resample(float **input, int input_size, int num_channels, int &position, unsigned int &fraction, float **output, int output_size);
+
+/// \}
+/// \name Implementation
+/// \{
+
+private:
+	std::shared_ptr<SoundResampler_Impl> impl;
+/// \}
+};
+
+}
+
+/// \}
@@ -30,6 +30,7 @@
 #pragma once
 
 #include "api_sound.h"
+#include "sound_resampler.h"
 #include <memory>
 
 namespace clan
@@ -110,6 +111,9 @@ public:
 	/// \brief Returns true if the session is playing
 	bool is_playing();
 
+	/// \brief Returns how the session is converted to the mixing frequency.
+	SoundResamplerMode get_resampler_mode() const;
+
 /// \}
 /// \name Operations
 /// \{
@@ -143,6 +147,11 @@ public:
 	/// \param new_freq New frequency of session.
 	void set_frequency(int new_freq);
 
+	/// \brief Sets how the session is converted to the mixing frequency.
+	///
+	/// The default is resampler_polyphase. resampler_linear uses less CPU time but lets more aliasing through.
+	void set_resampler_mode(SoundResamplerMode mode);
+
 	/// \brief Sets the volume of the session in a relative measure (0->1)
 	///
 	/// A value of 0 will effectively mute the sound (although it will
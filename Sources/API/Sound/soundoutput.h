@@ -42,6 +42,30 @@ class SoundBuffer;
 class SoundOutput_Description;
 class SoundOutput_Impl;
 
+/// \brief Timing statistics of the sound output mixer thread
+struct SoundOutput_MixStats
+{
+	SoundOutput_MixStats() : fragments_mixed(0), active_sessions(0), last_mix_time(0), max_mix_time(0), fragment_time(0), underruns(0) { }
+
+	/// \brief Number of fragments mixed
+	int fragments_mixed;
+
+	/// \brief Number of sessions mixed into the last fragment
+	int active_sessions;
+
+	/// \brief Time spent mixing the last fragment, in microseconds
+	int last_mix_time;
+
+	/// \brief Longest time spent mixing a fragment, in microseconds
+	int max_mix_time;
+
+	/// \brief Duration of the sound in a fragment, in microseconds
+	int fragment_time;
+
+	/// \brief Number of fragments that took longer to mix than their duration
+	int underruns;
+};
+
 /// \brief SoundOutput interface in ClanLib.
 ///
 ///   <p>SoundOutput is the interface to a sound output device. It is used to
@@ -94,6 +118,12 @@ public:
 	/// \brief Returns the main panning position of the sound output.
 	float get_global_pan() const;
 
+	/// \brief Returns true if sessions are mixed on worker threads.
+	bool is_parallel_mixing() const;
+
+	/// \brief Returns the mixer thread statistics since the last reset.
+	SoundOutput_MixStats get_mix_stats() const;
+
 /// \}
 /// \name Operations
 /// \{
@@ -108,6 +138,15 @@ public:
 	/// \brief Sets the main panning position on the sound output.
 	void set_global_pan(float pan);
 
+	/// \brief Enables mixing groups of sessions on worker threads.
+	///
+	/// Each group is mixed into its own buffers, which are added together afterwards.
+	/// Filters attached to sessions must not be shared between sessions when this is enabled.
+	void set_parallel_mixing(bool enable);
+
+	/// \brief Resets the mixer thread statistics.
+	void reset_mix_stats();
+
 	/// \brief Adds the sound filter to the sound output.
 	///
 	/// \param filter Sound filter to pass sound through.
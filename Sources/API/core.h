@@ -75,6 +75,7 @@
 #include "Core/System/disposable_object.h"
 #include "Core/System/event.h"
 #include "Core/System/event_provider.h"
+#include "Core/System/event_set.h"
 #include "Core/System/exception.h"
 #include "Core/System/mutex.h"
 #include "Core/System/runnable.h"
@@ -124,6 +125,9 @@
 #include "Core/Resources/xml_resource_document.h"
 #include "Core/Resources/xml_resource_manager.h"
 #include "Core/JSON/json_value.h"
+#include "Core/JSON/json_reader.h"
+#include "Core/JSON/json_writer.h"
+#include "Core/JSON/json_document.h"
 #include "Core/XML/dom_processing_instruction.h"
 #include "Core/XML/dom_entity_reference.h"
 #include "Core/XML/dom_notation.h"
@@ -147,6 +151,7 @@
 #include "Core/XML/xml_writer.h"
 #include "Core/XML/xml_token.h"
 #include "Core/XML/xpath_evaluator.h"
+#include "Core/XML/xpath_expression.h"
 #include "Core/XML/xpath_object.h"
 #include "Core/IOData/file.h"
 #include "Core/IOData/file_help.h"
@@ -217,6 +222,7 @@
 #include "Core/Crypto/aes256_decrypt.h"
 #include "Core/Crypto/rsa.h"
 #include "Core/Crypto/tls_client.h"
+#include "Core/Crypto/crypto_acceleration.h"
 #include "Core/Math/size.h"
 #include "Core/Math/triangle_math.h"
 #include "Core/Math/line.h"
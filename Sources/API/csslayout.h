@@ -43,6 +43,7 @@
 #include "CSSLayout/CSSDocument/dom_select_node.h"
 #include "CSSLayout/ComputedValues/css_computed_values.h"
 #include "CSSLayout/ComputedValues/css_computed_box.h"
+#include "CSSLayout/ComputedValues/css_style_sharing_stats.h"
 #include "CSSLayout/Layout/css_layout.h"
 #include "CSSLayout/Layout/css_layout_node.h"
 #include "CSSLayout/Layout/css_layout_element.h"
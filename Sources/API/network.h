@@ -66,6 +66,8 @@
 #include "Network/NetGame/event_dispatcher_v3.h"
 #include "Network/NetGame/event_value.h"
 #include "Network/NetGame/server.h"
+#include "Network/NetGame/replica.h"
+#include "Network/NetGame/replicator.h"
 
 #include "Network/TLS/tls_connection.h"
 
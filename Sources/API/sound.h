@@ -52,6 +52,7 @@
 #include "Sound/soundfilter.h"
 #include "Sound/cd_drive.h"
 #include "Sound/sound_sse.h"
+#include "Sound/sound_resampler.h"
 
 #include "Sound/SoundProviders/soundprovider_wave.h"
 #include "Sound/SoundProviders/soundprovider_raw.h"
@@ -0,0 +1,158 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Magnus Norddahl
+*/
+
+#include "CSSLayout/precomp.h"
+#include "css_ancestor_filter.h"
+#include "API/CSSLayout/CSSDocument/css_select_node.h"
+#include "API/Core/Text/string_help.h"
+
+namespace clan
+{
+
+CSSAncestorFilter::CSSAncestorFilter(CSSSelectNode *node)
+: node(node), collected(false)
+{
+}
+
+bool CSSAncestorFilter::may_match(const CSSSelectorChain &chain)
+{
+	if (chain.ancestor_hashes.empty())
+		return true;
+
+	if (!collected)
+		collect_ancestors();
+
+	for (size_t i = 0; i < chain.ancestor_hashes.size(); i++)
+	{
+		if (!may_contain(chain.ancestor_hashes[i]))
+			return false;
+	}
+	return true;
+}
+
+std::vector<unsigned int> CSSAncestorFilter::get_ancestor_hashes(const CSSSelectorChain &chain)
+{
+	// A compound selector must match an ancestor when the nearest combinator to its right is a
+	// descendant or child combinator. Siblings are skipped, but ancestors of a sibling are also
+	// ancestors of the node itself.
+	std::vector<unsigned int> hashes;
+	bool is_ancestor = false;
+	for (size_t i = chain.links.size(); i > 0; i--)
+	{
+		const CSSSelectorLink &link = chain.links[i - 1];
+		switch (link.type)
+		{
+		case CSSSelectorLink::type_descendant_combinator:
+		case CSSSelectorLink::type_child_combinator:
+			is_ancestor = true;
+			break;
+
+		case CSSSelectorLink::type_next_sibling_combinator:
+			is_ancestor = false;
+			break;
+
+		case CSSSelectorLink::type_simple_selector:
+		case CSSSelectorLink::type_universal_selector:
+			if (is_ancestor)
+			{
+				if (link.type == CSSSelectorLink::type_simple_selector)
+					hashes.push_back(hash_name(link.element_name));
+				if (!link.element_id.empty())
+					hashes.push_back(hash_id(link.element_id));
+				for (size_t j = 0; j < link.element_classes.size(); j++)
+					hashes.push_back(hash_class(link.element_classes[j]));
+			}
+			break;
+		}
+	}
+	return hashes;
+}
+
+unsigned int CSSAncestorFilter::hash_name(const std::string &name)
+{
+	return hash('t', StringHelp::text_to_lower(name));
+}
+
+unsigned int CSSAncestorFilter::hash_id(const std::string &id)
+{
+	return hash('#', id);
+}
+
+unsigned int CSSAncestorFilter::hash_class(const std::string &element_class)
+{
+	return hash('.', StringHelp::text_to_lower(element_class));
+}
+
+void CSSAncestorFilter::collect_ancestors()
+{
+	collected = true;
+	for (int i = 0; i < filter_bits / 32; i++)
+		bits[i] = 0;
+
+	node->push();
+	while (node->parent())
+	{
+		insert(hash_name(node->name()));
+
+		std::string id = node->id();
+		if (!id.empty())
+			insert(hash_id(id));
+
+		std::vector<std::string> element_classes = node->element_classes();
+		for (size_t i = 0; i < element_classes.size(); i++)
+			insert(hash_class(element_classes[i]));
+	}
+	node->pop();
+}
+
+void CSSAncestorFilter::insert(unsigned int hash)
+{
+	unsigned int bit1 = hash % filter_bits;
+	unsigned int bit2 = (hash >> 16) % filter_bits;
+	bits[bit1 / 32] |= 1 << (bit1 % 32);
+	bits[bit2 / 32] |= 1 << (bit2 % 32);
+}
+
+bool CSSAncestorFilter::may_contain(unsigned int hash) const
+{
+	unsigned int bit1 = hash % filter_bits;
+	unsigned int bit2 = (hash >> 16) % filter_bits;
+	return (bits[bit1 / 32] & (1 << (bit1 % 32))) && (bits[bit2 / 32] & (1 << (bit2 % 32)));
+}
+
+unsigned int CSSAncestorFilter::hash(char prefix, const std::string &value)
+{
+	// FNV-1a
+	unsigned int hash = 2166136261U;
+	hash = (hash ^ (unsigned char)prefix) * 16777619U;
+	for (size_t i = 0; i < value.length(); i++)
+		hash = (hash ^ (unsigned char)value[i]) * 16777619U;
+	return hash;
+}
+
+}
@@ -0,0 +1,70 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Magnus Norddahl
+*/
+
+#pragma once
+
+#include "css_selector_chain.h"
+
+namespace clan
+{
+
+class CSSSelectNode;
+
+/// \brief Bloom filter of the names, ids and classes of all ancestors of a node
+///
+/// Used to reject descendant and child selector chains without walking up the tree.
+/// The ancestors are only collected the first time the filter is queried.
+class CSSAncestorFilter
+{
+public:
+	CSSAncestorFilter(CSSSelectNode *node);
+
+	/// \brief Returns false if the node definitely has no ancestors able to match the chain
+	bool may_match(const CSSSelectorChain &chain);
+
+	/// \brief Calculates the hashes of the names, ids and classes that must exist among the ancestors of a node matching the chain
+	static std::vector<unsigned int> get_ancestor_hashes(const CSSSelectorChain &chain);
+
+	static unsigned int hash_name(const std::string &name);
+	static unsigned int hash_id(const std::string &id);
+	static unsigned int hash_class(const std::string &element_class);
+
+private:
+	void collect_ancestors();
+	void insert(unsigned int hash);
+	bool may_contain(unsigned int hash) const;
+	static unsigned int hash(char prefix, const std::string &value);
+
+	enum { filter_bits = 2048 };
+
+	CSSSelectNode *node;
+	bool collected;
+	unsigned int bits[filter_bits / 32];
+};
+
+}
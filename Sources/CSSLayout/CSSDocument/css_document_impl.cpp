@@ -37,9 +37,10 @@ namespace clan
 std::vector<CSSRulesetMatch> CSSDocument_Impl::select_rulesets(CSSSelectNode *node, const std::string &pseudo_element)
 {
 	std::vector<CSSRulesetMatch> matches;
+	CSSAncestorFilter ancestor_filter(node);
 	for (size_t i = 0; i < sheets.size(); i++)
 	{
-		std::vector<CSSRulesetMatch> sheet_matches = sheets[i]->select_rulesets(node, pseudo_element);
+		std::vector<CSSRulesetMatch> sheet_matches = sheets[i]->select_rulesets(node, pseudo_element, ancestor_filter);
 		matches.insert(matches.end(), sheet_matches.begin(), sheet_matches.end());
 	}
 	return matches;
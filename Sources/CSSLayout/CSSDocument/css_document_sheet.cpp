@@ -30,6 +30,7 @@
 #include "css_document_sheet.h"
 #include "css_ruleset_match.h"
 #include "API/Core/IOData/html_url.h"
+#include "API/Core/Text/string_help.h"
 
 namespace clan
 {
@@ -38,18 +39,36 @@ CSSDocumentSheet::CSSDocumentSheet(CSSSheetOrigin origin, CSSTokenizer &tokenize
 : origin(origin), base_uri(base_uri)
 {
 	read_stylesheet(tokenizer);
+	build_index();
 }
 
-std::vector<CSSRulesetMatch> CSSDocumentSheet::select_rulesets(CSSSelectNode *node, const std::string &pseudo_element)
+std::vector<CSSRulesetMatch> CSSDocumentSheet::select_rulesets(CSSSelectNode *node, const std::string &pseudo_element, CSSAncestorFilter &ancestor_filter)
 {
+	// Only rulesets with a chain whose rightmost selector can match this node are candidates
+	std::vector<size_t> candidates = universal_bucket;
+
+	std::string id = node->id();
+	if (!id.empty())
+		add_bucket_candidates(id_buckets, id, candidates);
+
+	std::vector<std::string> element_classes = node->element_classes();
+	for (size_t i = 0; i < element_classes.size(); i++)
+		add_bucket_candidates(class_buckets, StringHelp::text_to_lower(element_classes[i]), candidates);
+
+	add_bucket_candidates(name_buckets, StringHelp::text_to_lower(node->name()), candidates);
+
+	// Keep document order
+	std::sort(candidates.begin(), candidates.end());
+	candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
 	std::vector<CSSRulesetMatch> matched_rulesets;
-	for (size_t i = 0; i < rulesets.size(); i++)
+	for (size_t i = 0; i < candidates.size(); i++)
 	{
-		CSSRuleset *cur_ruleset = rulesets[i].get();
+		CSSRuleset *cur_ruleset = rulesets[candidates[i]].get();
 		for (size_t j = 0; j < cur_ruleset->selectors.size(); j++)
 		{
 			const CSSSelectorChain &chain = cur_ruleset->selectors[j];
-			if (equals(chain.pseudo_element, pseudo_element))
+			if (equals(chain.pseudo_element, pseudo_element) && ancestor_filter.may_match(chain))
 			{
 				bool matches = try_match_chain(chain, node, chain.links.size());
 				if (matches)
@@ -783,6 +802,54 @@ std::string CSSDocumentSheet::to_string(const CSSToken &token)
 	}
 }
 
+void CSSDocumentSheet::build_index()
+{
+	id_buckets.clear();
+	class_buckets.clear();
+	name_buckets.clear();
+	universal_bucket.clear();
+
+	for (size_t i = 0; i < rulesets.size(); i++)
+	{
+		CSSRuleset *cur_ruleset = rulesets[i].get();
+		for (size_t j = 0; j < cur_ruleset->selectors.size(); j++)
+		{
+			CSSSelectorChain &chain = cur_ruleset->selectors[j];
+			chain.ancestor_hashes = CSSAncestorFilter::get_ancestor_hashes(chain);
+
+			// Pick the most selective part of the rightmost compound selector
+			if (chain.links.empty())
+			{
+				add_to_bucket(universal_bucket, i);
+				continue;
+			}
+
+			const CSSSelectorLink &link = chain.links.back();
+			if (!link.element_id.empty())
+				add_to_bucket(id_buckets[link.element_id], i);
+			else if (!link.element_classes.empty())
+				add_to_bucket(class_buckets[StringHelp::text_to_lower(link.element_classes.front())], i);
+			else if (link.type == CSSSelectorLink::type_simple_selector)
+				add_to_bucket(name_buckets[StringHelp::text_to_lower(link.element_name)], i);
+			else
+				add_to_bucket(universal_bucket, i);
+		}
+	}
+}
+
+void CSSDocumentSheet::add_to_bucket(std::vector<size_t> &bucket, size_t ruleset_index)
+{
+	if (bucket.empty() || bucket.back() != ruleset_index)
+		bucket.push_back(ruleset_index);
+}
+
+void CSSDocumentSheet::add_bucket_candidates(const std::map<std::string, std::vector<size_t> > &buckets, const std::string &key, std::vector<size_t> &candidates)
+{
+	std::map<std::string, std::vector<size_t> >::const_iterator it = buckets.find(key);
+	if (it != buckets.end())
+		candidates.insert(candidates.end(), it->second.begin(), it->second.end());
+}
+
 bool CSSDocumentSheet::equals(const std::string &s1, const std::string &s2)
 {
 	return StringHelp::compare(s1, s2, true) == 0;
@@ -9,7 +9,9 @@
 #include "css_ruleset.h"
 #include "css_selector_chain.h"
 #include "css_selector_link.h"
+#include "css_ancestor_filter.h"
 #include <algorithm>
+#include <map>
 
 namespace clan
 {
@@ -20,7 +22,7 @@ class CSSDocumentSheet
 {
 public:
 	CSSDocumentSheet(CSSSheetOrigin origin, CSSTokenizer &tokenizer, const std::string &base_uri);
-	std::vector<CSSRulesetMatch> select_rulesets(CSSSelectNode *node, const std::string &pseudo_element);
+	std::vector<CSSRulesetMatch> select_rulesets(CSSSelectNode *node, const std::string &pseudo_element, CSSAncestorFilter &ancestor_filter);
 
 	CSSSheetOrigin origin;
 
@@ -38,10 +40,19 @@ private:
 	std::string to_string(const CSSToken &token);
 	static bool equals(const std::string &s1, const std::string &s2);
 	static std::string make_absolute_uri(std::string uri, std::string base_uri);
+	void build_index();
+	static void add_to_bucket(std::vector<size_t> &bucket, size_t ruleset_index);
+	static void add_bucket_candidates(const std::map<std::string, std::vector<size_t> > &buckets, const std::string &key, std::vector<size_t> &candidates);
 
 	std::string base_uri;
 	std::vector<std::shared_ptr<CSSRuleset> > rulesets;
 
+	// Ruleset indexes bucketed by the rightmost compound selector of their chains
+	std::map<std::string, std::vector<size_t> > id_buckets;
+	std::map<std::string, std::vector<size_t> > class_buckets;
+	std::map<std::string, std::vector<size_t> > name_buckets;
+	std::vector<size_t> universal_bucket;
+
 	CSSPropertyParsers parsers;
 };
 
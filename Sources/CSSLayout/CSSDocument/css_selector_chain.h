@@ -11,6 +11,7 @@ class CSSSelectorChain
 public:
 	std::vector<CSSSelectorLink> links;
 	std::string pseudo_element; // E:before (E::before in CSS3), E:after (E::after in CSS3)
+	std::vector<unsigned int> ancestor_hashes; // Names, ids and classes required among the ancestors (see CSSAncestorFilter)
 
 	size_t get_specificity()
 	{
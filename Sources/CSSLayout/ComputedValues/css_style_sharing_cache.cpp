@@ -0,0 +1,86 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Magnus Norddahl
+*/
+
+#include "CSSLayout/precomp.h"
+#include "css_style_sharing_cache.h"
+
+namespace clan
+{
+
+CSSStyleSharingCache::CSSStyleSharingCache()
+: num_candidates(0), next_candidate(0)
+{
+}
+
+CSSComputedValues CSSStyleSharingCache::find(const CSSComputedValues &parent, const CSSSelectResult &selected_values)
+{
+	stats.lookups++;
+
+	// Search the most recently inserted candidates first
+	for (int i = 0; i < num_candidates; i++)
+	{
+		Candidate &candidate = candidates[(next_candidate + max_candidates - 1 - i) % max_candidates];
+		if (candidate.parent == parent && equals(candidate.selected_values, selected_values))
+		{
+			stats.hits++;
+			return candidate.values;
+		}
+	}
+	return CSSComputedValues();
+}
+
+void CSSStyleSharingCache::insert(const CSSComputedValues &parent, const CSSSelectResult &selected_values, const CSSComputedValues &values)
+{
+	Candidate &candidate = candidates[next_candidate];
+	candidate.parent = parent;
+	candidate.selected_values = selected_values;
+	candidate.values = values;
+
+	next_candidate = (next_candidate + 1) % max_candidates;
+	if (num_candidates < max_candidates)
+		num_candidates++;
+}
+
+void CSSStyleSharingCache::clear()
+{
+	for (int i = 0; i < max_candidates; i++)
+		candidates[i] = Candidate();
+	num_candidates = 0;
+	next_candidate = 0;
+}
+
+bool CSSStyleSharingCache::equals(const CSSSelectResult &a, const CSSSelectResult &b)
+{
+	if (a.is_null() || b.is_null())
+		return a.is_null() && b.is_null();
+
+	// The property values are owned by the style sheets, so identical pointers means identical declarations
+	return a.get_values() == b.get_values();
+}
+
+}
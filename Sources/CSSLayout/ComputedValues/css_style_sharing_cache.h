@@ -0,0 +1,79 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Magnus Norddahl
+*/
+
+#pragma once
+
+#include "API/CSSLayout/ComputedValues/css_computed_values.h"
+#include "API/CSSLayout/ComputedValues/css_style_sharing_stats.h"
+#include "API/CSSLayout/CSSDocument/css_select_result.h"
+
+namespace clan
+{
+
+/// \brief Finds previously computed values that can be reused by an element
+///
+/// Two elements with the same parent computed values and the same selected
+/// property values always end up with identical computed values. The cache
+/// remembers the most recent elements, so siblings and cousins in long lists
+/// can share a single computed values object instead of computing their own.
+class CSSStyleSharingCache
+{
+public:
+	CSSStyleSharingCache();
+
+	/// \brief Returns the computed values to reuse, or null if no candidate matched
+	CSSComputedValues find(const CSSComputedValues &parent, const CSSSelectResult &selected_values);
+
+	/// \brief Adds new computed values as candidate for sharing
+	void insert(const CSSComputedValues &parent, const CSSSelectResult &selected_values, const CSSComputedValues &values);
+
+	/// \brief Removes all candidates
+	void clear();
+
+	const CSSStyleSharingStats &get_stats() const { return stats; }
+	void reset_stats() { stats = CSSStyleSharingStats(); }
+
+private:
+	struct Candidate
+	{
+		CSSComputedValues parent;
+		CSSSelectResult selected_values;
+		CSSComputedValues values;
+	};
+
+	static bool equals(const CSSSelectResult &a, const CSSSelectResult &b);
+
+	enum { max_candidates = 16 };
+
+	Candidate candidates[max_candidates];
+	int num_candidates;
+	int next_candidate;
+	CSSStyleSharingStats stats;
+};
+
+}
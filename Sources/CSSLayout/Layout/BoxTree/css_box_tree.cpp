@@ -63,6 +63,7 @@ void CSSBoxTree::compute(CSSResourceCache *cache)
 {
 	bool collapse_space = false;
 	compute(cache, 0, collapse_space);
+	style_sharing_cache.clear();
 }
 
 void CSSBoxTree::compute(CSSResourceCache *cache, CSSBoxNode *node, bool &collapse_space)
@@ -73,14 +74,22 @@ void CSSBoxTree::compute(CSSResourceCache *cache, CSSBoxNode *node, bool &collap
 	CSSBoxElement *element = dynamic_cast<CSSBoxElement *>(node);
 	if (element)
 	{
-		element->computed_values = CSSComputedValues(cache);
-
+		CSSComputedValues parent_values;
 		if (element->get_parent())
-			element->computed_values.set_parent(static_cast<CSSBoxElement*>(element->get_parent())->computed_values);
+			parent_values = static_cast<CSSBoxElement*>(element->get_parent())->computed_values;
 
 		CSSBoxSelectNode select_node(element);
 		CSSSelectResult select_result = css.select(&select_node);
-		element->computed_values.set_specified_values(select_result);
+
+		element->computed_values = style_sharing_cache.find(parent_values, select_result);
+		if (element->computed_values.is_null())
+		{
+			element->computed_values = CSSComputedValues(cache);
+			if (!parent_values.is_null())
+				element->computed_values.set_parent(parent_values);
+			element->computed_values.set_specified_values(select_result);
+			style_sharing_cache.insert(parent_values, select_result, element->computed_values);
+		}
 	}
 
 	CSSBoxText *text = dynamic_cast<CSSBoxText*>(node);
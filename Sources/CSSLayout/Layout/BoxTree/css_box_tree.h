@@ -30,6 +30,7 @@
 
 #include "API/CSSLayout/CSSDocument/css_document.h"
 #include "CSSLayout/PropertyParsers/css_property_parsers.h"
+#include "CSSLayout/ComputedValues/css_style_sharing_cache.h"
 
 namespace clan
 {
@@ -51,6 +52,7 @@ public:
 	CSSDocument css;
 	CSSBoxElement *get_root_element() { return root_element; }
 	const CSSBoxElement *get_root_element() const { return root_element; }
+	const CSSStyleSharingStats &get_style_sharing_stats() const { return style_sharing_cache.get_stats(); }
 
 private:
 	void compute(CSSResourceCache *cache);
@@ -64,6 +66,7 @@ private:
 
 	CSSBoxElement *root_element;
 	CSSPropertyParsers property_parsers;
+	CSSStyleSharingCache style_sharing_cache;
 };
 
 }
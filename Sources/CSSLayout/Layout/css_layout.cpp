@@ -32,6 +32,7 @@
 #include "API/CSSLayout/Layout/css_layout_element.h"
 #include "API/CSSLayout/Layout/css_layout_object.h"
 #include "API/CSSLayout/Layout/css_hit_test_result.h"
+#include "API/CSSLayout/ComputedValues/css_style_sharing_stats.h"
 #include "BoxTree/css_box_element.h"
 #include "BoxTree/css_box_text.h"
 #include "BoxTree/css_box_object.h"
@@ -219,6 +220,11 @@ CSSLayoutElement CSSLayout::find_element(const std::string &name)
 	}
 }
 
+CSSStyleSharingStats CSSLayout::get_style_sharing_stats() const
+{
+	return impl->box_tree.get_style_sharing_stats();
+}
+
 Callback_2<Image, Canvas &, const std::string &> &CSSLayout::func_get_image()
 {
 	return impl->resource_cache.cb_get_image;
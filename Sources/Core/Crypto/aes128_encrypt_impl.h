@@ -99,8 +99,13 @@ public:
 private:
 	void process_chunk();
 
+	/// \brief Processes whole blocks with the AES-NI instructions
+	void process_blocks(const unsigned char *data, int num_blocks);
+
 	ubyte32 key_expanded[aes128_nb_mult_nr_plus1];
 
+	unsigned char round_keys[aes128_nb_mult_nr_plus1 * 4];
+
 	unsigned char chunk[aes128_block_size_bytes];
 	ubyte32 initialisation_vector_1;
 	ubyte32 initialisation_vector_2;
@@ -29,6 +29,7 @@
 
 #include "Core/precomp.h"
 #include "aes192_decrypt_impl.h"
+#include "aes_ni.h"
 
 #include "../../API/Core/Math/cl_math.h"
 
@@ -87,6 +88,7 @@ void AES192_Decrypt_Impl::set_key(const unsigned char key[24])
 	cipher_key_set = true;
 	extract_encrypt_key192(key, key_expanded);
 	extract_decrypt_key(key_expanded, aes192_num_rounds_nr);
+	store_round_keys(key_expanded, aes192_num_rounds_nr, round_keys);
 }
 
 void AES192_Decrypt_Impl::add(const void *_data, int size)
@@ -104,6 +106,19 @@ void AES192_Decrypt_Impl::add(const void *_data, int size)
 	int pos = 0;
 	while (pos < size)
 	{
+		if (use_aes_ni && chunk_filled == 0)
+		{
+			int num_blocks = (size - pos) / aes192_block_size_bytes;
+			if (padding_enabled && num_blocks * aes192_block_size_bytes == size - pos)
+				num_blocks--;	// Keep the last block for calculate()
+			if (num_blocks > 0)
+			{
+				process_blocks(data + pos, num_blocks);
+				pos += num_blocks * aes192_block_size_bytes;
+				continue;
+			}
+		}
+
 		int data_left = size - pos;
 		int buffer_space = aes192_block_size_bytes - chunk_filled;
 		int data_used = min(buffer_space, data_left);
@@ -185,6 +200,7 @@ bool AES192_Decrypt_Impl::calculate()
 	initialisation_vector_set = false;	// Force to reset after each call
 	cipher_key_set = false;				// Force to reset after each call (to avoid keeping the cipher key in memory)
 	memset(key_expanded, 0, sizeof(key_expanded));
+	memset(round_keys, 0, sizeof(round_keys));
 
 	return true;
 
@@ -195,6 +211,12 @@ bool AES192_Decrypt_Impl::calculate()
 
 void AES192_Decrypt_Impl::process_chunk()
 {
+	if (use_aes_ni)
+	{
+		process_blocks(chunk, 1);
+		return;
+	}
+
 	const ubyte32 *key_expanded_ptr = key_expanded;
 
 	ubyte32 chunk1 = get_word(chunk);
@@ -289,4 +311,20 @@ void AES192_Decrypt_Impl::process_chunk()
 
 }
 
+void AES192_Decrypt_Impl::process_blocks(const unsigned char *data, int num_blocks)
+{
+	unsigned char iv[16];
+	put_word(initialisation_vector_1, iv);
+	put_word(initialisation_vector_2, iv + 4);
+	put_word(initialisation_vector_3, iv + 8);
+	put_word(initialisation_vector_4, iv + 12);
+
+	AES_NI::decrypt_cbc(round_keys, aes192_num_rounds_nr, iv, data, append_blocks(databuffer, num_blocks), num_blocks);
+
+	initialisation_vector_1 = get_word(iv);
+	initialisation_vector_2 = get_word(iv + 4);
+	initialisation_vector_3 = get_word(iv + 8);
+	initialisation_vector_4 = get_word(iv + 12);
+}
+
 }
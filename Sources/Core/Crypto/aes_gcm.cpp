@@ -0,0 +1,334 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Magnus Norddahl
+*/
+
+#include "Core/precomp.h"
+#include "API/Core/Crypto/crypto_acceleration.h"
+#include "aes_gcm.h"
+#include "aes_ni.h"
+
+#include "../../API/Core/Math/cl_math.h"
+
+#ifndef WIN32
+#include <cstring>
+#endif
+
+namespace clan
+{
+
+/////////////////////////////////////////////////////////////////////////////
+// AES_GCM Construction:
+
+AES_GCM::AES_GCM() : num_rounds(0), cipher_key_set(false)
+{
+	use_pclmul = CryptoAcceleration::is_enabled() && CryptoAcceleration::is_pclmul_supported();
+}
+
+AES_GCM::~AES_GCM()
+{
+	// Remove the key from memory
+	memset(key_expanded, 0, sizeof(key_expanded));
+	memset(round_keys, 0, sizeof(round_keys));
+	memset(ghash_keys, 0, sizeof(ghash_keys));
+	memset(ghash_table_high, 0, sizeof(ghash_table_high));
+	memset(ghash_table_low, 0, sizeof(ghash_table_low));
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// AES_GCM Operations:
+
+void AES_GCM::set_key(const unsigned char *key, int key_length)
+{
+	if (key_length == aes128_key_length_bytes)
+	{
+		extract_encrypt_key128(key, key_expanded);
+		num_rounds = aes128_num_rounds_nr;
+	}
+	else if (key_length == aes256_key_length_bytes)
+	{
+		extract_encrypt_key256(key, key_expanded);
+		num_rounds = aes256_num_rounds_nr;
+	}
+	else
+	{
+		throw Exception("AES-GCM key must be 16 or 32 bytes");
+	}
+	store_round_keys(key_expanded, num_rounds, round_keys);
+	cipher_key_set = true;
+
+	// The hash key H is the encrypted zero block
+	unsigned char hash_key[16] = { 0 };
+	encrypt_block(hash_key, hash_key);
+	if (use_pclmul)
+		AES_NI::create_ghash_keys(hash_key, ghash_keys);
+	else
+		ghash_create_table(hash_key);
+	memset(hash_key, 0, sizeof(hash_key));
+}
+
+void AES_GCM::encrypt(const unsigned char iv[iv_size], const void *aad, int aad_size, void *data, int size, unsigned char out_tag[tag_size])
+{
+	if (!cipher_key_set)
+		throw Exception("AES-GCM cipher key has not been set");
+
+	// The first counter block (J0) is used for the tag, the data starts at the next one
+	unsigned char counter[16];
+	memcpy(counter, iv, iv_size);
+	counter[12] = 0; counter[13] = 0; counter[14] = 0; counter[15] = 2;
+	crypt_ctr(counter, (unsigned char *) data, size);
+
+	calculate_tag(iv, aad, aad_size, data, size, out_tag);
+}
+
+bool AES_GCM::decrypt(const unsigned char iv[iv_size], const void *aad, int aad_size, void *data, int size, const unsigned char tag[tag_size])
+{
+	if (!cipher_key_set)
+		throw Exception("AES-GCM cipher key has not been set");
+
+	unsigned char expected_tag[tag_size];
+	calculate_tag(iv, aad, aad_size, data, size, expected_tag);
+
+	// Compare in constant time, not revealing how many bytes matched
+	unsigned char difference = 0;
+	for (int cnt = 0; cnt < tag_size; cnt++)
+		difference |= expected_tag[cnt] ^ tag[cnt];
+	if (difference != 0)
+		return false;
+
+	unsigned char counter[16];
+	memcpy(counter, iv, iv_size);
+	counter[12] = 0; counter[13] = 0; counter[14] = 0; counter[15] = 2;
+	crypt_ctr(counter, (unsigned char *) data, size);
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// AES_GCM Implementation:
+
+void AES_GCM::encrypt_block(const unsigned char input[16], unsigned char output[16])
+{
+	if (use_aes_ni)
+	{
+		// Encrypting a zero block in counter mode gives the encrypted counter block
+		unsigned char counter[16];
+		unsigned char zero[16] = { 0 };
+		memcpy(counter, input, 16);
+		AES_NI::crypt_ctr32(round_keys, num_rounds, counter, zero, output, 16);
+		return;
+	}
+
+	const ubyte32 *key_expanded_ptr = key_expanded;
+	ubyte32 s0 = get_word(input) ^ key_expanded_ptr[0];
+	ubyte32 s1 = get_word(input + 4) ^ key_expanded_ptr[1];
+	ubyte32 s2 = get_word(input + 8) ^ key_expanded_ptr[2];
+	ubyte32 s3 = get_word(input + 12) ^ key_expanded_ptr[3];
+
+	for (int round = 1; round < num_rounds; round++)
+	{
+		key_expanded_ptr += 4;
+		ubyte32 t0 = table_e0[s0 >> 24] ^ table_e1[(s1 >> 16) & 0xff] ^ table_e2[(s2 >>  8) & 0xff] ^ table_e3[s3 & 0xff] ^ key_expanded_ptr[0];
+		ubyte32 t1 = table_e0[s1 >> 24] ^ table_e1[(s2 >> 16) & 0xff] ^ table_e2[(s3 >>  8) & 0xff] ^ table_e3[s0 & 0xff] ^ key_expanded_ptr[1];
+		ubyte32 t2 = table_e0[s2 >> 24] ^ table_e1[(s3 >> 16) & 0xff] ^ table_e2[(s0 >>  8) & 0xff] ^ table_e3[s1 & 0xff] ^ key_expanded_ptr[2];
+		ubyte32 t3 = table_e0[s3 >> 24] ^ table_e1[(s0 >> 16) & 0xff] ^ table_e2[(s1 >>  8) & 0xff] ^ table_e3[s2 & 0xff] ^ key_expanded_ptr[3];
+		s0 = t0;
+		s1 = t1;
+		s2 = t2;
+		s3 = t3;
+	}
+
+	key_expanded_ptr += 4;
+
+	// Apply last round
+	ubyte32 t0 = (sbox_substitution_values[(s0 >> 24) ] & 0xff000000) ^ (sbox_substitution_values[(s1 >> 16) & 0xff] & 0x00ff0000) ^ (sbox_substitution_values[(s2 >> 8) & 0xff] & 0x0000ff00) ^ (sbox_substitution_values[(s3 ) & 0xff] & 0x000000ff) ^ key_expanded_ptr[0];
+	ubyte32 t1 = (sbox_substitution_values[(s1 >> 24) ] & 0xff000000) ^ (sbox_substitution_values[(s2 >> 16) & 0xff] & 0x00ff0000) ^ (sbox_substitution_values[(s3 >> 8) & 0xff] & 0x0000ff00) ^ (sbox_substitution_values[(s0 ) & 0xff] & 0x000000ff) ^ key_expanded_ptr[1];
+	ubyte32 t2 = (sbox_substitution_values[(s2 >> 24) ] & 0xff000000) ^ (sbox_substitution_values[(s3 >> 16) & 0xff] & 0x00ff0000) ^ (sbox_substitution_values[(s0 >> 8) & 0xff] & 0x0000ff00) ^ (sbox_substitution_values[(s1 ) & 0xff] & 0x000000ff) ^ key_expanded_ptr[2];
+	ubyte32 t3 = (sbox_substitution_values[(s3 >> 24) ] & 0xff000000) ^ (sbox_substitution_values[(s0 >> 16) & 0xff] & 0x00ff0000) ^ (sbox_substitution_values[(s1 >> 8) & 0xff] & 0x0000ff00) ^ (sbox_substitution_values[(s2 ) & 0xff] & 0x000000ff) ^ key_expanded_ptr[3];
+
+	put_word(t0, output);
+	put_word(t1, output + 4);
+	put_word(t2, output + 8);
+	put_word(t3, output + 12);
+}
+
+void AES_GCM::crypt_ctr(unsigned char counter[16], unsigned char *data, int size)
+{
+	if (use_aes_ni)
+	{
+		AES_NI::crypt_ctr32(round_keys, num_rounds, counter, data, data, size);
+		return;
+	}
+
+	unsigned char key_stream[16];
+	for (int pos = 0; pos < size; pos += 16)
+	{
+		encrypt_block(counter, key_stream);
+		int block_size = min(16, size - pos);
+		for (int cnt = 0; cnt < block_size; cnt++)
+			data[pos + cnt] ^= key_stream[cnt];
+
+		// Increment the last 32 bits only
+		for (int cnt = 15; cnt >= 12; cnt--)
+		{
+			if (++counter[cnt] != 0)
+				break;
+		}
+	}
+}
+
+void AES_GCM::ghash_create_table(const unsigned char hash_key[16])
+{
+	// Shoup's method: the products of H with every 4 bit value
+	ubyte64 high = 0, low = 0;
+	for (int cnt = 0; cnt < 8; cnt++)
+	{
+		high = (high << 8) | hash_key[cnt];
+		low = (low << 8) | hash_key[cnt + 8];
+	}
+
+	ghash_table_high[0] = 0;
+	ghash_table_low[0] = 0;
+	ghash_table_high[8] = high;
+	ghash_table_low[8] = low;
+
+	for (int cnt = 4; cnt > 0; cnt >>= 1)
+	{
+		// Multiply by x, in the bit reflected representation GCM uses
+		ubyte64 reduce = (low & 1) ? 0xe100000000000000ULL : 0;
+		low = (high << 63) | (low >> 1);
+		high = (high >> 1) ^ reduce;
+		ghash_table_high[cnt] = high;
+		ghash_table_low[cnt] = low;
+	}
+
+	for (int cnt = 2; cnt <= 8; cnt *= 2)
+	{
+		for (int index = 1; index < cnt; index++)
+		{
+			ghash_table_high[cnt + index] = ghash_table_high[cnt] ^ ghash_table_high[index];
+			ghash_table_low[cnt + index] = ghash_table_low[cnt] ^ ghash_table_low[index];
+		}
+	}
+}
+
+void AES_GCM::ghash_multiply(unsigned char hash[16])
+{
+	// Reduction of the 4 bits shifted out of the low end
+	static const ubyte64 reduction_table[16] =
+	{
+		0x0000, 0x1c20, 0x3840, 0x2460, 0x7080, 0x6ca0, 0x48c0, 0x54e0,
+		0xe100, 0xfd20, 0xd940, 0xc560, 0x9180, 0x8da0, 0xa9c0, 0xb5e0
+	};
+
+	int nibble = hash[15] & 0x0f;
+	ubyte64 high = ghash_table_high[nibble];
+	ubyte64 low = ghash_table_low[nibble];
+
+	for (int cnt = 15; cnt >= 0; cnt--)
+	{
+		if (cnt != 15)
+		{
+			nibble = hash[cnt] & 0x0f;
+			int remainder = low & 0x0f;
+			low = (high << 60) | (low >> 4);
+			high = (high >> 4) ^ (reduction_table[remainder] << 48);
+			high ^= ghash_table_high[nibble];
+			low ^= ghash_table_low[nibble];
+		}
+
+		nibble = hash[cnt] >> 4;
+		int remainder = low & 0x0f;
+		low = (high << 60) | (low >> 4);
+		high = (high >> 4) ^ (reduction_table[remainder] << 48);
+		high ^= ghash_table_high[nibble];
+		low ^= ghash_table_low[nibble];
+	}
+
+	for (int cnt = 7; cnt >= 0; cnt--)
+	{
+		hash[cnt] = (unsigned char) high;
+		hash[cnt + 8] = (unsigned char) low;
+		high >>= 8;
+		low >>= 8;
+	}
+}
+
+void AES_GCM::ghash_add(unsigned char hash[16], const void *data, int size)
+{
+	const unsigned char *data_ptr = (const unsigned char *) data;
+	int num_blocks = size / 16;
+
+	if (use_pclmul)
+	{
+		AES_NI::ghash(ghash_keys, hash, data_ptr, num_blocks);
+	}
+	else
+	{
+		for (int block = 0; block < num_blocks; block++)
+		{
+			for (int cnt = 0; cnt < 16; cnt++)
+				hash[cnt] ^= data_ptr[block * 16 + cnt];
+			ghash_multiply(hash);
+		}
+	}
+
+	// A partial last block is padded with zeros
+	int remaining = size - num_blocks * 16;
+	if (remaining > 0)
+	{
+		unsigned char block[16] = { 0 };
+		memcpy(block, data_ptr + num_blocks * 16, remaining);
+		ghash_add(hash, block, 16);
+	}
+}
+
+void AES_GCM::calculate_tag(const unsigned char iv[iv_size], const void *aad, int aad_size, const void *ciphertext, int size, unsigned char out_tag[tag_size])
+{
+	unsigned char hash[16] = { 0 };
+	ghash_add(hash, aad, aad_size);
+	ghash_add(hash, ciphertext, size);
+
+	unsigned char lengths[16];
+	ubyte64 aad_bits = ((ubyte64) aad_size) * 8;
+	ubyte64 data_bits = ((ubyte64) size) * 8;
+	for (int cnt = 7; cnt >= 0; cnt--)
+	{
+		lengths[cnt] = (unsigned char) aad_bits;
+		lengths[cnt + 8] = (unsigned char) data_bits;
+		aad_bits >>= 8;
+		data_bits >>= 8;
+	}
+	ghash_add(hash, lengths, 16);
+
+	unsigned char counter[16];
+	memcpy(counter, iv, iv_size);
+	counter[12] = 0; counter[13] = 0; counter[14] = 0; counter[15] = 1;
+	encrypt_block(counter, out_tag);
+	for (int cnt = 0; cnt < tag_size; cnt++)
+		out_tag[cnt] ^= hash[cnt];
+}
+
+}
@@ -0,0 +1,107 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Magnus Norddahl
+*/
+
+#pragma once
+
+#include "API/Core/System/cl_platform.h"
+#include "API/Core/System/databuffer.h"
+#include "aes_impl.h"
+
+namespace clan
+{
+
+/// \brief AES in Galois/Counter Mode (NIST SP 800-38D), as used by the TLS AES-GCM cipher suites
+///
+/// Data is encrypted and decrypted in place, in a single call per message.
+/// The AES-NI and PCLMULQDQ instructions are used when available.
+class AES_GCM : public AES_Impl
+{
+/// \name Construction
+/// \{
+
+public:
+	AES_GCM();
+	~AES_GCM();
+
+/// \}
+/// \name Attributes
+/// \{
+
+public:
+	static const int iv_size = 12;
+	static const int tag_size = 16;
+
+/// \}
+/// \name Operations
+/// \{
+
+public:
+	/// \brief Sets the cipher key
+	///
+	/// \param key_length = 16 for AES-128 or 32 for AES-256
+	void set_key(const unsigned char *key, int key_length);
+
+	/// \brief Encrypts data in place and calculates the authentication tag
+	///
+	/// \param aad = Additional data that is authenticated, but not encrypted
+	void encrypt(const unsigned char iv[iv_size], const void *aad, int aad_size, void *data, int size, unsigned char out_tag[tag_size]);
+
+	/// \brief Checks the authentication tag and decrypts data in place
+	///
+	/// \return false if the tag did not match. The data is left encrypted in that case.
+	bool decrypt(const unsigned char iv[iv_size], const void *aad, int aad_size, void *data, int size, const unsigned char tag[tag_size]);
+
+/// \}
+/// \name Implementation
+/// \{
+
+private:
+	void encrypt_block(const unsigned char input[16], unsigned char output[16]);
+	void crypt_ctr(unsigned char counter[16], unsigned char *data, int size);
+	void ghash_create_table(const unsigned char hash_key[16]);
+	void ghash_multiply(unsigned char hash[16]);
+	void ghash_add(unsigned char hash[16], const void *data, int size);
+	void calculate_tag(const unsigned char iv[iv_size], const void *aad, int aad_size, const void *ciphertext, int size, unsigned char out_tag[tag_size]);
+
+	int num_rounds;
+	bool cipher_key_set;
+	bool use_pclmul;
+
+	ubyte32 key_expanded[aes256_nb_mult_nr_plus1];
+	unsigned char round_keys[aes256_nb_mult_nr_plus1 * 4];
+
+	/// \brief H, H^2, H^3 and H^4 for the PCLMULQDQ path
+	unsigned char ghash_keys[64];
+
+	/// \brief Multiples of H for the 4 bit table driven portable path
+	ubyte64 ghash_table_high[16];
+	ubyte64 ghash_table_low[16];
+/// \}
+};
+
+}
@@ -31,6 +31,7 @@
 #include "API/Core/System/cl_platform.h"
 #include "API/Core/System/databuffer.h"
 #include "API/Core/Math/cl_math.h"
+#include "API/Core/Crypto/crypto_acceleration.h"
 #include "aes_impl.h"
 
 #ifndef WIN32
@@ -45,6 +46,8 @@ namespace clan
 
 AES_Impl::AES_Impl()
 {
+	use_aes_ni = CryptoAcceleration::is_enabled() && CryptoAcceleration::is_aes_supported();
+
 	if (!is_tables_created)
 	{
 		create_tables();
@@ -173,16 +176,7 @@ void AES_Impl::store_block(ubyte32 s0, ubyte32 s1, ubyte32 s2, ubyte32 s3, DataB
 	// (Note AES 128, 192 and 256 all have the same block size)
 
 	// Store the data
-	int current_size = databuffer.get_size();
-	int current_capacity = databuffer.get_capacity();
-	int available = current_capacity - current_size;
-	if (available < aes128_block_size_bytes)	// Increase capacity required
-	{
-		databuffer.set_capacity(current_capacity + 1024);	// Increase in blocks of 1K
-	}
-	databuffer.set_size(current_size + aes128_block_size_bytes);
-	unsigned char *dest_ptr = (unsigned char *) databuffer.get_data();
-	dest_ptr += current_size;
+	unsigned char *dest_ptr = append_blocks(databuffer, 1);
 
 	put_word(s0, dest_ptr);
 	put_word(s1, dest_ptr+4);
@@ -190,6 +184,28 @@ void AES_Impl::store_block(ubyte32 s0, ubyte32 s1, ubyte32 s2, ubyte32 s3, DataB
 	put_word(s3, dest_ptr+12);
 }
 
+void AES_Impl::store_round_keys(const ubyte32 *key_expanded, int num_rounds, unsigned char *out_round_keys)
+{
+	for (int cnt = 0; cnt < (num_rounds + 1) * 4; cnt++)
+	{
+		put_word(key_expanded[cnt], out_round_keys + cnt * 4);
+	}
+}
+
+unsigned char *AES_Impl::append_blocks(DataBuffer &databuffer, int num_blocks)
+{
+	int current_size = databuffer.get_size();
+	int current_capacity = databuffer.get_capacity();
+	int required_size = current_size + num_blocks * aes128_block_size_bytes;
+	if (required_size > current_capacity)	// Increase capacity required
+	{
+		// Grow geometrically, so large messages are not copied once per kilobyte
+		databuffer.set_capacity(max(required_size, current_capacity * 2 + 1024));
+	}
+	databuffer.set_size(required_size);
+	return (unsigned char *) databuffer.get_data() + current_size;
+}
+
 void AES_Impl::extract_decrypt_key(ubyte32 *key_expanded, int num_rounds)
 {
 	// Invert the order of the round keys
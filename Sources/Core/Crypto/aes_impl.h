@@ -79,6 +79,9 @@ public:
 	static ubyte32 table_d1[256];
 	static ubyte32 table_d2[256];
 	static ubyte32 table_d3[256];
+
+	/// \brief True when blocks are processed with the AES-NI instructions
+	bool use_aes_ni;
 /// \}
 /// \name Operations
 /// \{
@@ -90,6 +93,12 @@ public:
 	void extract_decrypt_key(ubyte32 *key_expanded, int num_rounds);
 	void store_block(ubyte32 s0, ubyte32 s1, ubyte32 s2, ubyte32 s3, DataBuffer &databuffer);
 
+	/// \brief Converts the expanded key to the round key layout used by AES_NI
+	void store_round_keys(const ubyte32 *key_expanded, int num_rounds, unsigned char *out_round_keys);
+
+	/// \brief Grows the databuffer by a number of blocks, returning a pointer to the first new block
+	static unsigned char *append_blocks(DataBuffer &databuffer, int num_blocks);
+
 	inline ubyte32 get_word(const unsigned char *data) const
 	{
 		return ( (data[0] << 24) | (data[1] << 16) | (data[2] << 8) | (data[3]) );
@@ -0,0 +1,333 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Magnus Norddahl
+*/
+
+#include "Core/precomp.h"
+#include "API/Core/System/cl_platform.h"
+#include "aes_ni.h"
+
+#ifndef ARM_PLATFORM
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#include <wmmintrin.h>
+#endif
+
+#if defined(__GNUC__) && !defined(ARM_PLATFORM)
+#define CL_AES_NI_TARGET __attribute__((target("aes,sse2")))
+#define CL_PCLMUL_TARGET __attribute__((target("pclmul,sse2,ssse3")))
+#else
+#define CL_AES_NI_TARGET
+#define CL_PCLMUL_TARGET
+#endif
+
+namespace clan
+{
+
+#ifndef ARM_PLATFORM
+
+CL_AES_NI_TARGET void AES_NI::encrypt_cbc(const unsigned char *round_keys, int num_rounds, unsigned char iv[16], const unsigned char *input, unsigned char *output, int num_blocks)
+{
+	__m128i keys[15];
+	for (int i = 0; i <= num_rounds; i++)
+		keys[i] = _mm_loadu_si128((const __m128i *) (round_keys + i * 16));
+
+	// Each block depends on the previous one, so there is nothing to interleave
+	__m128i feedback = _mm_loadu_si128((const __m128i *) iv);
+	for (int block = 0; block < num_blocks; block++)
+	{
+		feedback = _mm_xor_si128(feedback, _mm_loadu_si128((const __m128i *) (input + block * 16)));
+		feedback = _mm_xor_si128(feedback, keys[0]);
+		for (int i = 1; i < num_rounds; i++)
+			feedback = _mm_aesenc_si128(feedback, keys[i]);
+		feedback = _mm_aesenclast_si128(feedback, keys[num_rounds]);
+		_mm_storeu_si128((__m128i *) (output + block * 16), feedback);
+	}
+	_mm_storeu_si128((__m128i *) iv, feedback);
+}
+
+CL_AES_NI_TARGET void AES_NI::decrypt_cbc(const unsigned char *round_keys, int num_rounds, unsigned char iv[16], const unsigned char *input, unsigned char *output, int num_blocks)
+{
+	__m128i keys[15];
+	for (int i = 0; i <= num_rounds; i++)
+		keys[i] = _mm_loadu_si128((const __m128i *) (round_keys + i * 16));
+
+	__m128i feedback = _mm_loadu_si128((const __m128i *) iv);
+	int block = 0;
+	for (; block + 4 <= num_blocks; block += 4)
+	{
+		__m128i cipher0 = _mm_loadu_si128((const __m128i *) (input + block * 16));
+		__m128i cipher1 = _mm_loadu_si128((const __m128i *) (input + block * 16 + 16));
+		__m128i cipher2 = _mm_loadu_si128((const __m128i *) (input + block * 16 + 32));
+		__m128i cipher3 = _mm_loadu_si128((const __m128i *) (input + block * 16 + 48));
+
+		__m128i state0 = _mm_xor_si128(cipher0, keys[0]);
+		__m128i state1 = _mm_xor_si128(cipher1, keys[0]);
+		__m128i state2 = _mm_xor_si128(cipher2, keys[0]);
+		__m128i state3 = _mm_xor_si128(cipher3, keys[0]);
+		for (int i = 1; i < num_rounds; i++)
+		{
+			state0 = _mm_aesdec_si128(state0, keys[i]);
+			state1 = _mm_aesdec_si128(state1, keys[i]);
+			state2 = _mm_aesdec_si128(state2, keys[i]);
+			state3 = _mm_aesdec_si128(state3, keys[i]);
+		}
+		state0 = _mm_aesdeclast_si128(state0, keys[num_rounds]);
+		state1 = _mm_aesdeclast_si128(state1, keys[num_rounds]);
+		state2 = _mm_aesdeclast_si128(state2, keys[num_rounds]);
+		state3 = _mm_aesdeclast_si128(state3, keys[num_rounds]);
+
+		_mm_storeu_si128((__m128i *) (output + block * 16), _mm_xor_si128(state0, feedback));
+		_mm_storeu_si128((__m128i *) (output + block * 16 + 16), _mm_xor_si128(state1, cipher0));
+		_mm_storeu_si128((__m128i *) (output + block * 16 + 32), _mm_xor_si128(state2, cipher1));
+		_mm_storeu_si128((__m128i *) (output + block * 16 + 48), _mm_xor_si128(state3, cipher2));
+		feedback = cipher3;
+	}
+
+	for (; block < num_blocks; block++)
+	{
+		__m128i cipher = _mm_loadu_si128((const __m128i *) (input + block * 16));
+		__m128i state = _mm_xor_si128(cipher, keys[0]);
+		for (int i = 1; i < num_rounds; i++)
+			state = _mm_aesdec_si128(state, keys[i]);
+		state = _mm_aesdeclast_si128(state, keys[num_rounds]);
+		_mm_storeu_si128((__m128i *) (output + block * 16), _mm_xor_si128(state, feedback));
+		feedback = cipher;
+	}
+	_mm_storeu_si128((__m128i *) iv, feedback);
+}
+
+static inline ubyte32 counter_to_big_endian(ubyte32 value)
+{
+	return (value >> 24) | ((value >> 8) & 0xff00) | ((value << 8) & 0xff0000) | (value << 24);
+}
+
+CL_AES_NI_TARGET void AES_NI::crypt_ctr32(const unsigned char *round_keys, int num_rounds, unsigned char counter[16], const unsigned char *input, unsigned char *output, int size)
+{
+	__m128i keys[15];
+	for (int i = 0; i <= num_rounds; i++)
+		keys[i] = _mm_loadu_si128((const __m128i *) (round_keys + i * 16));
+
+	// The first 12 bytes of the counter block never change, only the big endian 32 bit counter in the last 4 bytes
+	int nonce[3];
+	memcpy(nonce, counter, 12);
+	ubyte32 count = (counter[12] << 24) | (counter[13] << 16) | (counter[14] << 8) | counter[15];
+
+	int pos = 0;
+	for (; pos + 64 <= size; pos += 64)
+	{
+		__m128i state0 = _mm_xor_si128(_mm_set_epi32(counter_to_big_endian(count), nonce[2], nonce[1], nonce[0]), keys[0]);
+		__m128i state1 = _mm_xor_si128(_mm_set_epi32(counter_to_big_endian(count + 1), nonce[2], nonce[1], nonce[0]), keys[0]);
+		__m128i state2 = _mm_xor_si128(_mm_set_epi32(counter_to_big_endian(count + 2), nonce[2], nonce[1], nonce[0]), keys[0]);
+		__m128i state3 = _mm_xor_si128(_mm_set_epi32(counter_to_big_endian(count + 3), nonce[2], nonce[1], nonce[0]), keys[0]);
+		count += 4;
+		for (int i = 1; i < num_rounds; i++)
+		{
+			state0 = _mm_aesenc_si128(state0, keys[i]);
+			state1 = _mm_aesenc_si128(state1, keys[i]);
+			state2 = _mm_aesenc_si128(state2, keys[i]);
+			state3 = _mm_aesenc_si128(state3, keys[i]);
+		}
+		state0 = _mm_aesenclast_si128(state0, keys[num_rounds]);
+		state1 = _mm_aesenclast_si128(state1, keys[num_rounds]);
+		state2 = _mm_aesenclast_si128(state2, keys[num_rounds]);
+		state3 = _mm_aesenclast_si128(state3, keys[num_rounds]);
+
+		_mm_storeu_si128((__m128i *) (output + pos), _mm_xor_si128(state0, _mm_loadu_si128((const __m128i *) (input + pos))));
+		_mm_storeu_si128((__m128i *) (output + pos + 16), _mm_xor_si128(state1, _mm_loadu_si128((const __m128i *) (input + pos + 16))));
+		_mm_storeu_si128((__m128i *) (output + pos + 32), _mm_xor_si128(state2, _mm_loadu_si128((const __m128i *) (input + pos + 32))));
+		_mm_storeu_si128((__m128i *) (output + pos + 48), _mm_xor_si128(state3, _mm_loadu_si128((const __m128i *) (input + pos + 48))));
+	}
+
+	for (; pos < size; pos += 16)
+	{
+		__m128i state = _mm_xor_si128(_mm_set_epi32(counter_to_big_endian(count), nonce[2], nonce[1], nonce[0]), keys[0]);
+		count++;
+		for (int i = 1; i < num_rounds; i++)
+			state = _mm_aesenc_si128(state, keys[i]);
+		state = _mm_aesenclast_si128(state, keys[num_rounds]);
+
+		if (pos + 16 <= size)
+		{
+			_mm_storeu_si128((__m128i *) (output + pos), _mm_xor_si128(state, _mm_loadu_si128((const __m128i *) (input + pos))));
+		}
+		else
+		{
+			unsigned char key_stream[16];
+			_mm_storeu_si128((__m128i *) key_stream, state);
+			for (int i = 0; pos + i < size; i++)
+				output[pos + i] = input[pos + i] ^ key_stream[i];
+		}
+	}
+
+	counter[12] = count >> 24;
+	counter[13] = count >> 16;
+	counter[14] = count >> 8;
+	counter[15] = count;
+}
+
+// GHASH works on bit reflected values. Byte swapping the blocks lets the multiplication below
+// follow the Intel carry-less multiplication white paper (algorithm 5, with the reduction deferred).
+
+CL_PCLMUL_TARGET static inline __m128i ghash_byte_swap(__m128i value)
+{
+	return _mm_shuffle_epi8(value, _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+}
+
+/// \brief Unreduced 256 bit carry-less product of a and b, added to low and high
+CL_PCLMUL_TARGET static inline void ghash_multiply_add(__m128i a, __m128i b, __m128i &low, __m128i &middle, __m128i &high)
+{
+	low = _mm_xor_si128(low, _mm_clmulepi64_si128(a, b, 0x00));
+	middle = _mm_xor_si128(middle, _mm_clmulepi64_si128(a, b, 0x10));
+	middle = _mm_xor_si128(middle, _mm_clmulepi64_si128(a, b, 0x01));
+	high = _mm_xor_si128(high, _mm_clmulepi64_si128(a, b, 0x11));
+}
+
+/// \brief Reduces a 256 bit product modulo the GCM polynomial
+CL_PCLMUL_TARGET static inline __m128i ghash_reduce(__m128i low, __m128i middle, __m128i high)
+{
+	low = _mm_xor_si128(low, _mm_slli_si128(middle, 8));
+	high = _mm_xor_si128(high, _mm_srli_si128(middle, 8));
+
+	// Shift the product left by one bit, as the operands are bit reflected
+	__m128i carry_low = _mm_srli_epi32(low, 31);
+	__m128i carry_high = _mm_srli_epi32(high, 31);
+	low = _mm_slli_epi32(low, 1);
+	high = _mm_slli_epi32(high, 1);
+	__m128i carry_between = _mm_srli_si128(carry_low, 12);
+	carry_high = _mm_slli_si128(carry_high, 4);
+	carry_low = _mm_slli_si128(carry_low, 4);
+	low = _mm_or_si128(low, carry_low);
+	high = _mm_or_si128(high, carry_high);
+	high = _mm_or_si128(high, carry_between);
+
+	// Reduce by x^128 + x^7 + x^2 + x + 1
+	__m128i a = _mm_slli_epi32(low, 31);
+	__m128i b = _mm_slli_epi32(low, 30);
+	__m128i c = _mm_slli_epi32(low, 25);
+	a = _mm_xor_si128(a, b);
+	a = _mm_xor_si128(a, c);
+	b = _mm_srli_si128(a, 4);
+	a = _mm_slli_si128(a, 12);
+	low = _mm_xor_si128(low, a);
+
+	__m128i d = _mm_srli_epi32(low, 1);
+	__m128i e = _mm_srli_epi32(low, 2);
+	__m128i f = _mm_srli_epi32(low, 7);
+	d = _mm_xor_si128(d, e);
+	d = _mm_xor_si128(d, f);
+	d = _mm_xor_si128(d, b);
+	low = _mm_xor_si128(low, d);
+	return _mm_xor_si128(high, low);
+}
+
+CL_PCLMUL_TARGET static inline __m128i ghash_multiply(__m128i a, __m128i b)
+{
+	__m128i low = _mm_setzero_si128();
+	__m128i middle = _mm_setzero_si128();
+	__m128i high = _mm_setzero_si128();
+	ghash_multiply_add(a, b, low, middle, high);
+	return ghash_reduce(low, middle, high);
+}
+
+CL_PCLMUL_TARGET void AES_NI::create_ghash_keys(const unsigned char hash_key[16], unsigned char out_hash_keys[64])
+{
+	__m128i h1 = ghash_byte_swap(_mm_loadu_si128((const __m128i *) hash_key));
+	__m128i h2 = ghash_multiply(h1, h1);
+	__m128i h3 = ghash_multiply(h2, h1);
+	__m128i h4 = ghash_multiply(h3, h1);
+	_mm_storeu_si128((__m128i *) out_hash_keys, h1);
+	_mm_storeu_si128((__m128i *) (out_hash_keys + 16), h2);
+	_mm_storeu_si128((__m128i *) (out_hash_keys + 32), h3);
+	_mm_storeu_si128((__m128i *) (out_hash_keys + 48), h4);
+}
+
+CL_PCLMUL_TARGET void AES_NI::ghash(const unsigned char hash_keys[64], unsigned char hash[16], const unsigned char *data, int num_blocks)
+{
+	__m128i h1 = _mm_loadu_si128((const __m128i *) hash_keys);
+	__m128i h2 = _mm_loadu_si128((const __m128i *) (hash_keys + 16));
+	__m128i h3 = _mm_loadu_si128((const __m128i *) (hash_keys + 32));
+	__m128i h4 = _mm_loadu_si128((const __m128i *) (hash_keys + 48));
+	__m128i y = ghash_byte_swap(_mm_loadu_si128((const __m128i *) hash));
+
+	int block = 0;
+	for (; block + 4 <= num_blocks; block += 4)
+	{
+		// Y' = (Y + X1)*H^4 + X2*H^3 + X3*H^2 + X4*H, with a single reduction
+		__m128i x1 = ghash_byte_swap(_mm_loadu_si128((const __m128i *) (data + block * 16)));
+		__m128i x2 = ghash_byte_swap(_mm_loadu_si128((const __m128i *) (data + block * 16 + 16)));
+		__m128i x3 = ghash_byte_swap(_mm_loadu_si128((const __m128i *) (data + block * 16 + 32)));
+		__m128i x4 = ghash_byte_swap(_mm_loadu_si128((const __m128i *) (data + block * 16 + 48)));
+
+		__m128i low = _mm_setzero_si128();
+		__m128i middle = _mm_setzero_si128();
+		__m128i high = _mm_setzero_si128();
+		ghash_multiply_add(_mm_xor_si128(y, x1), h4, low, middle, high);
+		ghash_multiply_add(x2, h3, low, middle, high);
+		ghash_multiply_add(x3, h2, low, middle, high);
+		ghash_multiply_add(x4, h1, low, middle, high);
+		y = ghash_reduce(low, middle, high);
+	}
+
+	for (; block < num_blocks; block++)
+	{
+		__m128i x = ghash_byte_swap(_mm_loadu_si128((const __m128i *) (data + block * 16)));
+		y = ghash_multiply(_mm_xor_si128(y, x), h1);
+	}
+
+	_mm_storeu_si128((__m128i *) hash, ghash_byte_swap(y));
+}
+
+#else
+
+void AES_NI::encrypt_cbc(const unsigned char *round_keys, int num_rounds, unsigned char iv[16], const unsigned char *input, unsigned char *output, int num_blocks)
+{
+	throw Exception("AES-NI is not available on this platform");
+}
+
+void AES_NI::decrypt_cbc(const unsigned char *round_keys, int num_rounds, unsigned char iv[16], const unsigned char *input, unsigned char *output, int num_blocks)
+{
+	throw Exception("AES-NI is not available on this platform");
+}
+
+void AES_NI::crypt_ctr32(const unsigned char *round_keys, int num_rounds, unsigned char counter[16], const unsigned char *input, unsigned char *output, int size)
+{
+	throw Exception("AES-NI is not available on this platform");
+}
+
+void AES_NI::create_ghash_keys(const unsigned char hash_key[16], unsigned char out_hash_keys[64])
+{
+	throw Exception("PCLMULQDQ is not available on this platform");
+}
+
+void AES_NI::ghash(const unsigned char hash_keys[64], unsigned char hash[16], const unsigned char *data, int num_blocks)
+{
+	throw Exception("PCLMULQDQ is not available on this platform");
+}
+
+#endif
+
+}
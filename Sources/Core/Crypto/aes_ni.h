@@ -0,0 +1,74 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Magnus Norddahl
+*/
+
+#pragma once
+
+namespace clan
+{
+
+/// \brief AES using the AES-NI instructions
+///
+/// Round keys are stored in the byte order the instructions use, 16 bytes per round.
+/// Only call these functions if CryptoAcceleration::is_aes_supported() returns true.
+class AES_NI
+{
+public:
+	/// \brief Encrypts blocks in cipher block chaining mode
+	///
+	/// \param round_keys = Encryption round keys
+	/// \param iv = Initialisation vector. Updated to the last encrypted block.
+	static void encrypt_cbc(const unsigned char *round_keys, int num_rounds, unsigned char iv[16], const unsigned char *input, unsigned char *output, int num_blocks);
+
+	/// \brief Decrypts blocks in cipher block chaining mode
+	///
+	/// Blocks are decrypted four at a time, as they do not depend on each other.
+	/// \param round_keys = Decryption round keys, as made by the equivalent inverse cipher
+	/// \param iv = Initialisation vector. Updated to the last encrypted block.
+	static void decrypt_cbc(const unsigned char *round_keys, int num_rounds, unsigned char iv[16], const unsigned char *input, unsigned char *output, int num_blocks);
+
+	/// \brief Encrypts or decrypts in counter mode, incrementing the last 32 bits of the counter block
+	///
+	/// The data may end with a partial block.
+	/// \param counter = Counter block for the first block of data. Updated to the block following the last one used.
+	static void crypt_ctr32(const unsigned char *round_keys, int num_rounds, unsigned char counter[16], const unsigned char *input, unsigned char *output, int size);
+
+	/// \brief Calculates the powers of the GHASH key used by ghash()
+	///
+	/// Only call this if CryptoAcceleration::is_pclmul_supported() also returns true.
+	/// \param hash_key = H, the encrypted zero block
+	/// \param out_hash_keys = H, H^2, H^3 and H^4, 16 bytes each
+	static void create_ghash_keys(const unsigned char hash_key[16], unsigned char out_hash_keys[64]);
+
+	/// \brief Adds whole blocks to a GHASH using carry-less multiplication (PCLMULQDQ)
+	///
+	/// \param hash_keys = As made by create_ghash_keys()
+	/// \param hash = Running hash value
+	static void ghash(const unsigned char hash_keys[64], unsigned char hash[16], const unsigned char *data, int num_blocks);
+};
+
+}
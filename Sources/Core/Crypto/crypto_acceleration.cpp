@@ -0,0 +1,84 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Magnus Norddahl
+*/
+
+#include "Core/precomp.h"
+#include "API/Core/Crypto/crypto_acceleration.h"
+#include "API/Core/System/system.h"
+
+namespace clan
+{
+
+static bool crypto_acceleration_enabled = true;
+
+/////////////////////////////////////////////////////////////////////////////
+// CryptoAcceleration Attributes:
+
+bool CryptoAcceleration::is_aes_supported()
+{
+#ifdef ARM_PLATFORM
+	return false;
+#else
+	static bool supported = System::detect_cpu_extension(System::aes);
+	return supported;
+#endif
+}
+
+bool CryptoAcceleration::is_sha_supported()
+{
+#ifdef ARM_PLATFORM
+	return false;
+#else
+	static bool supported = System::detect_cpu_extension(System::sha) && System::detect_cpu_extension(System::sse4_1);
+	return supported;
+#endif
+}
+
+bool CryptoAcceleration::is_pclmul_supported()
+{
+#ifdef ARM_PLATFORM
+	return false;
+#else
+	static bool supported = System::detect_cpu_extension(System::pclmul) && System::detect_cpu_extension(System::ssse3);
+	return supported;
+#endif
+}
+
+bool CryptoAcceleration::is_enabled()
+{
+	return crypto_acceleration_enabled;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// CryptoAcceleration Operations:
+
+void CryptoAcceleration::set_enabled(bool enable)
+{
+	crypto_acceleration_enabled = enable;
+}
+
+}
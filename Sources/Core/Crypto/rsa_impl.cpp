@@ -223,6 +223,29 @@ void RSA_Impl::rsadp(BigInt *cipher, const BigInt *d, const BigInt *modulus, Big
 	cipher->exptmod(d, modulus, msg);
 }
 
+void RSA_Impl::rsadp_crt(BigInt *cipher, const RSAPrivateKey &key, BigInt *msg)
+{
+	// Insure that ciphertext representative is in range of modulus
+	if((cipher->cmp_z() < 0) || (cipher->cmp(&key.modulus) >= 0))
+	{
+		throw Exception("ciphertext is out of range of modulus");
+	}
+
+	// Two exponentiations with half size numbers, see PKCS#1 v2.1 section 5.1.2
+	// m1 = c^dP mod p, m2 = c^dQ mod q
+	BigInt m1, m2;
+	cipher->exptmod(&key.exponent1, &key.prime1, &m1);
+	cipher->exptmod(&key.exponent2, &key.prime2, &m2);
+
+	// h = (m1 - m2) * qInv mod p
+	BigInt h = m1 - m2;
+	h = h * key.coefficient;
+	h.mod(&key.prime1, &h);
+
+	// m = m2 + q * h
+	*msg = m2 + h * key.prime2;
+}
+
 void RSA_Impl::pkcs1v15_encode(int block_type, Random &random, const char *msg, int mlen, char *emsg, int emlen)
 {
 	if(mlen > emlen - 11)
@@ -308,8 +331,26 @@ DataBuffer RSA_Impl::pkcs1v15_encrypt(int block_type, Random &random, const char
 	// Now, encrypt...
 	rsaep(&mrep, e, modulus, &mrep);
 
-	// Unpack message representative...
-	DataBuffer buffer(mrep.unsigned_octet_size());
+	// Unpack message representative, to the length of the modulus (I2OSP in PKCS#1)
+	DataBuffer buffer(k);
+	mrep.to_unsigned_octets((unsigned char *) buffer.get_data(), buffer.get_size());
+	return buffer;
+}
+
+DataBuffer RSA_Impl::pkcs1v15_encrypt(int block_type, Random &random, const char *msg, int mlen, const RSAPrivateKey &key)
+{
+	int k = key.modulus.unsigned_octet_size();	// length of modulus, in bytes
+
+	Secret key_buffer(k);
+	pkcs1v15_encode(block_type, random, msg, mlen, (char *) key_buffer.get_data(), k);
+
+	BigInt mrep;
+	mrep.read_unsigned_octets(key_buffer.get_data(), key_buffer.get_size());
+
+	// Encrypting with the private key is the decryption primitive
+	rsadp_crt(&mrep, key, &mrep);
+
+	DataBuffer buffer(k);
 	mrep.to_unsigned_octets((unsigned char *) buffer.get_data(), buffer.get_size());
 	return buffer;
 }
@@ -335,6 +376,31 @@ Secret RSA_Impl::pkcs1v15_decrypt(const char *msg, int mlen, const BigInt *d, co
 	return pkcs1v15_decode( (char *) key_buffer.get_data(), k);
 }
 
+Secret RSA_Impl::pkcs1v15_decrypt(const char *msg, int mlen, const RSAPrivateKey &key)
+{
+	int k = key.modulus.unsigned_octet_size();		// size of modulus, in bytes
+	if(mlen != k)
+		throw Exception("Invalid message length");
+
+	// Convert ciphertext to integer representative
+	BigInt  mrep;
+	mrep.read_unsigned_octets((const unsigned char *) msg, mlen);
+
+	// Decrypt ...
+	rsadp_crt(&mrep, key, &mrep);
+
+	Secret key_buffer(k);
+	mrep.to_unsigned_octets(key_buffer.get_data(), k);
+	return pkcs1v15_decode( (char *) key_buffer.get_data(), k);
+}
+
+Secret RSA_Impl::to_secret(const BigInt &value)
+{
+	Secret secret(value.unsigned_octet_size());
+	value.to_unsigned_octets(secret.get_data(), secret.get_size());
+	return secret;
+}
+
 DataBuffer RSA_Impl::encrypt(int block_type, Random &random, const void *in_public_exponent, unsigned int in_public_exponent_size, const void *in_modulus, unsigned int in_modulus_size, const void *in_data, unsigned int in_data_size)
 {
 	BigInt exponent;
@@ -357,6 +423,35 @@ Secret RSA_Impl::decrypt(const Secret &in_private_exponent, const void *in_modul
 	return pkcs1v15_decrypt((const char *) in_data, in_data_size, &exponent, &modulus);
 }
 
+void RSA_Impl::read_crt_key(const Secret &in_prime1, const Secret &in_prime2, const Secret &in_exponent1, const Secret &in_exponent2, const Secret &in_coefficient, const void *in_modulus, unsigned int in_modulus_size, RSAPrivateKey &out_key)
+{
+	out_key.prime1.read_unsigned_octets(in_prime1.get_data(), in_prime1.get_size());
+	out_key.prime2.read_unsigned_octets(in_prime2.get_data(), in_prime2.get_size());
+	out_key.exponent1.read_unsigned_octets(in_exponent1.get_data(), in_exponent1.get_size());
+	out_key.exponent2.read_unsigned_octets(in_exponent2.get_data(), in_exponent2.get_size());
+	out_key.coefficient.read_unsigned_octets(in_coefficient.get_data(), in_coefficient.get_size());
+	out_key.modulus.read_unsigned_octets((const unsigned char *) in_modulus, in_modulus_size);
+
+	if (out_key.prime1.cmp(&out_key.prime2) == 0 || (out_key.prime1 * out_key.prime2).cmp(&out_key.modulus) != 0)
+		throw Exception("The primes do not match the modulus");
+	if (out_key.coefficient.cmp(&out_key.prime1) >= 0)
+		throw Exception("The coefficient is out of range of the first prime");
+}
+
+DataBuffer RSA_Impl::encrypt(int block_type, Random &random, const Secret &in_prime1, const Secret &in_prime2, const Secret &in_exponent1, const Secret &in_exponent2, const Secret &in_coefficient, const void *in_modulus, unsigned int in_modulus_size, const void *in_data, unsigned int in_data_size)
+{
+	RSAPrivateKey key;
+	read_crt_key(in_prime1, in_prime2, in_exponent1, in_exponent2, in_coefficient, in_modulus, in_modulus_size, key);
+	return pkcs1v15_encrypt(block_type, random, (const char *) in_data, in_data_size, key);
+}
+
+Secret RSA_Impl::decrypt(const Secret &in_prime1, const Secret &in_prime2, const Secret &in_exponent1, const Secret &in_exponent2, const Secret &in_coefficient, const void *in_modulus, unsigned int in_modulus_size, const void *in_data, unsigned int in_data_size)
+{
+	RSAPrivateKey key;
+	read_crt_key(in_prime1, in_prime2, in_exponent1, in_exponent2, in_coefficient, in_modulus, in_modulus_size, key);
+	return pkcs1v15_decrypt((const char *) in_data, in_data_size, key);
+}
+
 void RSA_Impl::create_keypair(Random &random, Secret &out_private_exponent, DataBuffer &out_public_exponent, DataBuffer &out_modulus, int key_size_in_bits, int public_exponent_value)
 {
 	create(random, key_size_in_bits, public_exponent_value);
@@ -371,4 +466,14 @@ void RSA_Impl::create_keypair(Random &random, Secret &out_private_exponent, Data
 
 }
 
+void RSA_Impl::create_keypair(Random &random, Secret &out_private_exponent, DataBuffer &out_public_exponent, DataBuffer &out_modulus, Secret &out_prime1, Secret &out_prime2, Secret &out_exponent1, Secret &out_exponent2, Secret &out_coefficient, int key_size_in_bits, int public_exponent_value)
+{
+	create_keypair(random, out_private_exponent, out_public_exponent, out_modulus, key_size_in_bits, public_exponent_value);
+	out_prime1 = to_secret(rsa_private_key.prime1);
+	out_prime2 = to_secret(rsa_private_key.prime2);
+	out_exponent1 = to_secret(rsa_private_key.exponent1);
+	out_exponent2 = to_secret(rsa_private_key.exponent2);
+	out_coefficient = to_secret(rsa_private_key.coefficient);
+}
+
 }
@@ -84,6 +84,8 @@ public:
 
 	static DataBuffer encrypt(int block_type, Random &random, const void *in_public_exponent, unsigned int in_public_exponent_size, const void *in_modulus, unsigned int in_modulus_size, const void *in_data, unsigned int in_data_size);
 	static Secret decrypt(const Secret &in_private_exponent, const void *in_modulus, unsigned int in_modulus_size, const void *in_data, unsigned int in_data_size);
+	static DataBuffer encrypt(int block_type, Random &random, const Secret &in_prime1, const Secret &in_prime2, const Secret &in_exponent1, const Secret &in_exponent2, const Secret &in_coefficient, const void *in_modulus, unsigned int in_modulus_size, const void *in_data, unsigned int in_data_size);
+	static Secret decrypt(const Secret &in_prime1, const Secret &in_prime2, const Secret &in_exponent1, const Secret &in_exponent2, const Secret &in_coefficient, const void *in_modulus, unsigned int in_modulus_size, const void *in_data, unsigned int in_data_size);
 
 /// \}
 /// \name Operations
@@ -103,6 +105,9 @@ public:
 	/// \param public_exponent_value = public exponent value
 	void create_keypair(Random &random, Secret &out_private_exponent, DataBuffer &out_public_exponent, DataBuffer &out_modulus, int key_size_in_bits, int public_exponent_value);
 
+	/// \brief Create a keypair, also returning the Chinese remainder theorem parameters
+	void create_keypair(Random &random, Secret &out_private_exponent, DataBuffer &out_public_exponent, DataBuffer &out_modulus, Secret &out_prime1, Secret &out_prime2, Secret &out_exponent1, Secret &out_exponent2, Secret &out_coefficient, int key_size_in_bits, int public_exponent_value);
+
 /// \}
 /// \name Implementation
 /// \{
@@ -114,6 +119,12 @@ private:
 	static void rsaep(BigInt *msg, const BigInt *e, const BigInt *modulus, BigInt *cipher);
 	static void rsadp(BigInt *cipher, const BigInt *d, const BigInt *modulus, BigInt *msg);
 
+	// Decryption primitive using the Chinese remainder theorem. The private key must contain the primes, exponents and coefficient.
+	static void rsadp_crt(BigInt *cipher, const RSAPrivateKey &key, BigInt *msg);
+
+	// Reads the Chinese remainder theorem parameters of a private key
+	static void read_crt_key(const Secret &in_prime1, const Secret &in_prime2, const Secret &in_exponent1, const Secret &in_exponent2, const Secret &in_coefficient, const void *in_modulus, unsigned int in_modulus_size, RSAPrivateKey &out_key);
+
 	// PKCS#1 v.1.5 message padding and encoding
 	// msg       - input message
 	// mlen      - length of input message, in bytes
@@ -134,6 +145,12 @@ private:
 	// modulus   - encryption key modulus
 	static DataBuffer pkcs1v15_encrypt(int block_type, Random &random, const char *msg, int mlen, const BigInt *e, const BigInt *modulus);
 
+	// Encrypt a message with the private key using RSA and PKCS#1 v.1.5 padding, with the Chinese remainder theorem
+	// msg       - input message
+	// mlen      - length of input message, in bytes
+	// key       - private key, including the primes
+	static DataBuffer pkcs1v15_encrypt(int block_type, Random &random, const char *msg, int mlen, const RSAPrivateKey &key);
+
 	// Decrypt a message using RSA and PKCS#1 v.1.5 padding
 	// msg       - input message (ciphertext)
 	// mlen      - length of input message, in bytes
@@ -141,6 +158,14 @@ private:
 	// modulus   - decryption key modulus
 	static Secret pkcs1v15_decrypt(const char *msg, int mlen, const BigInt *d, const BigInt *modulus);
 
+	// Decrypt a message using RSA and PKCS#1 v.1.5 padding, with the Chinese remainder theorem
+	// msg       - input message (ciphertext)
+	// mlen      - length of input message, in bytes
+	// key       - private key, including the primes
+	static Secret pkcs1v15_decrypt(const char *msg, int mlen, const RSAPrivateKey &key);
+
+	static Secret to_secret(const BigInt &value);
+
 	RSAPrivateKey rsa_private_key;
 /// \}
 };
@@ -28,8 +28,10 @@
 
 #include "Core/precomp.h"
 #include "sha1_impl.h"
+#include "sha_ni.h"
 
 #include "../../API/Core/Math/cl_math.h"
+#include "../../API/Core/Crypto/crypto_acceleration.h"
 #include "../../API/Core/Crypto/sha1.h"
 
 #ifndef WIN32
@@ -44,6 +46,7 @@ namespace clan
 
 SHA1_Impl::SHA1_Impl()
 {
+	use_sha_ni = CryptoAcceleration::is_enabled() && CryptoAcceleration::is_sha_supported();
 	reset();
 }
 
@@ -120,6 +123,14 @@ void SHA1_Impl::add(const void *_data, int size)
 	int pos = 0;
 	while (pos < size)
 	{
+		if (use_sha_ni && chunk_filled == 0 && size - pos >= block_size)
+		{
+			int num_blocks = (size - pos) / block_size;
+			process_blocks(data + pos, num_blocks);
+			pos += num_blocks * block_size;
+			continue;
+		}
+
 		int data_left = size - pos;
 		int buffer_space = block_size - chunk_filled;
 		int data_used = min(buffer_space, data_left);
@@ -223,6 +234,12 @@ void SHA1_Impl::calculate()
 
 void SHA1_Impl::process_chunk()
 {
+	if (use_sha_ni)
+	{
+		process_blocks(chunk, 1);
+		return;
+	}
+
 	int i;
 	unsigned int w[80];
 
@@ -283,4 +300,15 @@ void SHA1_Impl::process_chunk()
 	h4 += e;
 }
 
+void SHA1_Impl::process_blocks(const unsigned char *data, int num_blocks)
+{
+	ubyte32 state[5] = { h0, h1, h2, h3, h4 };
+	SHA_NI::sha1_process_blocks(state, data, num_blocks);
+	h0 = state[0];
+	h1 = state[1];
+	h2 = state[2];
+	h3 = state[3];
+	h4 = state[4];
+}
+
 }
@@ -73,6 +73,9 @@ public:
 private:
 	void process_chunk();
 
+	/// \brief Processes whole blocks with the SHA extensions
+	void process_blocks(const unsigned char *data, int num_blocks);
+
 	inline unsigned int leftrotate_uint32(unsigned int value, int shift) const
 	{
 		return (value << shift) + (value >> (32-shift));
@@ -90,6 +93,8 @@ private:
 
 	bool calculated;
 
+	bool use_sha_ni;
+
 	bool hmac_enabled;
 	unsigned char hmac_key_chunk[block_size];
 /// \}
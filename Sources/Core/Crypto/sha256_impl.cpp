@@ -29,8 +29,10 @@
 
 #include "Core/precomp.h"
 #include "sha256_impl.h"
+#include "sha_ni.h"
 
 #include "../../API/Core/Math/cl_math.h"
+#include "../../API/Core/Crypto/crypto_acceleration.h"
 #include "../../API/Core/Crypto/sha224.h"
 #include "../../API/Core/Crypto/sha256.h"
 
@@ -46,6 +48,7 @@ namespace clan
 
 SHA256_Impl::SHA256_Impl(cl_sha_type new_sha_type) : sha_type(new_sha_type)
 {
+	use_sha_ni = CryptoAcceleration::is_enabled() && CryptoAcceleration::is_sha_supported();
 	reset();
 }
 
@@ -171,6 +174,14 @@ void SHA256_Impl::add(const void *_data, int size)
 	int pos = 0;
 	while (pos < size)
 	{
+		if (use_sha_ni && chunk_filled == 0 && size - pos >= block_size)
+		{
+			int num_blocks = (size - pos) / block_size;
+			process_blocks(data + pos, num_blocks);
+			pos += num_blocks * block_size;
+			continue;
+		}
+
 		int data_left = size - pos;
 		int buffer_space = block_size - chunk_filled;
 		int data_used = min(buffer_space, data_left);
@@ -303,6 +314,12 @@ void SHA256_Impl::calculate()
 
 void SHA256_Impl::process_chunk()
 {
+	if (use_sha_ni)
+	{
+		process_blocks(chunk, 1);
+		return;
+	}
+
 	// Constants defined in FIPS 180-3, section 4.2.2
 	static const ubyte32 constant_K[64] = {
 		0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b,
@@ -372,4 +389,18 @@ void SHA256_Impl::process_chunk()
 	h7 += h;
 }
 
+void SHA256_Impl::process_blocks(const unsigned char *data, int num_blocks)
+{
+	ubyte32 state[8] = { h0, h1, h2, h3, h4, h5, h6, h7 };
+	SHA_NI::sha256_process_blocks(state, data, num_blocks);
+	h0 = state[0];
+	h1 = state[1];
+	h2 = state[2];
+	h3 = state[3];
+	h4 = state[4];
+	h5 = state[5];
+	h6 = state[6];
+	h7 = state[7];
+}
+
 }
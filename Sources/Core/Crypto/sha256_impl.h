@@ -103,6 +103,9 @@ private:
 
 	void process_chunk();
 
+	/// \brief Processes whole blocks with the SHA extensions
+	void process_blocks(const unsigned char *data, int num_blocks);
+
 	ubyte32 h0, h1, h2, h3, h4, h5, h6, h7;
 
 	const static int block_size = 64;
@@ -115,6 +118,8 @@ private:
 
 	bool calculated;
 
+	bool use_sha_ni;
+
 	cl_sha_type sha_type;
 	bool hmac_enabled;
 	unsigned char hmac_key_chunk[block_size];
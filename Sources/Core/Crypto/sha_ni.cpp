@@ -0,0 +1,192 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Magnus Norddahl
+*/
+
+#include "Core/precomp.h"
+#include "sha_ni.h"
+
+#ifndef ARM_PLATFORM
+#include <immintrin.h>
+#endif
+
+#if defined(__GNUC__) && !defined(ARM_PLATFORM)
+#define CL_SHA_NI_TARGET __attribute__((target("sha,sse4.1")))
+#else
+#define CL_SHA_NI_TARGET
+#endif
+
+namespace clan
+{
+
+#ifndef ARM_PLATFORM
+
+// Four SHA-1 rounds. m0 holds the message words of group i, m1 to m3 those of the following groups.
+// The E value alternates between e_current and e_next, as sha1nexte derives it from A of the previous group.
+#define CL_SHA1_GROUP(i, e_current, e_next, m0, m1, m2, m3) \
+	{ \
+		if (i == 0) e_current = _mm_add_epi32(e_current, m0); else e_current = _mm_sha1nexte_epu32(e_current, m0); \
+		e_next = abcd; \
+		if (i >= 3 && i < 19) m1 = _mm_sha1msg2_epu32(m1, m0); \
+		abcd = _mm_sha1rnds4_epu32(abcd, e_current, (i) / 5); \
+		if (i >= 1 && i < 17) m3 = _mm_sha1msg1_epu32(m3, m0); \
+		if (i >= 2 && i < 18) m2 = _mm_xor_si128(m2, m0); \
+	}
+
+CL_SHA_NI_TARGET void SHA_NI::sha1_process_blocks(ubyte32 state[5], const unsigned char *data, int num_blocks)
+{
+	const __m128i byte_swap = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+
+	__m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) state), 0x1b);
+	__m128i e0 = _mm_set_epi32(state[4], 0, 0, 0);
+	__m128i e1;
+
+	for (int block = 0; block < num_blocks; block++, data += 64)
+	{
+		__m128i abcd_save = abcd;
+		__m128i e0_save = e0;
+
+		__m128i msg0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) data), byte_swap);
+		__m128i msg1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (data + 16)), byte_swap);
+		__m128i msg2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (data + 32)), byte_swap);
+		__m128i msg3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (data + 48)), byte_swap);
+
+		CL_SHA1_GROUP(0, e0, e1, msg0, msg1, msg2, msg3);
+		CL_SHA1_GROUP(1, e1, e0, msg1, msg2, msg3, msg0);
+		CL_SHA1_GROUP(2, e0, e1, msg2, msg3, msg0, msg1);
+		CL_SHA1_GROUP(3, e1, e0, msg3, msg0, msg1, msg2);
+		CL_SHA1_GROUP(4, e0, e1, msg0, msg1, msg2, msg3);
+		CL_SHA1_GROUP(5, e1, e0, msg1, msg2, msg3, msg0);
+		CL_SHA1_GROUP(6, e0, e1, msg2, msg3, msg0, msg1);
+		CL_SHA1_GROUP(7, e1, e0, msg3, msg0, msg1, msg2);
+		CL_SHA1_GROUP(8, e0, e1, msg0, msg1, msg2, msg3);
+		CL_SHA1_GROUP(9, e1, e0, msg1, msg2, msg3, msg0);
+		CL_SHA1_GROUP(10, e0, e1, msg2, msg3, msg0, msg1);
+		CL_SHA1_GROUP(11, e1, e0, msg3, msg0, msg1, msg2);
+		CL_SHA1_GROUP(12, e0, e1, msg0, msg1, msg2, msg3);
+		CL_SHA1_GROUP(13, e1, e0, msg1, msg2, msg3, msg0);
+		CL_SHA1_GROUP(14, e0, e1, msg2, msg3, msg0, msg1);
+		CL_SHA1_GROUP(15, e1, e0, msg3, msg0, msg1, msg2);
+		CL_SHA1_GROUP(16, e0, e1, msg0, msg1, msg2, msg3);
+		CL_SHA1_GROUP(17, e1, e0, msg1, msg2, msg3, msg0);
+		CL_SHA1_GROUP(18, e0, e1, msg2, msg3, msg0, msg1);
+		CL_SHA1_GROUP(19, e1, e0, msg3, msg0, msg1, msg2);
+
+		e0 = _mm_sha1nexte_epu32(e0, e0_save);
+		abcd = _mm_add_epi32(abcd, abcd_save);
+	}
+
+	_mm_storeu_si128((__m128i *) state, _mm_shuffle_epi32(abcd, 0x1b));
+	state[4] = _mm_extract_epi32(e0, 3);
+}
+
+// Four SHA-256 rounds. m0 holds the message words of group i, m1 to m3 those of the following groups.
+#define CL_SHA256_GROUP(i, m0, m1, m2, m3) \
+	{ \
+		__m128i words = _mm_add_epi32(m0, _mm_loadu_si128((const __m128i *) (constant_K + (i) * 4))); \
+		state1 = _mm_sha256rnds2_epu32(state1, state0, words); \
+		if (i >= 3 && i < 15) m1 = _mm_sha256msg2_epu32(_mm_add_epi32(m1, _mm_alignr_epi8(m0, m3, 4)), m0); \
+		state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(words, 0x0e)); \
+		if (i >= 1 && i < 13) m3 = _mm_sha256msg1_epu32(m3, m0); \
+	}
+
+CL_SHA_NI_TARGET void SHA_NI::sha256_process_blocks(ubyte32 state[8], const unsigned char *data, int num_blocks)
+{
+	// Constants defined in FIPS 180-3, section 4.2.2
+	static const ubyte32 constant_K[64] = {
+		0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+		0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+		0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+		0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+		0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+		0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+		0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+		0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+	};
+
+	const __m128i byte_swap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+	// The instructions keep the state as ABEF and CDGH
+	__m128i temp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) state), 0xb1);
+	__m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) (state + 4)), 0x1b);
+	__m128i state0 = _mm_alignr_epi8(temp, state1, 8);
+	state1 = _mm_blend_epi16(state1, temp, 0xf0);
+
+	for (int block = 0; block < num_blocks; block++, data += 64)
+	{
+		__m128i abef_save = state0;
+		__m128i cdgh_save = state1;
+
+		__m128i msg0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) data), byte_swap);
+		__m128i msg1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (data + 16)), byte_swap);
+		__m128i msg2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (data + 32)), byte_swap);
+		__m128i msg3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (data + 48)), byte_swap);
+
+		CL_SHA256_GROUP(0, msg0, msg1, msg2, msg3);
+		CL_SHA256_GROUP(1, msg1, msg2, msg3, msg0);
+		CL_SHA256_GROUP(2, msg2, msg3, msg0, msg1);
+		CL_SHA256_GROUP(3, msg3, msg0, msg1, msg2);
+		CL_SHA256_GROUP(4, msg0, msg1, msg2, msg3);
+		CL_SHA256_GROUP(5, msg1, msg2, msg3, msg0);
+		CL_SHA256_GROUP(6, msg2, msg3, msg0, msg1);
+		CL_SHA256_GROUP(7, msg3, msg0, msg1, msg2);
+		CL_SHA256_GROUP(8, msg0, msg1, msg2, msg3);
+		CL_SHA256_GROUP(9, msg1, msg2, msg3, msg0);
+		CL_SHA256_GROUP(10, msg2, msg3, msg0, msg1);
+		CL_SHA256_GROUP(11, msg3, msg0, msg1, msg2);
+		CL_SHA256_GROUP(12, msg0, msg1, msg2, msg3);
+		CL_SHA256_GROUP(13, msg1, msg2, msg3, msg0);
+		CL_SHA256_GROUP(14, msg2, msg3, msg0, msg1);
+		CL_SHA256_GROUP(15, msg3, msg0, msg1, msg2);
+
+		state0 = _mm_add_epi32(state0, abef_save);
+		state1 = _mm_add_epi32(state1, cdgh_save);
+	}
+
+	temp = _mm_shuffle_epi32(state0, 0x1b);
+	state1 = _mm_shuffle_epi32(state1, 0xb1);
+	_mm_storeu_si128((__m128i *) state, _mm_blend_epi16(temp, state1, 0xf0));
+	_mm_storeu_si128((__m128i *) (state + 4), _mm_alignr_epi8(state1, temp, 8));
+}
+
+#undef CL_SHA1_GROUP
+#undef CL_SHA256_GROUP
+
+#else
+
+void SHA_NI::sha1_process_blocks(ubyte32 state[5], const unsigned char *data, int num_blocks)
+{
+	throw Exception("SHA extensions are not available on this platform");
+}
+
+void SHA_NI::sha256_process_blocks(ubyte32 state[8], const unsigned char *data, int num_blocks)
+{
+	throw Exception("SHA extensions are not available on this platform");
+}
+
+#endif
+
+}
@@ -0,0 +1,53 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Magnus Norddahl
+*/
+
+#pragma once
+
+#include "API/Core/System/cl_platform.h"
+
+namespace clan
+{
+
+/// \brief SHA-1 and SHA-256 using the SHA extensions
+///
+/// Only call these functions if CryptoAcceleration::is_sha_supported() returns true.
+class SHA_NI
+{
+public:
+	/// \brief Processes 64 byte blocks
+	///
+	/// \param state = h0 to h4
+	static void sha1_process_blocks(ubyte32 state[5], const unsigned char *data, int num_blocks);
+
+	/// \brief Processes 64 byte blocks
+	///
+	/// \param state = h0 to h7
+	static void sha256_process_blocks(ubyte32 state[8], const unsigned char *data, int num_blocks);
+};
+
+}
@@ -78,4 +78,34 @@ void TLSClient::encrypted_data_consumed(int size)
 	impl->encrypted_data_consumed(size);
 }
 
+bool TLSClient::is_session_resumed() const
+{
+	return impl->is_session_resumed();
+}
+
+bool TLSClient::is_closed() const
+{
+	return impl->is_closed();
+}
+
+void *TLSClient::get_decrypt_buffer(int &out_size)
+{
+	return impl->get_decrypt_buffer(out_size);
+}
+
+void TLSClient::decrypt_buffer_filled(int size)
+{
+	impl->decrypt_buffer_filled(size);
+}
+
+void TLSClient::set_session_name(const std::string &name)
+{
+	impl->set_session_name(name);
+}
+
+void TLSClient::clear_session_cache()
+{
+	TLS_SessionCache::clear();
+}
+
 }
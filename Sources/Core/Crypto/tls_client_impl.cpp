@@ -35,7 +35,9 @@
 #include "API/Core/Crypto/aes128_decrypt.h"
 #include "API/Core/Crypto/aes256_encrypt.h"
 #include "API/Core/Crypto/aes256_decrypt.h"
+#include "API/Core/Crypto/sha384.h"
 #include "API/Core/IOData/file.h"
+#include "API/Core/System/system.h"
 #include <ctime>
 #include "x509.h"
 
@@ -48,13 +50,21 @@ namespace clan
 
 TLSClient_Impl::TLSClient_Impl() :
 	recv_in_data_read_pos(0), recv_out_data_read_pos(0), send_in_data_read_pos(0), send_out_data_read_pos(0), handshake_in_read_pos(0),
-	conversation_state(cl_tls_state_send_client_hello), security_parameters(), protocol(), is_protocol_chosen()
+	conversation_state(cl_tls_state_send_client_hello), security_parameters(), protocol(), is_protocol_chosen(),
+	session_resumed(false), session_ticket_expected(false), close_notify_received(false)
 {
-	// Set TLS 3.1
+	// Ask for TLS 1.2 (3.3). The server may choose down to TLS 1.0 (3.1)
 	protocol.major = 3;
-	protocol.minor = 1;
+	protocol.minor = 3;
+	client_hello_protocol = protocol;
 	is_protocol_chosen = false;
 
+	// Records are encrypted and decrypted in place in these buffers, so allocate them once
+	recv_in_data.set_capacity(desired_buffer_size);
+	recv_out_data.set_capacity(desired_buffer_size * 2 + max_record_length);
+	send_in_data.set_capacity(desired_buffer_size);
+	send_out_data.set_capacity(desired_buffer_size + sizeof(TLS_Record) + max_ciphertext_length);
+
 	create_security_parameters_client_random();
 }
 
@@ -124,7 +134,7 @@ void TLSClient_Impl::decrypted_data_consumed(int size)
 		throw Exception("TLSClient::decrypted_data_consumed misuse");
 
 	recv_out_data_read_pos += size;
-	if (recv_out_data_read_pos > desired_buffer_size / 2)
+	if (recv_out_data_read_pos > desired_buffer_size / 2 || recv_out_data_read_pos == (int) recv_out_data.get_size())
 	{
 		int available = recv_out_data.get_size() - recv_out_data_read_pos;
 		memmove(recv_out_data.get_data(), recv_out_data.get_data() + recv_out_data_read_pos, available);
@@ -143,7 +153,7 @@ void TLSClient_Impl::encrypted_data_consumed(int size)
 		throw Exception("TLSClient::encrypted_data_consumed misuse");
 
 	send_out_data_read_pos += size;
-	if (send_out_data_read_pos > desired_buffer_size / 2)
+	if (send_out_data_read_pos > desired_buffer_size / 2 || send_out_data_read_pos == (int) send_out_data.get_size())
 	{
 		int available = send_out_data.get_size() - send_out_data_read_pos;
 		memmove(send_out_data.get_data(), send_out_data.get_data() + send_out_data_read_pos, available);
@@ -154,6 +164,41 @@ void TLSClient_Impl::encrypted_data_consumed(int size)
 	progress_conversation();
 }
 
+void *TLSClient_Impl::get_decrypt_buffer(int &out_size)
+{
+	int insert_pos = recv_in_data.get_size();
+	out_size = desired_buffer_size - insert_pos;
+	return recv_in_data.get_data() + insert_pos;	// Within the capacity reserved by the constructor
+}
+
+void TLSClient_Impl::decrypt_buffer_filled(int size)
+{
+	int insert_pos = recv_in_data.get_size();
+	if (size < 0 || insert_pos + size > desired_buffer_size)
+		throw Exception("TLSClient::decrypt_buffer_filled misuse");
+
+	recv_in_data.set_size(insert_pos + size);
+
+	progress_conversation();
+}
+
+void TLSClient_Impl::set_session_name(const std::string &name)
+{
+	if (conversation_state != cl_tls_state_send_client_hello)
+		throw Exception("The TLS session name must be set before the handshake starts");
+	session_name = name;
+}
+
+bool TLSClient_Impl::is_session_resumed() const
+{
+	return session_resumed;
+}
+
+bool TLSClient_Impl::is_closed() const
+{
+	return close_notify_received;
+}
+
 void TLSClient_Impl::progress_conversation()
 {
 	try
@@ -222,22 +267,10 @@ bool TLSClient_Impl::send_application_data()
 	unsigned int max_record_length_gcc_fix = max_record_length;
 	unsigned int data_in_record = std::min((unsigned int)size, max_record_length_gcc_fix);
 
-	int offset = 0;
-	int offset_tls_record = offset;					offset += sizeof(TLS_Record);
-	int offset_tls_appdata = offset;				offset += data_in_record;
-
-	Secret message(offset);
-	unsigned char *message_ptr = message.get_data();
-
-	set_tls_record(message_ptr + offset_tls_record, cl_tls_content_application_data, offset - offset_tls_record);
-
-	memcpy(message_ptr + offset_tls_appdata, data, data_in_record);
-
-	send_record(message_ptr, offset);
-
+	write_record(cl_tls_content_application_data, data, data_in_record);
 
 	send_in_data_read_pos += data_in_record;
-	if (send_in_data_read_pos > desired_buffer_size / 2 || send_in_data_read_pos == 0)
+	if (send_in_data_read_pos > desired_buffer_size / 2 || send_in_data_read_pos == (int) send_in_data.get_size())
 	{
 		int available = send_in_data.get_size() - send_in_data_read_pos;
 		memmove(send_in_data.get_data(), send_in_data.get_data() + send_in_data_read_pos, available);
@@ -254,6 +287,10 @@ bool TLSClient_Impl::receive_record()
 	if (recv_out_data.get_size() - recv_out_data_read_pos >= desired_buffer_size)
 		return false;
 
+	// Nothing after a close_notify is processed
+	if (close_notify_received)
+		return false;
+
 	int data_available = recv_in_data.get_size() - recv_in_data_read_pos;
 	if (data_available < sizeof(TLS_Record))
 		return false;
@@ -263,7 +300,7 @@ bool TLSClient_Impl::receive_record()
 
 	int record_length;
 	record_length = record.length[0] << 8 | record.length[1];
-	if (record_length > max_record_length)
+	if (record_length > (int) max_ciphertext_length)
 		throw Exception("Maximum record length exceeded when receieving");
 	if (record_length == 0)	// The TLS Record Layer receives uninterpreted data from higher layers in non-empty blocks of arbitrary size.
 		throw Exception("Received an empty block");
@@ -283,23 +320,15 @@ bool TLSClient_Impl::receive_record()
 		// We set the protocol version in ServerHello
 	}
 
-	record_data_buffer.set_size(record_length);
-	memcpy(record_data_buffer.get_data(), recv_in_data.get_data() + recv_in_data_read_pos + sizeof(TLS_Record), record_length);
-
-	recv_in_data_read_pos += sizeof(TLS_Record) + record_length;
-	if (recv_in_data_read_pos > desired_buffer_size / 2)
-	{
-		int available = recv_in_data.get_size() - recv_in_data_read_pos;
-		memmove(recv_in_data.get_data(), recv_in_data.get_data() + recv_in_data_read_pos, available);
-		recv_in_data.set_size(available);
-		recv_in_data_read_pos = 0;
-	}
+	// The record is decrypted in place, it is not needed once processed
+	unsigned char *record_data = (unsigned char *) recv_in_data.get_data() + recv_in_data_read_pos + sizeof(TLS_Record);
 
-	DataBuffer plaintext;
+	const unsigned char *plaintext = record_data;
+	int plaintext_size = record_length;
 	if (security_parameters.is_receive_encrypted)
-		plaintext = decrypt_record(record, record_data_buffer);
-	else
-		plaintext = record_data_buffer;
+		decrypt_record(record, record_data, record_length, plaintext, plaintext_size);
+	else if (record_length > (int) max_record_length)
+		throw Exception("Maximum record length exceeded when receieving");
 
 	security_parameters.read_sequence_number++;
 	if (security_parameters.read_sequence_number == 0)
@@ -308,19 +337,19 @@ bool TLSClient_Impl::receive_record()
 	switch (record.type)
 	{
 	case cl_tls_content_change_cipher_spec:
-		change_cipher_spec_data(plaintext);
+		change_cipher_spec_data(plaintext, plaintext_size);
 		break;
 
 	case cl_tls_content_alert:
-		alert_data(plaintext);
+		alert_data(plaintext, plaintext_size);
 		break;
 
 	case cl_tls_content_handshake:
-		handshake_data(plaintext);
+		handshake_data(plaintext, plaintext_size);
 		break;
 
 	case cl_tls_content_application_data:
-		application_data(plaintext);
+		application_data(plaintext, plaintext_size);
 		break;
 
 	default:
@@ -329,35 +358,56 @@ bool TLSClient_Impl::receive_record()
 		break;
 	}
 
+	recv_in_data_read_pos += sizeof(TLS_Record) + record_length;
+	if (recv_in_data_read_pos > desired_buffer_size / 2 || recv_in_data_read_pos == (int) recv_in_data.get_size())
+	{
+		int available = recv_in_data.get_size() - recv_in_data_read_pos;
+		memmove(recv_in_data.get_data(), recv_in_data.get_data() + recv_in_data_read_pos, available);
+		recv_in_data.set_size(available);
+		recv_in_data_read_pos = 0;
+	}
+
 	return true;
 }
 
-void TLSClient_Impl::change_cipher_spec_data(DataBuffer record_plaintext)
+void TLSClient_Impl::change_cipher_spec_data(const unsigned char *data, int size)
 {
 	if (conversation_state != cl_tls_state_receive_change_cipher_spec)
 		throw Exception("Unexpected TLS change cipher record received");
 
-	if (record_plaintext.get_size() != 1)
+	if (size != 1)
 		throw Exception("Invalid TLS content change cipher spec size");
 
 	security_parameters.read_sequence_number = 0;
 
-	ubyte8 value = record_plaintext.get_data<ubyte8>()[0];
+	ubyte8 value = data[0];
 	if (value != 1)
 		throw Exception("TLS server change cipher spec did not send 1");
 
 	security_parameters.is_receive_encrypted = true;
+	if (security_parameters.cipher_type == cl_tls_cipher_type_aead)
+		server_write_gcm.set_key(security_parameters.server_write_key.get_data(), security_parameters.server_write_key.get_size());
 
 	conversation_state = cl_tls_state_receive_finished;
 }
 
-void TLSClient_Impl::alert_data(DataBuffer record_plaintext)
+void TLSClient_Impl::alert_data(const unsigned char *data, int size)
 {
-	if (record_plaintext.get_size() != 2) // To do: theoretically this is not safe - it could be split into two 1 byte records.
+	if (size != 2) // To do: theoretically this is not safe - it could be split into two 1 byte records.
 		throw Exception("Invalid TLS content alert message");
 
 	const int alert_data_size = 2;
-	ubyte8 *alert_data = record_plaintext.get_data<ubyte8>();
+	const ubyte8 *alert_data = data;
+
+	// "Unless some other fatal alert has been transmitted, each party is required to send a
+	// close_notify alert before closing the write side of the connection."
+	if (alert_data[1] == cl_tls_close_notify)
+	{
+		close_notify_received = true;
+		ubyte8 close_notify[alert_data_size] = { cl_tls_warning, cl_tls_close_notify };
+		write_record(cl_tls_content_alert, close_notify, alert_data_size);
+		return;
+	}
 
 	if (alert_data[0] == cl_tls_warning)
 		return;
@@ -463,90 +513,97 @@ void TLSClient_Impl::alert_data(DataBuffer record_plaintext)
 	throw Exception(string);
 }
 
-void TLSClient_Impl::handshake_data(DataBuffer record_plaintext)
+void TLSClient_Impl::handshake_data(const unsigned char *record_data, int record_size)
 {
 	// Copy handshake data into input buffer for easier processing:
 	// "RFC 2246 (5.2.1) multiple client messages of the same ContentType may be coalesced into a single TLSPlaintext record"
 	int pos = handshake_in_data.get_size();
-	handshake_in_data.set_size(pos + record_plaintext.get_size());
-	memcpy(handshake_in_data.get_data() + pos, record_plaintext.get_data(), record_plaintext.get_size());
+	handshake_in_data.set_size(pos + record_size);
+	memcpy(handshake_in_data.get_data() + pos, record_data, record_size);
 
-	// Check if we have received enough data to peek at the handshake header:
-	int available = handshake_in_data.get_size() - handshake_in_read_pos;
-	if (available < sizeof(TLS_Handshake))
-		return;
+	while (true)
+	{
+		// Check if we have received enough data to peek at the handshake header:
+		int available = handshake_in_data.get_size() - handshake_in_read_pos;
+		if (available < sizeof(TLS_Handshake))
+			break;
 
-	// Check if we have received enough data to read the entire handshake message:
-	TLS_Handshake &handshake = *reinterpret_cast<TLS_Handshake*>(handshake_in_data.get_data() + handshake_in_read_pos);
-	int length = handshake.length[0] << 16 | handshake.length[1] << 8 | handshake.length[2];
-	if (sizeof(TLS_Handshake) + length > available)
-		return;
+		// Check if we have received enough data to read the entire handshake message:
+		TLS_Handshake &handshake = *reinterpret_cast<TLS_Handshake*>(handshake_in_data.get_data() + handshake_in_read_pos);
+		int length = handshake.length[0] << 16 | handshake.length[1] << 8 | handshake.length[2];
+		if (sizeof(TLS_Handshake) + length > available)
+			break;
 
-	const char *data = handshake_in_data.get_data() + handshake_in_read_pos + sizeof(TLS_Handshake);
+		const char *data = handshake_in_data.get_data() + handshake_in_read_pos + sizeof(TLS_Handshake);
 
-	// We got a full message.
+		// We got a full message.
 
-	// All handshake messages except handshake_finished needs to be included in the handshake hash calculation:
-	if (handshake.msg_type != cl_tls_handshake_finished)
-	{
-		hash_handshake(&handshake, length + sizeof(TLS_Handshake));
-	}
+		// All handshake messages are included in the handshake hash. The finished message is added after
+		// it has been verified, as it is covered by the client finished message in an abbreviated handshake.
+		if (handshake.msg_type != cl_tls_handshake_finished)
+		{
+			hash_handshake(&handshake, length + sizeof(TLS_Handshake));
+		}
 
-	// Dispatch message for further parsing:
-	switch (handshake.msg_type)
-	{
-	case cl_tls_handshake_hello_request:
-		handshake_hello_request_received(data, length);
-		break;
-	case cl_tls_handshake_client_hello:
-		handshake_client_hello_received(data, length);
-		break;
-	case cl_tls_handshake_server_hello:
-		handshake_server_hello_received(data, length);
-		break;
-	case cl_tls_handshake_certificate:
-		handshake_certificate_received(data, length);
-		break;
-	case cl_tls_handshake_server_key_exchange:
-		handshake_server_key_exchange_received(data, length);
-		break;
-	case cl_tls_handshake_certificate_request:
-		handshake_certificate_request_received(data, length);
-		break;
-	case cl_tls_handshake_server_hello_done:
-		handshake_server_hello_done_received(data, length);
-		break;
-	case cl_tls_handshake_certificate_verify:
-		handshake_certificate_verify_received(data, length);
-		break;
-	case cl_tls_handshake_client_key_exchange:
-		handshake_client_key_exchange_received(data, length);
-		break;
-	case cl_tls_handshake_finished:
-		handshake_finished_received(data, length);
-		break;
-	default:
-		throw Exception("Unknown handshake type");
-	}
+		// Dispatch message for further parsing:
+		switch (handshake.msg_type)
+		{
+		case cl_tls_handshake_hello_request:
+			handshake_hello_request_received(data, length);
+			break;
+		case cl_tls_handshake_client_hello:
+			handshake_client_hello_received(data, length);
+			break;
+		case cl_tls_handshake_server_hello:
+			handshake_server_hello_received(data, length);
+			break;
+		case cl_tls_handshake_new_session_ticket:
+			handshake_new_session_ticket_received(data, length);
+			break;
+		case cl_tls_handshake_certificate:
+			handshake_certificate_received(data, length);
+			break;
+		case cl_tls_handshake_server_key_exchange:
+			handshake_server_key_exchange_received(data, length);
+			break;
+		case cl_tls_handshake_certificate_request:
+			handshake_certificate_request_received(data, length);
+			break;
+		case cl_tls_handshake_server_hello_done:
+			handshake_server_hello_done_received(data, length);
+			break;
+		case cl_tls_handshake_certificate_verify:
+			handshake_certificate_verify_received(data, length);
+			break;
+		case cl_tls_handshake_client_key_exchange:
+			handshake_client_key_exchange_received(data, length);
+			break;
+		case cl_tls_handshake_finished:
+			handshake_finished_received(data, length);
+			hash_handshake(&handshake, length + sizeof(TLS_Handshake));
+			break;
+		default:
+			throw Exception("Unknown handshake type");
+		}
 
-	// Remove processed handshake message from the input buffer:
-	handshake_in_read_pos += sizeof(TLS_Handshake) + length;
-	if (handshake_in_read_pos >= desired_buffer_size / 2)
-	{
-		available = handshake_in_data.get_size() - handshake_in_read_pos;
-		memmove(handshake_in_data.get_data(), handshake_in_data.get_data() + handshake_in_read_pos, available);
-		handshake_in_data.set_size(available);
+		handshake_in_read_pos += sizeof(TLS_Handshake) + length;
 	}
+
+	// Remove processed handshake messages from the input buffer:
+	int available = handshake_in_data.get_size() - handshake_in_read_pos;
+	memmove(handshake_in_data.get_data(), handshake_in_data.get_data() + handshake_in_read_pos, available);
+	handshake_in_data.set_size(available);
+	handshake_in_read_pos = 0;
 }
 
-void TLSClient_Impl::application_data(DataBuffer record_plaintext)
+void TLSClient_Impl::application_data(const unsigned char *data, int size)
 {
 	if (conversation_state != cl_tls_state_connected)
 		throw Exception("Unexpected application data record received");
 
 	int pos = recv_out_data.get_size();
-	recv_out_data.set_size(pos + record_plaintext.get_size());
-	memcpy(recv_out_data.get_data() + pos, record_plaintext.get_data(), record_plaintext.get_size());
+	recv_out_data.set_size(pos + size);
+	memcpy(recv_out_data.get_data() + pos, data, size);
 }
 
 void TLSClient_Impl::handshake_hello_request_received(const void *data, int size)
@@ -620,16 +677,57 @@ void TLSClient_Impl::handshake_server_hello_received(const void *data, int size)
 
 	ubyte8 session_id_length;
 	copy_data(&session_id_length, 1, data, size);
+	if (session_id_length > 32)
+		throw Exception("TLS session id too long");
 	Secret session_id(session_id_length);
 	copy_data(session_id.get_data(), session_id_length, data, size);
+	security_parameters.session_id = session_id;
 
-	byte8 buffer[3];
+	ubyte8 buffer[3];
 	copy_data(buffer, 3, data, size);
 
 	select_cipher_suite(buffer[0], buffer[1]);
 	select_compression_method(buffer[2]);
 
-	conversation_state = cl_tls_state_receive_certificate;
+	if (size > 0)
+		select_extensions(data, size);
+
+	// The server resumes the session by echoing the session id we offered
+	session_resumed = session_id_length > 0 && client_hello_session_id.get_size() == session_id_length && !memcmp(session_id.get_data(), client_hello_session_id.get_data(), session_id_length);
+	if (session_resumed)
+	{
+		if (resume_session.protocol.major != protocol.major || resume_session.protocol.minor != protocol.minor ||
+			resume_session.cipher_suite[0] != buffer[0] || resume_session.cipher_suite[1] != buffer[1])
+			throw Exception("TLS server resumed a session with different parameters");
+
+		memcpy(security_parameters.master_secret.get_data(), resume_session.master_secret.get_data(), security_parameters.master_secret.get_size());
+		create_keys();
+
+		// Abbreviated handshake: the server continues with its change cipher spec and finished messages
+		conversation_state = cl_tls_state_receive_change_cipher_spec;
+	}
+	else
+	{
+		conversation_state = cl_tls_state_receive_certificate;
+	}
+}
+
+void TLSClient_Impl::handshake_new_session_ticket_received(const void *data, int size)
+{
+	// RFC 5077: Sent before the server change cipher spec, in both the full and the abbreviated handshake
+	if (!session_ticket_expected || conversation_state != cl_tls_state_receive_change_cipher_spec)
+		throw Exception("Unexpected new session ticket handshake message received");
+
+	ubyte8 buffer[6];
+	copy_data(buffer, 6, data, size);	// ticket_lifetime_hint and ticket length
+
+	int ticket_length = buffer[4] << 8 | buffer[5];
+	if (ticket_length != size)
+		throw Exception("Invalid new session ticket message");
+
+	// An empty ticket means the server will not issue one after all
+	new_session_ticket.set_size(ticket_length);
+	copy_data(new_session_ticket.get_data(), ticket_length, data, size);
 }
 
 void TLSClient_Impl::handshake_certificate_received(const void *data, int size)
@@ -703,26 +801,29 @@ void TLSClient_Impl::handshake_finished_received(const void *data, int size)
 		throw Exception("TLS Expected server finished");
 
 	const int verify_data_size = 12;
+	if (size != verify_data_size)
+		throw Exception("Invalid TLS finished message");
+
 	Secret server_verify_data(verify_data_size);
 	copy_data(server_verify_data.get_data(), verify_data_size, data, size);
 
 	Secret client_verify_data(verify_data_size);
 
-	Secret md5_handshake_messages(16);
-	Secret sha1_handshake_messages(20);
-
-	server_handshake_md5_hash.calculate();
-	server_handshake_sha1_hash.calculate();
-
-	server_handshake_md5_hash.get_hash(md5_handshake_messages.get_data());
-	server_handshake_sha1_hash.get_hash(sha1_handshake_messages.get_data());
-
-	PRF(client_verify_data.get_data(), verify_data_size, security_parameters.master_secret, "server finished", md5_handshake_messages, sha1_handshake_messages);
+	PRF(client_verify_data.get_data(), verify_data_size, security_parameters.master_secret, "server finished", get_handshake_hash(), Secret());
 
 	if (memcmp(client_verify_data.get_data(), server_verify_data.get_data(), verify_data_size))
 		throw Exception("TLS server finished verify data failed");
 
-	conversation_state = cl_tls_state_connected;
+	if (session_resumed)
+	{
+		// In an abbreviated handshake the server finishes first
+		conversation_state = cl_tls_state_send_change_cipher_spec;
+	}
+	else
+	{
+		store_session();
+		conversation_state = cl_tls_state_connected;
+	}
 }
 
 bool TLSClient_Impl::can_send_record() const
@@ -730,43 +831,84 @@ bool TLSClient_Impl::can_send_record() const
 	return send_out_data.get_size() < desired_buffer_size;
 }
 
-void TLSClient_Impl::send_record(void *data_ptr, unsigned int data_size)
+void TLSClient_Impl::send_record(const void *data_ptr, unsigned int data_size)
 {
-	TLS_Record *record_ptr = (TLS_Record *) data_ptr;
+	const TLS_Record *record_ptr = (const TLS_Record *) data_ptr;
 
 	int record_length;
 	record_length = record_ptr->length[0] << 8 | record_ptr->length[1];
-	if (record_length > max_record_length)
+	if (record_length + sizeof(TLS_Record) != data_size)
+		throw Exception("Record length mismatch");
+
+	write_record((TLS_ContentType) record_ptr->type, (const unsigned char *) data_ptr + sizeof(TLS_Record), record_length);
+}
+
+void TLSClient_Impl::write_record(TLS_ContentType content_type, const void *data_ptr, unsigned int data_size)
+{
+	if (data_size > max_record_length)
 		throw Exception("Maximum record length exceeded when sending");
-	if (record_length == 0)
+	if (data_size == 0)
 		throw Exception("Trying to send an empty block");
 
-	if (record_length + sizeof(TLS_Record) != data_size)
-		throw Exception("Record length mismatch");
+	TLS_Record record;
+	record.type = content_type;
+	record.version = protocol;
+	record.length[0] = data_size >> 8;
+	record.length[1] = data_size;
+
+	int pos = send_out_data.get_size();
+
+	if (!security_parameters.is_send_encrypted)
+	{
+		send_out_data.set_size(pos + sizeof(TLS_Record) + data_size);
+		unsigned char *out_ptr = (unsigned char *) send_out_data.get_data() + pos;
+		memcpy(out_ptr, &record, sizeof(TLS_Record));
+		memcpy(out_ptr + sizeof(TLS_Record), data_ptr, data_size);
+	}
+	else if (security_parameters.cipher_type == cl_tls_cipher_type_aead)
+	{
+		// RFC 5288: explicit nonce, then the ciphertext and the tag. The plaintext is encrypted in place in send_out_data.
+		int record_iv_size = security_parameters.record_iv_size;
+		int new_length = record_iv_size + data_size + AES_GCM::tag_size;
+		send_out_data.set_size(pos + sizeof(TLS_Record) + new_length);
+		unsigned char *out_ptr = (unsigned char *) send_out_data.get_data() + pos;
+		unsigned char *nonce_ptr = out_ptr + sizeof(TLS_Record);
+		unsigned char *ciphertext_ptr = nonce_ptr + record_iv_size;
+
+		// The sequence number is unique for each record, so it doubles as the explicit nonce
+		ubyte64 sequence_number = security_parameters.write_sequence_number;
+		for (int cnt = record_iv_size - 1; cnt >= 0; cnt--)
+		{
+			nonce_ptr[cnt] = (unsigned char) sequence_number;
+			sequence_number >>= 8;
+		}
+
+		unsigned char nonce[AES_GCM::iv_size];
+		unsigned char additional_data[13];
+		set_aead_nonce_and_additional_data(nonce, additional_data, security_parameters.client_write_iv, nonce_ptr, security_parameters.write_sequence_number, record, data_size);
 
-	if (security_parameters.is_send_encrypted)
+		memcpy(ciphertext_ptr, data_ptr, data_size);
+		client_write_gcm.encrypt(nonce, additional_data, sizeof(additional_data), ciphertext_ptr, data_size, ciphertext_ptr + data_size);
+
+		record.length[0] = new_length >> 8;
+		record.length[1] = new_length;
+		memcpy(out_ptr, &record, sizeof(TLS_Record));
+	}
+	else
 	{
 		// "the encryption and MAC functions convert TLSCompressed.fragment structures to and from block TLSCiphertext.fragment structures."
-		const unsigned char *input_ptr = (const unsigned char *) data_ptr + sizeof(TLS_Record);
-		unsigned int input_size = data_size - sizeof(TLS_Record);
-		Secret mac = calculate_mac(data_ptr, data_size, NULL, 0, security_parameters.write_sequence_number, security_parameters.client_write_mac_secret);	// MAC includes the header and sequence number
-		DataBuffer encrypted = encrypt_data(input_ptr , input_size, mac.get_data(), mac.get_size());
+		Secret mac = calculate_mac(&record, sizeof(TLS_Record), data_ptr, data_size, security_parameters.write_sequence_number, security_parameters.client_write_mac_secret);	// MAC includes the header and sequence number
+		DataBuffer encrypted = encrypt_data(data_ptr, data_size, mac.get_data(), mac.get_size());
 
 		// Update the length
 		int new_length = encrypted.get_size();
-		record_ptr->length[0] = new_length >> 8;
-		record_ptr->length[1] = new_length;
+		record.length[0] = new_length >> 8;
+		record.length[1] = new_length;
 
-		int pos = send_out_data.get_size();
 		send_out_data.set_size(pos + sizeof(TLS_Record) + new_length);
-		memcpy(send_out_data.get_data() + pos, data_ptr, sizeof(TLS_Record));
-		memcpy(send_out_data.get_data() + pos + sizeof(TLS_Record), encrypted.get_data(), new_length);
-	}
-	else
-	{
-		int pos = send_out_data.get_size();
-		send_out_data.set_size(pos + data_size);
-		memcpy(send_out_data.get_data() + pos, data_ptr, data_size);
+		unsigned char *out_ptr = (unsigned char *) send_out_data.get_data() + pos;
+		memcpy(out_ptr, &record, sizeof(TLS_Record));
+		memcpy(out_ptr + sizeof(TLS_Record), encrypted.get_data(), new_length);
 	}
 
 	security_parameters.write_sequence_number++;
@@ -774,14 +916,30 @@ void TLSClient_Impl::send_record(void *data_ptr, unsigned int data_size)
 		throw Exception("Sequence number wraparound");
 }
 
+void TLSClient_Impl::set_aead_nonce_and_additional_data(unsigned char *out_nonce, unsigned char *out_additional_data, const Secret &write_iv, const unsigned char *record_nonce, ubyte64 sequence_number, const TLS_Record &record, unsigned int plaintext_size) const
+{
+	// RFC 5288 (3): The nonce is the salt from the key block followed by the explicit nonce of the record
+	memcpy(out_nonce, write_iv.get_data(), write_iv.get_size());
+	memcpy(out_nonce + write_iv.get_size(), record_nonce, AES_GCM::iv_size - write_iv.get_size());
+
+	// RFC 5246 (6.2.3.3): seq_num + TLSCompressed.type + TLSCompressed.version + TLSCompressed.length
+	for (int cnt = 7; cnt >= 0; cnt--)
+	{
+		out_additional_data[cnt] = (unsigned char) sequence_number;
+		sequence_number >>= 8;
+	}
+	out_additional_data[8] = record.type;
+	out_additional_data[9] = record.version.major;
+	out_additional_data[10] = record.version.minor;
+	out_additional_data[11] = plaintext_size >> 8;
+	out_additional_data[12] = plaintext_size;
+}
+
 void TLSClient_Impl::reset()
 {
 	security_parameters.reset();
 
-	client_handshake_md5_hash.reset();
-	client_handshake_sha1_hash.reset();
-	server_handshake_md5_hash.reset();
-	server_handshake_sha1_hash.reset();
+	handshake_messages.set_size(0);
 }
 
 void TLSClient_Impl::copy_data(void *out_data, int size, const void *&data, int &data_left)
@@ -819,7 +977,7 @@ void TLSClient_Impl::set_tls_handshake(unsigned char *dest_ptr, TLS_HandshakeTyp
 	if (length > max_handshake_length)
 		throw Exception("TLS handshake exceeded maximum number of bytes");
 
-	tls_handshake->length[0] = length >> 24;
+	tls_handshake->length[0] = length >> 16;
 	tls_handshake->length[1] = length >> 8;
 	tls_handshake->length[2] = length;
 }
@@ -850,14 +1008,15 @@ void TLSClient_Impl::set_tls_random(unsigned char *dest_ptr, Secret &time_and_ra
 
 int TLSClient_Impl::get_session_id_length() const
 {
-	// Enough to write single NUL
-	return 1;
+	// SessionID session_id<0..32>;
+	return 1 + client_hello_session_id.get_size();
 }
 
 void TLSClient_Impl::set_session_id(unsigned char *dest_ptr) const
 {
-	// Session id's are not supported
-	*dest_ptr = 0;
+	*(dest_ptr++) = client_hello_session_id.get_size();
+	if (client_hello_session_id.get_size() > 0)
+		memcpy(dest_ptr, client_hello_session_id.get_data(), client_hello_session_id.get_size());
 }
 
 int TLSClient_Impl::get_compression_methods_length() const
@@ -890,31 +1049,101 @@ void TLSClient_Impl::select_compression_method(ubyte8 value)
 int TLSClient_Impl::get_cipher_suites_length() const
 {
 	// CipherSuite cipher_suites<2..2^16-1>;
-	return 2 + (4*2);	// We support 4 cipher suites, each id contains 2 bytes
+	return 2 + (7*2);	// We support 6 cipher suites and the renegotiation info SCSV, each id contains 2 bytes
 }
 
 void TLSClient_Impl::set_cipher_suites(unsigned char *dest_ptr) const
 {
-	const int num_ciphers = 4;	// If changing, you MUST change get_cipher_suites_length
+	const int num_ciphers = 7;	// If changing, you MUST change get_cipher_suites_length
 	int length = num_ciphers * 2;
 	*(dest_ptr++) = length >> 8;
 	*(dest_ptr++) = length;
 
 	// Strongest first ... maybe that should be controlled by the user, strong and fast first
+	// The GCM suites need no separate MAC pass, and are only used with TLS 1.2.
+	*(dest_ptr++) = 0x00;	*(dest_ptr++) = 0x9D;	// TLS_RSA_WITH_AES_256_GCM_SHA384
+	*(dest_ptr++) = 0x00;	*(dest_ptr++) = 0x9C;	// TLS_RSA_WITH_AES_128_GCM_SHA256
 	*(dest_ptr++) = 0x00;	*(dest_ptr++) = 0x3D;	// TLS_RSA_WITH_AES_256_CBC_SHA256
 	*(dest_ptr++) = 0x00;	*(dest_ptr++) = 0x3C;	// TLS_RSA_WITH_AES_128_CBC_SHA256
 	*(dest_ptr++) = 0x00;	*(dest_ptr++) = 0x35;	// TLS_RSA_WITH_AES_256_CBC_SHA
 	*(dest_ptr++) = 0x00;	*(dest_ptr++) = 0x2F;	// TLS_RSA_WITH_AES_128_CBC_SHA
+	*(dest_ptr++) = 0x00;	*(dest_ptr++) = 0xFF;	// TLS_EMPTY_RENEGOTIATION_INFO_SCSV (RFC 5746). We never renegotiate.
+}
+
+int TLSClient_Impl::get_extensions_length() const
+{
+	// Extension extensions<0..2^16-1>;
+	int length = 2;
+	length += 4 + resume_session.session_ticket.get_size();	// session_ticket
+	length += 4 + 2 + 4*2;	// signature_algorithms
+	return length;
+}
+
+void TLSClient_Impl::set_extensions(unsigned char *dest_ptr) const
+{
+	int length = get_extensions_length() - 2;
+	*(dest_ptr++) = length >> 8;
+	*(dest_ptr++) = length;
+
+	// RFC 5077: An empty ticket asks the server for one, otherwise the ticket of the session to resume
+	int ticket_length = resume_session.session_ticket.get_size();
+	*(dest_ptr++) = 0x00;	*(dest_ptr++) = 0x23;
+	*(dest_ptr++) = ticket_length >> 8;
+	*(dest_ptr++) = ticket_length;
+	if (ticket_length > 0)
+		memcpy(dest_ptr, resume_session.session_ticket.get_data(), ticket_length);
+	dest_ptr += ticket_length;
+
+	// RFC 5246 (7.4.1.4.1): Only RSA certificates are supported
+	*(dest_ptr++) = 0x00;	*(dest_ptr++) = 0x0D;
+	*(dest_ptr++) = 0x00;	*(dest_ptr++) = 2 + 4*2;
+	*(dest_ptr++) = 0x00;	*(dest_ptr++) = 4*2;
+	*(dest_ptr++) = 0x04;	*(dest_ptr++) = 0x01;	// rsa_pkcs1_sha256
+	*(dest_ptr++) = 0x05;	*(dest_ptr++) = 0x01;	// rsa_pkcs1_sha384
+	*(dest_ptr++) = 0x06;	*(dest_ptr++) = 0x01;	// rsa_pkcs1_sha512
+	*(dest_ptr++) = 0x02;	*(dest_ptr++) = 0x01;	// rsa_pkcs1_sha1
 }
 
 void TLSClient_Impl::select_cipher_suite(ubyte8 value1, ubyte8 value2)
 {
+	// The GCM and SHA256 suites are only defined for TLS 1.2
+	bool is_tls12 = (protocol.major > 3) || (protocol.major == 3 && protocol.minor >= 3);
+
+	// TLS 1.1 and later send the CBC initialisation vector in front of each record instead of chaining it
+	bool is_explicit_iv = (protocol.major > 3) || (protocol.major == 3 && protocol.minor >= 2);
+
 	if (value1 == 0)
 	{
 		switch (value2)
 		{
+			case 0x9D:	// TLS_RSA_WITH_AES_256_GCM_SHA384
+			case 0x9C:	// TLS_RSA_WITH_AES_128_GCM_SHA256
+			{
+				if (!is_tls12)
+					throw Exception("TLS server selected an AES-GCM cipher suite without TLS 1.2");
+				security_parameters.cipher_type = cl_tls_cipher_type_aead;
+				security_parameters.mac_algorithm = cl_tls_mac_algorithm_null;
+				security_parameters.hash_size = 0;
+				security_parameters.iv_size = AES_GCM::iv_size - 8;	// 4 byte salt and an 8 byte explicit nonce
+				security_parameters.record_iv_size = 8;
+				if (value2 == 0x9D)
+				{
+					security_parameters.bulk_cipher_algorithm = cl_tls_cipher_algorithm_aes256;
+					security_parameters.prf_algorithm = cl_tls_prf_sha384;
+					security_parameters.key_material_length = AES256_Encrypt::key_size;
+				}
+				else
+				{
+					security_parameters.bulk_cipher_algorithm = cl_tls_cipher_algorithm_aes128;
+					security_parameters.prf_algorithm = cl_tls_prf_sha256;
+					security_parameters.key_material_length = AES128_Encrypt::key_size;
+				}
+				break;
+			}
 			case 0x3D:	// TLS_RSA_WITH_AES_256_CBC_SHA256
 			{
+				if (!is_tls12)
+					throw Exception("TLS server selected a SHA256 cipher suite without TLS 1.2");
 				security_parameters.mac_algorithm = cl_tls_mac_algorithm_sha256;
 				security_parameters.bulk_cipher_algorithm = cl_tls_cipher_algorithm_aes256;
 				security_parameters.hash_size = SHA256::hash_size;
@@ -924,6 +1153,8 @@ void TLSClient_Impl::select_cipher_suite(ubyte8 value1, ubyte8 value2)
 			}
 			case 0x3C:	// TLS_RSA_WITH_AES_128_CBC_SHA256
 			{
+				if (!is_tls12)
+					throw Exception("TLS server selected a SHA256 cipher suite without TLS 1.2");
 				security_parameters.mac_algorithm = cl_tls_mac_algorithm_sha256;
 				security_parameters.bulk_cipher_algorithm = cl_tls_cipher_algorithm_aes128;
 				security_parameters.hash_size = SHA256::hash_size;
@@ -958,6 +1189,60 @@ void TLSClient_Impl::select_cipher_suite(ubyte8 value1, ubyte8 value2)
 	{
 		throw Exception("TLS unsupported cipher suite");
 	}
+
+	if (security_parameters.cipher_type == cl_tls_cipher_type_block)
+	{
+		if (is_tls12)
+			security_parameters.prf_algorithm = cl_tls_prf_sha256;
+		if (is_explicit_iv)
+		{
+			security_parameters.record_iv_size = security_parameters.iv_size;
+			security_parameters.iv_size = 0;
+		}
+	}
+
+	security_parameters.cipher_suite[0] = value1;
+	security_parameters.cipher_suite[1] = value2;
+}
+
+void TLSClient_Impl::select_extensions(const void *data, int size)
+{
+	ubyte8 buffer[4];
+	copy_data(buffer, 2, data, size);
+	int extensions_length = buffer[0] << 8 | buffer[1];
+	if (extensions_length != size)
+		throw Exception("Invalid TLS server hello extensions");
+
+	while (size > 0)
+	{
+		copy_data(buffer, 4, data, size);
+		int extension_type = buffer[0] << 8 | buffer[1];
+		int extension_length = buffer[2] << 8 | buffer[3];
+		if (extension_length > size)
+			throw Exception("Invalid TLS server hello extensions");
+
+		const unsigned char *extension_data = (const unsigned char *) data;
+		switch (extension_type)
+		{
+			case 0x0023:	// session_ticket: a NewSessionTicket message will follow
+				if (extension_length != 0)
+					throw Exception("Invalid TLS session ticket extension");
+				session_ticket_expected = true;
+				break;
+
+			case 0xff01:	// renegotiation_info: must be empty on the initial handshake
+				if (extension_length != 1 || extension_data[0] != 0)
+					throw Exception("TLS secure renegotiation check failed");
+				break;
+
+			default:
+				// Other extensions we did not ask for are ignored
+				break;
+		}
+
+		data = extension_data + extension_length;
+		size -= extension_length;
+	}
 }
 
 bool TLSClient_Impl::send_client_hello()
@@ -965,6 +1250,22 @@ bool TLSClient_Impl::send_client_hello()
 	if (!can_send_record())
 		return false;
 
+	// Offer to resume the last session with this server
+	client_hello_session_id = Secret();
+	if (!session_name.empty() && TLS_SessionCache::find(session_name, resume_session))
+	{
+		if (resume_session.session_id.get_size() > 0)
+		{
+			client_hello_session_id = resume_session.session_id;
+		}
+		else
+		{
+			// RFC 5077 (3.4): The server echoes this session id if it accepts the ticket
+			client_hello_session_id = Secret(32);
+			m_Random.get_random_bytes(client_hello_session_id.get_data(), client_hello_session_id.get_size());
+		}
+	}
+
 	int offset = 0;
 	int offset_tls_record = offset;					offset += sizeof(TLS_Record);
 	int offset_tls_handshake = offset;				offset += sizeof(TLS_Handshake);
@@ -973,6 +1274,7 @@ bool TLSClient_Impl::send_client_hello()
 	int offset_tls_session_id = offset;				offset += get_session_id_length();
 	int offset_tls_cipher_suites = offset;			offset += get_cipher_suites_length();
 	int offset_tls_compression_methods = offset;	offset += get_compression_methods_length();
+	int offset_tls_extensions = offset;				offset += get_extensions_length();
 
 	Secret message(offset);	// keep data secure
 	unsigned char *message_ptr = message.get_data();
@@ -984,6 +1286,7 @@ bool TLSClient_Impl::send_client_hello()
 	set_session_id(message_ptr + offset_tls_session_id);
 	set_cipher_suites(message_ptr + offset_tls_cipher_suites);
 	set_compression_methods(message_ptr + offset_tls_compression_methods);
+	set_extensions(message_ptr + offset_tls_extensions);
 
 	hash_handshake( message_ptr + offset_tls_handshake, offset - offset_tls_handshake);
 
@@ -1014,13 +1317,42 @@ bool TLSClient_Impl::send_client_key_exchange()
 	Secret pre_master_secret(48);
 	unsigned char *pms_ptr = pre_master_secret.get_data();
 	m_Random.get_random_bytes(pms_ptr + 2, 46);
-	pms_ptr[0] = protocol.major;	// Version number
-	pms_ptr[1] = protocol.minor;
+	pms_ptr[0] = client_hello_protocol.major;	// "The latest (newest) version supported by the client", not the negotiated one
+	pms_ptr[1] = client_hello_protocol.minor;
 
 	DataBuffer wrapped_pre_master_secret = RSA::encrypt(2, m_Random, server_public_exponent,  server_public_modulus, pre_master_secret);
 
 	PRF(security_parameters.master_secret.get_data(), security_parameters.master_secret.get_size(), pre_master_secret, "master secret", security_parameters.client_random, security_parameters.server_random);
 
+	create_keys();
+
+	const int wrapped_pre_master_secret_length = wrapped_pre_master_secret.get_size();
+
+	int offset = 0;
+	int offset_tls_record = offset;					offset += sizeof(TLS_Record);
+	int offset_tls_handshake = offset;				offset += sizeof(TLS_Handshake);
+	int offset_tls_encrypted_pre_master_secret_length = offset;	offset+= 2;
+	int offset_tls_encrypted_pre_master_secret = offset;	offset+= wrapped_pre_master_secret_length;
+
+	Secret message(offset);	// keep data secure
+	unsigned char *message_ptr = message.get_data();
+	set_tls_record(message_ptr + offset_tls_record, cl_tls_content_handshake, offset - offset_tls_record);
+	set_tls_handshake(message_ptr + offset_tls_handshake, cl_tls_handshake_client_key_exchange, offset - offset_tls_handshake);
+
+	memcpy(message_ptr + offset_tls_encrypted_pre_master_secret, wrapped_pre_master_secret.get_data(), wrapped_pre_master_secret_length);
+	message_ptr[offset_tls_encrypted_pre_master_secret_length] = wrapped_pre_master_secret_length >> 8;
+	message_ptr[offset_tls_encrypted_pre_master_secret_length+1] = wrapped_pre_master_secret_length;
+
+	hash_handshake( message_ptr + offset_tls_handshake, offset - offset_tls_handshake);
+
+	send_record(message_ptr, offset);
+
+	conversation_state = cl_tls_state_send_change_cipher_spec;
+	return true;
+}
+
+void TLSClient_Impl::create_keys()
+{
 	Secret key_block( 2 * (security_parameters.hash_size + security_parameters.key_material_length + security_parameters.iv_size ) );
 	PRF(key_block.get_data(), key_block.get_size(), security_parameters.master_secret, "key expansion", security_parameters.server_random, security_parameters.client_random);
 
@@ -1050,34 +1382,88 @@ bool TLSClient_Impl::send_client_key_exchange()
 
 	memcpy(security_parameters.server_write_iv.get_data(), key_block_ptr, security_parameters.server_write_iv.get_size());
 	key_block_ptr+=security_parameters.server_write_iv.get_size();
+}
 
-	const int wrapped_pre_master_secret_length = wrapped_pre_master_secret.get_size();
-
-	int offset = 0;
-	int offset_tls_record = offset;					offset += sizeof(TLS_Record);
-	int offset_tls_handshake = offset;				offset += sizeof(TLS_Handshake);
-	int offset_tls_encrypted_pre_master_secret_length = offset;	offset+= 2;
-	int offset_tls_encrypted_pre_master_secret = offset;	offset+= wrapped_pre_master_secret_length;
+void TLSClient_Impl::store_session()
+{
+	if (session_name.empty())
+		return;
 
-	Secret message(offset);	// keep data secure
-	unsigned char *message_ptr = message.get_data();
-	set_tls_record(message_ptr + offset_tls_record, cl_tls_content_handshake, offset - offset_tls_record);
-	set_tls_handshake(message_ptr + offset_tls_handshake, cl_tls_handshake_client_key_exchange, offset - offset_tls_handshake);
+	TLS_Session session;
+	session.protocol = protocol;
+	session.cipher_suite[0] = security_parameters.cipher_suite[0];
+	session.cipher_suite[1] = security_parameters.cipher_suite[1];
+	session.session_id = security_parameters.session_id;
+	if (session_ticket_expected)
+		session.session_ticket = new_session_ticket;
+	else if (session_resumed)
+		session.session_ticket = resume_session.session_ticket;
+
+	// Nothing to resume with if the server gave neither a session id nor a ticket
+	if (session.session_id.get_size() == 0 && session.session_ticket.get_size() == 0)
+		return;
 
-	memcpy(message_ptr + offset_tls_encrypted_pre_master_secret, wrapped_pre_master_secret.get_data(), wrapped_pre_master_secret_length);
-	message_ptr[offset_tls_encrypted_pre_master_secret_length] = wrapped_pre_master_secret_length >> 8;
-	message_ptr[offset_tls_encrypted_pre_master_secret_length+1] = wrapped_pre_master_secret_length;
+	session.master_secret = Secret(security_parameters.master_secret.get_size());
+	memcpy(session.master_secret.get_data(), security_parameters.master_secret.get_data(), session.master_secret.get_size());
+	session.creation_time = session_resumed ? resume_session.creation_time : System::get_time();
 
-	hash_handshake( message_ptr + offset_tls_handshake, offset - offset_tls_handshake);
+	TLS_SessionCache::store(session_name, session);
+}
 
-	send_record(message_ptr, offset);
+/// \brief P_hash from RFC 5246 (5), the TLS 1.2 PRF
+template<typename HashFunction>
+static void tls12_prf(void *output_ptr, unsigned int output_size, const Secret &secret, const char *label_ptr, const Secret &seed_part1, const Secret &seed_part2)
+{
+	int label_length = strlen(label_ptr);
 
-	conversation_state = cl_tls_state_send_change_cipher_spec;
-	return true;
+	// A(1) = HMAC_hash(secret, seed)
+	Secret output_a(HashFunction::hash_size);
+	Secret output_b(HashFunction::hash_size);
+	HashFunction hash;
+	hash.set_hmac(secret.get_data(), secret.get_size());
+	hash.add(label_ptr, label_length);
+	hash.add(seed_part1.get_data(), seed_part1.get_size());
+	hash.add(seed_part2.get_data(), seed_part2.get_size());
+	hash.calculate();
+	hash.get_hash(output_a.get_data());
+
+	unsigned char *out_ptr = (unsigned char *) output_ptr;
+	unsigned int position = 0;
+	while (position < output_size)
+	{
+		hash.set_hmac(secret.get_data(), secret.get_size());
+		hash.add(output_a.get_data(), output_a.get_size());
+		hash.add(label_ptr, label_length);
+		hash.add(seed_part1.get_data(), seed_part1.get_size());
+		hash.add(seed_part2.get_data(), seed_part2.get_size());
+		hash.calculate();
+		hash.get_hash(output_b.get_data());
+
+		unsigned int copy_size = std::min(output_size - position, (unsigned int) HashFunction::hash_size);
+		memcpy(out_ptr + position, output_b.get_data(), copy_size);
+		position += copy_size;
+
+		// A(i) = HMAC_hash(secret, A(i-1))
+		hash.set_hmac(secret.get_data(), secret.get_size());
+		hash.add(output_a.get_data(), output_a.get_size());
+		hash.calculate();
+		hash.get_hash(output_a.get_data());
+	}
 }
 
 void TLSClient_Impl::PRF(void *output_ptr, unsigned int output_size, const Secret &secret, const char *label_ptr, const Secret &seed_part1, const Secret &seed_part2)
 {
+	if (security_parameters.prf_algorithm == cl_tls_prf_sha256)
+	{
+		tls12_prf<SHA256>(output_ptr, output_size, secret, label_ptr, seed_part1, seed_part2);
+		return;
+	}
+	else if (security_parameters.prf_algorithm == cl_tls_prf_sha384)
+	{
+		tls12_prf<SHA384>(output_ptr, output_size, secret, label_ptr, seed_part1, seed_part2);
+		return;
+	}
+
 	const ubyte8 *secret_part1 = secret.get_data();
 	int secret_length = secret.get_size();
 	int split_length = secret_length / 2;
@@ -1191,6 +1577,8 @@ bool TLSClient_Impl::send_change_cipher_spec()
 
 	security_parameters.is_send_encrypted = true;
 	security_parameters.write_sequence_number = 0;
+	if (security_parameters.cipher_type == cl_tls_cipher_type_aead)
+		client_write_gcm.set_key(security_parameters.client_write_key.get_data(), security_parameters.client_write_key.get_size());
 
 	conversation_state = cl_tls_state_send_finished;
 	return true;
@@ -1213,21 +1601,20 @@ bool TLSClient_Impl::send_finished()
 	set_tls_record(message_ptr + offset_tls_record, cl_tls_content_handshake, offset - offset_tls_record);
 	set_tls_handshake(message_ptr + offset_tls_handshake, cl_tls_handshake_finished, offset - offset_tls_handshake);
 
-	Secret md5_handshake_messages(MD5::hash_size);
-	Secret sha1_handshake_messages(SHA1::hash_size);
-
-	client_handshake_md5_hash.calculate();
-	client_handshake_sha1_hash.calculate();
-
-	client_handshake_md5_hash.get_hash(md5_handshake_messages.get_data());
-	client_handshake_sha1_hash.get_hash(sha1_handshake_messages.get_data());
-
-	PRF(message_ptr + offset_tls_finished, verify_data_size, security_parameters.master_secret, "client finished", md5_handshake_messages, sha1_handshake_messages);
+	PRF(message_ptr + offset_tls_finished, verify_data_size, security_parameters.master_secret, "client finished", get_handshake_hash(), Secret());
 
 	hash_handshake( message_ptr + offset_tls_handshake, offset - offset_tls_handshake);
 	send_record(message_ptr, offset);
 
-	conversation_state = cl_tls_state_receive_change_cipher_spec;
+	if (session_resumed)
+	{
+		store_session();
+		conversation_state = cl_tls_state_connected;
+	}
+	else
+	{
+		conversation_state = cl_tls_state_receive_change_cipher_spec;
+	}
 	return true;
 }
 
@@ -1236,12 +1623,22 @@ DataBuffer TLSClient_Impl::encrypt_data(const void *data_ptr, unsigned int data_
 	int additional_unpadded_blocks;
 	m_Random.get_random_bool() ? additional_unpadded_blocks = 1 : additional_unpadded_blocks = 0;
 
+	// TLS 1.1 and later: a random initialisation vector is sent in front of each record
+	const int explicit_iv_size = security_parameters.record_iv_size;
+	unsigned char explicit_iv[16];
+	const unsigned char *iv_ptr = security_parameters.client_write_iv.get_data();
+	if (explicit_iv_size > 0)
+	{
+		m_Random.get_random_bytes(explicit_iv, explicit_iv_size);
+		iv_ptr = explicit_iv;
+	}
+
 	DataBuffer buffer;
 	if (security_parameters.bulk_cipher_algorithm == cl_tls_cipher_algorithm_aes128)
 	{
 		AES128_Encrypt encrypt;
 		encrypt.set_padding(true, false, additional_unpadded_blocks);
-		encrypt.set_iv(security_parameters.client_write_iv.get_data());
+		encrypt.set_iv(iv_ptr);
 		encrypt.set_key(security_parameters.client_write_key.get_data());
 		encrypt.add(data_ptr, data_size);
 		encrypt.add(mac_ptr, mac_size);
@@ -1252,7 +1649,7 @@ DataBuffer TLSClient_Impl::encrypt_data(const void *data_ptr, unsigned int data_
 	{
 		AES256_Encrypt encrypt;
 		encrypt.set_padding(true, false, additional_unpadded_blocks);
-		encrypt.set_iv(security_parameters.client_write_iv.get_data());
+		encrypt.set_iv(iv_ptr);
 		encrypt.set_key(security_parameters.client_write_key.get_data());
 		encrypt.add(data_ptr, data_size);
 		encrypt.add(mac_ptr, mac_size);
@@ -1263,6 +1660,15 @@ DataBuffer TLSClient_Impl::encrypt_data(const void *data_ptr, unsigned int data_
 	{
 		throw Exception("Unsupported cipher");
 	}
+
+	if (explicit_iv_size > 0)
+	{
+		DataBuffer record_data(explicit_iv_size + buffer.get_size());
+		memcpy(record_data.get_data(), explicit_iv, explicit_iv_size);
+		memcpy(record_data.get_data() + explicit_iv_size, buffer.get_data(), buffer.get_size());
+		return record_data;
+	}
+
 	memcpy(security_parameters.client_write_iv.get_data(), buffer.get_data() + buffer.get_size() - security_parameters.client_write_iv.get_size(), security_parameters.client_write_iv.get_size());
 	return buffer;
 
@@ -1317,20 +1723,73 @@ Secret TLSClient_Impl::calculate_mac(const void *data_ptr, unsigned int data_siz
 
 void TLSClient_Impl::hash_handshake(const void *data_ptr, unsigned int data_size)
 {
-	client_handshake_md5_hash.add(data_ptr, data_size);
-	client_handshake_sha1_hash.add(data_ptr, data_size);
-	server_handshake_md5_hash.add(data_ptr, data_size);
-	server_handshake_sha1_hash.add(data_ptr, data_size);
+	// The hash function is not known before the server hello, so keep the messages instead
+	int pos = handshake_messages.get_size();
+	if (pos + data_size > handshake_messages.get_capacity())
+		handshake_messages.set_capacity(std::max(pos + data_size, handshake_messages.get_capacity() * 2 + 1024));
+	handshake_messages.set_size(pos + data_size);
+	memcpy(handshake_messages.get_data() + pos, data_ptr, data_size);
+}
+
+Secret TLSClient_Impl::get_handshake_hash() const
+{
+	const void *data_ptr = handshake_messages.get_data();
+	int data_size = handshake_messages.get_size();
+
+	if (security_parameters.prf_algorithm == cl_tls_prf_sha256)
+	{
+		Secret hash(SHA256::hash_size);
+		SHA256 sha256;
+		sha256.add(data_ptr, data_size);
+		sha256.calculate();
+		sha256.get_hash(hash.get_data());
+		return hash;
+	}
+	else if (security_parameters.prf_algorithm == cl_tls_prf_sha384)
+	{
+		Secret hash(SHA384::hash_size);
+		SHA384 sha384;
+		sha384.add(data_ptr, data_size);
+		sha384.calculate();
+		sha384.get_hash(hash.get_data());
+		return hash;
+	}
+	else
+	{
+		// TLS 1.0 and 1.1: MD5(handshake_messages) + SHA-1(handshake_messages)
+		Secret hash(MD5::hash_size + SHA1::hash_size);
+		MD5 md5;
+		md5.add(data_ptr, data_size);
+		md5.calculate();
+		md5.get_hash(hash.get_data());
+		SHA1 sha1;
+		sha1.add(data_ptr, data_size);
+		sha1.calculate();
+		sha1.get_hash(hash.get_data() + MD5::hash_size);
+		return hash;
+	}
 }
 
 DataBuffer TLSClient_Impl::decrypt_data(const void *data_ptr, unsigned int data_size)
 {
+	// TLS 1.1 and later: the initialisation vector is sent in front of each record
+	const unsigned char *iv_ptr = security_parameters.server_write_iv.get_data();
+	const unsigned int explicit_iv_size = security_parameters.record_iv_size;
+	if (explicit_iv_size > 0)
+	{
+		if (data_size < explicit_iv_size)
+			throw Exception("Invalid TLS record length");
+		iv_ptr = (const unsigned char *) data_ptr;
+		data_ptr = iv_ptr + explicit_iv_size;
+		data_size -= explicit_iv_size;
+	}
+
 	DataBuffer buffer;
 	if (security_parameters.bulk_cipher_algorithm == cl_tls_cipher_algorithm_aes128)
 	{
 		AES128_Decrypt decrypt;
 		decrypt.set_padding(true, false);
-		decrypt.set_iv(security_parameters.server_write_iv.get_data());
+		decrypt.set_iv(iv_ptr);
 		decrypt.set_key(security_parameters.server_write_key.get_data());
 		decrypt.add(data_ptr, data_size);
 		decrypt.calculate();
@@ -1340,7 +1799,7 @@ DataBuffer TLSClient_Impl::decrypt_data(const void *data_ptr, unsigned int data_
 	{
 		AES256_Decrypt decrypt;
 		decrypt.set_padding(true, false);
-		decrypt.set_iv(security_parameters.server_write_iv.get_data());
+		decrypt.set_iv(iv_ptr);
 		decrypt.set_key(security_parameters.server_write_key.get_data());
 		decrypt.add(data_ptr, data_size);
 		decrypt.calculate();
@@ -1350,21 +1809,46 @@ DataBuffer TLSClient_Impl::decrypt_data(const void *data_ptr, unsigned int data_
 	{
 		throw Exception("Unsupported cipher");
 	}
-	const unsigned char *last_block = (const unsigned char *) data_ptr;
-	last_block += data_size - security_parameters.server_write_iv.get_size();
-	memcpy(security_parameters.server_write_iv.get_data(), last_block, security_parameters.server_write_iv.get_size());
+	if (explicit_iv_size == 0)
+	{
+		const unsigned char *last_block = (const unsigned char *) data_ptr;
+		last_block += data_size - security_parameters.server_write_iv.get_size();
+		memcpy(security_parameters.server_write_iv.get_data(), last_block, security_parameters.server_write_iv.get_size());
+	}
 	return buffer;
 
 }
 
-DataBuffer TLSClient_Impl::decrypt_record(TLS_Record &record, const DataBuffer &record_data)
+void TLSClient_Impl::decrypt_record(TLS_Record &record, unsigned char *data_ptr, int data_size, const unsigned char *&out_plaintext, int &out_plaintext_size)
 {
-	DataBuffer decrypted = decrypt_data(record_data.get_data(), record_data.get_size());
+	if (security_parameters.cipher_type == cl_tls_cipher_type_aead)
+	{
+		// Explicit nonce, ciphertext and tag. Decrypted in place.
+		int record_iv_size = security_parameters.record_iv_size;
+		int decoded_size = data_size - record_iv_size - AES_GCM::tag_size;
+		if (decoded_size < 0 || decoded_size > (int) max_record_length)
+			throw Exception("Invalid decoded_size");
+
+		unsigned char nonce[AES_GCM::iv_size];
+		unsigned char additional_data[13];
+		set_aead_nonce_and_additional_data(nonce, additional_data, security_parameters.server_write_iv, data_ptr, security_parameters.read_sequence_number, record, decoded_size);
+
+		unsigned char *ciphertext_ptr = data_ptr + record_iv_size;
+		if (!server_write_gcm.decrypt(nonce, additional_data, sizeof(additional_data), ciphertext_ptr, decoded_size, ciphertext_ptr + decoded_size))
+			throw Exception("AES-GCM authentication failed");
+
+		out_plaintext = ciphertext_ptr;
+		out_plaintext_size = decoded_size;
+		return;
+	}
 
-	unsigned char *decrypted_data = (unsigned char *) decrypted.get_data();
+	// Block ciphers decrypt into a buffer of their own
+	cbc_plaintext = decrypt_data(data_ptr, data_size);
 
-	int decoded_size = decrypted.get_size() - security_parameters.hash_size;
-	if (decoded_size < 0)
+	unsigned char *decrypted_data = (unsigned char *) cbc_plaintext.get_data();
+
+	int decoded_size = cbc_plaintext.get_size() - security_parameters.hash_size;
+	if (decoded_size < 0 || decoded_size > (int) max_record_length)
 		throw Exception("Invalid decoded_size");
 
 	// Update the length
@@ -1376,8 +1860,65 @@ DataBuffer TLSClient_Impl::decrypt_record(TLS_Record &record, const DataBuffer &
 	if (memcmp(mac.get_data(), decrypted_data + decoded_size, mac.get_size()))
 		throw Exception("HMAC failed");
 
-	decrypted.set_size(decoded_size);
-	return decrypted;
+	out_plaintext = decrypted_data;
+	out_plaintext_size = decoded_size;
+}
+
+bool TLS_SessionCache::find(const std::string &name, TLS_Session &out_session)
+{
+	MutexSection mutex_lock(&get_mutex());
+	std::map<std::string, TLS_Session> &sessions = get_sessions();
+
+	std::map<std::string, TLS_Session>::iterator it = sessions.find(name);
+	if (it == sessions.end())
+		return false;
+
+	if (System::get_time() - it->second.creation_time > session_lifetime)
+	{
+		sessions.erase(it);
+		return false;
+	}
+
+	out_session = it->second;
+	return true;
+}
+
+void TLS_SessionCache::store(const std::string &name, const TLS_Session &session)
+{
+	MutexSection mutex_lock(&get_mutex());
+	std::map<std::string, TLS_Session> &sessions = get_sessions();
+
+	if (sessions.size() >= max_sessions && sessions.find(name) == sessions.end())
+	{
+		// Make room by forgetting the oldest session
+		std::map<std::string, TLS_Session>::iterator oldest = sessions.begin();
+		for (std::map<std::string, TLS_Session>::iterator it = sessions.begin(); it != sessions.end(); ++it)
+		{
+			if (it->second.creation_time < oldest->second.creation_time)
+				oldest = it;
+		}
+		sessions.erase(oldest);
+	}
+
+	sessions[name] = session;
+}
+
+void TLS_SessionCache::clear()
+{
+	MutexSection mutex_lock(&get_mutex());
+	get_sessions().clear();
+}
+
+Mutex &TLS_SessionCache::get_mutex()
+{
+	static Mutex mutex;
+	return mutex;
+}
+
+std::map<std::string, TLS_Session> &TLS_SessionCache::get_sessions()
+{
+	static std::map<std::string, TLS_Session> sessions;
+	return sessions;
 }
 
 }
@@ -35,7 +35,10 @@
 #include "API/Core/Crypto/random.h"
 #include "API/Core/Crypto/rsa.h"
 #include "API/Core/Crypto/hash_functions.h"
+#include "API/Core/System/mutex.h"
 #include "x509.h"
+#include "aes_gcm.h"
+#include <map>
 
 namespace clan
 {
@@ -61,7 +64,8 @@ enum TLS_BulkCipherAlgorithm
 enum TLS_CipherType
 {
 	cl_tls_cipher_type_stream,
-	cl_tls_cipher_type_block
+	cl_tls_cipher_type_block,
+	cl_tls_cipher_type_aead
 };
 
 enum TLS_MACAlgorithm
@@ -72,6 +76,13 @@ enum TLS_MACAlgorithm
 	cl_tls_mac_algorithm_sha256
 };
 
+enum TLS_PRFAlgorithm
+{
+	cl_tls_prf_md5_sha1,	// TLS 1.0 and 1.1
+	cl_tls_prf_sha256,
+	cl_tls_prf_sha384
+};
+
 enum TLS_CompressionMethod
 {
 	cl_tls_compression_null = 0
@@ -81,6 +92,7 @@ enum TLS_HandshakeType {
 	cl_tls_handshake_hello_request = 0,
 	cl_tls_handshake_client_hello = 1, 
 	cl_tls_handshake_server_hello = 2,
+	cl_tls_handshake_new_session_ticket = 4,	// RFC 5077
 	cl_tls_handshake_certificate = 11, 
 	cl_tls_handshake_server_key_exchange = 12,
 	cl_tls_handshake_certificate_request = 13,
@@ -169,10 +181,15 @@ public:
 		key_size = 0;
 		key_material_length = 0;
 		iv_size = 0;
+		record_iv_size = 0;
 		is_exportable = false;
 		mac_algorithm = cl_tls_mac_algorithm_null;
 		hash_size = 0;
+		prf_algorithm = cl_tls_prf_md5_sha1;
 		compression_algorithm = cl_tls_compression_null;
+		cipher_suite[0] = 0;
+		cipher_suite[1] = 0;
+		session_id = Secret();
 		master_secret = Secret(48);
 		client_random = Secret(32);
 		server_random = Secret(32);
@@ -194,11 +211,15 @@ public:
 	TLS_CipherType cipher_type;
 	ubyte8 key_size;
 	ubyte8 key_material_length;
-	ubyte8 iv_size;
+	ubyte8 iv_size;			// Implicit IV or salt taken from the key block
+	ubyte8 record_iv_size;	// Explicit IV or nonce sent in front of each record
 	bool is_exportable;
 	TLS_MACAlgorithm mac_algorithm;
 	ubyte8 hash_size;
+	TLS_PRFAlgorithm prf_algorithm;
 	TLS_CompressionMethod compression_algorithm;
+	ubyte8 cipher_suite[2];
+	Secret session_id;
 	Secret master_secret;
 	Secret client_random;
 	Secret server_random;
@@ -217,6 +238,48 @@ public:
 
 };
 
+/// \brief A negotiated TLS session a later connection can resume
+class TLS_Session
+{
+public:
+	TLS_Session() : creation_time(0)
+	{
+		protocol.major = 0;
+		protocol.minor = 0;
+		cipher_suite[0] = 0;
+		cipher_suite[1] = 0;
+	}
+
+	TLS_ProtocolVersion protocol;
+	ubyte8 cipher_suite[2];
+	Secret session_id;
+	DataBuffer session_ticket;
+	Secret master_secret;
+	ubyte64 creation_time;
+};
+
+/// \brief Sessions negotiated by TLSClient, shared by all connections in the process
+///
+/// Sessions are found by a name, normally the address and port of the server.
+class TLS_SessionCache
+{
+public:
+	/// \brief Finds an unexpired session. Returns false if none was found.
+	static bool find(const std::string &name, TLS_Session &out_session);
+
+	/// \brief Stores a session, replacing any earlier session with the same name
+	static void store(const std::string &name, const TLS_Session &session);
+
+	static void clear();
+
+	static const int max_sessions = 256;
+	static const int session_lifetime = 2*60*60*1000;	// Milliseconds. RFC 5246 suggests no more than 24 hours.
+
+private:
+	static Mutex &get_mutex();
+	static std::map<std::string, TLS_Session> &get_sessions();
+};
+
 enum TLS_ConversationState
 {
 	cl_tls_state_send_client_hello,
@@ -250,22 +313,31 @@ public:
 	void decrypted_data_consumed(int size);
 	void encrypted_data_consumed(int size);
 
+	void *get_decrypt_buffer(int &out_size);
+	void decrypt_buffer_filled(int size);
+
+	void set_session_name(const std::string &name);
+	bool is_session_resumed() const;
+	bool is_closed() const;
+
 private:
 	void progress_conversation();
 
 	bool can_send_record() const;
-	void send_record(void *data_ptr, unsigned int data_size);	// !< Note "data_ptr" may be written to
+	void send_record(const void *data_ptr, unsigned int data_size);
+	void write_record(TLS_ContentType content_type, const void *data_ptr, unsigned int data_size);	// !< Encrypts directly into send_out_data
 
 	bool receive_record();
 
-	void change_cipher_spec_data(DataBuffer record_plaintext);
-	void alert_data(DataBuffer record_plaintext);
-	void handshake_data(DataBuffer record_plaintext);
-	void application_data(DataBuffer record_plaintext);
+	void change_cipher_spec_data(const unsigned char *data, int size);
+	void alert_data(const unsigned char *data, int size);
+	void handshake_data(const unsigned char *data, int size);
+	void application_data(const unsigned char *data, int size);
 
 	void handshake_hello_request_received(const void *data, int size);
 	void handshake_client_hello_received(const void *data, int size);
 	void handshake_server_hello_received(const void *data, int size);
+	void handshake_new_session_ticket_received(const void *data, int size);
 	void handshake_certificate_received(const void *data, int size);
 	void handshake_server_key_exchange_received(const void *data, int size);
 	void handshake_certificate_request_received(const void *data, int size);
@@ -295,21 +367,29 @@ private:
 	void set_compression_methods(unsigned char *dest_ptr) const;
 	int get_cipher_suites_length() const;
 	void set_cipher_suites(unsigned char *dest_ptr) const;
+	int get_extensions_length() const;
+	void set_extensions(unsigned char *dest_ptr) const;
 	void select_cipher_suite(ubyte8 value1, ubyte8 value2);
 	void select_compression_method(ubyte8 value);
+	void select_extensions(const void *data, int size);
 	void inspect_certificate(std::vector<unsigned char> &cert);
 	void set_server_public_key();
 	void PRF(void *output_ptr, unsigned int output_size, const Secret &secret, const char *label_ptr, const Secret &seed_part1, const Secret &seed_part2);
 	void hash_handshake(const void *data_ptr, unsigned int data_size);
+	Secret get_handshake_hash() const;
+	void create_keys();
+	void store_session();
 
-	DataBuffer decrypt_record(TLS_Record &record, const DataBuffer &record_data);
+	void decrypt_record(TLS_Record &record, unsigned char *data_ptr, int data_size, const unsigned char *&out_plaintext, int &out_plaintext_size);
 	DataBuffer decrypt_data(const void *data_ptr, unsigned int data_size);
 
 	Secret calculate_mac(const void *data_ptr, unsigned int data_size, const void *data2_ptr, unsigned int data2_size, ubyte64 sequence_number, const Secret &mac_secret);
 	DataBuffer encrypt_data(const void *data_ptr, unsigned int data_size, const void *mac_ptr, unsigned int mac_size);
+	void set_aead_nonce_and_additional_data(unsigned char *out_nonce, unsigned char *out_additional_data, const Secret &write_iv, const unsigned char *record_nonce, ubyte64 sequence_number, const TLS_Record &record, unsigned int plaintext_size) const;
 
-	static const unsigned int max_record_length = 2<<14;	// RFC 2246 (6.2.1)
-	static const unsigned int max_handshake_length = 2<<24;	// RFC 2246 (implied by length in7.4)
+	static const unsigned int max_record_length = 1<<14;	// RFC 2246 (6.2.1)
+	static const unsigned int max_ciphertext_length = max_record_length + 2048;	// RFC 2246 (6.2.3)
+	static const unsigned int max_handshake_length = 1<<24;	// RFC 2246 (implied by length in7.4)
 
 	static const int desired_buffer_size = 64*1024;
 
@@ -330,10 +410,13 @@ private:
 
 	TLS_ConversationState conversation_state;
 
-	DataBuffer record_data_buffer; // local variable of receive_record(). Placed here to avoid allocating memory each time a record is processed
-
 	TLS_SecurityParameters security_parameters;
 	TLS_ProtocolVersion protocol;
+	TLS_ProtocolVersion client_hello_protocol;	// Highest version supported, also sent in the pre-master secret
+
+	AES_GCM client_write_gcm;
+	AES_GCM server_write_gcm;
+	DataBuffer cbc_plaintext;	// Output of decrypt_data() for the block cipher suites
 
 	DataBuffer server_public_exponent;
 	DataBuffer server_public_modulus;
@@ -342,12 +425,18 @@ private:
 
 	Random m_Random;
 
-	MD5 client_handshake_md5_hash;
-	SHA1 client_handshake_sha1_hash;
-	MD5 server_handshake_md5_hash;
-	SHA1 server_handshake_sha1_hash;
+	/// \brief All handshake messages so far, hashed for the finished messages once the PRF is known
+	DataBuffer handshake_messages;
 
 	std::vector<X509> certificate_chain;
+
+	std::string session_name;
+	TLS_Session resume_session;	// Session offered in the client hello
+	Secret client_hello_session_id;
+	bool session_resumed;
+	bool session_ticket_expected;
+	DataBuffer new_session_ticket;
+	bool close_notify_received;
 };
 
 }
@@ -85,7 +85,7 @@ FileSystem::FileSystem(const std::string &path, bool is_zip_file)
 : impl(new FileSystem_Impl)
 {
 	if (is_zip_file)
-		impl->provider = new FileSystemProvider_Zip(ZipArchive(path));
+		impl->provider = new FileSystemProvider_Zip(ZipArchive(path, true));
 	else
 		impl->provider = new FileSystemProvider_File(path);
 }
@@ -230,7 +230,7 @@ void FileSystem::mount(const std::string &mount_point, FileSystem fs)
 void FileSystem::mount(const std::string &mount_point, const std::string &path, bool is_zip_file)
 {
 	if (is_zip_file)
-		mount(mount_point, FileSystem(new FileSystemProvider_Zip(ZipArchive(path))));
+		mount(mount_point, FileSystem(new FileSystemProvider_Zip(ZipArchive(path, true))));
 	else
 		mount(mount_point, FileSystem(new FileSystemProvider_File(path)));
 }
@@ -0,0 +1,409 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Magnus Norddahl
+*/
+
+
+#include "Core/precomp.h"
+#include "API/Core/JSON/json_document.h"
+#include <vector>
+
+namespace clan
+{
+
+class JsonDocument_Node
+{
+public:
+	JsonValue::Type type;
+
+	/// \brief Number of members, items or string bytes
+	unsigned int size;
+
+	union
+	{
+		double number;
+		bool boolean;
+
+		/// \brief Index of the first item, or the first member name followed by its value
+		int first_child;
+
+		const char *string;
+	};
+};
+
+class JsonDocument_Impl
+{
+public:
+	JsonDocument_Impl() : root(-1), arena_used(0), arena_size(0), arena_total(0) { }
+	~JsonDocument_Impl();
+
+	void parse(JsonReader &reader);
+	const char *copy_string(const JsonStringView &text);
+	const JsonDocument_Node &get_node(int index) const { return nodes[index]; }
+
+	std::vector<JsonDocument_Node> nodes;
+	int root;
+
+	/// \brief Copy of the JSON data for documents created with from_json
+	std::string source;
+
+	/// \brief Blocks strings with escapes or strings from a device are copied to
+	std::vector<char *> arena_blocks;
+	size_t arena_used;
+	size_t arena_size;
+	size_t arena_total;
+
+	static const size_t arena_block_size = 64 * 1024;
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// JsonDocument Construction:
+
+JsonDocument::JsonDocument()
+: impl(new JsonDocument_Impl)
+{
+}
+
+JsonDocument::JsonDocument(const void *data, size_t size)
+: impl(new JsonDocument_Impl)
+{
+	JsonReader reader(data, size);
+	impl->parse(reader);
+}
+
+JsonDocument::JsonDocument(IODevice &device)
+: impl(new JsonDocument_Impl)
+{
+	JsonReader reader(device);
+	impl->parse(reader);
+}
+
+JsonDocument JsonDocument::from_json(const std::string &json)
+{
+	JsonDocument document;
+	document.impl->source = json;
+	JsonReader reader(document.impl->source.data(), document.impl->source.length());
+	document.impl->parse(reader);
+	return document;
+}
+
+JsonDocument::~JsonDocument()
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// JsonDocument Attributes:
+
+JsonElement JsonDocument::get_root() const
+{
+	return JsonElement(impl.get(), impl->root);
+}
+
+size_t JsonDocument::get_memory_usage() const
+{
+	return impl->nodes.capacity() * sizeof(JsonDocument_Node) + impl->arena_total + impl->source.capacity();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// JsonElement Attributes:
+
+JsonValue::Type JsonElement::get_type() const
+{
+	if (index == -1)
+		return JsonValue::type_null;
+	return document->get_node(index).type;
+}
+
+size_t JsonElement::get_size() const
+{
+	if (index == -1)
+		return 0;
+	const JsonDocument_Node &node = document->get_node(index);
+	switch (node.type)
+	{
+	case JsonValue::type_object:
+	case JsonValue::type_array:
+	case JsonValue::type_string:
+		return node.size;
+	default:
+		return 0;
+	}
+}
+
+JsonElement JsonElement::operator[](int item_index) const
+{
+	if (get_type() != JsonValue::type_array)
+		throw JsonException("JSON Value is not an array");
+	const JsonDocument_Node &node = document->get_node(index);
+	if (item_index < 0 || (unsigned int)item_index >= node.size)
+		throw JsonException("JSON array index out of range");
+	return JsonElement(document, node.first_child + item_index);
+}
+
+JsonElement JsonElement::operator[](const char *name) const
+{
+	return find_member(name, strlen(name));
+}
+
+JsonElement JsonElement::operator[](const std::string &name) const
+{
+	return find_member(name.data(), name.length());
+}
+
+bool JsonElement::has_member(const std::string &name) const
+{
+	return find_member(name.data(), name.length()).index != -1;
+}
+
+JsonStringView JsonElement::get_member_name(int member_index) const
+{
+	if (get_type() != JsonValue::type_object)
+		throw JsonException("JSON Value is not an object");
+	const JsonDocument_Node &node = document->get_node(index);
+	if (member_index < 0 || (unsigned int)member_index >= node.size)
+		throw JsonException("JSON member index out of range");
+	const JsonDocument_Node &name = document->get_node(node.first_child + member_index * 2);
+	return JsonStringView(name.string, name.size);
+}
+
+JsonElement JsonElement::get_member_value(int member_index) const
+{
+	if (get_type() != JsonValue::type_object)
+		throw JsonException("JSON Value is not an object");
+	const JsonDocument_Node &node = document->get_node(index);
+	if (member_index < 0 || (unsigned int)member_index >= node.size)
+		throw JsonException("JSON member index out of range");
+	return JsonElement(document, node.first_child + member_index * 2 + 1);
+}
+
+JsonStringView JsonElement::get_string() const
+{
+	if (get_type() != JsonValue::type_string)
+		throw JsonException("JSON Value is not a string");
+	const JsonDocument_Node &node = document->get_node(index);
+	return JsonStringView(node.string, node.size);
+}
+
+std::string JsonElement::to_string() const
+{
+	return get_string().to_string();
+}
+
+int JsonElement::to_int() const
+{
+	return (int)to_double();
+}
+
+float JsonElement::to_float() const
+{
+	return (float)to_double();
+}
+
+double JsonElement::to_double() const
+{
+	if (get_type() != JsonValue::type_number)
+		throw JsonException("JSON Value is not a number");
+	return document->get_node(index).number;
+}
+
+bool JsonElement::to_boolean() const
+{
+	if (get_type() != JsonValue::type_boolean)
+		throw JsonException("JSON Value is not a boolean");
+	return document->get_node(index).boolean;
+}
+
+JsonValue JsonElement::to_value() const
+{
+	switch (get_type())
+	{
+	default:
+	case JsonValue::type_null:
+		return JsonValue::null();
+	case JsonValue::type_object:
+		{
+			JsonValue value = JsonValue::object();
+			size_t size = get_size();
+			for (size_t i = 0; i < size; i++)
+				value[get_member_name(i).to_string()] = get_member_value(i).to_value();
+			return value;
+		}
+	case JsonValue::type_array:
+		{
+			JsonValue value = JsonValue::array();
+			size_t size = get_size();
+			value.get_items().reserve(size);
+			for (size_t i = 0; i < size; i++)
+				value.get_items().push_back((*this)[i].to_value());
+			return value;
+		}
+	case JsonValue::type_string:
+		return JsonValue::string(to_string());
+	case JsonValue::type_number:
+		return JsonValue::number(to_double());
+	case JsonValue::type_boolean:
+		return JsonValue::boolean(to_boolean());
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// JsonElement Implementation:
+
+JsonElement JsonElement::find_member(const char *name, size_t length) const
+{
+	if (get_type() != JsonValue::type_object)
+		throw JsonException("JSON Value is not an object");
+
+	const JsonDocument_Node &node = document->get_node(index);
+	int end = node.first_child + node.size * 2;
+	for (int i = node.first_child; i < end; i += 2)
+	{
+		const JsonDocument_Node &member_name = document->get_node(i);
+		if (member_name.size == length && memcmp(member_name.string, name, length) == 0)
+			return JsonElement(document, i + 1);
+	}
+	return JsonElement();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// JsonDocument_Impl Implementation:
+
+JsonDocument_Impl::~JsonDocument_Impl()
+{
+	for (size_t i = 0; i < arena_blocks.size(); i++)
+		delete[] arena_blocks[i];
+}
+
+void JsonDocument_Impl::parse(JsonReader &reader)
+{
+	// Values are collected here until their object or array ends. They are then
+	// moved to the end of nodes, which keeps the children of each object and
+	// array next to each other.
+	std::vector<JsonDocument_Node> pending;
+	std::vector<size_t> containers;
+
+	JsonDocument_Node node;
+	while (true)
+	{
+		JsonReader::Token token = reader.next();
+		switch (token)
+		{
+		case JsonReader::token_end:
+			break;
+
+		case JsonReader::token_begin_object:
+		case JsonReader::token_begin_array:
+			containers.push_back(pending.size());
+			continue;
+
+		case JsonReader::token_end_object:
+		case JsonReader::token_end_array:
+			{
+				size_t start = containers.back();
+				containers.pop_back();
+
+				node.type = (token == JsonReader::token_end_object) ? JsonValue::type_object : JsonValue::type_array;
+				node.size = pending.size() - start;
+				if (token == JsonReader::token_end_object)
+					node.size /= 2;
+				node.first_child = nodes.size();
+
+				nodes.insert(nodes.end(), pending.begin() + start, pending.end());
+				pending.resize(start);
+				pending.push_back(node);
+			}
+			continue;
+
+		case JsonReader::token_member_name:
+		case JsonReader::token_string:
+			{
+				JsonStringView text = reader.get_string();
+				node.type = JsonValue::type_string;
+				node.size = text.length;
+				node.string = reader.is_string_in_source() ? text.data : copy_string(text);
+				pending.push_back(node);
+			}
+			continue;
+
+		case JsonReader::token_number:
+			node.type = JsonValue::type_number;
+			node.size = 0;
+			node.number = reader.get_number();
+			pending.push_back(node);
+			continue;
+
+		case JsonReader::token_boolean:
+			node.type = JsonValue::type_boolean;
+			node.size = 0;
+			node.boolean = reader.get_boolean();
+			pending.push_back(node);
+			continue;
+
+		case JsonReader::token_null:
+			node.type = JsonValue::type_null;
+			node.size = 0;
+			node.first_child = 0;
+			pending.push_back(node);
+			continue;
+		}
+		break;
+	}
+
+	nodes.push_back(pending.back());
+	root = nodes.size() - 1;
+}
+
+const char *JsonDocument_Impl::copy_string(const JsonStringView &text)
+{
+	if (text.length == 0)
+		return "";
+
+	if (text.length > arena_size - arena_used)
+	{
+		size_t block_size = text.length > arena_block_size / 4 ? text.length : arena_block_size;
+		char *block = new char[block_size];
+		arena_total += block_size;
+
+		// Keep filling the current block if the string got a block of its own
+		if (block_size != arena_block_size && !arena_blocks.empty())
+		{
+			arena_blocks.insert(arena_blocks.end() - 1, block);
+			memcpy(block, text.data, text.length);
+			return block;
+		}
+
+		arena_blocks.push_back(block);
+		arena_used = 0;
+		arena_size = block_size;
+	}
+
+	char *string = arena_blocks.back() + arena_used;
+	memcpy(string, text.data, text.length);
+	arena_used += text.length;
+	return string;
+}
+
+}
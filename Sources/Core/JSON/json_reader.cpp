@@ -0,0 +1,617 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Magnus Norddahl
+*/
+
+
+#include "Core/precomp.h"
+#include "API/Core/JSON/json_reader.h"
+#include "API/Core/IOData/iodevice.h"
+#include "API/Core/Text/string_help.h"
+#include <vector>
+#include <cstdlib>
+#include <clocale>
+
+namespace clan
+{
+
+class JsonReader_Impl
+{
+public:
+	enum State
+	{
+		state_value,
+		state_first_member,
+		state_member,
+		state_colon,
+		state_first_item,
+		state_after_value,
+		state_done
+	};
+
+	JsonReader_Impl() : device(0), data(0), length(0), pos(0), token_start(0), stream_offset(0), token_offset(0),
+		state(state_value), token(JsonReader::token_end), string_in_source(false), number(0.0), boolean(false)
+	{
+	}
+
+	JsonReader::Token next();
+	void skip();
+
+	int get_depth() const
+	{
+		int depth = stack.size();
+		if (token == JsonReader::token_begin_object || token == JsonReader::token_begin_array)
+			depth--;
+		return depth;
+	}
+
+	IODevice *device;
+	std::vector<char> buffer;
+
+	const char *data;
+	size_t length;
+	size_t pos;
+
+	/// \brief Start of the data that must stay in the buffer when it is refilled
+	size_t token_start;
+
+	/// \brief Offset in the JSON data of data[0]
+	size_t stream_offset;
+
+	size_t token_offset;
+
+	/// \brief '{' or '[' for each enclosing object or array
+	std::vector<char> stack;
+	State state;
+
+	JsonReader::Token token;
+	JsonStringView string;
+	bool string_in_source;
+	double number;
+	bool boolean;
+
+	/// \brief Decoded text of strings containing escapes
+	std::string scratch;
+
+private:
+	bool read_more();
+	int peek();
+	void skip_whitespace();
+	JsonReader::Token read_value();
+	JsonReader::Token read_string(JsonReader::Token string_token);
+	JsonReader::Token read_number();
+	JsonReader::Token read_literal(const char *text, size_t text_length, JsonReader::Token literal_token);
+	unsigned int read_hex(size_t offset);
+	void require(size_t count);
+	void begin_token();
+
+	static void throw_unexpected_end() { throw JsonException("Unexpected end of JSON data"); }
+	static void throw_unexpected_character() { throw JsonException("Unexpected character in JSON data"); }
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// JsonReader Construction:
+
+JsonReader::JsonReader(const void *data, size_t size)
+: impl(new JsonReader_Impl)
+{
+	impl->data = static_cast<const char *>(data);
+	impl->length = size;
+}
+
+JsonReader::JsonReader(IODevice &device, int buffer_size)
+: impl(new JsonReader_Impl)
+{
+	impl->device = &device;
+	impl->buffer.resize(buffer_size > 16 ? buffer_size : 16);
+	impl->data = &impl->buffer[0];
+}
+
+JsonReader::~JsonReader()
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// JsonReader Attributes:
+
+JsonReader::Token JsonReader::get_token() const
+{
+	return impl->token;
+}
+
+JsonStringView JsonReader::get_string() const
+{
+	if (impl->token != token_member_name && impl->token != token_string)
+		throw JsonException("JSON token is not a string");
+	return impl->string;
+}
+
+bool JsonReader::is_string_in_source() const
+{
+	return impl->string_in_source;
+}
+
+double JsonReader::get_number() const
+{
+	if (impl->token != token_number)
+		throw JsonException("JSON token is not a number");
+	return impl->number;
+}
+
+bool JsonReader::get_boolean() const
+{
+	if (impl->token != token_boolean)
+		throw JsonException("JSON token is not a boolean");
+	return impl->boolean;
+}
+
+int JsonReader::get_depth() const
+{
+	return impl->get_depth();
+}
+
+size_t JsonReader::get_offset() const
+{
+	return impl->token_offset;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// JsonReader Operations:
+
+JsonReader::Token JsonReader::next()
+{
+	return impl->next();
+}
+
+void JsonReader::skip()
+{
+	impl->skip();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// JsonReader_Impl Implementation:
+
+JsonReader::Token JsonReader_Impl::next()
+{
+	skip_whitespace();
+	begin_token();
+
+	while (true)
+	{
+		switch (state)
+		{
+		case state_value:
+			token = read_value();
+			return token;
+
+		case state_first_member:
+			if (peek() == '}')
+			{
+				pos++;
+				stack.pop_back();
+				state = state_after_value;
+				token = JsonReader::token_end_object;
+				return token;
+			}
+			state = state_member;
+			break;
+
+		case state_member:
+			if (peek() != '"')
+				throw_unexpected_character();
+			token = read_string(JsonReader::token_member_name);
+			state = state_colon;
+			return token;
+
+		case state_colon:
+			if (peek() != ':')
+				throw_unexpected_character();
+			pos++;
+			skip_whitespace();
+			begin_token();
+			state = state_value;
+			break;
+
+		case state_first_item:
+			if (peek() == ']')
+			{
+				pos++;
+				stack.pop_back();
+				state = state_after_value;
+				token = JsonReader::token_end_array;
+				return token;
+			}
+			state = state_value;
+			break;
+
+		case state_after_value:
+			if (stack.empty())
+			{
+				// Only whitespace may follow the top level value
+				if (peek() != -1)
+					throw_unexpected_character();
+				state = state_done;
+				break;
+			}
+			else
+			{
+				int c = peek();
+				char container = stack.back();
+				if (c == ',')
+				{
+					pos++;
+					skip_whitespace();
+					begin_token();
+					state = (container == '{') ? state_member : state_value;
+				}
+				else if (c == '}' && container == '{')
+				{
+					pos++;
+					stack.pop_back();
+					token = JsonReader::token_end_object;
+					return token;
+				}
+				else if (c == ']' && container == '[')
+				{
+					pos++;
+					stack.pop_back();
+					token = JsonReader::token_end_array;
+					return token;
+				}
+				else if (c == -1)
+				{
+					throw_unexpected_end();
+				}
+				else
+				{
+					throw_unexpected_character();
+				}
+			}
+			break;
+
+		case state_done:
+			token = JsonReader::token_end;
+			return token;
+		}
+	}
+}
+
+void JsonReader_Impl::skip()
+{
+	if (token != JsonReader::token_begin_object && token != JsonReader::token_begin_array)
+		return;
+
+	size_t depth = stack.size();
+	while (stack.size() >= depth)
+		next();
+}
+
+JsonReader::Token JsonReader_Impl::read_value()
+{
+	state = state_after_value;
+	switch (peek())
+	{
+	case '{':
+		pos++;
+		stack.push_back('{');
+		state = state_first_member;
+		return JsonReader::token_begin_object;
+	case '[':
+		pos++;
+		stack.push_back('[');
+		state = state_first_item;
+		return JsonReader::token_begin_array;
+	case '"':
+		return read_string(JsonReader::token_string);
+	case '-':
+	case '0':
+	case '1':
+	case '2':
+	case '3':
+	case '4':
+	case '5':
+	case '6':
+	case '7':
+	case '8':
+	case '9':
+		return read_number();
+	case 't':
+		boolean = true;
+		return read_literal("true", 4, JsonReader::token_boolean);
+	case 'f':
+		boolean = false;
+		return read_literal("false", 5, JsonReader::token_boolean);
+	case 'n':
+		return read_literal("null", 4, JsonReader::token_null);
+	case -1:
+		throw_unexpected_end();
+	default:
+		throw_unexpected_character();
+	}
+	return JsonReader::token_end;
+}
+
+JsonReader::Token JsonReader_Impl::read_string(JsonReader::Token string_token)
+{
+	pos++;
+	token_start = pos;
+
+	bool escaped = false;
+	scratch.clear();
+
+	while (true)
+	{
+		const char *d = data;
+		size_t p = pos;
+		size_t end = length;
+		while (p != end && d[p] != '"' && d[p] != '\\' && (unsigned char) d[p] >= 0x20)
+			p++;
+		pos = p;
+
+		if (p == end)
+		{
+			if (!read_more())
+				throw_unexpected_end();
+			continue;
+		}
+
+		// Control characters must be escaped
+		if ((unsigned char) d[p] < 0x20)
+			throw_unexpected_character();
+
+		if (d[p] == '"')
+		{
+			if (!escaped)
+			{
+				string = JsonStringView(data + token_start, pos - token_start);
+				string_in_source = (device == 0);
+			}
+			else
+			{
+				scratch.append(data + token_start, pos - token_start);
+				string = JsonStringView(scratch.data(), scratch.length());
+				string_in_source = false;
+			}
+			pos++;
+			return string_token;
+		}
+
+		// Everything up to the escape is moved to scratch, so the buffer only has to keep the rest
+		escaped = true;
+		scratch.append(data + token_start, pos - token_start);
+		token_start = pos;
+
+		require(2);
+		switch (data[pos + 1])
+		{
+		case '"': scratch.push_back('"'); break;
+		case '\\': scratch.push_back('\\'); break;
+		case '/': scratch.push_back('/'); break;
+		case 'b': scratch.push_back('\b'); break;
+		case 'f': scratch.push_back('\f'); break;
+		case 'n': scratch.push_back('\n'); break;
+		case 'r': scratch.push_back('\r'); break;
+		case 't': scratch.push_back('\t'); break;
+		case 'u':
+			{
+				require(6);
+				unsigned int code = read_hex(pos + 2);
+				if (code >= 0xd800 && code < 0xdc00)
+				{
+					// UTF-16 surrogate pair
+					require(12);
+					if (data[pos + 6] != '\\' || data[pos + 7] != 'u')
+						throw JsonException("Invalid unicode escape in JSON data");
+					unsigned int low = read_hex(pos + 8);
+					if (low < 0xdc00 || low >= 0xe000)
+						throw JsonException("Invalid unicode escape in JSON data");
+					code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+					pos += 6;
+				}
+				else if (code >= 0xdc00 && code < 0xe000)
+				{
+					// Low surrogate without a high surrogate before it
+					throw JsonException("Invalid unicode escape in JSON data");
+				}
+				scratch += StringHelp::unicode_to_utf8(code);
+				pos += 4;
+			}
+			break;
+		default:
+			throw_unexpected_character();
+		}
+		pos += 2;
+		token_start = pos;
+	}
+}
+
+JsonReader::Token JsonReader_Impl::read_number()
+{
+	token_start = pos;
+	while (true)
+	{
+		const char *d = data;
+		size_t p = pos;
+		size_t end = length;
+		while (p != end && ((d[p] >= '0' && d[p] <= '9') || d[p] == '-' || d[p] == '+' || d[p] == '.' || d[p] == 'e' || d[p] == 'E'))
+			p++;
+		pos = p;
+		if (p != end || !read_more())
+			break;
+	}
+
+	const char *text = data + token_start;
+	size_t text_length = pos - token_start;
+
+	// Plain integers are by far the most common
+	size_t i = (text[0] == '-') ? 1 : 0;
+	if (text_length > i && text_length - i <= 18)
+	{
+		byte64 value = 0;
+		while (i != text_length && text[i] >= '0' && text[i] <= '9')
+			value = value * 10 + (text[i++] - '0');
+		if (i == text_length)
+		{
+			number = (double) ((text[0] == '-') ? -value : value);
+			return JsonReader::token_number;
+		}
+	}
+
+	char local_buffer[64];
+	std::string long_buffer;
+	char *number_text = local_buffer;
+	if (text_length >= sizeof(local_buffer))
+	{
+		long_buffer.assign(text, text_length);
+		number_text = &long_buffer[0];
+	}
+	else
+	{
+		memcpy(local_buffer, text, text_length);
+		local_buffer[text_length] = 0;
+	}
+
+	// strtod expects the decimal point of the current locale
+	char decimal_point = *localeconv()->decimal_point;
+	if (decimal_point != '.')
+	{
+		char *point = strchr(number_text, '.');
+		if (point)
+			*point = decimal_point;
+	}
+
+	char *number_end = 0;
+	number = strtod(number_text, &number_end);
+	if (number_end != number_text + text_length || text_length == 0)
+		throw_unexpected_character();
+	return JsonReader::token_number;
+}
+
+JsonReader::Token JsonReader_Impl::read_literal(const char *text, size_t text_length, JsonReader::Token literal_token)
+{
+	token_start = pos;
+	while (length - pos < text_length)
+	{
+		if (!read_more())
+			throw_unexpected_end();
+	}
+	if (memcmp(data + pos, text, text_length) != 0)
+		throw_unexpected_character();
+	pos += text_length;
+	return literal_token;
+}
+
+unsigned int JsonReader_Impl::read_hex(size_t offset)
+{
+	unsigned int value = 0;
+	for (size_t i = offset; i < offset + 4; i++)
+	{
+		char c = data[i];
+		value <<= 4;
+		if (c >= '0' && c <= '9')
+			value += c - '0';
+		else if (c >= 'a' && c <= 'f')
+			value += c - 'a' + 10;
+		else if (c >= 'A' && c <= 'F')
+			value += c - 'A' + 10;
+		else
+			throw JsonException("Invalid unicode escape in JSON data");
+	}
+	return value;
+}
+
+void JsonReader_Impl::require(size_t count)
+{
+	while (length - pos < count)
+	{
+		if (!read_more())
+			throw_unexpected_end();
+	}
+}
+
+int JsonReader_Impl::peek()
+{
+	if (pos == length)
+	{
+		token_start = pos;
+		if (!read_more())
+			return -1;
+	}
+	return (unsigned char) data[pos];
+}
+
+void JsonReader_Impl::skip_whitespace()
+{
+	while (true)
+	{
+		const char *d = data;
+		size_t p = pos;
+		size_t end = length;
+		while (p != end && (d[p] == ' ' || d[p] == '\n' || d[p] == '\r' || d[p] == '\t'))
+			p++;
+		pos = p;
+
+		if (p != end)
+			break;
+
+		token_start = pos;
+		if (!read_more())
+			break;
+	}
+}
+
+void JsonReader_Impl::begin_token()
+{
+	token_start = pos;
+	token_offset = stream_offset + pos;
+}
+
+bool JsonReader_Impl::read_more()
+{
+	if (device == 0)
+		return false;
+
+	if (token_start > 0)
+	{
+		memmove(&buffer[0], &buffer[token_start], length - token_start);
+		length -= token_start;
+		pos -= token_start;
+		stream_offset += token_start;
+		token_start = 0;
+	}
+
+	if (length == buffer.size())
+		buffer.resize(buffer.size() * 2);
+	data = &buffer[0];
+
+	int received = device->read(&buffer[length], buffer.size() - length, false);
+	if (received <= 0)
+		return false;
+	length += received;
+	return true;
+}
+
+}
@@ -0,0 +1,370 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Magnus Norddahl
+*/
+
+
+#include "Core/precomp.h"
+#include "API/Core/JSON/json_writer.h"
+#include "API/Core/IOData/iodevice.h"
+#include <vector>
+#include <cstdio>
+#include <clocale>
+
+namespace clan
+{
+
+/// \brief Formats a number, returning the length. Integers are written without a fraction.
+static int format_json_number(double value, char *buf)
+{
+	if (value >= -2147483648.0 && value <= 2147483647.0 && value == (double)(int)value)
+		return sprintf(buf, "%d", (int)value);
+	else if (value - value != 0.0)
+		return sprintf(buf, "null");	// JSON has no infinity or NaN
+
+	// sprintf uses the decimal point of the current locale
+	int length = sprintf(buf, "%.17g", value);
+	char decimal_point = *localeconv()->decimal_point;
+	if (decimal_point != '.')
+	{
+		char *point = strchr(buf, decimal_point);
+		if (point)
+			*point = '.';
+	}
+	return length;
+}
+
+class JsonWriter_Impl
+{
+public:
+	JsonWriter_Impl(IODevice &device, int buffer_size) : device(device), used(0), need_comma(false), need_value(false)
+	{
+		buffer.resize(buffer_size > 64 ? buffer_size : 64);
+	}
+
+	void begin_value();
+	void begin_container(char container);
+	void end_container(char container);
+	void write_string(const char *text, size_t length);
+	void write_value(const JsonValue &value);
+
+	void write_raw(const char *text, size_t length)
+	{
+		if (length <= buffer.size() - used)
+		{
+			memcpy(&buffer[used], text, length);
+			used += length;
+		}
+		else
+		{
+			flush();
+			if (length < buffer.size())
+			{
+				memcpy(&buffer[0], text, length);
+				used = length;
+			}
+			else
+			{
+				device.write(text, length);
+			}
+		}
+	}
+
+	void write_char(char c)
+	{
+		if (used == buffer.size())
+			flush();
+		buffer[used++] = c;
+	}
+
+	void flush()
+	{
+		if (used != 0)
+		{
+			device.write(&buffer[0], used);
+			used = 0;
+		}
+	}
+
+	IODevice &device;
+	std::vector<char> buffer;
+	size_t used;
+
+	/// \brief '{' or '[' for each open object or array
+	std::vector<char> stack;
+
+	/// \brief A value was written in the current object or array
+	bool need_comma;
+
+	/// \brief A member name was written and its value is next
+	bool need_value;
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// JsonWriter Construction:
+
+JsonWriter::JsonWriter(IODevice &device, int buffer_size)
+: impl(new JsonWriter_Impl(device, buffer_size))
+{
+}
+
+JsonWriter::~JsonWriter()
+{
+	impl->flush();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// JsonWriter Operations:
+
+void JsonWriter::begin_object()
+{
+	impl->begin_container('{');
+}
+
+void JsonWriter::end_object()
+{
+	impl->end_container('{');
+}
+
+void JsonWriter::begin_array()
+{
+	impl->begin_container('[');
+}
+
+void JsonWriter::end_array()
+{
+	impl->end_container('[');
+}
+
+void JsonWriter::write_member_name(const std::string &name)
+{
+	write_member_name(JsonStringView(name.data(), name.length()));
+}
+
+void JsonWriter::write_member_name(const JsonStringView &name)
+{
+	if (impl->stack.empty() || impl->stack.back() != '{' || impl->need_value)
+		throw JsonException("JSON member name written outside an object");
+	if (impl->need_comma)
+		impl->write_char(',');
+	impl->write_string(name.data, name.length);
+	impl->write_char(':');
+	impl->need_value = true;
+}
+
+void JsonWriter::write_string(const std::string &value)
+{
+	impl->begin_value();
+	impl->write_string(value.data(), value.length());
+}
+
+void JsonWriter::write_string(const JsonStringView &value)
+{
+	impl->begin_value();
+	impl->write_string(value.data, value.length);
+}
+
+void JsonWriter::write_number(int value)
+{
+	impl->begin_value();
+	char buf[16];
+	int length = sprintf(buf, "%d", value);
+	impl->write_raw(buf, length);
+}
+
+void JsonWriter::write_number(double value)
+{
+	impl->begin_value();
+	char buf[32];
+	int length = format_json_number(value, buf);
+	impl->write_raw(buf, length);
+}
+
+void JsonWriter::write_boolean(bool value)
+{
+	impl->begin_value();
+	if (value)
+		impl->write_raw("true", 4);
+	else
+		impl->write_raw("false", 5);
+}
+
+void JsonWriter::write_null()
+{
+	impl->begin_value();
+	impl->write_raw("null", 4);
+}
+
+void JsonWriter::write_value(const JsonValue &value)
+{
+	impl->write_value(value);
+}
+
+void JsonWriter::flush()
+{
+	impl->flush();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// JsonWriter_Impl Implementation:
+
+void JsonWriter_Impl::begin_value()
+{
+	if (stack.empty())
+	{
+		if (need_comma)
+			throw JsonException("JSON can only have one top level value");
+	}
+	else if (stack.back() == '{')
+	{
+		if (!need_value)
+			throw JsonException("JSON object member written without a name");
+	}
+	else if (need_comma)
+	{
+		write_char(',');
+	}
+	need_value = false;
+	need_comma = true;
+}
+
+void JsonWriter_Impl::begin_container(char container)
+{
+	begin_value();
+	write_char(container);
+	stack.push_back(container);
+	need_comma = false;
+}
+
+void JsonWriter_Impl::end_container(char container)
+{
+	if (stack.empty() || stack.back() != container || need_value)
+		throw JsonException("Unmatched end of JSON object or array");
+	stack.pop_back();
+	write_char(container == '{' ? '}' : ']');
+	need_comma = true;
+}
+
+void JsonWriter_Impl::write_string(const char *text, size_t length)
+{
+	static const char hex[] = "0123456789abcdef";
+
+	write_char('"');
+	size_t start = 0;
+	for (size_t i = 0; i < length; i++)
+	{
+		unsigned char c = text[i];
+		if (c >= 0x20 && c != '"' && c != '\\')
+			continue;
+
+		write_raw(text + start, i - start);
+		start = i + 1;
+
+		char escape[6] = { '\\', 0, 0, 0, 0, 0 };
+		size_t escape_length = 2;
+		switch (c)
+		{
+		case '"': escape[1] = '"'; break;
+		case '\\': escape[1] = '\\'; break;
+		case '\b': escape[1] = 'b'; break;
+		case '\f': escape[1] = 'f'; break;
+		case '\n': escape[1] = 'n'; break;
+		case '\r': escape[1] = 'r'; break;
+		case '\t': escape[1] = 't'; break;
+		default:
+			escape[1] = 'u';
+			escape[2] = '0';
+			escape[3] = '0';
+			escape[4] = hex[c >> 4];
+			escape[5] = hex[c & 15];
+			escape_length = 6;
+			break;
+		}
+		write_raw(escape, escape_length);
+	}
+	write_raw(text + start, length - start);
+	write_char('"');
+}
+
+void JsonWriter_Impl::write_value(const JsonValue &value)
+{
+	switch (value.get_type())
+	{
+	case JsonValue::type_null:
+		begin_value();
+		write_raw("null", 4);
+		break;
+	case JsonValue::type_object:
+		{
+			begin_container('{');
+			const std::map<std::string, JsonValue> &members = value.get_members();
+			for (std::map<std::string, JsonValue>::const_iterator it = members.begin(); it != members.end(); ++it)
+			{
+				if (need_comma)
+					write_char(',');
+				write_string(it->first.data(), it->first.length());
+				write_char(':');
+				need_value = true;
+				write_value(it->second);
+			}
+			end_container('{');
+		}
+		break;
+	case JsonValue::type_array:
+		{
+			begin_container('[');
+			const std::vector<JsonValue> &items = value.get_items();
+			for (size_t i = 0; i < items.size(); i++)
+				write_value(items[i]);
+			end_container('[');
+		}
+		break;
+	case JsonValue::type_string:
+		{
+			begin_value();
+			std::string text = value.to_string();
+			write_string(text.data(), text.length());
+		}
+		break;
+	case JsonValue::type_number:
+		{
+			begin_value();
+			char buf[32];
+			int length = format_json_number(value.to_double(), buf);
+			write_raw(buf, length);
+		}
+		break;
+	case JsonValue::type_boolean:
+		begin_value();
+		if (value.to_boolean())
+			write_raw("true", 4);
+		else
+			write_raw("false", 5);
+		break;
+	}
+}
+
+}
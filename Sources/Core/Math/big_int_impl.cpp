@@ -48,8 +48,13 @@
 #include "Core/precomp.h"
 #include "big_int_impl.h"
 #include "API/Core/Math/big_int.h"
+#include "API/Core/Math/cl_math.h"
 #include <cstdlib>
 
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
 namespace clan
 {
 
@@ -1311,6 +1316,97 @@ void BigInt_Impl::mod(const BigInt_Impl *m, BigInt_Impl *c) const
 	}
 }
 
+// Computes out = a * b, where out has room for na + nb digits
+static void schoolbook_mul(const ubyte32 *a, unsigned int na, const ubyte32 *b, unsigned int nb, ubyte32 *out)
+{
+	memset(out, 0, (na + nb) * sizeof(ubyte32));
+	for (unsigned int ix = 0; ix < nb; ix++)
+	{
+		if (b[ix] == 0)
+			continue;
+
+		ubyte64 k = 0;
+		for (unsigned int jx = 0; jx < na; jx++)
+		{
+			ubyte64 w = (ubyte64) b[ix] * (ubyte64) a[jx] + k + (ubyte64) out[ix + jx];
+			out[ix + jx] = (ubyte32) w;
+			k = w >> 32;
+		}
+		out[ix + na] = (ubyte32) k;
+	}
+}
+
+// Computes out = a + b, where na >= nb and out has room for na digits. Returns the carry.
+static ubyte32 add_digits(const ubyte32 *a, unsigned int na, const ubyte32 *b, unsigned int nb, ubyte32 *out)
+{
+	ubyte64 k = 0;
+	for (unsigned int ix = 0; ix < na; ix++)
+	{
+		k += (ubyte64) a[ix];
+		if (ix < nb)
+			k += (ubyte64) b[ix];
+		out[ix] = (ubyte32) k;
+		k >>= 32;
+	}
+	return (ubyte32) k;
+}
+
+// Computes a += b, where na >= nb. The result must fit in na digits.
+static void add_digits_in_place(ubyte32 *a, unsigned int na, const ubyte32 *b, unsigned int nb)
+{
+	ubyte64 k = 0;
+	for (unsigned int ix = 0; ix < na && (ix < nb || k); ix++)
+	{
+		k += (ubyte64) a[ix];
+		if (ix < nb)
+			k += (ubyte64) b[ix];
+		a[ix] = (ubyte32) k;
+		k >>= 32;
+	}
+}
+
+// Computes a -= b, where na >= nb and a >= b
+static void sub_digits_in_place(ubyte32 *a, unsigned int na, const ubyte32 *b, unsigned int nb)
+{
+	ubyte32 borrow = 0;
+	for (unsigned int ix = 0; ix < na && (ix < nb || borrow); ix++)
+	{
+		ubyte64 w = (ubyte64) a[ix] - (ix < nb ? b[ix] : 0) - borrow;
+		a[ix] = (ubyte32) w;
+		borrow = (w >> 32) ? 1 : 0;
+	}
+}
+
+// Computes out = a * b, where both a and b have n digits and out has room for 2n digits.
+// With a = a1*B + a0 and b = b1*B + b0, the middle term a1*b0 + a0*b1 is computed as
+// (a0 + a1)(b0 + b1) - a0*b0 - a1*b1, using three half size multiplications instead of four.
+static void karatsuba_mul(const ubyte32 *a, const ubyte32 *b, unsigned int n, unsigned int threshold, ubyte32 *out)
+{
+	if (n < threshold)
+	{
+		schoolbook_mul(a, n, b, n, out);
+		return;
+	}
+
+	unsigned int low = n / 2;
+	unsigned int high = n - low;
+
+	karatsuba_mul(a, b, low, threshold, out);
+	karatsuba_mul(a + low, b + low, high, threshold, out + 2 * low);
+
+	std::vector<ubyte32> sum_a(high + 1), sum_b(high + 1), middle(2 * (high + 1));
+	sum_a[high] = add_digits(a + low, high, a, low, &sum_a[0]);
+	sum_b[high] = add_digits(b + low, high, b, low, &sum_b[0]);
+	karatsuba_mul(&sum_a[0], &sum_b[0], high + 1, threshold, &middle[0]);
+
+	sub_digits_in_place(&middle[0], middle.size(), out, 2 * low);
+	sub_digits_in_place(&middle[0], middle.size(), out + 2 * low, 2 * high);
+
+	// The middle term is below 2^(32(n+1)), any digits above that are zero
+	unsigned int middle_used = min((unsigned int) middle.size(), 2 * n - low);
+	add_digits_in_place(out + low, 2 * n - low, &middle[0], middle_used);
+}
+
 void BigInt_Impl::internal_mul(const BigInt_Impl *b)
 {
 	// Compute a = |a| * |b|
@@ -1320,6 +1416,23 @@ void BigInt_Impl::internal_mul(const BigInt_Impl *b)
 	const ubyte32 *pb;
 	ubyte32 *pt, *pbt;
 
+	// Use Karatsuba for large operands of similar size, padding the shorter one with zeroes
+	unsigned int size = max(ua, ub);
+	if (ua >= karatsuba_threshold && ub >= karatsuba_threshold && size <= 2 * min(ua, ub))
+	{
+		std::vector<ubyte32> digits_a(size, 0), digits_b(size, 0);
+		memcpy(&digits_a[0], digits, ua * sizeof(ubyte32));
+		memcpy(&digits_b[0], b->digits, ub * sizeof(ubyte32));
+
+		BigInt_Impl tmp_impl(2 * size);
+		tmp_impl.digits_used = 2 * size;
+		karatsuba_mul(&digits_a[0], &digits_b[0], size, karatsuba_threshold, tmp_impl.digits);
+
+		tmp_impl.internal_clamp();
+		tmp_impl.internal_exch(this);
+		return;
+	}
+
 	BigInt_Impl tmp_impl(ua + ub);
 
 	// This has the effect of left-padding with zeroes...
@@ -1599,6 +1712,124 @@ void BigInt_Impl::internal_sqr()
 	tmp_impl.internal_exch(this);
 }
 
+// Computes a * b + c + carry. The high 64 bits are returned in carry.
+static inline ubyte64 limb_mul_add(ubyte64 a, ubyte64 b, ubyte64 c, ubyte64 &carry)
+{
+#if defined(__SIZEOF_INT128__)
+	unsigned __int128 w = (unsigned __int128) a * b + c + carry;
+	carry = (ubyte64) (w >> 64);
+	return (ubyte64) w;
+#else
+#if defined(_MSC_VER) && defined(_M_X64)
+	ubyte64 high;
+	ubyte64 low = _umul128(a, b, &high);
+#else
+	ubyte64 p0 = (a & 0xffffffff) * (b & 0xffffffff);
+	ubyte64 p1 = (a & 0xffffffff) * (b >> 32);
+	ubyte64 p2 = (a >> 32) * (b & 0xffffffff);
+	ubyte64 p3 = (a >> 32) * (b >> 32);
+	ubyte64 middle = (p0 >> 32) + (p1 & 0xffffffff) + (p2 & 0xffffffff);
+	ubyte64 low = (p0 & 0xffffffff) | (middle << 32);
+	ubyte64 high = p3 + (p1 >> 32) + (p2 >> 32) + (middle >> 32);
+#endif
+	low += c;
+	high += (low < c) ? 1 : 0;
+	low += carry;
+	high += (low < carry) ? 1 : 0;
+	carry = high;
+	return low;
+#endif
+}
+
+// Montgomery multiplication modulo an odd number, on 64 bit limbs.
+// Values are kept as a*R (mod m), where R = 2^(64*size). Multiplying two of them
+// and dividing by R replaces the long division of a normal modular multiplication.
+class BigInt_Montgomery
+{
+public:
+	BigInt_Montgomery(const ubyte32 *modulus_digits, unsigned int modulus_used)
+	: size((modulus_used + 1) / 2), modulus(size), temp(size + 2)
+	{
+		load(modulus_digits, modulus_used, &modulus[0]);
+
+		// Newton iteration for modulus^-1 (mod 2^64). Each step doubles the number of correct bits.
+		ubyte64 inverse = modulus[0];
+		for (int cnt = 0; cnt < 5; cnt++)
+			inverse *= 2 - modulus[0] * inverse;
+		modulus_inverse = 0 - inverse;
+	}
+
+	// Converts 32 bit digits to limbs
+	void load(const ubyte32 *digits, unsigned int used, ubyte64 *out_limbs) const
+	{
+		for (unsigned int ix = 0; ix < (unsigned int) size; ix++)
+		{
+			ubyte64 low = (2 * ix < used) ? digits[2 * ix] : 0;
+			ubyte64 high = (2 * ix + 1 < used) ? digits[2 * ix + 1] : 0;
+			out_limbs[ix] = low | (high << 32);
+		}
+	}
+
+	// Computes out = a * b / R (mod m). out may be a or b.
+	void multiply(const ubyte64 *a, const ubyte64 *b, ubyte64 *out)
+	{
+		// Coarsely integrated operand scanning (CIOS)
+		ubyte64 *t = &temp[0];
+		memset(t, 0, (size + 2) * sizeof(ubyte64));
+
+		for (int ix = 0; ix < size; ix++)
+		{
+			ubyte64 carry = 0;
+			for (int jx = 0; jx < size; jx++)
+				t[jx] = limb_mul_add(a[jx], b[ix], t[jx], carry);
+			ubyte64 sum = t[size] + carry;
+			t[size + 1] = (sum < carry) ? 1 : 0;
+			t[size] = sum;
+
+			// Add a multiple of the modulus that makes the lowest limb zero, then shift it out
+			ubyte64 factor = t[0] * modulus_inverse;
+			carry = 0;
+			limb_mul_add(factor, modulus[0], t[0], carry);
+			for (int jx = 1; jx < size; jx++)
+				t[jx - 1] = limb_mul_add(factor, modulus[jx], t[jx], carry);
+			sum = t[size] + carry;
+			t[size - 1] = sum;
+			t[size] = t[size + 1] + ((sum < carry) ? 1 : 0);
+		}
+
+		// t is below 2m here
+		if (t[size] || compare(t, &modulus[0]) >= 0)
+		{
+			ubyte64 borrow = 0;
+			for (int ix = 0; ix < size; ix++)
+			{
+				ubyte64 value = t[ix] - modulus[ix] - borrow;
+				borrow = (t[ix] < modulus[ix] || (t[ix] == modulus[ix] && borrow)) ? 1 : 0;
+				t[ix] = value;
+			}
+		}
+
+		memcpy(out, t, size * sizeof(ubyte64));
+	}
+
+	int size;
+
+private:
+	int compare(const ubyte64 *a, const ubyte64 *b) const
+	{
+		for (int ix = size - 1; ix >= 0; ix--)
+		{
+			if (a[ix] != b[ix])
+				return (a[ix] > b[ix]) ? 1 : -1;
+		}
+		return 0;
+	}
+
+	std::vector<ubyte64> modulus;
+	ubyte64 modulus_inverse;
+	std::vector<ubyte64> temp;
+};
+
 void BigInt_Impl::exptmod(const BigInt_Impl *b, const BigInt_Impl *m, BigInt_Impl *c) const
 {
 	BigInt_Impl s, mu;
@@ -1611,6 +1842,13 @@ void BigInt_Impl::exptmod(const BigInt_Impl *b, const BigInt_Impl *m, BigInt_Imp
 	if (b->cmp_z() < 0 || m->cmp_z() <= 0)
 		throw Exception("Divide by zero");
 
+	// Odd moduli (such as RSA and Diffie-Hellman) use Montgomery multiplication
+	if (m->isodd() && m->digits_used > 1)
+	{
+		internal_exptmod_montgomery(b, m, c);
+		return;
+	}
+
 	BigInt_Impl x(*this);
 
 	x.mod(m, &x);
@@ -1662,6 +1900,99 @@ void BigInt_Impl::exptmod(const BigInt_Impl *b, const BigInt_Impl *m, BigInt_Imp
 	s.internal_exch(c);
 }
 
+void BigInt_Impl::internal_exptmod_montgomery(const BigInt_Impl *b, const BigInt_Impl *m, BigInt_Impl *c) const
+{
+	BigInt_Montgomery montgomery(m->digits, m->digits_used);
+	const int size = montgomery.size;
+
+	unsigned int exponent_bits = b->significant_bits();
+	if (b->cmp_z() == 0)
+	{
+		c->set((ubyte32) 1);
+		return;
+	}
+
+	// Fixed window exponentiation. Larger windows need fewer multiplications,
+	// but the table of powers costs 2^window multiplications to build.
+	unsigned int window = 1;
+	if (exponent_bits > 671)
+		window = 6;
+	else if (exponent_bits > 239)
+		window = 5;
+	else if (exponent_bits > 79)
+		window = 4;
+	else if (exponent_bits > 23)
+		window = 3;
+
+	BigInt_Impl x(*this);
+	x.mod(m, &x);
+
+	// R^2 (mod m) converts values into Montgomery form
+	BigInt_Impl r2;
+	r2.set((ubyte32) 1);
+	r2.internal_lshd(4 * size);
+	r2.mod(m, &r2);
+
+	std::vector<ubyte64> r2_limbs(size), result(size);
+	montgomery.load(r2.digits, r2.digits_used, &r2_limbs[0]);
+
+	// table[i] = x^i * R (mod m)
+	const unsigned int table_size = 1 << window;
+	std::vector<ubyte64> table(table_size * size);
+	montgomery.load(x.digits, x.digits_used, &table[size]);
+	montgomery.multiply(&table[size], &r2_limbs[0], &table[size]);
+	for (unsigned int ix = 2; ix < table_size; ix++)
+		montgomery.multiply(&table[(ix - 1) * size], &table[size], &table[ix * size]);
+
+	// The top window is shorter when the bit count is not a multiple of the window size
+	unsigned int first_window = exponent_bits % window;
+	if (first_window == 0)
+		first_window = window;
+
+	unsigned int bit = exponent_bits - first_window;
+	ubyte32 index = b->internal_get_bits(bit, first_window);
+	memcpy(&result[0], &table[index * size], size * sizeof(ubyte64));
+
+	while (bit > 0)
+	{
+		bit -= window;
+		for (unsigned int cnt = 0; cnt < window; cnt++)
+			montgomery.multiply(&result[0], &result[0], &result[0]);
+
+		index = b->internal_get_bits(bit, window);
+		if (index)
+			montgomery.multiply(&result[0], &table[index * size], &result[0]);
+	}
+
+	// Convert back from Montgomery form by multiplying with 1
+	std::vector<ubyte64> one(size, 0);
+	one[0] = 1;
+	montgomery.multiply(&result[0], &one[0], &result[0]);
+
+	BigInt_Impl s(2 * size);
+	s.digits_used = 2 * size;
+	for (int ix = 0; ix < size; ix++)
+	{
+		s.digits[2 * ix] = (ubyte32) result[ix];
+		s.digits[2 * ix + 1] = (ubyte32) (result[ix] >> 32);
+	}
+	s.internal_clamp();
+	s.internal_exch(c);
+}
+
+ubyte32 BigInt_Impl::internal_get_bits(unsigned int first_bit, unsigned int count) const
+{
+	ubyte32 value = 0;
+	for (unsigned int bit = first_bit + count; bit > first_bit; bit--)
+	{
+		unsigned int digit = (bit - 1) / num_bits_in_digit;
+		value <<= 1;
+		if (digit < digits_used)
+			value |= (digits[digit] >> ((bit - 1) % num_bits_in_digit)) & 1;
+	}
+	return value;
+}
+
 bool BigInt_Impl::fermat(ubyte32 w) const
 {
 	BigInt_Impl  base, test;
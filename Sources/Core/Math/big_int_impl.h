@@ -117,6 +117,9 @@ private:
 	static const ubyte32 digit_half_radix = 1U << (8*sizeof(ubyte32) - 1);
 	static const ubyte64 word_maximim_value = ~0;
 
+	/// \brief Digits in each operand before internal_mul uses Karatsuba multiplication
+	static const unsigned int karatsuba_threshold = 32;
+
 	static const int prime_tab_size = 6542;
 	static std::vector<ubyte32> prime_tab;
 
@@ -169,6 +172,12 @@ private:
 	void internal_reduce(const BigInt_Impl *m, BigInt_Impl *mu);
 	void internal_sqr();
 
+	// Computes c = a**b (mod m) with Montgomery multiplication on 64 bit limbs. m must be odd.
+	void internal_exptmod_montgomery(const BigInt_Impl *b, const BigInt_Impl *m, BigInt_Impl *c) const;
+
+	// Returns count bits of |a|, starting at bit number first_bit
+	ubyte32 internal_get_bits(unsigned int first_bit, unsigned int count) const;
+
 	bool digits_negative;	// True if the value is negative
 	unsigned int digits_alloc;		// How many digits allocated
 	unsigned int digits_used;		// How many digits used
@@ -117,7 +117,6 @@ IntersectionTest::Result IntersectionTest::frustum_aabb(const FrustumPlanes &fru
 			return outside;
 		else if (result == intersecting)
 			is_intersecting = true;
-		break;
 	}
 	if (is_intersecting)
 		return intersecting;
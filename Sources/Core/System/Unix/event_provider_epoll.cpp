@@ -0,0 +1,271 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Magnus Norddahl
+*/
+
+#include "Core/precomp.h"
+
+#ifdef __linux__
+
+#include "event_provider_epoll.h"
+#include "API/Core/System/exception.h"
+#include "API/Core/System/system.h"
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <errno.h>
+#include <algorithm>
+
+namespace clan
+{
+
+/////////////////////////////////////////////////////////////////////////////
+// EventProvider_Epoll Construction:
+
+EventProvider_Epoll::EventProvider_Epoll()
+: epoll_handle(-1)
+{
+	epoll_handle = epoll_create1(EPOLL_CLOEXEC);
+	if (epoll_handle == -1)
+		throw Exception(std::string("Could not create epoll instance: ") + strerror(errno));
+}
+
+EventProvider_Epoll::~EventProvider_Epoll()
+{
+	close(epoll_handle);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// EventProvider_Epoll Attributes:
+
+int EventProvider_Epoll::get_size()
+{
+	MutexSection mutex_lock(&mutex);
+	return providers.size();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// EventProvider_Epoll Operations:
+
+void EventProvider_Epoll::add(const Event &event, int id, bool edge_triggered)
+{
+	EventProvider *provider = event.get_event_provider();
+	if (provider == 0)
+		throw Exception("Event's EventProvider is a null pointer!");
+
+	MutexSection mutex_lock(&mutex);
+	if (providers.find(provider) != providers.end())
+		throw Exception("Event is already in the event set");
+
+	int num_handles = provider->get_num_event_handles();
+	for (int i = 0; i < num_handles; i++)
+	{
+		// A socket's read and write events share the same descriptor, so the watches are merged per descriptor
+		int handle = provider->get_event_handle(i);
+		Watch watch;
+		watch.event = event;
+		watch.handle_index = i;
+		watch.type = provider->get_event_type(i);
+		watch.id = id;
+		watch.edge_triggered = edge_triggered;
+
+		// The descriptor is registered again even if the mask is unchanged: the
+		// descriptor number may belong to a new file since the watches were added
+		Descriptor &descriptor = descriptors[handle];
+		descriptor.watches.push_back(watch);
+		update_descriptor(handle, descriptor, true);
+	}
+	providers[provider] = id;
+}
+
+void EventProvider_Epoll::remove(const Event &event)
+{
+	EventProvider *provider = event.get_event_provider();
+
+	MutexSection mutex_lock(&mutex);
+	if (providers.erase(provider) == 0)
+		return;
+
+	int num_handles = provider->get_num_event_handles();
+	for (int i = 0; i < num_handles; i++)
+	{
+		int handle = provider->get_event_handle(i);
+		std::map<int, Descriptor>::iterator it = descriptors.find(handle);
+		if (it == descriptors.end())
+			continue;
+
+		std::vector<Watch> &watches = it->second.watches;
+		for (size_t j = watches.size(); j > 0; j--)
+		{
+			if (watches[j - 1].event.get_event_provider() == provider)
+				watches.erase(watches.begin() + (j - 1));
+		}
+
+		update_descriptor(handle, it->second);
+		if (watches.empty())
+			descriptors.erase(it);
+	}
+}
+
+void EventProvider_Epoll::clear()
+{
+	MutexSection mutex_lock(&mutex);
+	for (std::map<int, Descriptor>::iterator it = descriptors.begin(); it != descriptors.end(); ++it)
+	{
+		it->second.watches.clear();
+		update_descriptor(it->first, it->second);
+	}
+	descriptors.clear();
+	providers.clear();
+}
+
+int EventProvider_Epoll::wait(std::vector<int> &out_flagged_ids, int timeout)
+{
+	out_flagged_ids.clear();
+
+	ubyte64 start_time = System::get_time();
+	epoll_event events[max_events_per_wait];
+	std::vector<Watch> ready_watches;
+
+	while (true)
+	{
+		int time_left = timeout;
+		if (timeout > 0)
+		{
+			int time_elapsed = (int) (System::get_time() - start_time);
+			time_left = (time_elapsed < timeout) ? timeout - time_elapsed : 0;
+		}
+
+		int result;
+		do
+		{
+			result = epoll_wait(epoll_handle, events, max_events_per_wait, time_left);
+		} while (result == -1 && errno == EINTR); // The syscall was interrupted.  Try again.
+
+		if (result == -1)
+			throw Exception(std::string("Event wait failed! Unix Error: ") + strerror(errno));
+		else if (result == 0)
+			return 0;
+
+		// Find the watches for the ready descriptors
+		ready_watches.clear();
+		MutexSection mutex_lock(&mutex);
+		for (int i = 0; i < result; i++)
+		{
+			std::map<int, Descriptor>::iterator it = descriptors.find(events[i].data.fd);
+			if (it == descriptors.end())
+				continue; // Removed from another thread after epoll_wait returned
+
+			std::vector<Watch> &watches = it->second.watches;
+			for (size_t j = 0; j < watches.size(); j++)
+			{
+				if ((events[i].events & (get_mask(watches[j].type) | EPOLLERR | EPOLLHUP)) != 0)
+					ready_watches.push_back(watches[j]);
+			}
+		}
+		mutex_lock.unlock();
+
+		// Let the event providers confirm the wakeup (an auto reset event may have been claimed by another thread)
+		for (size_t i = 0; i < ready_watches.size(); i++)
+		{
+			const Watch &watch = ready_watches[i];
+			if (watch.event.get_event_provider()->check_after_wait(watch.handle_index))
+			{
+				if (std::find(out_flagged_ids.begin(), out_flagged_ids.end(), watch.id) == out_flagged_ids.end())
+					out_flagged_ids.push_back(watch.id);
+			}
+		}
+
+		if (!out_flagged_ids.empty())
+			return out_flagged_ids.size();
+		else if (time_left == 0)
+			return 0;
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// EventProvider_Epoll Implementation:
+
+void EventProvider_Epoll::update_descriptor(int handle, Descriptor &descriptor, bool force)
+{
+	unsigned int mask = 0;
+	bool edge_triggered = !descriptor.watches.empty();
+	for (size_t i = 0; i < descriptor.watches.size(); i++)
+	{
+		mask |= get_mask(descriptor.watches[i].type);
+		edge_triggered = edge_triggered && descriptor.watches[i].edge_triggered;
+	}
+	if (edge_triggered)
+		mask |= EPOLLET;
+
+	if (mask == descriptor.registered_mask && (!force || mask == 0))
+		return;
+
+	epoll_event event;
+	memset(&event, 0, sizeof(epoll_event));
+	event.events = mask;
+	event.data.fd = handle;
+
+	int operation;
+	if (descriptor.registered_mask == 0)
+		operation = EPOLL_CTL_ADD;
+	else if (mask == 0)
+		operation = EPOLL_CTL_DEL;
+	else
+		operation = EPOLL_CTL_MOD;
+
+	int result = epoll_ctl(epoll_handle, operation, handle, &event);
+
+	// Closing a descriptor removes it from epoll without remove() being called,
+	// and a new file may since have been opened with the same number
+	if (result == -1 && operation == EPOLL_CTL_MOD && errno == ENOENT)
+		result = epoll_ctl(epoll_handle, EPOLL_CTL_ADD, handle, &event);
+	else if (result == -1 && operation == EPOLL_CTL_ADD && errno == EEXIST)
+		result = epoll_ctl(epoll_handle, EPOLL_CTL_MOD, handle, &event);
+
+	// The descriptor may already have been closed when removing it
+	if (result == -1 && mask != 0)
+		throw Exception(std::string("Could not register event handle with epoll: ") + strerror(errno));
+
+	descriptor.registered_mask = mask;
+}
+
+unsigned int EventProvider_Epoll::get_mask(EventType type)
+{
+	switch (type)
+	{
+	case type_fd_read:
+		return EPOLLIN;
+	case type_fd_write:
+		return EPOLLOUT;
+	case type_fd_exception:
+		return EPOLLPRI;
+	}
+	return 0;
+}
+
+}
+
+#endif
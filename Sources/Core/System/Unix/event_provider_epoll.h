@@ -0,0 +1,102 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Magnus Norddahl
+*/
+
+#pragma once
+
+#include "API/Core/System/event_provider.h"
+#include "API/Core/System/event.h"
+#include "API/Core/System/mutex.h"
+#include <map>
+
+namespace clan
+{
+
+/// \brief Event provider for an epoll instance with persistently registered events
+///
+/// The provider itself is flagged when any of the registered events are ready,
+/// allowing an epoll set to be waited for together with other events.
+class EventProvider_Epoll : public EventProvider
+{
+/// \name Construction
+/// \{
+public:
+	EventProvider_Epoll();
+	~EventProvider_Epoll();
+/// \}
+
+/// \name Attributes
+/// \{
+public:
+	EventType get_event_type(int index) { return type_fd_read; }
+	int get_event_handle(int index) { return epoll_handle; }
+	int get_num_event_handles() { return 1; }
+
+	int get_size();
+/// \}
+
+/// \name Operations
+/// \{
+public:
+	void add(const Event &event, int id, bool edge_triggered);
+	void remove(const Event &event);
+	void clear();
+	int wait(std::vector<int> &out_flagged_ids, int timeout);
+/// \}
+
+/// \name Implementation
+/// \{
+private:
+	struct Watch
+	{
+		Event event;
+		int handle_index;
+		EventType type;
+		int id;
+		bool edge_triggered;
+	};
+
+	struct Descriptor
+	{
+		Descriptor() : registered_mask(0) { }
+		std::vector<Watch> watches;
+		unsigned int registered_mask;
+	};
+
+	void update_descriptor(int handle, Descriptor &descriptor, bool force = false);
+	static unsigned int get_mask(EventType type);
+
+	Mutex mutex;
+	int epoll_handle;
+	std::map<int, Descriptor> descriptors;
+	std::map<EventProvider *, int> providers;
+
+	enum { max_events_per_wait = 256 };
+/// \}
+};
+
+}
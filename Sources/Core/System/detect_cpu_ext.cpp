@@ -55,6 +55,9 @@ bool System::detect_cpu_extension(CPU_ExtensionX86 ext)
 
 #define __cpuid(out, infoType)\
 	asm("cpuid": "=a" ((out)[0]), "=b" ((out)[1]), "=c" ((out)[2]), "=d" ((out)[3]): "a" (infoType));
+
+#define __cpuidex(out, infoType, subType)\
+	asm("cpuid": "=a" ((out)[0]), "=b" ((out)[1]), "=c" ((out)[2]), "=d" ((out)[3]): "a" (infoType), "c" (subType));
 #else
 
 #define __cpuid(out, infoType) \
@@ -64,8 +67,31 @@ bool System::detect_cpu_extension(CPU_ExtensionX86 ext)
 			"popl %%ebx" \
 		: "=a" ((out)[0]), "=r" ((out)[1]), "=c" ((out)[2]), "=d" ((out)[3]): "a" (infoType));
 
+#define __cpuidex(out, infoType, subType) \
+	asm volatile(	"pushl %%ebx \n" \
+			"cpuid \n" \
+			"movl %%ebx, %1 \n" \
+			"popl %%ebx" \
+		: "=a" ((out)[0]), "=r" ((out)[1]), "=c" ((out)[2]), "=d" ((out)[3]): "a" (infoType), "c" (subType));
+
 #endif
 
+static unsigned int cl_xgetbv(unsigned int index)
+{
+	unsigned int eax, edx;
+	asm volatile(".byte 0x0f, 0x01, 0xd0" : "=a" (eax), "=d" (edx) : "c" (index));
+	return eax;
+}
+
+#else
+
+#include <immintrin.h>
+
+static unsigned int cl_xgetbv(unsigned int index)
+{
+	return (unsigned int)_xgetbv(index);
+}
+
 #endif
 
 bool System::detect_cpu_extension(CPU_ExtensionPPC ext)
@@ -182,6 +208,36 @@ bool System::detect_cpu_extension(CPU_ExtensionX86 ext)
 		__cpuid((int*)cpuinfo, 0x80000001);
 		return ((cpuinfo[2] & (1 << 16)) != 0);
 	}
+	else if(ext == avx2)
+	{
+		__cpuid((int*)cpuinfo, 0);
+		if(cpuinfo[0] < 7)
+			return false;
+
+		// The OS must save the YMM registers on context switches (OSXSAVE set and XCR0 bits 1 and 2 enabled)
+		__cpuid((int*)cpuinfo, 0x1);
+		if((cpuinfo[2] & (1 << 27)) == 0 || (cpuinfo[2] & (1 << 28)) == 0)
+			return false;
+		if((cl_xgetbv(0) & 0x6) != 0x6)
+			return false;
+
+		__cpuidex((int*)cpuinfo, 0x7, 0);
+		return ((cpuinfo[1] & (1 << 5)) != 0);
+	}
+	else if(ext == pclmul)
+	{
+		__cpuid((int*)cpuinfo, 0x1);
+		return ((cpuinfo[2] & (1 << 1)) != 0);
+	}
+	else if(ext == sha)
+	{
+		__cpuid((int*)cpuinfo, 0);
+		if(cpuinfo[0] < 7)
+			return false;
+
+		__cpuidex((int*)cpuinfo, 0x7, 0);
+		return ((cpuinfo[1] & (1 << 29)) != 0);
+	}
 	return false;
 }
 
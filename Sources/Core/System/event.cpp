@@ -43,6 +43,11 @@
 #include <sys/time.h>
 #endif
 
+#ifdef __linux__
+#include <poll.h>
+#include "API/Core/System/system.h"
+#endif
+
 namespace clan
 {
 
@@ -174,6 +179,83 @@ int Event::wait(int count, Event const * const * events, int timeout)
 			return index_events;
 	}
 
+#ifdef __linux__
+	// poll() is not limited to FD_SETSIZE handles like select() is
+	std::vector<pollfd> poll_handles;
+	for (index_events = 0; index_events < count; index_events++)
+	{
+		EventProvider *provider = events[index_events]->impl->provider;
+		int num_handles = provider->get_num_event_handles();
+		for (int i=0; i<num_handles; i++)
+		{
+			pollfd poll_handle;
+			poll_handle.fd = provider->get_event_handle(i);
+			poll_handle.revents = 0;
+			switch (provider->get_event_type(i))
+			{
+			case EventProvider::type_fd_read:
+			default:
+				poll_handle.events = POLLIN;
+				break;
+			case EventProvider::type_fd_write:
+				poll_handle.events = POLLOUT;
+				break;
+			case EventProvider::type_fd_exception:
+				poll_handle.events = POLLPRI;
+				break;
+			}
+			poll_handles.push_back(poll_handle);
+		}
+	}
+
+	ubyte64 start_time = System::get_time();
+	while (true)
+	{
+		int time_left = timeout;
+		if (timeout > 0)
+		{
+			int time_elapsed = (int) (System::get_time() - start_time);
+			time_left = (time_elapsed < timeout) ? timeout - time_elapsed : 0;
+		}
+
+		int result;
+		do
+		{
+			result = poll(poll_handles.empty() ? 0 : &poll_handles[0], poll_handles.size(), time_left);
+		} while (result == -1 && errno == EINTR); // The syscall was interrupted.  Try again.
+
+		if (result == -1) // Error occoured
+		{
+			throw Exception(std::string("Event wait failed! Unix Error: ") + strerror(errno));
+		}
+		else if (result == 0) // Timed out
+		{
+			return -1;
+		}
+		else // Got a message
+		{
+			// find the flagged sockets
+			int index_handle = 0;
+			for (index_events = 0; index_events < count; index_events++)
+			{
+				EventProvider *provider = events[index_events]->impl->provider;
+				int num_handles = provider->get_num_event_handles();
+				for (int i=0; i<num_handles; i++)
+				{
+					if (poll_handles[index_handle++].revents != 0)
+					{
+						bool flagged = provider->check_after_wait(i);
+						if (flagged)
+							return index_events;
+					}
+				}
+			}
+
+			if (time_left == 0)
+				return -1;
+		}
+	}
+#else
 	// Placing the timeval struct here allows linux systems to more
 	// correctly resume a select if it was awaken by a complex event.
 	// On non-linux unixes (those that do not update timeval), the
@@ -295,6 +377,8 @@ int Event::wait(int count, Event const * const * events, int timeout)
 		}
 	}
 
+#endif
+
 	return -1;
 #endif
 }
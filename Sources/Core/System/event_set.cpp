@@ -0,0 +1,140 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Magnus Norddahl
+*/
+
+#include "Core/precomp.h"
+#include "API/Core/System/event_set.h"
+#include "API/Core/System/event.h"
+#include "API/Core/System/exception.h"
+#ifdef __linux__
+#include "Unix/event_provider_epoll.h"
+#endif
+
+namespace clan
+{
+
+class EventSet_Impl
+{
+public:
+#ifdef __linux__
+	EventSet_Impl() : epoll_provider(new EventProvider_Epoll()), epoll_event(epoll_provider) { }
+
+	EventProvider_Epoll *epoll_provider;
+	Event epoll_event; // Owns epoll_provider
+#else
+	std::vector<Event> events;
+	std::vector<int> ids;
+#endif
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// EventSet Construction:
+
+EventSet::EventSet()
+: impl(new EventSet_Impl())
+{
+}
+
+EventSet::~EventSet()
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// EventSet Attributes:
+
+int EventSet::get_size() const
+{
+#ifdef __linux__
+	return impl->epoll_provider->get_size();
+#else
+	return impl->events.size();
+#endif
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// EventSet Operations:
+
+void EventSet::add(const Event &event, int id, bool edge_triggered)
+{
+#ifdef __linux__
+	impl->epoll_provider->add(event, id, edge_triggered);
+#else
+	for (size_t i = 0; i < impl->events.size(); i++)
+	{
+		if (impl->events[i].get_event_provider() == event.get_event_provider())
+			throw Exception("Event is already in the event set");
+	}
+	impl->events.push_back(event);
+	impl->ids.push_back(id);
+#endif
+}
+
+void EventSet::remove(const Event &event)
+{
+#ifdef __linux__
+	impl->epoll_provider->remove(event);
+#else
+	for (size_t i = 0; i < impl->events.size(); i++)
+	{
+		if (impl->events[i].get_event_provider() == event.get_event_provider())
+		{
+			impl->events.erase(impl->events.begin() + i);
+			impl->ids.erase(impl->ids.begin() + i);
+			break;
+		}
+	}
+#endif
+}
+
+void EventSet::clear()
+{
+#ifdef __linux__
+	impl->epoll_provider->clear();
+#else
+	impl->events.clear();
+	impl->ids.clear();
+#endif
+}
+
+int EventSet::wait(std::vector<int> &out_flagged_ids, int timeout)
+{
+#ifdef __linux__
+	return impl->epoll_provider->wait(out_flagged_ids, timeout);
+#else
+	out_flagged_ids.clear();
+	int index = Event::wait(impl->events, timeout);
+	if (index == -1)
+		return 0;
+	out_flagged_ids.push_back(impl->ids[index]);
+	return 1;
+#endif
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// EventSet Implementation:
+
+}
@@ -35,7 +35,7 @@
 #include "API/Core/System/event.h"
 #include "API/Core/System/system.h"
 #include "API/Core/Signals/callback_v0.h"
-#include <map>
+#include <vector>
 
 namespace clan
 {
@@ -43,22 +43,50 @@ namespace clan
 class Timer_Object
 {
 public:
-	Timer_Object() : stopped(true) {}
+	Timer_Object() : heap_index(-1), heap_end_time(0), end_time(disarmed), timeout(0), repeating(false) {}
+
+	/// \brief end_time of a timer that is not running
+	static const ubyte64 disarmed = ~(ubyte64) 0;
+
+	/// \brief Position in the timer heap, or -1 if the timer is not running
+	int heap_index;
+
+	/// \brief Expiry time the timer is sorted by in the heap
+	ubyte64 heap_end_time;
+
+	/// \brief Expiry time of the timer
+	///
+	/// A running one shot timer can be moved to a later time without the lock by
+	/// changing this alone, so it can be after heap_end_time. It is only changed
+	/// with the atomic functions below.
+	volatile ubyte64 end_time;
 
-	bool stopped;
-	ubyte64 end_time;
 	unsigned int timeout;
 	bool repeating;
 	Callback_v0 func_expired;
+
+#ifdef WIN32
+	static ubyte64 load(volatile ubyte64 *value) { return InterlockedCompareExchange64((volatile LONGLONG *) value, 0, 0); }
+	static void store(volatile ubyte64 *value, ubyte64 new_value) { InterlockedExchange64((volatile LONGLONG *) value, new_value); }
+	static bool compare_and_swap(volatile ubyte64 *value, ubyte64 expected_value, ubyte64 new_value) { return InterlockedCompareExchange64((volatile LONGLONG *) value, new_value, expected_value) == (LONGLONG) expected_value; }
+#else
+	static ubyte64 load(volatile ubyte64 *value) { return __sync_val_compare_and_swap(value, 0, 0); }
+	static void store(volatile ubyte64 *value, ubyte64 new_value) { __sync_lock_test_and_set(value, new_value); __sync_synchronize(); }
+	static bool compare_and_swap(volatile ubyte64 *value, ubyte64 expected_value, ubyte64 new_value) { return __sync_bool_compare_and_swap(value, expected_value, new_value); }
+#endif
 };
 
 /////////////////////////////////////////////////////////////////////////////
 // Timer_Thread Class:
 
+/// \brief Runs the timers of all Timer objects
+///
+/// Running timers are kept in a binary min-heap ordered by expiry time, so start,
+/// stop and expire cost O(log n) and the next timeout is found at the top.
 class Timer_Thread : public KeepAliveObject
 {
 public:
-	Timer_Thread() : timeout(-1), stop_thread(false)
+	Timer_Thread() : stop_thread(false), wakeup_pending(false), wakeup_time(Timer_Object::disarmed)
 	{
 		thread.start(this, &Timer_Thread::timer_main);
 	}
@@ -70,108 +98,237 @@ public:
 		mutex_lock.unlock();
 		update_event.set();
 		thread.join();
+	}
 
-		// Delete all timer objects in the map
-		for (std::map<int, Timer_Object* >::iterator it = timer_objects.begin(); it != timer_objects.end(); ++it)
-		{
-			delete it->second;
-		}
+	Timer_Object *create_timer()
+	{
+		return new Timer_Object;
 	}
 
-	void start(int timer_id, unsigned int new_timeout, bool repeat)
+	void remove_timer(Timer_Object *object)
 	{
 		MutexSection mutex_lock(&mutex);
+		if (object->heap_index != -1)
+			heap_remove(object);
+		delete object;
+	}
+
+	void start(Timer_Object *object, unsigned int new_timeout, bool repeat)
+	{
+		ubyte64 end_time = System::get_time() + new_timeout;
 
-		Timer_Object &object = get_timer_object(timer_id);
-		object.stopped = false;
-		object.end_time = System::get_time() + new_timeout;
-		object.timeout = new_timeout;
-		object.repeating = repeat;
+		// Pushing a running one shot timer further out, as done with idle timeouts,
+		// does not need the lock. The heap is corrected when the old time is reached.
+		if (!repeat && !object->repeating && try_extend(object, end_time))
+			return;
 
-		if ( (timeout == -1) || (new_timeout < ( (unsigned int) timeout) ) )
+		MutexSection mutex_lock(&mutex);
+		object->timeout = new_timeout;
+		object->repeating = repeat;
+		Timer_Object::store(&object->end_time, end_time);
+		if (object->heap_index == -1)
+			heap_insert(object, end_time);
+		else
+			heap_update(object, end_time);
+
+		if (!wakeup_pending && end_time < wakeup_time)
 		{
 			// Only break into the thread when a shorter timeout is required
 			update_event.set();
 		}
 	}
 
-	void stop(int timer_id)
+	void stop(Timer_Object *object)
 	{
 		MutexSection mutex_lock(&mutex);
-		Timer_Object &object = get_timer_object(timer_id);
-		object.stopped = true;
+		if (object->heap_index != -1)
+		{
+			Timer_Object::store(&object->end_time, Timer_Object::disarmed);
+			heap_remove(object);
+		}
 	}
 
-	void remove_timer(int timer_id)
+	void stop(const std::vector<Timer_Object *> &objects)
 	{
-		// Remove the unused timers, to prevent memory leaks
 		MutexSection mutex_lock(&mutex);
-		std::map<int, Timer_Object *>::iterator it = timer_objects.find(timer_id);
-		if (it != timer_objects.end())
+
+		// Removing timers one at a time costs O(log n) each. Rebuilding the heap is O(n).
+		if (objects.size() < heap.size() / 8)
 		{
-			delete it->second;
-			timer_objects.erase(it);
+			for (size_t i = 0; i < objects.size(); i++)
+			{
+				if (objects[i]->heap_index != -1)
+				{
+					Timer_Object::store(&objects[i]->end_time, Timer_Object::disarmed);
+					heap_remove(objects[i]);
+				}
+			}
+		}
+		else
+		{
+			for (size_t i = 0; i < objects.size(); i++)
+				Timer_Object::store(&objects[i]->end_time, Timer_Object::disarmed);
+
+			size_t heap_size = 0;
+			for (size_t i = 0; i < heap.size(); i++)
+			{
+				if (Timer_Object::load(&heap[i]->end_time) == Timer_Object::disarmed)
+				{
+					heap[i]->heap_index = -1;
+				}
+				else
+				{
+					heap[i]->heap_index = heap_size;
+					heap[heap_size++] = heap[i];
+				}
+			}
+			heap.resize(heap_size);
+
+			for (int i = (int)heap.size() / 2 - 1; i >= 0; i--)
+				sift_down(i);
 		}
 	}
 
 	void process()
 	{
 		MutexSection mutex_lock(&mutex);
+		wakeup_pending = false;
 
 		ubyte64 current_time = System::get_time();
 
-		// Scan for events and trigger them
-		for (std::map<int, Timer_Object *>::iterator it = timer_objects.begin(); it != timer_objects.end();)
+		// Timers that expire within this time are triggered now
+		const int grace_period = 1;	// Allow 1ms grace
+		ubyte64 process_time = current_time + grace_period;
+
+		while (!heap.empty() && heap[0]->heap_end_time <= process_time)
 		{
-			Timer_Object &object = *(it->second);
-			++it;	// We need to update the iterator here - Because func_expired may remove the timer object
+			Timer_Object *object = heap[0];
 
-			// Found a timer
-			const int grace_period = 1;	// Allow 1ms grace
-			if (object.end_time <= (current_time + grace_period))
+			ubyte64 end_time = Timer_Object::load(&object->end_time);
+			if (end_time > process_time)
 			{
-				if (!object.stopped)
+				// Moved to a later time without the lock
+				heap_update(object, end_time);
+				continue;
+			}
+
+			if (object->repeating)
+			{
+				ubyte64 next_end_time = object->heap_end_time + object->timeout;
+				if (next_end_time <= current_time)
 				{
-					if (object.repeating)
-					{
-						object.end_time += object.timeout;
-						if (object.end_time <= current_time)
-						{
-							// An event has been missed, reset the timer
-							object.end_time = current_time + object.timeout;
-						}
-					}
-					else
-					{
-						object.stopped = true;
-					}
-
-					if (!object.func_expired.is_null())
-						object.func_expired.invoke();
+					// An event has been missed, reset the timer
+					next_end_time = current_time + object->timeout;
 				}
+
+				// Do not trigger it again in this call
+				if (next_end_time <= process_time)
+					next_end_time = process_time + 1;
+
+				if (!Timer_Object::compare_and_swap(&object->end_time, end_time, next_end_time))
+					continue;
+				heap_update(object, next_end_time);
+			}
+			else
+			{
+				if (!Timer_Object::compare_and_swap(&object->end_time, end_time, Timer_Object::disarmed))
+					continue;	// Moved to a later time while we looked at it
+				heap_remove(object);
 			}
+
+			// The callback may stop, restart or destroy the timer
+			Callback_v0 func_expired = object->func_expired;
+			if (!func_expired.is_null())
+				func_expired.invoke();
 		}
+
+		// Let the thread find the next timeout
+		update_event.set();
 	}
 
-	Callback_v0 &get_func_expired(int timer_id)
+private:
+	/// \brief Moves a running timer to a later time without taking the lock
+	bool try_extend(Timer_Object *object, ubyte64 new_end_time)
 	{
-		MutexSection mutex_lock(&mutex);
-		return get_timer_object(timer_id).func_expired;
+		while (true)
+		{
+			ubyte64 end_time = Timer_Object::load(&object->end_time);
+			if (end_time == Timer_Object::disarmed || new_end_time < end_time)
+				return false;
+			if (Timer_Object::compare_and_swap(&object->end_time, end_time, new_end_time))
+				return true;
+		}
 	}
 
-private:
-	Timer_Object &get_timer_object(int timer_id)
+	void heap_insert(Timer_Object *object, ubyte64 end_time)
 	{
-		// Find existing timer
-		std::map<int, Timer_Object* >::iterator it = timer_objects.find(timer_id);
-		if (it != timer_objects.end())
+		object->heap_end_time = end_time;
+		object->heap_index = heap.size();
+		heap.push_back(object);
+		sift_up(object->heap_index);
+	}
+
+	void heap_remove(Timer_Object *object)
+	{
+		int index = object->heap_index;
+		Timer_Object *last = heap.back();
+		heap.pop_back();
+		object->heap_index = -1;
+
+		if (last != object)
 		{
-			return *(it->second);
+			heap[index] = last;
+			last->heap_index = index;
+			sift_down(index);
+			sift_up(last->heap_index);
 		}
+	}
+
+	void heap_update(Timer_Object *object, ubyte64 end_time)
+	{
+		ubyte64 old_end_time = object->heap_end_time;
+		object->heap_end_time = end_time;
+		if (end_time < old_end_time)
+			sift_up(object->heap_index);
+		else
+			sift_down(object->heap_index);
+	}
 
-		Timer_Object *object = new Timer_Object;
-		timer_objects[timer_id] = object;
-		return *object;
+	void sift_up(int index)
+	{
+		Timer_Object *object = heap[index];
+		while (index > 0)
+		{
+			int parent = (index - 1) / 2;
+			if (heap[parent]->heap_end_time <= object->heap_end_time)
+				break;
+			heap[index] = heap[parent];
+			heap[index]->heap_index = index;
+			index = parent;
+		}
+		heap[index] = object;
+		object->heap_index = index;
+	}
+
+	void sift_down(int index)
+	{
+		Timer_Object *object = heap[index];
+		int size = heap.size();
+		while (true)
+		{
+			int child = index * 2 + 1;
+			if (child >= size)
+				break;
+			if (child + 1 < size && heap[child + 1]->heap_end_time < heap[child]->heap_end_time)
+				child++;
+			if (object->heap_end_time <= heap[child]->heap_end_time)
+				break;
+			heap[index] = heap[child];
+			heap[index]->heap_index = index;
+			index = child;
+		}
+		heap[index] = object;
+		object->heap_index = index;
 	}
 
 	void timer_main()
@@ -183,51 +340,57 @@ private:
 			if (stop_thread)
 				break;
 
-			ubyte64 current_time = System::get_time();
-			timeout = -1;
-			bool found_timer = false;
+			// Move timers that were pushed further out without the lock
+			while (!heap.empty())
+			{
+				Timer_Object *object = heap[0];
+				ubyte64 end_time = Timer_Object::load(&object->end_time);
+				if (end_time == object->heap_end_time)
+					break;
+				heap_update(object, end_time);
+			}
+
+			int timeout = -1;
+			wakeup_time = Timer_Object::disarmed;
 
-			// Scan for timers to find the next one to call
-			for (std::map<int, Timer_Object *>::iterator it = timer_objects.begin(); it != timer_objects.end(); ++it)
+			// Nothing to do until process() has handled the timers that expired
+			if (!wakeup_pending && !heap.empty())
 			{
-				Timer_Object &object = *(it->second);
-				if (!object.stopped)
-				{
-					if (!found_timer)
-					{
-						// First timer in the list
-						timeout = object.end_time - current_time;
-						found_timer = true;
-					}
-					else
-					{
-						// Get the smallest timeout
-						int next_timeout = object.end_time - current_time;
-						if (next_timeout < timeout)
-						{
-							timeout = next_timeout;
-						}
-					}
-					// Force update, if a timer was missed
-					if (timeout < 1)
-						timeout = 1;
-				}
+				ubyte64 current_time = System::get_time();
+				wakeup_time = heap[0]->heap_end_time;
+				if (wakeup_time > current_time + 0x7fffffff)
+					timeout = 0x7fffffff;
+				else if (wakeup_time > current_time)
+					timeout = (int) (wakeup_time - current_time);
+				else
+					timeout = 0;
 			}
 
 			mutex_lock.unlock();
 
 			if (Event::wait(update_event, timeout) == -1)
+			{
+				mutex_lock.lock();
+				wakeup_pending = true;
+				mutex_lock.unlock();
 				set_wakeup_event();
+			}
 		}
 	}
 
 	Thread thread;
 	Event update_event;
 	Mutex mutex;
-	int timeout;
 	bool stop_thread;
 
-	std::map<int, Timer_Object *> timer_objects;
+	/// \brief Set while waiting for process() to handle expired timers
+	bool wakeup_pending;
+
+	/// \brief Time the thread wakes up to trigger the next timer
+	ubyte64 wakeup_time;
+
+	/// \brief Running timers
+	std::vector<Timer_Object *> heap;
 };
 
 /////////////////////////////////////////////////////////////////////////////
@@ -236,42 +399,44 @@ private:
 class Timer_Impl
 {
 public:
-	Timer_Impl() : timeout(0), repeating(false), id(-1)
+	Timer_Impl() : timer_thread(0), object(0), timeout(0), repeating(false)
 	{
 		// Create a static timer thread if none exist
 		MutexSection mutex_lock(&timer_thread_mutex);
 		if (!timer_thread_instance_count)
 		{
-			timer_thread = new(Timer_Thread);
+			timer_thread_instance = new(Timer_Thread);
 		}
 		timer_thread_instance_count++;
-		timer_thread_max_id++;
-		id = timer_thread_max_id;
+		timer_thread = timer_thread_instance;
+		object = timer_thread->create_timer();
 	}
 
 	~Timer_Impl()
 	{
 		// Destroy the static timer thread if this is the last timer
 		MutexSection mutex_lock(&timer_thread_mutex);
-		timer_thread->remove_timer(id);
+		timer_thread->remove_timer(object);
 		timer_thread_instance_count--;
 		if (!timer_thread_instance_count)
 		{
-			delete timer_thread;
-			timer_thread = NULL;
+			delete timer_thread_instance;
+			timer_thread_instance = NULL;
 		}
 	}
 
+	// The timer thread exists as long as this timer, so it can be used without timer_thread_mutex
+
 	void start(unsigned int new_timeout, bool repeat)
 	{
-		MutexSection mutex_lock(&timer_thread_mutex);
-		timer_thread->start(id, new_timeout, repeat);
+		timeout = new_timeout;
+		repeating = repeat;
+		timer_thread->start(object, new_timeout, repeat);
 	}
 
 	void stop()
 	{
-		MutexSection mutex_lock(&timer_thread_mutex);
-		timer_thread->stop(id);
+		timer_thread->stop(object);
 	}
 
 	bool is_repeating() const { return repeating; }
@@ -279,25 +444,24 @@ public:
 
 	Callback_v0 &func_expired()
 	{
-		MutexSection mutex_lock(&timer_thread_mutex);
-		return timer_thread->get_func_expired(id);
+		return object->func_expired;
 	}
 
+	Timer_Thread *timer_thread;
+	Timer_Object *object;
+
 private:
-	static Timer_Thread *timer_thread;
+	static Timer_Thread *timer_thread_instance;
 	static int timer_thread_instance_count;
 	static Mutex timer_thread_mutex;
-	static int timer_thread_max_id;	// Unique timer id
 
 	unsigned int timeout;
 	bool repeating;
-	int id;
 };
 
-Timer_Thread *Timer_Impl::timer_thread = NULL;
+Timer_Thread *Timer_Impl::timer_thread_instance = NULL;
 int Timer_Impl::timer_thread_instance_count = 0;
 Mutex Timer_Impl::timer_thread_mutex;
-int Timer_Impl::timer_thread_max_id = 0;
 
 /////////////////////////////////////////////////////////////////////////////
 // Timer Construction:
@@ -342,6 +506,19 @@ void Timer::stop()
 	impl->stop();
 }
 
+void Timer::stop(const std::vector<Timer> &timers)
+{
+	if (timers.empty())
+		return;
+
+	std::vector<Timer_Object *> objects;
+	objects.reserve(timers.size());
+	for (size_t i = 0; i < timers.size(); i++)
+		objects.push_back(timers[i].impl->object);
+
+	timers[0].impl->timer_thread->stop(objects);
+}
+
 /////////////////////////////////////////////////////////////////////////////
 // Timer Implementation:
 
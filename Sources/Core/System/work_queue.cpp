@@ -28,38 +28,65 @@
 
 #include "Core/precomp.h"
 #include "API/Core/System/work_queue.h"
-#include "API/Core/System/keep_alive.h"
-#include "API/Core/System/event.h"
-#include "API/Core/System/mutex.h"
-#include "API/Core/System/thread.h"
 #include "API/Core/System/system.h"
+#include "API/Core/System/thread_local_storage.h"
+#include "work_queue_impl.h"
+#include <algorithm>
+
+#ifndef WIN32
+#include <sched.h>
+#endif
 
 #undef max
 
 namespace clan
 {
 
-class WorkQueue_Impl : public KeepAliveObject
+#ifndef __APPLE__
+// cl_tls_variable is not thread local on Apple, so workers are not identified there
+// and tasks queued from a worker go through the injection queue instead.
+static cl_tls_variable WorkQueueWorker *cl_current_work_queue_worker = 0;
+#endif
+
+static void yield_thread()
+{
+#ifdef WIN32
+	SwitchToThread();
+#else
+	sched_yield();
+#endif
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+WorkTask::WorkTask()
 {
-public:
-	WorkQueue_Impl();
-	~WorkQueue_Impl();
+}
 
-	void queue(WorkItem *item); // transfers ownership
+WorkTask::WorkTask(const std::shared_ptr<WorkTask_Impl> &impl)
+: impl(impl)
+{
+}
 
-private:
-	void process();
-	void worker_main();
+bool WorkTask::is_finished() const
+{
+	return !impl || WorkQueue_Impl::is_finished(impl.get());
+}
 
-	std::vector<Thread> threads;
-	Mutex mutex;
-	Event stop_event, work_available_event;
-	std::vector<WorkItem *> queued_items;
-	std::vector<WorkItem *> finished_items;
-};
+/////////////////////////////////////////////////////////////////////////////
 
 WorkQueue::WorkQueue()
-	: impl(new WorkQueue_Impl())
+	: impl(new WorkQueue_Impl(std::max(System::get_num_cores() - 1, 1)))
+{
+}
+
+WorkQueue::WorkQueue(int num_threads)
+	: impl(new WorkQueue_Impl(std::max(num_threads, 1)))
+{
+}
+
+WorkQueue::WorkQueue(const std::shared_ptr<WorkQueue_Impl> &impl)
+	: impl(impl)
 {
 }
 
@@ -67,45 +94,177 @@ WorkQueue::~WorkQueue()
 {
 }
 
+WorkQueue WorkQueue::get_shared()
+{
+	static Mutex mutex;
+	MutexSection mutex_lock(&mutex);
+
+	// Deliberately leaked: the impl is a keep alive object of the thread that created it,
+	// and destroying it from another thread at exit would unregister it from the wrong thread.
+	static std::shared_ptr<WorkQueue_Impl> *shared_impl = 0;
+	if (shared_impl == 0)
+		shared_impl = new std::shared_ptr<WorkQueue_Impl>(new WorkQueue_Impl(std::max(System::get_num_cores() - 1, 1)));
+	return WorkQueue(*shared_impl);
+}
+
+int WorkQueue::get_num_threads() const
+{
+	return impl->get_num_threads();
+}
+
 void WorkQueue::queue(WorkItem *item) // transfers ownership
 {
 	impl->queue(item);
 }
 
+WorkTask WorkQueue::run(const Callback_v0 &func)
+{
+	return WorkTask(impl->run(func, std::shared_ptr<WorkTask_Impl>()));
+}
+
+WorkTask WorkQueue::run_child(const WorkTask &parent, const Callback_v0 &func)
+{
+	if (parent.is_null())
+		throw Exception("Parent task is null");
+	return WorkTask(impl->run(func, parent.impl));
+}
+
+WorkTask WorkQueue::run_after(const WorkTask &task, const Callback_v0 &func)
+{
+	return WorkTask(impl->run_after(std::vector<WorkTask>(1, task), func));
+}
+
+WorkTask WorkQueue::run_after(const std::vector<WorkTask> &tasks, const Callback_v0 &func)
+{
+	return WorkTask(impl->run_after(tasks, func));
+}
+
+void WorkQueue::wait_for(const WorkTask &task)
+{
+	if (!task.is_null())
+		impl->wait_for(task.impl);
+}
+
 /////////////////////////////////////////////////////////////////////////////
 
-WorkQueue_Impl::WorkQueue_Impl()
+WorkQueue_Impl::WorkQueue_Impl(int num_threads)
+: num_injected(0), num_queued(0), num_sleeping(0), num_waiters(0), threads_started(0)
 {
+	for (int i = 0; i < num_threads; i++)
+		workers.push_back(new WorkQueueWorker(this, i));
 }
 
 WorkQueue_Impl::~WorkQueue_Impl()
 {
 	stop_event.set();
-	for (size_t i = 0; i < threads.size(); i++)
-		threads[i].join();
-	for (size_t i = 0; i < queued_items.size(); i++)
-		delete queued_items[i];
+	for (size_t i = 0; i < workers.size(); i++)
+		workers[i]->thread.join();
+
+	// Release tasks that never got to run:
+	for (size_t i = 0; i < workers.size(); i++)
+	{
+		while (true)
+		{
+			WorkTask_Impl *task = workers[i]->deque.pop();
+			if (task == 0)
+				break;
+			delete task->item;
+			task->self.reset();
+		}
+		delete workers[i];
+	}
+	for (size_t i = 0; i < injected_tasks.size(); i++)
+	{
+		delete injected_tasks[i]->item;
+		injected_tasks[i]->self.reset();
+	}
+
 	for (size_t i = 0; i < finished_items.size(); i++)
 		delete finished_items[i];
 }
 
 void WorkQueue_Impl::queue(WorkItem *item) // transfers ownership
 {
-	if (threads.empty())
+	std::shared_ptr<WorkTask_Impl> task(new WorkTask_Impl(this, Callback_v0(this, &WorkQueue_Impl::process_item, item)));
+	task->item = item;
+	submit(task);
+}
+
+std::shared_ptr<WorkTask_Impl> WorkQueue_Impl::run(const Callback_v0 &func, const std::shared_ptr<WorkTask_Impl> &parent)
+{
+	std::shared_ptr<WorkTask_Impl> task(new WorkTask_Impl(this, func));
+	if (parent)
 	{
-		int num_cores = std::max(System::get_num_cores() - 1, 1);
-		for (int i = 0; i < num_cores; i++)
+		while (true)
 		{
-			Thread thread;
-			thread.start(this, &WorkQueue_Impl::worker_main);
-			threads.push_back(thread);
+			int unfinished = WorkQueueAtomic::load(&parent->unfinished);
+			if (unfinished == 0)
+				throw Exception("Cannot add a child to a task that has finished");
+			if (WorkQueueAtomic::compare_and_swap(&parent->unfinished, unfinished, unfinished + 1))
+				break;
 		}
+		task->parent = parent;
 	}
+	submit(task);
+	return task;
+}
 
-	MutexSection mutex_lock(&mutex);
-	queued_items.push_back(item);
-	mutex_lock.unlock();
-	work_available_event.set();
+std::shared_ptr<WorkTask_Impl> WorkQueue_Impl::run_after(const std::vector<WorkTask> &tasks, const Callback_v0 &func)
+{
+	std::shared_ptr<WorkTask_Impl> task(new WorkTask_Impl(this, func));
+
+	// The extra dependency keeps the task from being queued before all predecessors are registered
+	WorkQueueAtomic::store(&task->dependencies, (int) tasks.size() + 1);
+	for (size_t i = 0; i < tasks.size(); i++)
+	{
+		WorkTask_Impl *predecessor = tasks[i].impl.get();
+		bool added = false;
+		if (predecessor)
+		{
+			predecessor->lock();
+			if (!predecessor->finished)
+			{
+				predecessor->continuations.push_back(task);
+				added = true;
+			}
+			predecessor->unlock();
+		}
+		if (!added)
+			WorkQueueAtomic::decrement(&task->dependencies);
+	}
+
+	if (WorkQueueAtomic::decrement(&task->dependencies) == 0)
+		submit(task);
+	return task;
+}
+
+void WorkQueue_Impl::wait_for(const std::shared_ptr<WorkTask_Impl> &task)
+{
+	WorkQueueWorker *worker = get_current_worker();
+	std::unique_ptr<Event> waiter_event;
+	WorkQueueAtomic::increment(&num_waiters);
+	while (!is_finished(task.get()))
+	{
+		WorkTask_Impl *next_task = find_task(worker);
+		if (next_task)
+		{
+			run_task(next_task);
+		}
+		else if (worker)
+		{
+			wait_for_work(task.get(), worker->wakeup_event);
+		}
+		else
+		{
+			if (!waiter_event)
+				waiter_event.reset(new Event());
+			wait_for_work(task.get(), *waiter_event);
+		}
+	}
+	WorkQueueAtomic::decrement(&num_waiters);
+
+	if (task->exception)
+		std::rethrow_exception(task->exception);
 }
 
 void WorkQueue_Impl::process()
@@ -130,30 +289,221 @@ void WorkQueue_Impl::process()
 	}
 }
 
-void WorkQueue_Impl::worker_main()
+void WorkQueue_Impl::worker_main(int index)
 {
+	WorkQueueWorker *worker = workers[index];
+#ifndef __APPLE__
+	cl_current_work_queue_worker = worker;
+#endif
+
+	int idle_rounds = 0;
 	while (true)
 	{
-		int wakeup_reason = Event::wait(stop_event, work_available_event);
-		if (wakeup_reason != 1)
-			break;
-		MutexSection mutex_lock(&mutex);
-		if (!queued_items.empty())
+		WorkTask_Impl *task = find_task(worker);
+		if (task)
 		{
-			WorkItem *item = queued_items.front();
-			queued_items.erase(queued_items.begin());
-			mutex_lock.unlock();
-			item->process_work();
-			mutex_lock.lock();
-			finished_items.push_back(item);
-			mutex_lock.unlock();
-			set_wakeup_event();
+			run_task(task);
+			idle_rounds = 0;
+		}
+		else if (++idle_rounds < 64)
+		{
+			yield_thread();
 		}
 		else
 		{
-			work_available_event.reset();
+			idle_rounds = 0;
+			if (!wait_for_work(0, worker->wakeup_event))
+				break;
+		}
+	}
+}
+
+void WorkQueue_Impl::process_item(WorkItem *item)
+{
+	try
+	{
+		item->process_work();
+	}
+	catch (...)
+	{
+		delete item;
+		throw;
+	}
+	MutexSection mutex_lock(&mutex);
+	finished_items.push_back(item);
+	mutex_lock.unlock();
+	set_wakeup_event();
+}
+
+WorkQueueWorker *WorkQueue_Impl::get_current_worker()
+{
+#ifndef __APPLE__
+	WorkQueueWorker *worker = cl_current_work_queue_worker;
+	if (worker && worker->queue == this)
+		return worker;
+#endif
+	return 0;
+}
+
+void WorkQueue_Impl::submit(const std::shared_ptr<WorkTask_Impl> &task)
+{
+	task->self = task;
+
+	WorkQueueWorker *worker = get_current_worker();
+	if (worker)
+	{
+		worker->deque.push(task.get());
+	}
+	else
+	{
+		MutexSection mutex_lock(&injected_mutex);
+		injected_tasks.push_back(task.get());
+		WorkQueueAtomic::increment(&num_injected);
+	}
+
+	WorkQueueAtomic::increment(&num_queued);
+	if (WorkQueueAtomic::load(&threads_started) == 0)
+		start_threads();
+	if (WorkQueueAtomic::load(&num_sleeping) > 0)
+		wake_sleepers();
+}
+
+void WorkQueue_Impl::start_threads()
+{
+	MutexSection mutex_lock(&start_mutex);
+	if (WorkQueueAtomic::load(&threads_started) == 0)
+	{
+		for (size_t i = 0; i < workers.size(); i++)
+			workers[i]->thread.start(this, &WorkQueue_Impl::worker_main, (int) i);
+		WorkQueueAtomic::store(&threads_started, 1);
+	}
+}
+
+WorkTask_Impl *WorkQueue_Impl::find_task(WorkQueueWorker *worker)
+{
+	WorkTask_Impl *task = 0;
+	if (worker)
+		task = worker->deque.pop();
+
+	if (task == 0 && WorkQueueAtomic::load(&num_injected) > 0)
+	{
+		MutexSection mutex_lock(&injected_mutex);
+		if (!injected_tasks.empty())
+		{
+			task = injected_tasks.front();
+			injected_tasks.pop_front();
+			WorkQueueAtomic::decrement(&num_injected);
 		}
 	}
+
+	if (task == 0)
+	{
+		int num_workers = (int) workers.size();
+		unsigned int start = 0;
+		if (worker)
+		{
+			worker->random_seed = worker->random_seed * 1103515245 + 12345;
+			start = worker->random_seed >> 16;
+		}
+		for (int i = 0; i < num_workers && task == 0; i++)
+		{
+			WorkQueueWorker *victim = workers[(start + i) % num_workers];
+			if (victim != worker)
+				task = victim->deque.steal();
+		}
+	}
+
+	if (task)
+		WorkQueueAtomic::decrement(&num_queued);
+	return task;
+}
+
+void WorkQueue_Impl::run_task(WorkTask_Impl *task_ptr)
+{
+	std::shared_ptr<WorkTask_Impl> task;
+	task.swap(task_ptr->self);
+	try
+	{
+		task->func.invoke();
+	}
+	catch (...)
+	{
+		// The task still finishes, so nobody waiting for it hangs
+		task->lock();
+		if (!task->exception)
+			task->exception = std::current_exception();
+		task->unlock();
+	}
+	task->func.clear();
+	finish_task(task);
+}
+
+void WorkQueue_Impl::finish_task(std::shared_ptr<WorkTask_Impl> task)
+{
+	while (task)
+	{
+		if (WorkQueueAtomic::decrement(&task->unfinished) != 0)
+			break;
+
+		std::vector<std::shared_ptr<WorkTask_Impl> > continuations;
+		task->lock();
+		task->finished = true;
+		continuations.swap(task->continuations);
+		task->unlock();
+
+		for (size_t i = 0; i < continuations.size(); i++)
+		{
+			if (WorkQueueAtomic::decrement(&continuations[i]->dependencies) == 0)
+				submit(continuations[i]);
+		}
+
+		if (WorkQueueAtomic::load(&num_waiters) > 0)
+			wake_sleepers();
+
+		std::shared_ptr<WorkTask_Impl> parent;
+		parent.swap(task->parent);
+		if (parent && task->exception)
+		{
+			parent->lock();
+			if (!parent->exception)
+				parent->exception = task->exception;
+			parent->unlock();
+		}
+		task = parent;
+	}
+}
+
+bool WorkQueue_Impl::wait_for_work(WorkTask_Impl *waiting_for, Event &wakeup_event)
+{
+	// Every sleeper has its own event, so no other thread can reset a wakeup
+	// meant for this one. The event is registered and num_sleeping raised
+	// before checking for work: a thread queueing work either sees the
+	// sleeper and sets its event, or its work is seen by the check.
+	MutexSection mutex_lock(&sleep_mutex);
+	wakeup_event.reset();
+	sleeping_events.push_back(&wakeup_event);
+	WorkQueueAtomic::increment(&num_sleeping);
+	bool wakeup = WorkQueueAtomic::load(&num_queued) > 0 || (waiting_for && is_finished(waiting_for));
+	if (!wakeup)
+	{
+		mutex_lock.unlock();
+		wakeup = Event::wait(stop_event, wakeup_event) == 1;
+		mutex_lock.lock();
+	}
+
+	std::vector<Event *>::iterator it = std::find(sleeping_events.begin(), sleeping_events.end(), &wakeup_event);
+	if (it != sleeping_events.end())
+		sleeping_events.erase(it);
+	WorkQueueAtomic::decrement(&num_sleeping);
+	return wakeup;
+}
+
+void WorkQueue_Impl::wake_sleepers()
+{
+	MutexSection mutex_lock(&sleep_mutex);
+	for (size_t i = 0; i < sleeping_events.size(); i++)
+		sleeping_events[i]->set();
+	sleeping_events.clear();
 }
 
 }
@@ -0,0 +1,297 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Magnus Norddahl
+*/
+
+#pragma once
+
+#include "API/Core/System/work_queue.h"
+#include "API/Core/System/keep_alive.h"
+#include "API/Core/System/event.h"
+#include "API/Core/System/mutex.h"
+#include "API/Core/System/thread.h"
+#include <deque>
+#include <exception>
+
+#ifdef WIN32
+#include <windows.h>
+#endif
+
+namespace clan
+{
+
+/// \brief Atomic operations on plain integers
+///
+/// Unlike InterlockedVariable these do not allocate, which matters for
+/// objects created once per task. All operations are full barriers.
+class WorkQueueAtomic
+{
+public:
+#ifdef WIN32
+	static int load(volatile int *value) { return InterlockedCompareExchange((volatile LONG *) value, 0, 0); }
+	static void store(volatile int *value, int new_value) { InterlockedExchange((volatile LONG *) value, new_value); }
+	static int increment(volatile int *value) { return InterlockedIncrement((volatile LONG *) value); }
+	static int decrement(volatile int *value) { return InterlockedDecrement((volatile LONG *) value); }
+	static bool compare_and_swap(volatile int *value, int expected_value, int new_value) { return InterlockedCompareExchange((volatile LONG *) value, new_value, expected_value) == expected_value; }
+#else
+	static int load(volatile int *value) { return __sync_val_compare_and_swap(value, 0, 0); }
+	static void store(volatile int *value, int new_value) { __sync_lock_test_and_set(value, new_value); __sync_synchronize(); }
+	static int increment(volatile int *value) { return __sync_add_and_fetch(value, 1); }
+	static int decrement(volatile int *value) { return __sync_sub_and_fetch(value, 1); }
+	static bool compare_and_swap(volatile int *value, int expected_value, int new_value) { return __sync_bool_compare_and_swap(value, expected_value, new_value); }
+#endif
+
+	/// \brief Adds to an index, wrapping around instead of overflowing
+	static int add(int index, int delta) { return (int) ((unsigned int) index + (unsigned int) delta); }
+
+	/// \brief Distance between two indexes that may have wrapped around
+	static int distance(int from, int to) { return (int) ((unsigned int) to - (unsigned int) from); }
+};
+
+/// \brief Chase-Lev work stealing deque
+///
+/// The owning thread pushes and pops at the bottom. Other threads steal
+/// from the top. Buffers replaced when growing are kept until destruction,
+/// since a thief may still be reading from them.
+template<typename Type>
+class WorkStealingDeque
+{
+public:
+	WorkStealingDeque()
+	: top(0), bottom(0)
+	{
+		Buffer *initial = new Buffer(1024);
+		buffers.push_back(initial);
+		buffer = initial;
+	}
+
+	~WorkStealingDeque()
+	{
+		for (size_t i = 0; i < buffers.size(); i++)
+			delete buffers[i];
+	}
+
+	/// \brief Adds an item at the bottom. Owner thread only.
+	void push(Type *item)
+	{
+		int b = WorkQueueAtomic::load(&bottom);
+		int t = WorkQueueAtomic::load(&top);
+		Buffer *current = buffer;
+		if (WorkQueueAtomic::distance(t, b) >= current->capacity - 1)
+		{
+			Buffer *grown = new Buffer(current->capacity * 2);
+			for (int i = t; i != b; i = WorkQueueAtomic::add(i, 1))
+				grown->set(i, current->get(i));
+			buffers.push_back(grown);
+			buffer = grown;
+			current = grown;
+		}
+		current->set(b, item);
+		WorkQueueAtomic::increment(&bottom);
+	}
+
+	/// \brief Removes an item from the bottom. Owner thread only.
+	Type *pop()
+	{
+		int b = WorkQueueAtomic::decrement(&bottom);
+		int t = WorkQueueAtomic::load(&top);
+		int size = WorkQueueAtomic::distance(t, b);
+		if (size < 0)
+		{
+			WorkQueueAtomic::store(&bottom, t);
+			return 0;
+		}
+
+		Type *item = buffer->get(b);
+		if (size > 0)
+			return item;
+
+		// Last item. Race any thieves for it:
+		if (!WorkQueueAtomic::compare_and_swap(&top, t, WorkQueueAtomic::add(t, 1)))
+			item = 0;
+		WorkQueueAtomic::store(&bottom, WorkQueueAtomic::add(t, 1));
+		return item;
+	}
+
+	/// \brief Removes an item from the top. Any thread.
+	///
+	/// Returns null if the deque is empty or another thread took the item first.
+	Type *steal()
+	{
+		int t = WorkQueueAtomic::load(&top);
+		int b = WorkQueueAtomic::load(&bottom);
+		if (WorkQueueAtomic::distance(t, b) <= 0)
+			return 0;
+
+		Type *item = buffer->get(t);
+		if (!WorkQueueAtomic::compare_and_swap(&top, t, WorkQueueAtomic::add(t, 1)))
+			return 0;
+		return item;
+	}
+
+private:
+	struct Buffer
+	{
+		Buffer(int capacity) : capacity(capacity), items(new Type *[capacity]) { }
+		~Buffer() { delete[] items; }
+
+		Type *get(int index) const { return items[(unsigned int) index & (capacity - 1)]; }
+		void set(int index, Type *item) { items[(unsigned int) index & (capacity - 1)] = item; }
+
+		int capacity;
+		Type * volatile *items;
+	};
+
+	volatile int top;
+	volatile int bottom;
+	Buffer * volatile buffer;
+	std::vector<Buffer *> buffers;
+
+	WorkStealingDeque(const WorkStealingDeque &);
+	WorkStealingDeque &operator=(const WorkStealingDeque &);
+};
+
+class WorkQueue_Impl;
+
+class WorkTask_Impl
+{
+public:
+	WorkTask_Impl(WorkQueue_Impl *queue, const Callback_v0 &func)
+	: queue(queue), func(func), item(0), unfinished(1), dependencies(0), lock_flag(0), finished(false)
+	{
+	}
+
+	void lock() { while (!WorkQueueAtomic::compare_and_swap(&lock_flag, 0, 1)) { } }
+	void unlock() { WorkQueueAtomic::store(&lock_flag, 0); }
+
+	WorkQueue_Impl *queue;
+
+	Callback_v0 func;
+
+	/// \brief Item passed to WorkQueue::queue, deleted if the task never runs
+	WorkItem *item;
+
+	/// \brief The task itself plus its unfinished children
+	volatile int unfinished;
+
+	/// \brief Tasks that must finish before this one can be queued
+	volatile int dependencies;
+
+	/// \brief Parent waiting for this task to finish
+	std::shared_ptr<WorkTask_Impl> parent;
+
+	/// \brief Keeps the task alive while it is in a deque
+	std::shared_ptr<WorkTask_Impl> self;
+
+	/// \brief Protects finished, continuations and exception
+	volatile int lock_flag;
+
+	bool finished;
+
+	std::vector<std::shared_ptr<WorkTask_Impl> > continuations;
+
+	/// \brief Exception thrown by the task or one of its children, rethrown by wait_for
+	std::exception_ptr exception;
+};
+
+class WorkQueueWorker
+{
+public:
+	WorkQueueWorker(WorkQueue_Impl *queue, int index) : queue(queue), index(index), random_seed(index * 7919 + 1) { }
+
+	WorkQueue_Impl *queue;
+	int index;
+	unsigned int random_seed;
+	Thread thread;
+	WorkStealingDeque<WorkTask_Impl> deque;
+
+	/// \brief Set when work is queued while the worker sleeps
+	Event wakeup_event;
+};
+
+class WorkQueue_Impl : public KeepAliveObject
+{
+public:
+	WorkQueue_Impl(int num_threads);
+	~WorkQueue_Impl();
+
+	int get_num_threads() const { return (int) workers.size(); }
+
+	void queue(WorkItem *item); // transfers ownership
+
+	std::shared_ptr<WorkTask_Impl> run(const Callback_v0 &func, const std::shared_ptr<WorkTask_Impl> &parent);
+	std::shared_ptr<WorkTask_Impl> run_after(const std::vector<WorkTask> &tasks, const Callback_v0 &func);
+	void wait_for(const std::shared_ptr<WorkTask_Impl> &task);
+
+	static bool is_finished(WorkTask_Impl *task) { return WorkQueueAtomic::load(&task->unfinished) == 0; }
+
+private:
+	void process();
+	void worker_main(int index);
+	void process_item(WorkItem *item);
+
+	WorkQueueWorker *get_current_worker();
+	void submit(const std::shared_ptr<WorkTask_Impl> &task);
+	WorkTask_Impl *find_task(WorkQueueWorker *worker);
+	void run_task(WorkTask_Impl *task);
+	void finish_task(std::shared_ptr<WorkTask_Impl> task);
+	bool wait_for_work(WorkTask_Impl *waiting_for, Event &wakeup_event);
+	void wake_sleepers();
+	void start_threads();
+
+	std::vector<WorkQueueWorker *> workers;
+
+	Mutex injected_mutex;
+	std::deque<WorkTask_Impl *> injected_tasks;
+	volatile int num_injected;
+
+	/// \brief Tasks sitting in a deque or the injection queue
+	volatile int num_queued;
+
+	/// \brief Threads about to sleep or sleeping in wait_for_work
+	volatile int num_sleeping;
+
+	/// \brief Threads inside wait_for
+	volatile int num_waiters;
+
+	/// \brief Set once the worker threads are started by the first submit
+	volatile int threads_started;
+
+	Mutex start_mutex;
+
+	/// \brief Protects sleeping_events
+	Mutex sleep_mutex;
+
+	/// \brief Wakeup events of the sleeping threads not yet woken
+	std::vector<Event *> sleeping_events;
+
+	Event stop_event;
+
+	Mutex mutex;
+	std::vector<WorkItem *> finished_items;
+};
+
+}
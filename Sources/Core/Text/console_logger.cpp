@@ -58,7 +58,12 @@ ConsoleLogger::~ConsoleLogger()
 
 void ConsoleLogger::log(const std::string &type, const std::string &text)
 {
-	std::string months[] =
+	log_at(type, text, DateTime::get_current_utc_time());
+}
+
+void ConsoleLogger::log_at(const std::string &type, const std::string &text, const DateTime &time)
+{
+	static const char *months[] =
 	{
 		"Jan",
 		"Feb",
@@ -74,7 +79,7 @@ void ConsoleLogger::log(const std::string &type, const std::string &text)
 		"Dec"
 	};
 	
-	std::string days[] =
+	static const char *days[] =
 	{
 		"Sun",
 		"Mon",
@@ -86,20 +91,18 @@ void ConsoleLogger::log(const std::string &type, const std::string &text)
 	};
 
 	// Tue Nov 16 11:34:15 2004 UTC
-	DateTime cur_time = DateTime::get_current_utc_time();
-
 #ifdef WIN32
 	StringFormat format("%1 %2 %3 %4:%5:%6 %7 UTC [%8] %9\r\n");
 #else
 	StringFormat format("%1 %2 %3 %4:%5:%6 %7 UTC [%8] %9\n");
 #endif
-	format.set_arg(1, days[cur_time.get_day_of_week()]);
-	format.set_arg(2, months[cur_time.get_month() - 1]);
-	format.set_arg(3, cur_time.get_day());
-	format.set_arg(4, cur_time.get_hour(), 2);
-	format.set_arg(5, cur_time.get_minutes(), 2);
-	format.set_arg(6, cur_time.get_seconds(), 2);
-	format.set_arg(7, cur_time.get_year());
+	format.set_arg(1, days[time.get_day_of_week()]);
+	format.set_arg(2, months[time.get_month() - 1]);
+	format.set_arg(3, time.get_day());
+	format.set_arg(4, time.get_hour(), 2);
+	format.set_arg(5, time.get_minutes(), 2);
+	format.set_arg(6, time.get_seconds(), 2);
+	format.set_arg(7, time.get_year());
 	format.set_arg(8, type);
 	format.set_arg(9, text);
 
@@ -39,13 +39,15 @@ namespace clan
 /////////////////////////////////////////////////////////////////////////////
 // FileLogger Construction:
 
-FileLogger::FileLogger(const std::string &filename) : file(0)
+FileLogger::FileLogger(const std::string &filename) : file(0), cached_second(0)
 {
 	file = new File(filename, File::open_always, File::access_read_write);
 }
 
 FileLogger::~FileLogger()
 {
+	disable();
+	flush();
 	delete file;
 }
 
@@ -57,7 +59,13 @@ FileLogger::~FileLogger()
 
 void FileLogger::log(const std::string &type, const std::string &text)
 {
-	std::string months[] =
+	log_at(type, text, DateTime::get_current_utc_time());
+	flush();
+}
+
+void FileLogger::log_at(const std::string &type, const std::string &text, const DateTime &time)
+{
+	static const char *months[] =
 	{
 		"Jan",
 		"Feb",
@@ -73,7 +81,7 @@ void FileLogger::log(const std::string &type, const std::string &text)
 		"Dec"
 	};
 	
-	std::string days[] =
+	static const char *days[] =
 	{
 		"Sun",
 		"Mon",
@@ -84,27 +92,43 @@ void FileLogger::log(const std::string &type, const std::string &text)
 		"Sat"
 	};
 
-	// Tue Nov 16 11:34:15 CET 2004
-	DateTime cur_time = DateTime::get_current_utc_time();
+	// Records arrive in batches, mostly within the same second
+	byte64 second = time.to_ticks() / 10000000;
+	if (cached_time.empty() || second != cached_second)
+	{
+		// Tue Nov 16 11:34:15 2004 UTC
+		StringFormat format("%1 %2 %3 %4:%5:%6 %7 UTC");
+		format.set_arg(1, days[time.get_day_of_week()]);
+		format.set_arg(2, months[time.get_month() - 1]);
+		format.set_arg(3, time.get_day());
+		format.set_arg(4, time.get_hour(), 2);
+		format.set_arg(5, time.get_minutes(), 2);
+		format.set_arg(6, time.get_seconds(), 2);
+		format.set_arg(7, time.get_year());
+		cached_time = format.get_result();
+		cached_second = second;
+	}
 
+	buffer += cached_time;
+	buffer += " [";
+	buffer += StringHelp::text_to_local8(type);
+	buffer += "] ";
+	buffer += StringHelp::text_to_local8(text);
 #ifdef WIN32
-	StringFormat format("%1 %2 %3 %4:%5:%6 %7 UTC [%8] %9\r\n");
+	buffer += "\r\n";
 #else
-	StringFormat format("%1 %2 %3 %4:%5:%6 %7 UTC [%8] %9\n");
+	buffer += "\n";
 #endif
-	format.set_arg(1, days[cur_time.get_day_of_week()]);
-	format.set_arg(2, months[cur_time.get_month() - 1]);
-	format.set_arg(3, cur_time.get_day());
-	format.set_arg(4, cur_time.get_hour(), 2);
-	format.set_arg(5, cur_time.get_minutes(), 2);
-	format.set_arg(6, cur_time.get_seconds(), 2);
-	format.set_arg(7, cur_time.get_year());
-	format.set_arg(8, type);
-	format.set_arg(9, text);
-	std::string log_line = StringHelp::text_to_local8(format.get_result());
+}
+
+void FileLogger::flush()
+{
+	if (buffer.empty())
+		return;
 
 	file->seek(0, File::seek_end);
-	file->write(log_line.data(), (int) log_line.length());
+	file->write(buffer.data(), (int) buffer.length());
+	buffer.clear();
 }
 
 /////////////////////////////////////////////////////////////////////////////
@@ -28,6 +28,7 @@
 
 #include "Core/precomp.h"
 #include "API/Core/Text/logger.h"
+#include "logger_async.h"
 #include <algorithm>
 
 namespace clan
@@ -76,8 +77,37 @@ void Logger::log(const std::string &type, const std::string &text)
 	throw Exception("Implement me");
 }
 
+void Logger::log_at(const std::string &type, const std::string &text, const DateTime &time)
+{
+	log(type, text);
+}
+
+void Logger::flush()
+{
+}
+
+void Logger::enable_async(OverflowPolicy policy, int queue_size)
+{
+	disable_async();
+	Logger_AsyncWriter::instance = new Logger_AsyncWriter(policy, queue_size);
+}
+
+void Logger::disable_async()
+{
+	Logger_AsyncWriter *writer = Logger_AsyncWriter::instance;
+	Logger_AsyncWriter::instance = 0;
+	delete writer;
+}
+
 void log_event(const std::string &type, const std::string &text)
 {
+	Logger_AsyncWriter *writer = Logger_AsyncWriter::instance;
+	if (writer)
+	{
+		writer->log(type, text);
+		return;
+	}
+
 	MutexSection mutex_lock(&Logger::mutex);
 	if (Logger::instances.empty())
 		return;
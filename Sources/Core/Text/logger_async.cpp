@@ -0,0 +1,242 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Magnus Norddahl
+*/
+
+#include "Core/precomp.h"
+#include "logger_async.h"
+#include "API/Core/System/system.h"
+#include "API/Core/System/thread_local_storage.h"
+
+namespace clan
+{
+
+/////////////////////////////////////////////////////////////////////////////
+// Logger_AsyncQueue:
+
+Logger_AsyncQueue::Logger_AsyncQueue(int size) : records(0), mask(0), push_pos(0), pop_pos(0)
+{
+	int capacity = 2;
+	while (capacity < size)
+		capacity *= 2;
+
+	records = new Logger_AsyncRecord[capacity];
+	mask = capacity - 1;
+	for (int i = 0; i < capacity; i++)
+		records[i].sequence = i;
+}
+
+Logger_AsyncQueue::~Logger_AsyncQueue()
+{
+	delete[] records;
+}
+
+bool Logger_AsyncQueue::push(const std::string &type, const std::string &text, const DateTime &time)
+{
+	// Positions are compared as differences, so they may wrap around
+	int pos = push_pos;
+	Logger_AsyncRecord *record;
+	while (true)
+	{
+		record = &records[pos & mask];
+		int difference = (int) ((unsigned int) record->sequence - (unsigned int) pos);
+		if (difference == 0)
+		{
+			if (Logger_AsyncWriter::compare_and_swap(&push_pos, pos, (int) ((unsigned int) pos + 1)))
+				break;
+			pos = push_pos;
+		}
+		else if (difference < 0)
+		{
+			// The writer has not freed this slot from the previous lap yet
+			return false;
+		}
+		else
+		{
+			pos = push_pos;
+		}
+	}
+
+	record->type = type;
+	record->text = text;
+	record->time = time;
+
+	Logger_AsyncWriter::memory_barrier();
+	record->sequence = (int) ((unsigned int) pos + 1);
+	return true;
+}
+
+Logger_AsyncRecord *Logger_AsyncQueue::front()
+{
+	Logger_AsyncRecord *record = &records[pop_pos & mask];
+	if (record->sequence != (int) ((unsigned int) pop_pos + 1))
+		return 0;
+	Logger_AsyncWriter::memory_barrier();
+	return record;
+}
+
+void Logger_AsyncQueue::pop()
+{
+	Logger_AsyncRecord *record = &records[pop_pos & mask];
+	Logger_AsyncWriter::memory_barrier();
+	record->sequence = (int) ((unsigned int) pop_pos + mask + 1);
+	pop_pos = (int) ((unsigned int) pop_pos + 1);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Logger_AsyncWriter:
+
+Logger_AsyncWriter * volatile Logger_AsyncWriter::instance = 0;
+
+// Not thread local on Apple, where all threads then share one queue. The queues accept
+// any number of threads, so this only costs contention.
+static cl_tls_variable int cl_log_queue_index = -1;
+static volatile int cl_log_queue_count = 0;
+
+Logger_AsyncWriter::Logger_AsyncWriter(Logger::OverflowPolicy policy, int queue_size)
+: policy(policy), wakeup_event(false), writer_sleeping(0), stop_flag(0), dropped_count(0)
+{
+	int num_queues = System::get_num_cores() * 2;
+	if (num_queues > 64)
+		num_queues = 64;
+
+	for (int i = 0; i < num_queues; i++)
+		queues.push_back(new Logger_AsyncQueue(queue_size));
+
+	thread.start(this, &Logger_AsyncWriter::writer_main);
+}
+
+Logger_AsyncWriter::~Logger_AsyncWriter()
+{
+	exchange(&stop_flag, 1);
+	wakeup_event.set();
+	thread.join();
+
+	for (size_t i = 0; i < queues.size(); i++)
+		delete queues[i];
+}
+
+void Logger_AsyncWriter::log(const std::string &type, const std::string &text)
+{
+	DateTime time = DateTime::get_current_utc_time();
+
+	Logger_AsyncQueue &queue = get_queue();
+	while (!queue.push(type, text, time))
+	{
+		if (policy == Logger::overflow_drop)
+		{
+			increment(&dropped_count);
+			return;
+		}
+
+		wake_writer();
+#ifdef WIN32
+		SwitchToThread();
+#else
+		sched_yield();
+#endif
+	}
+
+	// Pairs with the barrier in writer_main, so either the writer sees the
+	// record before it sleeps or this thread sees that it is sleeping
+	memory_barrier();
+	if (writer_sleeping)
+		wake_writer();
+}
+
+void Logger_AsyncWriter::wake_writer()
+{
+	if (compare_and_swap(&writer_sleeping, 1, 0))
+		wakeup_event.set();
+}
+
+Logger_AsyncQueue &Logger_AsyncWriter::get_queue()
+{
+	if (cl_log_queue_index == -1)
+		cl_log_queue_index = increment(&cl_log_queue_count) - 1;
+	return *queues[(unsigned int) cl_log_queue_index % queues.size()];
+}
+
+void Logger_AsyncWriter::writer_main()
+{
+	while (true)
+	{
+		// Read before writing so records queued before the destructor are written
+		bool stopping = stop_flag != 0;
+		if (write_queued())
+			continue;
+		if (stopping)
+			break;
+
+		exchange(&writer_sleeping, 1);
+		if (!write_queued())
+			wakeup_event.wait(max_write_delay);
+		exchange(&writer_sleeping, 0);
+	}
+}
+
+bool Logger_AsyncWriter::write_queued()
+{
+	MutexSection mutex_lock(&Logger::mutex);
+
+	bool written = false;
+	int dropped = exchange(&dropped_count, 0);
+	if (dropped != 0)
+	{
+		StringFormat format("%1 log records were dropped");
+		format.set_arg(1, dropped);
+		DateTime time = DateTime::get_current_utc_time();
+		for (size_t i = 0; i < Logger::instances.size(); i++)
+			Logger::instances[i]->log_at("log", format.get_result(), time);
+		written = true;
+	}
+
+	for (size_t i = 0; i < queues.size(); i++)
+	{
+		// Limit each batch so one busy thread cannot starve the other queues
+		for (int count = 0; count < 256; count++)
+		{
+			Logger_AsyncRecord *record = queues[i]->front();
+			if (record == 0)
+				break;
+
+			for (size_t j = 0; j < Logger::instances.size(); j++)
+				Logger::instances[j]->log_at(record->type, record->text, record->time);
+			queues[i]->pop();
+			written = true;
+		}
+	}
+
+	if (written)
+	{
+		for (size_t i = 0; i < Logger::instances.size(); i++)
+			Logger::instances[i]->flush();
+	}
+
+	return written;
+}
+
+}
@@ -0,0 +1,147 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Magnus Norddahl
+*/
+
+#pragma once
+
+#include "API/Core/Text/logger.h"
+#include "API/Core/System/datetime.h"
+#include "API/Core/System/thread.h"
+#include "API/Core/System/event.h"
+#include <vector>
+
+#ifdef WIN32
+#include <windows.h>
+#endif
+
+namespace clan
+{
+
+/// \brief Log record waiting to be written
+class Logger_AsyncRecord
+{
+public:
+	Logger_AsyncRecord() : sequence(0) { }
+
+	volatile int sequence;
+	std::string type;
+	std::string text;
+	DateTime time;
+};
+
+/// \brief Bounded lock free queue of log records
+///
+/// Any number of threads can push, only the writer thread pops. Each slot has
+/// a sequence number telling whether it is free or holds a record for the
+/// current lap, so a push is one compare and swap and no thread ever waits on
+/// another. The strings in a slot keep their capacity between records.
+class Logger_AsyncQueue
+{
+public:
+	Logger_AsyncQueue(int size);
+	~Logger_AsyncQueue();
+
+	/// \brief Queues a record. Returns false if the queue is full.
+	bool push(const std::string &type, const std::string &text, const DateTime &time);
+
+	/// \brief Returns the oldest record or null if the queue is empty. Writer thread only.
+	Logger_AsyncRecord *front();
+
+	/// \brief Frees the record returned by front(). Writer thread only.
+	void pop();
+
+private:
+	Logger_AsyncQueue(const Logger_AsyncQueue &);
+	Logger_AsyncQueue &operator =(const Logger_AsyncQueue &);
+
+	Logger_AsyncRecord *records;
+	int mask;
+
+	// Kept on separate cache lines so producers and the writer do not share one
+	char padding0[64];
+	volatile int push_pos;
+	char padding1[64];
+	int pop_pos;
+	char padding2[64];
+};
+
+/// \brief Writes queued log records to the enabled loggers on a background thread
+class Logger_AsyncWriter
+{
+public:
+	Logger_AsyncWriter(Logger::OverflowPolicy policy, int queue_size);
+
+	/// \brief Writes all queued records and stops the thread
+	~Logger_AsyncWriter();
+
+	/// \brief Queues a record. Called by log_event on any thread.
+	void log(const std::string &type, const std::string &text);
+
+	/// \brief The writer used by log_event, or null when logging is synchronous
+	static Logger_AsyncWriter * volatile instance;
+
+#ifdef WIN32
+	static int exchange(volatile int *value, int new_value) { return InterlockedExchange((volatile LONG *) value, new_value); }
+	static int increment(volatile int *value) { return InterlockedIncrement((volatile LONG *) value); }
+	static bool compare_and_swap(volatile int *value, int expected_value, int new_value) { return InterlockedCompareExchange((volatile LONG *) value, new_value, expected_value) == expected_value; }
+	static void memory_barrier() { MemoryBarrier(); }
+#else
+	static int exchange(volatile int *value, int new_value) { int old_value = __sync_lock_test_and_set(value, new_value); __sync_synchronize(); return old_value; }
+	static int increment(volatile int *value) { return __sync_add_and_fetch(value, 1); }
+	static bool compare_and_swap(volatile int *value, int expected_value, int new_value) { return __sync_bool_compare_and_swap(value, expected_value, new_value); }
+	static void memory_barrier() { __sync_synchronize(); }
+#endif
+
+private:
+	Logger_AsyncWriter(const Logger_AsyncWriter &);
+	Logger_AsyncWriter &operator =(const Logger_AsyncWriter &);
+
+	void writer_main();
+
+	/// \brief Writes everything queued so far. Returns false if nothing was queued.
+	bool write_queued();
+
+	void wake_writer();
+
+	Logger_AsyncQueue &get_queue();
+
+	Logger::OverflowPolicy policy;
+
+	/// \brief Queues threads are spread over to keep them from contending on one
+	std::vector<Logger_AsyncQueue *> queues;
+
+	Thread thread;
+	Event wakeup_event;
+	volatile int writer_sleeping;
+	volatile int stop_flag;
+	volatile int dropped_count;
+
+	/// \brief Longest time records wait when the writer was not woken up
+	static const int max_write_delay = 20;
+};
+
+}
@@ -44,6 +44,7 @@
 #include "API/Core/XML/xml_writer.h"
 #include "API/Core/XML/xml_token.h"
 #include "dom_document_generic.h"
+#include "xml_tokenizer_generic.h"
 #include <stack>
 
 namespace clan
@@ -277,105 +278,34 @@ std::vector<DomNode> DomDocument::load(
 {
 	clear_all();
 
-	XMLTokenizer tokenizer(input);
-	tokenizer.set_eat_whitespace(eat_whitespace);
+	XMLTokenizer_Impl tokenizer;
+	tokenizer.eat_whitespace = eat_whitespace;
+	tokenizer.load(input);
 
 	if (insert_point.is_element() == false)
 		insert_point = *this;
 
-	std::vector<DomNode> node_stack;
-	node_stack.push_back(insert_point);
-
-	std::vector<DomNode> result;
+	// The tree nodes are built straight from the tokenizer data, without going through XMLToken or DomNode objects:
+	DomDocument_Impl *doc_impl = static_cast<DomDocument_Impl *>(impl.get());
+	std::vector<unsigned int> top_level_nodes;
 	try
 	{
-		XMLToken cur_token;
-		tokenizer.next(&cur_token);
-		while (cur_token.type != XMLToken::NULL_TOKEN)
-		{
-			switch (cur_token.type)
-			{
-			case XMLToken::TEXT_TOKEN:
-				node_stack.back().append_child(create_text_node(cur_token.value));
-				if (node_stack.back() == insert_point)
-					result.push_back(node_stack.back().get_last_child());
-				break;
-
-			case XMLToken::CDATA_SECTION_TOKEN:
-				node_stack.back().append_child(create_cdata_section(cur_token.value));
-				if (node_stack.back() == insert_point)
-					result.push_back(node_stack.back().get_last_child());
-				break;
-
-			case XMLToken::ELEMENT_TOKEN:
-				if (cur_token.variant != XMLToken::END)
-				{
-					DomString namespace_uri = DomDocument_Impl::find_namespace_uri(cur_token.name, cur_token, node_stack.back());
-					DomElement element = create_element_ns(namespace_uri, cur_token.name);
-					node_stack.back().append_child(element);
-					if (node_stack.back() == insert_point)
-						result.push_back(node_stack.back().get_last_child());
-
-					int size = (int) cur_token.attributes.size();
-					for (int i=0; i<size; i++)
-					{
-						XMLToken::Attribute &attribute = cur_token.attributes[i];
-						DomString attribute_namespace_uri = DomDocument_Impl::find_namespace_uri(attribute.first, cur_token, node_stack.back());
-						element.set_attribute_ns(
-							attribute_namespace_uri,
-							attribute.first,
-							attribute.second);
-					}
-				
-					if (cur_token.variant == XMLToken::BEGIN)
-						node_stack.push_back(element);
-				}
-				else
-				{
-					node_stack.pop_back();
-					if (node_stack.empty()) throw Exception("Malformed XML tree!");
-				}
-				break;
-
-			case XMLToken::NULL_TOKEN: 
-				break;
-
-			case XMLToken::ENTITY_REFERENCE_TOKEN: 
-				break;
-
-			case XMLToken::ENTITY_TOKEN: 
-				break;
-			
-			case XMLToken::COMMENT_TOKEN:
-				node_stack.back().append_child(create_comment(cur_token.value));
-				if (node_stack.back() == insert_point)
-					result.push_back(node_stack.back().get_last_child());
-				break;
-
-			case XMLToken::DOCUMENT_TYPE_TOKEN:
-				break;
-
-			case XMLToken::NOTATION_TOKEN:
-				break;
-
-			case XMLToken::PROCESSING_INSTRUCTION_TOKEN:
-				node_stack.back().append_child(create_processing_instruction(cur_token.name, cur_token.value));
-				if (node_stack.back() == insert_point)
-					result.push_back(node_stack.back().get_last_child());
-				break;
-			}		
-
-			tokenizer.next(&cur_token);
-		}
+		doc_impl->load(tokenizer, insert_point.impl->node_index, top_level_nodes);
 	}
 	catch (const Exception& e)
 	{
-		for (std::vector<DomNode>::size_type i = 0; i < result.size(); i++)
+		for (std::vector<unsigned int>::size_type i = 0; i < top_level_nodes.size(); i++)
 		{
-			insert_point.remove_child(result[i]);
+			DomNode node = create_node(top_level_nodes[i]);
+			insert_point.remove_child(node);
 		}
 		throw;
 	}
+
+	std::vector<DomNode> result;
+	result.reserve(top_level_nodes.size());
+	for (std::vector<unsigned int>::size_type i = 0; i < top_level_nodes.size(); i++)
+		result.push_back(create_node(top_level_nodes[i]));
 	return result;
 }
 
@@ -453,4 +383,12 @@ void DomDocument::clear_all()
 /////////////////////////////////////////////////////////////////////////////
 // DomDocument implementation:
 
+DomNode DomDocument::create_node(unsigned int node_index)
+{
+	DomDocument_Impl *doc_impl = static_cast<DomDocument_Impl *>(impl.get());
+	DomNode_Impl *dom_node = doc_impl->allocate_dom_node();
+	dom_node->node_index = node_index;
+	return DomNode(std::shared_ptr<DomNode_Impl>(dom_node, DomDocument_Impl::NodeDeleter(doc_impl)));
+}
+
 }
@@ -32,26 +32,67 @@
 #include "dom_document_generic.h"
 #include "dom_tree_node.h"
 #include "dom_named_node_map_generic.h"
+#include "xml_tokenizer_generic.h"
+#include <algorithm>
 
 namespace clan
 {
 
+const std::string DomTreeNode::empty_string;
+
+/// \brief Document order position searched for in a list of node indices
+class DomDocument_OrderKey
+{
+public:
+	explicit DomDocument_OrderKey(unsigned int order) : order(order) { }
+	unsigned int order;
+};
+
+/// \brief Orders node indices by the document order position of the node or of its parent
+class DomDocument_NodeOrder
+{
+public:
+	DomDocument_NodeOrder(const DomDocument_Impl *doc, const std::vector<unsigned int> &node_order, bool use_parent)
+	: doc(doc), node_order(&node_order), use_parent(use_parent)
+	{
+	}
+
+	unsigned int get_order(unsigned int node_index) const
+	{
+		return (*node_order)[use_parent ? doc->get_node(node_index)->parent : node_index];
+	}
+
+	bool operator()(unsigned int a, unsigned int b) const { return get_order(a) < get_order(b); }
+	bool operator()(unsigned int node_index, const DomDocument_OrderKey &key) const { return get_order(node_index) < key.order; }
+	bool operator()(const DomDocument_OrderKey &key, unsigned int node_index) const { return key.order < get_order(node_index); }
+
+private:
+	const DomDocument_Impl *doc;
+	const std::vector<unsigned int> *node_order;
+	bool use_parent;
+};
+
 /////////////////////////////////////////////////////////////////////////////
 // DomDocument_Impl construction:
 
 DomDocument_Impl::DomDocument_Impl()
+: num_nodes(0), string_block(0), string_block_pos(string_block_size), tree_version(1), name_index_version(0)
 {
 	node_index = DomDocument_Impl::allocate_tree_node();
-	nodes[node_index]->node_type = DomNode::DOCUMENT_NODE;
+	get_node(node_index)->node_type = DomNode::DOCUMENT_NODE;
 }
 
 DomDocument_Impl::~DomDocument_Impl()
 {
-	std::vector<DomNode_Impl *>::size_type pos, size;
+	std::vector<DomTreeNode *>::size_type pos, size;
 
-	size = nodes.size();
+	size = node_blocks.size();
 	for (pos = 0; pos < size; pos++)
-		delete nodes[pos];
+		delete[] node_blocks[pos];
+
+	size = string_blocks.size();
+	for (pos = 0; pos < size; pos++)
+		delete[] string_blocks[pos];
 
 	while (!free_dom_nodes.empty())
 	{
@@ -72,49 +113,224 @@ DomDocument_Impl::~DomDocument_Impl()
 /////////////////////////////////////////////////////////////////////////////
 // DomDocument_Impl operations:
 
-DomString DomDocument_Impl::find_namespace_uri(
-	const DomString &qualified_name,
-	const XMLToken &search_token,
-	const DomNode &search_node)
+void DomDocument_Impl::load(XMLTokenizer_Impl &tokenizer, unsigned int parent_index, std::vector<unsigned int> &out_top_level_nodes)
 {
-	static DomString xmlns_prefix("xmlns:");
-	DomString name = qualified_name;
-	DomString prefix;
-	DomString::size_type pos = name.find(':');
-	if (pos != DomString::npos)
-		prefix = name.substr(0, pos);
+	static const std::string xmlns("xmlns");
+
+	tree_changed();
+
+	std::vector<unsigned int> node_stack;
+	node_stack.push_back(parent_index);
 
-	int size = (int) search_token.attributes.size();
-	for (int i=0; i<size; i++)
+	// Namespace declarations of the open elements, innermost last:
+	std::vector<NamespaceBinding> bindings;
+	std::vector<std::vector<NamespaceBinding>::size_type> bindings_start;
+
+	std::string text;
+	XMLTokenizer_Token &token = tokenizer.token;
+	tokenizer.next(token);
+	while (token.type != XMLToken::NULL_TOKEN)
 	{
-		if (prefix.empty())
-		{
-			if (search_token.attributes[i].first == "xmlns")
-				return search_token.attributes[i].second;
-		}
-		else
+		switch (token.type)
 		{
-			if (search_token.attributes[i].first.substr(0, 6) == xmlns_prefix &&
-				search_token.attributes[i].first.substr(6) == prefix)
-				return search_token.attributes[i].second;
+		case XMLToken::TEXT_TOKEN:
+			load_value(append_tree_node(node_stack, DomNode::TEXT_NODE, out_top_level_nodes), tokenizer, token.value);
+			break;
+
+		case XMLToken::CDATA_SECTION_TOKEN:
+			load_value(append_tree_node(node_stack, DomNode::CDATA_SECTION_NODE, out_top_level_nodes), tokenizer, token.value);
+			break;
+
+		case XMLToken::COMMENT_TOKEN:
+			load_value(append_tree_node(node_stack, DomNode::COMMENT_NODE, out_top_level_nodes), tokenizer, token.value);
+			break;
+
+		case XMLToken::PROCESSING_INSTRUCTION_TOKEN:
+			{
+				unsigned int index = append_tree_node(node_stack, DomNode::PROCESSING_INSTRUCTION_NODE, out_top_level_nodes);
+				get_node(index)->node_name = intern(tokenizer.data.data() + token.name.pos, token.name.length);
+				load_value(index, tokenizer, token.value);
+			}
+			break;
+
+		case XMLToken::ELEMENT_TOKEN:
+			if (token.variant != XMLToken::END)
+			{
+				std::vector<NamespaceBinding>::size_type element_bindings = bindings.size();
+				for (std::vector<NamespaceBinding>::size_type i = 0; i < token.num_attributes; i++)
+				{
+					const XMLTokenizer_Text &name = token.attributes[i].first;
+					if (name.length >= 5 && tokenizer.data.compare(name.pos, 5, xmlns) == 0 && (name.length == 5 || (name.length > 6 && tokenizer.data[name.pos + 5] == ':')))
+					{
+						const std::string *prefix = (name.length == 5) ? &DomTreeNode::empty_string : intern(tokenizer.data.data() + name.pos + 6, name.length - 6);
+						tokenizer.get_text(token.attributes[i].second, text);
+						bindings.push_back(NamespaceBinding(prefix, intern(text)));
+					}
+				}
+
+				unsigned int element_index = append_tree_node(node_stack, DomNode::ELEMENT_NODE, out_top_level_nodes);
+				DomTreeNode *element = get_node(element_index);
+				element->node_name = intern(tokenizer.data.data() + token.name.pos, token.name.length);
+				element->namespace_uri = resolve_namespace(*element->node_name, bindings, element_bindings, parent_index);
+
+				unsigned int last_attribute = cl_null_node_index;
+				for (std::vector<NamespaceBinding>::size_type i = 0; i < token.num_attributes; i++)
+				{
+					const XMLTokenizer_Text &name = token.attributes[i].first;
+					const std::string *attribute_name = intern(tokenizer.data.data() + name.pos, name.length);
+					const std::string *attribute_namespace_uri = resolve_namespace(*attribute_name, bindings, element_bindings, parent_index);
+
+					// A repeated attribute replaces the value of the first, like DomElement::set_attribute_ns
+					unsigned int attribute_index = find_attribute(element, attribute_namespace_uri, *attribute_name);
+					if (attribute_index == cl_null_node_index)
+					{
+						attribute_index = allocate_tree_node();
+						DomTreeNode *attribute = get_node(attribute_index);
+						attribute->node_type = DomNode::ATTRIBUTE_NODE;
+						attribute->node_name = attribute_name;
+						attribute->namespace_uri = attribute_namespace_uri;
+						attribute->parent = element_index;
+						attribute->previous_sibling = last_attribute;
+						if (last_attribute == cl_null_node_index)
+							element->first_attribute = attribute_index;
+						else
+							get_node(last_attribute)->next_sibling = attribute_index;
+						last_attribute = attribute_index;
+					}
+					load_value(attribute_index, tokenizer, token.attributes[i].second);
+				}
+
+				if (token.variant == XMLToken::BEGIN)
+				{
+					node_stack.push_back(element_index);
+					bindings_start.push_back(element_bindings);
+				}
+				else
+				{
+					bindings.resize(element_bindings, NamespaceBinding(0, 0));
+				}
+			}
+			else
+			{
+				node_stack.pop_back();
+				if (node_stack.empty()) throw Exception("Malformed XML tree!");
+				bindings.resize(bindings_start.back(), NamespaceBinding(0, 0));
+				bindings_start.pop_back();
+			}
+			break;
+
+		default:
+			break;
 		}
+
+		tokenizer.next(token);
 	}
+}
 
-	return search_node.find_namespace_uri(qualified_name);
+const std::string *DomDocument_Impl::intern(const std::string &text)
+{
+	if (text.empty())
+		return &DomTreeNode::empty_string;
+	return &*atoms.insert(text).first;
+}
+
+const std::string *DomDocument_Impl::intern(const char *text, std::string::size_type length)
+{
+	if (length == 0)
+		return &DomTreeNode::empty_string;
+
+	// Look up through a reused key so names already seen cost no allocation
+	atom_key.assign(text, length);
+	std::unordered_set<std::string>::const_iterator it = atoms.find(atom_key);
+	if (it != atoms.end())
+		return &*it;
+	return &*atoms.insert(atom_key).first;
+}
+
+char *DomDocument_Impl::allocate_string(std::string::size_type length, std::string::size_type &out_capacity)
+{
+	// Reuse released storage, unless it is much larger than needed
+	std::multimap<std::string::size_type, char *>::iterator it = free_strings.lower_bound(length);
+	if (it != free_strings.end() && it->first <= length * 2)
+	{
+		char *data = it->second;
+		out_capacity = it->first;
+		free_strings.erase(it);
+		return data;
+	}
+
+	out_capacity = length;
+	if (length > string_block_size / 4)
+	{
+		// Large values get a block of their own so the current block is not abandoned
+		char *data = new char[length];
+		string_blocks.push_back(data);
+		return data;
+	}
+
+	if (string_block_pos + length > string_block_size)
+	{
+		string_block = new char[string_block_size];
+		string_blocks.push_back(string_block);
+		string_block_pos = 0;
+	}
+
+	char *data = string_block + string_block_pos;
+	string_block_pos += length;
+	return data;
+}
+
+void DomDocument_Impl::free_string(char *data, std::string::size_type capacity)
+{
+	free_strings.insert(std::make_pair(capacity, data));
+}
+
+bool DomDocument_Impl::find_child_elements(unsigned int node_index, const std::string &name, std::vector<unsigned int> &out_nodes)
+{
+	if (!update_name_index(node_index))
+		return false;
+
+	const NameIndexEntry *entry = find_name_index_entry(name);
+	if (entry)
+	{
+		DomDocument_NodeOrder parent_order(this, node_order, true);
+		std::pair<std::vector<unsigned int>::const_iterator, std::vector<unsigned int>::const_iterator> range;
+		range = std::equal_range(entry->elements_by_parent.begin(), entry->elements_by_parent.end(), DomDocument_OrderKey(node_order[node_index]), parent_order);
+		out_nodes.insert(out_nodes.end(), range.first, range.second);
+	}
+	return true;
+}
+
+bool DomDocument_Impl::find_descendant_elements(unsigned int node_index, const std::string &name, std::vector<unsigned int> &out_nodes)
+{
+	if (!update_name_index(node_index))
+		return false;
+
+	const NameIndexEntry *entry = find_name_index_entry(name);
+	if (entry)
+	{
+		// The descendants are the nodes numbered after the node and before the end of its subtree
+		DomDocument_NodeOrder order(this, node_order, false);
+		std::vector<unsigned int>::const_iterator first, last;
+		first = std::upper_bound(entry->elements.begin(), entry->elements.end(), DomDocument_OrderKey(node_order[node_index]), order);
+		last = std::lower_bound(first, entry->elements.end(), DomDocument_OrderKey(node_subtree_end[node_index]), order);
+		out_nodes.insert(out_nodes.end(), first, last);
+	}
+	return true;
 }
 
 unsigned int DomDocument_Impl::allocate_tree_node()
 {
 	if (free_nodes.empty())
 	{
-		DomTreeNode *node = new (&node_allocator) DomTreeNode();
-		nodes.push_back(node);
-		return nodes.size() - 1;
+		if ((num_nodes & (node_block_size - 1)) == 0)
+			node_blocks.push_back(new DomTreeNode[node_block_size]);
+		return num_nodes++;
 	}
 	else
 	{
 		unsigned index = free_nodes.back();
-		nodes[index]->reset();
+		get_node(index)->reset();
 		free_nodes.pop_back();
 		return index;
 	}
@@ -179,4 +395,201 @@ void DomDocument_Impl::free_named_node_map(DomNamedNodeMap_Impl *map)
 /////////////////////////////////////////////////////////////////////////////
 // DomDocument_Impl implementation:
 
+unsigned int DomDocument_Impl::append_tree_node(const std::vector<unsigned int> &node_stack, unsigned short node_type, std::vector<unsigned int> &out_top_level_nodes)
+{
+	unsigned int node_index = allocate_tree_node();
+	unsigned int parent_index = node_stack.back();
+	DomTreeNode *node = get_node(node_index);
+	DomTreeNode *parent = get_node(parent_index);
+	node->node_type = node_type;
+	node->parent = parent_index;
+	if (parent->last_child != cl_null_node_index)
+	{
+		get_node(parent->last_child)->next_sibling = node_index;
+		node->previous_sibling = parent->last_child;
+	}
+	else
+	{
+		parent->first_child = node_index;
+	}
+	parent->last_child = node_index;
+
+	if (node_stack.size() == 1)
+		out_top_level_nodes.push_back(node_index);
+	return node_index;
+}
+
+void DomDocument_Impl::load_value(unsigned int node_index, const XMLTokenizer_Impl &tokenizer, const XMLTokenizer_Text &text)
+{
+	// Unescaping never makes a value longer, so the raw length is enough room
+	DomTreeNode *node = get_node(node_index);
+	if (text.length > node->value_capacity)
+	{
+		if (node->value_capacity > 0)
+			free_string(node->node_value, node->value_capacity);
+		std::string::size_type capacity = 0;
+		node->node_value = allocate_string(text.length, capacity);
+		node->value_capacity = (unsigned int) capacity;
+	}
+	node->value_length = (unsigned int) tokenizer.get_text(text, node->node_value);
+}
+
+unsigned int DomDocument_Impl::find_attribute(const DomTreeNode *element, const std::string *namespace_uri, const std::string &qualified_name) const
+{
+	std::string::size_type local_pos = qualified_name.find(':');
+	local_pos = (local_pos == std::string::npos) ? 0 : local_pos + 1;
+
+	unsigned int index = element->first_attribute;
+	while (index != cl_null_node_index)
+	{
+		const DomTreeNode *attribute = get_node(index);
+		if (attribute->node_name == &qualified_name)
+			return index;
+
+		if (attribute->namespace_uri == namespace_uri)
+		{
+			const std::string &name = *attribute->node_name;
+			std::string::size_type pos = name.find(':');
+			pos = (pos == std::string::npos) ? 0 : pos + 1;
+			if (name.compare(pos, std::string::npos, qualified_name, local_pos, std::string::npos) == 0)
+				return index;
+		}
+		index = attribute->next_sibling;
+	}
+	return cl_null_node_index;
+}
+
+const std::string *DomDocument_Impl::resolve_namespace(const std::string &qualified_name, const std::vector<NamespaceBinding> &bindings, std::vector<NamespaceBinding>::size_type element_bindings, unsigned int insert_index)
+{
+	// Same search order as find_namespace_uri: the declarations of the element itself,
+	// the reserved prefixes and then the declarations in scope.
+	static const std::string xmlns_xml("xml");
+	static const std::string xmlns_xmlns("xmlns");
+
+	std::string::size_type prefix_length = qualified_name.find(':');
+	if (prefix_length == std::string::npos)
+		prefix_length = 0;
+
+	for (std::vector<NamespaceBinding>::size_type i = element_bindings; i < bindings.size(); i++)
+	{
+		const std::string &prefix = *bindings[i].prefix;
+		if (prefix.length() == prefix_length && qualified_name.compare(0, prefix_length, prefix) == 0)
+			return bindings[i].namespace_uri;
+	}
+
+	if (prefix_length == 3 && qualified_name.compare(0, 3, xmlns_xml) == 0)
+		return intern(xmlns_xml);
+	else if ((prefix_length == 5 && qualified_name.compare(0, 5, xmlns_xmlns) == 0) || qualified_name == xmlns_xmlns)
+		return intern(xmlns_xmlns);
+
+	for (std::vector<NamespaceBinding>::size_type i = element_bindings; i > 0; i--)
+	{
+		const std::string &prefix = *bindings[i - 1].prefix;
+		if (prefix.length() == prefix_length && qualified_name.compare(0, prefix_length, prefix) == 0)
+			return bindings[i - 1].namespace_uri;
+	}
+
+	// Declarations on the insert point and its ancestors:
+	unsigned int index = insert_index;
+	while (index != cl_null_node_index)
+	{
+		const DomTreeNode *node = get_node(index);
+		unsigned int attribute_index = node->first_attribute;
+		while (attribute_index != cl_null_node_index)
+		{
+			const DomTreeNode *attribute = get_node(attribute_index);
+			const std::string &name = *attribute->node_name;
+			if (prefix_length == 0)
+			{
+				if (name == xmlns_xmlns)
+					return intern(attribute->node_value, attribute->value_length);
+			}
+			else if (name.length() == prefix_length + 6 && name.compare(0, 5, xmlns_xmlns) == 0 && name[5] == ':' && name.compare(6, prefix_length, qualified_name, 0, prefix_length) == 0)
+			{
+				return intern(attribute->node_value, attribute->value_length);
+			}
+			attribute_index = attribute->next_sibling;
+		}
+		index = node->parent;
+	}
+	return &DomTreeNode::empty_string;
+}
+
+const DomDocument_Impl::NameIndexEntry *DomDocument_Impl::find_name_index_entry(const std::string &name) const
+{
+	// Element names are interned, so a name never seen by the document matches no element
+	std::unordered_set<std::string>::const_iterator atom = atoms.find(name);
+	if (atom == atoms.end())
+		return 0;
+
+	std::unordered_map<const std::string *, NameIndexEntry>::const_iterator it = name_index.find(&*atom);
+	if (it == name_index.end())
+		return 0;
+	return &it->second;
+}
+
+bool DomDocument_Impl::update_name_index(unsigned int index)
+{
+	if (name_index_version != tree_version)
+	{
+		node_order.assign(num_nodes, cl_null_node_index);
+		node_subtree_end.assign(num_nodes, cl_null_node_index);
+		name_index.clear();
+
+		// Number the nodes reachable from the document in document order.
+		// Attributes are not on the child axes and are left unnumbered.
+		unsigned int order = 0;
+		unsigned int cur_index = node_index;
+		while (cur_index != cl_null_node_index)
+		{
+			const DomTreeNode *cur = get_node(cur_index);
+			node_order[cur_index] = order++;
+			if (cur->node_type == DomNode::ELEMENT_NODE)
+				name_index[cur->node_name].elements.push_back(cur_index);
+
+			if (cur->first_child != cl_null_node_index)
+			{
+				cur_index = cur->first_child;
+				continue;
+			}
+
+			while (true)
+			{
+				node_subtree_end[cur_index] = order;
+				if (cur_index == node_index)
+				{
+					cur_index = cl_null_node_index;
+					break;
+				}
+
+				cur = get_node(cur_index);
+				if (cur->next_sibling != cl_null_node_index)
+				{
+					cur_index = cur->next_sibling;
+					break;
+				}
+
+				// A sibling chain should never lead out of the tree, but never index with a null parent
+				if (cur->parent == cl_null_node_index)
+				{
+					cur_index = cl_null_node_index;
+					break;
+				}
+				cur_index = cur->parent;
+			}
+		}
+
+		DomDocument_NodeOrder parent_order(this, node_order, true);
+		for (std::unordered_map<const std::string *, NameIndexEntry>::iterator it = name_index.begin(); it != name_index.end(); ++it)
+		{
+			it->second.elements_by_parent = it->second.elements;
+			std::stable_sort(it->second.elements_by_parent.begin(), it->second.elements_by_parent.end(), parent_order);
+		}
+
+		name_index_version = tree_version;
+	}
+
+	return index < node_order.size() && node_order[index] != cl_null_node_index;
+}
+
 }
@@ -32,12 +32,16 @@
 #include "API/Core/System/block_allocator.h"
 #include <vector>
 #include <stack>
+#include <unordered_set>
+#include <unordered_map>
+#include <map>
 
 namespace clan
 {
 
 class DomTreeNode;
-class XMLToken;
+class XMLTokenizer_Impl;
+class XMLTokenizer_Text;
 class DomNamedNodeMap_Impl;
 
 class DomDocument_Impl : public DomNode_Impl
@@ -60,7 +64,8 @@ public:
 	std::string system_id;
 	std::string internal_subset;
 	BlockAllocator node_allocator;
-	std::vector<DomTreeNode *> nodes;
+	std::vector<DomTreeNode *> node_blocks;
+	unsigned int num_nodes;
 	std::vector<int> free_nodes;
 	std::vector<DomNode_Impl *> free_dom_nodes;
 	std::vector<DomNamedNodeMap_Impl *> free_named_node_maps;
@@ -70,10 +75,37 @@ public:
 /// \{
 
 public:
-	static DomString find_namespace_uri(
-		const DomString &qualified_name,
-		const XMLToken &search_token,
-		const DomNode &search_node);
+	/// \brief Builds tree nodes directly from the tokenizer and appends them to parent_index
+	void load(XMLTokenizer_Impl &tokenizer, unsigned int parent_index, std::vector<unsigned int> &out_top_level_nodes);
+
+	/// \brief Returns the tree node at an index (defined in dom_tree_node.h)
+	inline DomTreeNode *get_node(unsigned int node_index) const;
+
+	/// \brief Returns the interned copy of a name or namespace URI
+	const std::string *intern(const std::string &text);
+	const std::string *intern(const char *text, std::string::size_type length);
+
+	/// \brief Allocates storage for a node value from the string arena
+	///
+	/// Storage released by free_string is reused when it fits.
+	/// \param out_capacity = Size of the returned storage, at least length
+	char *allocate_string(std::string::size_type length, std::string::size_type &out_capacity);
+
+	/// \brief Returns node value storage to the string arena for reuse
+	void free_string(char *data, std::string::size_type capacity);
+
+	/// \brief Invalidates the element name index. Called whenever the tree structure or an element name changes.
+	void tree_changed() { tree_version++; }
+
+	/// \brief Appends the element children of a node with the given name, in document order
+	///
+	/// \return false if the node is not part of the document tree and the index cannot be used
+	bool find_child_elements(unsigned int node_index, const std::string &name, std::vector<unsigned int> &out_nodes);
+
+	/// \brief Appends the element descendants of a node with the given name, in document order
+	///
+	/// \return false if the node is not part of the document tree and the index cannot be used
+	bool find_descendant_elements(unsigned int node_index, const std::string &name, std::vector<unsigned int> &out_nodes);
 
 	unsigned int allocate_tree_node();
 	void free_tree_node(unsigned int node_index);
@@ -99,6 +131,60 @@ public:
 	};
 
 /// \}
+/// \name Implementation
+/// \{
+
+private:
+	struct NamespaceBinding
+	{
+		NamespaceBinding(const std::string *prefix, const std::string *namespace_uri) : prefix(prefix), namespace_uri(namespace_uri) { }
+
+		const std::string *prefix;
+		const std::string *namespace_uri;
+	};
+
+	unsigned int append_tree_node(const std::vector<unsigned int> &node_stack, unsigned short node_type, std::vector<unsigned int> &out_top_level_nodes);
+	void load_value(unsigned int node_index, const XMLTokenizer_Impl &tokenizer, const XMLTokenizer_Text &text);
+	unsigned int find_attribute(const DomTreeNode *element, const std::string *namespace_uri, const std::string &qualified_name) const;
+	const std::string *resolve_namespace(const std::string &qualified_name, const std::vector<NamespaceBinding> &bindings, std::vector<NamespaceBinding>::size_type element_bindings, unsigned int insert_index);
+
+	/// \brief Elements sharing a name
+	struct NameIndexEntry
+	{
+		/// \brief Element indices in document order
+		std::vector<unsigned int> elements;
+
+		/// \brief Element indices grouped by the document order of their parent
+		std::vector<unsigned int> elements_by_parent;
+	};
+
+	const NameIndexEntry *find_name_index_entry(const std::string &name) const;
+	bool update_name_index(unsigned int node_index);
+
+	static const unsigned int node_block_shift = 10;
+	static const unsigned int node_block_size = 1 << node_block_shift;
+	static const std::string::size_type string_block_size = 64 * 1024;
+
+	std::unordered_set<std::string> atoms;
+	std::string atom_key;
+	std::vector<char *> string_blocks;
+	char *string_block;
+	std::string::size_type string_block_pos;
+
+	/// \brief Released value storage by capacity
+	std::multimap<std::string::size_type, char *> free_strings;
+
+	unsigned int tree_version;
+	unsigned int name_index_version;
+
+	/// \brief Document order position of each node, or cl_null_node_index if the node is not in the tree
+	std::vector<unsigned int> node_order;
+
+	/// \brief Document order position following the last descendant of each node
+	std::vector<unsigned int> node_subtree_end;
+
+	std::unordered_map<const std::string *, NameIndexEntry> name_index;
+/// \}
 };
 
 }
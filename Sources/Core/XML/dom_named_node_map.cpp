@@ -179,7 +179,7 @@ DomNode DomNamedNodeMap::set_named_item(const DomNode &node)
 		new_tree_node->parent = impl->node_index;
 		new_tree_node->previous_sibling = last_index;
 		new_tree_node->next_sibling = cl_null_node_index;
-		doc_impl->nodes[last_index]->next_sibling = node.impl->node_index;
+		doc_impl->get_node(last_index)->next_sibling = node.impl->node_index;
 	}
 	return node;
 }
@@ -237,7 +237,7 @@ DomNode DomNamedNodeMap::set_named_item_ns(const DomNode &node)
 		new_tree_node->parent = impl->node_index;
 		new_tree_node->previous_sibling = last_index;
 		new_tree_node->next_sibling = cl_null_node_index;
-		doc_impl->nodes[last_index]->next_sibling = node.impl->node_index;
+		doc_impl->get_node(last_index)->next_sibling = node.impl->node_index;
 	}
 	return node;
 }
@@ -366,7 +366,7 @@ inline DomTreeNode *DomNamedNodeMap_Impl::get_tree_node()
 	if (node_index == cl_null_node_index)
 		return 0;
 	DomDocument_Impl *doc_impl = (DomDocument_Impl *) owner_document.lock().get();
-	return doc_impl->nodes[node_index];
+	return doc_impl->get_node(node_index);
 }
 
 inline const DomTreeNode *DomNamedNodeMap_Impl::get_tree_node() const
@@ -374,7 +374,7 @@ inline const DomTreeNode *DomNamedNodeMap_Impl::get_tree_node() const
 	if (node_index == cl_null_node_index)
 		return 0;
 	DomDocument_Impl *doc_impl = (DomDocument_Impl *) owner_document.lock().get();
-	return doc_impl->nodes[node_index];
+	return doc_impl->get_node(node_index);
 }
 
 }
@@ -458,6 +458,7 @@ DomNode DomNode::insert_before(DomNode &new_child, DomNode &ref_child)
 		if (tree_node->first_child == ref_child.impl->node_index)
 			tree_node->first_child = new_child.impl->node_index;
 		new_tree_node->parent = impl->node_index;
+		doc_impl->tree_changed();
 
 		return new_child;
 	}
@@ -468,6 +469,7 @@ DomNode DomNode::replace_child(DomNode &new_child, DomNode &old_child)
 {
 	if (impl && new_child.impl && old_child.impl)
 	{
+		DomDocument_Impl *doc_impl = (DomDocument_Impl *) impl->owner_document.lock().get();
 		DomTreeNode *tree_node = impl->get_tree_node();
 		DomTreeNode *new_tree_node = new_child.impl->get_tree_node();
 		DomTreeNode *old_tree_node = old_child.impl->get_tree_node();
@@ -475,6 +477,10 @@ DomNode DomNode::replace_child(DomNode &new_child, DomNode &old_child)
 		new_tree_node->previous_sibling = old_tree_node->previous_sibling;
 		new_tree_node->next_sibling = old_tree_node->next_sibling;
 		new_tree_node->parent = impl->node_index;
+		if (new_tree_node->previous_sibling != cl_null_node_index)
+			new_tree_node->get_previous_sibling(doc_impl)->next_sibling = new_child.impl->node_index;
+		if (new_tree_node->next_sibling != cl_null_node_index)
+			new_tree_node->get_next_sibling(doc_impl)->previous_sibling = new_child.impl->node_index;
 		if (tree_node->first_child == old_child.impl->node_index)
 			tree_node->first_child = new_child.impl->node_index;
 		if (tree_node->last_child == old_child.impl->node_index)
@@ -482,6 +488,7 @@ DomNode DomNode::replace_child(DomNode &new_child, DomNode &old_child)
 		old_tree_node->previous_sibling = cl_null_node_index;
 		old_tree_node->next_sibling = cl_null_node_index;
 		old_tree_node->parent = cl_null_node_index;
+		doc_impl->tree_changed();
 
 		return new_child;
 	}
@@ -510,6 +517,7 @@ DomNode DomNode::remove_child(DomNode &old_child)
 		old_tree_node->previous_sibling = cl_null_node_index;
 		old_tree_node->next_sibling = cl_null_node_index;
 		old_tree_node->parent = cl_null_node_index;
+		doc_impl->tree_changed();
 	}
 	return DomNode();
 }
@@ -534,6 +542,7 @@ DomNode DomNode::append_child(DomNode new_child)
 			tree_node->last_child = new_child.impl->node_index;
 		}
 		new_tree_node->parent = impl->node_index;
+		doc_impl->tree_changed();
 		return new_child;
 	}
 	return DomNode();
@@ -781,7 +790,7 @@ DomTreeNode *DomNode_Impl::get_tree_node()
 	if (node_index == cl_null_node_index)
 		return 0;
 	DomDocument_Impl *doc_impl = (DomDocument_Impl *) owner_document.lock().get();
-	return doc_impl->nodes[node_index];
+	return doc_impl->get_node(node_index);
 }
 
 const DomTreeNode *DomNode_Impl::get_tree_node() const
@@ -789,7 +798,7 @@ const DomTreeNode *DomNode_Impl::get_tree_node() const
 	if (node_index == cl_null_node_index)
 		return 0;
 	DomDocument_Impl *doc_impl = (DomDocument_Impl *) owner_document.lock().get();
-	return doc_impl->nodes[node_index];
+	return doc_impl->get_node(node_index);
 }
 
 }
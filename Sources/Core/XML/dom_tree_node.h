@@ -28,7 +28,6 @@
 
 #pragma once
 
-#include "API/Core/System/block_allocator.h"
 #include "dom_document_generic.h"
 
 namespace clan
@@ -38,19 +37,22 @@ namespace clan
 
 class DomDocument_Impl;
 
-class DomTreeNode : public BlockAllocated
+/// \brief Node in the tree of a DomDocument
+///
+/// Names and namespace URIs point at strings interned in the owner document.
+/// The value is stored in the string arena of the owner document. Storage
+/// outgrown by a new value goes back to the arena for other values to reuse.
+class DomTreeNode
 {
 /// \name Construction
 /// \{
 public:
 	DomTreeNode()
-	: node_type(0), parent(cl_null_node_index), first_child(cl_null_node_index),
-	  last_child(cl_null_node_index), previous_sibling(cl_null_node_index),
-	  next_sibling(cl_null_node_index), first_attribute(cl_null_node_index)
-	{
-	}
-
-	virtual ~DomTreeNode()
+	: node_name(&empty_string), namespace_uri(&empty_string), node_value(0),
+	  value_length(0), value_capacity(0), node_type(0), parent(cl_null_node_index),
+	  first_child(cl_null_node_index), last_child(cl_null_node_index),
+	  previous_sibling(cl_null_node_index), next_sibling(cl_null_node_index),
+	  first_attribute(cl_null_node_index)
 	{
 	}
 /// \}
@@ -58,9 +60,11 @@ public:
 /// \name Attributes
 /// \{
 public:
-	std::string node_name;
-	std::string node_value;
-	std::string namespace_uri;
+	const std::string *node_name;
+	const std::string *namespace_uri;
+	char *node_value;
+	unsigned int value_length;
+	unsigned int value_capacity;
 	unsigned short node_type;
 	unsigned int parent;
 	unsigned int first_child;
@@ -68,16 +72,19 @@ public:
 	unsigned int previous_sibling;
 	unsigned int next_sibling;
 	unsigned int first_attribute;
+
+	static const std::string empty_string;
 /// \}
 
 /// \name Operations
 /// \{
 public:
+	/// \brief Clears the node. The value storage is kept for reuse.
 	void reset()
 	{
-		node_name.clear();
-		node_value.clear();
-		namespace_uri.clear();
+		node_name = &empty_string;
+		namespace_uri = &empty_string;
+		value_length = 0;
 		node_type = 0;
 		parent = cl_null_node_index;
 		first_child = cl_null_node_index;
@@ -87,101 +94,140 @@ public:
 		first_attribute = cl_null_node_index;
 	}
 
-	std::string get_node_name() const
+	const std::string &get_node_name() const
 	{
-		return node_name;
+		return *node_name;
 	}
 
 	std::string get_node_value() const
 	{
-		return node_value;
+		return std::string(node_value, value_length);
 	}
 
-	std::string get_namespace_uri() const
+	const std::string &get_namespace_uri() const
 	{
-		return namespace_uri;
+		return *namespace_uri;
 	}
 
 	void set_node_name(DomDocument_Impl *owner_document, const DomString &str)
 	{
-		node_name = str;
+		node_name = owner_document->intern(str);
+		owner_document->tree_changed();
 	}
 
 	void set_node_value(DomDocument_Impl *owner_document, const DomString &str)
 	{
-		node_value = str;
+		set_node_value(owner_document, str.data(), str.length());
+	}
+
+	void set_node_value(DomDocument_Impl *owner_document, const char *str, std::string::size_type length)
+	{
+		if (length > value_capacity)
+			reserve_node_value(owner_document, length, false);
+		if (length > 0)
+			memcpy(node_value, str, length);
+		value_length = (unsigned int) length;
+	}
+
+	void append_node_value(DomDocument_Impl *owner_document, const DomString &str)
+	{
+		std::string::size_type length = value_length + str.length();
+		if (length > value_capacity)
+			reserve_node_value(owner_document, length, true);
+		memcpy(node_value + value_length, str.data(), str.length());
+		value_length = (unsigned int) length;
 	}
 
 	void set_namespace_uri(DomDocument_Impl *owner_document, const DomString &str)
 	{
-		namespace_uri = str;
+		namespace_uri = owner_document->intern(str);
 	}
 
 	DomTreeNode *get_parent(DomDocument_Impl *owner_document)
 	{
-		return parent != cl_null_node_index ? owner_document->nodes[parent] : 0;
+		return parent != cl_null_node_index ? owner_document->get_node(parent) : 0;
 	}
 
 	const DomTreeNode *get_parent(DomDocument_Impl *owner_document) const
 	{
-		return parent != cl_null_node_index ? owner_document->nodes[parent] : 0;
+		return parent != cl_null_node_index ? owner_document->get_node(parent) : 0;
 	}
 
 	DomTreeNode *get_first_child(DomDocument_Impl *owner_document)
 	{
-		return first_child != cl_null_node_index ? owner_document->nodes[first_child] : 0;
+		return first_child != cl_null_node_index ? owner_document->get_node(first_child) : 0;
 	}
 
 	const DomTreeNode *get_first_child(DomDocument_Impl *owner_document) const
 	{
-		return first_child != cl_null_node_index ? owner_document->nodes[first_child] : 0;
+		return first_child != cl_null_node_index ? owner_document->get_node(first_child) : 0;
 	}
 
 	DomTreeNode *get_last_child(DomDocument_Impl *owner_document)
 	{
-		return last_child != cl_null_node_index ? owner_document->nodes[last_child] : 0;
+		return last_child != cl_null_node_index ? owner_document->get_node(last_child) : 0;
 	}
 
 	const DomTreeNode *get_last_child(DomDocument_Impl *owner_document) const
 	{
-		return last_child != cl_null_node_index ? owner_document->nodes[last_child] : 0;
+		return last_child != cl_null_node_index ? owner_document->get_node(last_child) : 0;
 	}
 
 	DomTreeNode *get_previous_sibling(DomDocument_Impl *owner_document)
 	{
-		return previous_sibling != cl_null_node_index ? owner_document->nodes[previous_sibling] : 0;
+		return previous_sibling != cl_null_node_index ? owner_document->get_node(previous_sibling) : 0;
 	}
 
 	const DomTreeNode *get_previous_sibling(DomDocument_Impl *owner_document) const
 	{
-		return previous_sibling != cl_null_node_index ? owner_document->nodes[previous_sibling] : 0;
+		return previous_sibling != cl_null_node_index ? owner_document->get_node(previous_sibling) : 0;
 	}
 
 	DomTreeNode *get_next_sibling(DomDocument_Impl *owner_document)
 	{
-		return next_sibling != cl_null_node_index ? owner_document->nodes[next_sibling] : 0;
+		return next_sibling != cl_null_node_index ? owner_document->get_node(next_sibling) : 0;
 	}
 
 	const DomTreeNode *get_next_sibling(DomDocument_Impl *owner_document) const
 	{
-		return next_sibling != cl_null_node_index ? owner_document->nodes[next_sibling] : 0;
+		return next_sibling != cl_null_node_index ? owner_document->get_node(next_sibling) : 0;
 	}
 
 	DomTreeNode *get_first_attribute(DomDocument_Impl *owner_document)
 	{
-		return first_attribute != cl_null_node_index ? owner_document->nodes[first_attribute] : 0;
+		return first_attribute != cl_null_node_index ? owner_document->get_node(first_attribute) : 0;
 	}
 
 	const DomTreeNode *get_first_attribute(DomDocument_Impl *owner_document) const
 	{
-		return first_attribute != cl_null_node_index ? owner_document->nodes[first_attribute] : 0;
+		return first_attribute != cl_null_node_index ? owner_document->get_node(first_attribute) : 0;
 	}
 /// \}
 
 /// \name Implementation
 /// \{
 private:
+	void reserve_node_value(DomDocument_Impl *owner_document, std::string::size_type length, bool keep_value)
+	{
+		// Grow geometrically so repeated appends stay linear
+		std::string::size_type new_capacity = (std::string::size_type) value_capacity * 2;
+		if (new_capacity < length)
+			new_capacity = length;
+
+		char *new_value = owner_document->allocate_string(new_capacity, new_capacity);
+		if (keep_value && value_length > 0)
+			memcpy(new_value, node_value, value_length);
+		if (value_capacity > 0)
+			owner_document->free_string(node_value, value_capacity);
+		node_value = new_value;
+		value_capacity = (unsigned int) new_capacity;
+	}
 /// \}
 };
 
+inline DomTreeNode *DomDocument_Impl::get_node(unsigned int node_index) const
+{
+	return node_blocks[node_index >> node_block_shift] + (node_index & (node_block_size - 1));
+}
+
 }
@@ -29,7 +29,6 @@
 #include "Core/precomp.h"
 #include "API/Core/XML/xml_tokenizer.h"
 #include "API/Core/XML/xml_token.h"
-#include "API/Core/System/databuffer.h"
 #include "API/Core/Text/string_format.h"
 #include "API/Core/Text/string_help.h"
 #include "xml_tokenizer_generic.h"
@@ -52,33 +51,7 @@ XMLTokenizer::XMLTokenizer(const XMLTokenizer &copy) : impl(copy.impl)
 
 XMLTokenizer::XMLTokenizer(IODevice &input) : impl(new XMLTokenizer_Impl)
 {
-	impl->input = input;
-	impl->size = input.get_size();
-	impl->pos = 0;
-
-	DataBuffer buffer(impl->size);
-	input.receive(buffer.get_data(), buffer.get_size(), true);
-
-	StringHelp::BOMType bom_type = StringHelp::detect_bom(buffer.get_data(), buffer.get_size());
-	switch (bom_type)
-	{
-	default:
-	case StringHelp::bom_none:
-		impl->data = StringHelp::utf8_to_text(std::string(buffer.get_data(), buffer.get_size()));
-		break;
-	case StringHelp::bom_utf32_be:
-	case StringHelp::bom_utf32_le:
-		throw Exception("UTF-16 XML files not supported yet");
-		break;
-	case StringHelp::bom_utf16_be:
-	case StringHelp::bom_utf16_le:
-		throw Exception("UTF-32 XML files not supported yet");
-		break;
-	case StringHelp::bom_utf8:
-		impl->data = StringHelp::utf8_to_text(std::string(buffer.get_data()+3, buffer.get_size()-3));
-		break;
-	}
-
+	impl->load(input);
 }
 
 XMLTokenizer::~XMLTokenizer()
@@ -105,15 +78,42 @@ void XMLTokenizer::next(XMLToken *out_token)
 {
 	out_token->type = XMLToken::NULL_TOKEN;
 	out_token->variant = XMLToken::SINGLE;
-//	out_token->attributes.clear();
-	while (!out_token->attributes.empty())
-		out_token->attributes.pop_back();
 
-	if (impl)
+	if (!impl)
 	{
-		if (impl->next_text_node(out_token))
-			return;
-		impl->next_tag_node(out_token);
+		out_token->attributes.clear();
+		return;
+	}
+
+	XMLTokenizer_Token &token = impl->token;
+	impl->next(token);
+
+	out_token->type = token.type;
+	out_token->variant = token.variant;
+	switch (token.type)
+	{
+	case XMLToken::ELEMENT_TOKEN:
+		impl->get_text(token.name, out_token->name);
+		break;
+	case XMLToken::PROCESSING_INSTRUCTION_TOKEN:
+		impl->get_text(token.name, out_token->name);
+		impl->get_text(token.value, out_token->value);
+		break;
+	case XMLToken::TEXT_TOKEN:
+	case XMLToken::COMMENT_TOKEN:
+	case XMLToken::CDATA_SECTION_TOKEN:
+		impl->get_text(token.value, out_token->value);
+		break;
+	default:
+		break;
+	}
+
+	// Resizing keeps the attribute strings of the previous token, so their memory is reused
+	out_token->attributes.resize(token.num_attributes);
+	for (std::vector<XMLToken::Attribute>::size_type i = 0; i < token.num_attributes; i++)
+	{
+		impl->get_text(token.attributes[i].first, out_token->attributes[i].first);
+		impl->get_text(token.attributes[i].second, out_token->attributes[i].second);
 	}
 }
 
@@ -127,7 +127,115 @@ XMLToken XMLTokenizer::next()
 /////////////////////////////////////////////////////////////////////////////
 // XMLTokenizer implementation:
 
-bool XMLTokenizer_Impl::next_text_node(XMLToken *out_token)
+void XMLTokenizer_Impl::load(IODevice &device)
+{
+	input = device;
+	pos = 0;
+
+	// Text is UTF-8 internally, so the input is received straight into the data string
+	data.resize(device.get_size());
+	if (!data.empty())
+		device.receive(&data[0], data.size(), true);
+
+	StringHelp::BOMType bom_type = StringHelp::detect_bom(data.data(), data.size());
+	switch (bom_type)
+	{
+	default:
+	case StringHelp::bom_none:
+		break;
+	case StringHelp::bom_utf32_be:
+	case StringHelp::bom_utf32_le:
+		throw Exception("UTF-16 XML files not supported yet");
+		break;
+	case StringHelp::bom_utf16_be:
+	case StringHelp::bom_utf16_le:
+		throw Exception("UTF-32 XML files not supported yet");
+		break;
+	case StringHelp::bom_utf8:
+		data.erase(0, 3);
+		break;
+	}
+
+	size = data.size();
+}
+
+void XMLTokenizer_Impl::next(XMLTokenizer_Token &out_token)
+{
+	out_token.type = XMLToken::NULL_TOKEN;
+	out_token.variant = XMLToken::SINGLE;
+	out_token.num_attributes = 0;
+
+	if (next_text_node(out_token))
+		return;
+	next_tag_node(out_token);
+}
+
+void XMLTokenizer_Impl::get_text(const XMLTokenizer_Text &text, std::string &out_text) const
+{
+	if (!text.escaped)
+	{
+		out_text.assign(data, text.pos, text.length);
+	}
+	else
+	{
+		out_text.resize(text.length);
+		out_text.resize(get_text(text, &out_text[0]));
+	}
+}
+
+std::string::size_type XMLTokenizer_Impl::get_text(const XMLTokenizer_Text &text, char *out_text) const
+{
+	const char *src = data.data() + text.pos;
+	if (!text.escaped)
+	{
+		memcpy(out_text, src, text.length);
+		return text.length;
+	}
+
+	std::string::size_type read_pos = 0;
+	std::string::size_type write_pos = 0;
+	while (read_pos < text.length)
+	{
+		if (src[read_pos] == '&')
+		{
+			std::string::size_type available = text.length - read_pos;
+			if (available >= 6 && memcmp(src + read_pos, "&quot;", 6) == 0)
+			{
+				out_text[write_pos++] = '"';
+				read_pos += 6;
+				continue;
+			}
+			else if (available >= 6 && memcmp(src + read_pos, "&apos;", 6) == 0)
+			{
+				out_text[write_pos++] = '\'';
+				read_pos += 6;
+				continue;
+			}
+			else if (available >= 4 && memcmp(src + read_pos, "&lt;", 4) == 0)
+			{
+				out_text[write_pos++] = '<';
+				read_pos += 4;
+				continue;
+			}
+			else if (available >= 4 && memcmp(src + read_pos, "&gt;", 4) == 0)
+			{
+				out_text[write_pos++] = '>';
+				read_pos += 4;
+				continue;
+			}
+			else if (available >= 5 && memcmp(src + read_pos, "&amp;", 5) == 0)
+			{
+				out_text[write_pos++] = '&';
+				read_pos += 5;
+				continue;
+			}
+		}
+		out_text[write_pos++] = src[read_pos++];
+	}
+	return write_pos;
+}
+
+bool XMLTokenizer_Impl::next_text_node(XMLTokenizer_Token &out_token)
 {
 	while (pos < size && data[pos] != '<')
 	{
@@ -136,24 +244,22 @@ bool XMLTokenizer_Impl::next_text_node(XMLToken *out_token)
 		if (end_pos == data.npos) end_pos = size;
 		pos = end_pos;
 
-		std::string text;
-		std::string text_orig = data.substr(start_pos, end_pos-start_pos);
-		unescape(text, text_orig);
+		XMLTokenizer_Text text = escaped_text(start_pos, end_pos);
 		if (eat_whitespace)
 		{
 			text = trim_whitespace(text);
-			if (text.empty())
+			if (text.length == 0)
 				continue;
 		}
 
-		out_token->type = XMLToken::TEXT_TOKEN;
-		out_token->value = text;
+		out_token.type = XMLToken::TEXT_TOKEN;
+		out_token.value = text;
 		return true;
 	}
 	return false;
 }
 
-bool XMLTokenizer_Impl::next_tag_node(XMLToken *out_token)
+bool XMLTokenizer_Impl::next_tag_node(XMLTokenizer_Token &out_token)
 {
 	if (pos == size || data[pos] != '<')
 		return false;
@@ -187,11 +293,11 @@ bool XMLTokenizer_Impl::next_tag_node(XMLToken *out_token)
 		XMLTokenizer_Impl::throw_exception("Premature end of XML data!");
 	pos = end_pos;
 
-	out_token->type = questionMark ? XMLToken::PROCESSING_INSTRUCTION_TOKEN : XMLToken::ELEMENT_TOKEN;
-	out_token->variant = closing ? XMLToken::END : XMLToken::BEGIN;
-	out_token->name = data.substr(start_pos, end_pos - start_pos);
+	out_token.type = questionMark ? XMLToken::PROCESSING_INSTRUCTION_TOKEN : XMLToken::ELEMENT_TOKEN;
+	out_token.variant = closing ? XMLToken::END : XMLToken::BEGIN;
+	out_token.name = XMLTokenizer_Text(start_pos, end_pos - start_pos);
 
-	if (out_token->type == XMLToken::PROCESSING_INSTRUCTION_TOKEN)
+	if (out_token.type == XMLToken::PROCESSING_INSTRUCTION_TOKEN)
 	{
 		// Strip whitespace:
 		pos = data.find_first_not_of(" \r\n\t", pos);
@@ -201,10 +307,10 @@ bool XMLTokenizer_Impl::next_tag_node(XMLToken *out_token)
 		end_pos = data.find_first_of("?", pos);
 		if (end_pos == data.npos)
 			XMLTokenizer_Impl::throw_exception("Premature end of XML data!");
-		out_token->value = data.substr(pos, end_pos - pos);
+		out_token.value = XMLTokenizer_Text(pos, end_pos - pos);
 		pos = end_pos;
 	}
-	else // out_token->type == XMLToken::ELEMENT_TOKEN
+	else // out_token.type == XMLToken::ELEMENT_TOKEN
 	{
 		// Check for possible attributes:
 		while (true)
@@ -225,14 +331,14 @@ bool XMLTokenizer_Impl::next_tag_node(XMLToken *out_token)
 				XMLTokenizer_Impl::throw_exception("Premature end of XML data!");
 			pos = end_pos;
 
-			std::string attributeName = data.substr(start_pos, end_pos-start_pos);
+			XMLTokenizer_Text attributeName(start_pos, end_pos-start_pos);
 
 			// Find seperator:
 			pos = data.find_first_not_of(" \r\n\t", pos);
 			if (pos == data.npos || pos == size-1)
 				XMLTokenizer_Impl::throw_exception("Premature end of XML data!");
 			if (data[pos++] != '=')
-				XMLTokenizer_Impl::throw_exception(string_format("XML error(s), parser confused at line %1 (tag=%2, attributeName=%3)", get_line_number(), out_token->name, attributeName));
+				XMLTokenizer_Impl::throw_exception(string_format("XML error(s), parser confused at line %1 (tag=%2, attributeName=%3)", get_line_number(), data.substr(out_token.name.pos, out_token.name.length), data.substr(attributeName.pos, attributeName.length)));
 
 			// Strip whitespace:
 			pos = data.find_first_not_of(" \r\n\t", pos);
@@ -262,23 +368,23 @@ bool XMLTokenizer_Impl::next_tag_node(XMLToken *out_token)
 				if (end_pos == data.npos)
 					XMLTokenizer_Impl::throw_exception("Premature end of XML data!");
 
-				std::string attributeValue;
-				std::string attributeValueOrig = data.substr(start_pos, end_pos-start_pos);
-				unescape(attributeValue, attributeValueOrig);
+				XMLTokenizer_Text attributeValue = escaped_text(start_pos, end_pos);
 
 				pos = end_pos + 1;
 				if (pos == size)
 					XMLTokenizer_Impl::throw_exception("Premature end of XML data!");
 
 				// Finally apply attribute to token:
-				out_token->attributes.push_back(XMLToken::Attribute(attributeName, attributeValue));
+				if (out_token.num_attributes == out_token.attributes.size())
+					out_token.attributes.push_back(std::pair<XMLTokenizer_Text, XMLTokenizer_Text>());
+				out_token.attributes[out_token.num_attributes++] = std::make_pair(attributeName, attributeValue);
 		}
 	}
 
 	// Check if its singular:
 	if (data[pos] == '/' || data[pos] == '?')
 	{
-		out_token->variant = XMLToken::SINGLE;
+		out_token.variant = XMLToken::SINGLE;
 		pos++;
 		if (pos == size)
 			XMLTokenizer_Impl::throw_exception("Premature end of XML data!");
@@ -292,7 +398,7 @@ bool XMLTokenizer_Impl::next_tag_node(XMLToken *out_token)
 	return true;
 }
 
-bool XMLTokenizer_Impl::next_exclamation_mark_node(XMLToken *out_token)
+bool XMLTokenizer_Impl::next_exclamation_mark_node(XMLTokenizer_Token &out_token)
 {
 	if (pos+2 >= size)
 		XMLTokenizer_Impl::throw_exception("Premature end of XML data!");
@@ -305,15 +411,13 @@ bool XMLTokenizer_Impl::next_exclamation_mark_node(XMLToken *out_token)
 			XMLTokenizer_Impl::throw_exception("Premature end of XML data!");
 		pos = end_pos+3;
 
-		std::string text;
-		std::string text_orig = data.substr(start_pos, end_pos-start_pos);
-		unescape(text, text_orig);
+		XMLTokenizer_Text text = escaped_text(start_pos, end_pos);
 		if (eat_whitespace)
 			text = trim_whitespace(text);
 
-		out_token->type = XMLToken::COMMENT_TOKEN;
-		out_token->variant = XMLToken::SINGLE;
-		out_token->value = text;
+		out_token.type = XMLToken::COMMENT_TOKEN;
+		out_token.variant = XMLToken::SINGLE;
+		out_token.value = text;
 		return true;
 	}
 
@@ -450,7 +554,7 @@ bool XMLTokenizer_Impl::next_exclamation_mark_node(XMLToken *out_token)
 			XMLTokenizer_Impl::throw_exception(string_format("Error in XML stream, line %1 (expected end of DOCTYPE)", get_line_number()));
 		pos++;
 
-		out_token->type = XMLToken::DOCUMENT_TYPE_TOKEN;
+		out_token.type = XMLToken::DOCUMENT_TYPE_TOKEN;
 		return true;
 	}
 	else if (data.compare(pos, 7, "[CDATA[") == 0)
@@ -461,11 +565,9 @@ bool XMLTokenizer_Impl::next_exclamation_mark_node(XMLToken *out_token)
 			XMLTokenizer_Impl::throw_exception("Premature end of XML data!");
 		pos = end_pos+3;
 
-		std::string value = data.substr(start_pos, end_pos-start_pos);
-
-		out_token->type = XMLToken::CDATA_SECTION_TOKEN;
-		out_token->variant = XMLToken::SINGLE;
-		out_token->value = value;
+		out_token.type = XMLToken::CDATA_SECTION_TOKEN;
+		out_token.variant = XMLToken::SINGLE;
+		out_token.value = XMLTokenizer_Text(start_pos, end_pos-start_pos);
 		return true;
 	}
 	else
@@ -495,54 +597,22 @@ int XMLTokenizer_Impl::get_line_number()
 	return line;
 }
 
-inline void XMLTokenizer_Impl::unescape(std::string &unescaped, const std::string &text)
+XMLTokenizer_Text XMLTokenizer_Impl::escaped_text(std::string::size_type start_pos, std::string::size_type end_pos) const
 {
-	static const std::string quot("&quot;");
-	static const std::string apos("&apos;");
-	static const std::string lt("&lt;");
-	static const std::string gt("&gt;");
-	static const std::string amp("&amp;");
-
-	unescaped = text;
-	unescape(unescaped, quot, '"');
-	unescape(unescaped, apos, '\'');
-	unescape(unescaped, lt, '<');
-	unescape(unescaped, gt, '>');
-	unescape(unescaped, amp, '&');
-}
-
-inline void XMLTokenizer_Impl::unescape(std::string &text, const std::string &search, std::string::value_type replace)
-{
-	std::string::size_type read_pos = 0;
-	std::string::size_type length = text.length();
-	std::string::size_type search_length = search.length();
-	while (true)
-	{
-		std::string::size_type next_match = text.find(search, read_pos);
-		if (next_match == std::string::npos)
-			break;
-
-		std::string::size_type copy_size = length - (next_match + search_length);
-		if (copy_size > 0)
-			memcpy(&text[next_match + 1], &text[next_match + search_length], copy_size * sizeof(std::string::value_type));
-		text[next_match] = replace;
-		length -= search_length - 1;
-		read_pos = next_match + 1;
-		if (read_pos > length)
-			break;
-	}
-	text.resize(length);
+	bool escaped = memchr(data.data() + start_pos, '&', end_pos - start_pos) != 0;
+	return XMLTokenizer_Text(start_pos, end_pos - start_pos, escaped);
 }
 
-inline std::string XMLTokenizer_Impl::trim_whitespace(const std::string &text)
+XMLTokenizer_Text XMLTokenizer_Impl::trim_whitespace(const XMLTokenizer_Text &text) const
 {
-	std::string::size_type pos_start = text.find_first_not_of(" \t\r\n");
-	if (pos_start == std::string::npos)
-		return std::string();
-	std::string::size_type pos_end = text.find_last_not_of(" \t\r\n");
-	if (pos_end == std::string::npos)
-		return std::string();
-	return text.substr(pos_start, pos_end - pos_start + 1);
+	// Entity references never expand to whitespace, so trimming before unescaping gives the same result
+	std::string::size_type pos_start = text.pos;
+	std::string::size_type pos_end = text.pos + text.length;
+	while (pos_start < pos_end && (data[pos_start] == ' ' || data[pos_start] == '\t' || data[pos_start] == '\r' || data[pos_start] == '\n'))
+		pos_start++;
+	while (pos_end > pos_start && (data[pos_end - 1] == ' ' || data[pos_end - 1] == '\t' || data[pos_end - 1] == '\r' || data[pos_end - 1] == '\n'))
+		pos_end--;
+	return XMLTokenizer_Text(pos_start, pos_end - pos_start, text.escaped);
 }
 
 }
@@ -29,10 +29,42 @@
 #pragma once
 
 #include "API/Core/IOData/iodevice.h"
+#include "API/Core/XML/xml_token.h"
+#include <vector>
 
 namespace clan
 {
 
+/// \brief Range of the tokenizer data making up a name or a value
+class XMLTokenizer_Text
+{
+public:
+	XMLTokenizer_Text() : pos(0), length(0), escaped(false) { }
+	XMLTokenizer_Text(std::string::size_type pos, std::string::size_type length, bool escaped = false) : pos(pos), length(length), escaped(escaped) { }
+
+	std::string::size_type pos;
+	std::string::size_type length;
+
+	/// \brief True if the range contains entity references that must be unescaped
+	bool escaped;
+};
+
+/// \brief Token referring to ranges in the tokenizer data instead of holding copies
+class XMLTokenizer_Token
+{
+public:
+	XMLTokenizer_Token() : type(XMLToken::NULL_TOKEN), variant(XMLToken::SINGLE), num_attributes(0) { }
+
+	XMLToken::TokenType type;
+	XMLToken::TokenVariant variant;
+	XMLTokenizer_Text name;
+	XMLTokenizer_Text value;
+
+	/// \brief Attribute name and value pairs. Only the first num_attributes entries are valid.
+	std::vector<std::pair<XMLTokenizer_Text, XMLTokenizer_Text> > attributes;
+	std::vector<std::pair<XMLTokenizer_Text, XMLTokenizer_Text> >::size_type num_attributes;
+};
+
 class XMLTokenizer_Impl
 {
 /// \name Construction
@@ -48,22 +80,34 @@ public:
 	std::string::size_type pos, size;
 	std::string data;
 	bool eat_whitespace;
+	XMLTokenizer_Token token;
 /// \}
 
 /// \name Operations
 /// \{
 public:
+	/// \brief Reads the entire input device into data
+	void load(IODevice &input);
+
+	/// \brief Reads the next token into out_token
+	void next(XMLTokenizer_Token &out_token);
+
+	/// \brief Copies a text range into out_text, unescaping it if needed
+	void get_text(const XMLTokenizer_Text &text, std::string &out_text) const;
+
+	/// \brief Copies a text range to the buffer, unescaping it if needed. Returns the length written.
+	std::string::size_type get_text(const XMLTokenizer_Text &text, char *out_text) const;
+
 	static void throw_exception(const std::string &str);
-	bool next_text_node(XMLToken *out_token);
-	bool next_tag_node(XMLToken *out_token);
-	bool next_exclamation_mark_node(XMLToken *out_token);
+	bool next_text_node(XMLTokenizer_Token &out_token);
+	bool next_tag_node(XMLTokenizer_Token &out_token);
+	bool next_exclamation_mark_node(XMLTokenizer_Token &out_token);
 
 	// used to get the line number when there is an error in the xml file
 	int get_line_number();
 
-	void unescape(std::string &text_out, const std::string &text_in);
-	void unescape(std::string &text, const std::string &search, std::string::value_type replace);
-	std::string trim_whitespace(const std::string &text);
+	XMLTokenizer_Text escaped_text(std::string::size_type start_pos, std::string::size_type end_pos) const;
+	XMLTokenizer_Text trim_whitespace(const XMLTokenizer_Text &text) const;
 /// \}
 
 /// \name Implementation
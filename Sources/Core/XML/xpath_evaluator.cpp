@@ -29,10 +29,10 @@
 
 #include "Core/precomp.h"
 #include "API/Core/XML/xpath_evaluator.h"
-#include "API/Core/XML/xpath_exception.h"
+#include "API/Core/XML/xpath_expression.h"
 #include "API/Core/XML/dom_node.h"
 #include "xpath_evaluator_impl.h"
-#include "xpath_token.h"
+#include "xpath_expression_impl.h"
 
 namespace clan
 {
@@ -50,12 +50,8 @@ XPathEvaluator::XPathEvaluator()
 
 XPathObject XPathEvaluator::evaluate(const std::string &expression, const DomNode &context_node) const
 {
-	XPathToken prev_token;
-	std::vector<DomNode> nodelist(1, context_node);
-	XPathEvaluateResult result = impl->evaluate(expression, nodelist, 0, prev_token);
-	if (result.next_token.type != XPathToken::type_none)
-		throw XPathException("Expected end of expression", expression, result.next_token);
-	return result.result;
+	XPathExpression compiled_expression(XPathExpression_Impl::compile_cached(expression));
+	return compiled_expression.evaluate(context_node);
 }
 
 }
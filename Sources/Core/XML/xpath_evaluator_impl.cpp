@@ -40,6 +40,8 @@
 #include "xpath_evaluator_impl.h"
 #include "xpath_token.h"
 #include "xpath_location_step.h"
+#include "xpath_expression_node.h"
+#include "dom_document_generic.h"
 #include <cmath>
 #include <limits>
 
@@ -50,10 +52,51 @@ namespace clan
 // XPathEvaluator_Impl Operations:
 
 
-XPathEvaluateResult XPathEvaluator_Impl::evaluate(
-	const std::string &expression,
+std::shared_ptr<XPathExpressionNode> XPathEvaluator_Impl::compile(const std::string &expression) const
+{
+	XPathCompileResult result = compile(expression, XPathToken());
+	if (result.next_token.type != XPathToken::type_none)
+		throw XPathException("Expected end of expression", expression, result.next_token);
+	return result.node;
+}
+
+XPathObject XPathEvaluator_Impl::evaluate(
+	const XPathExpressionNode &node,
 	const XPathNodeSet &context,
-	XPathNodeSet::size_type context_node_index,
+	XPathNodeSet::size_type context_node_index) const
+{
+	switch (node.type)
+	{
+	case XPathExpressionNode::type_literal:
+		return XPathObject(node.str);
+
+	case XPathExpressionNode::type_number:
+		return XPathObject(node.number);
+
+	case XPathExpressionNode::type_function:
+		{
+			std::vector<XPathObject> parameters;
+			parameters.reserve(node.operands.size());
+			for (std::vector<Operand>::const_iterator it = node.operands.begin(), itEnd = node.operands.end(); it != itEnd; ++it)
+				parameters.push_back(evaluate(**it, context, context_node_index));
+			return (this->*node.function)(context, context_node_index, parameters);
+		}
+
+	case XPathExpressionNode::type_operator:
+		return evaluate_operator(node, context, context_node_index);
+
+	case XPathExpressionNode::type_location_path:
+		return evaluate_location_path(node, context, context_node_index);
+
+	case XPathExpressionNode::type_filter:
+		return evaluate_filter(node, context, context_node_index);
+	}
+
+	return XPathObject();
+}
+
+XPathCompileResult XPathEvaluator_Impl::compile(
+	const std::string &expression,
 	XPathToken prev_token) const
 {
 	std::vector<Operator> operator_stack;
@@ -78,37 +121,39 @@ XPathEvaluateResult XPathEvaluator_Impl::evaluate(
 			break;
 
 		// Check if its a location path:
-		if (cur_token.type == XPathToken::type_axis_name ||
-			cur_token.type == XPathToken::type_name_test ||
-			cur_token.type == XPathToken::type_at_sign ||
-			cur_token.type == XPathToken::type_dot ||
-			cur_token.type == XPathToken::type_double_dot ||
-			cur_token.type == XPathToken::type_node_type ||
-			(cur_token.type == XPathToken::type_operator &&
-				(cur_token.value.oper == XPathToken::operator_slash ||
-				cur_token.value.oper == XPathToken::operator_double_slash)))
-		{
-			prev_token = read_location_path(expression, cur_token, context, context_node_index, operand_stack);
+		if (is_step_token(cur_token) ||
+			is_operator(cur_token, XPathToken::operator_slash) ||
+			is_operator(cur_token, XPathToken::operator_double_slash))
+		{
+			prev_token = read_location_path(expression, cur_token, operand_stack);
 			continue;
 		}
 
-		// Evaluate expression:
-
 		if (cur_token.type == XPathToken::type_literal)
 		{
-			operand_stack.push_back(XPathObject(cur_token.value.str));
+			Operand literal(new XPathExpressionNode(XPathExpressionNode::type_literal));
+			literal->str = cur_token.value.str;
+			operand_stack.push_back(literal);
 		}
 		else if (cur_token.type == XPathToken::type_variable_reference)
 		{
-			operand_stack.push_back(XPathObject(get_variable(cur_token.value.str)));
+			Operand variable(new XPathExpressionNode(XPathExpressionNode::type_literal));
+			variable->str = get_variable(cur_token.value.str).get_string();
+			operand_stack.push_back(variable);
 		}
 		else if (cur_token.type == XPathToken::type_number)
 		{
-			operand_stack.push_back(XPathObject(StringHelp::text_to_double(cur_token.value.str)));
+			Operand value(new XPathExpressionNode(XPathExpressionNode::type_number));
+			value->number = StringHelp::text_to_double(cur_token.value.str);
+			operand_stack.push_back(value);
 		}
 		else if (cur_token.type == XPathToken::type_function_name)
 		{
-			std::string function_name = cur_token.value.str;
+			Operand function(new XPathExpressionNode(XPathExpressionNode::type_function));
+			function->function = find_function(cur_token.value.str);
+			if (function->function == 0)
+				throw XPathException(string_format("Unknown function '%1'", cur_token.value.str), expression, cur_token);
+
 			cur_token = read_token(expression, cur_token);
 			if (cur_token.type != XPathToken::type_operator ||
 				cur_token.value.oper != XPathToken::operator_parenthesis_begin)
@@ -116,12 +161,11 @@ XPathEvaluateResult XPathEvaluator_Impl::evaluate(
 				throw XPathException("Expected '(' after function name", expression, cur_token);
 			}
 
-			std::vector<XPathObject> parameters;
 			while (true)
 			{
-				XPathEvaluateResult result = evaluate(expression, context, context_node_index, cur_token);
-				if (!result.result.is_null())
-					parameters.push_back(result.result);
+				XPathCompileResult result = compile(expression, cur_token);
+				if (result.node)
+					function->operands.push_back(result.node);
 
 				cur_token = result.next_token;
 				if (cur_token.type == XPathToken::type_operator &&
@@ -131,55 +175,18 @@ XPathEvaluateResult XPathEvaluator_Impl::evaluate(
 					throw XPathException("Expected ',' or ')' in function call", expression, cur_token);
 			}
 
-			XPathObject obj = call_function(context, context_node_index, function_name, parameters);
-			operand_stack.push_back(obj);
+			operand_stack.push_back(function);
 		}
 		else if (cur_token.type == XPathToken::type_bracket_begin)
 		{
 			if (operand_stack.empty())
 				throw XPathException("Missing operand before predicate", expression, cur_token);
 
-			Operand cur_operand = operand_stack.back();
+			Operand filter(new XPathExpressionNode(XPathExpressionNode::type_filter));
+			filter->operands.push_back(operand_stack.back());
 			operand_stack.pop_back();
-			if (cur_operand.get_type() != XPathObject::type_node_set)
-				throw XPathException("Expected node-set operand before '['", expression, cur_token);
-
-			XPathToken end_token = cur_token;
-			while (end_token.type != XPathToken::type_bracket_end && end_token.type != XPathToken::type_none)
-				end_token = read_token(expression, end_token);
-
-			if (end_token.type == XPathToken::type_none)
-				throw XPathException("Missing matching ']' in expression", expression, cur_token);
-
-			XPathLocationStep::Predicate predicate;
-			predicate.pos = cur_token.pos + cur_token.length;
-			predicate.length = end_token.pos - predicate.pos;
-
-			XPathNodeSet filtered_nodes;
-			XPathNodeSet nodes = cur_operand.get_node_set();
-			for (XPathNodeSet::size_type node_index = 0, num_nodes = nodes.size(); node_index < num_nodes; node_index++)
-			{
-				if (confirm_step_predicate(nodes, node_index, predicate, expression))
-					filtered_nodes.push_back(nodes[node_index]);
-			}
-
-			cur_token = read_token(expression, end_token);
-			XPathToken next_token = read_token(expression, cur_token);
-			if (!filtered_nodes.empty() &&
-				(next_token.type == XPathToken::type_axis_name ||
-				next_token.type == XPathToken::type_name_test ||
-				next_token.type == XPathToken::type_node_type ||
-				next_token.type == XPathToken::type_at_sign ||
-				next_token.type == XPathToken::type_dot ||
-				next_token.type == XPathToken::type_double_dot ||
-				(next_token.type == XPathToken::type_operator && next_token.value.oper == XPathToken::operator_double_slash)))
-			{
-				cur_token = read_location_steps(expression, next_token, filtered_nodes, 0, operand_stack);
-			}
-			else
-			{
-				operand_stack.push_back(XPathObject(filtered_nodes));
-			}
+			cur_token = read_filter(expression, cur_token, *filter);
+			operand_stack.push_back(filter);
 		}
 		else if (cur_token.type == XPathToken::type_operator)
 		{
@@ -200,6 +207,21 @@ XPathEvaluateResult XPathEvaluator_Impl::evaluate(
 
 			if (cur_operator != XPathToken::operator_parenthesis_end)
 				operator_stack.push_back(cur_operator);
+
+			// '(expr)/step' is a filter expression without predicates
+			if (cur_operator == XPathToken::operator_parenthesis_end && !operand_stack.empty())
+			{
+				XPathToken next_token = read_token(expression, cur_token);
+				if (is_operator(next_token, XPathToken::operator_slash) ||
+					is_operator(next_token, XPathToken::operator_double_slash))
+				{
+					Operand filter(new XPathExpressionNode(XPathExpressionNode::type_filter));
+					filter->operands.push_back(operand_stack.back());
+					operand_stack.pop_back();
+					cur_token = read_filter_steps(expression, cur_token, *filter);
+					operand_stack.push_back(filter);
+				}
+			}
 		}
 		else
 		{
@@ -221,70 +243,71 @@ XPathEvaluateResult XPathEvaluator_Impl::evaluate(
 		throw XPathException("Expected operand", expression, cur_token);
 	}
 
-	XPathEvaluateResult result;
-	result.result = operand_stack.empty() ? XPathObject() : operand_stack.back();
+	XPathCompileResult result;
+	if (!operand_stack.empty())
+		result.node = operand_stack.back();
 	result.next_token = cur_token;
 	return result;
 }
 
-XPathObject XPathEvaluator_Impl::call_function(const XPathNodeSet& context, XPathNodeSet::size_type context_node_index, const std::string &name, const std::vector<XPathObject> &parameters) const
+XPathEvaluator_Impl::Function XPathEvaluator_Impl::find_function(const std::string &name)
 {
 	if (name == "last")
-		return function_last(context, context_node_index, parameters);
+		return &XPathEvaluator_Impl::function_last;
 	else if (name == "position")
-		return function_position(context, context_node_index, parameters);
+		return &XPathEvaluator_Impl::function_position;
 	else if (name == "count")
-		return function_count(context, context_node_index, parameters);
+		return &XPathEvaluator_Impl::function_count;
 	else if (name == "id")
-		return function_id(context, context_node_index, parameters);
+		return &XPathEvaluator_Impl::function_id;
 	else if (name == "local-name")
-		return function_local_name(context, context_node_index, parameters);
+		return &XPathEvaluator_Impl::function_local_name;
 	else if (name == "namespace-uri")
-		return function_namespace_uri(context, context_node_index, parameters);
+		return &XPathEvaluator_Impl::function_namespace_uri;
 	else if (name == "name")
-		return function_name(context, context_node_index, parameters);
+		return &XPathEvaluator_Impl::function_name;
 	else if (name == "string")
-		return function_string(context, context_node_index, parameters);
+		return &XPathEvaluator_Impl::function_string;
 	else if (name == "concat")
-		return function_concat(context, context_node_index, parameters);
+		return &XPathEvaluator_Impl::function_concat;
 	else if (name == "starts-with")
-		return function_starts_with(context, context_node_index, parameters);
+		return &XPathEvaluator_Impl::function_starts_with;
 	else if (name == "contains")
-		return function_contains(context, context_node_index, parameters);
+		return &XPathEvaluator_Impl::function_contains;
 	else if (name == "substring-before")
-		return function_substring_before(context, context_node_index, parameters);
+		return &XPathEvaluator_Impl::function_substring_before;
 	else if (name == "substring-after")
-		return function_substring_after(context, context_node_index, parameters);
+		return &XPathEvaluator_Impl::function_substring_after;
 	else if (name == "substring")
-		return function_substring(context, context_node_index, parameters);
+		return &XPathEvaluator_Impl::function_substring;
 	else if (name == "string-length")
-		return function_string_length(context, context_node_index, parameters);
+		return &XPathEvaluator_Impl::function_string_length;
 	else if (name == "normalize-space")
-		return function_normalize_space(context, context_node_index, parameters);
+		return &XPathEvaluator_Impl::function_normalize_space;
 	else if (name == "translate")
-		return function_translate(context, context_node_index, parameters);
+		return &XPathEvaluator_Impl::function_translate;
 	else if (name == "boolean")
-		return function_boolean(context, context_node_index, parameters);
+		return &XPathEvaluator_Impl::function_boolean;
 	else if (name == "not")
-		return function_not(context, context_node_index, parameters);
+		return &XPathEvaluator_Impl::function_not;
 	else if (name == "true")
-		return function_true(context, context_node_index, parameters);
+		return &XPathEvaluator_Impl::function_true;
 	else if (name == "false")
-		return function_false(context, context_node_index, parameters);
+		return &XPathEvaluator_Impl::function_false;
 	else if (name == "lang")
-		return function_lang(context, context_node_index, parameters);
+		return &XPathEvaluator_Impl::function_lang;
 	else if (name == "number")
-		return function_number(context, context_node_index, parameters);
+		return &XPathEvaluator_Impl::function_number;
 	else if (name == "sum")
-		return function_sum(context, context_node_index, parameters);
+		return &XPathEvaluator_Impl::function_sum;
 	else if (name == "floor")
-		return function_floor(context, context_node_index, parameters);
+		return &XPathEvaluator_Impl::function_floor;
 	else if (name == "ceiling")
-		return function_ceiling(context, context_node_index, parameters);
+		return &XPathEvaluator_Impl::function_ceiling;
 	else if (name == "round")
-		return function_round(context, context_node_index, parameters);
+		return &XPathEvaluator_Impl::function_round;
 
-	throw Exception(string_format("Unknown function '%1'", name));
+	return 0;
 }
 
 XPathObject XPathEvaluator_Impl::get_variable(const std::string &name) const
@@ -305,111 +328,99 @@ bool XPathEvaluator_Impl::do_npr(
 	Operator oper = operator_stack.back();
 	operator_stack.pop_back();
 
-	Operand a, b;
-	Operand result;
-
 	switch (oper)
 	{
 	case XPathToken::operator_parenthesis_begin:
 		return false;
 
 	case XPathToken::operator_and:
-		if (operand_stack.empty()) 
-			return false;
-		a = operand_stack.back();
-		operand_stack.pop_back();
-
-		if (operand_stack.empty()) 
-			return false;
-		b = operand_stack.back();
-		operand_stack.pop_back();
-
-		result.set_boolean(boolean(b).get_boolean() && boolean(a).get_boolean());
-		operand_stack.push_back(result);
+	case XPathToken::operator_or:
+	case XPathToken::operator_mod:
+	case XPathToken::operator_div:
+	case XPathToken::operator_multiply:
+	case XPathToken::operator_union:
+	case XPathToken::operator_plus:
+	case XPathToken::operator_minus:
+	case XPathToken::operator_compare_equal:
+	case XPathToken::operator_compare_not_equal:
+	case XPathToken::operator_less:
+	case XPathToken::operator_less_equal:
+	case XPathToken::operator_greater:
+	case XPathToken::operator_greater_equal:
+		{
+			if (operand_stack.empty()) 
+				return false;
+			Operand a = operand_stack.back();
+			operand_stack.pop_back();
+
+			if (operand_stack.empty()) 
+				return false;
+			Operand b = operand_stack.back();
+			operand_stack.pop_back();
+
+			Operand result(new XPathExpressionNode(XPathExpressionNode::type_operator));
+			result->oper = oper;
+			result->operands.push_back(b);
+			result->operands.push_back(a);
+			operand_stack.push_back(result);
+		}
 		break;
 
-	case XPathToken::operator_or:
-		if (operand_stack.empty()) 
-			return false;
-		a = operand_stack.back();
-		operand_stack.pop_back();
-
-		if (operand_stack.empty()) 
-			return false;
-		b = operand_stack.back();
-		operand_stack.pop_back();
-
-		result.set_boolean(boolean(b).get_boolean() || boolean(a).get_boolean());
-		operand_stack.push_back(result);
+	default:	// Added to stop compiler warnings for "operator_xxx" not handled in switch
 		break;
+	}
+
+	return true;
+}
+
+XPathObject XPathEvaluator_Impl::evaluate_operator(const XPathExpressionNode &node, const XPathNodeSet &context, XPathNodeSet::size_type context_node_index) const
+{
+	const XPathExpressionNode &left = *node.operands[0];
+	const XPathExpressionNode &right = *node.operands[1];
+
+	switch (node.oper)
+	{
+	case XPathToken::operator_and:
+		return XPathObject(boolean(evaluate(left, context, context_node_index)).get_boolean() && boolean(evaluate(right, context, context_node_index)).get_boolean());
+
+	case XPathToken::operator_or:
+		return XPathObject(boolean(evaluate(left, context, context_node_index)).get_boolean() || boolean(evaluate(right, context, context_node_index)).get_boolean());
 
 	case XPathToken::operator_mod:
-		if (operand_stack.empty()) 
-			return false;
-		a = operand_stack.back();
-		operand_stack.pop_back();
-
-		if (operand_stack.empty()) 
-			return false;
-		b = operand_stack.back();
-		operand_stack.pop_back();
-
-		result.set_number(static_cast<int>(number(b).get_number()) % static_cast<int>(number(a).get_number()));
-		operand_stack.push_back(result);
-		break;
+		{
+			int b = static_cast<int>(number(evaluate(left, context, context_node_index)).get_number());
+			int a = static_cast<int>(number(evaluate(right, context, context_node_index)).get_number());
+			return XPathObject(static_cast<double>(b % a));
+		}
+
 	case XPathToken::operator_div:
-		if (operand_stack.empty()) 
-			return false;
-		a = operand_stack.back();
-		operand_stack.pop_back();
-
-		if (operand_stack.empty()) 
-			return false;
-		b = operand_stack.back();
-		operand_stack.pop_back();
-
-		result.set_number(number(b).get_number() / number(a).get_number());
-		operand_stack.push_back(result);
-		break;
+		return XPathObject(number(evaluate(left, context, context_node_index)).get_number() / number(evaluate(right, context, context_node_index)).get_number());
+
 	case XPathToken::operator_multiply:
-		if (operand_stack.empty()) 
-			return false;
-		a = operand_stack.back();
-		operand_stack.pop_back();
-
-		if (operand_stack.empty()) 
-			return false;
-		b = operand_stack.back();
-		operand_stack.pop_back();
-
-		result.set_number(number(a).get_number() * number(b).get_number());
-		operand_stack.push_back(result);
-		break;
-	case XPathToken::operator_union:
-		if (operand_stack.empty()) 
-			return false;
-		a = operand_stack.back();
-		operand_stack.pop_back();
+		return XPathObject(number(evaluate(left, context, context_node_index)).get_number() * number(evaluate(right, context, context_node_index)).get_number());
 
-		if (operand_stack.empty()) 
-			return false;
-		b = operand_stack.back();
-		operand_stack.pop_back();
+	case XPathToken::operator_plus:
+		return XPathObject(number(evaluate(left, context, context_node_index)).get_number() + number(evaluate(right, context, context_node_index)).get_number());
 
-		if (a.get_type() != XPathObject::type_node_set)
-			return false;
-		if (b.get_type() != XPathObject::type_node_set)
-			return false;
+	case XPathToken::operator_minus:
+		return XPathObject(number(evaluate(left, context, context_node_index)).get_number() - number(evaluate(right, context, context_node_index)).get_number());
 
+	case XPathToken::operator_union:
 		{
+			XPathObject b = evaluate(left, context, context_node_index);
+			XPathObject a = evaluate(right, context, context_node_index);
+			if (a.get_type() != XPathObject::type_node_set || b.get_type() != XPathObject::type_node_set)
+				throw XPathException("Expected node-set operands for '|'");
+
 			XPathNodeSet nodeset_a = a.get_node_set();
 			XPathNodeSet nodeset_b = b.get_node_set();
+			XPathNodeSet::size_type num_b = nodeset_b.size();
 			for (XPathNodeSet::const_iterator ita = nodeset_a.begin(), itaEnd = nodeset_a.end(); ita != itaEnd; ++ita)
 			{
 				bool found = false;
-				for (XPathNodeSet::const_iterator itb = nodeset_b.begin(), itbEnd = nodeset_b.end(); itb != itbEnd; ++itb)
+				for (XPathNodeSet::size_type index_b = 0; index_b < num_b; index_b++)
 				{
-					if (*ita == *itb)
+					if (*ita == nodeset_b[index_b])
 					{
 						found = true;
 						break;
@@ -418,133 +429,57 @@ bool XPathEvaluator_Impl::do_npr(
 				if (!found)
 					nodeset_b.push_back(*ita);
 			}
-
-			result.set_node_set(nodeset_b);
-			operand_stack.push_back(result);
+			return XPathObject(nodeset_b);
 		}
-		break;
-
-	case XPathToken::operator_plus:
-		if (operand_stack.empty()) 
-			return false;
-		a = operand_stack.back();
-		operand_stack.pop_back();
-
-		if (operand_stack.empty()) 
-			return false;
-		b = operand_stack.back();
-		operand_stack.pop_back();
-
-		result.set_number(number(a).get_number() + number(b).get_number());
-		operand_stack.push_back(result);
-		break;
-
-	case XPathToken::operator_minus:
-		if (operand_stack.empty()) 
-			return false;
-		a = operand_stack.back();
-		operand_stack.pop_back();
-
-		if (operand_stack.empty()) 
-			return false;
-		b = operand_stack.back();
-		operand_stack.pop_back();
-
-		result.set_number(number(b).get_number() - number(a).get_number());
-		operand_stack.push_back(result);
-		break;
 
 	case XPathToken::operator_compare_equal:
-		if (operand_stack.empty()) 
-			return false;
-		a = operand_stack.back();
-		operand_stack.pop_back();
-
-		if (operand_stack.empty()) 
-			return false;
-		b = operand_stack.back();
-		operand_stack.pop_back();
-
-		result.set_boolean(compare_operands(b, a, oper));
-		operand_stack.push_back(result);
-		break;
 	case XPathToken::operator_compare_not_equal:
-		if (operand_stack.empty()) 
-			return false;
-		a = operand_stack.back();
-		operand_stack.pop_back();
-
-		if (operand_stack.empty()) 
-			return false;
-		b = operand_stack.back();
-		operand_stack.pop_back();
-
-		result.set_boolean(compare_operands(b, a, oper));
-		operand_stack.push_back(result);
-		break;
 	case XPathToken::operator_less:
-		if (operand_stack.empty()) 
-			return false;
-		a = operand_stack.back();
-		operand_stack.pop_back();
-
-		if (operand_stack.empty()) 
-			return false;
-		b = operand_stack.back();
-		operand_stack.pop_back();
-
-		result.set_boolean(compare_operands(b, a, oper));
-		operand_stack.push_back(result);
-		break;
 	case XPathToken::operator_less_equal:
-		if (operand_stack.empty()) 
-			return false;
-		a = operand_stack.back();
-		operand_stack.pop_back();
-
-		if (operand_stack.empty()) 
-			return false;
-		b = operand_stack.back();
-		operand_stack.pop_back();
-
-		result.set_boolean(compare_operands(b, a, oper));
-		operand_stack.push_back(result);
-		break;
-
 	case XPathToken::operator_greater:
-		if (operand_stack.empty()) 
-			return false;
-		a = operand_stack.back();
-		operand_stack.pop_back();
-
-		if (operand_stack.empty()) 
-			return false;
-		b = operand_stack.back();
-		operand_stack.pop_back();
-
-		result.set_boolean(compare_operands(b, a, oper));
-		operand_stack.push_back(result);
-		break;
-
 	case XPathToken::operator_greater_equal:
-		if (operand_stack.empty()) 
-			return false;
-		a = operand_stack.back();
-		operand_stack.pop_back();
-
-		if (operand_stack.empty()) 
-			return false;
-		b = operand_stack.back();
-		operand_stack.pop_back();
-
-		result.set_boolean(compare_operands(b, a, oper));
-		operand_stack.push_back(result);
-		break;
-	default:	// Added to stop compiler warnings for "operator_xxx" not handled in switch
-		break;
+		return XPathObject(compare_operands(evaluate(left, context, context_node_index), evaluate(right, context, context_node_index), node.oper));
+
+	default:
+		return XPathObject();
 	}
+}
 
-	return true;
+XPathObject XPathEvaluator_Impl::evaluate_location_path(const XPathExpressionNode &node, const XPathNodeSet &context, XPathNodeSet::size_type context_node_index) const
+{
+	XPathNodeSet nodeset(1, context[context_node_index]);
+	if (node.absolute)
+	{
+		// Find root node:
+		while (true)
+		{
+			DomNode parent = nodeset[0].get_parent_node();
+			if (!parent.is_null())
+				nodeset[0] = parent;
+			else
+				break;
+		}
+	}
+
+	XPathNodeSet nodes;
+	evaluate_location_steps(nodeset, node.steps, nodes);
+	return XPathObject(nodes);
+}
+
+XPathObject XPathEvaluator_Impl::evaluate_filter(const XPathExpressionNode &node, const XPathNodeSet &context, XPathNodeSet::size_type context_node_index) const
+{
+	XPathObject operand = evaluate(*node.operands[0], context, context_node_index);
+	if (operand.get_type() != XPathObject::type_node_set)
+		throw XPathException("Expected node-set operand before '['");
+
+	XPathNodeSet nodeset = operand.get_node_set();
+	evaluate_predicates(node.predicates, nodeset);
+	if (node.steps.empty() || nodeset.empty())
+		return XPathObject(nodeset);
+
+	XPathNodeSet nodes;
+	evaluate_location_steps(nodeset, node.steps, nodes);
+	return XPathObject(nodes);
 }
 
 template<>
@@ -613,7 +548,7 @@ bool XPathEvaluator_Impl::compare(const T &value1, const T &value2, Operator ope
 	return false;
 }
 
-bool XPathEvaluator_Impl::compare_operands(const Operand &a, const Operand &b, Operator oper) const
+bool XPathEvaluator_Impl::compare_operands(const XPathObject &a, const XPathObject &b, Operator oper) const
 {
 	if (a.get_type() == XPathObject::type_node_set)
 	{
@@ -637,19 +572,24 @@ bool XPathEvaluator_Impl::compare_operands(const Operand &a, const Operand &b, O
 	}
 }
 
-bool XPathEvaluator_Impl::compare_node_set(const Operand &a, const Operand &b, Operator oper) const
+bool XPathEvaluator_Impl::compare_node_set(const XPathObject &a, const XPathObject &b, Operator oper) const
 {
 	XPathNodeSet nodeset1 = a.get_node_set();
 	if (b.get_type() == XPathObject::type_node_set)
 	{
+		// Convert the second node-set to strings once rather than for every node in the first
 		XPathNodeSet nodeset2 = b.get_node_set();
+		std::vector<std::string> values2;
+		values2.reserve(nodeset2.size());
+		for (XPathNodeSet::const_iterator it2 = nodeset2.begin(); it2 != nodeset2.end(); ++it2)
+			values2.push_back(string(*it2));
+
 		for (XPathNodeSet::const_iterator it1 = nodeset1.begin(); it1 != nodeset1.end(); ++it1)
 		{
 			std::string value1 = string(*it1);
-			for (XPathNodeSet::const_iterator it2 = nodeset2.begin(); it2 != nodeset2.end(); ++it2)
+			for (std::vector<std::string>::const_iterator it2 = values2.begin(); it2 != values2.end(); ++it2)
 			{
-				std::string value2 = string(*it2);
-				if (compare(value1, value2, oper))
+				if (compare(value1, *it2, oper))
 					return true;
 			}
 		}
@@ -701,7 +641,7 @@ bool XPathEvaluator_Impl::compare_node_set(const Operand &a, const Operand &b, O
 	}
 }
 
-bool XPathEvaluator_Impl::compare_boolean(const Operand &a, const Operand &b, Operator oper) const
+bool XPathEvaluator_Impl::compare_boolean(const XPathObject &a, const XPathObject &b, Operator oper) const
 {
 	bool value1 = a.get_boolean();
 	if (b.get_type() == XPathObject::type_node_set)
@@ -750,7 +690,7 @@ bool XPathEvaluator_Impl::compare_boolean(const Operand &a, const Operand &b, Op
 	}
 }
 
-bool XPathEvaluator_Impl::compare_number(const Operand &a, const Operand &b, Operator oper) const
+bool XPathEvaluator_Impl::compare_number(const XPathObject &a, const XPathObject &b, Operator oper) const
 {
 	double value1 = a.get_number();
 	if (b.get_type() == XPathObject::type_node_set)
@@ -807,7 +747,7 @@ bool XPathEvaluator_Impl::compare_number(const Operand &a, const Operand &b, Ope
 	}
 }
 
-bool XPathEvaluator_Impl::compare_string(const Operand &a, const Operand &b, Operator oper) const
+bool XPathEvaluator_Impl::compare_string(const XPathObject &a, const XPathObject &b, Operator oper) const
 {
 	if (b.get_type() == XPathObject::type_node_set)
 	{
@@ -858,8 +798,6 @@ bool XPathEvaluator_Impl::compare_string(const Operand &a, const Operand &b, Ope
 XPathToken XPathEvaluator_Impl::read_location_path(
 	const std::string &expression,
 	XPathToken cur_token,
-	const XPathNodeSet &context,
-	XPathNodeSet::size_type context_node_index,
 	std::vector<XPathEvaluator_Impl::Operand> &operand_stack) const
 {
 /*
@@ -868,95 +806,69 @@ XPathToken XPathEvaluator_Impl::read_location_path(
 	[3] RelativeLocationPath       ::= Step | RelativeLocationPath '/' Step | AbbreviatedRelativeLocationPath
 */
 
-	if (cur_token.type == XPathToken::type_operator && (cur_token.value.oper == XPathToken::operator_slash || cur_token.value.oper == XPathToken::operator_double_slash))
-	{
-		// Find root node:
-		DomNode root_node = context[context_node_index];
-		while (true)
-		{
-			DomNode parent = root_node.get_parent_node();
-			if (!parent.is_null())
-				root_node = parent;
-			else
-				break;
-		}
-
-		XPathNodeSet nodeset(1, root_node);
+	Operand path(new XPathExpressionNode(XPathExpressionNode::type_location_path));
+	operand_stack.push_back(path);
 
-		if (cur_token.value.oper == XPathToken::operator_double_slash)
-		{
-			return read_location_steps(expression, cur_token, nodeset, 0, operand_stack);
-		}
+	if (is_operator(cur_token, XPathToken::operator_slash))
+	{
+		path->absolute = true;
+		XPathToken next_token = read_token(expression, cur_token);
+		if (is_step_token(next_token) || is_operator(next_token, XPathToken::operator_double_slash))
+			return read_location_steps(expression, next_token, path->steps);
 		else
-		{
-			XPathToken next_token = read_token(expression, cur_token);
-			if (next_token.type == XPathToken::type_axis_name ||
-				next_token.type == XPathToken::type_name_test ||
-				next_token.type == XPathToken::type_node_type ||
-				next_token.type == XPathToken::type_at_sign ||
-				next_token.type == XPathToken::type_dot ||
-				next_token.type == XPathToken::type_double_dot ||
-				(next_token.type == XPathToken::type_operator && next_token.value.oper == XPathToken::operator_double_slash))
-			{
-				cur_token = next_token;
-				return read_location_steps(expression, cur_token, nodeset, 0, operand_stack);
-			}
-			else
-			{
-				operand_stack.push_back(XPathObject(nodeset));
-				return cur_token;
-			}
-		}
+			return cur_token;
+	}
+	else if (is_operator(cur_token, XPathToken::operator_double_slash))
+	{
+		path->absolute = true;
+		return read_location_steps(expression, cur_token, path->steps);
 	}
 	else
 	{
-		return read_location_steps(expression, cur_token, context, context_node_index, operand_stack);
+		return read_location_steps(expression, cur_token, path->steps);
 	}
 }
 
 XPathToken XPathEvaluator_Impl::read_location_steps(
 	const std::string &expression,
 	XPathToken cur_token,
-	const XPathNodeSet &context,
-	XPathNodeSet::size_type context_node_index,
-	std::vector<XPathEvaluator_Impl::Operand> &operand_stack) const
+	std::vector<XPathLocationStep> &steps) const
 {
-	std::vector<XPathLocationStep> steps;
 	while (true)
 	{
 		XPathLocationStep step;
 		cur_token = read_location_step(expression, cur_token, step);
-		steps.push_back(step);
 
-		XPathToken next_token = read_token(expression, cur_token);
-		if ((next_token.type == XPathToken::type_operator && next_token.value.oper == XPathToken::operator_slash) ||
-			(cur_token.type == XPathToken::type_operator && cur_token.value.oper == XPathToken::operator_double_slash))
-		{
-			if (next_token.value.oper == XPathToken::operator_slash)
-				next_token = read_token(expression, next_token);
-			if (next_token.type == XPathToken::type_axis_name ||
-				next_token.type == XPathToken::type_name_test ||
-				next_token.type == XPathToken::type_node_type ||
-				next_token.type == XPathToken::type_at_sign ||
-				next_token.type == XPathToken::type_dot ||
-				next_token.type == XPathToken::type_double_dot)
-			{
-				cur_token = next_token;
-			}
-			else
-			{
-				break;
-			}
+		// descendant-or-self::node()/child::name without predicates selects the same nodes as descendant::name
+		if (!steps.empty() && is_descendant_or_self_node_step(steps.back()) && step.axis == XPathLocationStep::axis_child && step.predicates.empty())
+		{
+			step.axis = XPathLocationStep::axis_descendant;
+			steps.back() = step;
 		}
 		else
 		{
-			break;
+			steps.push_back(step);
 		}
-	}
 
-	XPathNodeSet nodeset;
-	evaluate_location_step(context, context_node_index, steps, 0, expression, nodeset);
-	operand_stack.push_back(XPathObject(nodeset));
+		// '//' is a descendant-or-self::node() step of its own, followed by the step it applies to
+		bool double_slash_step = is_operator(cur_token, XPathToken::operator_double_slash);
+		XPathToken next_token = read_token(expression, cur_token);
+		if (!double_slash_step && is_operator(next_token, XPathToken::operator_double_slash))
+		{
+			cur_token = next_token;
+			continue;
+		}
+
+		if (!double_slash_step && !is_operator(next_token, XPathToken::operator_slash))
+			break;
+
+		if (is_operator(next_token, XPathToken::operator_slash))
+			next_token = read_token(expression, next_token);
+		if (!is_step_token(next_token))
+			break;
+
+		cur_token = next_token;
+	}
 	return cur_token;
 }
 
@@ -989,19 +901,19 @@ XPathToken XPathEvaluator_Impl::read_location_step(
 */
 	if (cur_token.type == XPathToken::type_dot)
 	{
-		step.axis = "self";
+		step.axis = XPathLocationStep::axis_self;
 		step.test_type = XPathLocationStep::type_node;
 		step.node_type = XPathToken::node_type_node;
 	}
 	else if (cur_token.type == XPathToken::type_double_dot)
 	{
-		step.axis = "parent";
+		step.axis = XPathLocationStep::axis_parent;
 		step.test_type = XPathLocationStep::type_node;
 		step.node_type = XPathToken::node_type_node;
 	}
-	else if (cur_token.type == XPathToken::type_operator && cur_token.value.oper == XPathToken::operator_double_slash)
+	else if (is_operator(cur_token, XPathToken::operator_double_slash))
 	{
-		step.axis = "descendant-or-self";
+		step.axis = XPathLocationStep::axis_descendant_or_self;
 		step.test_type = XPathLocationStep::type_node;
 		step.node_type = XPathToken::node_type_node;
 	}
@@ -1010,7 +922,8 @@ XPathToken XPathEvaluator_Impl::read_location_step(
 		// Read AxisSpecifier:
 		if (cur_token.type == XPathToken::type_axis_name)
 		{
-			step.axis = cur_token.value.str;
+			if (!find_axis(cur_token.value.str, step.axis))
+				throw XPathException("Unknown location step axis", expression, cur_token);
 			cur_token = read_token(expression, cur_token);
 			if (cur_token.type != XPathToken::type_double_colon)
 				throw XPathException("Expected '::' after axis name", expression, cur_token);
@@ -1018,12 +931,12 @@ XPathToken XPathEvaluator_Impl::read_location_step(
 		}
 		else if (cur_token.type == XPathToken::type_at_sign) // Abbreviated axis specifier
 		{
-			step.axis = "attribute";
+			step.axis = XPathLocationStep::axis_attribute;
 			cur_token = read_token(expression, cur_token);
 		}
 		else // Abbreviated syntax
 		{
-			step.axis = "child";
+			step.axis = XPathLocationStep::axis_child;
 		}
 
 		// Read Node Test:
@@ -1056,150 +969,289 @@ XPathToken XPathEvaluator_Impl::read_location_step(
 		XPathToken next_token = read_token(expression, cur_token);
 		while (next_token.type == XPathToken::type_bracket_begin)
 		{
-			XPathLocationStep::Predicate predicate;
-			predicate.pos = next_token.pos + next_token.length;
-			cur_token = skip_predicate_expression(expression, next_token);
-			predicate.length = cur_token.pos - predicate.pos;
-			step.predicates.push_back(predicate);
+			cur_token = read_predicate(expression, next_token, step.predicates);
 			next_token = read_token(expression, cur_token);
 		}
 	}
 	return cur_token;
 }
 
-XPathToken XPathEvaluator_Impl::skip_predicate_expression(const std::string &expression, const XPathToken &previous_token) const
+XPathToken XPathEvaluator_Impl::read_filter(
+	const std::string &expression,
+	XPathToken cur_token,
+	XPathExpressionNode &filter) const
 {
-	int bracket_count = 1;
-	XPathToken cur_token = previous_token;
+/*
+	[20] FilterExpr                ::= PrimaryExpr | FilterExpr Predicate
+	[19] PathExpr                  ::= LocationPath | FilterExpr | FilterExpr '/' RelativeLocationPath | FilterExpr '//' RelativeLocationPath
+*/
 	while (true)
 	{
-		cur_token = read_token(expression, cur_token);
-		if (cur_token.type == XPathToken::type_bracket_begin)
-		{
-			bracket_count++;
-		}
-		else if (cur_token.type == XPathToken::type_bracket_end)
+		cur_token = read_predicate(expression, cur_token, filter.predicates);
+		XPathToken next_token = read_token(expression, cur_token);
+		if (next_token.type != XPathToken::type_bracket_begin)
+			break;
+		cur_token = next_token;
+	}
+
+	return read_filter_steps(expression, cur_token, filter);
+}
+
+XPathToken XPathEvaluator_Impl::read_filter_steps(
+	const std::string &expression,
+	XPathToken cur_token,
+	XPathExpressionNode &filter) const
+{
+	XPathToken next_token = read_token(expression, cur_token);
+	if (is_operator(next_token, XPathToken::operator_double_slash))
+	{
+		cur_token = read_location_steps(expression, next_token, filter.steps);
+	}
+	else if (is_operator(next_token, XPathToken::operator_slash))
+	{
+		XPathToken step_token = read_token(expression, next_token);
+		if (is_step_token(step_token))
+			cur_token = read_location_steps(expression, step_token, filter.steps);
+	}
+	return cur_token;
+}
+
+XPathToken XPathEvaluator_Impl::read_predicate(
+	const std::string &expression,
+	const XPathToken &bracket_token,
+	std::vector<Operand> &predicates) const
+{
+	XPathCompileResult result = compile(expression, bracket_token);
+	if (result.next_token.type != XPathToken::type_bracket_end)
+		throw XPathException("Missing matching ']' in expression", expression, bracket_token);
+	predicates.push_back(result.node);
+	return result.next_token;
+}
+
+bool XPathEvaluator_Impl::is_operator(const XPathToken &token, Operator oper)
+{
+	return token.type == XPathToken::type_operator && token.value.oper == oper;
+}
+
+bool XPathEvaluator_Impl::is_step_token(const XPathToken &token)
+{
+	return
+		token.type == XPathToken::type_axis_name ||
+		token.type == XPathToken::type_name_test ||
+		token.type == XPathToken::type_node_type ||
+		token.type == XPathToken::type_at_sign ||
+		token.type == XPathToken::type_dot ||
+		token.type == XPathToken::type_double_dot;
+}
+
+bool XPathEvaluator_Impl::is_descendant_or_self_node_step(const XPathLocationStep &step)
+{
+	return
+		step.axis == XPathLocationStep::axis_descendant_or_self &&
+		step.test_type == XPathLocationStep::type_node &&
+		step.node_type == XPathToken::node_type_node &&
+		step.predicates.empty();
+}
+
+bool XPathEvaluator_Impl::find_axis(const std::string &name, XPathLocationStep::Axis &out_axis)
+{
+	if (name == "ancestor")
+		out_axis = XPathLocationStep::axis_ancestor;
+	else if (name == "ancestor-or-self")
+		out_axis = XPathLocationStep::axis_ancestor_or_self;
+	else if (name == "attribute")
+		out_axis = XPathLocationStep::axis_attribute;
+	else if (name == "child")
+		out_axis = XPathLocationStep::axis_child;
+	else if (name == "descendant")
+		out_axis = XPathLocationStep::axis_descendant;
+	else if (name == "descendant-or-self")
+		out_axis = XPathLocationStep::axis_descendant_or_self;
+	else if (name == "following")
+		out_axis = XPathLocationStep::axis_following;
+	else if (name == "following-sibling")
+		out_axis = XPathLocationStep::axis_following_sibling;
+	else if (name == "namespace")
+		out_axis = XPathLocationStep::axis_namespace;
+	else if (name == "parent")
+		out_axis = XPathLocationStep::axis_parent;
+	else if (name == "preceding")
+		out_axis = XPathLocationStep::axis_preceding;
+	else if (name == "preceding-sibling")
+		out_axis = XPathLocationStep::axis_preceding_sibling;
+	else if (name == "self")
+		out_axis = XPathLocationStep::axis_self;
+	else
+		return false;
+	return true;
+}
+
+void XPathEvaluator_Impl::evaluate_location_steps(const XPathNodeSet &context, const std::vector<XPathLocationStep> &steps, XPathNodeSet &nodes) const
+{
+	XPathNodeSet nodeset = context;
+	XPathNodeSet step_nodeset, selected_nodes;
+	for (std::vector<XPathLocationStep>::const_iterator it = steps.begin(), itEnd = steps.end(); it != itEnd; ++it)
+	{
+		step_nodeset.clear();
+		for (XPathNodeSet::const_iterator node_it = nodeset.begin(), node_itEnd = nodeset.end(); node_it != node_itEnd; ++node_it)
 		{
-			bracket_count--;
-			if (bracket_count == 0)
-				break;
+			selected_nodes.clear();
+			select_nodes(*node_it, *it, selected_nodes);
+			evaluate_predicates(it->predicates, selected_nodes);
+			step_nodeset.insert(step_nodeset.end(), selected_nodes.begin(), selected_nodes.end());
 		}
-		else if (cur_token.type == XPathToken::type_none)
+		nodeset.swap(step_nodeset);
+	}
+
+	nodes.insert(nodes.end(), nodeset.begin(), nodeset.end());
+}
+
+void XPathEvaluator_Impl::evaluate_predicates(const std::vector<Operand> &predicates, XPathNodeSet &nodes) const
+{
+	for (std::vector<Operand>::const_iterator pit = predicates.begin(), pEnd = predicates.end(); pit != pEnd && !nodes.empty(); ++pit)
+	{
+		XPathNodeSet filtered_nodes;
+		for (XPathNodeSet::size_type node_index = 0, num_nodes = nodes.size(); node_index < num_nodes; node_index++)
 		{
-			break;
+			if (confirm_predicate(**pit, nodes, node_index))
+				filtered_nodes.push_back(nodes[node_index]);
 		}
+		nodes.swap(filtered_nodes);
 	}
-	return cur_token;
 }
 
-void XPathEvaluator_Impl::evaluate_location_step(const XPathNodeSet &context, XPathNodeSet::size_type context_node_index, const std::vector<XPathLocationStep> &steps, std::vector<XPathLocationStep>::size_type step_index, const std::string &expression, XPathNodeSet &nodes) const
-{
-	if (step_index < steps.size())
-	{
-		if (steps[step_index].axis == "ancestor")
-			select_nodes_ancestor(context, context_node_index, steps, step_index, expression, nodes);
-		else if (steps[step_index].axis == "ancestor-or-self")
-			select_nodes_ancestor_or_self(context, context_node_index, steps, step_index, expression, nodes);
-		else if (steps[step_index].axis == "attribute")
-			select_nodes_attribute(context, context_node_index, steps, step_index, expression, nodes);
-		else if (steps[step_index].axis == "child")
-			select_nodes_child(context, context_node_index, steps, step_index, expression, nodes);
-		else if (steps[step_index].axis == "descendant")
-			select_nodes_descendant(context, context_node_index, steps, step_index, expression, nodes);
-		else if (steps[step_index].axis == "descendant-or-self")
-			select_nodes_descendant_or_self(context, context_node_index, steps, step_index, expression, nodes);
-		else if (steps[step_index].axis == "following")
-			select_nodes_following(context, context_node_index, steps, step_index, expression, nodes);
-		else if (steps[step_index].axis == "follwing-sibling")
-			select_nodes_following_sibling(context, context_node_index, steps, step_index, expression, nodes);
-		else if (steps[step_index].axis == "namespace")
-			select_nodes_namespace(context, context_node_index, steps, step_index, expression, nodes);
-		else if (steps[step_index].axis == "parent")
-			select_nodes_parent(context, context_node_index, steps, step_index, expression, nodes);
-		else if (steps[step_index].axis == "preceding")
-			select_nodes_preceding(context, context_node_index, steps, step_index, expression, nodes);
-		else if (steps[step_index].axis == "preceding-sibling")
-			select_nodes_preceding_sibling(context, context_node_index, steps, step_index, expression, nodes);
-		else if (steps[step_index].axis == "self")
-			select_nodes_self(context, context_node_index, steps, step_index, expression, nodes);
-		else
-			throw XPathException(string_format("Unknown location step axis", steps[step_index].axis), expression);
+bool XPathEvaluator_Impl::confirm_predicate(const XPathExpressionNode &predicate, const XPathNodeSet &context, XPathNodeSet::size_type context_node_index) const
+{
+	XPathObject result = evaluate(predicate, context, context_node_index);
+	bool include_in_nodeset = false;
+	switch (result.get_type())
+	{
+	case XPathObject::type_null:
+		break;
+	case XPathObject::type_node_set:
+		include_in_nodeset = !result.get_node_set().empty();
+		break;
+	case XPathObject::type_boolean:
+		include_in_nodeset = result.get_boolean();
+		break;
+	case XPathObject::type_number:
+		include_in_nodeset = result.get_number() == context_node_index+1;
+		break;
+	case XPathObject::type_string:
+		include_in_nodeset = !result.get_string().empty();
+		break;
 	}
-	else
+	return include_in_nodeset;
+}
+
+void XPathEvaluator_Impl::select_nodes(const DomNode &context_node, const XPathLocationStep &step, XPathNodeSet &nodes) const
+{
+	switch (step.axis)
 	{
-		nodes.push_back(context[context_node_index]);
+	case XPathLocationStep::axis_ancestor:
+		select_nodes_ancestor(context_node, step, nodes);
+		break;
+	case XPathLocationStep::axis_ancestor_or_self:
+		select_nodes_ancestor_or_self(context_node, step, nodes);
+		break;
+	case XPathLocationStep::axis_attribute:
+		select_nodes_attribute(context_node, step, nodes);
+		break;
+	case XPathLocationStep::axis_child:
+		select_nodes_child(context_node, step, nodes);
+		break;
+	case XPathLocationStep::axis_descendant:
+		select_nodes_descendant(context_node, step, nodes);
+		break;
+	case XPathLocationStep::axis_descendant_or_self:
+		select_nodes_descendant_or_self(context_node, step, nodes);
+		break;
+	case XPathLocationStep::axis_following:
+		select_nodes_following(context_node, step, nodes);
+		break;
+	case XPathLocationStep::axis_following_sibling:
+		select_nodes_following_sibling(context_node, step, nodes);
+		break;
+	case XPathLocationStep::axis_namespace:
+		select_nodes_namespace(context_node, step, nodes);
+		break;
+	case XPathLocationStep::axis_parent:
+		select_nodes_parent(context_node, step, nodes);
+		break;
+	case XPathLocationStep::axis_preceding:
+		select_nodes_preceding(context_node, step, nodes);
+		break;
+	case XPathLocationStep::axis_preceding_sibling:
+		select_nodes_preceding_sibling(context_node, step, nodes);
+		break;
+	case XPathLocationStep::axis_self:
+		select_nodes_self(context_node, step, nodes);
+		break;
 	}
 }
 
-void XPathEvaluator_Impl::select_nodes_ancestor(const XPathNodeSet &context, XPathNodeSet::size_type context_node_index, const std::vector<XPathLocationStep> &steps, std::vector<XPathLocationStep>::size_type step_index, const std::string &expression, XPathNodeSet &nodes) const
+void XPathEvaluator_Impl::select_nodes_ancestor(const DomNode &context_node, const XPathLocationStep &step, XPathNodeSet &nodes) const
 {
-	XPathNodeSet nodeset;
-	DomNode parent = context[context_node_index].get_parent_node();
+	DomNode parent = context_node.get_parent_node();
 	while (!parent.is_null())
 	{
-		if (confirm_step_requirements(parent, steps[step_index], expression))
-			nodeset.push_back(parent);
+		if (confirm_step_requirements(parent, step))
+			nodes.push_back(parent);
 
 		parent = parent.get_parent_node();
 	}
-
-	evaluate_location_step_predicates(nodeset, steps, step_index, expression, nodes);
 }
 
-void XPathEvaluator_Impl::select_nodes_ancestor_or_self(const XPathNodeSet &context, XPathNodeSet::size_type context_node_index, const std::vector<XPathLocationStep> &steps, std::vector<XPathLocationStep>::size_type step_index, const std::string &expression, XPathNodeSet &nodes) const
+void XPathEvaluator_Impl::select_nodes_ancestor_or_self(const DomNode &context_node, const XPathLocationStep &step, XPathNodeSet &nodes) const
 {
-	XPathNodeSet nodeset;
-	DomNode parent = context[context_node_index];
+	DomNode parent = context_node;
 	while (!parent.is_null())
 	{
-		if (confirm_step_requirements(parent, steps[step_index], expression))
-			nodeset.push_back(parent);
+		if (confirm_step_requirements(parent, step))
+			nodes.push_back(parent);
 
 		parent = parent.get_parent_node();
 	}
-
-	evaluate_location_step_predicates(nodeset, steps, step_index, expression, nodes);
 }
 
-void XPathEvaluator_Impl::select_nodes_attribute(const XPathNodeSet &context, XPathNodeSet::size_type context_node_index, const std::vector<XPathLocationStep> &steps, std::vector<XPathLocationStep>::size_type step_index, const std::string &expression, XPathNodeSet &nodes) const
+void XPathEvaluator_Impl::select_nodes_attribute(const DomNode &context_node, const XPathLocationStep &step, XPathNodeSet &nodes) const
 {
-	XPathNodeSet nodeset;
-	DomNamedNodeMap attributes = context[context_node_index].get_attributes();
+	DomNamedNodeMap attributes = context_node.get_attributes();
 	unsigned long num_attributes = attributes.get_length();
 	for (unsigned long idx = 0; idx < num_attributes; idx++)
 	{
 		const DomNode &node = attributes.item(idx);
-		if (confirm_step_requirements(node, steps[step_index], expression))
-			nodeset.push_back(node);
+		if (confirm_step_requirements(node, step))
+			nodes.push_back(node);
 	}
-
-	evaluate_location_step_predicates(nodeset, steps, step_index, expression, nodes);
 }
 
-void XPathEvaluator_Impl::select_nodes_child(const XPathNodeSet &context, XPathNodeSet::size_type context_node_index, const std::vector<XPathLocationStep> &steps, std::vector<XPathLocationStep>::size_type step_index, const std::string &expression, XPathNodeSet &nodes) const
+void XPathEvaluator_Impl::select_nodes_child(const DomNode &context_node, const XPathLocationStep &step, XPathNodeSet &nodes) const
 {
-	XPathNodeSet nodeset;
-	DomNode cur_node = context[context_node_index].get_first_child();
+	if (select_indexed_elements(context_node, step, false, nodes))
+		return;
+
+	DomNode cur_node = context_node.get_first_child();
 	while (!cur_node.is_null())
 	{
-		if (confirm_step_requirements(cur_node, steps[step_index], expression))
-			nodeset.push_back(cur_node);
+		if (confirm_step_requirements(cur_node, step))
+			nodes.push_back(cur_node);
 		cur_node = cur_node.get_next_sibling();
 	}
-
-	evaluate_location_step_predicates(nodeset, steps, step_index, expression, nodes);
 }
 
-void XPathEvaluator_Impl::select_nodes_descendant(const XPathNodeSet &context, XPathNodeSet::size_type context_node_index, const std::vector<XPathLocationStep> &steps, std::vector<XPathLocationStep>::size_type step_index, const std::string &expression, XPathNodeSet &nodes) const
+void XPathEvaluator_Impl::select_nodes_descendant(const DomNode &context_node, const XPathLocationStep &step, XPathNodeSet &nodes) const
 {
+	if (select_indexed_elements(context_node, step, true, nodes))
+		return;
+
 	XPathNodeSet parentNodes;
-	XPathNodeSet nodeset;
 
-	DomNode cur_node = context[context_node_index].get_first_child();
+	DomNode cur_node = context_node.get_first_child();
 	while (!cur_node.is_null())
 	{
-		if (confirm_step_requirements(cur_node, steps[step_index], expression))
-			nodeset.push_back(cur_node);
+		if (confirm_step_requirements(cur_node, step))
+			nodes.push_back(cur_node);
 
 		parentNodes.push_back(cur_node);
 		cur_node = cur_node.get_first_child();
@@ -1212,42 +1264,23 @@ void XPathEvaluator_Impl::select_nodes_descendant(const XPathNodeSet &context, X
 			cur_node = cur_node.get_next_sibling();
 		}
 	}
-
-	evaluate_location_step_predicates(nodeset, steps, step_index, expression, nodes);
 }
 
-void XPathEvaluator_Impl::select_nodes_descendant_or_self(const XPathNodeSet &context, XPathNodeSet::size_type context_node_index, const std::vector<XPathLocationStep> &steps, std::vector<XPathLocationStep>::size_type step_index, const std::string &expression, XPathNodeSet &nodes) const
+void XPathEvaluator_Impl::select_nodes_descendant_or_self(const DomNode &context_node, const XPathLocationStep &step, XPathNodeSet &nodes) const
 {
-	XPathNodeSet parentNodes;
-	XPathNodeSet nodeset;
+	if (context_node.is_null())
+		return;
 
-	DomNode cur_node = context[context_node_index];
-	while (!cur_node.is_null())
-	{
-		if (confirm_step_requirements(cur_node, steps[step_index], expression))
-			nodeset.push_back(cur_node);
+	if (confirm_step_requirements(context_node, step))
+		nodes.push_back(context_node);
 
-		parentNodes.push_back(cur_node);
-		cur_node = cur_node.get_first_child();
-		while (cur_node.is_null())
-		{
-			if (parentNodes.empty())
-				break;
-			cur_node = parentNodes.back();
-			parentNodes.pop_back();
-			cur_node = cur_node.get_next_sibling();
-		}
-	}
-
-	evaluate_location_step_predicates(nodeset, steps, step_index, expression, nodes);
+	select_nodes_descendant(context_node, step, nodes);
 }
 
-void XPathEvaluator_Impl::select_nodes_following(const XPathNodeSet &context, XPathNodeSet::size_type context_node_index, const std::vector<XPathLocationStep> &steps, std::vector<XPathLocationStep>::size_type step_index, const std::string &expression, XPathNodeSet &nodes) const
+void XPathEvaluator_Impl::select_nodes_following(const DomNode &context_node, const XPathLocationStep &step, XPathNodeSet &nodes) const
 {
-	XPathNodeSet nodeset;
-
 	DomNode cur_node;
-	DomNode next_node = context[context_node_index];
+	DomNode next_node = context_node;
 	while (!next_node.is_null())
 	{
 		cur_node = next_node;
@@ -1259,62 +1292,52 @@ void XPathEvaluator_Impl::select_nodes_following(const XPathNodeSet &context, XP
 		else
 		{
 			cur_node = next_node;
-			if (confirm_step_requirements(cur_node, steps[step_index], expression))
-				nodeset.push_back(cur_node);
+			if (confirm_step_requirements(cur_node, step))
+				nodes.push_back(cur_node);
 
 			next_node = cur_node.get_first_child();
 			while (!next_node.is_null())
 			{
 				cur_node = next_node;
-				if (confirm_step_requirements(cur_node, steps[step_index], expression))
-					nodeset.push_back(cur_node);
+				if (confirm_step_requirements(cur_node, step))
+					nodes.push_back(cur_node);
 
 				next_node = cur_node.get_first_child();
 			}
 			next_node = cur_node.get_parent_node();
 		}
 	}
-
-	evaluate_location_step_predicates(nodeset, steps, step_index, expression, nodes);
 }
 
-void XPathEvaluator_Impl::select_nodes_following_sibling(const XPathNodeSet &context, XPathNodeSet::size_type context_node_index, const std::vector<XPathLocationStep> &steps, std::vector<XPathLocationStep>::size_type step_index, const std::string &expression, XPathNodeSet &nodes) const
+void XPathEvaluator_Impl::select_nodes_following_sibling(const DomNode &context_node, const XPathLocationStep &step, XPathNodeSet &nodes) const
 {
-	XPathNodeSet nodeset;
-	DomNode cur_node = context[context_node_index].get_next_sibling();
+	DomNode cur_node = context_node.get_next_sibling();
 	while (!cur_node.is_null())
 	{
-		if (confirm_step_requirements(cur_node, steps[step_index], expression))
-			nodeset.push_back(cur_node);
+		if (confirm_step_requirements(cur_node, step))
+			nodes.push_back(cur_node);
 		cur_node = cur_node.get_next_sibling();
 	}
-
-	evaluate_location_step_predicates(nodeset, steps, step_index, expression, nodes);
 }
 
-void XPathEvaluator_Impl::select_nodes_namespace(const XPathNodeSet &context, XPathNodeSet::size_type context_node_index, const std::vector<XPathLocationStep> &steps, std::vector<XPathLocationStep>::size_type step_index, const std::string &expression, XPathNodeSet &nodes) const
+void XPathEvaluator_Impl::select_nodes_namespace(const DomNode &context_node, const XPathLocationStep &step, XPathNodeSet &nodes) const
 {
 }
 
-void XPathEvaluator_Impl::select_nodes_parent(const XPathNodeSet &context, XPathNodeSet::size_type context_node_index, const std::vector<XPathLocationStep> &steps, std::vector<XPathLocationStep>::size_type step_index, const std::string &expression, XPathNodeSet &nodes) const
+void XPathEvaluator_Impl::select_nodes_parent(const DomNode &context_node, const XPathLocationStep &step, XPathNodeSet &nodes) const
 {
-	XPathNodeSet nodeset;
-	DomNode parent = context[context_node_index].get_parent_node();
+	DomNode parent = context_node.get_parent_node();
 	if (!parent.is_null())
 	{
-		if (confirm_step_requirements(parent, steps[step_index], expression))
-			nodeset.push_back(parent);
+		if (confirm_step_requirements(parent, step))
+			nodes.push_back(parent);
 	}
-
-	evaluate_location_step_predicates(nodeset, steps, step_index, expression, nodes);
 }
 
-void XPathEvaluator_Impl::select_nodes_preceding(const XPathNodeSet &context, XPathNodeSet::size_type context_node_index, const std::vector<XPathLocationStep> &steps, std::vector<XPathLocationStep>::size_type step_index, const std::string &expression, XPathNodeSet &nodes) const
+void XPathEvaluator_Impl::select_nodes_preceding(const DomNode &context_node, const XPathLocationStep &step, XPathNodeSet &nodes) const
 {
-	XPathNodeSet nodeset;
-
 	DomNode cur_node;
-	DomNode next_node = context[context_node_index];
+	DomNode next_node = context_node;
 	while (!next_node.is_null())
 	{
 		cur_node = next_node;
@@ -1326,50 +1349,73 @@ void XPathEvaluator_Impl::select_nodes_preceding(const XPathNodeSet &context, XP
 		else
 		{
 			cur_node = next_node;
-			if (confirm_step_requirements(cur_node, steps[step_index], expression))
-				nodeset.push_back(cur_node);
+			if (confirm_step_requirements(cur_node, step))
+				nodes.push_back(cur_node);
 
 			next_node = cur_node.get_last_child();
 			while (!next_node.is_null())
 			{
 				cur_node = next_node;
-				if (confirm_step_requirements(cur_node, steps[step_index], expression))
-					nodeset.push_back(cur_node);
+				if (confirm_step_requirements(cur_node, step))
+					nodes.push_back(cur_node);
 
 				next_node = cur_node.get_last_child();
 			}
 			next_node = cur_node.get_parent_node();
 		}
 	}
-
-	evaluate_location_step_predicates(nodeset, steps, step_index, expression, nodes);
 }
 
-void XPathEvaluator_Impl::select_nodes_preceding_sibling(const XPathNodeSet &context, XPathNodeSet::size_type context_node_index, const std::vector<XPathLocationStep> &steps, std::vector<XPathLocationStep>::size_type step_index, const std::string &expression, XPathNodeSet &nodes) const
+void XPathEvaluator_Impl::select_nodes_preceding_sibling(const DomNode &context_node, const XPathLocationStep &step, XPathNodeSet &nodes) const
 {
-	XPathNodeSet nodeset;
-	DomNode cur_node = context[context_node_index].get_previous_sibling();
+	DomNode cur_node = context_node.get_previous_sibling();
 	while (!cur_node.is_null())
 	{
-		if (confirm_step_requirements(cur_node, steps[step_index], expression))
-			nodeset.push_back(cur_node);
+		if (confirm_step_requirements(cur_node, step))
+			nodes.push_back(cur_node);
 		cur_node = cur_node.get_previous_sibling();
 	}
+}
 
-	evaluate_location_step_predicates(nodeset, steps, step_index, expression, nodes);
+void XPathEvaluator_Impl::select_nodes_self(const DomNode &context_node, const XPathLocationStep &step, XPathNodeSet &nodes) const
+{
+	if (!context_node.is_null())
+	{
+		if (confirm_step_requirements(context_node, step))
+			nodes.push_back(context_node);
+	}
 }
 
-void XPathEvaluator_Impl::select_nodes_self(const XPathNodeSet &context, XPathNodeSet::size_type context_node_index, const std::vector<XPathLocationStep> &steps, std::vector<XPathLocationStep>::size_type step_index, const std::string &expression, XPathNodeSet &nodes) const
+bool XPathEvaluator_Impl::select_indexed_elements(const DomNode &context_node, const XPathLocationStep &step, bool descendants, XPathNodeSet &nodes) const
 {
-	DomNode cur_node = context[context_node_index];
-	if (!cur_node.is_null())
+	// Only element names are indexed. Other tests and nodes outside the document tree walk the tree instead.
+	if (step.test_type != XPathLocationStep::type_name || step.test_str == "*" || !context_node.impl)
+		return false;
+
+	DomDocument_Impl *doc_impl = (DomDocument_Impl *) context_node.impl->owner_document.lock().get();
+	if (doc_impl == 0)
+		return false;
+
+	std::vector<unsigned int> node_indices;
+	bool indexed;
+	if (descendants)
+		indexed = doc_impl->find_descendant_elements(context_node.impl->node_index, step.test_str, node_indices);
+	else
+		indexed = doc_impl->find_child_elements(context_node.impl->node_index, step.test_str, node_indices);
+	if (!indexed)
+		return false;
+
+	nodes.reserve(nodes.size() + node_indices.size());
+	for (std::vector<unsigned int>::size_type i = 0; i < node_indices.size(); i++)
 	{
-		if (confirm_step_requirements(cur_node, steps[step_index], expression))
-			evaluate_location_step_predicates(XPathNodeSet(1, cur_node), steps, step_index, expression, nodes);
+		DomNode_Impl *dom_node = doc_impl->allocate_dom_node();
+		dom_node->node_index = node_indices[i];
+		nodes.push_back(DomNode(std::shared_ptr<DomNode_Impl>(dom_node, DomDocument_Impl::NodeDeleter(doc_impl))));
 	}
+	return true;
 }
 
-bool XPathEvaluator_Impl::confirm_step_requirements(const DomNode &node, const XPathLocationStep &step, const std::string &expression) const
+bool XPathEvaluator_Impl::confirm_step_requirements(const DomNode &node, const XPathLocationStep &step) const
 {
 	bool test_passed = false;
 	switch (step.test_type)
@@ -1408,48 +1454,6 @@ bool XPathEvaluator_Impl::confirm_step_requirements(const DomNode &node, const X
 	return test_passed;
 }
 
-bool XPathEvaluator_Impl::confirm_step_predicate(XPathNodeSet &context, XPathNodeSet::size_type context_node_index, const XPathLocationStep::Predicate &predicate, const std::string &expression) const
-{
-	XPathEvaluateResult result = evaluate(expression.substr(predicate.pos, predicate.length), context, context_node_index, XPathToken());
-	bool include_in_nodeset = false;
-	switch (result.result.get_type())
-	{
-	case XPathObject::type_null:
-		break;
-	case XPathObject::type_node_set:
-		include_in_nodeset = !result.result.get_node_set().empty();
-		break;
-	case XPathObject::type_boolean:
-		include_in_nodeset = result.result.get_boolean();
-		break;
-	case XPathObject::type_number:
-		include_in_nodeset = result.result.get_number() == context_node_index+1;
-		break;
-	case XPathObject::type_string:
-		include_in_nodeset = !result.result.get_string().empty();
-		break;
-	}
-	return include_in_nodeset;
-}
-
-void XPathEvaluator_Impl::evaluate_location_step_predicates(const XPathNodeSet &context, const std::vector<XPathLocationStep> &steps, std::vector<XPathLocationStep>::size_type step_index, const std::string &expression, XPathNodeSet &nodes) const
-{
-	XPathNodeSet nodeset = context;
-	for (std::vector<XPathLocationStep::Predicate>::const_iterator pit = steps[step_index].predicates.begin(), pEnd = steps[step_index].predicates.end(); pit != pEnd; ++pit)
-	{
-		XPathNodeSet filtered_nodes;
-		for (XPathNodeSet::size_type node_index = 0, num_nodes = nodeset.size(); node_index < num_nodes; node_index++)
-		{
-			if (confirm_step_predicate(nodeset, node_index, *pit, expression))
-				filtered_nodes.push_back(nodeset[node_index]);
-		}
-		nodeset = filtered_nodes;
-	}
-
-	for (XPathNodeSet::size_type node_index = 0, num_nodes = nodeset.size(); node_index < num_nodes; node_index++)
-		evaluate_location_step(nodeset, node_index, steps, step_index+1, expression, nodes);
-}
-
 XPathToken XPathEvaluator_Impl::read_token(
 	const std::string &expression,
 	const XPathToken &previous_token) const
@@ -2723,10 +2727,10 @@ inline XPathObject XPathEvaluator_Impl::string(const XPathObject &object)
 
 std::string XPathEvaluator_Impl::string(const DomNode &node)
 {
-	std::string s = node.get_node_value();
 	if (node.is_element())
-		s = node.to_element().get_text();
-	return s;
+		return node.to_element().get_text();
+	else
+		return node.get_node_value();
 }
 
 }
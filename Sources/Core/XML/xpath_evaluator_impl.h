@@ -36,10 +36,12 @@
 namespace clan
 {
 
-class XPathEvaluateResult
+class XPathExpressionNode;
+
+class XPathCompileResult
 {
 public:
-	XPathObject result;
+	std::shared_ptr<XPathExpressionNode> node;
 	XPathToken next_token;
 };
 
@@ -47,82 +49,108 @@ class XPathEvaluator_Impl
 {
 public:
 	typedef std::vector<DomNode> XPathNodeSet;
+	typedef XPathObject (XPathEvaluator_Impl::*Function)(const XPathNodeSet &context, XPathNodeSet::size_type context_node_index, const std::vector<XPathObject> &parameters) const;
 
 public:
-	XPathEvaluateResult evaluate(
-		const std::string &expression,
+	/// \brief Parses an expression into a tree of expression nodes
+	std::shared_ptr<XPathExpressionNode> compile(const std::string &expression) const;
+
+	/// \brief Evaluates a compiled expression
+	XPathObject evaluate(
+		const XPathExpressionNode &node,
 		const XPathNodeSet &context,
-		XPathNodeSet::size_type context_node_index,
-		XPathToken prev_token) const;
+		XPathNodeSet::size_type context_node_index) const;
 
 private:
 	typedef XPathToken::Operator Operator;
-	typedef XPathObject Operand;
+	typedef std::shared_ptr<XPathExpressionNode> Operand;
 	enum ErrorType
 	{
 		syntax_error,
 		expression_error
 	};
 
+	XPathCompileResult compile(
+		const std::string &expression,
+		XPathToken prev_token) const;
+
 	bool do_npr(
 		std::vector<Operator> &operator_stack,
 		std::vector<Operand> &operand_stack) const;
 
+	XPathObject evaluate_operator(const XPathExpressionNode &node, const XPathNodeSet &context, XPathNodeSet::size_type context_node_index) const;
+	XPathObject evaluate_location_path(const XPathExpressionNode &node, const XPathNodeSet &context, XPathNodeSet::size_type context_node_index) const;
+	XPathObject evaluate_filter(const XPathExpressionNode &node, const XPathNodeSet &context, XPathNodeSet::size_type context_node_index) const;
+
 	template<typename T>
 	bool compare(const T &a, const T &b, Operator oper) const;
-	bool compare_operands(const Operand &a, const Operand &b, Operator oper) const;
-	bool compare_node_set(const Operand &a, const Operand &b, Operator oper) const;
-	bool compare_boolean(const Operand &a, const Operand &b, Operator oper) const;
-	bool compare_number(const Operand &a, const Operand &b, Operator oper) const;
-	bool compare_string(const Operand &a, const Operand &b, Operator oper) const;
+	bool compare_operands(const XPathObject &a, const XPathObject &b, Operator oper) const;
+	bool compare_node_set(const XPathObject &a, const XPathObject &b, Operator oper) const;
+	bool compare_boolean(const XPathObject &a, const XPathObject &b, Operator oper) const;
+	bool compare_number(const XPathObject &a, const XPathObject &b, Operator oper) const;
+	bool compare_string(const XPathObject &a, const XPathObject &b, Operator oper) const;
 
 	XPathToken read_location_path(
 		const std::string &expression,
 		XPathToken cur_token,
-		const XPathNodeSet &context,
-		XPathNodeSet::size_type context_node_index,
 		std::vector<Operand> &operand_stack) const;
 
 	XPathToken read_location_steps(
 		const std::string &expression,
 		XPathToken cur_token,
-		const XPathNodeSet &context,
-		XPathNodeSet::size_type context_node_index,
-		std::vector<XPathEvaluator_Impl::Operand> &operand_stack) const;
+		std::vector<XPathLocationStep> &steps) const;
 
 	XPathToken read_location_step(
 		const std::string &expression,
 		XPathToken cur_token,
 		XPathLocationStep &step) const;
 
-	XPathToken read_token(
+	XPathToken read_filter(
 		const std::string &expression,
-		const XPathToken &previous_token = XPathToken()) const;
+		XPathToken cur_token,
+		XPathExpressionNode &filter) const;
+
+	XPathToken read_filter_steps(
+		const std::string &expression,
+		XPathToken cur_token,
+		XPathExpressionNode &filter) const;
 
-	XPathToken skip_predicate_expression(
+	XPathToken read_predicate(
+		const std::string &expression,
+		const XPathToken &bracket_token,
+		std::vector<Operand> &predicates) const;
+
+	XPathToken read_token(
 		const std::string &expression,
 		const XPathToken &previous_token = XPathToken()) const;
 
-	void evaluate_location_step(const XPathNodeSet &context, XPathNodeSet::size_type context_node_index, const std::vector<XPathLocationStep> &steps, std::vector<XPathLocationStep>::size_type step_index, const std::string &expression, XPathNodeSet &out_nodeset) const;
-	void evaluate_location_step_predicates(const XPathNodeSet &context, const std::vector<XPathLocationStep> &steps, std::vector<XPathLocationStep>::size_type step_index, const std::string & expression, XPathNodeSet & nodes) const;
-
-	void select_nodes_ancestor(const XPathNodeSet &context, XPathNodeSet::size_type context_node_index, const std::vector<XPathLocationStep> &steps, std::vector<XPathLocationStep>::size_type step_index, const std::string &expression, XPathNodeSet &out_nodeset) const;
-	void select_nodes_ancestor_or_self(const XPathNodeSet &context, XPathNodeSet::size_type context_node_index, const std::vector<XPathLocationStep> &steps, std::vector<XPathLocationStep>::size_type step_index, const std::string &expression, XPathNodeSet &out_nodeset) const;
-	void select_nodes_attribute(const XPathNodeSet &context, XPathNodeSet::size_type context_node_index, const std::vector<XPathLocationStep> &steps, std::vector<XPathLocationStep>::size_type step_index, const std::string &expression, XPathNodeSet &out_nodeset) const;
-	void select_nodes_child(const XPathNodeSet &context, XPathNodeSet::size_type context_node_index, const std::vector<XPathLocationStep> &steps, std::vector<XPathLocationStep>::size_type step_index, const std::string &expression, XPathNodeSet &out_nodeset) const;
-	void select_nodes_descendant(const XPathNodeSet &context, XPathNodeSet::size_type context_node_index, const std::vector<XPathLocationStep> &steps, std::vector<XPathLocationStep>::size_type step_index, const std::string &expression, XPathNodeSet &out_nodeset) const;
-	void select_nodes_descendant_or_self(const XPathNodeSet &context, XPathNodeSet::size_type context_node_index, const std::vector<XPathLocationStep> &steps, std::vector<XPathLocationStep>::size_type step_index, const std::string &expression, XPathNodeSet &out_nodeset) const;
-	void select_nodes_following(const XPathNodeSet &context, XPathNodeSet::size_type context_node_index, const std::vector<XPathLocationStep> &steps, std::vector<XPathLocationStep>::size_type step_index, const std::string &expression, XPathNodeSet &out_nodeset) const;
-	void select_nodes_following_sibling(const XPathNodeSet &context, XPathNodeSet::size_type context_node_index, const std::vector<XPathLocationStep> &steps, std::vector<XPathLocationStep>::size_type step_index, const std::string &expression, XPathNodeSet &out_nodeset) const;
-	void select_nodes_namespace(const XPathNodeSet &context, XPathNodeSet::size_type context_node_index, const std::vector<XPathLocationStep> &steps, std::vector<XPathLocationStep>::size_type step_index, const std::string &expression, XPathNodeSet &out_nodeset) const;
-	void select_nodes_parent(const XPathNodeSet &context, XPathNodeSet::size_type context_node_index, const std::vector<XPathLocationStep> &steps, std::vector<XPathLocationStep>::size_type step_index, const std::string &expression, XPathNodeSet &out_nodeset) const;
-	void select_nodes_preceding(const XPathNodeSet &context, XPathNodeSet::size_type context_node_index, const std::vector<XPathLocationStep> &steps, std::vector<XPathLocationStep>::size_type step_index, const std::string &expression, XPathNodeSet &out_nodeset) const;
-	void select_nodes_preceding_sibling(const XPathNodeSet &context, XPathNodeSet::size_type context_node_index, const std::vector<XPathLocationStep> &steps, std::vector<XPathLocationStep>::size_type step_index, const std::string &expression, XPathNodeSet &out_nodeset) const;
-	void select_nodes_self(const XPathNodeSet &context, XPathNodeSet::size_type context_node_index, const std::vector<XPathLocationStep> &steps, std::vector<XPathLocationStep>::size_type step_index, const std::string &expression, XPathNodeSet &out_nodeset) const;
-	bool confirm_step_requirements(const DomNode &node, const XPathLocationStep &step, const std::string &expression) const;
-	bool confirm_step_predicate(XPathNodeSet &context, XPathNodeSet::size_type context_node_index, const XPathLocationStep::Predicate &predicate, const std::string &expression) const;
-
-	XPathObject call_function(const XPathNodeSet& context, XPathNodeSet::size_type context_node_index, const std::string &name, const std::vector<XPathObject> &parameters) const;
+	static bool is_operator(const XPathToken &token, Operator oper);
+	static bool is_step_token(const XPathToken &token);
+	static bool is_descendant_or_self_node_step(const XPathLocationStep &step);
+	static bool find_axis(const std::string &name, XPathLocationStep::Axis &out_axis);
+	static Function find_function(const std::string &name);
+
+	void evaluate_location_steps(const XPathNodeSet &context, const std::vector<XPathLocationStep> &steps, XPathNodeSet &out_nodeset) const;
+	void evaluate_predicates(const std::vector<Operand> &predicates, XPathNodeSet &nodes) const;
+	bool confirm_predicate(const XPathExpressionNode &predicate, const XPathNodeSet &context, XPathNodeSet::size_type context_node_index) const;
+
+	void select_nodes(const DomNode &context_node, const XPathLocationStep &step, XPathNodeSet &out_nodeset) const;
+	void select_nodes_ancestor(const DomNode &context_node, const XPathLocationStep &step, XPathNodeSet &out_nodeset) const;
+	void select_nodes_ancestor_or_self(const DomNode &context_node, const XPathLocationStep &step, XPathNodeSet &out_nodeset) const;
+	void select_nodes_attribute(const DomNode &context_node, const XPathLocationStep &step, XPathNodeSet &out_nodeset) const;
+	void select_nodes_child(const DomNode &context_node, const XPathLocationStep &step, XPathNodeSet &out_nodeset) const;
+	void select_nodes_descendant(const DomNode &context_node, const XPathLocationStep &step, XPathNodeSet &out_nodeset) const;
+	void select_nodes_descendant_or_self(const DomNode &context_node, const XPathLocationStep &step, XPathNodeSet &out_nodeset) const;
+	void select_nodes_following(const DomNode &context_node, const XPathLocationStep &step, XPathNodeSet &out_nodeset) const;
+	void select_nodes_following_sibling(const DomNode &context_node, const XPathLocationStep &step, XPathNodeSet &out_nodeset) const;
+	void select_nodes_namespace(const DomNode &context_node, const XPathLocationStep &step, XPathNodeSet &out_nodeset) const;
+	void select_nodes_parent(const DomNode &context_node, const XPathLocationStep &step, XPathNodeSet &out_nodeset) const;
+	void select_nodes_preceding(const DomNode &context_node, const XPathLocationStep &step, XPathNodeSet &out_nodeset) const;
+	void select_nodes_preceding_sibling(const DomNode &context_node, const XPathLocationStep &step, XPathNodeSet &out_nodeset) const;
+	void select_nodes_self(const DomNode &context_node, const XPathLocationStep &step, XPathNodeSet &out_nodeset) const;
+	bool select_indexed_elements(const DomNode &context_node, const XPathLocationStep &step, bool descendants, XPathNodeSet &out_nodeset) const;
+	bool confirm_step_requirements(const DomNode &node, const XPathLocationStep &step) const;
+
 	XPathObject get_variable(const std::string &name) const;
 
 	XPathObject function_last(const XPathNodeSet& context, XPathNodeSet::size_type context_node_index, const std::vector<XPathObject> &parameters) const;
@@ -0,0 +1,132 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Magnus Norddahl
+*/
+
+#include "Core/precomp.h"
+#include "API/Core/XML/xpath_expression.h"
+#include "API/Core/XML/xpath_exception.h"
+#include "API/Core/XML/dom_node.h"
+#include "xpath_expression_impl.h"
+#include "xpath_expression_node.h"
+#include "xpath_evaluator_impl.h"
+
+namespace clan
+{
+
+/////////////////////////////////////////////////////////////////////////////
+// XPathExpression_Impl Operations:
+
+Mutex XPathExpression_Impl::cache_mutex;
+XPathExpression_Impl::CacheList XPathExpression_Impl::cache;
+std::unordered_map<std::string, XPathExpression_Impl::CacheList::iterator> XPathExpression_Impl::cache_index;
+
+std::shared_ptr<XPathExpression_Impl> XPathExpression_Impl::compile(const std::string &expression)
+{
+	std::shared_ptr<XPathExpression_Impl> impl(new XPathExpression_Impl);
+	impl->expression = expression;
+	impl->root = XPathEvaluator_Impl().compile(expression);
+	return impl;
+}
+
+std::shared_ptr<XPathExpression_Impl> XPathExpression_Impl::compile_cached(const std::string &expression)
+{
+	{
+		MutexSection mutex_lock(&cache_mutex);
+		std::unordered_map<std::string, CacheList::iterator>::iterator it = cache_index.find(expression);
+		if (it != cache_index.end())
+		{
+			cache.splice(cache.begin(), cache, it->second);
+			return *it->second;
+		}
+	}
+
+	// Compile outside the lock. Invalid expressions throw and are not cached.
+	std::shared_ptr<XPathExpression_Impl> impl = compile(expression);
+
+	MutexSection mutex_lock(&cache_mutex);
+	std::unordered_map<std::string, CacheList::iterator>::iterator it = cache_index.find(expression);
+	if (it != cache_index.end())
+	{
+		cache.splice(cache.begin(), cache, it->second);
+		return *it->second;
+	}
+
+	cache.push_front(impl);
+	cache_index[expression] = cache.begin();
+	if (cache.size() > max_cache_size)
+	{
+		cache_index.erase(cache.back()->expression);
+		cache.pop_back();
+	}
+	return impl;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// XPathExpression Construction:
+
+XPathExpression::XPathExpression()
+{
+}
+
+XPathExpression::XPathExpression(const std::string &expression)
+: impl(XPathExpression_Impl::compile(expression))
+{
+}
+
+XPathExpression::XPathExpression(const std::shared_ptr<XPathExpression_Impl> &impl)
+: impl(impl)
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// XPathExpression Attributes:
+
+void XPathExpression::throw_if_null() const
+{
+	if (!impl)
+		throw Exception("XPathExpression is null");
+}
+
+std::string XPathExpression::get_expression() const
+{
+	if (impl)
+		return impl->expression;
+	else
+		return std::string();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// XPathExpression Operations:
+
+XPathObject XPathExpression::evaluate(const DomNode &context_node) const
+{
+	throw_if_null();
+	std::vector<DomNode> nodelist(1, context_node);
+	return XPathEvaluator_Impl().evaluate(*impl->root, nodelist, 0);
+}
+
+}
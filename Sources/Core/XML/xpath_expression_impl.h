@@ -0,0 +1,67 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Magnus Norddahl
+*/
+
+#pragma once
+
+#include "API/Core/System/mutex.h"
+#include <list>
+#include <memory>
+#include <unordered_map>
+
+namespace clan
+{
+
+class XPathExpressionNode;
+
+class XPathExpression_Impl
+{
+public:
+	std::string expression;
+
+	std::shared_ptr<XPathExpressionNode> root;
+
+	/// \brief Compiles an expression
+	static std::shared_ptr<XPathExpression_Impl> compile(const std::string &expression);
+
+	/// \brief Returns a compiled expression, keeping the most recently used ones cached
+	static std::shared_ptr<XPathExpression_Impl> compile_cached(const std::string &expression);
+
+private:
+	typedef std::list<std::shared_ptr<XPathExpression_Impl> > CacheList;
+
+	static const CacheList::size_type max_cache_size = 256;
+
+	static Mutex cache_mutex;
+
+	/// \brief Cached expressions, most recently used first
+	static CacheList cache;
+
+	static std::unordered_map<std::string, CacheList::iterator> cache_index;
+};
+
+}
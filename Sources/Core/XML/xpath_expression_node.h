@@ -0,0 +1,84 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Magnus Norddahl
+*/
+
+#pragma once
+
+#include "API/Core/XML/xpath_object.h"
+#include "xpath_evaluator_impl.h"
+#include "xpath_location_step.h"
+
+namespace clan
+{
+
+/// \brief Node in the tree of a compiled XPath expression
+class XPathExpressionNode
+{
+public:
+	enum Type
+	{
+		type_literal,
+		type_number,
+		type_function,
+		type_operator,
+		type_location_path,
+		type_filter
+	};
+
+	XPathExpressionNode(Type type)
+	: type(type), number(0.0), function(0), oper(XPathToken::operator_parenthesis_begin), absolute(false)
+	{
+	}
+
+	Type type;
+
+	/// \brief Value of a literal or a variable reference
+	std::string str;
+
+	/// \brief Value of a number
+	double number;
+
+	/// \brief Function called with the values of the operands as parameters
+	XPathEvaluator_Impl::Function function;
+
+	/// \brief Operator applied to the left and right operands
+	XPathToken::Operator oper;
+
+	/// \brief Function parameters, operator operands or the expression being filtered
+	std::vector<std::shared_ptr<XPathExpressionNode> > operands;
+
+	/// \brief Predicates of a filter expression
+	std::vector<std::shared_ptr<XPathExpressionNode> > predicates;
+
+	/// \brief Location path starts at the root node
+	bool absolute;
+
+	/// \brief Location path steps, or the steps following a filter expression
+	std::vector<XPathLocationStep> steps;
+};
+
+}
@@ -35,6 +35,7 @@
 #include "API/Core/Text/string_format.h"
 #include "API/Core/Text/string_help.h"
 #include "API/Core/System/mutex.h"
+#include "API/Core/System/work_queue.h"
 #include "zip_archive_impl.h"
 #include "zip_file_header.h"
 #include "zip_64_end_of_central_directory_record.h"
@@ -44,7 +45,12 @@
 #include "zip_iodevice_fileentry.h"
 #include "zip_compression_method.h"
 #include "zip_digital_signature.h"
+#include "zip_local_file_header.h"
+#include "zip_memory_map.h"
+#include "zip_iodevice_memory_view.h"
+#include "miniz.h"
 #include <ctime>
+#include <set>
 
 namespace clan
 {
@@ -57,10 +63,19 @@ ZipArchive::ZipArchive()
 {
 }
 	
-ZipArchive::ZipArchive(const std::string &filename)
+ZipArchive::ZipArchive(const std::string &filename, bool memory_map)
 : impl(new ZipArchive_Impl)
 {
-	IODevice input = File(filename);
+	IODevice input;
+	if (memory_map)
+	{
+		impl->memory_map = std::shared_ptr<ZipMemoryMap>(new ZipMemoryMap(filename));
+		input = IODevice(new ZipIODevice_MemoryView(impl->memory_map, impl->memory_map->get_data(), impl->memory_map->get_size()));
+	}
+	else
+	{
+		input = File(filename);
+	}
 	impl->input = input;
 	load(input);
 }
@@ -98,7 +113,7 @@ std::vector<ZipFileEntry> ZipArchive::get_file_list(const std::string &dirpath)
 	path = PathHelp::add_trailing_slash(path, PathHelp::path_type_virtual);
 
 	std::vector<ZipFileEntry> files;
-	std::vector<std::string> added_directories;
+	std::set<std::string> added_directories;
 
 	for (std::vector<ZipFileEntry>::size_type i=0; i<impl->files.size(); i++)
 	{
@@ -115,23 +130,14 @@ std::vector<ZipFileEntry> ZipArchive::get_file_list(const std::string &dirpath)
 
 			if (subdir_slash_pos != std::string::npos) // subdirectory or files in a subdirectory
 			{
-				bool dir_added = false;
 				std::string directory_name = filename.substr(path.size(), subdir_slash_pos-path.size());
 
-				for (std::vector<std::string>::size_type j = 0; j < added_directories.size(); j++)
-				{
-					if (added_directories[j] == directory_name)
-						dir_added = true;
-				}
-
-				if (!dir_added)
+				if (added_directories.insert(directory_name).second)
 				{
 					ZipFileEntry dir_entry;
 					dir_entry.set_archive_filename(directory_name);
 					dir_entry.set_directory(true);
 					files.push_back(dir_entry);
-
-					added_directories.push_back(directory_name);
 				}
 			}
 			else if (impl->files[i].get_archive_filename() != path)
@@ -152,40 +158,156 @@ std::vector<ZipFileEntry> ZipArchive::get_file_list(const std::string &dirpath)
 
 IODevice ZipArchive::open_file(const std::string &filename)
 {
-	int size = impl->files.size();
-	for (int i=0; i<size; i++)
+	int index = impl->find_file(filename);
+	if (index == -1)
+		throw Exception(string_format("Unable to find zip index %1", filename));
+
+	ZipFileEntry &entry = impl->files[index];
+	switch (entry.impl->type)
+	{
+	case ZipFileEntry_Impl::type_file:
 	{
-		ZipFileEntry &entry = impl->files[i];
+		const ZipFileHeader &record = entry.impl->record;
+		if (impl->memory_map && record.compression_method == zip_compress_store)
+		{
+			return IODevice(new ZipIODevice_MemoryView(impl->memory_map, impl->get_mapped_data(record), record.compressed_size));
+		}
+		else if (impl->memory_map && record.compression_method == zip_compress_deflate)
+		{
+			DataBuffer data(record.uncompressed_size);
+			if (!ZipArchive_Impl::inflate(impl->get_mapped_data(record), record.compressed_size, data.get_data(), data.get_size()))
+				throw Exception(string_format("Zlib inflate failed while decompressing zip file %1", filename));
+			return IODevice_Memory(data);
+		}
+
+		IODevice dupe = impl->input.duplicate();
+		return IODevice(new ZipIODevice_FileEntry(dupe, entry));
+	}
 
-		std::string entry_filename = entry.impl->record.filename;
-		if (entry_filename[0] == '/')
-			entry_filename = entry_filename.substr(1,std::string::npos);
+	case ZipFileEntry_Impl::type_removed:
+		throw Exception(string_format("Unable to zip open file entry %1. The entry has been removed!", filename));
+		break;
 
-		if (entry_filename == filename)
+	case ZipFileEntry_Impl::type_added_memory:
+		return IODevice_Memory(entry.impl->data);
+
+	case ZipFileEntry_Impl::type_added_file:
+		return File(entry.impl->filename);
+	}
+	throw Exception(string_format("Unknown zip file entry type %1", filename));
+}
+
+bool ZipArchive::get_file_view(const std::string &filename, const void *&out_data, int &out_size)
+{
+	int index = impl->find_file(filename);
+	if (index == -1)
+		throw Exception(string_format("Unable to find zip index %1", filename));
+
+	ZipFileEntry &entry = impl->files[index];
+	const ZipFileHeader &record = entry.impl->record;
+	if (!impl->memory_map || entry.impl->type != ZipFileEntry_Impl::type_file || record.compression_method != zip_compress_store)
+		return false;
+
+	out_data = impl->get_mapped_data(record);
+	out_size = record.compressed_size;
+	return true;
+}
+
+std::vector<DataBuffer> ZipArchive::load_files(const std::vector<std::string> &filenames, WorkQueue &work_queue)
+{
+	// Amount of compressed data given to each inflate task
+	const int task_input_size = 256*1024;
+
+	std::vector<DataBuffer> output(filenames.size());
+
+	// The jobs must not be reallocated while tasks are running
+	ZipArchive_Inflater inflater;
+	inflater.jobs.reserve(filenames.size());
+
+	std::vector<WorkTask> tasks;
+	int task_begin = 0;
+	int task_input = 0;
+
+	try
+	{
+		for (size_t i = 0; i < filenames.size(); i++)
 		{
-			switch (entry.impl->type)
-			{
-			case ZipFileEntry_Impl::type_file:
+			int index = impl->find_file(filenames[i]);
+			if (index == -1)
+				throw Exception(string_format("Unable to find zip index %1", filenames[i]));
+
+			ZipFileEntry &entry = impl->files[index];
+			const ZipFileHeader &record = entry.impl->record;
+			bool stored = (record.compression_method == zip_compress_store);
+			bool deflated = (record.compression_method == zip_compress_deflate);
+
+			if (entry.impl->type != ZipFileEntry_Impl::type_file || !(stored || deflated))
 			{
-				IODevice dupe = impl->input.duplicate();
-				return IODevice(new ZipIODevice_FileEntry(dupe, entry));
+				IODevice file = open_file(filenames[i]);
+				output[i] = DataBuffer(file.get_size());
+				file.read(output[i].get_data(), output[i].get_size());
+				continue;
 			}
 
-			case ZipFileEntry_Impl::type_removed:
-				throw Exception(string_format("Unable to zip open file entry %1. The entry has been removed!", filename));
-				break;
+			output[i] = DataBuffer(record.uncompressed_size);
 
-			case ZipFileEntry_Impl::type_added_memory:
-				return IODevice_Memory(entry.impl->data);
+			const void *input = 0;
+			if (impl->memory_map)
+			{
+				input = impl->get_mapped_data(record);
+				if (stored)
+					memcpy(output[i].get_data(), input, output[i].get_size());
+			}
+			else if (stored)
+			{
+				impl->seek_to_data(record);
+				impl->input.read(output[i].get_data(), output[i].get_size());
+			}
+			else
+			{
+				DataBuffer compressed_data(record.compressed_size);
+				impl->seek_to_data(record);
+				impl->input.read(compressed_data.get_data(), compressed_data.get_size());
+				inflater.compressed_data.push_back(compressed_data);
+				input = compressed_data.get_data();
+			}
+
+			if (deflated)
+			{
+				inflater.jobs.push_back(ZipArchive_Inflater::Job(input, record.compressed_size, output[i].get_data(), output[i].get_size()));
 
-			case ZipFileEntry_Impl::type_added_file:
-				return File(entry.impl->filename);
+				task_input += record.compressed_size;
+				if (task_input >= task_input_size)
+				{
+					tasks.push_back(work_queue.run(Callback_v0(&inflater, &ZipArchive_Inflater::inflate_range, ZipArchive_InflateRange(task_begin, inflater.jobs.size()))));
+					task_begin = inflater.jobs.size();
+					task_input = 0;
+				}
 			}
-			throw Exception(string_format("Unknown zip file entry type %1", filename));
 		}
+
+		if (task_begin < (int)inflater.jobs.size())
+			tasks.push_back(work_queue.run(Callback_v0(&inflater, &ZipArchive_Inflater::inflate_range, ZipArchive_InflateRange(task_begin, inflater.jobs.size()))));
+	}
+	catch (...)
+	{
+		// The tasks use the inflater on our stack
+		for (size_t i = 0; i < tasks.size(); i++)
+			work_queue.wait_for(tasks[i]);
+		throw;
 	}
-	throw Exception(string_format("Unable to find zip index %1", filename));
-} 
+
+	for (size_t i = 0; i < tasks.size(); i++)
+		work_queue.wait_for(tasks[i]);
+
+	for (size_t i = 0; i < inflater.jobs.size(); i++)
+	{
+		if (inflater.jobs[i].failed)
+			throw Exception("Zlib inflate failed while decompressing zip file!");
+	}
+
+	return output;
+}
 
 std::string ZipArchive::get_pathname(const std::string &filename)
 {
@@ -203,6 +325,7 @@ void ZipArchive::add_file(const std::string &input_filename, const std::string &
 	file_entry.set_input_filename(input_filename);
 	file_entry.set_archive_filename(archive_filename);
 	impl->files.push_back(file_entry);
+	impl->add_to_index(impl->files.size() - 1);
 }
 
 void ZipArchive::save()
@@ -369,23 +492,110 @@ void ZipArchive::load(IODevice &input)
 
 	// Load central directory records:
 
-	if (zip64) input.seek(int(zip64_end_of_directory.offset_to_start_of_central_directory), IODevice::seek_set);
-	else input.seek(int(end_of_directory.offset_to_start_of_central_directory), IODevice::seek_set);
+	byte64 central_directory_offset = (ubyte32) end_of_directory.offset_to_start_of_central_directory;
+	byte64 central_directory_size = (ubyte32) end_of_directory.size_of_central_directory;
+	byte64 num_entries = (ubyte16) end_of_directory.number_of_entries_in_central_directory;
+	if (zip64)
+	{
+		central_directory_offset = zip64_end_of_directory.offset_to_start_of_central_directory;
+		central_directory_size = zip64_end_of_directory.size_of_central_directory;
+		num_entries = zip64_end_of_directory.number_of_entries_in_central_directory;
+	}
 
-	byte64 num_entries = end_of_directory.number_of_entries_in_central_directory;
-	if (zip64) num_entries = zip64_end_of_directory.number_of_entries_in_central_directory;
+	if (central_directory_offset < 0 || central_directory_size < 0 || central_directory_offset + central_directory_size > size_file)
+		throw Exception("Zip central directory is outside the file");
 
-	for (int i=0; i<num_entries; i++)
+	// Read the directory in one go, rather than a few bytes at a time from the input device
+	DataBuffer central_directory((int) central_directory_size);
+	input.seek(int(central_directory_offset), IODevice::seek_set);
+	if (input.read(central_directory.get_data(), central_directory.get_size()) != (int) central_directory.get_size())
+		throw Exception("Unable to read the zip central directory");
+
+	IODevice_Memory directory_input(central_directory);
+	directory_input.set_little_endian_mode();
+
+	impl->files.reserve(impl->files.size() + (size_t) num_entries);
+	for (byte64 i=0; i<num_entries; i++)
 	{
 		ZipFileEntry entry;
-		entry.impl->record.load(input);
+		entry.impl->record.load(directory_input);
 		impl->files.push_back(entry);
+		impl->add_to_index(impl->files.size() - 1);
 	}
 }
 
 /////////////////////////////////////////////////////////////////////////////
 // ZipArchive implementation:
 
+void ZipArchive_Impl::add_to_index(int index)
+{
+	std::string filename = files[index].get_archive_filename();
+	if (!filename.empty() && filename[0] == '/')
+		filename = filename.substr(1, std::string::npos);
+
+	// The first entry wins if the archive contains the same filename twice
+	file_index.insert(std::pair<std::string, int>(filename, index));
+}
+
+int ZipArchive_Impl::find_file(const std::string &filename) const
+{
+	std::unordered_map<std::string, int>::const_iterator it = file_index.find(filename);
+	if (it != file_index.end())
+		return it->second;
+	else
+		return -1;
+}
+
+const unsigned char *ZipArchive_Impl::get_mapped_data(const ZipFileHeader &record) const
+{
+	// Local file header: 30 bytes followed by the filename and the extra field
+	const int local_header_size = 30;
+
+	const unsigned char *data = memory_map->get_data();
+	int size = memory_map->get_size();
+
+	int offset = record.relative_offset_of_local_header;
+	if (offset < 0 || offset > size - local_header_size)
+		throw Exception("Zip file entry is outside the file");
+
+	const unsigned char *local_header = data + offset;
+	ubyte32 signature = local_header[0] | (local_header[1] << 8) | (local_header[2] << 16) | (local_header[3] << 24);
+	if (signature != 0x04034b50)
+		throw Exception("Incorrect Local File Header signature");
+
+	int file_name_length = local_header[26] | (local_header[27] << 8);
+	int extra_field_length = local_header[28] | (local_header[29] << 8);
+	offset += local_header_size + file_name_length + extra_field_length;
+
+	if (record.compressed_size < 0 || offset > size - record.compressed_size)
+		throw Exception("Zip file entry is outside the file");
+
+	return data + offset;
+}
+
+void ZipArchive_Impl::seek_to_data(const ZipFileHeader &record)
+{
+	input.seek(record.relative_offset_of_local_header, IODevice::seek_set);
+
+	ZipLocalFileHeader local_header;
+	local_header.load(input);
+}
+
+bool ZipArchive_Impl::inflate(const void *input, int input_size, void *output, int output_size)
+{
+	size_t result = tinfl_decompress_mem_to_mem(output, output_size, input, input_size, 0);
+	return result == (size_t) output_size;
+}
+
+void ZipArchive_Inflater::inflate_range(ZipArchive_InflateRange range)
+{
+	for (int i = range.begin; i < range.end; i++)
+	{
+		Job &job = jobs[i];
+		job.failed = !ZipArchive_Impl::inflate(job.input, job.input_size, job.output, job.output_size);
+	}
+}
+
 void ZipArchive_Impl::calc_time_and_date(byte16 &out_date, byte16 &out_time)
 {
 	ubyte32 day_of_month = 0;
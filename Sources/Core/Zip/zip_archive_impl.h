@@ -30,11 +30,49 @@
 
 #include "API/Core/Zip/zip_file_entry.h"
 #include "API/Core/IOData/iodevice.h"
+#include "API/Core/System/databuffer.h"
 #include "zip_flags.h"
+#include "zip_file_header.h"
+#include <unordered_map>
+#include <memory>
 
 namespace clan
 {
 
+class ZipMemoryMap;
+
+/// \brief Range of jobs inflated by one task in ZipArchive::load_files
+struct ZipArchive_InflateRange
+{
+	ZipArchive_InflateRange(int begin, int end) : begin(begin), end(end) { }
+
+	int begin;
+	int end;
+};
+
+/// \brief Compressed files inflated on a work queue by ZipArchive::load_files
+class ZipArchive_Inflater
+{
+public:
+	struct Job
+	{
+		Job(const void *input, int input_size, void *output, int output_size) : input(input), input_size(input_size), output(output), output_size(output_size), failed(false) { }
+
+		const void *input;
+		int input_size;
+		void *output;
+		int output_size;
+		bool failed;
+	};
+
+	std::vector<Job> jobs;
+
+	/// \brief Compressed data read from the input device, if the archive is not memory mapped
+	std::vector<DataBuffer> compressed_data;
+
+	void inflate_range(ZipArchive_InflateRange range);
+};
+
 class ZipArchive_Impl
 {
 /// \name Construction
@@ -50,8 +88,14 @@ public:
 public:
 	std::vector<ZipFileEntry> files;
 
+	/// \brief Index into files by filename, without the leading slash
+	std::unordered_map<std::string, int> file_index;
+
 	IODevice input;
 
+	/// \brief The archive file, if it was memory mapped
+	std::shared_ptr<ZipMemoryMap> memory_map;
+
 
 /// \}
 /// \name Operations
@@ -62,6 +106,21 @@ public:
 
 	static void calc_time_and_date(byte16 &out_date, byte16 &out_time);
 
+	/// \brief Adds files[index] to the file index
+	void add_to_index(int index);
+
+	/// \brief Returns the position in files, or -1 if the archive does not contain the file
+	int find_file(const std::string &filename) const;
+
+	/// \brief Returns where the compressed data of a file starts in the memory mapped archive
+	const unsigned char *get_mapped_data(const ZipFileHeader &record) const;
+
+	/// \brief Seeks the input device to the compressed data of a file
+	void seek_to_data(const ZipFileHeader &record);
+
+	/// \brief Inflates raw deflate data in one go. Returns false if the data is corrupt.
+	static bool inflate(const void *input, int input_size, void *output, int output_size);
+
 
 /// \}
 /// \name Implementation
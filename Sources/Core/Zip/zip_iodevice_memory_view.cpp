@@ -0,0 +1,114 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Magnus Norddahl
+*/
+
+#include "Core/precomp.h"
+#include "zip_iodevice_memory_view.h"
+#include "zip_memory_map.h"
+#include "API/Core/Math/cl_math.h"
+
+namespace clan
+{
+
+/////////////////////////////////////////////////////////////////////////////
+// ZipIODevice_MemoryView Construction:
+
+ZipIODevice_MemoryView::ZipIODevice_MemoryView(const std::shared_ptr<ZipMemoryMap> &memory_map, const unsigned char *data, int size)
+: memory_map(memory_map), data(data), size(size), position(0)
+{
+}
+
+ZipIODevice_MemoryView::~ZipIODevice_MemoryView()
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// ZipIODevice_MemoryView Attributes:
+
+int ZipIODevice_MemoryView::get_size() const
+{
+	return size;
+}
+
+int ZipIODevice_MemoryView::get_position() const
+{
+	return position;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// ZipIODevice_MemoryView Operations:
+
+int ZipIODevice_MemoryView::send(const void *data, int len, bool send_all)
+{
+	throw Exception("Zip file entries are read only");
+}
+
+int ZipIODevice_MemoryView::receive(void *buffer, int len, bool receive_all)
+{
+	len = peek(buffer, len);
+	position += len;
+	return len;
+}
+
+int ZipIODevice_MemoryView::peek(void *buffer, int len)
+{
+	len = clamp(len, 0, size - position);
+	memcpy(buffer, data + position, len);
+	return len;
+}
+
+bool ZipIODevice_MemoryView::seek(int requested_position, IODevice::SeekMode mode)
+{
+	int new_position = position;
+	switch (mode)
+	{
+	case IODevice::seek_set:
+		new_position = requested_position;
+		break;
+	case IODevice::seek_cur:
+		new_position += requested_position;
+		break;
+	case IODevice::seek_end:
+		new_position = size + requested_position;
+		break;
+	default:
+		return false;
+	}
+
+	if (new_position < 0 || new_position > size)
+		return false;
+
+	position = new_position;
+	return true;
+}
+
+IODeviceProvider *ZipIODevice_MemoryView::duplicate()
+{
+	return new ZipIODevice_MemoryView(memory_map, data, size);
+}
+
+}
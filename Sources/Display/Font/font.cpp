@@ -355,6 +355,12 @@ int Font::get_character_index(Canvas &canvas, const std::string &text, const Poi
 	return 0;
 }
 
+void Font::prewarm(Canvas &canvas, unsigned int first_glyph, unsigned int last_glyph)
+{
+	if (impl)
+		impl->prewarm(canvas, first_glyph, last_glyph);
+}
+
 /////////////////////////////////////////////////////////////////////////////
 // Font Implementation:
 
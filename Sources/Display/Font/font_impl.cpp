@@ -159,6 +159,11 @@ int Font_Impl::get_character_index(GraphicContext &gc, const std::string &text,
 	return glyph_cache.get_character_index(font_engine, gc, text, point);
 }
 
+void Font_Impl::prewarm(GraphicContext &gc, unsigned int first_glyph, unsigned int last_glyph)
+{
+	glyph_cache.prewarm(font_engine, gc, first_glyph, last_glyph);
+}
+
 void Font_Impl::load_font( Canvas &canvas, Sprite &sprite, const std::string &glyph_list, int spacelen, bool monospace, const FontMetrics &metrics)
 {
 	free_font();
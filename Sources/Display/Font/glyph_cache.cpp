@@ -47,6 +47,7 @@
 #include "../Render/graphic_context_impl.h"
 #include "API/Display/2D/canvas.h"
 #include "../2D/canvas_impl.h"
+#include <algorithm>
 
 namespace clan
 {
@@ -57,6 +58,8 @@ namespace clan
 GlyphCache::GlyphCache()
 {
 	glyph_list.reserve(256);
+	for (unsigned int i = 0; i < latin1_table_size; i++)
+		latin1_table[i] = NULL;
 
 	// Note, the user can specify a different texture group size using set_texture_group()
 	texture_group = TextureGroup(Size(256,256));
@@ -112,26 +115,15 @@ Size GlyphCache::get_text_size(FontEngine *font_engine, GraphicContext &gc, cons
 
 Font_TextureGlyph *GlyphCache::get_glyph(FontEngine *font_engine, GraphicContext &gc, unsigned int glyph)
 {
-	std::vector< Font_TextureGlyph * >::size_type size = glyph_list.size();
-	for (int cnt=0; cnt<size; cnt++)
-	{
-		if (glyph_list[cnt]->glyph == glyph)
-			return &(*glyph_list[cnt]);
-	}
+	Font_TextureGlyph *font_glyph = find_glyph(glyph);
+	if (font_glyph)
+		return font_glyph;
 
 	// If glyph does not exist, create one automatically
 
 	insert_glyph(font_engine, gc, glyph);
 
-	// Search for the glyph again
-	size = glyph_list.size();
-	for (int cnt=0; cnt<size; cnt++)
-	{
-		if (glyph_list[cnt]->glyph == glyph)
-			return &(*glyph_list[cnt]);
-	}
-
-	return NULL;
+	return find_glyph(glyph);
 }
 
 /////////////////////////////////////////////////////////////////////////////
@@ -191,17 +183,12 @@ int GlyphCache::get_character_index(FontEngine *font_engine, GraphicContext &gc,
 void GlyphCache::insert_glyph(GraphicContext &gc, FontPixelBuffer &pb)
 {
 	// Search for duplicated glyph's, if found silently ignore them
-	std::vector< Font_TextureGlyph * >::size_type size = glyph_list.size();
-	for (int cnt=0; cnt<size; cnt++)
-	{
-		if (glyph_list[cnt]->glyph == pb.glyph)
-			return ;
-	}
+	if (find_glyph(pb.glyph))
+		return;
 
 	Font_TextureGlyph *font_glyph = new Font_TextureGlyph();
-	
-	glyph_list.push_back(font_glyph);
 	font_glyph->glyph = pb.glyph;
+	add_glyph(font_glyph);
 	font_glyph->offset = pb.offset;
 	font_glyph->increment = pb.increment;
 
@@ -227,17 +214,12 @@ void GlyphCache::insert_glyph(FontEngine *font_engine, GraphicContext &gc, const
 void GlyphCache::insert_glyph(GraphicContext &gc, unsigned int glyph, Subtexture &sub_texture, const Point &offset, const Point &increment)
 {
 	// Search for duplicated glyph's, if found silently ignore them
-	std::vector< Font_TextureGlyph * >::size_type size = glyph_list.size();
-	for (int cnt=0; cnt<size; cnt++)
-	{
-		if (glyph_list[cnt]->glyph == glyph)
-			return;
-	}
+	if (find_glyph(glyph))
+		return;
 
 	Font_TextureGlyph *font_glyph = new Font_TextureGlyph();
-	
-	glyph_list.push_back(font_glyph);
 	font_glyph->glyph = glyph;
+	add_glyph(font_glyph);
 	font_glyph->offset = offset;
 	font_glyph->increment = increment;
 
@@ -269,6 +251,51 @@ void GlyphCache::insert_glyph(FontEngine *font_engine, GraphicContext &gc, int g
 	}
 }
 
+static bool prewarm_taller_glyph(const FontPixelBuffer &a, const FontPixelBuffer &b)
+{
+	return a.buffer_rect.get_height() > b.buffer_rect.get_height();
+}
+
+void GlyphCache::prewarm(FontEngine *font_engine, GraphicContext &gc, unsigned int first_glyph, unsigned int last_glyph)
+{
+	if (first_glyph > last_glyph)
+		return;
+
+	std::vector<FontPixelBuffer> buffers;
+	buffers.reserve(last_glyph - first_glyph + 1);
+
+	// Rasterize every missing glyph first
+	for (unsigned int glyph = first_glyph; ; glyph++)
+	{
+		if (!find_glyph(glyph))
+		{
+			FontPixelBuffer pb;
+			if (enable_subpixel)
+			{
+				pb = font_engine->get_font_glyph_subpixel(glyph);
+			}
+			else
+			{
+				pb = font_engine->get_font_glyph_standard(glyph, anti_alias);
+			}
+
+			if (pb.glyph)	// Ignore invalid glyphs
+				buffers.push_back(pb);
+		}
+
+		if (glyph == last_glyph)
+			break;
+	}
+
+	// Pack the tallest glyphs first, so the texture group rows are filled with similar sized glyphs
+	std::stable_sort(buffers.begin(), buffers.end(), &prewarm_taller_glyph);
+
+	for (std::vector<FontPixelBuffer>::size_type i = 0; i < buffers.size(); i++)
+	{
+		insert_glyph(gc, buffers[i]);
+	}
+}
+
 void GlyphCache::draw_text(FontEngine *font_engine, Canvas &canvas, float xpos, float ypos, const std::string &text, const Colorf &color) 
 {
 	std::string::size_type string_length = text.length();
@@ -331,4 +358,17 @@ void GlyphCache::set_font_metrics(const FontMetrics &metrics)
 /////////////////////////////////////////////////////////////////////////////
 // GlyphCache Implementation:
 
+void GlyphCache::add_glyph(Font_TextureGlyph *font_glyph)
+{
+	glyph_list.push_back(font_glyph);
+	if (font_glyph->glyph < latin1_table_size)
+	{
+		latin1_table[font_glyph->glyph] = font_glyph;
+	}
+	else
+	{
+		glyph_map[font_glyph->glyph] = font_glyph;
+	}
+}
+
 }
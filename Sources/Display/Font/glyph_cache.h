@@ -36,6 +36,7 @@
 #include "API/Display/Render/texture_2d.h"
 #include <list>
 #include <map>
+#include <unordered_map>
 
 namespace clan
 {
@@ -96,6 +97,15 @@ public:
 	/// \brief Get a glyph. Returns NULL if the glyph was not found
 	Font_TextureGlyph *get_glyph(FontEngine *font_engine, GraphicContext &gc, unsigned int glyph);
 
+	/// \brief Get a glyph already in the cache. Returns NULL if the glyph has not been inserted
+	Font_TextureGlyph *find_glyph(unsigned int glyph) const
+	{
+		if (glyph < latin1_table_size)
+			return latin1_table[glyph];
+		std::unordered_map<unsigned int, Font_TextureGlyph *>::const_iterator it = glyph_map.find(glyph);
+		return (it != glyph_map.end()) ? it->second : NULL;
+	}
+
 /// \}
 /// \name Operations
 /// \{
@@ -119,6 +129,11 @@ public:
 	void insert_glyph(GraphicContext &gc, FontPixelBuffer &pb);
 	void insert_glyph(FontEngine *font_engine, GraphicContext &gc, const std::string &text);
 
+	/// \brief Rasterize all glyphs in the range [first_glyph, last_glyph] and pack them into the texture group
+	///
+	/// The glyphs are rasterized first and then packed tallest first, giving tighter texture usage than inserting them on demand.
+	void prewarm(FontEngine *font_engine, GraphicContext &gc, unsigned int first_glyph, unsigned int last_glyph);
+
 /// \}
 /// \name Implementation
 /// \{
@@ -126,8 +141,19 @@ private:
 	/// \brief Set the font metrics from the OS font
 	void write_font_metrics(GraphicContext &gc);
 
+	/// \brief Take ownership of the glyph and add it to the lookup tables
+	void add_glyph(Font_TextureGlyph *font_glyph);
+
 	std::vector<Font_TextureGlyph* > glyph_list;
 
+	static const unsigned int latin1_table_size = 256;
+
+	/// \brief Direct mapped lookup for ASCII and Latin-1 glyphs
+	Font_TextureGlyph *latin1_table[latin1_table_size];
+
+	/// \brief Hashed lookup for all other glyphs
+	std::unordered_map<unsigned int, Font_TextureGlyph *> glyph_map;
+
 	TextureGroup texture_group;
 
 	static const int glyph_border_size = 1;
@@ -53,6 +53,12 @@ void NetGameClient::connect(const std::string &server, const std::string &port)
 	impl->connection.reset(new NetGameConnection(this, SocketName(server, port)));
 }
 
+void NetGameClient::connect(const std::string &server, const std::string &port, NetGameTransport transport)
+{
+	disconnect();
+	impl->connection.reset(new NetGameConnection(this, SocketName(server, port), transport));
+}
+
 void NetGameClient::disconnect()
 {
 	if (impl->connection.get() != 0)
@@ -72,6 +78,12 @@ void NetGameClient::send_event(const NetGameEvent &game_event)
 		impl->connection->send_event(game_event);
 }
 
+void NetGameClient::send_event(const NetGameEvent &game_event, NetGameChannel channel)
+{
+	if (impl->connection.get() != 0)
+		impl->connection->send_event(game_event, channel);
+}
+
 Signal_v1<const NetGameEvent &> &NetGameClient::sig_event_received()
 {
 	return impl->sig_game_event_received;
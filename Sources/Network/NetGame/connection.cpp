@@ -32,20 +32,51 @@
 #include "network_event.h"
 #include "network_data.h"
 #include "connection_impl.h"
+#include "udp_connection_impl.h"
+#include "udp_host.h"
 
 namespace clan
 {
 
 NetGameConnection::NetGameConnection(NetGameConnectionSite *site, const TCPConnection &connection)
-: impl(new NetGameConnection_Impl())
+: impl(0)
 {
-	impl->start(this, site, connection);
+	NetGameTCPConnection_Impl *tcp_impl = new NetGameTCPConnection_Impl();
+	impl = tcp_impl;
+	tcp_impl->start(this, site, connection);
 }
 
 NetGameConnection::NetGameConnection(NetGameConnectionSite *site, const SocketName &socket_name)
-: impl(new NetGameConnection_Impl())
+: impl(0)
 {
-	impl->start(this, site, socket_name);
+	NetGameTCPConnection_Impl *tcp_impl = new NetGameTCPConnection_Impl();
+	impl = tcp_impl;
+	tcp_impl->start(this, site, socket_name);
+}
+
+NetGameConnection::NetGameConnection(NetGameConnectionSite *site, const SocketName &socket_name, NetGameTransport transport)
+: impl(0)
+{
+	if (transport == netgame_transport_udp)
+	{
+		std::shared_ptr<NetGameUDPHost> host(new NetGameUDPHost(site, SocketName(), false));
+		NetGameUDPConnection_Impl *udp_impl = new NetGameUDPConnection_Impl(host, socket_name, true);
+		impl = udp_impl;
+		udp_impl->start(this);
+		host->start();
+	}
+	else
+	{
+		NetGameTCPConnection_Impl *tcp_impl = new NetGameTCPConnection_Impl();
+		impl = tcp_impl;
+		tcp_impl->start(this, site, socket_name);
+	}
+}
+
+NetGameConnection::NetGameConnection(NetGameConnection_Impl *impl)
+: impl(impl)
+{
+	impl->set_base(this);
 }
 
 NetGameConnection::~NetGameConnection()
@@ -65,7 +96,12 @@ void *NetGameConnection::get_data(const std::string &name) const
 
 void NetGameConnection::send_event(const NetGameEvent &game_event)
 {
-	impl->send_event(game_event);
+	impl->send_event(game_event, netgame_channel_reliable_ordered);
+}
+
+void NetGameConnection::send_event(const NetGameEvent &game_event, NetGameChannel channel)
+{
+	impl->send_event(game_event, channel);
 }
 
 void NetGameConnection::disconnect()
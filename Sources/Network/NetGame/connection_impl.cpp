@@ -38,35 +38,6 @@
 namespace clan
 {
 
-NetGameConnection_Impl::NetGameConnection_Impl()
-{
-}
-
-void NetGameConnection_Impl::start(NetGameConnection *xbase, NetGameConnectionSite *xsite, const TCPConnection &xconnection)
-{
-	base = xbase;
-	site = xsite;
-	connection = xconnection;
-	socket_name = connection.get_remote_name();
-	is_connected = true;
-	thread.start(this, &NetGameConnection_Impl::connection_main);
-}
-
-void NetGameConnection_Impl::start(NetGameConnection *xbase, NetGameConnectionSite *xsite, const SocketName &xsocket_name)
-{
-	base = xbase;
-	site = xsite;
-	socket_name = xsocket_name;
-	is_connected = false;
-	thread.start(this, &NetGameConnection_Impl::connection_main);
-}
-
-NetGameConnection_Impl::~NetGameConnection_Impl()
-{
-	stop_event.set();
-	thread.join();
-}
-
 void NetGameConnection_Impl::set_data(const std::string &name, void *new_data)
 {
 	for (std::vector<AttachedData>::iterator it = data.begin(); it != data.end(); ++it)
@@ -93,7 +64,36 @@ void *NetGameConnection_Impl::get_data(const std::string &name) const
 	return 0;
 }
 
-void NetGameConnection_Impl::send_event(const NetGameEvent &game_event)
+NetGameTCPConnection_Impl::NetGameTCPConnection_Impl()
+{
+}
+
+void NetGameTCPConnection_Impl::start(NetGameConnection *xbase, NetGameConnectionSite *xsite, const TCPConnection &xconnection)
+{
+	base = xbase;
+	site = xsite;
+	connection = xconnection;
+	socket_name = connection.get_remote_name();
+	is_connected = true;
+	thread.start(this, &NetGameTCPConnection_Impl::connection_main);
+}
+
+void NetGameTCPConnection_Impl::start(NetGameConnection *xbase, NetGameConnectionSite *xsite, const SocketName &xsocket_name)
+{
+	base = xbase;
+	site = xsite;
+	socket_name = xsocket_name;
+	is_connected = false;
+	thread.start(this, &NetGameTCPConnection_Impl::connection_main);
+}
+
+NetGameTCPConnection_Impl::~NetGameTCPConnection_Impl()
+{
+	stop_event.set();
+	thread.join();
+}
+
+void NetGameTCPConnection_Impl::send_event(const NetGameEvent &game_event, NetGameChannel channel)
 {
 	MutexSection mutex_lock(&mutex);
 	Message message;
@@ -103,7 +103,7 @@ void NetGameConnection_Impl::send_event(const NetGameEvent &game_event)
 	queue_event.set();
 }
 
-void NetGameConnection_Impl::disconnect()
+void NetGameTCPConnection_Impl::disconnect()
 {
 	MutexSection mutex_lock(&mutex);
 	Message message;
@@ -112,12 +112,12 @@ void NetGameConnection_Impl::disconnect()
 	queue_event.set();
 }
 
-SocketName NetGameConnection_Impl::get_remote_name() const
+SocketName NetGameTCPConnection_Impl::get_remote_name() const
 {
 	return socket_name;
 }
 
-void NetGameConnection_Impl::connection_main()
+void NetGameTCPConnection_Impl::connection_main()
 {
 	try
 	{
@@ -126,18 +126,15 @@ void NetGameConnection_Impl::connection_main()
 		is_connected = true;
 		site->add_network_event(NetGameNetworkEvent(base, NetGameNetworkEvent::client_connected));
 
-		int bytes_received = 0;
-		int bytes_sent = 0;
-		const int max_event_packet_size = 32000 + 2;
-		DataBuffer receive_buffer(max_event_packet_size);
-		DataBuffer send_buffer;
+		NetGameReceiveRing receive_ring;
+		NetGameSendArena send_arena;
 
 		bool send_graceful_close = false;
 
 		connection.set_nodelay(true);
 		while (true)
 		{
-			bool send_buffer_empty = (bytes_sent == send_buffer.get_size());
+			bool send_buffer_empty = send_arena.is_empty();
 
 			Event read_event = connection.get_read_event();
 			Event send_event = send_buffer_empty ? queue_event : connection.get_write_event();
@@ -148,38 +145,27 @@ void NetGameConnection_Impl::connection_main()
 			}
 			else if (wakeup_reason == 1) // we got data to receive
 			{
-				int bytes = connection.read(receive_buffer.get_data() + bytes_received, receive_buffer.get_size() - bytes_received, false);
+				int free_size = 0;
+				char *receive_data = receive_ring.get_write_data(free_size);
+				int bytes = connection.read(receive_data, free_size, false);
 				if (bytes <= 0)
 				{
 					connection.disconnect_graceful();
 					break;
 				}
 
-				bytes_received += bytes;
-
-				int bytes_consumed = 0;
-				bool exit = read_data(receive_buffer.get_data(), bytes_received, bytes_consumed);
-
-				if (bytes_consumed >= 0)
-				{
-					memmove(receive_buffer.get_data(), receive_buffer.get_data() + bytes_consumed, bytes_received - bytes_consumed);
-					bytes_received -= bytes_consumed;
-				}
+				receive_ring.commit_write(bytes);
 
+				bool exit = read_data(receive_ring);
 				if (exit)
 					break;
 			}
 			else if (wakeup_reason == 2) // we got data to send
 			{
 				if (!send_buffer_empty)
-				{
-					int bytes = connection.write(send_buffer.get_data() + bytes_sent, send_buffer.get_size() - bytes_sent, false);
-					if (bytes < 0)
-						throw Exception("TCPConnection.write failed");
-					bytes_sent += bytes;
-				}
+					send_arena.write(connection);
 
-				if (bytes_sent == send_buffer.get_size())
+				if (send_arena.is_empty())
 				{
 					if (send_graceful_close)
 					{
@@ -188,9 +174,8 @@ void NetGameConnection_Impl::connection_main()
 					}
 					else
 					{
-						bytes_sent = 0;
-						send_buffer.set_size(0);
-						send_graceful_close = write_data(send_buffer);
+						send_arena.clear();
+						send_graceful_close = write_data(send_arena);
 					}
 				}
 			}
@@ -204,52 +189,42 @@ void NetGameConnection_Impl::connection_main()
 	}
 }
 
-bool NetGameConnection_Impl::read_data(const void *data, int size, int &bytes_consumed)
+bool NetGameTCPConnection_Impl::read_data(NetGameReceiveRing &receive_ring)
 {
-	bytes_consumed = 0;
-	while (bytes_consumed != size)
+	NetGameEventView incoming_event;
+	while (receive_ring.next_event(incoming_event))
 	{
-		int bytes = 0;
-		NetGameEvent incoming_event = NetGameNetworkData::receive_data(static_cast<const char*>(data) + bytes_consumed, size - bytes_consumed, bytes);
-		bytes_consumed += bytes;
-
-		if (bytes == 0)
-		{
-			return false;
-		}
-		else if (incoming_event.get_name() == "_close")
-		{
+		if (incoming_event.is_name("_close"))
 			return true;
-		}
 
-		site->add_network_event(NetGameNetworkEvent(base, incoming_event));
+		site->add_network_event(NetGameNetworkEvent(base, incoming_event.to_event()));
 	}
 	return false;
 }
 
-bool NetGameConnection_Impl::write_data(DataBuffer &buffer)
+bool NetGameTCPConnection_Impl::write_data(NetGameSendArena &send_arena)
 {
 	MutexSection mutex_lock(&mutex);
 	queue_event.reset();
-	std::vector<Message> new_send_queue;
-	send_queue.swap(new_send_queue);
+	send_queue.swap(sending_queue);
 	mutex_lock.unlock();
-	for (unsigned int i = 0; i < new_send_queue.size(); i++)
+
+	// All queued events are coalesced into the arena and sent with one gathered write
+	bool disconnect = false;
+	for (unsigned int i = 0; i < sending_queue.size(); i++)
 	{
-		if (new_send_queue[i].type == Message::type_message)
+		if (sending_queue[i].type == Message::type_message)
 		{
-			DataBuffer packet = NetGameNetworkData::send_data(new_send_queue[i].event);
-
-			int pos = buffer.get_size();
-			buffer.set_size(pos + packet.get_size());
-			memcpy(buffer.get_data() + pos, packet.get_data(), packet.get_size());
+			NetGameNetworkData::send_data(send_arena, sending_queue[i].event);
 		}
-		else if (new_send_queue[i].type == Message::type_disconnect)
+		else if (sending_queue[i].type == Message::type_disconnect)
 		{
-			return true;
+			disconnect = true;
+			break;
 		}
 	}
-	return false;
+	sending_queue.clear();
+	return disconnect;
 }
 
 }
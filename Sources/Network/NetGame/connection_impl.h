@@ -32,27 +32,56 @@
 namespace clan
 {
 
+class NetGameReceiveRing;
+class NetGameSendArena;
+
+/// \brief Transport independent part of a NetGameConnection
 class NetGameConnection_Impl
 {
 public:
-	NetGameConnection_Impl();
-	~NetGameConnection_Impl();
-	void start(NetGameConnection *base, NetGameConnectionSite *site, const TCPConnection &connection);
-	void start(NetGameConnection *base, NetGameConnectionSite *site, const SocketName &socket_name);
+	NetGameConnection_Impl() : base(0), site(0) { }
+	virtual ~NetGameConnection_Impl() { }
+
 	void set_data(const std::string &name, void *data);
 	void *get_data(const std::string &name) const;
-	void send_event(const NetGameEvent &game_event);
+
+	/// \brief Sets the connection object events are reported for
+	void set_base(NetGameConnection *new_base) { base = new_base; }
+
+	virtual void send_event(const NetGameEvent &game_event, NetGameChannel channel) = 0;
+	virtual void disconnect() = 0;
+	virtual SocketName get_remote_name() const = 0;
+
+protected:
+	NetGameConnection *base;
+	NetGameConnectionSite *site;
+
+private:
+	struct AttachedData
+	{
+		std::string name;
+		void *data;
+	};
+	std::vector<AttachedData> data;
+};
+
+/// \brief Connection sending all events in order over a TCP stream
+class NetGameTCPConnection_Impl : public NetGameConnection_Impl
+{
+public:
+	NetGameTCPConnection_Impl();
+	~NetGameTCPConnection_Impl();
+	void start(NetGameConnection *base, NetGameConnectionSite *site, const TCPConnection &connection);
+	void start(NetGameConnection *base, NetGameConnectionSite *site, const SocketName &socket_name);
+	void send_event(const NetGameEvent &game_event, NetGameChannel channel);
 	void disconnect();
 	SocketName get_remote_name() const;
 
 private:
 	void connection_main();
-	bool read_data(const void *data, int size, int &out_bytes_consumed);
-	bool write_data(DataBuffer &buffer);
-
-	NetGameConnection *base;
+	bool read_data(NetGameReceiveRing &receive_ring);
+	bool write_data(NetGameSendArena &send_arena);
 
-	NetGameConnectionSite *site;
 	TCPConnection connection;
 	SocketName socket_name;
 	bool is_connected;
@@ -71,12 +100,9 @@ private:
 		NetGameEvent event;
 	};
 	std::vector<Message> send_queue;
-	struct AttachedData
-	{
-		std::string name;
-		void *data;
-	};
-	std::vector<AttachedData> data;
+
+	/// \brief Messages being encoded by the connection thread. Swapped with send_queue to keep both allocations.
+	std::vector<Message> sending_queue;
 };
 
 }
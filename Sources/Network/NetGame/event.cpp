@@ -84,7 +84,7 @@ unsigned int NetGameEvent::get_argument_count() const
 	return arguments.size();
 }
 
-NetGameEventValue NetGameEvent::get_argument(unsigned int index) const
+const NetGameEventValue &NetGameEvent::get_argument(unsigned int index) const
 {
 	if (index >= arguments.size())
 		throw Exception(string_format("Arguments out of bounds for game event %1", name));
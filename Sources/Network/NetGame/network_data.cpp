@@ -30,13 +30,33 @@
 #include "API/Core/System/databuffer.h"
 #include "API/Core/IOData/iodevice_memory.h"
 #include "API/Core/Text/string_help.h"
+#include "API/Core/Text/string_format.h"
 #include "API/Core/Zip/zlib_compression.h"
+#include "API/Core/Math/cl_math.h"
 #include "network_data.h"
 
 namespace clan
 {
 
 NetGameEvent NetGameNetworkData::receive_data(const void *data, int size, int &out_bytes_consumed)
+{
+	NetGameEventView view;
+	if (receive_view(data, size, out_bytes_consumed, view))
+		return view.to_event();
+	else
+		return NetGameEvent(std::string());
+}
+
+DataBuffer NetGameNetworkData::send_data(const NetGameEvent &e)
+{
+	NetGameSendArena arena;
+	send_data(arena, e);
+	DataBuffer buffer;
+	arena.copy_to(buffer);
+	return buffer;
+}
+
+bool NetGameNetworkData::receive_view(const void *data, int size, int &out_bytes_consumed, NetGameEventView &out_view)
 {
 	if (size >= 2)
 	{
@@ -46,226 +66,151 @@ NetGameEvent NetGameNetworkData::receive_data(const void *data, int size, int &o
 
 		if (size >= 2 + payload_size)
 		{
+			out_view = NetGameEventView(static_cast<const char*>(data) + 2, payload_size);
 			out_bytes_consumed = 2 + payload_size;
-			DataBuffer buffer(static_cast<const char*>(data) + 2, payload_size);
-			return decode_event(buffer);
+			return true;
 		}
 	}
 
 	out_bytes_consumed = 0;
-	return NetGameEvent(std::string());
+	return false;
 }
 
-DataBuffer NetGameNetworkData::send_data(const NetGameEvent &e)
+void NetGameNetworkData::send_data(NetGameSendArena &arena, const NetGameEvent &e)
 {
-	DataBuffer buffer = encode_event(e);
-	if (buffer.get_size() > packet_limit + 2)
+	const std::string &name = e.get_name();
+	unsigned int name_length = name.length();
+
+	unsigned int length = 3 + name_length;
+	for (unsigned int i = 0; i < e.get_argument_count(); i++)
+		length += get_encoded_length(e.get_argument(i));
+	if (length > packet_limit)
 		throw Exception("Outgoing message too big");
-	return buffer;
-}
 
-NetGameEvent NetGameNetworkData::decode_event(const DataBuffer &data)
-{
-	const unsigned char *d = data.get_data<unsigned char>();
-	unsigned int length = data.get_size();
-	if (length < 3)
-		throw Exception("Invalid network data");
+	// Write packet size (2) and name (2 + name length)
+	unsigned char *d = arena.alloc(4 + name_length);
+	*reinterpret_cast<unsigned short*>(d) = length;
+	*reinterpret_cast<unsigned short*>(d + 2) = name_length;
+	memcpy(d + 4, name.data(), name_length);
 
-	unsigned int name_length = *reinterpret_cast<const unsigned short*>(d);
-	if (length < 2 + name_length + 1)
-		throw Exception("Invalid network data");
-	std::string name = std::string(reinterpret_cast<const char*>(d + 2), name_length);
+	for (unsigned int i = 0; i < e.get_argument_count(); i++)
+		encode_value(arena, e.get_argument(i));
 
-	NetGameEvent e(name);
-	unsigned int pos = 2 + name_length;
-	while (true)
-	{
-		if (pos >= length)
-			throw Exception("Invalid network data");
-		unsigned char type = d[pos++];
-		if (type == 0)
-			break;
-		e.add_argument(decode_value(type, d, length, pos));
-	}
-	return e;
+	// Write end marker
+	*arena.alloc(1) = 0;
 }
 
-NetGameEventValue NetGameNetworkData::decode_value(unsigned char type, const unsigned char *d, unsigned int length, unsigned int &pos)
+void NetGameNetworkData::skip_value(unsigned char type, const unsigned char *d, unsigned int length, unsigned int &pos)
 {
 	switch (type)
 	{
 	case 1: // null
-		return NetGameEventValue(NetGameEventValue::null);
+	case 5: // false boolean
+	case 6: // true boolean
+		break;
 	case 2: // uint
-		{
-			if (pos + 4 > length)
-				throw Exception("Invalid network data");
-			unsigned int v = *reinterpret_cast<const unsigned int*>(d + pos);
-			pos += 4;
-			return NetGameEventValue(v);
-		}
 	case 3: // int
-		{
-			if (pos + 4 > length)
-				throw Exception("Invalid network data");
-			int v = *reinterpret_cast<const int*>(d + pos);
-			pos += 4;
-			return NetGameEventValue(v);
-		}
 	case 4: // number
-		{
-			if (pos + 4 > length)
-				throw Exception("Invalid network data");
-			float v = *reinterpret_cast<const float*>(d + pos);
-			pos += 4;
-			return NetGameEventValue(v);
-		}
-	case 5: // false boolean
-		return NetGameEventValue(false);
-	case 6: // true boolean
-		return NetGameEventValue(true);
+		if (pos + 4 > length)
+			throw Exception("Invalid network data");
+		pos += 4;
+		break;
+	case 9: // uchar
+	case 10: // char
+		if (pos + 1 > length)
+			throw Exception("Invalid network data");
+		pos += 1;
+		break;
 	case 7: // string
+	case 11: // binary
 		{
 			if (pos + 2 > length)
 				throw Exception("Invalid network data");
-			unsigned short name_length = *reinterpret_cast<const unsigned short*>(d + pos);
+			unsigned short data_length = *reinterpret_cast<const unsigned short*>(d + pos);
 			pos += 2;
-			if (pos + name_length > length)
+			if (pos + data_length > length)
 				throw Exception("Invalid network data");
-			std::string value(reinterpret_cast<const char*>(d + pos), name_length);
-			pos += name_length;
-			return NetGameEventValue(value);
+			pos += data_length;
+			break;
 		}
 	case 8: // complex
+		while (true)
 		{
-			NetGameEventValue value(NetGameEventValue::complex);
-			while (true)
-			{
-				if (pos >= length)
-					throw Exception("Invalid network data");
-				unsigned char type = d[pos++];
-				if (type == 0)
-					break;
-				value.add_member(decode_value(type, d, length, pos));
-			}
-			return value;
-		}
-	case 9: // uchar
-		{
-			if (pos + 1 > length)
-				throw Exception("Invalid network data");
-			unsigned char v = *reinterpret_cast<const unsigned char*>(d + pos);
-			pos += 1;
-			return NetGameEventValue(v);
-		}
-	case 10: // char
-		{
-			if (pos + 1 > length)
+			if (pos >= length)
 				throw Exception("Invalid network data");
-			char v = *reinterpret_cast<const char*>(d + pos);
-			pos += 1;
-			return NetGameEventValue(v);
-		}
-	case 11: // binary
-		{
-			if (pos + 2 > length)
-				throw Exception("Invalid network data");
-			unsigned short binary_length = *reinterpret_cast<const unsigned short*>(d + pos);
-			pos += 2;
-			if (pos + binary_length > length)
-				throw Exception("Invalid network data");
-			DataBuffer value(reinterpret_cast<const char*>(d + pos), binary_length);
-			pos += binary_length;
-			return NetGameEventValue(value);
+			unsigned char member_type = d[pos++];
+			if (member_type == 0)
+				break;
+			skip_value(member_type, d, length, pos);
 		}
+		break;
 	default:
 		throw Exception("Invalid network data");
 	}
 }
 
-DataBuffer NetGameNetworkData::encode_event(const NetGameEvent &e)
-{
-	unsigned int length = 3 + e.get_name().length();
-	for (unsigned int i = 0; i < e.get_argument_count(); i++)
-		length += get_encoded_length(e.get_argument(i));
-
-	DataBuffer data(length + 2);
-
-	*data.get_data<unsigned short>() = length;
-
-	unsigned char *d = data.get_data<unsigned char>() + 2;
-
-	// Write name (2 + name length)
-	unsigned int name_length = e.get_name().length();
-	*reinterpret_cast<unsigned short*>(d) = name_length;
-	d += 2;
-	memcpy(d, e.get_name().data(), name_length);
-	d += name_length;
-
-	for (unsigned int i = 0; i < e.get_argument_count(); i++)
-		d += encode_value(d, e.get_argument(i));
-
-	// Write end marker
-	*d = 0;
-
-	return data;
-}
-
-unsigned int NetGameNetworkData::encode_value(unsigned char *d, const NetGameEventValue &value)
+void NetGameNetworkData::encode_value(NetGameSendArena &arena, const NetGameEventValue &value)
 {
+	unsigned char *d;
 	switch (value.get_type())
 	{
 	case NetGameEventValue::null:
-		*d = 1;
-		return 1;
+		*arena.alloc(1) = 1;
+		break;
 	case NetGameEventValue::uinteger:
+		d = arena.alloc(5);
 		*d = 2;
 		*reinterpret_cast<unsigned int*>(d + 1) = value.to_uinteger();
-		return 5;
+		break;
 	case NetGameEventValue::integer:
+		d = arena.alloc(5);
 		*d = 3;
 		*reinterpret_cast<int*>(d + 1) = value.to_integer();
-		return 5;
+		break;
 	case NetGameEventValue::number:
+		d = arena.alloc(5);
 		*d = 4;
 		*reinterpret_cast<float*>(d + 1) = value.to_number();
-		return 5;
+		break;
 	case NetGameEventValue::boolean:
-		*d = value.to_boolean() ? 6 : 5;
-		return 1;
+		*arena.alloc(1) = value.to_boolean() ? 6 : 5;
+		break;
 	case NetGameEventValue::string:
 		{
-			std::string s = value.to_string();
+			const std::string &s = value.to_string();
+			d = arena.alloc(3 + s.length());
 			*d = 7;
 			*reinterpret_cast<unsigned short*>(d + 1) = s.length();
 			memcpy(d + 3, s.data(), s.length());
-			return 3 + s.length();
+			break;
 		}
 	case NetGameEventValue::complex:
-		{
-			d[0] = 8;
-			unsigned l = 1;
-			for (unsigned int i = 0; i < value.get_member_count(); i++)
-				l += encode_value(d + l, value.get_member(i));
-			d[l] = 0;
-			l++;
-			return l;
-		}
+		*arena.alloc(1) = 8;
+		for (unsigned int i = 0; i < value.get_member_count(); i++)
+			encode_value(arena, value.get_member(i));
+		*arena.alloc(1) = 0;
+		break;
 	case NetGameEventValue::ucharacter:
+		d = arena.alloc(2);
 		*d = 9;
 		*reinterpret_cast<unsigned char*>(d + 1) = value.to_ucharacter();
-		return 2;
+		break;
 	case NetGameEventValue::character:
+		d = arena.alloc(2);
 		*d = 10;
 		*reinterpret_cast<char*>(d + 1) = value.to_character();
-		return 2;
+		break;
 	case NetGameEventValue::binary:
 		{
 			DataBuffer s = value.to_binary();
+			d = arena.alloc(3);
 			*d = 11;
 			*reinterpret_cast<unsigned short*>(d + 1) = s.get_size();
-			memcpy(d + 3, s.get_data(), s.get_size());
-			return 3 + s.get_size();
+			if (s.get_size() >= NetGameSendArena::min_external_size)
+				arena.add_external(s);
+			else if (s.get_size() > 0)
+				memcpy(arena.alloc(s.get_size()), s.get_data(), s.get_size());
+			break;
 		}
 	default:
 		throw Exception("Unknown game event value type");
@@ -302,4 +247,329 @@ unsigned int NetGameNetworkData::get_encoded_length(const NetGameEventValue &val
 	}
 }
 
+NetGameEventValue::Type NetGameEventValueView::get_type() const
+{
+	switch (data[0])
+	{
+	case 1: return NetGameEventValue::null;
+	case 2: return NetGameEventValue::uinteger;
+	case 3: return NetGameEventValue::integer;
+	case 4: return NetGameEventValue::number;
+	case 5:
+	case 6: return NetGameEventValue::boolean;
+	case 7: return NetGameEventValue::string;
+	case 8: return NetGameEventValue::complex;
+	case 9: return NetGameEventValue::ucharacter;
+	case 10: return NetGameEventValue::character;
+	default: return NetGameEventValue::binary;
+	}
+}
+
+unsigned int NetGameEventValueView::get_member_count() const
+{
+	unsigned int count = 0;
+	unsigned int pos = 1;
+	while (data[pos] != 0)
+	{
+		pos += NetGameEventValueView(data + pos).get_encoded_length();
+		count++;
+	}
+	return count;
+}
+
+NetGameEventValueView NetGameEventValueView::get_member(unsigned int index) const
+{
+	unsigned int pos = 1;
+	for (unsigned int i = 0; i < index; i++)
+	{
+		if (data[pos] == 0)
+			throw Exception("Member out of bounds");
+		pos += NetGameEventValueView(data + pos).get_encoded_length();
+	}
+	if (data[pos] == 0)
+		throw Exception("Member out of bounds");
+	return NetGameEventValueView(data + pos);
+}
+
+unsigned int NetGameEventValueView::get_encoded_length() const
+{
+	switch (data[0])
+	{
+	case 1:
+	case 5:
+	case 6:
+		return 1;
+	case 2:
+	case 3:
+	case 4:
+		return 5;
+	case 9:
+	case 10:
+		return 2;
+	case 7:
+	case 11:
+		return 3 + get_size();
+	default: // complex
+		{
+			unsigned int pos = 1;
+			while (data[pos] != 0)
+				pos += NetGameEventValueView(data + pos).get_encoded_length();
+			return pos + 1;
+		}
+	}
+}
+
+NetGameEventValue NetGameEventValueView::to_value() const
+{
+	switch (data[0])
+	{
+	case 1: return NetGameEventValue(NetGameEventValue::null);
+	case 2: return NetGameEventValue(to_uinteger());
+	case 3: return NetGameEventValue(to_integer());
+	case 4: return NetGameEventValue(to_number());
+	case 5:
+	case 6: return NetGameEventValue(to_boolean());
+	case 7: return NetGameEventValue(to_string());
+	case 9: return NetGameEventValue(to_ucharacter());
+	case 10: return NetGameEventValue(to_character());
+	case 11: return NetGameEventValue(DataBuffer(get_data(), get_size()));
+	default: // complex
+		{
+			NetGameEventValue value(NetGameEventValue::complex);
+			unsigned int pos = 1;
+			while (data[pos] != 0)
+			{
+				NetGameEventValueView member(data + pos);
+				value.add_member(member.to_value());
+				pos += member.get_encoded_length();
+			}
+			return value;
+		}
+	}
+}
+
+NetGameEventView::NetGameEventView()
+: data(0), argument_count(0), first_argument(0), last_index(0), last_offset(0)
+{
+}
+
+NetGameEventView::NetGameEventView(const void *event_data, unsigned int length)
+: data(static_cast<const unsigned char *>(event_data)), argument_count(0), first_argument(0), last_index(0), last_offset(0)
+{
+	if (length < 3)
+		throw Exception("Invalid network data");
+
+	unsigned int name_length = *reinterpret_cast<const unsigned short*>(data);
+	if (length < 2 + name_length + 1)
+		throw Exception("Invalid network data");
+
+	unsigned int pos = 2 + name_length;
+	first_argument = pos;
+	last_offset = pos;
+	while (true)
+	{
+		if (pos >= length)
+			throw Exception("Invalid network data");
+		unsigned char type = data[pos++];
+		if (type == 0)
+			break;
+		NetGameNetworkData::skip_value(type, data, length, pos);
+		argument_count++;
+	}
+}
+
+bool NetGameEventView::is_name(const char *name) const
+{
+	unsigned int name_length = strlen(name);
+	return name_length == get_name_length() && memcmp(get_name_data(), name, name_length) == 0;
+}
+
+NetGameEventValueView NetGameEventView::get_argument(unsigned int index) const
+{
+	if (index >= argument_count)
+		throw Exception(string_format("Arguments out of bounds for game event %1", get_name()));
+
+	if (index < last_index)
+	{
+		last_index = 0;
+		last_offset = first_argument;
+	}
+
+	while (last_index < index)
+	{
+		last_offset += NetGameEventValueView(data + last_offset).get_encoded_length();
+		last_index++;
+	}
+	return NetGameEventValueView(data + last_offset);
+}
+
+NetGameEvent NetGameEventView::to_event() const
+{
+	NetGameEvent e(get_name());
+	unsigned int pos = first_argument;
+	for (unsigned int i = 0; i < argument_count; i++)
+	{
+		NetGameEventValueView argument(data + pos);
+		e.add_argument(argument.to_value());
+		pos += argument.get_encoded_length();
+	}
+	return e;
+}
+
+NetGameSendArena::NetGameSendArena()
+: arena_size(0), total_size(0), bytes_sent(0), current_segment(0), current_segment_offset(0)
+{
+}
+
+void NetGameSendArena::clear()
+{
+	arena_size = 0;
+	segments.clear();
+	total_size = 0;
+	bytes_sent = 0;
+	current_segment = 0;
+	current_segment_offset = 0;
+}
+
+unsigned char *NetGameSendArena::alloc(unsigned int size)
+{
+	if (arena_size + size > arena.size())
+		arena.resize(max(max((unsigned int) arena.size() * 2, arena_size + size), 4096u));
+
+	if (segments.empty() || !segments.back().external.is_null() || segments.back().offset + segments.back().size != arena_size)
+	{
+		Segment segment;
+		segment.offset = arena_size;
+		segments.push_back(segment);
+	}
+	segments.back().size += size;
+
+	unsigned char *d = &arena[arena_size];
+	arena_size += size;
+	total_size += size;
+	return d;
+}
+
+void NetGameSendArena::add_external(const DataBuffer &buffer)
+{
+	Segment segment;
+	segment.size = buffer.get_size();
+	segment.external = buffer;
+	segments.push_back(segment);
+	total_size += segment.size;
+}
+
+int NetGameSendArena::write(TCPConnection &connection)
+{
+	int count = 0;
+	unsigned int offset = current_segment_offset;
+	for (unsigned int i = current_segment; i < segments.size() && count < max_gather_buffers; i++)
+	{
+		gather_data[count] = get_segment_data(segments[i]) + offset;
+		gather_sizes[count] = segments[i].size - offset;
+		offset = 0;
+		count++;
+	}
+	if (count == 0)
+		return 0;
+
+	int bytes = connection.write_gather(gather_data, gather_sizes, count);
+	bytes_sent += bytes;
+
+	unsigned int bytes_left = bytes;
+	while (bytes_left > 0)
+	{
+		unsigned int segment_left = segments[current_segment].size - current_segment_offset;
+		if (bytes_left < segment_left)
+		{
+			current_segment_offset += bytes_left;
+			break;
+		}
+		bytes_left -= segment_left;
+		current_segment++;
+		current_segment_offset = 0;
+	}
+	return bytes;
+}
+
+void NetGameSendArena::copy_to(DataBuffer &buffer) const
+{
+	buffer.set_size(total_size);
+	char *d = buffer.get_data();
+	for (size_t i = 0; i < segments.size(); i++)
+	{
+		memcpy(d, get_segment_data(segments[i]), segments[i].size);
+		d += segments[i].size;
+	}
+}
+
+const char *NetGameSendArena::get_segment_data(const Segment &segment) const
+{
+	if (segment.external.is_null())
+		return reinterpret_cast<const char *>(&arena[segment.offset]);
+	else
+		return segment.external.get_data();
+}
+
+NetGameReceiveRing::NetGameReceiveRing()
+: buffer(ring_size), read_pos(0), bytes_available(0), scratch(NetGameNetworkData::packet_limit)
+{
+}
+
+char *NetGameReceiveRing::get_write_data(int &out_size)
+{
+	if (bytes_available == 0)
+		read_pos = 0;
+
+	unsigned int write_pos = (read_pos + bytes_available) % ring_size;
+	if (bytes_available == ring_size)
+		out_size = 0;
+	else if (write_pos >= read_pos)
+		out_size = ring_size - write_pos;
+	else
+		out_size = read_pos - write_pos;
+	return buffer.get_data() + write_pos;
+}
+
+void NetGameReceiveRing::commit_write(int size)
+{
+	bytes_available += size;
+}
+
+bool NetGameReceiveRing::next_event(NetGameEventView &out_view)
+{
+	if (bytes_available < 2)
+		return false;
+
+	unsigned short payload_size = 0;
+	copy_out(read_pos, 2, reinterpret_cast<char *>(&payload_size));
+	if (payload_size > NetGameNetworkData::packet_limit)
+		throw Exception("Incoming message too big");
+
+	if (bytes_available < 2u + payload_size)
+		return false;
+
+	unsigned int payload_pos = (read_pos + 2) % ring_size;
+	if (payload_pos + payload_size <= ring_size)
+	{
+		out_view = NetGameEventView(buffer.get_data() + payload_pos, payload_size);
+	}
+	else
+	{
+		copy_out(payload_pos, payload_size, scratch.get_data());
+		out_view = NetGameEventView(scratch.get_data(), payload_size);
+	}
+
+	read_pos = (read_pos + 2 + payload_size) % ring_size;
+	bytes_available -= 2 + payload_size;
+	return true;
+}
+
+void NetGameReceiveRing::copy_out(unsigned int pos, unsigned int size, char *dest) const
+{
+	unsigned int first = min(size, ring_size - pos);
+	memcpy(dest, buffer.get_data() + pos, first);
+	memcpy(dest + first, buffer.get_data(), size - first);
+}
+
 }
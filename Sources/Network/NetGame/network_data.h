@@ -30,12 +30,15 @@
 
 #include "API/Network/NetGame/event.h"
 #include "API/Network/Socket/tcp_connection.h"
+#include "API/Core/System/databuffer.h"
 #include <map>
+#include <vector>
 
 namespace clan
 {
 
-class DataBuffer;
+class NetGameEventView;
+class NetGameSendArena;
 
 class NetGameNetworkData
 {
@@ -43,16 +46,198 @@ public:
 	static NetGameEvent receive_data(const void *data, int size, int &out_bytes_consumed);
 	static DataBuffer send_data(const NetGameEvent &e);
 
-private:
-	static NetGameEvent decode_event(const DataBuffer &data);
-	static DataBuffer encode_event(const NetGameEvent &e);
+	/// \brief Finds the next complete event without copying it
+	///
+	/// \return False if more data is needed
+	static bool receive_view(const void *data, int size, int &out_bytes_consumed, NetGameEventView &out_view);
 
-	static unsigned int get_encoded_length(const NetGameEventValue &value);
-	static unsigned int encode_value(unsigned char *d, const NetGameEventValue &value);
+	/// \brief Serializes an event at the end of a send arena
+	static void send_data(NetGameSendArena &arena, const NetGameEvent &e);
 
-	static NetGameEventValue decode_value(unsigned char type, const unsigned char *d, unsigned int length, unsigned int &pos);
+	/// \brief Checks that an encoded value is valid and moves pos past it
+	static void skip_value(unsigned char type, const unsigned char *d, unsigned int length, unsigned int &pos);
+
+	/// \brief Returns the number of bytes a value is encoded as
+	static unsigned int get_encoded_length(const NetGameEventValue &value);
 
 	enum { packet_limit = 32000 };
+
+private:
+	static void encode_value(NetGameSendArena &arena, const NetGameEventValue &value);
+};
+
+/// \brief Encoded event value read in place
+///
+/// Only valid while the data of the NetGameEventView it came from is.
+class NetGameEventValueView
+{
+public:
+	NetGameEventValueView() : data(0) { }
+	NetGameEventValueView(const unsigned char *data) : data(data) { }
+
+	NetGameEventValue::Type get_type() const;
+
+	unsigned int to_uinteger() const { return *reinterpret_cast<const unsigned int*>(data + 1); }
+	int to_integer() const { return *reinterpret_cast<const int*>(data + 1); }
+	float to_number() const { return *reinterpret_cast<const float*>(data + 1); }
+	bool to_boolean() const { return data[0] == 6; }
+	unsigned char to_ucharacter() const { return data[1]; }
+	char to_character() const { return static_cast<char>(data[1]); }
+
+	/// \brief Returns the characters of a string or the bytes of a binary value
+	const char *get_data() const { return reinterpret_cast<const char*>(data + 3); }
+
+	/// \brief Returns the length of a string or binary value
+	unsigned int get_size() const { return *reinterpret_cast<const unsigned short*>(data + 1); }
+
+	std::string to_string() const { return std::string(get_data(), get_size()); }
+
+	unsigned int get_member_count() const;
+	NetGameEventValueView get_member(unsigned int index) const;
+
+	/// \brief Returns the encoded size of the value, including its type
+	unsigned int get_encoded_length() const;
+
+	/// \brief Copies the value into a NetGameEventValue
+	NetGameEventValue to_value() const;
+
+private:
+	const unsigned char *data;
+};
+
+/// \brief Encoded event read in place, without allocating its values
+///
+/// The event is validated when constructed, so the accessors do no bounds checking.
+/// Only valid while the data it was constructed from is.
+class NetGameEventView
+{
+public:
+	NetGameEventView();
+
+	/// \brief Constructs a view of an event payload, without the packet size in front
+	NetGameEventView(const void *data, unsigned int length);
+
+	std::string get_name() const { return std::string(get_name_data(), get_name_length()); }
+	const char *get_name_data() const { return reinterpret_cast<const char*>(data + 2); }
+	unsigned int get_name_length() const { return *reinterpret_cast<const unsigned short*>(data); }
+
+	/// \brief Compares the name without creating a string
+	bool is_name(const char *name) const;
+
+	unsigned int get_argument_count() const { return argument_count; }
+
+	/// \brief Returns an argument. Reading the arguments in order is a constant time operation.
+	NetGameEventValueView get_argument(unsigned int index) const;
+
+	/// \brief Copies the event into a NetGameEvent
+	NetGameEvent to_event() const;
+
+private:
+	const unsigned char *data;
+	unsigned int argument_count;
+	unsigned int first_argument;
+
+	mutable unsigned int last_index;
+	mutable unsigned int last_offset;
+};
+
+/// \brief Reusable buffer outgoing events are serialized into
+///
+/// Events are written directly into an arena that keeps its memory between batches.
+/// Large binary values are referenced instead of copied, and everything is sent with
+/// a single gathered write.
+class NetGameSendArena
+{
+public:
+	NetGameSendArena();
+
+	/// \brief Returns true if all added data has been sent
+	bool is_empty() const { return bytes_sent == total_size; }
+
+	/// \brief Returns the number of bytes added since the last clear
+	unsigned int get_size() const { return total_size; }
+
+	/// \brief Removes all data, keeping the allocated memory
+	void clear();
+
+	/// \brief Appends space to the arena
+	///
+	/// \return Pointer to the space, valid until the next call to alloc
+	unsigned char *alloc(unsigned int size);
+
+	/// \brief Appends a buffer by reference
+	void add_external(const DataBuffer &buffer);
+
+	/// \brief Sends as much of the pending data as the connection accepts
+	///
+	/// \return Number of bytes written
+	int write(TCPConnection &connection);
+
+	/// \brief Copies the pending data into a buffer
+	void copy_to(DataBuffer &buffer) const;
+
+	/// \brief Binary values at least this large are sent from their own buffer
+	static const unsigned int min_external_size = 1024;
+
+private:
+	struct Segment
+	{
+		Segment() : offset(0), size(0) { }
+
+		/// \brief Offset in the arena. Not used by external segments.
+		unsigned int offset;
+		unsigned int size;
+
+		/// \brief Referenced buffer, or null if the data is in the arena
+		DataBuffer external;
+	};
+
+	const char *get_segment_data(const Segment &segment) const;
+
+	std::vector<unsigned char> arena;
+	unsigned int arena_size;
+	std::vector<Segment> segments;
+	unsigned int total_size;
+	unsigned int bytes_sent;
+	unsigned int current_segment;
+	unsigned int current_segment_offset;
+
+	enum { max_gather_buffers = 64 };
+	const void *gather_data[max_gather_buffers];
+	int gather_sizes[max_gather_buffers];
+};
+
+/// \brief Ring buffer for received data that decodes events where they are
+class NetGameReceiveRing
+{
+public:
+	NetGameReceiveRing();
+
+	/// \brief Returns where the next received data should be written
+	///
+	/// \param out_size = Contiguous free space at the returned location
+	char *get_write_data(int &out_size);
+
+	/// \brief Adds data written to the location returned by get_write_data
+	void commit_write(int size);
+
+	/// \brief Removes the next complete event from the ring
+	///
+	/// The view is valid until more data is written to the ring.
+	/// \return False if more data is needed
+	bool next_event(NetGameEventView &out_view);
+
+private:
+	enum { ring_size = 2 * (NetGameNetworkData::packet_limit + 2) };
+
+	void copy_out(unsigned int pos, unsigned int size, char *dest) const;
+
+	DataBuffer buffer;
+	unsigned int read_pos;
+	unsigned int bytes_available;
+
+	/// \brief Holds events wrapping around the end of the ring
+	DataBuffer scratch;
 };
 
 }
@@ -0,0 +1,193 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Magnus Norddahl
+*/
+
+#include "Network/precomp.h"
+#include "API/Network/NetGame/replica.h"
+#include "API/Network/NetGame/client.h"
+#include "API/Network/NetGame/event.h"
+#include "API/Core/System/exception.h"
+#include "replica_impl.h"
+
+namespace clan
+{
+
+NetGameReplica::NetGameReplica()
+: impl(new NetGameReplica_Impl)
+{
+}
+
+NetGameReplica::~NetGameReplica()
+{
+}
+
+int NetGameReplica::get_tick() const
+{
+	return impl->tick;
+}
+
+std::vector<int> NetGameReplica::get_object_ids() const
+{
+	std::vector<int> object_ids;
+	object_ids.reserve(impl->objects.size());
+	for (std::unordered_map<int, NetGameReplicaObject>::const_iterator it = impl->objects.begin(); it != impl->objects.end(); ++it)
+		object_ids.push_back(it->first);
+	return object_ids;
+}
+
+bool NetGameReplica::has_object(int object_id) const
+{
+	return impl->objects.find(object_id) != impl->objects.end();
+}
+
+int NetGameReplica::get_object_type(int object_id) const
+{
+	return impl->get_object(object_id).type;
+}
+
+int NetGameReplica::get_field_count(int object_id) const
+{
+	return impl->get_object(object_id).fields.size();
+}
+
+const NetGameEventValue &NetGameReplica::get_field(int object_id, int field) const
+{
+	const NetGameReplicaObject &object = impl->get_object(object_id);
+	if (field < 0 || field >= (int) object.fields.size())
+		throw Exception("Field out of bounds");
+	return object.fields[field];
+}
+
+bool NetGameReplica::process_event(const NetGameEvent &e, NetGameClient &client)
+{
+	if (e.get_name() != "_rep")
+		return false;
+
+	int tick = e.get_argument(0).to_integer();
+	bool last = e.get_argument(1).to_boolean();
+
+	unsigned int num_arguments = e.get_argument_count();
+	unsigned int pos = 2;
+	while (pos + 2 <= num_arguments)
+	{
+		int object_id = e.get_argument(pos).to_uinteger();
+		int operation = e.get_argument(pos + 1).to_ucharacter();
+		pos += 2;
+
+		if (operation == 0) // remove
+		{
+			if (impl->objects.erase(object_id) != 0)
+				impl->sig_object_removed.invoke(object_id);
+		}
+		else if (operation == 1) // create
+		{
+			if (pos + 2 > num_arguments)
+				throw Exception("Invalid replication data");
+			int type = e.get_argument(pos).to_integer();
+			unsigned int num_fields = e.get_argument(pos + 1).to_ucharacter();
+			pos += 2;
+			if (pos + num_fields > num_arguments)
+				throw Exception("Invalid replication data");
+
+			bool created = impl->objects.find(object_id) == impl->objects.end();
+			NetGameReplicaObject &object = impl->objects[object_id];
+			object.type = type;
+			object.fields.assign(num_fields, NetGameEventValue(NetGameEventValue::null));
+			for (unsigned int field = 0; field < num_fields; field++)
+				object.fields[field] = e.get_argument(pos++);
+
+			if (created)
+				impl->sig_object_created.invoke(object_id);
+			else
+				impl->sig_object_updated.invoke(object_id);
+		}
+		else if (operation == 2) // update
+		{
+			if (pos + 1 > num_arguments)
+				throw Exception("Invalid replication data");
+			unsigned int mask = e.get_argument(pos++).to_uinteger();
+
+			std::unordered_map<int, NetGameReplicaObject>::iterator it = impl->objects.find(object_id);
+			for (unsigned int field = 0; mask != 0; field++, mask >>= 1)
+			{
+				if (mask & 1)
+				{
+					if (pos >= num_arguments)
+						throw Exception("Invalid replication data");
+					if (it != impl->objects.end() && field < it->second.fields.size())
+						it->second.fields[field] = e.get_argument(pos);
+					pos++;
+				}
+			}
+
+			if (it != impl->objects.end())
+				impl->sig_object_updated.invoke(object_id);
+		}
+		else
+		{
+			throw Exception("Invalid replication data");
+		}
+	}
+
+	if (last)
+	{
+		impl->tick = tick;
+		client.send_event(NetGameEvent("_rep_ack", tick));
+	}
+	return true;
+}
+
+void NetGameReplica::clear()
+{
+	impl->objects.clear();
+	impl->tick = 0;
+}
+
+Signal_v1<int> &NetGameReplica::sig_object_created()
+{
+	return impl->sig_object_created;
+}
+
+Signal_v1<int> &NetGameReplica::sig_object_updated()
+{
+	return impl->sig_object_updated;
+}
+
+Signal_v1<int> &NetGameReplica::sig_object_removed()
+{
+	return impl->sig_object_removed;
+}
+
+const NetGameReplicaObject &NetGameReplica_Impl::get_object(int object_id) const
+{
+	std::unordered_map<int, NetGameReplicaObject>::const_iterator it = objects.find(object_id);
+	if (it == objects.end())
+		throw Exception("Replicated object not found");
+	return it->second;
+}
+
+}
@@ -0,0 +1,62 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Magnus Norddahl
+*/
+
+#pragma once
+
+#include "API/Network/NetGame/replica.h"
+#include "API/Network/NetGame/event_value.h"
+#include <unordered_map>
+
+namespace clan
+{
+
+/// \brief Object received by NetGameReplica
+struct NetGameReplicaObject
+{
+	NetGameReplicaObject() : type(0) { }
+
+	int type;
+	std::vector<NetGameEventValue> fields;
+};
+
+class NetGameReplica_Impl
+{
+public:
+	NetGameReplica_Impl() : tick(0) { }
+
+	const NetGameReplicaObject &get_object(int object_id) const;
+
+	int tick;
+	std::unordered_map<int, NetGameReplicaObject> objects;
+
+	Signal_v1<int> sig_object_created;
+	Signal_v1<int> sig_object_updated;
+	Signal_v1<int> sig_object_removed;
+};
+
+}
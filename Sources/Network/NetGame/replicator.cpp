@@ -0,0 +1,457 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Magnus Norddahl
+*/
+
+#include "Network/precomp.h"
+#include "API/Network/NetGame/replicator.h"
+#include "API/Network/NetGame/connection.h"
+#include "API/Core/System/exception.h"
+#include "API/Core/System/system.h"
+#include "API/Core/Math/cl_math.h"
+#include "replicator_impl.h"
+#include "network_data.h"
+#include <cmath>
+
+namespace clan
+{
+
+NetGameReplicator::NetGameReplicator(float cell_size)
+: impl(new NetGameReplicator_Impl(cell_size))
+{
+}
+
+NetGameReplicator::~NetGameReplicator()
+{
+}
+
+int NetGameReplicator::get_tick() const
+{
+	return impl->tick;
+}
+
+int NetGameReplicator::get_object_count() const
+{
+	return impl->objects.size();
+}
+
+const NetGameEventValue &NetGameReplicator::get_field(int object_id, int field) const
+{
+	NetGameReplicatedObject &object = impl->get_object(object_id);
+	if (field < 0 || field >= (int) object.fields.size())
+		throw Exception("Field out of bounds");
+	return object.fields[field];
+}
+
+NetGameReplicatorStats NetGameReplicator::get_stats() const
+{
+	return impl->stats;
+}
+
+int NetGameReplicator::create_object(int type, int num_fields, const Pointf &position)
+{
+	if (num_fields < 0 || num_fields > NetGameReplicator_Impl::max_fields)
+		throw Exception("Replicated objects can have at most 32 fields");
+
+	int object_id = impl->next_object_id++;
+	NetGameReplicatedObject &object = impl->objects[object_id];
+	object.id = object_id;
+	object.type = type;
+	object.position = position;
+	object.fields.resize(num_fields, NetGameEventValue(NetGameEventValue::null));
+	object.field_ticks.resize(num_fields, impl->tick + 1);
+	impl->add_to_cell(object);
+	return object_id;
+}
+
+void NetGameReplicator::destroy_object(int object_id)
+{
+	NetGameReplicatedObject &object = impl->get_object(object_id);
+	impl->remove_from_cell(object);
+	impl->objects.erase(object_id);
+}
+
+void NetGameReplicator::set_position(int object_id, const Pointf &position)
+{
+	NetGameReplicatedObject &object = impl->get_object(object_id);
+	int cell_x = (int) std::floor(position.x / impl->cell_size);
+	int cell_y = (int) std::floor(position.y / impl->cell_size);
+	if (impl->get_cell_key(cell_x, cell_y) != object.cell_key)
+	{
+		impl->remove_from_cell(object);
+		object.position = position;
+		impl->add_to_cell(object);
+	}
+	else
+	{
+		object.position = position;
+	}
+}
+
+void NetGameReplicator::set_field(int object_id, int field, const NetGameEventValue &value)
+{
+	NetGameReplicatedObject &object = impl->get_object(object_id);
+	if (field < 0 || field >= (int) object.fields.size())
+		throw Exception("Field out of bounds");
+
+	NetGameEventValue &current = object.fields[field];
+	if (current.get_type() == value.get_type())
+	{
+		switch (value.get_type())
+		{
+		case NetGameEventValue::null:
+			return;
+		case NetGameEventValue::uinteger:
+			if (current.to_uinteger() == value.to_uinteger()) return;
+			break;
+		case NetGameEventValue::integer:
+			if (current.to_integer() == value.to_integer()) return;
+			break;
+		case NetGameEventValue::number:
+			if (current.to_number() == value.to_number()) return;
+			break;
+		case NetGameEventValue::boolean:
+			if (current.to_boolean() == value.to_boolean()) return;
+			break;
+		case NetGameEventValue::string:
+			if (current.to_string() == value.to_string()) return;
+			break;
+		case NetGameEventValue::ucharacter:
+			if (current.to_ucharacter() == value.to_ucharacter()) return;
+			break;
+		case NetGameEventValue::character:
+			if (current.to_character() == value.to_character()) return;
+			break;
+		default:
+			break;
+		}
+	}
+
+	current = value;
+	object.field_ticks[field] = impl->tick + 1;
+}
+
+void NetGameReplicator::add_client(NetGameConnection *connection)
+{
+	NetGameReplicatorClient &client = impl->clients[connection];
+	client = NetGameReplicatorClient();
+	client.connection = connection;
+}
+
+void NetGameReplicator::remove_client(NetGameConnection *connection)
+{
+	impl->clients.erase(connection);
+}
+
+void NetGameReplicator::set_client_view(NetGameConnection *connection, const Pointf &position, float radius)
+{
+	NetGameReplicatorClient &client = impl->get_client(connection);
+	client.has_view = true;
+	client.view_position = position;
+	client.view_radius = radius;
+}
+
+void NetGameReplicator::set_client_filter(NetGameConnection *connection, const Callback_2<bool, NetGameConnection *, int> &filter)
+{
+	impl->get_client(connection).filter = filter;
+}
+
+bool NetGameReplicator::process_event(NetGameConnection *connection, const NetGameEvent &e)
+{
+	if (e.get_name() != "_rep_ack")
+		return false;
+
+	std::unordered_map<NetGameConnection *, NetGameReplicatorClient>::iterator it = impl->clients.find(connection);
+	if (it != impl->clients.end())
+		impl->acknowledge(it->second, e.get_argument(0).to_integer());
+	return true;
+}
+
+void NetGameReplicator::update()
+{
+	ubyte64 start_time = System::get_microseconds();
+
+	impl->tick++;
+	impl->stats = NetGameReplicatorStats();
+	impl->stats.tick = impl->tick;
+	impl->stats.clients = impl->clients.size();
+
+	for (std::unordered_map<NetGameConnection *, NetGameReplicatorClient>::iterator it = impl->clients.begin(); it != impl->clients.end(); ++it)
+		impl->update_client(it->second);
+
+	impl->stats.update_time = System::get_microseconds() - start_time;
+}
+
+NetGameReplicator_Impl::NetGameReplicator_Impl(float cell_size)
+: cell_size(cell_size), tick(0), next_object_id(1), next_visible_stamp(0), event_size(0)
+{
+}
+
+NetGameReplicatedObject &NetGameReplicator_Impl::get_object(int object_id)
+{
+	std::unordered_map<int, NetGameReplicatedObject>::iterator it = objects.find(object_id);
+	if (it == objects.end())
+		throw Exception("Replicated object not found");
+	return it->second;
+}
+
+NetGameReplicatorClient &NetGameReplicator_Impl::get_client(NetGameConnection *connection)
+{
+	std::unordered_map<NetGameConnection *, NetGameReplicatorClient>::iterator it = clients.find(connection);
+	if (it == clients.end())
+		throw Exception("Connection is not a replication client");
+	return it->second;
+}
+
+void NetGameReplicator_Impl::add_to_cell(NetGameReplicatedObject &object)
+{
+	int cell_x = (int) std::floor(object.position.x / cell_size);
+	int cell_y = (int) std::floor(object.position.y / cell_size);
+	object.cell_key = get_cell_key(cell_x, cell_y);
+	std::vector<NetGameReplicatedObject *> &cell = cells[object.cell_key];
+	object.cell_index = cell.size();
+	cell.push_back(&object);
+}
+
+void NetGameReplicator_Impl::remove_from_cell(NetGameReplicatedObject &object)
+{
+	std::unordered_map<ubyte64, std::vector<NetGameReplicatedObject *> >::iterator it = cells.find(object.cell_key);
+	std::vector<NetGameReplicatedObject *> &cell = it->second;
+	cell[object.cell_index] = cell.back();
+	cell[object.cell_index]->cell_index = object.cell_index;
+	cell.pop_back();
+	if (cell.empty())
+		cells.erase(it);
+}
+
+void NetGameReplicator_Impl::find_visible_objects(NetGameReplicatorClient &client)
+{
+	visible_objects.clear();
+	if (client.has_view)
+	{
+		float radius = client.view_radius;
+		float radius2 = radius * radius;
+		int cell_x0 = (int) std::floor((client.view_position.x - radius) / cell_size);
+		int cell_y0 = (int) std::floor((client.view_position.y - radius) / cell_size);
+		int cell_x1 = (int) std::floor((client.view_position.x + radius) / cell_size);
+		int cell_y1 = (int) std::floor((client.view_position.y + radius) / cell_size);
+		for (int cell_y = cell_y0; cell_y <= cell_y1; cell_y++)
+		{
+			for (int cell_x = cell_x0; cell_x <= cell_x1; cell_x++)
+			{
+				std::unordered_map<ubyte64, std::vector<NetGameReplicatedObject *> >::iterator it = cells.find(get_cell_key(cell_x, cell_y));
+				if (it == cells.end())
+					continue;
+
+				std::vector<NetGameReplicatedObject *> &cell = it->second;
+				for (size_t i = 0; i < cell.size(); i++)
+				{
+					float dx = cell[i]->position.x - client.view_position.x;
+					float dy = cell[i]->position.y - client.view_position.y;
+					if (dx * dx + dy * dy <= radius2 && (client.filter.is_null() || client.filter.invoke(client.connection, cell[i]->id)))
+						visible_objects.push_back(cell[i]);
+				}
+			}
+		}
+	}
+	else if (!client.filter.is_null())
+	{
+		for (std::unordered_map<int, NetGameReplicatedObject>::iterator it = objects.begin(); it != objects.end(); ++it)
+		{
+			if (client.filter.invoke(client.connection, it->first))
+				visible_objects.push_back(&it->second);
+		}
+	}
+}
+
+void NetGameReplicator_Impl::update_client(NetGameReplicatorClient &client)
+{
+	next_visible_stamp++;
+	if (next_visible_stamp == 0)
+		next_visible_stamp++;
+
+	find_visible_objects(client);
+	for (size_t i = 0; i < visible_objects.size(); i++)
+		visible_objects[i]->visible_stamp = next_visible_stamp;
+	stats.visible_objects += visible_objects.size();
+
+	NetGameReplicatorSnapshot snapshot;
+	snapshot.tick = tick;
+	event_values.clear();
+	event_size = 0;
+
+	for (size_t i = 0; i < visible_objects.size(); i++)
+	{
+		NetGameReplicatedObject &object = *visible_objects[i];
+
+		std::unordered_map<int, NetGameReplicatorClientObject>::iterator it = client.objects.find(object.id);
+		if (it == client.objects.end())
+		{
+			it = client.objects.insert(std::pair<int, NetGameReplicatorClientObject>(object.id, NetGameReplicatorClientObject())).first;
+			it->second.sent_tick = tick;
+		}
+		else if (it->second.removing)
+		{
+			// Visible again before the client acknowledged the removal
+			it->second = NetGameReplicatorClientObject();
+			it->second.sent_tick = tick;
+		}
+
+		int num_fields = object.fields.size();
+		if (it->second.baseline_tick < 0)
+		{
+			// Create record: id, 1, type, field count, all fields
+			unsigned int size = 5 + 2 + 5 + 2;
+			for (int field = 0; field < num_fields; field++)
+				size += NetGameNetworkData::get_encoded_length(object.fields[field]);
+			reserve_event_space(client, size);
+
+			event_values.push_back(NetGameEventValue((unsigned int) object.id));
+			event_values.push_back(NetGameEventValue((unsigned char) 1));
+			event_values.push_back(NetGameEventValue(object.type));
+			event_values.push_back(NetGameEventValue((unsigned char) num_fields));
+			for (int field = 0; field < num_fields; field++)
+				event_values.push_back(object.fields[field]);
+			event_size += size;
+			stats.fields_sent += num_fields;
+		}
+		else
+		{
+			// Update record: id, 2, mask of changed fields, changed fields
+			int baseline_tick = it->second.baseline_tick;
+			unsigned int mask = 0;
+			unsigned int size = 5 + 2 + 5;
+			for (int field = 0; field < num_fields; field++)
+			{
+				if (object.field_ticks[field] > baseline_tick)
+				{
+					mask |= 1 << field;
+					size += NetGameNetworkData::get_encoded_length(object.fields[field]);
+				}
+			}
+			if (mask == 0)
+				continue;
+			reserve_event_space(client, size);
+
+			event_values.push_back(NetGameEventValue((unsigned int) object.id));
+			event_values.push_back(NetGameEventValue((unsigned char) 2));
+			event_values.push_back(NetGameEventValue(mask));
+			for (int field = 0; field < num_fields; field++)
+			{
+				if (mask & (1 << field))
+				{
+					event_values.push_back(object.fields[field]);
+					stats.fields_sent++;
+				}
+			}
+			event_size += size;
+		}
+
+		snapshot.sent_objects.push_back(object.id);
+		stats.objects_sent++;
+	}
+
+	for (std::unordered_map<int, NetGameReplicatorClientObject>::iterator it = client.objects.begin(); it != client.objects.end(); ++it)
+	{
+		std::unordered_map<int, NetGameReplicatedObject>::iterator it_object = objects.find(it->first);
+		if (it_object != objects.end() && it_object->second.visible_stamp == next_visible_stamp)
+			continue;
+
+		if (!it->second.removing)
+		{
+			it->second.removing = true;
+			it->second.remove_tick = tick;
+		}
+
+		// Remove record: id, 0
+		reserve_event_space(client, 5 + 2);
+		event_values.push_back(NetGameEventValue((unsigned int) it->first));
+		event_values.push_back(NetGameEventValue((unsigned char) 0));
+		event_size += 5 + 2;
+
+		snapshot.removed_objects.push_back(it->first);
+		stats.objects_removed++;
+	}
+
+	if (!snapshot.sent_objects.empty() || !snapshot.removed_objects.empty())
+	{
+		send_event(client, true);
+
+		client.snapshots.push_back(snapshot);
+		if (client.snapshots.size() > max_snapshots)
+			client.snapshots.pop_front();
+	}
+}
+
+void NetGameReplicator_Impl::reserve_event_space(NetGameReplicatorClient &client, unsigned int size)
+{
+	if (!event_values.empty() && event_size + size > max_event_size)
+		send_event(client, false);
+}
+
+void NetGameReplicator_Impl::send_event(NetGameReplicatorClient &client, bool last)
+{
+	NetGameEvent e("_rep", tick, NetGameEventValue(last));
+	for (size_t i = 0; i < event_values.size(); i++)
+		e.add_argument(event_values[i]);
+	client.connection->send_event(e);
+
+	stats.events_sent++;
+	stats.bytes_sent += 2 + 2 + 4 + 5 + 1 + 1 + event_size;
+
+	event_values.clear();
+	event_size = 0;
+}
+
+void NetGameReplicator_Impl::acknowledge(NetGameReplicatorClient &client, int ack_tick)
+{
+	if (ack_tick <= client.acked_tick)
+		return;
+	client.acked_tick = ack_tick;
+
+	while (!client.snapshots.empty() && client.snapshots.front().tick <= ack_tick)
+	{
+		NetGameReplicatorSnapshot &snapshot = client.snapshots.front();
+
+		for (size_t i = 0; i < snapshot.sent_objects.size(); i++)
+		{
+			std::unordered_map<int, NetGameReplicatorClientObject>::iterator it = client.objects.find(snapshot.sent_objects[i]);
+			if (it != client.objects.end() && !it->second.removing && snapshot.tick >= it->second.sent_tick)
+				it->second.baseline_tick = max(it->second.baseline_tick, snapshot.tick);
+		}
+
+		for (size_t i = 0; i < snapshot.removed_objects.size(); i++)
+		{
+			std::unordered_map<int, NetGameReplicatorClientObject>::iterator it = client.objects.find(snapshot.removed_objects[i]);
+			if (it != client.objects.end() && it->second.removing && snapshot.tick >= it->second.remove_tick)
+				client.objects.erase(it);
+		}
+
+		client.snapshots.pop_front();
+	}
+}
+
+}
@@ -0,0 +1,155 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Magnus Norddahl
+*/
+
+#pragma once
+
+#include "API/Network/NetGame/replicator.h"
+#include "API/Network/NetGame/event.h"
+#include "API/Network/NetGame/event_value.h"
+#include <unordered_map>
+#include <vector>
+#include <deque>
+
+namespace clan
+{
+
+/// \brief Object replicated by NetGameReplicator
+class NetGameReplicatedObject
+{
+public:
+	NetGameReplicatedObject() : id(0), type(0), cell_key(0), cell_index(0), visible_stamp(0) { }
+
+	int id;
+	int type;
+	Pointf position;
+
+	/// \brief Grid cell the object is in, and its index in the cell
+	ubyte64 cell_key;
+	unsigned int cell_index;
+
+	std::vector<NetGameEventValue> fields;
+
+	/// \brief Tick each field was last changed in
+	std::vector<int> field_ticks;
+
+	/// \brief Set to the stamp of the client being updated when the object is visible to it
+	unsigned int visible_stamp;
+};
+
+/// \brief Replication state of an object a client may have
+struct NetGameReplicatorClientObject
+{
+	NetGameReplicatorClientObject() : baseline_tick(-1), sent_tick(0), removing(false), remove_tick(0) { }
+
+	/// \brief Last acknowledged snapshot containing the object, or -1 if the client has not acknowledged its creation
+	int baseline_tick;
+
+	/// \brief Tick the object was first sent, or sent again after being removed
+	int sent_tick;
+
+	bool removing;
+	int remove_tick;
+};
+
+/// \brief Objects sent in a snapshot that has not been acknowledged yet
+struct NetGameReplicatorSnapshot
+{
+	int tick;
+	std::vector<int> sent_objects;
+	std::vector<int> removed_objects;
+};
+
+/// \brief Client of a NetGameReplicator
+class NetGameReplicatorClient
+{
+public:
+	NetGameReplicatorClient() : connection(0), has_view(false), view_radius(0.0f), acked_tick(0) { }
+
+	NetGameConnection *connection;
+
+	bool has_view;
+	Pointf view_position;
+	float view_radius;
+	Callback_2<bool, NetGameConnection *, int> filter;
+
+	int acked_tick;
+	std::unordered_map<int, NetGameReplicatorClientObject> objects;
+	std::deque<NetGameReplicatorSnapshot> snapshots;
+};
+
+class NetGameReplicator_Impl
+{
+public:
+	NetGameReplicator_Impl(float cell_size);
+
+	NetGameReplicatedObject &get_object(int object_id);
+	NetGameReplicatorClient &get_client(NetGameConnection *connection);
+
+	void add_to_cell(NetGameReplicatedObject &object);
+	void remove_from_cell(NetGameReplicatedObject &object);
+	ubyte64 get_cell_key(int cell_x, int cell_y) const { return (((ubyte64) (unsigned int) cell_x) << 32) | (unsigned int) cell_y; }
+
+	void update_client(NetGameReplicatorClient &client);
+	void find_visible_objects(NetGameReplicatorClient &client);
+	void acknowledge(NetGameReplicatorClient &client, int tick);
+
+	/// \brief Starts a new snapshot event if the current one is full
+	void reserve_event_space(NetGameReplicatorClient &client, unsigned int size);
+	void send_event(NetGameReplicatorClient &client, bool last);
+
+	float cell_size;
+	int tick;
+	int next_object_id;
+	unsigned int next_visible_stamp;
+
+	std::unordered_map<int, NetGameReplicatedObject> objects;
+
+	/// \brief Objects in each grid cell. Object addresses are stable in the unordered_map.
+	std::unordered_map<ubyte64, std::vector<NetGameReplicatedObject *> > cells;
+
+	std::unordered_map<NetGameConnection *, NetGameReplicatorClient> clients;
+
+	NetGameReplicatorStats stats;
+
+	/// \brief Records of the snapshot event being built and its approximate size
+	std::vector<NetGameEventValue> event_values;
+	unsigned int event_size;
+
+	/// \brief Objects visible to the client being updated
+	std::vector<NetGameReplicatedObject *> visible_objects;
+
+	/// \brief Largest number of snapshots kept for a client that does not acknowledge them
+	static const unsigned int max_snapshots = 64;
+
+	/// \brief Size snapshot events are split at, leaving room below the packet limit
+	static const unsigned int max_event_size = 30000;
+
+	static const int max_fields = 32;
+};
+
+}
@@ -32,6 +32,7 @@
 #include "API/Network/Socket/socket_name.h"
 #include "network_event.h"
 #include "server_impl.h"
+#include "udp_host.h"
 #include <algorithm>
 
 namespace clan
@@ -68,6 +69,15 @@ void NetGameServer::send_event(const NetGameEvent &game_event)
 	}
 }
 
+void NetGameServer::send_event(const NetGameEvent &game_event, NetGameChannel channel)
+{
+	MutexSection mutex_lock(&impl->mutex);
+	for (unsigned int i = 0; i < impl->connections.size(); i++)
+	{
+		impl->connections[i]->send_event(game_event, channel);
+	}
+}
+
 void NetGameServer::start(const std::string &port)
 {
 	stop();
@@ -84,17 +94,46 @@ void NetGameServer::start(const std::string &address, const std::string &port)
 	impl->listen_thread.start(this, &NetGameServer::listen_thread_main);
 }
 
+void NetGameServer::start(const std::string &port, NetGameTransport transport)
+{
+	start(std::string(), port, transport);
+}
+
+void NetGameServer::start(const std::string &address, const std::string &port, NetGameTransport transport)
+{
+	if (transport == netgame_transport_udp)
+	{
+		stop();
+		impl->udp_host.reset(new NetGameUDPHost(this, address.empty() ? SocketName(port) : SocketName(address, port), true));
+		impl->udp_host->func_connection_accepted().set(impl.get(), &NetGameServer_Impl::udp_connection_accepted);
+		impl->udp_host->start();
+	}
+	else if (address.empty())
+	{
+		start(port);
+	}
+	else
+	{
+		start(address, port);
+	}
+}
+
 void NetGameServer::stop()
 {
 	impl->stop_event.set();
 	impl->listen_thread.join();
 	impl->tcp_listen.reset();
 
+	// The host thread must be stopped before its connections are destroyed
+	if (impl->udp_host)
+		impl->udp_host->stop();
+
 	for (unsigned int i = 0; i < impl->connections.size(); i++)
 	{
 		delete impl->connections[i];
 	}
 	impl->connections.clear();
+	impl->udp_host.reset();
 }
 
 void NetGameServer::listen_thread_main()
@@ -128,6 +167,12 @@ Signal_v2<NetGameConnection *, const NetGameEvent &> &NetGameServer::sig_event_r
 	return impl->sig_game_event_received; 
 }
 
+void NetGameServer_Impl::udp_connection_accepted(NetGameConnection *connection)
+{
+	MutexSection mutex_lock(&mutex);
+	connections.push_back(connection);
+}
+
 void NetGameServer_Impl::process()
 {
 	MutexSection mutex_lock(&mutex);
@@ -35,14 +35,19 @@
 namespace clan
 {
 
+class NetGameUDPHost;
+
 class NetGameServer_Impl : public KeepAliveObject
 {
 public:
 	void process();
+	void udp_connection_accepted(NetGameConnection *connection);
 
 	std::unique_ptr<TCPListen> tcp_listen;
 	Thread listen_thread;
 
+	std::shared_ptr<NetGameUDPHost> udp_host;
+
 	Mutex mutex;
 	Event stop_event;
 	std::vector<NetGameConnection *> connections;
@@ -0,0 +1,595 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Magnus Norddahl
+*/
+
+#include "Network/precomp.h"
+#include "API/Network/NetGame/connection.h"
+#include "API/Network/NetGame/connection_site.h"
+#include "API/Core/System/system.h"
+#include "network_event.h"
+#include "network_data.h"
+#include "udp_connection_impl.h"
+#include "udp_host.h"
+#include <algorithm>
+
+namespace clan
+{
+
+NetGameUDPConnection_Impl::NetGameUDPConnection_Impl(const std::shared_ptr<NetGameUDPHost> &host, const SocketName &name, bool is_client)
+: host(host), remote_name(name), is_client(is_client), disconnect_requested(false),
+  state(is_client ? state_connecting : state_connected), packet(max_packet_size),
+  start_time(System::get_time()), last_receive_time(start_time), last_send_time(0), last_connect_time(0), disconnect_time(0), ack_pending(false),
+  local_sequence(0), remote_sequence(0), remote_ack_bits(0), remote_sequence_valid(false), round_trip_time(0.0f),
+  sent_packets(sent_packet_window), next_fragment_serial(0),
+  next_ordered_id(1), next_unordered_id(1), last_sequenced_id(0)
+{
+	site = host->get_site();
+	for (int i = 0; i < 3; i++)
+		next_message_id[i] = 1;
+
+	// Packets are matched to connections by the address they come from
+	if (is_client)
+		remote_name = remote_name.to_ipv4();
+}
+
+NetGameUDPConnection_Impl::~NetGameUDPConnection_Impl()
+{
+	MutexSection host_lock(&host->mutex);
+	if (state == state_connected)
+		send_control_packet(packet_disconnect);
+	host_lock.unlock();
+
+	host->remove_connection(this);
+}
+
+void NetGameUDPConnection_Impl::start(NetGameConnection *new_base)
+{
+	base = new_base;
+	host->add_connection(this);
+}
+
+void NetGameUDPConnection_Impl::send_event(const NetGameEvent &game_event, NetGameChannel channel)
+{
+	// Encoded here rather than on the host thread, so an event too big to send throws to the caller
+	MutexSection mutex_lock(&mutex);
+	encode_arena.clear();
+	NetGameNetworkData::send_data(encode_arena, game_event);
+	Message message;
+	encode_arena.copy_to(message.data);
+	message.channel = channel;
+	send_queue.push_back(message);
+	mutex_lock.unlock();
+	host->wakeup();
+}
+
+void NetGameUDPConnection_Impl::disconnect()
+{
+	MutexSection mutex_lock(&mutex);
+	disconnect_requested = true;
+	mutex_lock.unlock();
+	host->wakeup();
+}
+
+SocketName NetGameUDPConnection_Impl::get_remote_name() const
+{
+	return remote_name;
+}
+
+bool NetGameUDPConnection_Impl::read_packet_type(const unsigned char *data, int size, PacketType &out_type)
+{
+	if (size < packet_header_size)
+		return false;
+
+	unsigned int magic = 0;
+	memcpy(&magic, data, 4);
+	if (magic != protocol_magic || data[12] > packet_disconnect)
+		return false;
+
+	out_type = static_cast<PacketType>(data[12]);
+	return true;
+}
+
+void NetGameUDPConnection_Impl::packet_received(const unsigned char *data, int size, ubyte64 time, std::vector<NetGameNetworkEvent> &out_events)
+{
+	PacketType type;
+	if (state == state_closed || !read_packet_type(data, size, type))
+		return;
+
+	last_receive_time = time;
+
+	if (type == packet_connect)
+	{
+		// The accept packet was lost
+		if (!is_client)
+			send_control_packet(packet_accept);
+		return;
+	}
+	else if (type == packet_disconnect)
+	{
+		close(std::string(), out_events);
+		return;
+	}
+
+	if (state == state_connecting)
+	{
+		// Data arriving before the accept packet also means the server accepted us
+		state = state_connected;
+		out_events.push_back(NetGameNetworkEvent(base, NetGameNetworkEvent::client_connected));
+	}
+
+	if (type != packet_data)
+		return;
+
+	unsigned short sequence, ack;
+	unsigned int ack_bits;
+	memcpy(&sequence, data + 4, 2);
+	memcpy(&ack, data + 6, 2);
+	memcpy(&ack_bits, data + 8, 4);
+
+	bool duplicate = !packet_sequence_received(sequence);
+	packets_acknowledged(ack, ack_bits, time);
+	if (duplicate || size == packet_header_size)
+		return;
+
+	ack_pending = true;
+
+	int pos = packet_header_size;
+	while (pos + fragment_header_size <= size)
+	{
+		const unsigned char *fragment = data + pos;
+		unsigned int message_id;
+		unsigned short fragment_size;
+		memcpy(&message_id, fragment + 1, 4);
+		memcpy(&fragment_size, fragment + 7, 2);
+		unsigned char channel = fragment[0];
+		unsigned int fragment_index = fragment[5];
+		unsigned int fragment_count = fragment[6];
+
+		pos += fragment_header_size;
+		if (channel > netgame_channel_unreliable_sequenced || fragment_index >= fragment_count || fragment_size > max_fragment_size || pos + fragment_size > size)
+			break;
+
+		fragment_received(channel, message_id, fragment_index, fragment_count, data + pos, fragment_size, out_events);
+		pos += fragment_size;
+	}
+}
+
+void NetGameUDPConnection_Impl::update(ubyte64 time, std::vector<NetGameNetworkEvent> &out_events)
+{
+	if (state == state_closed)
+		return;
+
+	MutexSection mutex_lock(&mutex);
+	send_queue.swap(sending_queue);
+	bool disconnect = disconnect_requested;
+	mutex_lock.unlock();
+
+	for (unsigned int i = 0; i < sending_queue.size(); i++)
+		queue_message(sending_queue[i]);
+	sending_queue.clear();
+
+	if (state == state_connecting)
+	{
+		if (disconnect)
+		{
+			close(std::string(), out_events);
+		}
+		else if (time - start_time > connection_timeout)
+		{
+			close("Connection timed out", out_events);
+		}
+		else if (time - last_connect_time >= connect_interval)
+		{
+			send_control_packet(packet_connect);
+			last_connect_time = time;
+		}
+		return;
+	}
+
+	if (time - last_receive_time > connection_timeout)
+	{
+		close("Connection timed out", out_events);
+		return;
+	}
+
+	send_fragments(time);
+
+	// Reliable events queued before the disconnect are delivered first, unless the remote end stops acknowledging them
+	if (disconnect && disconnect_time == 0)
+		disconnect_time = time;
+	if (disconnect && (reliable_fragments.empty() || time - disconnect_time >= disconnect_flush_timeout))
+	{
+		send_control_packet(packet_disconnect);
+		close(std::string(), out_events);
+	}
+	else if (ack_pending || time - last_send_time >= keep_alive_interval)
+	{
+		send_data_packet(packet_header_size, time);
+	}
+}
+
+void NetGameUDPConnection_Impl::queue_message(const Message &message)
+{
+	// send_data limits events to packet_limit bytes, far fewer than the 255 fragments the header allows
+	const DataBuffer &encoded = message.data;
+	unsigned int size = encoded.get_size();
+	unsigned int fragment_count = (size + max_fragment_size - 1) / max_fragment_size;
+
+	unsigned char channel = static_cast<unsigned char>(message.channel);
+	unsigned int message_id = next_message_id[channel]++;
+	for (unsigned int i = 0; i < fragment_count; i++)
+	{
+		OutgoingFragment fragment;
+		fragment.channel = channel;
+		fragment.message_id = message_id;
+		fragment.fragment_index = i;
+		fragment.fragment_count = fragment_count;
+		fragment.message = encoded;
+		fragment.offset = i * max_fragment_size;
+		fragment.size = std::min(size - fragment.offset, (unsigned int)max_fragment_size);
+
+		if (message.channel == netgame_channel_unreliable_sequenced)
+			unreliable_fragments.push_back(fragment);
+		else
+			reliable_fragments[next_fragment_serial++] = fragment;
+	}
+}
+
+void NetGameUDPConnection_Impl::send_fragments(ubyte64 time)
+{
+	unsigned int resend_timeout = get_resend_timeout();
+	unsigned int pos = packet_header_size;
+	int packets_sent = 0;
+
+	// Reliable fragments go first, oldest first, so resends are not starved by new events
+	for (std::map<unsigned int, OutgoingFragment>::iterator it = reliable_fragments.begin(); it != reliable_fragments.end(); ++it)
+	{
+		OutgoingFragment &fragment = it->second;
+		if (fragment.send_time != 0 && time - fragment.send_time < resend_timeout)
+			continue;
+
+		if (pos + fragment_header_size + fragment.size > max_packet_size)
+		{
+			send_data_packet(pos, time);
+			pos = packet_header_size;
+			if (++packets_sent == max_packets_per_update)
+				return;
+		}
+
+		unsigned char *d = &packet[pos];
+		unsigned short fragment_size = fragment.size;
+		d[0] = fragment.channel;
+		memcpy(d + 1, &fragment.message_id, 4);
+		d[5] = fragment.fragment_index;
+		d[6] = fragment.fragment_count;
+		memcpy(d + 7, &fragment_size, 2);
+		memcpy(d + fragment_header_size, fragment.message.get_data() + fragment.offset, fragment.size);
+		pos += fragment_header_size + fragment.size;
+
+		fragment.send_time = time;
+		packet_fragments.push_back(it->first);
+	}
+
+	unsigned int unreliable_sent = 0;
+	for (; unreliable_sent < unreliable_fragments.size(); unreliable_sent++)
+	{
+		const OutgoingFragment &fragment = unreliable_fragments[unreliable_sent];
+		if (pos + fragment_header_size + fragment.size > max_packet_size)
+		{
+			send_data_packet(pos, time);
+			pos = packet_header_size;
+			if (++packets_sent == max_packets_per_update)
+				break;
+		}
+
+		unsigned char *d = &packet[pos];
+		unsigned short fragment_size = fragment.size;
+		d[0] = fragment.channel;
+		memcpy(d + 1, &fragment.message_id, 4);
+		d[5] = fragment.fragment_index;
+		d[6] = fragment.fragment_count;
+		memcpy(d + 7, &fragment_size, 2);
+		memcpy(d + fragment_header_size, fragment.message.get_data() + fragment.offset, fragment.size);
+		pos += fragment_header_size + fragment.size;
+	}
+	unreliable_fragments.erase(unreliable_fragments.begin(), unreliable_fragments.begin() + unreliable_sent);
+
+	if (pos > packet_header_size)
+		send_data_packet(pos, time);
+}
+
+void NetGameUDPConnection_Impl::send_data_packet(unsigned int size, ubyte64 time)
+{
+	local_sequence++;
+	write_header(packet_data, local_sequence);
+
+	// A packet still waiting for its ack when its slot is reused is too old to ever be acknowledged
+	SentPacket &sent_packet = sent_packets[local_sequence % sent_packet_window];
+	if (sent_packet.valid)
+		packet_lost(sent_packet);
+	sent_packet.valid = true;
+	sent_packet.sequence = local_sequence;
+	sent_packet.send_time = time;
+	sent_packet.fragments.swap(packet_fragments);
+	packet_fragments.clear();
+
+	host->send_packet(&packet[0], size, remote_name);
+	last_send_time = time;
+	ack_pending = false;
+}
+
+void NetGameUDPConnection_Impl::send_control_packet(PacketType type)
+{
+	write_header(type, 0);
+	host->send_packet(&packet[0], packet_header_size, remote_name);
+}
+
+void NetGameUDPConnection_Impl::write_header(PacketType type, unsigned short sequence)
+{
+	unsigned char *d = &packet[0];
+	unsigned int magic = protocol_magic;
+	memcpy(d, &magic, 4);
+	memcpy(d + 4, &sequence, 2);
+	memcpy(d + 6, &remote_sequence, 2);
+	memcpy(d + 8, &remote_ack_bits, 4);
+	d[12] = type;
+}
+
+void NetGameUDPConnection_Impl::close(const std::string &reason, std::vector<NetGameNetworkEvent> &out_events)
+{
+	state = state_closed;
+	reliable_fragments.clear();
+	unreliable_fragments.clear();
+	early_ordered_messages.clear();
+	incoming_messages.clear();
+	out_events.push_back(NetGameNetworkEvent(base, NetGameNetworkEvent::client_disconnected, NetGameEvent(reason)));
+}
+
+bool NetGameUDPConnection_Impl::packet_sequence_received(unsigned short sequence)
+{
+	if (!remote_sequence_valid)
+	{
+		remote_sequence = sequence;
+		remote_ack_bits = 0;
+		remote_sequence_valid = true;
+		return true;
+	}
+
+	int delta = sequence_delta(sequence, remote_sequence);
+	if (delta > 0)
+	{
+		// Bit n of remote_ack_bits acknowledges remote_sequence - 1 - n
+		if (delta > 32)
+			remote_ack_bits = 0;
+		else
+			remote_ack_bits = ((delta == 32) ? 0 : (remote_ack_bits << delta)) | (1u << (delta - 1));
+		remote_sequence = sequence;
+		return true;
+	}
+	else if (delta < 0 && delta >= -32)
+	{
+		unsigned int bit = 1u << (-delta - 1);
+		if (remote_ack_bits & bit)
+			return false;
+		remote_ack_bits |= bit;
+		return true;
+	}
+	else
+	{
+		// Duplicate, or too old to be acknowledged
+		return false;
+	}
+}
+
+void NetGameUDPConnection_Impl::packets_acknowledged(unsigned short ack, unsigned int ack_bits, ubyte64 time)
+{
+	for (int i = 0; i <= 32; i++)
+	{
+		unsigned short sequence = ack - i;
+		SentPacket &sent_packet = sent_packets[sequence % sent_packet_window];
+		if (!sent_packet.valid || sent_packet.sequence != sequence || sequence_delta(local_sequence, sequence) < 0)
+			continue;
+
+		bool acked = (i == 0) || (ack_bits & (1u << (i - 1)));
+		if (acked)
+		{
+			float packet_rtt = (float)(time - sent_packet.send_time);
+			round_trip_time = (round_trip_time == 0.0f) ? packet_rtt : round_trip_time + (packet_rtt - round_trip_time) * 0.1f;
+
+			for (unsigned int j = 0; j < sent_packet.fragments.size(); j++)
+				reliable_fragments.erase(sent_packet.fragments[j]);
+			sent_packet.fragments.clear();
+			sent_packet.valid = false;
+		}
+		else if (i >= fast_resend_gap)
+		{
+			// Newer packets arrived, so this one most likely got lost
+			packet_lost(sent_packet);
+		}
+	}
+}
+
+void NetGameUDPConnection_Impl::packet_lost(SentPacket &sent_packet)
+{
+	for (unsigned int i = 0; i < sent_packet.fragments.size(); i++)
+	{
+		std::map<unsigned int, OutgoingFragment>::iterator it = reliable_fragments.find(sent_packet.fragments[i]);
+		if (it != reliable_fragments.end())
+			it->second.send_time = 0;
+	}
+	sent_packet.fragments.clear();
+	sent_packet.valid = false;
+}
+
+unsigned int NetGameUDPConnection_Impl::get_resend_timeout() const
+{
+	unsigned int timeout = (unsigned int)(round_trip_time * 1.5f) + resend_slack;
+	return timeout < min_resend_timeout ? min_resend_timeout : timeout;
+}
+
+void NetGameUDPConnection_Impl::fragment_received(unsigned char channel, unsigned int message_id, unsigned int fragment_index, unsigned int fragment_count, const unsigned char *data, unsigned int size, std::vector<NetGameNetworkEvent> &out_events)
+{
+	if (is_message_received(channel, message_id))
+		return;
+
+	if (fragment_count == 1)
+	{
+		message_received(channel, message_id, DataBuffer(data, size), out_events);
+		return;
+	}
+
+	// All fragments but the last are full, which tells where each goes
+	if (fragment_index + 1 < fragment_count && size != max_fragment_size)
+		return;
+
+	std::pair<unsigned char, unsigned int> key(channel, message_id);
+	std::map<std::pair<unsigned char, unsigned int>, IncomingMessage>::iterator it = incoming_messages.find(key);
+	if (it == incoming_messages.end())
+	{
+		if (incoming_messages.size() >= max_incoming_messages)
+			return;
+
+		it = incoming_messages.insert(std::make_pair(key, IncomingMessage())).first;
+		it->second.data = DataBuffer(fragment_count * max_fragment_size);
+		it->second.received.resize(fragment_count, false);
+		it->second.fragments_left = fragment_count;
+	}
+
+	IncomingMessage &incoming = it->second;
+	if (incoming.received.size() != fragment_count || incoming.received[fragment_index])
+		return;
+
+	memcpy(incoming.data.get_data() + fragment_index * max_fragment_size, data, size);
+	incoming.received[fragment_index] = true;
+	incoming.fragments_left--;
+	if (fragment_index + 1 == fragment_count)
+		incoming.last_fragment_size = size;
+
+	if (incoming.fragments_left == 0)
+	{
+		DataBuffer message = incoming.data;
+		message.set_size((fragment_count - 1) * max_fragment_size + incoming.last_fragment_size);
+		incoming_messages.erase(it);
+		message_received(channel, message_id, message, out_events);
+	}
+}
+
+bool NetGameUDPConnection_Impl::is_message_received(unsigned char channel, unsigned int message_id) const
+{
+	switch (channel)
+	{
+	case netgame_channel_reliable_ordered:
+		return message_id < next_ordered_id || early_ordered_messages.find(message_id) != early_ordered_messages.end();
+	case netgame_channel_reliable_unordered:
+		return message_id < next_unordered_id || early_unordered_ids.find(message_id) != early_unordered_ids.end();
+	default:
+		return message_id <= last_sequenced_id;
+	}
+}
+
+void NetGameUDPConnection_Impl::message_received(unsigned char channel, unsigned int message_id, const DataBuffer &message, std::vector<NetGameNetworkEvent> &out_events)
+{
+	if (channel == netgame_channel_reliable_ordered)
+	{
+		if (message_id != next_ordered_id)
+		{
+			early_ordered_messages[message_id] = message;
+			return;
+		}
+
+		deliver(message, out_events);
+		next_ordered_id++;
+
+		std::map<unsigned int, DataBuffer>::iterator it = early_ordered_messages.begin();
+		while (it != early_ordered_messages.end() && it->first == next_ordered_id)
+		{
+			deliver(it->second, out_events);
+			early_ordered_messages.erase(it++);
+			next_ordered_id++;
+		}
+	}
+	else if (channel == netgame_channel_reliable_unordered)
+	{
+		deliver(message, out_events);
+		if (message_id == next_unordered_id)
+		{
+			next_unordered_id++;
+			std::set<unsigned int>::iterator it = early_unordered_ids.begin();
+			while (it != early_unordered_ids.end() && *it == next_unordered_id)
+			{
+				early_unordered_ids.erase(it++);
+				next_unordered_id++;
+			}
+		}
+		else
+		{
+			early_unordered_ids.insert(message_id);
+		}
+	}
+	else
+	{
+		deliver(message, out_events);
+		last_sequenced_id = message_id;
+
+		// Partially received events older than this one will never be delivered
+		std::map<std::pair<unsigned char, unsigned int>, IncomingMessage>::iterator it = incoming_messages.begin();
+		while (it != incoming_messages.end())
+		{
+			if (it->first.first == channel && it->first.second < message_id)
+				incoming_messages.erase(it++);
+			else
+				++it;
+		}
+	}
+}
+
+void NetGameUDPConnection_Impl::deliver(const DataBuffer &message, std::vector<NetGameNetworkEvent> &out_events)
+{
+	try
+	{
+		int bytes_consumed = 0;
+		NetGameEventView view;
+		if (NetGameNetworkData::receive_view(message.get_data(), message.get_size(), bytes_consumed, view) && bytes_consumed == (int) message.get_size())
+			out_events.push_back(NetGameNetworkEvent(base, view.to_event()));
+	}
+	catch (const Exception &)
+	{
+		// Malformed events are dropped. Unlike a TCP stream, the rest of the connection is unaffected.
+	}
+}
+
+int NetGameUDPConnection_Impl::sequence_delta(unsigned short s1, unsigned short s2)
+{
+	int delta = (int)s1 - (int)s2;
+	if (delta > 32768)
+		delta -= 65536;
+	else if (delta < -32768)
+		delta += 65536;
+	return delta;
+}
+
+}
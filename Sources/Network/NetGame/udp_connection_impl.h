@@ -0,0 +1,218 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Magnus Norddahl
+*/
+
+#pragma once
+
+#include "connection_impl.h"
+#include "network_data.h"
+#include <map>
+#include <set>
+#include <memory>
+
+namespace clan
+{
+
+class NetGameUDPHost;
+class NetGameNetworkEvent;
+
+/// \brief Connection carrying events over UDP through a NetGameUDPHost
+///
+/// Events are split into fragments small enough to avoid IP fragmentation, and
+/// all fragments waiting to be sent are coalesced into as few datagrams as possible.
+/// Every packet acknowledges the last packet received plus a bitfield of the 32
+/// before it. Fragments of reliable events are sent again when the packet carrying
+/// them is reported missing or is not acknowledged in time.
+class NetGameUDPConnection_Impl : public NetGameConnection_Impl
+{
+public:
+	NetGameUDPConnection_Impl(const std::shared_ptr<NetGameUDPHost> &host, const SocketName &remote_name, bool is_client);
+	~NetGameUDPConnection_Impl();
+
+	/// \brief Registers the connection with its host
+	void start(NetGameConnection *base);
+
+	void send_event(const NetGameEvent &game_event, NetGameChannel channel);
+	void disconnect();
+	SocketName get_remote_name() const;
+
+	enum PacketType
+	{
+		packet_connect,
+		packet_accept,
+		packet_data,
+		packet_disconnect
+	};
+
+	/// \brief Checks the header of a datagram
+	///
+	/// \return False if the datagram is not a NetGame packet
+	static bool read_packet_type(const unsigned char *data, int size, PacketType &out_type);
+
+	/// \brief Processes a packet from the remote end. Host thread only, with the host locked.
+	void packet_received(const unsigned char *data, int size, ubyte64 time, std::vector<NetGameNetworkEvent> &out_events);
+
+	/// \brief Sends queued events, acknowledgements and resends. Host thread only, with the host locked.
+	void update(ubyte64 time, std::vector<NetGameNetworkEvent> &out_events);
+
+	static const int max_packet_size = 1200;
+	static const int packet_header_size = 13;
+	static const int fragment_header_size = 9;
+	static const int max_fragment_size = max_packet_size - packet_header_size - fragment_header_size;
+
+private:
+	enum State
+	{
+		state_connecting,
+		state_connected,
+		state_closed
+	};
+
+	struct Message
+	{
+		Message() : channel(netgame_channel_reliable_ordered) { }
+
+		/// \brief Event encoded by send_event
+		DataBuffer data;
+		NetGameChannel channel;
+	};
+
+	struct OutgoingFragment
+	{
+		OutgoingFragment() : channel(0), fragment_index(0), fragment_count(0), message_id(0), offset(0), size(0), send_time(0) { }
+		unsigned char channel;
+		unsigned char fragment_index;
+		unsigned char fragment_count;
+		unsigned int message_id;
+
+		/// \brief Encoded event, shared by all its fragments
+		DataBuffer message;
+		unsigned int offset;
+		unsigned int size;
+
+		/// \brief When the fragment was last sent, or 0 if it is due
+		ubyte64 send_time;
+	};
+
+	struct SentPacket
+	{
+		SentPacket() : valid(false), sequence(0), send_time(0) { }
+		bool valid;
+		unsigned short sequence;
+		ubyte64 send_time;
+
+		/// \brief Serial numbers of the reliable fragments in the packet
+		std::vector<unsigned int> fragments;
+	};
+
+	struct IncomingMessage
+	{
+		IncomingMessage() : fragments_left(0), last_fragment_size(0) { }
+		DataBuffer data;
+		std::vector<bool> received;
+		unsigned int fragments_left;
+		unsigned int last_fragment_size;
+	};
+
+	void queue_message(const Message &message);
+	void send_fragments(ubyte64 time);
+	void send_data_packet(unsigned int size, ubyte64 time);
+	void send_control_packet(PacketType type);
+	void write_header(PacketType type, unsigned short sequence);
+	void close(const std::string &reason, std::vector<NetGameNetworkEvent> &out_events);
+
+	bool packet_sequence_received(unsigned short sequence);
+	void packets_acknowledged(unsigned short ack, unsigned int ack_bits, ubyte64 time);
+	void packet_lost(SentPacket &packet);
+	unsigned int get_resend_timeout() const;
+
+	void fragment_received(unsigned char channel, unsigned int message_id, unsigned int fragment_index, unsigned int fragment_count, const unsigned char *data, unsigned int size, std::vector<NetGameNetworkEvent> &out_events);
+	bool is_message_received(unsigned char channel, unsigned int message_id) const;
+	void message_received(unsigned char channel, unsigned int message_id, const DataBuffer &message, std::vector<NetGameNetworkEvent> &out_events);
+	void deliver(const DataBuffer &message, std::vector<NetGameNetworkEvent> &out_events);
+
+	static int sequence_delta(unsigned short s1, unsigned short s2);
+
+	std::shared_ptr<NetGameUDPHost> host;
+	SocketName remote_name;
+	bool is_client;
+
+	Mutex mutex;
+	std::vector<Message> send_queue;
+	NetGameSendArena encode_arena;
+	bool disconnect_requested;
+
+	// The rest is only accessed by the host thread:
+	State state;
+	std::vector<Message> sending_queue;
+	std::vector<unsigned char> packet;
+
+	ubyte64 start_time;
+	ubyte64 last_receive_time;
+	ubyte64 last_send_time;
+	ubyte64 last_connect_time;
+
+	/// \brief When the requested disconnect was first seen, or 0
+	ubyte64 disconnect_time;
+	bool ack_pending;
+
+	unsigned short local_sequence;
+	unsigned short remote_sequence;
+	unsigned int remote_ack_bits;
+	bool remote_sequence_valid;
+	float round_trip_time;
+
+	std::vector<SentPacket> sent_packets;
+	std::vector<unsigned int> packet_fragments;
+	unsigned int next_fragment_serial;
+	std::map<unsigned int, OutgoingFragment> reliable_fragments;
+	std::vector<OutgoingFragment> unreliable_fragments;
+	unsigned int next_message_id[3];
+
+	unsigned int next_ordered_id;
+	std::map<unsigned int, DataBuffer> early_ordered_messages;
+	unsigned int next_unordered_id;
+	std::set<unsigned int> early_unordered_ids;
+	unsigned int last_sequenced_id;
+	std::map<std::pair<unsigned char, unsigned int>, IncomingMessage> incoming_messages;
+
+	static const unsigned int protocol_magic = (unsigned int)'c' | ((unsigned int)'l' << 8) | ((unsigned int)'a' << 16) | ((unsigned int)'n' << 24);
+	static const int sent_packet_window = 1024;
+	static const int fast_resend_gap = 3;
+	static const int max_packets_per_update = 32;
+	static const int max_incoming_messages = 256;
+	static const unsigned int min_resend_timeout = 40;
+	static const unsigned int resend_slack = 10;
+	static const unsigned int connect_interval = 100;
+	static const unsigned int keep_alive_interval = 250;
+	static const unsigned int connection_timeout = 10000;
+
+	/// \brief How long a requested disconnect waits for reliable events to be acknowledged
+	static const unsigned int disconnect_flush_timeout = 2000;
+};
+
+}
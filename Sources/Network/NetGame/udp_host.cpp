@@ -0,0 +1,162 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Magnus Norddahl
+*/
+
+#include "Network/precomp.h"
+#include "API/Network/NetGame/connection.h"
+#include "API/Network/NetGame/connection_site.h"
+#include "API/Core/System/system.h"
+#include "network_event.h"
+#include "udp_connection_impl.h"
+#include "udp_host.h"
+
+namespace clan
+{
+
+NetGameUDPHost::NetGameUDPHost(NetGameConnectionSite *site, const SocketName &local_name, bool accept_connections)
+: site(site), accept_connections(accept_connections), socket(local_name), receive_buffer(NetGameUDPConnection_Impl::max_packet_size)
+{
+}
+
+NetGameUDPHost::~NetGameUDPHost()
+{
+	stop();
+}
+
+void NetGameUDPHost::start()
+{
+	stop_event.reset();
+	thread.start(this, &NetGameUDPHost::thread_main);
+}
+
+void NetGameUDPHost::stop()
+{
+	stop_event.set();
+	thread.join();
+}
+
+void NetGameUDPHost::add_connection(NetGameUDPConnection_Impl *connection)
+{
+	MutexSection mutex_lock(&mutex);
+	connections[connection->get_remote_name()] = connection;
+	wakeup_event.set();
+}
+
+void NetGameUDPHost::remove_connection(NetGameUDPConnection_Impl *connection)
+{
+	MutexSection mutex_lock(&mutex);
+	std::map<SocketName, NetGameUDPConnection_Impl *>::iterator it = connections.find(connection->get_remote_name());
+	if (it != connections.end() && it->second == connection)
+		connections.erase(it);
+}
+
+void NetGameUDPHost::send_packet(const void *data, int size, const SocketName &to)
+{
+	try
+	{
+		socket.send(data, size, to);
+	}
+	catch (const Exception &)
+	{
+		// Datagrams may be lost anyway. A failed send is handled like a lost packet.
+	}
+}
+
+void NetGameUDPHost::thread_main()
+{
+	std::vector<NetGameNetworkEvent> events;
+	std::vector<NetGameConnection *> accepted;
+	while (true)
+	{
+		Event read_event = socket.get_read_event();
+		int wakeup_reason = Event::wait(stop_event, read_event, wakeup_event, update_interval);
+		if (wakeup_reason == 0)
+			break;
+
+		ubyte64 time = System::get_time();
+
+		MutexSection mutex_lock(&mutex);
+		wakeup_event.reset();
+		receive_packets(time, events);
+		for (std::map<SocketName, NetGameUDPConnection_Impl *>::iterator it = connections.begin(); it != connections.end(); ++it)
+			it->second->update(time, events);
+		accepted.swap(accepted_connections);
+		mutex_lock.unlock();
+
+		// Reported without the lock, as the receivers lock their own mutex and may destroy connections while holding it
+		for (unsigned int i = 0; i < accepted.size(); i++)
+			cb_connection_accepted.invoke(accepted[i]);
+		for (unsigned int i = 0; i < events.size(); i++)
+			site->add_network_event(events[i]);
+		accepted.clear();
+		events.clear();
+	}
+}
+
+void NetGameUDPHost::receive_packets(ubyte64 time, std::vector<NetGameNetworkEvent> &out_events)
+{
+	Event read_event = socket.get_read_event();
+	for (int i = 0; i < max_packets_per_update && Event::wait(read_event, 0) == 0; i++)
+	{
+		SocketName from;
+		int size = 0;
+		try
+		{
+			size = socket.receive(&receive_buffer[0], receive_buffer.size(), from);
+		}
+		catch (const Exception &)
+		{
+			// An ICMP error from an earlier send. The connection it concerns will time out.
+			continue;
+		}
+		packet_received(&receive_buffer[0], size, from, time, out_events);
+	}
+}
+
+void NetGameUDPHost::packet_received(const unsigned char *data, int size, const SocketName &from, ubyte64 time, std::vector<NetGameNetworkEvent> &out_events)
+{
+	std::map<SocketName, NetGameUDPConnection_Impl *>::iterator it = connections.find(from);
+	if (it != connections.end())
+	{
+		it->second->packet_received(data, size, time, out_events);
+		return;
+	}
+
+	NetGameUDPConnection_Impl::PacketType type;
+	if (accept_connections && NetGameUDPConnection_Impl::read_packet_type(data, size, type) && type == NetGameUDPConnection_Impl::packet_connect)
+	{
+		NetGameUDPConnection_Impl *connection_impl = new NetGameUDPConnection_Impl(shared_from_this(), from, false);
+		NetGameConnection *connection = new NetGameConnection(connection_impl);
+		connections[from] = connection_impl;
+		accepted_connections.push_back(connection);
+
+		connection_impl->packet_received(data, size, time, out_events);
+		out_events.push_back(NetGameNetworkEvent(connection, NetGameNetworkEvent::client_connected));
+	}
+}
+
+}
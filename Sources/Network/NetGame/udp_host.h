@@ -0,0 +1,101 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Magnus Norddahl
+*/
+
+#pragma once
+
+#include "API/Network/Socket/udp_socket.h"
+#include "API/Core/Signals/callback_v1.h"
+#include <map>
+#include <memory>
+
+namespace clan
+{
+
+class NetGameConnection;
+class NetGameConnectionSite;
+class NetGameNetworkEvent;
+class NetGameUDPConnection_Impl;
+
+/// \brief UDP socket shared by the NetGame connections of a client or server
+///
+/// A single thread receives all datagrams, hands them to the connection of the
+/// sender and drives resends and acknowledgements of every connection.
+class NetGameUDPHost : public std::enable_shared_from_this<NetGameUDPHost>
+{
+public:
+	/// \brief Constructs a host
+	///
+	/// \param site = Where network events are reported
+	/// \param local_name = Address to bind the socket to
+	/// \param accept_connections = Creates connections for clients that connect, as a server does
+	NetGameUDPHost(NetGameConnectionSite *site, const SocketName &local_name, bool accept_connections);
+	~NetGameUDPHost();
+
+	NetGameConnectionSite *get_site() const { return site; }
+
+	/// \brief Invoked by the host thread for each connection it accepted
+	Callback_v1<NetGameConnection *> &func_connection_accepted() { return cb_connection_accepted; }
+
+	void start();
+	void stop();
+
+	void add_connection(NetGameUDPConnection_Impl *connection);
+	void remove_connection(NetGameUDPConnection_Impl *connection);
+
+	/// \brief Wakes up the host thread to send queued events
+	void wakeup() { wakeup_event.set(); }
+
+	/// \brief Sends a datagram. Host thread only, or with the host locked.
+	void send_packet(const void *data, int size, const SocketName &to);
+
+	/// \brief Serializes access to the connections
+	Mutex mutex;
+
+private:
+	NetGameUDPHost(const NetGameUDPHost &);
+	NetGameUDPHost &operator =(const NetGameUDPHost &);
+
+	void thread_main();
+	void receive_packets(ubyte64 time, std::vector<NetGameNetworkEvent> &out_events);
+	void packet_received(const unsigned char *data, int size, const SocketName &from, ubyte64 time, std::vector<NetGameNetworkEvent> &out_events);
+
+	NetGameConnectionSite *site;
+	bool accept_connections;
+	UDPSocket socket;
+	Thread thread;
+	Event stop_event, wakeup_event;
+	std::map<SocketName, NetGameUDPConnection_Impl *> connections;
+	std::vector<NetGameConnection *> accepted_connections;
+	std::vector<unsigned char> receive_buffer;
+	Callback_v1<NetGameConnection *> cb_connection_accepted;
+
+	static const int update_interval = 10;
+	static const int max_packets_per_update = 256;
+};
+
+}
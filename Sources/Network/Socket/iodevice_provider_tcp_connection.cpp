@@ -165,6 +165,11 @@ int IODeviceProvider_TCPConnection::send(const void *data, int len, bool send_al
 	}
 }
 
+int IODeviceProvider_TCPConnection::send_gather(const void * const *buffers, const int *sizes, int count)
+{
+	return socket.send_gather(buffers, sizes, count);
+}
+
 int IODeviceProvider_TCPConnection::receive(void *data, int len, bool receive_all)
 {
 	if (!receive_all)
@@ -81,6 +81,7 @@ public:
 	void set_nodelay(bool enable);
 	void set_keep_alive(bool enable, int timeout, int interval);
 	int send(const void *data, int len, bool send_all);
+	int send_gather(const void * const *buffers, const int *sizes, int count);
 	int receive(void *data, int len, bool receive_all);
 	int peek(void *data, int len);
 	IODeviceProvider *duplicate();
@@ -141,6 +141,12 @@ void TCPConnection::set_keep_alive(bool enable, int timeout, int interval)
 	provider->set_keep_alive(enable, timeout, interval);
 }
 
+int TCPConnection::write_gather(const void * const *buffers, const int *sizes, int count)
+{
+	IODeviceProvider_TCPConnection *provider = dynamic_cast<IODeviceProvider_TCPConnection*>(impl->provider);
+	return provider->send_gather(buffers, sizes, count);
+}
+
 /////////////////////////////////////////////////////////////////////////////
 // TCPConnection Implementation:
 
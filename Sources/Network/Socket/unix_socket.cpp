@@ -33,7 +33,9 @@
 #include <sys/time.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <sys/ioctl.h>
+#include <poll.h>
 #include <unistd.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
@@ -92,13 +94,12 @@ void UnixSocket::disconnect_graceful(int timeout)
 {
 	shutdown(handle, SHUT_RDWR);
 
-	fd_set rfds;
-	FD_ZERO(&rfds);
-	FD_SET(handle, &rfds);
-	timeval tv;
-	tv.tv_sec = timeout/1000;
-	tv.tv_usec = (timeout%1000)*1000;
-	select(handle+1, &rfds, 0, 0, &tv);
+	// poll() rather than select() so handles above FD_SETSIZE are safe
+	pollfd poll_handle;
+	poll_handle.fd = handle;
+	poll_handle.events = POLLIN;
+	poll_handle.revents = 0;
+	poll(&poll_handle, 1, timeout);
 
 	close_handle();
 }
@@ -284,6 +285,41 @@ int UnixSocket::send(const void *data, int size)
 	}
 }
 
+int UnixSocket::send_gather(const void * const *buffers, const int *sizes, int count)
+{
+	iovec iov[max_gather_buffers];
+	if (count > max_gather_buffers)
+		count = max_gather_buffers;
+	for (int i = 0; i < count; i++)
+	{
+		iov[i].iov_base = const_cast<void *>(buffers[i]);
+		iov[i].iov_len = sizes[i];
+	}
+
+	msghdr message;
+	memset(&message, 0, sizeof(msghdr));
+	message.msg_iov = iov;
+	message.msg_iovlen = count;
+
+	int result = ::sendmsg(handle, &message, 0);
+	if (result == -1)
+	{
+		int errorcode = errno;
+		if (errorcode == EWOULDBLOCK)
+		{
+			return 0;
+		}
+		else
+		{
+			throw Exception(error_to_string(errorcode));
+		}
+	}
+	else
+	{
+		return result;
+	}
+}
+
 int UnixSocket::send_to(const void *data, int size, const SocketName &socketname)
 {
 	sockaddr_in addr;
@@ -309,6 +309,38 @@ int Win32Socket::send(const void *data, int size)
 	}
 }
 
+int Win32Socket::send_gather(const void * const *buffers, const int *sizes, int count)
+{
+	WSABUF wsa_buffers[max_gather_buffers];
+	if (count > max_gather_buffers)
+		count = max_gather_buffers;
+	for (int i = 0; i < count; i++)
+	{
+		wsa_buffers[i].buf = (CHAR *) buffers[i];
+		wsa_buffers[i].len = sizes[i];
+	}
+
+	DWORD bytes_sent = 0;
+	int result = WSASend(handle, wsa_buffers, count, &bytes_sent, 0, 0, 0);
+	if (result == SOCKET_ERROR)
+	{
+		int errorcode = WSAGetLastError();
+		if (errorcode == WSAEWOULDBLOCK)
+		{
+			reset_send();
+			return 0;
+		}
+		else
+		{
+			throw Exception(error_to_string(errorcode));
+		}
+	}
+	else
+	{
+		return bytes_sent;
+	}
+}
+
 int Win32Socket::send_to(const void *data, int size, const SocketName &socketname)
 {
 	sockaddr_in addr;
@@ -64,6 +64,7 @@ public:
 	int receive(void *data, int size);
 	int peek(void *data, int size);
 	int send(const void *data, int size);
+	int send_gather(const void * const *buffers, const int *sizes, int count);
 	void close_send();
 
 	int receive_from(void *data, int size, SocketName &out_socketname);
@@ -80,6 +81,9 @@ public:
 	SOCKET get_handle() const { return handle; }
 
 private:
+	/// \brief Most buffers passed to the operating system in one send_gather call
+	static const int max_gather_buffers = 64;
+
 	void create_event_handles();
 	void create_socket_handle(int type);
 	void select_events();
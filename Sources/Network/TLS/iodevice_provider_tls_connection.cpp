@@ -44,7 +44,7 @@ namespace clan
 // IODeviceProvider_TLSConnection Construction:
 
 IODeviceProvider_TLSConnection::IODeviceProvider_TLSConnection()
-	: read_buffer(16*1024), read_buffer_pos(0)
+	: end_of_file(false)
 {
 }
 	
@@ -56,13 +56,23 @@ IODeviceProvider_TLSConnection::~IODeviceProvider_TLSConnection()
 /////////////////////////////////////////////////////////////////////////////
 // IODeviceProvider_TLSConnection Attributes:
 
+bool IODeviceProvider_TLSConnection::is_session_resumed() const
+{
+	return tls_client.is_session_resumed();
+}
+
 /////////////////////////////////////////////////////////////////////////////
 // IODeviceProvider_TLSConnection Operations:
 
 void IODeviceProvider_TLSConnection::connect(TCPConnection &device)
 {
 	connected_device = device;
-	read_buffer_pos = 0;
+	tls_client = TLSClient();
+	end_of_file = false;
+
+	// Resume earlier sessions with the same server
+	SocketName remote_name = device.get_remote_name();
+	tls_client.set_session_name(remote_name.get_address() + ":" + remote_name.get_port());
 }
 
 void IODeviceProvider_TLSConnection::disconnect()
@@ -74,31 +84,46 @@ void IODeviceProvider_TLSConnection::disconnect()
 int IODeviceProvider_TLSConnection::send(const void *data, int len, bool send_all)
 {
 	int pos = 0;
-	do
+	while (true)
 	{
-		update_io_buffers(send_all);
-
 		pos += tls_client.encrypt(static_cast<const char*>(data) + pos, len - pos);
 
-		update_io_buffers(send_all);
+		bool progress = update_io_buffers();
+		if (!send_all || pos == len)
+			break;
+		if (!progress)
+			wait_for_device();
+	}
 
-	} while (send_all && pos != len);
+	// Get the data on the wire before returning
+	while (send_all && tls_client.get_encrypted_data_available() != 0)
+	{
+		if (!update_io_buffers())
+			wait_for_device();
+	}
 	return pos;
 }
 
 int IODeviceProvider_TLSConnection::receive(void *data, int len, bool receive_all)
 {
 	int pos = 0;
-	do
+	while (true)
 	{
-		update_io_buffers(receive_all);
-
-		int bytes_available = std::min(tls_client.get_decrypted_data_available(), len);
-		memcpy(static_cast<char*>(data) + pos, tls_client.get_decrypted_data(), bytes_available);
-
-		update_io_buffers(receive_all);
-
-	} while (receive_all && pos != len);
+		int bytes_available = std::min(tls_client.get_decrypted_data_available(), len - pos);
+		if (bytes_available > 0)
+		{
+			memcpy(static_cast<char*>(data) + pos, tls_client.get_decrypted_data(), bytes_available);
+			tls_client.decrypted_data_consumed(bytes_available);
+			pos += bytes_available;
+		}
+
+		// Without receive_all, return as soon as there is something, like a blocking socket
+		if (pos == len || end_of_file || (pos > 0 && !receive_all))
+			break;
+
+		if (!update_io_buffers())
+			wait_for_device();
+	}
 	return pos;
 }
 
@@ -115,28 +140,62 @@ IODeviceProvider *IODeviceProvider_TLSConnection::duplicate()
 /////////////////////////////////////////////////////////////////////////////
 // IODeviceProvider_TLSConnection Implementation:
 
-void IODeviceProvider_TLSConnection::update_io_buffers(bool wait)
+bool IODeviceProvider_TLSConnection::update_io_buffers()
 {
+	bool progress = false;
+
 	// Pass on any encrypted data ready to be sent:
-	if (tls_client.get_encrypted_data_available() != 0)
+	if (tls_client.get_encrypted_data_available() != 0 && connected_device.get_write_event().wait(0))
 	{
-		int written = connected_device.write(tls_client.get_encrypted_data(), tls_client.get_encrypted_data_available(), wait);
+		int written = connected_device.write(tls_client.get_encrypted_data(), tls_client.get_encrypted_data_available(), false);
 		tls_client.encrypted_data_consumed(written);
+		progress = progress || written > 0;
 	}
 
-	// Read incoming data:
-	if (read_buffer_pos != read_buffer.get_size())
+	// Read incoming data directly into the TLSClient record buffer, where it is decrypted in place:
+	int buffer_size = 0;
+	void *buffer = tls_client.get_decrypt_buffer(buffer_size);
+	if (buffer_size > 0 && !end_of_file && connected_device.get_read_event().wait(0))
+	{
+		int bytes_read = connected_device.read(buffer, buffer_size, false);
+		if (bytes_read == 0)
+			end_of_file = true;
+		tls_client.decrypt_buffer_filled(bytes_read);
+		progress = true;
+	}
+	else
 	{
-		read_buffer_pos += connected_device.read(read_buffer.get_data() + read_buffer_pos, read_buffer.get_size() - read_buffer_pos, false);
+		// Lets the handshake start before anything is received
+		tls_client.decrypt_buffer_filled(0);
 	}
 
-	// Pass any available incoming data to TLSClient for decryption:
-	if (read_buffer_pos != 0)
+	// A close_notify ends the data just like closing the socket
+	if (tls_client.is_closed())
+		end_of_file = true;
+
+	// The handshake may have queued more data to send
+	if (tls_client.get_encrypted_data_available() != 0 && connected_device.get_write_event().wait(0))
 	{
-		int tcp_bytes_read = tls_client.decrypt(read_buffer.get_data(), read_buffer_pos);
-		memmove(read_buffer.get_data(), read_buffer.get_data() + tcp_bytes_read, read_buffer_pos - tcp_bytes_read);
-		read_buffer_pos = 0;
+		int written = connected_device.write(tls_client.get_encrypted_data(), tls_client.get_encrypted_data_available(), false);
+		tls_client.encrypted_data_consumed(written);
+		progress = progress || written > 0;
 	}
+
+	return progress;
+}
+
+void IODeviceProvider_TLSConnection::wait_for_device()
+{
+	if (end_of_file)
+		throw Exception("TLS connection closed by peer");
+
+	std::vector<Event> events;
+	events.push_back(connected_device.get_read_event());
+	if (tls_client.get_encrypted_data_available() != 0)
+		events.push_back(connected_device.get_write_event());
+
+	if (Event::wait(events, timeout) == -1)
+		throw Exception("TLS connection timed out");
 }
 
 }
@@ -51,6 +51,7 @@ public:
 /// \name Attributes
 /// \{
 public:
+	bool is_session_resumed() const;
 /// \}
 
 /// \name Operations
@@ -67,13 +68,17 @@ public:
 /// \name Implementation
 /// \{
 private:
-	void update_io_buffers(bool wait);
+	/// \brief Moves data between the socket and the TLS client without blocking. Returns true if anything moved.
+	bool update_io_buffers();
+
+	/// \brief Blocks until the socket can be read, or written if there is data to send
+	void wait_for_device();
 
 	TCPConnection connected_device;
 	TLSClient tls_client;
+	bool end_of_file;
 
-	DataBuffer read_buffer;
-	int read_buffer_pos;
+	static const int timeout = 15000;
 /// \}
 };
 
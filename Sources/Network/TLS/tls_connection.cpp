@@ -58,6 +58,12 @@ TLSConnection::~TLSConnection()
 /////////////////////////////////////////////////////////////////////////////
 // TLSConnection Attributes:
 
+bool TLSConnection::is_session_resumed() const
+{
+	IODeviceProvider_TLSConnection *provider = dynamic_cast<IODeviceProvider_TLSConnection*>(impl->provider);
+	return provider->is_session_resumed();
+}
+
 /////////////////////////////////////////////////////////////////////////////
 // TLSConnection Operations:
 
@@ -37,7 +37,12 @@ namespace clan
 // HTTPServer Construction:
 
 HTTPServer::HTTPServer()
-: impl(new HTTPServer_Impl)
+: impl(new HTTPServer_Impl(0))
+{
+}
+
+HTTPServer::HTTPServer(int num_worker_threads)
+: impl(new HTTPServer_Impl(num_worker_threads))
 {
 }
 
@@ -48,12 +53,18 @@ HTTPServer::~HTTPServer()
 /////////////////////////////////////////////////////////////////////////////
 // HTTPServer Attributes:
 
+int HTTPServer::get_max_request_size() const
+{
+	MutexSection mutex_lock(&impl->mutex);
+	return impl->max_request_size;
+}
+
 /////////////////////////////////////////////////////////////////////////////
 // HTTPServer Operations:
 
 void HTTPServer::bind(const SocketName &name)
 {
-	TCPListen tcp_listen(name);
+	TCPListen tcp_listen(name, 128);
 	MutexSection mutex_lock(&impl->mutex);
 	impl->listen_ports.push_back(tcp_listen);
 	impl->update_event.set();
@@ -77,6 +88,12 @@ void HTTPServer::remove_handler(const HTTPRequestHandler &handler)
 	}
 }
 
+void HTTPServer::set_max_request_size(int size)
+{
+	MutexSection mutex_lock(&impl->mutex);
+	impl->max_request_size = size;
+}
+
 /////////////////////////////////////////////////////////////////////////////
 // HTTPServer Implementation:
 
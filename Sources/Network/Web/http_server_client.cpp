@@ -0,0 +1,178 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Magnus Norddahl
+*/
+
+#include "Network/precomp.h"
+#include "http_server_client.h"
+#include "http_server_connection_impl.h"
+#include "API/Core/System/system.h"
+#include "API/Core/Text/string_help.h"
+#include "API/Core/Math/cl_math.h"
+
+namespace clan
+{
+
+/////////////////////////////////////////////////////////////////////////////
+// HTTPServerClient Construction:
+
+HTTPServerClient::HTTPServerClient(const TCPConnection &connection, int id, int max_request_size)
+: connection(connection), id(id), buffer(buffer_size), keep_alive(false), busy(false), closed(false),
+  last_activity(System::get_time()), header_parsed(false), body_received(0), max_request_size(max_request_size)
+{
+}
+
+HTTPServerClient::~HTTPServerClient()
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// HTTPServerClient Attributes:
+
+/////////////////////////////////////////////////////////////////////////////
+// HTTPServerClient Operations:
+
+bool HTTPServerClient::receive()
+{
+	// One receive per wakeup. The event loop waits level-triggered, so any
+	// data left in the socket simply flags the client again.
+	size_t write_size = buffer.get_write_size();
+	if (write_size == 0)
+		return true;
+
+	int received = connection.read(buffer.get_write_pos(), (int) write_size, false);
+	if (received <= 0)
+		return false;
+
+	buffer.write(received);
+	last_activity = System::get_time();
+	return true;
+}
+
+HTTPServerClient::ParseResult HTTPServerClient::parse()
+{
+	if (!header_parsed)
+	{
+		ParseResult result = parse_header();
+		if (result != parse_request)
+			return result;
+	}
+
+	while (body_received < request_data.get_size() && buffer.get_read_size() > 0)
+	{
+		unsigned int available = min((unsigned int) buffer.get_read_size(), request_data.get_size() - body_received);
+		memcpy(request_data.get_data() + body_received, buffer.get_read_pos(), available);
+		buffer.read(available);
+		body_received += available;
+	}
+
+	if (body_received < request_data.get_size())
+		return parse_incomplete;
+
+	header_parsed = false;
+	return parse_request;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// HTTPServerClient Implementation:
+
+HTTPServerClient::ParseResult HTTPServerClient::parse_header()
+{
+	size_t header_length = buffer.find("\r\n\r\n", 4);
+	if (header_length == RingBuffer::npos)
+	{
+		if (buffer.get_length() == buffer.get_capacity())
+			return set_error("431 Request Header Fields Too Large");
+		return parse_incomplete;
+	}
+
+	std::string header = buffer.read_to_string(header_length + 4);
+	std::string::size_type request_line_end = header.find("\r\n");
+	std::string request = header.substr(0, request_line_end);
+	request_headers = header.substr(request_line_end + 2);
+
+	// Extract request command, url and version:
+
+	std::string::size_type pos1 = request.find(' ');
+	if (pos1 == std::string::npos)
+		return set_error("400 Bad Request");
+	request_type = request.substr(0, pos1);
+	if (request_type != "POST" && request_type != "GET")
+		return set_error("501 Not Implemented");
+	std::string::size_type pos2 = request.find(' ', pos1 + 1);
+	if (pos2 == std::string::npos)
+		return set_error("400 Bad Request");
+	request_url = request.substr(pos1+1, pos2-pos1-1);
+	std::string::size_type pos3 = request.find(' ', pos2 + 1);
+	if (pos3 != std::string::npos)
+		return set_error("400 Bad Request");
+	std::string version = request.substr(pos2 + 1);
+
+	std::string connection_value = StringHelp::local8_to_lower(HTTPServerConnection_Impl::get_header_value("Connection", request_headers));
+	if (version == "HTTP/1.1")
+		keep_alive = (connection_value != "close");
+	else
+		keep_alive = (connection_value == "keep-alive");
+
+	// Chunked request bodies are only supported by the thread per connection mode:
+	if (!HTTPServerConnection_Impl::get_header_value("Transfer-Encoding", request_headers).empty())
+		return set_error("501 Not Implemented");
+
+	int content_length = 0;
+	if (request_type == "POST")
+	{
+		std::string str_content_length = HTTPServerConnection_Impl::get_header_value("Content-Length", request_headers);
+		if (str_content_length.empty())
+			return set_error("411 Length Required");
+		content_length = StringHelp::local8_to_int(str_content_length);
+		if (content_length < 0)
+			return set_error("400 Bad Request");
+		if (content_length > max_request_size)
+			return set_error("413 Payload Too Large");
+
+		// The body is read before the handler runs, so answer an expectation right away:
+		std::string expect = StringHelp::local8_to_lower(HTTPServerConnection_Impl::get_header_value("Expect", request_headers));
+		if (expect == "100-continue" && content_length > 0)
+		{
+			std::string continue_response("HTTP/1.1 100 Continue\r\n\r\n");
+			connection.send(continue_response.data(), continue_response.length(), false);
+		}
+	}
+
+	request_data = DataBuffer(content_length);
+	body_received = 0;
+	header_parsed = true;
+	return parse_request;
+}
+
+HTTPServerClient::ParseResult HTTPServerClient::set_error(const std::string &status)
+{
+	error_status = status;
+	keep_alive = false;
+	return parse_error;
+}
+
+}
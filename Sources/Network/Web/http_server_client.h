@@ -0,0 +1,130 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Magnus Norddahl
+*/
+
+#pragma once
+
+#include "API/Network/Socket/tcp_connection.h"
+#include "API/Core/System/databuffer.h"
+#include "ring_buffer.h"
+
+namespace clan
+{
+
+/// \brief Connection state for the event loop mode of HTTPServer.
+///
+/// The event loop thread owns the client while it is idle or receiving.
+/// A worker thread owns it from the moment a parsed request is queued until
+/// the client is handed back to the event loop.
+class HTTPServerClient
+{
+/// \name Construction
+/// \{
+
+public:
+	HTTPServerClient(const TCPConnection &connection, int id, int max_request_size);
+
+	~HTTPServerClient();
+
+
+/// \}
+/// \name Attributes
+/// \{
+
+public:
+	enum ParseResult
+	{
+		parse_incomplete,
+		parse_request,
+		parse_error
+	};
+
+	TCPConnection connection;
+
+	int id;
+
+	RingBuffer buffer;
+
+	std::string request_type;
+
+	std::string request_url;
+
+	std::string request_headers;
+
+	DataBuffer request_data;
+
+	/// \brief True if the connection stays open after the current request
+	bool keep_alive;
+
+	/// \brief Status line sent instead of dispatching the request when parsing failed
+	std::string error_status;
+
+	/// \brief Set while a worker thread owns the client
+	bool busy;
+
+	/// \brief Set when the connection has been disconnected
+	bool closed;
+
+	/// \brief Time of the last received data, used for the idle timeout
+	ubyte64 last_activity;
+
+
+/// \}
+/// \name Operations
+/// \{
+
+public:
+	/// \brief Reads available data from the connection into the ring buffer.
+	///
+	/// \return false if the peer closed the connection
+	bool receive();
+
+	/// \brief Extracts the next request from the ring buffer, if complete.
+	ParseResult parse();
+
+
+/// \}
+/// \name Implementation
+/// \{
+
+private:
+	ParseResult parse_header();
+
+	ParseResult set_error(const std::string &status);
+
+	bool header_parsed;
+
+	unsigned int body_received;
+
+	/// \brief Largest Content-Length accepted before answering 413
+	int max_request_size;
+
+	static const size_t buffer_size = 32*1024;
+/// \}
+};
+
+}
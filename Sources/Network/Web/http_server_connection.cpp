@@ -62,6 +62,7 @@ public:
 	int send(const void *data, int len, bool send_all)
 	{
 		impl.lock()->performed_write = true;
+		impl.lock()->flush_header();
 		return impl.lock()->connection.send(data, len, send_all);
 	}
 
@@ -218,7 +219,7 @@ void HTTPServerConnection::write_response_status(int status_code, const std::str
 	status_line.append(" ");
 	status_line.append(status_text);
 	status_line.append("\r\n");
-	impl->connection.write(status_line.data(), status_line.length(), true);
+	impl->header_buffer.append(status_line);
 }
 
 void HTTPServerConnection::write_response_headers(const std::string &headers)
@@ -270,20 +271,21 @@ void HTTPServerConnection::write_response_headers(const std::string &headers)
 			else if (name == "Vary")
 				vary_line = true;
 
-			impl->connection.write(line.data(), line.length(), true);
-			impl->connection.write("\r\n", 2, true);
+			impl->header_buffer.append(line);
+			impl->header_buffer.append("\r\n");
 		}
 	}
 
 	static std::string str_server_line("Server: ClanLib HTTP Server\r\n");
 	static std::string str_connection_line("Connection: close\r\n");
+	static std::string str_keep_alive_line("Connection: keep-alive\r\n");
 	static std::string str_vary_line("Vary: *\r\n");
 	if (!server_line)
-		impl->connection.write(str_server_line.data(), str_server_line.length(), true);
+		impl->header_buffer.append(str_server_line);
 	if (!connection_line)
-		impl->connection.write(str_connection_line.data(), str_connection_line.length(), true);
+		impl->header_buffer.append(impl->keep_alive ? str_keep_alive_line : str_connection_line);
 	if (!date_line && !expires_line && !vary_line)
-		impl->connection.write(str_vary_line.data(), str_vary_line.length(), true);
+		impl->header_buffer.append(str_vary_line);
 //	write_line(connection, "Date: Sun, 16 Oct 2005 20:13:00 GMT");
 //	write_line(connection, "Expires: Sun, 16 Oct 2005 20:13:00 GMT");
 
@@ -305,16 +307,27 @@ void HTTPServerConnection::write_response_data(const DataBuffer &data)
 			length.append("Content-Length: ");
 			length.append(StringHelp::int_to_local8(data.get_size()));
 			length.append("\r\n");
-			impl->connection.write(length.data(), length.length(), true);
+			impl->header_buffer.append(length);
 		}
-		impl->connection.write("\r\n", 2, true);
+		impl->header_buffer.append("\r\n");
 	}
 	impl->writing_header = false;
 	if (impl->written_content_length >= 0 && data.get_size() != impl->written_content_length)
 		throw Exception("HTTP Content-Length in header does not match response data size!");
 
-	// Header should be ok.  Write the actual data:
-	impl->connection.write(data.get_data(), data.get_size(), true);
+	// Header should be ok.  Write the actual data, in the same send as the header when it is small:
+	if (data.get_size() <= 16*1024)
+	{
+		if (data.get_size() > 0)
+			impl->header_buffer.append(data.get_data(), data.get_size());
+		impl->flush_header();
+	}
+	else
+	{
+		impl->flush_header();
+		impl->connection.write(data.get_data(), data.get_size(), true);
+	}
+	impl->response_complete = true;
 }
 
 /////////////////////////////////////////////////////////////////////////////
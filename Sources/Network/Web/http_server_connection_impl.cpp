@@ -37,7 +37,8 @@ namespace clan
 
 HTTPServerConnection_Impl::HTTPServerConnection_Impl()
 : request_read(false), performed_read(false), performed_write(false),
-  writing_header(false), written_content_length(-1)
+  writing_header(false), written_content_length(-1),
+  keep_alive(false), response_complete(false)
 {
 }
 
@@ -51,6 +52,15 @@ HTTPServerConnection_Impl::~HTTPServerConnection_Impl()
 /////////////////////////////////////////////////////////////////////////////
 // HTTPServerConnection_Impl Operations:
 
+void HTTPServerConnection_Impl::flush_header()
+{
+	if (!header_buffer.empty())
+	{
+		connection.write(header_buffer.data(), header_buffer.length(), true);
+		header_buffer.clear();
+	}
+}
+
 std::string HTTPServerConnection_Impl::get_header_value(
 	const std::string &name,
 	const std::string &header_lines)
@@ -68,12 +68,24 @@ public:
 
 	byte64 written_content_length;
 
+	/// \brief Connection header value to send is keep-alive instead of close
+	bool keep_alive;
+
+	/// \brief Set once write_response_data has sent a complete response
+	bool response_complete;
+
+	/// \brief Status and header lines not yet sent
+	std::string header_buffer;
+
 
 /// \}
 /// \name Operations
 /// \{
 
 public:
+	/// \brief Sends any buffered status and header lines
+	void flush_header();
+
 	static std::string get_header_value(
 		const std::string &name,
 		const std::string &header_lines);
@@ -31,9 +31,13 @@
 #include "API/Core/Text/string_help.h"
 #include "API/Core/Text/string_format.h"
 #include "API/Core/Text/logger.h"
+#include "API/Core/System/event_set.h"
+#include "API/Core/System/system.h"
 #include "API/Network/Web/http_server_connection.h"
 #include "http_server_impl.h"
 #include "http_server_connection_impl.h"
+#include "http_server_client.h"
+#include <map>
 
 namespace clan
 {
@@ -41,15 +45,31 @@ namespace clan
 /////////////////////////////////////////////////////////////////////////////
 // HTTPServer_Impl Construction:
 
-HTTPServer_Impl::HTTPServer_Impl()
+HTTPServer_Impl::HTTPServer_Impl(int num_worker_threads)
+: max_request_size(default_max_request_size)
 {
-	accept_thread.start(this, &HTTPServer_Impl::accept_thread_main);
+	if (num_worker_threads > 0)
+	{
+		for (int i = 0; i < num_worker_threads; i++)
+		{
+			Thread thread;
+			thread.start(this, &HTTPServer_Impl::worker_thread_main);
+			worker_threads.push_back(thread);
+		}
+		accept_thread.start(this, &HTTPServer_Impl::event_loop_main);
+	}
+	else
+	{
+		accept_thread.start(this, &HTTPServer_Impl::accept_thread_main);
+	}
 }
 
 HTTPServer_Impl::~HTTPServer_Impl()
 {
 	stop_event.set();
 	accept_thread.join();
+	for (size_t i = 0; i < worker_threads.size(); i++)
+		worker_threads[i].join();
 }
 
 /////////////////////////////////////////////////////////////////////////////
@@ -223,6 +243,7 @@ void HTTPServer_Impl::connection_thread_main(TCPConnection connection)
 				connection_impl->request_headers = headers;
 				HTTPServerConnection http_connection(connection_impl);
 				handler.handle_request(http_connection);
+				connection_impl->flush_header();
 				handled = true;
 				break;
 			}
@@ -316,4 +337,270 @@ void HTTPServer_Impl::connection_thread_main(TCPConnection connection)
 	}
 }
 
+void HTTPServer_Impl::event_loop_main()
+{
+	// All connections are multiplexed on this thread. A client is only
+	// watched while it is idle or receiving; once a complete request has
+	// been parsed it is handed to the worker pool and watched again when
+	// the worker returns it through finished_clients.
+
+	const int id_stop = 0;
+	const int id_update = 1;
+	const int id_work_finished = 2;
+
+	EventSet event_set;
+	event_set.add(stop_event, id_stop);
+	event_set.add(update_event, id_update);
+	event_set.add(work_finished_event, id_work_finished);
+
+	int next_id = 3;
+	std::vector<TCPListen>::size_type num_listen_ports = 0;
+	std::map<int, std::vector<TCPListen>::size_type> listen_ids;
+	std::map<int, std::shared_ptr<HTTPServerClient> > clients;
+	std::vector<int> flagged_ids;
+	ubyte64 last_idle_check = System::get_time();
+
+	// Pick up ports bound before the thread started:
+	update_event.set();
+
+	while (true)
+	{
+		event_set.wait(flagged_ids, 1000);
+		for (size_t index = 0; index < flagged_ids.size(); index++)
+		{
+			int id = flagged_ids[index];
+			if (id == id_stop)
+			{
+				return;
+			}
+			else if (id == id_update)
+			{
+				MutexSection mutex_lock(&mutex);
+				update_event.reset();
+				for (; num_listen_ports < listen_ports.size(); num_listen_ports++)
+				{
+					listen_ids[next_id] = num_listen_ports;
+					event_set.add(listen_ports[num_listen_ports].get_accept_event(), next_id);
+					next_id++;
+				}
+			}
+			else if (id == id_work_finished)
+			{
+				MutexSection mutex_lock(&mutex);
+				work_finished_event.reset();
+				std::vector<std::shared_ptr<HTTPServerClient> > returned_clients;
+				returned_clients.swap(finished_clients);
+				mutex_lock.unlock();
+
+				for (size_t i = 0; i < returned_clients.size(); i++)
+				{
+					std::shared_ptr<HTTPServerClient> client = returned_clients[i];
+					if (client->closed)
+					{
+						clients.erase(client->id);
+						continue;
+					}
+
+					client->busy = false;
+					client->last_activity = System::get_time();
+
+					// Pipelined requests may already be waiting in the buffer:
+					if (client->parse() != HTTPServerClient::parse_incomplete)
+						queue_client(client);
+					else
+						event_set.add(client->connection.get_read_event(), client->id);
+				}
+			}
+			else
+			{
+				std::map<int, std::vector<TCPListen>::size_type>::iterator it_listen = listen_ids.find(id);
+				if (it_listen != listen_ids.end())
+				{
+					try
+					{
+						MutexSection mutex_lock(&mutex);
+						TCPListen listen_port = listen_ports[it_listen->second];
+						int client_max_request_size = max_request_size;
+						mutex_lock.unlock();
+						TCPConnection connection = listen_port.accept();
+						connection.set_nodelay(true);
+						std::shared_ptr<HTTPServerClient> client(new HTTPServerClient(connection, next_id++, client_max_request_size));
+						clients[client->id] = client;
+						event_set.add(connection.get_read_event(), client->id);
+					}
+					catch (const Exception& e)
+					{
+						log_event("error", e.message);
+					}
+					continue;
+				}
+
+				std::map<int, std::shared_ptr<HTTPServerClient> >::iterator it_client = clients.find(id);
+				if (it_client == clients.end() || it_client->second->busy)
+					continue;
+
+				std::shared_ptr<HTTPServerClient> client = it_client->second;
+				bool connected = false;
+				HTTPServerClient::ParseResult result = HTTPServerClient::parse_incomplete;
+				try
+				{
+					connected = client->receive();
+					if (connected)
+						result = client->parse();
+				}
+				catch (const Exception&)
+				{
+					connected = false;
+				}
+
+				if (!connected)
+				{
+					event_set.remove(client->connection.get_read_event());
+					client->connection.disconnect_abortive();
+					clients.erase(it_client);
+				}
+				else if (result != HTTPServerClient::parse_incomplete)
+				{
+					event_set.remove(client->connection.get_read_event());
+					queue_client(client);
+				}
+			}
+		}
+
+		// Close connections that have been idle for too long:
+		ubyte64 current_time = System::get_time();
+		if (current_time - last_idle_check < 1000)
+			continue;
+		last_idle_check = current_time;
+		std::map<int, std::shared_ptr<HTTPServerClient> >::iterator it_client = clients.begin();
+		while (it_client != clients.end())
+		{
+			HTTPServerClient *client = it_client->second.get();
+			if (!client->busy && current_time - client->last_activity > (ubyte64) idle_timeout)
+			{
+				event_set.remove(client->connection.get_read_event());
+				client->connection.disconnect_abortive();
+				clients.erase(it_client++);
+			}
+			else
+			{
+				++it_client;
+			}
+		}
+	}
+}
+
+void HTTPServer_Impl::queue_client(const std::shared_ptr<HTTPServerClient> &client)
+{
+	client->busy = true;
+	MutexSection mutex_lock(&mutex);
+	pending_clients.push_back(client);
+	work_available_event.set();
+}
+
+void HTTPServer_Impl::worker_thread_main()
+{
+	while (true)
+	{
+		int wakeup_reason = Event::wait(stop_event, work_available_event);
+		if (wakeup_reason != 1)
+			break;
+
+		MutexSection mutex_lock(&mutex);
+		if (pending_clients.empty())
+		{
+			work_available_event.reset();
+			continue;
+		}
+		std::shared_ptr<HTTPServerClient> client = pending_clients.front();
+		pending_clients.pop_front();
+		mutex_lock.unlock();
+
+		process_client(*client);
+
+		mutex_lock.lock();
+		finished_clients.push_back(client);
+		work_finished_event.set();
+	}
+}
+
+void HTTPServer_Impl::process_client(HTTPServerClient &client)
+{
+	try
+	{
+		if (!client.error_status.empty())
+		{
+			write_error(client.connection, client.error_status, false);
+			client.connection.disconnect_graceful();
+			client.closed = true;
+			return;
+		}
+
+		// Look for a request handler that will deal with the HTTP request:
+		HTTPRequestHandler handler;
+		MutexSection mutex_lock(&mutex);
+		std::vector<HTTPRequestHandler>::size_type index, size;
+		size = handlers.size();
+		for (index = 0; index < size; index++)
+		{
+			if (handlers[index].is_handling_request(client.request_type, client.request_url, client.request_headers))
+			{
+				handler = handlers[index];
+				break;
+			}
+		}
+		mutex_lock.unlock();
+
+		bool keep_alive = client.keep_alive;
+		if (handler.is_null())
+		{
+			write_error(client.connection, "404 Not Found", keep_alive);
+		}
+		else
+		{
+			std::shared_ptr<HTTPServerConnection_Impl> connection_impl(new HTTPServerConnection_Impl);
+			connection_impl->connection = client.connection;
+			connection_impl->request_type = client.request_type;
+			connection_impl->request_url = client.request_url;
+			connection_impl->request_headers = client.request_headers;
+			connection_impl->request_data = client.request_data;
+			connection_impl->request_read = true;
+			connection_impl->keep_alive = keep_alive;
+			HTTPServerConnection http_connection(connection_impl);
+			handler.handle_request(http_connection);
+			connection_impl->flush_header();
+
+			// The connection can only be reused if the end of the response is known to the client:
+			if (!connection_impl->response_complete || connection_impl->performed_read || connection_impl->performed_write)
+				keep_alive = false;
+		}
+
+		if (!keep_alive)
+		{
+			client.connection.disconnect_graceful();
+			client.closed = true;
+		}
+	}
+	catch (const Exception& e)
+	{
+		log_event("error", e.message);
+		client.connection.disconnect_abortive();
+		client.closed = true;
+	}
+}
+
+void HTTPServer_Impl::write_error(TCPConnection &connection, const std::string &status, bool keep_alive)
+{
+	std::string response;
+	response.append("HTTP/1.1 " + status + "\r\n");
+	response.append("Server: ClanLib HTTP Server\r\n");
+	response.append(keep_alive ? "Connection: keep-alive\r\n" : "Connection: close\r\n");
+	response.append("Vary: *\r\n");
+	response.append("Content-Type: text/plain\r\n");
+	response.append("Content-Length: " + StringHelp::int_to_local8(status.length()+2) + "\r\n");
+	response.append("\r\n");
+	response.append(status + "\r\n");
+	connection.write(response.data(), response.length(), true);
+}
+
 }
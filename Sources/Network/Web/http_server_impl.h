@@ -35,17 +35,24 @@
 #include "API/Core/System/thread.h"
 #include "API/Core/System/event.h"
 #include <vector>
+#include <deque>
+#include <memory>
 
 namespace clan
 {
 
+class HTTPServerClient;
+
 class HTTPServer_Impl
 {
 /// \name Construction
 /// \{
 
 public:
-	HTTPServer_Impl();
+	/// \brief Constructs the server
+	///
+	/// \param num_worker_threads = Size of the worker pool. 0 starts a thread per connection instead of the event loop.
+	HTTPServer_Impl(int num_worker_threads);
 
 	~HTTPServer_Impl();
 
@@ -61,10 +68,25 @@ public:
 
 	Event stop_event, update_event;
 
+	std::vector<Thread> worker_threads;
+
+	/// \brief Set while clients are waiting in pending_clients
+	Event work_available_event;
+
+	/// \brief Set when workers hand clients back in finished_clients
+	Event work_finished_event;
+
+	std::deque<std::shared_ptr<HTTPServerClient> > pending_clients;
+
+	std::vector<std::shared_ptr<HTTPServerClient> > finished_clients;
+
 	std::vector<HTTPRequestHandler> handlers;
 
 	std::vector<TCPListen> listen_ports;
 
+	/// \brief Largest request body accepted by the event loop
+	int max_request_size;
+
 
 /// \}
 /// \name Operations
@@ -86,6 +108,20 @@ private:
 	void accept_thread_main();
 
 	void connection_thread_main(TCPConnection connection);
+
+	void event_loop_main();
+
+	void queue_client(const std::shared_ptr<HTTPServerClient> &client);
+
+	void worker_thread_main();
+
+	void process_client(HTTPServerClient &client);
+
+	void write_error(TCPConnection &connection, const std::string &status, bool keep_alive);
+
+	static const int idle_timeout = 15000;
+
+	static const int default_max_request_size = 16*1024*1024;
 /// \}
 };
 
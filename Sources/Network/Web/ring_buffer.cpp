@@ -41,6 +41,16 @@ size_t RingBuffer::get_read_size()
 	return end_pos - pos;
 }
 
+size_t RingBuffer::get_length() const
+{
+	return length;
+}
+
+size_t RingBuffer::get_capacity() const
+{
+	return size;
+}
+
 char *RingBuffer::get_write_pos()
 {
 	size_t end_pos = pos + length;
@@ -55,8 +65,10 @@ size_t RingBuffer::get_write_size()
 	if (end_pos >= size)
 		end_pos -= size;
 
-	if (pos < end_pos)
-		return end_pos - pos;
+	if (length == size)
+		return 0;
+	else if (end_pos < pos)
+		return pos - end_pos;
 	else
 		return size - end_pos;
 }
@@ -15,6 +15,8 @@ public:
 
 	const char *get_read_pos();
 	size_t get_read_size();
+	size_t get_length() const;
+	size_t get_capacity() const;
 	char *get_write_pos();
 	size_t get_write_size();
 	void write(size_t length);
@@ -44,8 +44,15 @@ void PixelCommandBicubic::run(PixelThreadContext *context)
 	PixelBicubicRenderer bicubic_renderer;
 	bicubic_renderer.set_dest(context->colorbuffer0.data, context->colorbuffer0.size.width, context->colorbuffer0.size.height);
 	bicubic_renderer.set_src((unsigned int*)image.get_data(), image.get_width(), image.get_height());
+	bicubic_renderer.set_clip_rect(context->clip_rect);
 	bicubic_renderer.set_core(context->core, context->num_cores);
 	bicubic_renderer.render(x, y, zoom_number, zoom_denominator);
 }
 
+bool PixelCommandBicubic::get_bounds(Rect &out_bounds) const
+{
+	out_bounds = Rect(x, y, Size(image.get_width() * zoom_number / zoom_denominator, image.get_height() * zoom_number / zoom_denominator));
+	return true;
+}
+
 }
@@ -39,6 +39,7 @@ class PixelCommandBicubic : public PixelCommand
 public:
 	PixelCommandBicubic(int x, int y, int zoom_number, int zoom_denominator, const PixelBuffer &image);
 	void run(PixelThreadContext *context);
+	bool get_bounds(Rect &out_bounds) const;
 
 private:
 	int x;
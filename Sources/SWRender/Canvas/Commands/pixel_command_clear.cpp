@@ -48,4 +48,13 @@ void PixelCommandClear::run(PixelThreadContext *context)
 	fill_renderer.clear(color);
 }
 
+bool PixelCommandClear::get_opaque_rect(const PixelOcclusionState &state, Rect &out_rect) const
+{
+	// Clearing replaces the pixels in the clipping rectangle, whatever the alpha of the color
+	if (!state.clip_rect_known)
+		return false;
+	out_rect = state.clip_rect;
+	return true;
+}
+
 }
@@ -39,6 +39,7 @@ class PixelCommandClear : public PixelCommand
 public:
 	PixelCommandClear(const Colorf &color);
 	void run(PixelThreadContext *context);
+	bool get_opaque_rect(const PixelOcclusionState &state, Rect &out_rect) const;
 
 private:
 	Colorf color;
@@ -65,4 +65,16 @@ void PixelCommandLine::run(PixelThreadContext *context)
 	line_renderer.draw_line(line, color);
 }
 
+bool PixelCommandLine::get_bounds(Rect &out_bounds) const
+{
+	float x0 = min(points[0].x, points[1].x);
+	float y0 = min(points[0].y, points[1].y);
+	float x1 = max(points[0].x, points[1].x);
+	float y1 = max(points[0].y, points[1].y);
+	if (!(x0 > -1.0e8f && y0 > -1.0e8f && x1 < 1.0e8f && y1 < 1.0e8f))
+		return false; // Too large to convert to integers, or not a number
+	out_bounds = Rect((int)x0 - 1, (int)y0 - 1, (int)x1 + 2, (int)y1 + 2);
+	return true;
+}
+
 }
@@ -40,6 +40,7 @@ class PixelCommandLine : public PixelCommand
 public:
 	PixelCommandLine(const Vec2f init_points[2], const Vec4f init_primcolor[2], const Vec2f init_texcoords[2], int init_sampler);
 	void run(PixelThreadContext *context);
+	bool get_bounds(Rect &out_bounds) const;
 
 private:
 	Vec2f points[2];
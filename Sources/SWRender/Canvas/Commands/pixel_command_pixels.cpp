@@ -235,4 +235,10 @@ Rect PixelCommandPixels::get_clipped_dest_rect(PixelThreadContext *context) cons
 	return dest;
 }
 
+bool PixelCommandPixels::get_bounds(Rect &out_bounds) const
+{
+	out_bounds = dest_rect;
+	return true;
+}
+
 }
@@ -40,6 +40,7 @@ class PixelCommandPixels : public PixelCommand
 public:
 	PixelCommandPixels(const Rect &dest_rect, const PixelBuffer &image, const Rect &src_rect, const Colorf &primary_color);
 	void run(PixelThreadContext *context);
+	bool get_bounds(Rect &out_bounds) const;
 
 private:
 	void render_pixels_scale(PixelThreadContext *context, const Rect &box);
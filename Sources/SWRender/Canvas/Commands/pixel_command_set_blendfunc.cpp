@@ -47,4 +47,9 @@ void PixelCommandSetBlendFunc::run(PixelThreadContext *context)
 	context->cur_blend_color = const_color;
 }
 
+bool PixelCommandSetBlendFunc::update_occlusion_state(PixelOcclusionState &state) const
+{
+	return true;
+}
+
 }
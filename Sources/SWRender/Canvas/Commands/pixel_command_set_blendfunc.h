@@ -40,6 +40,7 @@ class PixelCommandSetBlendFunc : public PixelCommand
 public:
 	PixelCommandSetBlendFunc(BlendFunc src, BlendFunc dest, BlendFunc src_alpha, BlendFunc dest_alpha, Colorf const_color);
 	void run(PixelThreadContext *context);
+	bool update_occlusion_state(PixelOcclusionState &state) const;
 
 private:
 	BlendFunc src;
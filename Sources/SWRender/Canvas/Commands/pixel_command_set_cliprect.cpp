@@ -41,6 +41,14 @@ PixelCommandSetClipRect::PixelCommandSetClipRect(const Rect &rect)
 void PixelCommandSetClipRect::run(PixelThreadContext *context)
 {
 	context->clip_rect = rect;
+	context->clip_rect.overlap(context->tile_rect);
+}
+
+bool PixelCommandSetClipRect::update_occlusion_state(PixelOcclusionState &state) const
+{
+	state.clip_rect = rect;
+	state.clip_rect_known = true;
+	return true;
 }
 
 }
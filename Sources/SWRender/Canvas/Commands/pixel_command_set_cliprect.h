@@ -39,6 +39,7 @@ class PixelCommandSetClipRect : public PixelCommand
 public:
 	PixelCommandSetClipRect(const Rect &rect);
 	void run(PixelThreadContext *context);
+	bool update_occlusion_state(PixelOcclusionState &state) const;
 
 private:
 	Rect rect;
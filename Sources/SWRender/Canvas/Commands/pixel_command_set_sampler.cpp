@@ -52,4 +52,9 @@ void PixelCommandSetSampler::run(PixelThreadContext *context)
 		context->samplers[index].set(context->pixelbuffer_white);
 }
 
+bool PixelCommandSetSampler::update_occlusion_state(PixelOcclusionState &state) const
+{
+	return true;
+}
+
 }
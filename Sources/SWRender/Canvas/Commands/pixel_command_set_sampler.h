@@ -40,6 +40,7 @@ public:
 	PixelCommandSetSampler(int index, const PixelBuffer &pixelbuffer);
 	PixelCommandSetSampler(int index);
 	void run(PixelThreadContext *context);
+	bool update_occlusion_state(PixelOcclusionState &state) const;
 
 private:
 	int index;
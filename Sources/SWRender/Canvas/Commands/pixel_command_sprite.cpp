@@ -65,7 +65,7 @@ void PixelCommandSprite::run(PixelThreadContext *context)
 	}
 	else
 	{
-		Rect dest = get_dest_rect(context);
+		Rect dest = get_dest_rect(context->clip_rect);
 		Colorf color(primcolor.r, primcolor.g, primcolor.b, primcolor.a);
 
 		if (dest.left < dest.right && dest.top < dest.bottom)
@@ -116,7 +116,7 @@ void PixelCommandSprite::render_sprite_rotated(PixelThreadContext *context)
 
 void PixelCommandSprite::render_sprite(PixelThreadContext *context)
 {
-	Rect box = get_dest_rect(context);
+	Rect box = get_dest_rect(context->clip_rect);
 	if (box.left < box.right && box.top < box.bottom)
 	{
 		float dx = (texcoords[1].x-texcoords[0].x)/(points[1].x-points[0].x);
@@ -173,14 +173,15 @@ void PixelCommandSprite::render_sprite_scale(PixelThreadContext *context, const
 	float dx = (texcoords[1].x-texcoords[0].x)/(points[1].x-points[0].x);
 	float dy = (texcoords[2].y-texcoords[0].y)/(points[2].y-points[0].y);
 	float tx_left = texcoords[0].x + dx*(box.left+0.5f-points[0].x);
-	float ty_top = texcoords[0].y + dy*(box.top+0.5f-points[0].y);
+	int dest_top = get_dest_top();
+	float ty_top = texcoords[0].y + dy*(dest_top+0.5f-points[0].y);
 	int dtx = (int)(dx*context->samplers[sampler].size.width * 32768);
 	int dty = (int)(dy*context->samplers[sampler].size.height * 32768);
 
 	int start_tx = (int)(tx_left*context->samplers[sampler].size.width * 32768);
 	int ty = (int)(ty_top*context->samplers[sampler].size.height * 32768);
 	int skip_lines = find_first_line_for_core(box.top, context->core, context->num_cores)-box.top;
-	ty += dty * skip_lines;
+	ty += dty * (box.top + skip_lines - dest_top);
 	dty *= context->num_cores;
 
 	int width = box.get_width();
@@ -238,13 +239,14 @@ void PixelCommandSprite::render_sprite_noscale_white(PixelThreadContext *context
 	float dx = (texcoords[1].x-texcoords[0].x)/(points[1].x-points[0].x);
 	float dy = (texcoords[2].y-texcoords[0].y)/(points[2].y-points[0].y);
 	float tx_left = texcoords[0].x + dx*(box.left+0.5f-points[0].x);
-	float ty_top = texcoords[0].y + dy*(box.top+0.5f-points[0].y);
+	int dest_top = get_dest_top();
+	float ty_top = texcoords[0].y + dy*(dest_top+0.5f-points[0].y);
 	int dty = (int)(dy*context->samplers[sampler].size.height * 32768);
 
 	int start_tx = (int)(tx_left*context->samplers[sampler].size.width * 32768);
 	int ty = (int)(ty_top*context->samplers[sampler].size.height * 32768);
 	int skip_lines = find_first_line_for_core(box.top, context->core, context->num_cores)-box.top;
-	ty += dty * skip_lines;
+	ty += dty * (box.top + skip_lines - dest_top);
 	dty *= context->num_cores;
 
 	int width = box.get_width();
@@ -288,13 +290,14 @@ void PixelCommandSprite::render_sprite_noscale(PixelThreadContext *context, cons
 	float dx = (texcoords[1].x-texcoords[0].x)/(points[1].x-points[0].x);
 	float dy = (texcoords[2].y-texcoords[0].y)/(points[2].y-points[0].y);
 	float tx_left = texcoords[0].x + dx*(box.left+0.5f-points[0].x);
-	float ty_top = texcoords[0].y + dy*(box.top+0.5f-points[0].y);
+	int dest_top = get_dest_top();
+	float ty_top = texcoords[0].y + dy*(dest_top+0.5f-points[0].y);
 	int dty = (int)(dy*context->samplers[sampler].size.height * 32768);
 
 	int start_tx = (int)(tx_left*context->samplers[sampler].size.width * 32768);
 	int ty = (int)(ty_top*context->samplers[sampler].size.height * 32768);
 	int skip_lines = find_first_line_for_core(box.top, context->core, context->num_cores)-box.top;
-	ty += dty * skip_lines;
+	ty += dty * (box.top + skip_lines - dest_top);
 	dty *= context->num_cores;
 
 	int width = box.get_width();
@@ -346,14 +349,15 @@ void PixelCommandSprite::render_glyph_scale(PixelThreadContext *context, const R
 	float dx = (texcoords[1].x-texcoords[0].x)/(points[1].x-points[0].x);
 	float dy = (texcoords[2].y-texcoords[0].y)/(points[2].y-points[0].y);
 	float tx_left = texcoords[0].x + dx*(box.left+0.5f-points[0].x);
-	float ty_top = texcoords[0].y + dy*(box.top+0.5f-points[0].y);
+	int dest_top = get_dest_top();
+	float ty_top = texcoords[0].y + dy*(dest_top+0.5f-points[0].y);
 	int dtx = (int)(dx*context->samplers[sampler].size.width * 32768);
 	int dty = (int)(dy*context->samplers[sampler].size.height * 32768);
 
 	int start_tx = (int)(tx_left*context->samplers[sampler].size.width * 32768);
 	int ty = (int)(ty_top*context->samplers[sampler].size.height * 32768);
 	int skip_lines = find_first_line_for_core(box.top, context->core, context->num_cores)-box.top;
-	ty += dty * skip_lines;
+	ty += dty * (box.top + skip_lines - dest_top);
 	dty *= context->num_cores;
 
 	int width = box.get_width();
@@ -409,13 +413,14 @@ void PixelCommandSprite::render_glyph_noscale(PixelThreadContext *context, const
 	float dx = (texcoords[1].x-texcoords[0].x)/(points[1].x-points[0].x);
 	float dy = (texcoords[2].y-texcoords[0].y)/(points[2].y-points[0].y);
 	float tx_left = texcoords[0].x + dx*(box.left+0.5f-points[0].x);
-	float ty_top = texcoords[0].y + dy*(box.top+0.5f-points[0].y);
+	int dest_top = get_dest_top();
+	float ty_top = texcoords[0].y + dy*(dest_top+0.5f-points[0].y);
 	int dty = (int)(dy*context->samplers[sampler].size.height * 32768);
 
 	int start_tx = (int)(tx_left*context->samplers[sampler].size.width * 32768);
 	int ty = (int)(ty_top*context->samplers[sampler].size.height * 32768);
 	int skip_lines = find_first_line_for_core(box.top, context->core, context->num_cores)-box.top;
-	ty += dty * skip_lines;
+	ty += dty * (box.top + skip_lines - dest_top);
 	dty *= context->num_cores;
 
 	int width = box.get_width();
@@ -461,7 +466,7 @@ void PixelCommandSprite::render_glyph_noscale(PixelThreadContext *context, const
 }
 
 
-Rect PixelCommandSprite::get_dest_rect(PixelThreadContext *context) const
+Rect PixelCommandSprite::get_dest_rect(const Rect &clip_rect) const
 {
 	float x0, x1, y0, y1;
 	if (points[0].x <= points[1].x)
@@ -492,14 +497,20 @@ Rect PixelCommandSprite::get_dest_rect(PixelThreadContext *context) const
 	dest.top = (int)(y0 + 0.5f);
 	dest.bottom = (int)(y1 - 0.5f) + 1;
 
-	dest.left = max(min(dest.left, context->clip_rect.right), context->clip_rect.left);
-	dest.right = max(min(dest.right, context->clip_rect.right), context->clip_rect.left);
-	dest.top = max(min(dest.top, context->clip_rect.bottom), context->clip_rect.top);
-	dest.bottom = max(min(dest.bottom, context->clip_rect.bottom), context->clip_rect.top);
+	dest.left = max(min(dest.left, clip_rect.right), clip_rect.left);
+	dest.right = max(min(dest.right, clip_rect.right), clip_rect.left);
+	dest.top = max(min(dest.top, clip_rect.bottom), clip_rect.top);
+	dest.bottom = max(min(dest.bottom, clip_rect.bottom), clip_rect.top);
 
 	return dest;
 }
 
+int PixelCommandSprite::get_dest_top() const
+{
+	// Texture coordinates are stepped from the unclipped top, so a sprite samples the same texels no matter how it is clipped
+	return (int)(min(points[0].y, points[2].y) + 0.5f);
+}
+
 void PixelCommandSprite::render_linear_scanline(Scanline *d)
 {
 	unsigned int *dest = d->dest;
@@ -850,4 +861,27 @@ void PixelCommandSprite::render_linear_scanline(Scanline *d)
 	}
 }
 
+bool PixelCommandSprite::get_bounds(Rect &out_bounds) const
+{
+	// The fourth corner of a rotated sprite is implied by the other three
+	Vec2f point3 = points[1] + points[2] - points[0];
+	float x0 = min(min(points[0].x, points[1].x), min(points[2].x, point3.x));
+	float y0 = min(min(points[0].y, points[1].y), min(points[2].y, point3.y));
+	float x1 = max(max(points[0].x, points[1].x), max(points[2].x, point3.x));
+	float y1 = max(max(points[0].y, points[1].y), max(points[2].y, point3.y));
+	if (!(x0 > -1.0e8f && y0 > -1.0e8f && x1 < 1.0e8f && y1 < 1.0e8f))
+		return false; // Too large to convert to integers, or not a number
+	out_bounds = Rect((int)floor(x0) - 1, (int)floor(y0) - 1, (int)ceil(x1) + 1, (int)ceil(y1) + 1);
+	return true;
+}
+
+bool PixelCommandSprite::get_opaque_rect(const PixelOcclusionState &state, Rect &out_rect) const
+{
+	// Only solid fills are known to be opaque, as texture alpha is not inspected. Fill alpha is rounded the same way as in PixelFillRenderer::fill_rect.
+	if (sampler != 4 || !state.clip_rect_known || (unsigned int) (primcolor.a*255) != 255)
+		return false;
+	out_rect = get_dest_rect(state.clip_rect);
+	return out_rect.left < out_rect.right && out_rect.top < out_rect.bottom;
+}
+
 }
@@ -42,6 +42,8 @@ class PixelCommandSprite : public PixelCommand
 public:
 	PixelCommandSprite(const Vec2f init_points[3], const Vec4f init_primcolor, const Vec2f init_texcoords[3], int init_sampler);
 	void run(PixelThreadContext *context);
+	bool get_bounds(Rect &out_bounds) const;
+	bool get_opaque_rect(const PixelOcclusionState &state, Rect &out_rect) const;
 
 private:
 	struct Scanline
@@ -67,7 +69,8 @@ private:
 	void render_sprite_noscale_white(PixelThreadContext *context, const Rect &box);
 	void render_glyph_scale(PixelThreadContext *context, const Rect &box);
 	void render_glyph_noscale(PixelThreadContext *context, const Rect &box);
-	Rect get_dest_rect(PixelThreadContext *context) const;
+	Rect get_dest_rect(const Rect &clip_rect) const;
+	int get_dest_top() const;
 
 	void render_linear_scanline(Scanline *d);
 
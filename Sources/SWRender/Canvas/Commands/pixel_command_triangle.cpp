@@ -65,4 +65,17 @@ void PixelCommandTriangle::run(PixelThreadContext *context)
 	triangle_renderer.set_blend_function(context->cur_blend_src, context->cur_blend_dest, context->cur_blend_src_alpha, context->cur_blend_dest_alpha);
 	triangle_renderer.render_nearest(0, 1, 2);
 }
+
+bool PixelCommandTriangle::get_bounds(Rect &out_bounds) const
+{
+	float x0 = min(min(points[0].x, points[1].x), points[2].x);
+	float y0 = min(min(points[0].y, points[1].y), points[2].y);
+	float x1 = max(max(points[0].x, points[1].x), points[2].x);
+	float y1 = max(max(points[0].y, points[1].y), points[2].y);
+	if (!(x0 > -1.0e8f && y0 > -1.0e8f && x1 < 1.0e8f && y1 < 1.0e8f))
+		return false; // Too large to convert to integers, or not a number
+	out_bounds = Rect((int)floor(x0) - 1, (int)floor(y0) - 1, (int)ceil(x1) + 1, (int)ceil(y1) + 1);
+	return true;
+}
+
 }
@@ -40,6 +40,7 @@ class PixelCommandTriangle : public PixelCommand
 public:
 	PixelCommandTriangle(const Vec2f init_points[3], const Vec4f init_primcolor[3], const Vec2f init_texcoords[3], int init_sampler);
 	void run(PixelThreadContext *context);
+	bool get_bounds(Rect &out_bounds) const;
 
 private:
 	Vec2f points[3];
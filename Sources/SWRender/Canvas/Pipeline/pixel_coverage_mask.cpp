@@ -0,0 +1,114 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Magnus Norddahl
+*/
+
+#include "SWRender/precomp.h"
+#include "pixel_coverage_mask.h"
+
+namespace clan
+{
+
+PixelCoverageMask::PixelCoverageMask()
+: words_per_line(0), empty(true)
+{
+}
+
+void PixelCoverageMask::reset(const Rect &new_area)
+{
+	area = new_area;
+	words_per_line = (area.get_width() + 31) / 32;
+	bits.resize(words_per_line * area.get_height());
+	clear();
+}
+
+void PixelCoverageMask::clear()
+{
+	if (!empty)
+	{
+		for (size_t i = 0; i < bits.size(); i++)
+			bits[i] = 0;
+		empty = true;
+	}
+}
+
+void PixelCoverageMask::add(const Rect &rect)
+{
+	Rect box = rect;
+	box.overlap(area);
+	if (box.left >= box.right || box.top >= box.bottom)
+		return;
+
+	int start_x = box.left - area.left;
+	int end_x = box.right - area.left;
+	int first_word = start_x / 32;
+	int last_word = (end_x - 1) / 32;
+	for (int y = box.top; y < box.bottom; y++)
+	{
+		unsigned int *line = &bits[(y - area.top) * words_per_line];
+		for (int word = first_word; word <= last_word; word++)
+			line[word] |= get_word_mask(word, start_x, end_x);
+	}
+	empty = false;
+}
+
+bool PixelCoverageMask::is_covered(const Rect &rect) const
+{
+	Rect box = rect;
+	box.overlap(area);
+	if (box.left >= box.right || box.top >= box.bottom)
+		return true;
+	if (empty)
+		return false;
+
+	int start_x = box.left - area.left;
+	int end_x = box.right - area.left;
+	int first_word = start_x / 32;
+	int last_word = (end_x - 1) / 32;
+	for (int y = box.top; y < box.bottom; y++)
+	{
+		const unsigned int *line = &bits[(y - area.top) * words_per_line];
+		for (int word = first_word; word <= last_word; word++)
+		{
+			unsigned int mask = get_word_mask(word, start_x, end_x);
+			if ((line[word] & mask) != mask)
+				return false;
+		}
+	}
+	return true;
+}
+
+unsigned int PixelCoverageMask::get_word_mask(int word, int start_x, int end_x)
+{
+	int first_bit = max(start_x - word * 32, 0);
+	int end_bit = min(end_x - word * 32, 32);
+	unsigned int mask = 0xffffffff << first_bit;
+	if (end_bit < 32)
+		mask &= (1u << end_bit) - 1;
+	return mask;
+}
+
+}
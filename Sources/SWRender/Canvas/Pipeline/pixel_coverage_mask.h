@@ -0,0 +1,66 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Magnus Norddahl
+*/
+
+#pragma once
+
+#include "API/Core/Math/rect.h"
+#include <vector>
+
+namespace clan
+{
+
+/// \brief Bit mask of the pixels in a screen tile that are hidden by opaque commands
+class PixelCoverageMask
+{
+public:
+	PixelCoverageMask();
+
+	/// \brief Sets the area covered by the mask and clears it
+	void reset(const Rect &area);
+
+	/// \brief Marks every pixel as visible again
+	void clear();
+
+	/// \brief Marks the pixels in a rectangle as covered
+	void add(const Rect &rect);
+
+	/// \brief Returns true if every pixel of the rectangle inside the mask area is covered
+	///
+	/// Rectangles not overlapping the mask area are always covered.
+	bool is_covered(const Rect &rect) const;
+
+private:
+	static unsigned int get_word_mask(int word, int start_x, int end_x);
+
+	Rect area;
+	int words_per_line;
+	std::vector<unsigned int> bits;
+	bool empty;
+};
+
+}
@@ -40,20 +40,22 @@
 #endif
 
 #ifdef PROFILE_PIPELINE
-#include "API/Core/Text/string_format.h"
+#include "API/Core/Text/logger.h"
 #endif
 
 namespace clan
 {
 
 
-PixelPipeline::PixelPipeline()
-: active_cores(0), local_writer_index(0), local_reader_index(0), local_commands_written(0), cur_block(0)
+PixelPipeline::PixelPipeline(bool tiled, bool occlusion_culling)
+: tiled(tiled), active_cores(0), local_writer_index(0), local_reader_index(0), local_commands_written(0), occlusion_culling(occlusion_culling), local_batch_open(false), local_batches_written(0), cur_block(0)
 {
 #if defined(WIN32) && defined(PROFILE_PIPELINE)
 	SetThreadIdealProcessor(GetCurrentThread(), 0);
 	SetThreadAffinityMask(GetCurrentThread(), 1);
-	profiler.start_time = __rdtsc();
+#endif
+#ifdef PROFILE_PIPELINE
+	profiler.start_time = System::get_microseconds();
 #endif
 
 	active_cores = System::get_num_cores();
@@ -61,6 +63,11 @@ PixelPipeline::PixelPipeline()
 		command_queue[i] = 0;
 	reader_indices.resize(active_cores);
 	reader_active.resize(active_cores);
+	batches_retired.resize(active_cores);
+	tile_workers.resize(active_cores);
+#ifdef PROFILE_PIPELINE
+	worker_profilers.resize(active_cores);
+#endif
 
 	// Do not change this code to event_more_commands.resize().
 	// If you do this, the same Event handle end up in every index due to resize(n) calling resize(n, Event()).
@@ -78,8 +85,8 @@ PixelPipeline::PixelPipeline()
 PixelPipeline::~PixelPipeline()
 {
 	wait_for_workers();
-#if defined(WIN32) && defined(PROFILE_PIPELINE)
-	profiler.end_time = __rdtsc();
+#ifdef PROFILE_PIPELINE
+	profiler.end_time = System::get_microseconds();
 #endif
 	event_stop.set();
 	for (std::vector<Thread>::size_type i = 0; i < worker_threads.size(); i++)
@@ -91,27 +98,51 @@ PixelPipeline::~PixelPipeline()
 		command_queue[i] = 0;
 	}
 
+	for (int i = 0; i < max_batches; i++)
+	{
+		for (size_t j = 0; j < batches[i].commands.size(); j++)
+			delete batches[i].commands[j].command;
+		batches[i].commands.clear();
+	}
+
 	if (cur_block && cur_block->refcount == 1)
 		delete[] (char*) cur_block;
 
-#if defined(WIN32) && defined(PROFILE_PIPELINE)
-	MessageBoxA(0, cl_format("Queue = %1\r\nSetEvent = %2\r\nWaitForWorkers = %3\r\nWaitForSpace = %4\r\nAllocFree = %5",
-		(int)(profiler.queue_time*100/(profiler.end_time-profiler.start_time)),
-		(int)(profiler.set_event_time*100/(profiler.end_time-profiler.start_time)),
-		(int)(profiler.wait_for_workers_time*100/(profiler.end_time-profiler.start_time)),
-		(int)(profiler.wait_for_space_time*100/(profiler.end_time-profiler.start_time)),
-		(int)(profiler.alloc_time*100/(profiler.end_time-profiler.start_time))).c_str(),
-		"DEBUG", MB_OK);
+#ifdef PROFILE_PIPELINE
+	ubyte64 total_time = max(profiler.end_time-profiler.start_time, (ubyte64)1);
+	log_event("debug", "Pipeline: Queue = %1%%, SetEvent = %2%%, WaitForWorkers = %3%%, WaitForSpace = %4%%, AllocFree = %5%%",
+		(int)(profiler.queue_time*100/total_time),
+		(int)(profiler.set_event_time*100/total_time),
+		(int)(profiler.wait_for_workers_time*100/total_time),
+		(int)(profiler.wait_for_space_time*100/total_time),
+		(int)(profiler.alloc_time*100/total_time));
+	for (int core = 0; core < active_cores; core++)
+	{
+		WorkerCounters &counters = worker_profilers[core];
+		ubyte64 worker_time = max(counters.time_working+counters.time_waiting, (ubyte64)1);
+		log_event("debug", "Pipeline core %1: %2%% utilization, %3 commands run, %4 commands skipped by tile binning",
+			core,
+			(int)(counters.time_working*100/worker_time),
+			(int)counters.commands_run,
+			(int)counters.commands_skipped);
+	}
 #endif
 }
 
 void PixelPipeline::queue(std::unique_ptr<PixelCommand> &command)
 {
+	if (tiled)
+	{
+		queue_tiled(command.get());
+		command.release();
+		return;
+	}
+
 	wait_for_space();
 	delete command_queue[local_writer_index];
 
-#if defined(WIN32) && defined(PROFILE_PIPELINE)
-	unsigned __int64 start_time = __rdtsc();
+#ifdef PROFILE_PIPELINE
+	ubyte64 start_time = System::get_microseconds();
 #endif
 
 	command_queue[local_writer_index] = command.get();
@@ -128,30 +159,30 @@ void PixelPipeline::queue(std::unique_ptr<PixelCommand> &command)
 		writer_index.set(local_writer_index);
 		local_commands_written = 0;
 
-#if defined(WIN32) && defined(PROFILE_PIPELINE)
-		unsigned __int64 start_event_time = __rdtsc();
+#ifdef PROFILE_PIPELINE
+		ubyte64 start_event_time = System::get_microseconds();
 #endif
 		for (int i = 0; i < active_cores; i++)
 		{
 			if (reader_active[i].get() == 0)
 				event_more_commands[i].set();
 		}
-#if defined(WIN32) && defined(PROFILE_PIPELINE)
-		unsigned __int64 end_event_time = __rdtsc();
+#ifdef PROFILE_PIPELINE
+		ubyte64 end_event_time = System::get_microseconds();
 		profiler.set_event_time += end_event_time-start_event_time;
 #endif
 	}
 
-#if defined(WIN32) && defined(PROFILE_PIPELINE)
-	unsigned __int64 end_time = __rdtsc();
+#ifdef PROFILE_PIPELINE
+	ubyte64 end_time = System::get_microseconds();
 	profiler.queue_time += end_time-start_time;
 #endif
 }
 
 void PixelPipeline::wait_for_space()
 {
-#if defined(WIN32) && defined(PROFILE_PIPELINE)
-	unsigned __int64 start_time = __rdtsc();
+#ifdef PROFILE_PIPELINE
+	ubyte64 start_time = System::get_microseconds();
 #endif
 
 	int next_index = local_writer_index+1;
@@ -168,45 +199,97 @@ void PixelPipeline::wait_for_space()
 		}
 	}
 
-#if defined(WIN32) && defined(PROFILE_PIPELINE)
-	unsigned __int64 end_time = __rdtsc();
+#ifdef PROFILE_PIPELINE
+	ubyte64 end_time = System::get_microseconds();
 	profiler.wait_for_space_time += end_time-start_time;
 #endif
 }
 
 void PixelPipeline::wait_for_workers()
 {
-#if defined(WIN32) && defined(PROFILE_PIPELINE)
-	unsigned __int64 start_time = __rdtsc();
+#ifdef PROFILE_PIPELINE
+	ubyte64 start_time = System::get_microseconds();
 #endif
 
-	if (local_commands_written > 0)
+	if (tiled)
 	{
-		cl_compiler_barrier();
-		writer_index.set(local_writer_index);
-		local_commands_written = 0;
-
-		for (int i = 0; i < active_cores; i++)
-			event_more_commands[i].set();
+		if (local_batch_open)
+			end_batch();
+		wait_for_batches(0);
 	}
-
-	if (local_reader_index != local_writer_index)
+	else
 	{
-		update_local_reader_index();
-		while (local_reader_index != local_writer_index)
+		if (local_commands_written > 0)
+		{
+			cl_compiler_barrier();
+			writer_index.set(local_writer_index);
+			local_commands_written = 0;
+
+			for (int i = 0; i < active_cores; i++)
+				event_more_commands[i].set();
+		}
+
+		if (local_reader_index != local_writer_index)
 		{
-			event_reader_done.wait();
-			event_reader_done.reset();
 			update_local_reader_index();
+			while (local_reader_index != local_writer_index)
+			{
+				event_reader_done.wait();
+				event_reader_done.reset();
+				update_local_reader_index();
+			}
 		}
 	}
 
-#if defined(WIN32) && defined(PROFILE_PIPELINE)
-	unsigned __int64 end_time = __rdtsc();
+#ifdef PROFILE_PIPELINE
+	ubyte64 end_time = System::get_microseconds();
 	profiler.wait_for_workers_time += end_time-start_time;
 #endif
 }
 
+void PixelPipeline::set_framebuffer_size(const Size &size)
+{
+	if (!tiled)
+		return;
+
+	wait_for_workers();
+
+	int num_tiles = max((size.height + tile_height - 1) / tile_height, 1);
+	if (tiles.empty())
+		tiles.push_back(PixelThreadContext(Rect(0, 0, size.width, tile_height)));
+
+	PixelThreadContext first_tile = tiles.front();
+	tiles.resize(num_tiles, first_tile);
+	for (int i = 0; i < num_tiles; i++)
+		tiles[i].tile_rect = Rect(0, i * tile_height, size.width, (i + 1) * tile_height);
+
+	// The clipping rectangle of added tiles is not known until it is set again
+	occlusion_state = PixelOcclusionState();
+}
+
+PixelOverdrawCounters PixelPipeline::get_overdraw_counters()
+{
+	wait_for_workers();
+
+	PixelOverdrawCounters total;
+	for (size_t i = 0; i < tile_workers.size(); i++)
+	{
+		const PixelOverdrawCounters &counters = tile_workers[i].counters;
+		total.commands_run += counters.commands_run;
+		total.commands_culled += counters.commands_culled;
+		total.pixels_drawn += counters.pixels_drawn;
+		total.pixels_culled += counters.pixels_culled;
+	}
+	return total;
+}
+
+void PixelPipeline::reset_overdraw_counters()
+{
+	wait_for_workers();
+	for (size_t i = 0; i < tile_workers.size(); i++)
+		tile_workers[i].counters = PixelOverdrawCounters();
+}
+
 void PixelPipeline::update_local_reader_index()
 {
 	local_reader_index = local_writer_index;
@@ -222,42 +305,165 @@ void PixelPipeline::update_local_reader_index()
 		local_reader_index += queue_max;
 }
 
+void PixelPipeline::queue_tiled(PixelCommand *command)
+{
+#ifdef PROFILE_PIPELINE
+	ubyte64 start_time = System::get_microseconds();
+#endif
+
+	if (!local_batch_open)
+		begin_batch();
+
+	Batch &batch = batches[local_batches_written % max_batches];
+
+	BatchCommand entry;
+	entry.command = command;
+	entry.opaque = command->get_opaque_rect(occlusion_state, entry.opaque_rect);
+
+	int num_tiles = batch.bins.size();
+	int first_tile = 0;
+	int last_tile = num_tiles - 1;
+
+	Rect bounds;
+	if (command->get_bounds(bounds))
+	{
+		first_tile = max(bounds.top, 0) / tile_height;
+		last_tile = min((max(bounds.bottom, 1) - 1) / tile_height, num_tiles - 1);
+		if (bounds.get_width() <= 0 || bounds.get_height() <= 0)
+			last_tile = first_tile - 1;
+
+		entry.type = command_draw;
+		entry.visible_rect = bounds;
+		if (occlusion_state.clip_rect_known)
+			entry.visible_rect.overlap(occlusion_state.clip_rect);
+	}
+	else if (entry.opaque)
+	{
+		entry.type = command_draw;
+		entry.visible_rect = entry.opaque_rect;
+	}
+	else if (command->update_occlusion_state(occlusion_state))
+	{
+		entry.type = command_state;
+	}
+	else
+	{
+		entry.type = command_barrier;
+	}
+
+	int index = batch.commands.size();
+	batch.commands.push_back(entry);
+	for (int tile = first_tile; tile <= last_tile; tile++)
+		batch.bins[tile].push_back(index);
+
+	if (batch.commands.size() == batch_size)
+		end_batch();
+
+#ifdef PROFILE_PIPELINE
+	ubyte64 end_time = System::get_microseconds();
+	profiler.queue_time += end_time-start_time;
+#endif
+}
+
+void PixelPipeline::begin_batch()
+{
+	// Block until the workers have retired the batch previously stored in this slot
+	wait_for_batches(max_batches - 1);
+
+	Batch &batch = batches[local_batches_written % max_batches];
+	for (size_t i = 0; i < batch.commands.size(); i++)
+		delete batch.commands[i].command;
+	batch.commands.clear();
+
+	// Without a frame buffer size the single tile is unbounded and too large for a coverage mask
+	batch.occlusion_culling = occlusion_culling && !tiles.empty();
+	if (tiles.empty())
+		tiles.push_back(PixelThreadContext(Rect(0, 0, 0x7fffffff, 0x7fffffff)));
+
+	batch.bins.resize(tiles.size());
+	for (size_t i = 0; i < batch.bins.size(); i++)
+		batch.bins[i].clear();
+
+	local_batch_open = true;
+}
+
+void PixelPipeline::end_batch()
+{
+	local_batch_open = false;
+	local_batches_written++;
+	cl_compiler_barrier();
+	batches_written.set(local_batches_written);
+
+#ifdef PROFILE_PIPELINE
+	ubyte64 start_event_time = System::get_microseconds();
+#endif
+	for (int i = 0; i < active_cores; i++)
+	{
+		if (reader_active[i].get() == 0)
+			event_more_commands[i].set();
+	}
+#ifdef PROFILE_PIPELINE
+	ubyte64 end_event_time = System::get_microseconds();
+	profiler.set_event_time += end_event_time-start_event_time;
+#endif
+}
+
+void PixelPipeline::wait_for_batches(int max_pending)
+{
+#ifdef PROFILE_PIPELINE
+	ubyte64 start_time = System::get_microseconds();
+#endif
+
+	while (true)
+	{
+		int pending = 0;
+		for (int i = 0; i < active_cores; i++)
+			pending = max(pending, local_batches_written - batches_retired[i].get());
+		if (pending <= max_pending)
+			break;
+
+		event_reader_done.wait();
+		event_reader_done.reset();
+	}
+
+#ifdef PROFILE_PIPELINE
+	ubyte64 end_time = System::get_microseconds();
+	profiler.wait_for_space_time += end_time-start_time;
+#endif
+}
+
 void PixelPipeline::worker_main(int core)
 {
 #if defined(WIN32) && defined(PROFILE_PIPELINE)
 	SetThreadIdealProcessor(GetCurrentThread(), core);
 	SetThreadAffinityMask(GetCurrentThread(), 1 << core);
-	unsigned __int64 ticks_waiting = 0;
-	unsigned __int64 ticks_working = 0;
+#endif
+#ifdef PROFILE_PIPELINE
+	WorkerCounters &counters = worker_profilers[core];
 #endif
 	PixelThreadContext context(core, active_cores);
 	while (true)
 	{
-#if defined(WIN32) && defined(PROFILE_PIPELINE)
-		unsigned __int64 wait_start_time = __rdtsc();
+#ifdef PROFILE_PIPELINE
+		ubyte64 wait_start_time = System::get_microseconds();
 #endif
 		int wakeup_reason = Event::wait(event_more_commands[core], event_stop);
 		if (wakeup_reason != 0)
 			break;
 		event_more_commands[core].reset();
-#if defined(WIN32) && defined(PROFILE_PIPELINE)
-		unsigned __int64 wait_end_time = __rdtsc();
-		ticks_waiting += wait_end_time-wait_start_time;
+#ifdef PROFILE_PIPELINE
+		ubyte64 wait_end_time = System::get_microseconds();
+		counters.time_waiting += wait_end_time-wait_start_time;
 #endif
-		process_commands(&context);
-#if defined(WIN32) && defined(PROFILE_PIPELINE)
-		unsigned __int64 commands_end_time = __rdtsc();
-		ticks_working += commands_end_time-wait_end_time;
+		if (tiled)
+			process_batches(core);
+		else
+			process_commands(&context);
+#ifdef PROFILE_PIPELINE
+		ubyte64 commands_end_time = System::get_microseconds();
+		counters.time_working += commands_end_time-wait_end_time;
 #endif
 	}
-#if defined(WIN32) && defined(PROFILE_PIPELINE)
-	MessageBoxA(
-		0,
-		cl_format("Pipeline core %1 spent %2 percent of its time waiting for commands",
-		core,
-		(int)(ticks_waiting*100/(ticks_working+ticks_waiting))).c_str(),
-		"DEBUG", MB_OK);
-#endif
 }
 
 void PixelPipeline::process_commands(PixelThreadContext *context)
@@ -275,6 +481,9 @@ void PixelPipeline::process_commands(PixelThreadContext *context)
 		{
 			PixelCommand *command = command_queue[worker_reader_index];
 			command->run(context);
+#ifdef PROFILE_PIPELINE
+			worker_profilers[context->core].commands_run++;
+#endif
 
 			worker_reader_index++;
 			if (worker_reader_index == queue_max)
@@ -301,10 +510,91 @@ void PixelPipeline::process_commands(PixelThreadContext *context)
 	}
 }
 
+void PixelPipeline::process_batches(int core)
+{
+	while (true)
+	{
+		int worker_batches_retired = batches_retired[core].get();
+		int worker_batches_written = batches_written.get();
+		if (worker_batches_retired == worker_batches_written)
+			break;
+
+		reader_active[core].set(1);
+		while (worker_batches_retired != worker_batches_written)
+		{
+			Batch &batch = batches[worker_batches_retired % max_batches];
+
+			// Each core owns every active_cores'th tile, keeping its part of the frame buffer in its own cache
+			TileWorker &worker = tile_workers[core];
+			int num_tiles = batch.bins.size();
+			for (int tile = core; tile < num_tiles; tile += active_cores)
+			{
+				const std::vector<int> &bin = batch.bins[tile];
+				PixelThreadContext *context = &tiles[tile];
+
+				worker.culled.assign(bin.size(), false);
+				if (batch.occlusion_culling)
+					cull_tile(batch, bin, context->tile_rect, worker);
+
+				for (size_t i = 0; i < bin.size(); i++)
+				{
+					const BatchCommand &entry = batch.commands[bin[i]];
+					if (entry.type == command_draw)
+					{
+						Rect box = entry.visible_rect;
+						box.overlap(context->tile_rect);
+						ubyte64 pixels = (ubyte64)box.get_width() * (ubyte64)box.get_height();
+						if (worker.culled[i])
+						{
+							worker.counters.commands_culled++;
+							worker.counters.pixels_culled += pixels;
+							continue;
+						}
+						worker.counters.commands_run++;
+						worker.counters.pixels_drawn += pixels;
+					}
+					entry.command->run(context);
+				}
+#ifdef PROFILE_PIPELINE
+				worker_profilers[core].commands_run += bin.size();
+				worker_profilers[core].commands_skipped += batch.commands.size() - bin.size();
+#endif
+			}
+
+			worker_batches_retired++;
+			cl_compiler_barrier();
+			batches_retired[core].set(worker_batches_retired);
+			event_reader_done.set();
+		}
+		reader_active[core].set(0);
+	}
+}
+
+void PixelPipeline::cull_tile(const Batch &batch, const std::vector<int> &bin, const Rect &tile_rect, TileWorker &worker)
+{
+	// Walk the tile front to back, so a command is culled when the opaque commands drawn after it cover everything it may write
+	worker.coverage.reset(tile_rect);
+	for (size_t i = bin.size(); i > 0; i--)
+	{
+		const BatchCommand &entry = batch.commands[bin[i - 1]];
+		if (entry.type == command_barrier)
+		{
+			worker.coverage.clear();
+		}
+		else if (entry.type == command_draw)
+		{
+			if (worker.coverage.is_covered(entry.visible_rect))
+				worker.culled[i - 1] = true;
+			else if (entry.opaque)
+				worker.coverage.add(entry.opaque_rect);
+		}
+	}
+}
+
 void *PixelPipeline::alloc_command(size_t s)
 {
-#if defined(WIN32) && defined(PROFILE_PIPELINE)
-	unsigned __int64 start_time = __rdtsc();
+#ifdef PROFILE_PIPELINE
+	ubyte64 start_time = System::get_microseconds();
 #endif
 
 	s += sizeof(unsigned int);
@@ -335,8 +625,8 @@ void *PixelPipeline::alloc_command(size_t s)
 	cur_block->pos += s;
 	cur_block->refcount++;
 
-#if defined(WIN32) && defined(PROFILE_PIPELINE)
-	unsigned __int64 end_time = __rdtsc();
+#ifdef PROFILE_PIPELINE
+	ubyte64 end_time = System::get_microseconds();
 	profiler.alloc_time += end_time-start_time;
 #endif
 
@@ -345,8 +635,8 @@ void *PixelPipeline::alloc_command(size_t s)
 
 void PixelPipeline::free_command(void *d)
 {
-#if defined(WIN32) && defined(PROFILE_PIPELINE)
-	unsigned __int64 start_time = __rdtsc();
+#ifdef PROFILE_PIPELINE
+	ubyte64 start_time = System::get_microseconds();
 #endif
 
 	char *data = (char *) d;
@@ -357,8 +647,8 @@ void PixelPipeline::free_command(void *d)
 	if (block->refcount == 0)
 		delete[] (char*) block;
 
-#if defined(WIN32) && defined(PROFILE_PIPELINE)
-	unsigned __int64 end_time = __rdtsc();
+#ifdef PROFILE_PIPELINE
+	ubyte64 end_time = System::get_microseconds();
 	profiler.alloc_time += end_time-start_time;
 #endif
 }
@@ -32,9 +32,12 @@
 #include "API/Core/System/event.h"
 #include "API/Core/System/thread.h"
 #include "API/Core/System/interlocked_variable.h"
+#include "API/Core/Math/size.h"
 
 
 #include "API/SWRender/pixel_command.h"
+#include "API/SWRender/swr_graphic_context.h"
+#include "pixel_coverage_mask.h"
 #include <memory>
 
 namespace clan
@@ -45,7 +48,11 @@ class PixelCommand;
 class PixelPipeline
 {
 public:
-	PixelPipeline();
+	/// \brief Constructs the pipeline and starts a worker thread per core
+	///
+	/// \param tiled = Split the frame buffer into horizontal tiles owned by the workers, instead of interleaving lines between them
+	/// \param occlusion_culling = Skip commands hidden by later opaque commands in the same tile. Only used when tiled.
+	PixelPipeline(bool tiled = false, bool occlusion_culling = false);
 	~PixelPipeline();
 
 	void queue(PixelCommand *command) { std::unique_ptr<PixelCommand> cmd(command); queue(cmd); } 
@@ -53,6 +60,18 @@ public:
 
 	void wait_for_workers();
 
+	/// \brief Sets the frame buffer size used to divide the screen into tiles
+	///
+	/// Waits for the workers to finish. Tiles added by a larger size start out with the state of the first tile,
+	/// except for the clipping rectangle which must be set again afterwards.
+	void set_framebuffer_size(const Size &size);
+
+	/// \brief Returns the overdraw counters summed over all workers. Waits for the workers to finish.
+	PixelOverdrawCounters get_overdraw_counters();
+
+	/// \brief Sets the overdraw counters to zero. Waits for the workers to finish.
+	void reset_overdraw_counters();
+
 	void *alloc_command(size_t s);
 	void free_command(void *d);
 
@@ -62,6 +81,13 @@ private:
 	void wait_for_space();
 	void update_local_reader_index();
 
+	void queue_tiled(PixelCommand *command);
+	void begin_batch();
+	void end_batch();
+	void wait_for_batches(int max_pending);
+	void process_batches(int core);
+
+	bool tiled;
 	int active_cores;
 	Event event_stop;
 	std::vector<Thread> worker_threads;
@@ -79,6 +105,57 @@ private:
 
 	std::vector<InterlockedVariable> reader_active;
 
+	enum BatchCommandType
+	{
+		command_state,   // Only changes thread context state, never culled
+		command_draw,    // Draws inside visible_rect, culled when the rectangle is hidden in a tile
+		command_barrier  // May read or replace the frame buffer, earlier commands are never culled across it
+	};
+
+	struct BatchCommand
+	{
+		PixelCommand *command;
+		BatchCommandType type;
+		Rect visible_rect;
+		bool opaque;
+		Rect opaque_rect;
+	};
+
+	/// \brief Commands queued in tile mode, binned by the tiles they touch
+	///
+	/// The vectors keep their capacity when a batch is reused, so a batch grows to the largest
+	/// number of commands ever placed in it instead of having a fixed queue size.
+	/// Bins hold indices into the commands vector.
+	struct Batch
+	{
+		Batch() : occlusion_culling(false) { }
+
+		std::vector<BatchCommand> commands;
+		std::vector<std::vector<int> > bins;
+		bool occlusion_culling;
+	};
+
+	/// \brief Scratch data and counters of a worker in tile mode
+	struct TileWorker
+	{
+		PixelCoverageMask coverage;
+		std::vector<bool> culled;
+		PixelOverdrawCounters counters;
+	};
+
+	void cull_tile(const Batch &batch, const std::vector<int> &bin, const Rect &tile_rect, TileWorker &worker);
+
+	enum { max_batches = 4, batch_size = 1024, tile_height = 32 };
+	Batch batches[max_batches];
+	std::vector<PixelThreadContext> tiles;
+	std::vector<TileWorker> tile_workers;
+	bool occlusion_culling;
+	PixelOcclusionState occlusion_state;
+	bool local_batch_open;
+	int local_batches_written;
+	InterlockedVariable batches_written;
+	std::vector<InterlockedVariable> batches_retired;
+
 	struct AllocBlock
 	{
 		size_t size;
@@ -92,14 +169,24 @@ private:
 	struct PerformanceCounters
 	{
 		PerformanceCounters() : start_time(0), end_time(0), queue_time(0), set_event_time(0), wait_for_workers_time(0), wait_for_space_time(0), alloc_time(0) { }
-		unsigned __int64 start_time;
-		unsigned __int64 end_time;
-		unsigned __int64 queue_time;
-		unsigned __int64 set_event_time;
-		unsigned __int64 wait_for_workers_time;
-		unsigned __int64 wait_for_space_time;
-		unsigned __int64 alloc_time;
+		ubyte64 start_time;
+		ubyte64 end_time;
+		ubyte64 queue_time;
+		ubyte64 set_event_time;
+		ubyte64 wait_for_workers_time;
+		ubyte64 wait_for_space_time;
+		ubyte64 alloc_time;
 	} profiler;
+
+	struct WorkerCounters
+	{
+		WorkerCounters() : time_waiting(0), time_working(0), commands_run(0), commands_skipped(0) { }
+		ubyte64 time_waiting;
+		ubyte64 time_working;
+		ubyte64 commands_run;
+		ubyte64 commands_skipped;
+	};
+	std::vector<WorkerCounters> worker_profilers;
 	#endif
 };
 
@@ -35,10 +35,28 @@ namespace clan
 PixelThreadContext::PixelThreadContext(int core, int num_cores)
 : core(core),
   num_cores(num_cores),
+  tile_rect(0, 0, 0x7fffffff, 0x7fffffff),
   cur_blend_src(blend_src_alpha),
   cur_blend_dest(blend_one_minus_src_alpha),
   cur_blend_src_alpha(blend_one), 
   cur_blend_dest_alpha(blend_one_minus_src_alpha)
+{
+	init_samplers();
+}
+
+PixelThreadContext::PixelThreadContext(const Rect &tile_rect)
+: core(0),
+  num_cores(1),
+  tile_rect(tile_rect),
+  cur_blend_src(blend_src_alpha),
+  cur_blend_dest(blend_one_minus_src_alpha),
+  cur_blend_src_alpha(blend_one), 
+  cur_blend_dest_alpha(blend_one_minus_src_alpha)
+{
+	init_samplers();
+}
+
+void PixelThreadContext::init_samplers()
 {
 	unsigned int white = 0xffffffff;
 	pixelbuffer_white = PixelBuffer(1, 1, tf_bgra8, &white);
@@ -41,7 +41,7 @@ namespace clan
 // http://members.bellatlantic.net/~vze2vrva/magnify_c.txt
 
 PixelBicubicRenderer::PixelBicubicRenderer()
-: h_vector(0), dest(0), dest_width(0), dest_height(0), src(0), src_width(0), src_height(0), core(0), num_cores(1)
+: h_vector(0), dest(0), dest_width(0), dest_height(0), src(0), src_width(0), src_height(0), core(0), num_cores(1), clip_rect_set(false)
 {
 	for (int i = 0; i < 4; i++)
 		c_vector[i] = 0;
@@ -72,12 +72,29 @@ void PixelBicubicRenderer::set_core(int new_core, int new_num_cores)
 	num_cores = new_num_cores;
 }
 
+void PixelBicubicRenderer::set_clip_rect(const Rect &new_clip_rect)
+{
+	clip_rect = new_clip_rect;
+	clip_rect_set = true;
+}
+
 void PixelBicubicRenderer::render(int x, int y, int zoom_number, int zoom_denominator)
 {
-	scale(-0.5f, zoom_number, zoom_denominator, src_width, src_width*4, src_height, src, src_width*zoom_number/zoom_denominator, dest_width*4, src_height*zoom_number/zoom_denominator, dest+x+y*dest_width);
+	int out_width = src_width*zoom_number/zoom_denominator;
+	int out_height = src_height*zoom_number/zoom_denominator;
+
+	Rect box(0, 0, dest_width, dest_height);
+	if (clip_rect_set)
+		box.overlap(clip_rect);
+	box.translate(Vec2i(-x, -y));
+	box.overlap(Rect(0, 0, out_width, out_height));
+	if (box.get_width() <= 0 || box.get_height() <= 0)
+		return;
+
+	scale(-0.5f, zoom_number, zoom_denominator, src_width, src_width*4, src_height, src, out_width, dest_width*4, out_height, dest+x+y*dest_width, box);
 }
 
-void PixelBicubicRenderer::scale(float a, int n, int d, int in_width, int in_pitch, int in_height, const unsigned int *in_data, int out_width, int out_pitch, int out_height, unsigned int *out_data)
+void PixelBicubicRenderer::scale(float a, int n, int d, int in_width, int in_pitch, int in_height, const unsigned int *in_data, int out_width, int out_pitch, int out_height, unsigned int *out_data, const Rect &out_box)
 {
 	prepare(a, n, d, in_width, out_width, out_height);
 	int *L = get_L();
@@ -87,7 +104,7 @@ void PixelBicubicRenderer::scale(float a, int n, int d, int in_width, int in_pit
 	const unsigned char *in_data8 = (const unsigned char *) in_data;
 	unsigned char *out_data8 = (unsigned char *) out_data;
 
-	for (int k = find_first_line_for_core(0, core, num_cores); k < out_height; k += num_cores)
+	for (int k = find_first_line_for_core(out_box.top, core, num_cores); k < out_box.bottom; k += num_cores)
 	{
 		for (int j = 0; j < in_width; j++)
 		{
@@ -104,7 +121,7 @@ void PixelBicubicRenderer::scale(float a, int n, int d, int in_width, int in_pit
 				}
 			}
 		}
-		for (int m = 0; m < out_width; m++)
+		for (int m = out_box.left; m < out_box.right; m++)
 		{
 			__m128 x = _mm_set1_ps(0.5f);
 			for (int l = 0; l < 4; l++)
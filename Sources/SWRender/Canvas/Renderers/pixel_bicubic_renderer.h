@@ -42,6 +42,7 @@ public:
 	void set_dest(unsigned int *data, int width, int height);
 	void set_src(unsigned int *data, int width, int height);
 	void set_core(int core, int num_cores);
+	void set_clip_rect(const Rect &clip_rect);
 
 	void render(int x, int y, int zoom_number, int zoom_denominator);
 
@@ -52,7 +53,9 @@ private:
 	/// be a rational number, so we can represent it in a program with a pair of integer variables, n and d, such that r = n/d
 	/// 
 	/// a is a spline parameter such that -1 <= a <= 0
-	void scale(float a, int n, int d, int in_width, int in_pitch, int in_height, const unsigned int *in_data, int out_width, int out_pitch, int out_height, unsigned int *out_data);
+	///
+	/// Only the pixels inside out_box, given in output coordinates, are written.
+	void scale(float a, int n, int d, int in_width, int in_pitch, int in_height, const unsigned int *in_data, int out_width, int out_pitch, int out_height, unsigned int *out_data, const Rect &out_box);
 
 	static int find_first_line_for_core(int y_start, int core, int num_cores);
 	static int get_larger_out_dimension(int out_width, int out_height);
@@ -84,6 +87,9 @@ private:
 
 	int core;
 	int num_cores;
+
+	Rect clip_rect;
+	bool clip_rect_set;
 };
 
 }
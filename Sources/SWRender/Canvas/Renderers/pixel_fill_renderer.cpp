@@ -29,6 +29,7 @@
 #include "SWRender/precomp.h"
 #include "pixel_fill_renderer.h"
 #include "API/Display/2D/color.h"
+#include "pixel_span_avx2.h"
 #include <emmintrin.h>
 
 namespace clan
@@ -36,7 +37,7 @@ namespace clan
 
 
 PixelFillRenderer::PixelFillRenderer()
-: core(0), num_cores(1)
+: core(0), num_cores(1), use_avx2(PixelSpanAVX2::is_supported())
 {
 }
 
@@ -131,8 +132,15 @@ void PixelFillRenderer::fill_rect(const Rect &dest, const Colorf &primary_color)
 			unsigned int color = (salpha<<24) + (sred<<16) + (sgreen<<8) + sblue;
 			while (dest_y < end_y)
 			{
-				for (int x = 0; x < line_length; x++)
-					dest_line[x] = color;
+				if (use_avx2)
+				{
+					PixelSpanAVX2::fill(dest_line, line_length, color);
+				}
+				else
+				{
+					for (int x = 0; x < line_length; x++)
+						dest_line[x] = color;
+				}
 
 				dest_y += num_cores;
 				dest_line += dest_line_incr;
@@ -142,26 +150,34 @@ void PixelFillRenderer::fill_rect(const Rect &dest, const Colorf &primary_color)
 		{
 			unsigned int pos_salpha = salpha*256/255;
 			unsigned int neg_salpha = 256-salpha;
+			unsigned int color = (salpha<<24) + (sred<<16) + (sgreen<<8) + sblue;
 			while (dest_y < end_y)
 			{
-				for (int x = 0; x < line_length; x++)
+				if (use_avx2)
+				{
+					PixelSpanAVX2::fill_blend(dest_line, line_length, color, pos_salpha, neg_salpha);
+				}
+				else
 				{
-					#define alpha_component(a) (((a)&0xff000000)>>24)
-					#define red_component(a) (((a)&0x00ff0000)>>16)
-					#define green_component(a) (((a)&0x0000ff00)>>8)
-					#define blue_component(a) ((a)&0x000000ff)
-
-					unsigned int dest_color = dest_line[x];
-					unsigned int dred = red_component(dest_color);
-					unsigned int dgreen = green_component(dest_color);
-					unsigned int dblue = blue_component(dest_color);
-					unsigned int dalpha = alpha_component(dest_color);
-
-					unsigned red = (dred * neg_salpha + sred * pos_salpha) >> 8;
-					unsigned green = (dgreen * neg_salpha + sgreen * pos_salpha) >> 8;
-					unsigned blue = (dblue * neg_salpha + sblue * pos_salpha) >> 8;
-					unsigned alpha = (dalpha * neg_salpha + salpha * pos_salpha) >> 8;
-					dest_line[x] = (alpha<<24) + (red<<16) + (green<<8) + blue;
+					for (int x = 0; x < line_length; x++)
+					{
+						#define alpha_component(a) (((a)&0xff000000)>>24)
+						#define red_component(a) (((a)&0x00ff0000)>>16)
+						#define green_component(a) (((a)&0x0000ff00)>>8)
+						#define blue_component(a) ((a)&0x000000ff)
+
+						unsigned int dest_color = dest_line[x];
+						unsigned int dred = red_component(dest_color);
+						unsigned int dgreen = green_component(dest_color);
+						unsigned int dblue = blue_component(dest_color);
+						unsigned int dalpha = alpha_component(dest_color);
+
+						unsigned red = (dred * neg_salpha + sred * pos_salpha) >> 8;
+						unsigned green = (dgreen * neg_salpha + sgreen * pos_salpha) >> 8;
+						unsigned blue = (dblue * neg_salpha + sblue * pos_salpha) >> 8;
+						unsigned alpha = (dalpha * neg_salpha + salpha * pos_salpha) >> 8;
+						dest_line[x] = (alpha<<24) + (red<<16) + (green<<8) + blue;
+					}
 				}
 
 				dest_y += num_cores;
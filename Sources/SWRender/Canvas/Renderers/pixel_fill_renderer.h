@@ -63,6 +63,7 @@ private:
 	Rect clip_rect;
 	int core;
 	int num_cores;
+	bool use_avx2;
 };
 
 }
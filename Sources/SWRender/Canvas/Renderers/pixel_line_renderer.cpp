@@ -76,10 +76,11 @@ int PixelLineRenderer::find_first_line_for_core(int y_start, int core, int num_c
 
 void PixelLineRenderer::draw_line(const LineSegment2 &line_dest, const Colorf &primary_color)
 {
-	// Clip the input line
+	// Clip the input line to the frame buffer. The clipping rectangle is applied per pixel,
+	// so the pixels chosen for a line do not depend on how it is clipped.
 	LineSegment2 line(line_dest);
 	bool clipped;
-	line.clip(clip_rect, clipped);
+	line.clip(Rect(0, 0, dest_width, dest_height), clipped);
 	if (!clipped)	// Off screen
 		return;
 
@@ -115,17 +116,17 @@ void PixelLineRenderer::draw_line(const LineSegment2 &line_dest, const Colorf &p
 				line.q.x = t;
 			}
 
-			if(dest_y>=dest_height)
-			{
-				//abort
+			if (dest_y < clip_rect.top || dest_y >= clip_rect.bottom)
 				return;
-			}
+
+			int xstart = max(line.p.x, clip_rect.left);
+			int xend = min(line.q.x, clip_rect.right);
 
 			unsigned int *dest_line = dest+dest_y*dest_width;
 			if (salpha == 255)
 			{
 				unsigned int color = (salpha<<24) + (sred<<16) + (sgreen<<8) + sblue;
-				for (int x = line.p.x; x < line.q.x; x++)
+				for (int x = xstart; x < xend; x++)
 				{
 					dest_line[x] = color;
 				}
@@ -135,7 +136,7 @@ void PixelLineRenderer::draw_line(const LineSegment2 &line_dest, const Colorf &p
 				unsigned int pos_salpha = salpha*256/255;
 				unsigned int neg_salpha = 256-salpha;
 
-				for (int x = line.p.x; x < line.q.x; x++)
+				for (int x = xstart; x < xend; x++)
 				{
 					unsigned int dest_color = dest_line[x];
 					unsigned int dred = red_component(dest_color);
@@ -155,8 +156,10 @@ void PixelLineRenderer::draw_line(const LineSegment2 &line_dest, const Colorf &p
 	// All other lines
 	else
 	{
-		int dest_y = find_first_line_for_core(line.p.y, core, num_cores);
+		int dest_y = find_first_line_for_core(max(line.p.y, clip_rect.top), core, num_cores);
 		unsigned int *dest_line = dest+dest_y*dest_width+line.p.x;
+		int clip_left = clip_rect.left - line.p.x;
+		int clip_right = clip_rect.right - line.p.x;
 
 		float line_ratio = ( (float) (line.q.x - line.p.x))  / ( (float) (line.q.y - line.p.y) );
 
@@ -165,7 +168,7 @@ void PixelLineRenderer::draw_line(const LineSegment2 &line_dest, const Colorf &p
 		if (salpha == 255)
 		{
 			unsigned int color = (salpha<<24) + (sred<<16) + (sgreen<<8) + sblue;
-			int length_y = line.q.y - line.p.y;
+			int length_y = min(line.q.y, clip_rect.bottom) - line.p.y;
 			for (int y=dest_y - line.p.y; y < length_y; y += num_cores)
 			{
 				int xstart = (int) (( ((float) y) * line_ratio));
@@ -180,6 +183,8 @@ void PixelLineRenderer::draw_line(const LineSegment2 &line_dest, const Colorf &p
 					xstart = xend;
 					xend = t;
 				}
+				xstart = max(xstart, clip_left);
+				xend = min(xend, clip_right);
 				for (int x = xstart; x < xend; x++)
 					dest_line[x] = color;
 
@@ -191,7 +196,7 @@ void PixelLineRenderer::draw_line(const LineSegment2 &line_dest, const Colorf &p
 			unsigned int pos_salpha = salpha*256/255;
 			unsigned int neg_salpha = 256-salpha;
 
-			int length_y = line.q.y - line.p.y;
+			int length_y = min(line.q.y, clip_rect.bottom) - line.p.y;
 			for (int y=dest_y - line.p.y; y < length_y; y += num_cores)
 			{
 				int xstart = (int) (( ((float) y) * line_ratio));
@@ -206,6 +211,8 @@ void PixelLineRenderer::draw_line(const LineSegment2 &line_dest, const Colorf &p
 					xstart = xend;
 					xend = t;
 				}
+				xstart = max(xstart, clip_left);
+				xend = min(xend, clip_right);
 
 				for (int x = xstart; x < xend; x++)
 				{
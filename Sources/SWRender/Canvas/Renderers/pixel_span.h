@@ -0,0 +1,91 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Magnus Norddahl
+*/
+
+#pragma once
+
+#include "API/Display/Render/blend_state.h"
+#include "API/SWRender/blit_argb8_sse.h"
+
+namespace clan
+{
+
+/// \brief Blend function combinations with their own span kernels
+enum PixelSpanBlend
+{
+	span_blend_normal,        // src_alpha, one_minus_src_alpha
+	span_blend_premultiplied, // one, one_minus_src_alpha
+	span_blend_copy           // one, zero
+};
+
+/// \brief Returns the span kernel for a blend function combination
+///
+/// Combinations without a kernel of their own use span_blend_normal.
+inline PixelSpanBlend get_span_blend(BlendFunc src, BlendFunc dest, BlendFunc src_alpha, BlendFunc dest_alpha)
+{
+	if (src == blend_one && dest == blend_zero && src_alpha == blend_one && dest_alpha == blend_zero)
+		return span_blend_copy;
+	else if (src == blend_one && dest == blend_one_minus_src_alpha)
+		return span_blend_premultiplied;
+	else
+		return span_blend_normal;
+}
+
+/// \brief Start values and per pixel steps for a textured span, in 16.16 fixed point
+///
+/// Texture coordinates are in texels. Colors are 0-65536 for each channel.
+struct PixelSpanGradients
+{
+	int tx, ty;
+	int dtx, dty;
+	int red, green, blue, alpha;
+	int dred, dgreen, dblue, dalpha;
+};
+
+/// \brief Blends unpacked 16 bit channels of two pixels with the blend function combination given by the template argument
+template<PixelSpanBlend blend>
+inline void pixel_span_blend_sse2(__m128i &dest, __m128i &src, __m128i &one, __m128i &half);
+
+template<>
+inline void pixel_span_blend_sse2<span_blend_normal>(__m128i &dest, __m128i &src, __m128i &one, __m128i &half)
+{
+	BlitARGB8SSE::blend_normal(dest, src, one, half);
+}
+
+template<>
+inline void pixel_span_blend_sse2<span_blend_premultiplied>(__m128i &dest, __m128i &src, __m128i &one, __m128i &half)
+{
+	BlitARGB8SSE::blend_premultiplied(dest, src, one, half);
+}
+
+template<>
+inline void pixel_span_blend_sse2<span_blend_copy>(__m128i &dest, __m128i &src, __m128i &one, __m128i &half)
+{
+	dest = src;
+}
+
+}
@@ -0,0 +1,396 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Magnus Norddahl
+*/
+
+#include "SWRender/precomp.h"
+#include "pixel_span_avx2.h"
+
+#if defined(_MSC_VER) && _MSC_VER >= 1800 && (defined(_M_IX86) || defined(_M_X64))
+	#define CL_SPAN_AVX2
+	#define cl_avx2_target
+#elif (defined(__clang__) || (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)))) && (defined(__i386__) || defined(__x86_64__))
+	// Only the functions marked with the target attribute are compiled for AVX2, so the rest of the library still runs on any SSE2 CPU
+	#define CL_SPAN_AVX2
+	#define cl_avx2_target __attribute__((target("avx2")))
+#endif
+
+#ifdef CL_SPAN_AVX2
+#include <immintrin.h>
+#endif
+
+namespace clan
+{
+
+#ifdef CL_SPAN_AVX2
+
+/////////////////////////////////////////////////////////////////////////////
+// AVX2 kernels:
+
+template<PixelSpanBlend blend>
+cl_avx2_target static inline void pixel_span_blend_avx2(__m256i &dest, __m256i &src, const __m256i &one, const __m256i &half);
+
+template<>
+cl_avx2_target inline void pixel_span_blend_avx2<span_blend_normal>(__m256i &dest, __m256i &src, const __m256i &one, const __m256i &half)
+{
+	__m256i src_alpha = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(src, 0xff), 0xff);
+	__m256i invsrc_alpha = _mm256_sub_epi16(one, src_alpha);
+	src = _mm256_mullo_epi16(src, src_alpha);
+	dest = _mm256_mullo_epi16(dest, invsrc_alpha);
+	dest = _mm256_add_epi16(dest, src);
+	dest = _mm256_add_epi16(dest, half); // round up
+	dest = _mm256_srli_epi16(dest, 8);
+}
+
+template<>
+cl_avx2_target inline void pixel_span_blend_avx2<span_blend_premultiplied>(__m256i &dest, __m256i &src, const __m256i &one, const __m256i &half)
+{
+	__m256i src_alpha = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(src, 0xff), 0xff);
+	__m256i invsrc_alpha = _mm256_sub_epi16(one, src_alpha);
+	dest = _mm256_mullo_epi16(dest, invsrc_alpha);
+	dest = _mm256_add_epi16(dest, half); // round up
+	dest = _mm256_srli_epi16(dest, 8);
+	dest = _mm256_add_epi16(dest, src);
+}
+
+template<>
+cl_avx2_target inline void pixel_span_blend_avx2<span_blend_copy>(__m256i &dest, __m256i &src, const __m256i &one, const __m256i &half)
+{
+	dest = src;
+}
+
+cl_avx2_target static inline void pixel_span_texture_repeat_avx2(__m256i &tx, __m256i &ty, const __m256i &width, const __m256i &height)
+{
+	__m256i zero = _mm256_setzero_si256();
+	while (true)
+	{
+		__m256i compare_result = _mm256_cmpgt_epi32(zero, tx);
+		if (_mm256_movemask_epi8(compare_result) == 0)
+			break;
+		tx = _mm256_add_epi32(tx, _mm256_and_si256(compare_result, width));
+	}
+	while (true)
+	{
+		__m256i compare_result = _mm256_cmpgt_epi32(width, tx);
+		if (_mm256_movemask_epi8(compare_result) == -1)
+			break;
+		tx = _mm256_sub_epi32(tx, _mm256_andnot_si256(compare_result, width));
+	}
+	while (true)
+	{
+		__m256i compare_result = _mm256_cmpgt_epi32(zero, ty);
+		if (_mm256_movemask_epi8(compare_result) == 0)
+			break;
+		ty = _mm256_add_epi32(ty, _mm256_and_si256(compare_result, height));
+	}
+	while (true)
+	{
+		__m256i compare_result = _mm256_cmpgt_epi32(height, ty);
+		if (_mm256_movemask_epi8(compare_result) == -1)
+			break;
+		ty = _mm256_sub_epi32(ty, _mm256_andnot_si256(compare_result, height));
+	}
+}
+
+/// \brief Interpolation state for eight pixels of a span
+///
+/// The 128 bit lanes of the colors hold pixel 0 and 4 of the block, which matches how
+/// _mm256_unpacklo_epi8 and _mm256_unpackhi_epi8 split the pixels into 16 bit channels.
+struct PixelSpanStateAVX2
+{
+	__m256i tx, ty, inc_tx, inc_ty;
+	__m256i color, inc_color, inc_color8;
+	__m256i src_width, src_width16, src_height, src_height16;
+	__m256i one, half;
+};
+
+cl_avx2_target static inline void pixel_span_setup_avx2(PixelSpanStateAVX2 &state, int src_width, int src_height, const PixelSpanGradients &gradients)
+{
+	__m256i lanes = _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+	state.tx = _mm256_add_epi32(_mm256_set1_epi32(gradients.tx), _mm256_mullo_epi32(lanes, _mm256_set1_epi32(gradients.dtx)));
+	state.ty = _mm256_add_epi32(_mm256_set1_epi32(gradients.ty), _mm256_mullo_epi32(lanes, _mm256_set1_epi32(gradients.dty)));
+	state.inc_tx = _mm256_slli_epi32(_mm256_set1_epi32(gradients.dtx), 3);
+	state.inc_ty = _mm256_slli_epi32(_mm256_set1_epi32(gradients.dty), 3);
+
+	__m128i color0 = _mm_set_epi32(gradients.alpha, gradients.red, gradients.green, gradients.blue);
+	__m128i inc_color = _mm_set_epi32(gradients.dalpha, gradients.dred, gradients.dgreen, gradients.dblue);
+	__m128i color4 = _mm_add_epi32(color0, _mm_slli_epi32(inc_color, 2));
+	state.color = _mm256_inserti128_si256(_mm256_castsi128_si256(color0), color4, 1);
+	state.inc_color = _mm256_inserti128_si256(_mm256_castsi128_si256(inc_color), inc_color, 1);
+	state.inc_color8 = _mm256_slli_epi32(state.inc_color, 3);
+
+	state.src_width = _mm256_set1_epi32(src_width);
+	state.src_width16 = _mm256_set1_epi32(src_width << 16);
+	state.src_height = _mm256_set1_epi32(src_height);
+	state.src_height16 = _mm256_set1_epi32(src_height << 16);
+	state.one = _mm256_set1_epi16(0x0100);
+	state.half = _mm256_set1_epi16(0x007f);
+}
+
+template<PixelSpanBlend blend>
+cl_avx2_target static inline void pixel_span_nearest_block_avx2(PixelSpanStateAVX2 &state, unsigned int *dest, const unsigned int *src)
+{
+	__m256i zero = _mm256_setzero_si256();
+
+	pixel_span_texture_repeat_avx2(state.tx, state.ty, state.src_width16, state.src_height16);
+	__m256i offset = _mm256_add_epi32(_mm256_srai_epi32(state.tx, 16), _mm256_mullo_epi32(_mm256_srai_epi32(state.ty, 16), state.src_width));
+	__m256i p8src = _mm256_i32gather_epi32((const int *) src, offset, 4);
+	__m256i p8dest = _mm256_loadu_si256((const __m256i *) dest);
+
+	__m256i color_a = state.color;
+	__m256i color_b = _mm256_add_epi32(color_a, state.inc_color);
+	__m256i color_c = _mm256_add_epi32(color_b, state.inc_color);
+	__m256i color_d = _mm256_add_epi32(color_c, state.inc_color);
+	state.color = _mm256_add_epi32(state.color, state.inc_color8);
+
+	__m256i src0 = _mm256_unpacklo_epi8(p8src, zero);
+	__m256i dest0 = _mm256_unpacklo_epi8(p8dest, zero);
+	src0 = _mm256_srli_epi16(_mm256_mullo_epi16(src0, _mm256_packs_epi32(_mm256_srai_epi32(color_a, 8), _mm256_srai_epi32(color_b, 8))), 8);
+	pixel_span_blend_avx2<blend>(dest0, src0, state.one, state.half);
+
+	__m256i src1 = _mm256_unpackhi_epi8(p8src, zero);
+	__m256i dest1 = _mm256_unpackhi_epi8(p8dest, zero);
+	src1 = _mm256_srli_epi16(_mm256_mullo_epi16(src1, _mm256_packs_epi32(_mm256_srai_epi32(color_c, 8), _mm256_srai_epi32(color_d, 8))), 8);
+	pixel_span_blend_avx2<blend>(dest1, src1, state.one, state.half);
+
+	_mm256_storeu_si256((__m256i *) dest, _mm256_packus_epi16(dest0, dest1));
+
+	state.tx = _mm256_add_epi32(state.tx, state.inc_tx);
+	state.ty = _mm256_add_epi32(state.ty, state.inc_ty);
+}
+
+cl_avx2_target static inline __m256i pixel_span_bilinear_avx2(__m256i p00, __m256i p10, __m256i p01, __m256i p11, __m256i fracx, __m256i fracy)
+{
+	__m256i full = _mm256_set1_epi16(0x80);
+	__m256i inv_fracx = _mm256_sub_epi16(full, fracx);
+	__m256i inv_fracy = _mm256_sub_epi16(full, fracy);
+	__m256i frac0 = _mm256_srli_epi16(_mm256_mullo_epi16(inv_fracx, inv_fracy), 7);
+	__m256i frac1 = _mm256_srli_epi16(_mm256_mullo_epi16(fracx, inv_fracy), 7);
+	__m256i frac2 = _mm256_srli_epi16(_mm256_mullo_epi16(inv_fracx, fracy), 7);
+	__m256i frac3 = _mm256_srli_epi16(_mm256_mullo_epi16(fracx, fracy), 7);
+	__m256i sum = _mm256_mullo_epi16(p00, frac0);
+	sum = _mm256_add_epi16(sum, _mm256_mullo_epi16(p10, frac1));
+	sum = _mm256_add_epi16(sum, _mm256_mullo_epi16(p01, frac2));
+	sum = _mm256_add_epi16(sum, _mm256_mullo_epi16(p11, frac3));
+	return _mm256_srli_epi16(_mm256_add_epi16(sum, _mm256_set1_epi16(64)), 7);
+}
+
+template<PixelSpanBlend blend>
+cl_avx2_target static inline void pixel_span_linear_block_avx2(PixelSpanStateAVX2 &state, unsigned int *dest, const unsigned int *src)
+{
+	__m256i zero = _mm256_setzero_si256();
+	__m256i one32 = _mm256_set1_epi32(1);
+	__m256i low16 = _mm256_set1_epi32(0xffff);
+
+	pixel_span_texture_repeat_avx2(state.tx, state.ty, state.src_width16, state.src_height16);
+	__m256i sx0 = _mm256_srai_epi32(state.tx, 16);
+	__m256i sy0 = _mm256_srai_epi32(state.ty, 16);
+	__m256i sx1 = _mm256_add_epi32(sx0, one32);
+	__m256i sy1 = _mm256_add_epi32(sy0, one32);
+	sx1 = _mm256_andnot_si256(_mm256_cmpeq_epi32(sx1, state.src_width), sx1);
+	sy1 = _mm256_andnot_si256(_mm256_cmpeq_epi32(sy1, state.src_height), sy1);
+	__m256i row0 = _mm256_mullo_epi32(sy0, state.src_width);
+	__m256i row1 = _mm256_mullo_epi32(sy1, state.src_width);
+
+	__m256i p00 = _mm256_i32gather_epi32((const int *) src, _mm256_add_epi32(row0, sx0), 4);
+	__m256i p10 = _mm256_i32gather_epi32((const int *) src, _mm256_add_epi32(row0, sx1), 4);
+	__m256i p01 = _mm256_i32gather_epi32((const int *) src, _mm256_add_epi32(row1, sx0), 4);
+	__m256i p11 = _mm256_i32gather_epi32((const int *) src, _mm256_add_epi32(row1, sx1), 4);
+
+	// 7 bit fractions, repeated in both 16 bit halves so unpacking spreads them over all four channels
+	__m256i fracx = _mm256_srli_epi32(_mm256_and_si256(state.tx, low16), 9);
+	__m256i fracy = _mm256_srli_epi32(_mm256_and_si256(state.ty, low16), 9);
+	fracx = _mm256_or_si256(fracx, _mm256_slli_epi32(fracx, 16));
+	fracy = _mm256_or_si256(fracy, _mm256_slli_epi32(fracy, 16));
+
+	__m256i p8dest = _mm256_loadu_si256((const __m256i *) dest);
+
+	__m256i color_a = state.color;
+	__m256i color_b = _mm256_add_epi32(color_a, state.inc_color);
+	__m256i color_c = _mm256_add_epi32(color_b, state.inc_color);
+	__m256i color_d = _mm256_add_epi32(color_c, state.inc_color);
+	state.color = _mm256_add_epi32(state.color, state.inc_color8);
+
+	__m256i src0 = pixel_span_bilinear_avx2(
+		_mm256_unpacklo_epi8(p00, zero), _mm256_unpacklo_epi8(p10, zero), _mm256_unpacklo_epi8(p01, zero), _mm256_unpacklo_epi8(p11, zero),
+		_mm256_unpacklo_epi32(fracx, fracx), _mm256_unpacklo_epi32(fracy, fracy));
+	__m256i dest0 = _mm256_unpacklo_epi8(p8dest, zero);
+	src0 = _mm256_srli_epi16(_mm256_mullo_epi16(src0, _mm256_packus_epi32(_mm256_and_si256(_mm256_srai_epi32(color_a, 8), low16), _mm256_and_si256(_mm256_srai_epi32(color_b, 8), low16))), 8);
+	pixel_span_blend_avx2<blend>(dest0, src0, state.one, state.half);
+
+	__m256i src1 = pixel_span_bilinear_avx2(
+		_mm256_unpackhi_epi8(p00, zero), _mm256_unpackhi_epi8(p10, zero), _mm256_unpackhi_epi8(p01, zero), _mm256_unpackhi_epi8(p11, zero),
+		_mm256_unpackhi_epi32(fracx, fracx), _mm256_unpackhi_epi32(fracy, fracy));
+	__m256i dest1 = _mm256_unpackhi_epi8(p8dest, zero);
+	src1 = _mm256_srli_epi16(_mm256_mullo_epi16(src1, _mm256_packus_epi32(_mm256_and_si256(_mm256_srai_epi32(color_c, 8), low16), _mm256_and_si256(_mm256_srai_epi32(color_d, 8), low16))), 8);
+	pixel_span_blend_avx2<blend>(dest1, src1, state.one, state.half);
+
+	_mm256_storeu_si256((__m256i *) dest, _mm256_packus_epi16(dest0, dest1));
+
+	state.tx = _mm256_add_epi32(state.tx, state.inc_tx);
+	state.ty = _mm256_add_epi32(state.ty, state.inc_ty);
+}
+
+template<PixelSpanBlend blend, bool linear>
+cl_avx2_target static void pixel_span_render_avx2(unsigned int *dest, int length, const unsigned int *src, int src_width, int src_height, const PixelSpanGradients &gradients)
+{
+	PixelSpanStateAVX2 state;
+	pixel_span_setup_avx2(state, src_width, src_height, gradients);
+
+	int avx_length = length / 8 * 8;
+	for (int x = 0; x < avx_length; x += 8)
+	{
+		if (linear)
+			pixel_span_linear_block_avx2<blend>(state, dest + x, src);
+		else
+			pixel_span_nearest_block_avx2<blend>(state, dest + x, src);
+	}
+
+	if (avx_length != length)
+	{
+		unsigned int dest_last[8] = { 0,0,0,0,0,0,0,0 };
+		for (int x = avx_length; x < length; x++)
+			dest_last[x-avx_length] = dest[x];
+
+		if (linear)
+			pixel_span_linear_block_avx2<blend>(state, dest_last, src);
+		else
+			pixel_span_nearest_block_avx2<blend>(state, dest_last, src);
+
+		for (int x = avx_length; x < length; x++)
+			dest[x] = dest_last[x-avx_length];
+	}
+}
+
+cl_avx2_target static void pixel_span_fill_avx2(unsigned int *dest, int length, unsigned int color)
+{
+	__m256i color8 = _mm256_set1_epi32(color);
+	int x = 0;
+	for (; x + 8 <= length; x += 8)
+		_mm256_storeu_si256((__m256i *) (dest + x), color8);
+	for (; x < length; x++)
+		dest[x] = color;
+}
+
+cl_avx2_target static void pixel_span_fill_blend_avx2(unsigned int *dest, int length, unsigned int color, unsigned int pos_alpha, unsigned int neg_alpha)
+{
+	__m256i zero = _mm256_setzero_si256();
+	__m256i src = _mm256_mullo_epi16(_mm256_unpacklo_epi8(_mm256_set1_epi32(color), zero), _mm256_set1_epi16(pos_alpha));
+	__m256i neg = _mm256_set1_epi16(neg_alpha);
+
+	int x = 0;
+	for (; x + 8 <= length; x += 8)
+	{
+		__m256i p8dest = _mm256_loadu_si256((const __m256i *) (dest + x));
+		__m256i dest0 = _mm256_unpacklo_epi8(p8dest, zero);
+		__m256i dest1 = _mm256_unpackhi_epi8(p8dest, zero);
+		dest0 = _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(dest0, neg), src), 8);
+		dest1 = _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(dest1, neg), src), 8);
+		_mm256_storeu_si256((__m256i *) (dest + x), _mm256_packus_epi16(dest0, dest1));
+	}
+
+	for (; x < length; x++)
+	{
+		unsigned int dest_color = dest[x];
+		unsigned int alpha = (((dest_color >> 24) & 0xff) * neg_alpha + ((color >> 24) & 0xff) * pos_alpha) >> 8;
+		unsigned int red = (((dest_color >> 16) & 0xff) * neg_alpha + ((color >> 16) & 0xff) * pos_alpha) >> 8;
+		unsigned int green = (((dest_color >> 8) & 0xff) * neg_alpha + ((color >> 8) & 0xff) * pos_alpha) >> 8;
+		unsigned int blue = ((dest_color & 0xff) * neg_alpha + (color & 0xff) * pos_alpha) >> 8;
+		dest[x] = (alpha<<24) + (red<<16) + (green<<8) + blue;
+	}
+}
+
+#endif
+
+/////////////////////////////////////////////////////////////////////////////
+// PixelSpanAVX2 Attributes:
+
+bool PixelSpanAVX2::is_supported()
+{
+#ifdef CL_SPAN_AVX2
+	static int supported = -1;
+	if (supported == -1)
+		supported = System::detect_cpu_extension(System::avx2) ? 1 : 0;
+	return supported == 1;
+#else
+	return false;
+#endif
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PixelSpanAVX2 Operations:
+
+void PixelSpanAVX2::render_nearest(PixelSpanBlend blend, unsigned int *dest, int length, const unsigned int *src, int src_width, int src_height, const PixelSpanGradients &gradients)
+{
+#ifdef CL_SPAN_AVX2
+	switch (blend)
+	{
+	case span_blend_normal:
+		pixel_span_render_avx2<span_blend_normal, false>(dest, length, src, src_width, src_height, gradients);
+		break;
+	case span_blend_premultiplied:
+		pixel_span_render_avx2<span_blend_premultiplied, false>(dest, length, src, src_width, src_height, gradients);
+		break;
+	case span_blend_copy:
+		pixel_span_render_avx2<span_blend_copy, false>(dest, length, src, src_width, src_height, gradients);
+		break;
+	}
+#endif
+}
+
+void PixelSpanAVX2::render_linear(PixelSpanBlend blend, unsigned int *dest, int length, const unsigned int *src, int src_width, int src_height, const PixelSpanGradients &gradients)
+{
+#ifdef CL_SPAN_AVX2
+	switch (blend)
+	{
+	case span_blend_normal:
+		pixel_span_render_avx2<span_blend_normal, true>(dest, length, src, src_width, src_height, gradients);
+		break;
+	case span_blend_premultiplied:
+		pixel_span_render_avx2<span_blend_premultiplied, true>(dest, length, src, src_width, src_height, gradients);
+		break;
+	case span_blend_copy:
+		pixel_span_render_avx2<span_blend_copy, true>(dest, length, src, src_width, src_height, gradients);
+		break;
+	}
+#endif
+}
+
+void PixelSpanAVX2::fill(unsigned int *dest, int length, unsigned int color)
+{
+#ifdef CL_SPAN_AVX2
+	pixel_span_fill_avx2(dest, length, color);
+#endif
+}
+
+void PixelSpanAVX2::fill_blend(unsigned int *dest, int length, unsigned int color, unsigned int pos_alpha, unsigned int neg_alpha)
+{
+#ifdef CL_SPAN_AVX2
+	pixel_span_fill_blend_avx2(dest, length, color, pos_alpha, neg_alpha);
+#endif
+}
+
+}
@@ -0,0 +1,63 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Magnus Norddahl
+*/
+
+#pragma once
+
+#include "pixel_span.h"
+
+namespace clan
+{
+
+/// \brief AVX2 span kernels processing eight pixels at a time
+///
+/// The kernels produce exactly the same pixels as the SSE2 paths in PixelTriangleRenderer and PixelFillRenderer.
+/// The blend function is resolved before the span is drawn, so each inner loop is specialized for one combination.
+class PixelSpanAVX2
+{
+public:
+	/// \brief Returns true if the compiler and the CPU both support AVX2
+	static bool is_supported();
+
+	/// \brief Draws a span using nearest texture sampling with repeat wrapping
+	static void render_nearest(PixelSpanBlend blend, unsigned int *dest, int length, const unsigned int *src, int src_width, int src_height, const PixelSpanGradients &gradients);
+
+	/// \brief Draws a span using bilinear texture sampling with repeat wrapping
+	static void render_linear(PixelSpanBlend blend, unsigned int *dest, int length, const unsigned int *src, int src_width, int src_height, const PixelSpanGradients &gradients);
+
+	/// \brief Fills a span with a solid color
+	static void fill(unsigned int *dest, int length, unsigned int color);
+
+	/// \brief Blends a solid color onto a span
+	///
+	/// \param color = Color to blend, in the frame buffer format
+	/// \param pos_alpha = Weight of the color (0-256)
+	/// \param neg_alpha = Weight of the destination (0-256)
+	static void fill_blend(unsigned int *dest, int length, unsigned int color, unsigned int pos_alpha, unsigned int neg_alpha);
+};
+
+}
@@ -29,12 +29,13 @@
 #include "SWRender/precomp.h"
 #include "pixel_triangle_renderer.h"
 #include "API/SWRender/blit_argb8_sse.h"
+#include "pixel_span_avx2.h"
 
 namespace clan
 {
 
 PixelTriangleRenderer::PixelTriangleRenderer()
-: dest(0), dest_width(0), dest_height(0), src(0), src_width(0), src_height(0), x(0), y(0), tx(0), ty(0), red(0), blue(0), green(0), alpha(0), core(0), num_cores(1)
+: dest(0), dest_width(0), dest_height(0), src(0), src_width(0), src_height(0), x(0), y(0), tx(0), ty(0), red(0), blue(0), green(0), alpha(0), core(0), num_cores(1), span_blend(span_blend_normal), use_avx2(PixelSpanAVX2::is_supported())
 {
 }
 
@@ -77,6 +78,7 @@ void PixelTriangleRenderer::set_core(int new_core, int new_num_cores)
 
 void PixelTriangleRenderer::set_blend_function(BlendFunc src, BlendFunc dest, BlendFunc src_alpha, BlendFunc dest_alpha)
 {
+	span_blend = get_span_blend(src, dest, src_alpha, dest_alpha);
 }
 
 void PixelTriangleRenderer::render_nearest(unsigned int v1, unsigned int v2, unsigned int v3)
@@ -203,115 +205,24 @@ void PixelTriangleRenderer::render_scanline_nearest(int y, const LinePoint &p0,
 	ScanLine scanline;
 	if (prepare_scanline(y, p0, p1, scanline))
 	{
-		scanline.cur_tx *= src_width;
-		scanline.cur_ty *= src_height;
-		scanline.slope_tx *= src_width;
-		scanline.slope_ty *= src_height;
-
-		int icur_tx = (int)(scanline.cur_tx*65536);
-		int icur_ty = (int)(scanline.cur_ty*65536);
-		int icur_r = (int)(scanline.cur_r*65536);
-		int icur_g = (int)(scanline.cur_g*65536);
-		int icur_b = (int)(scanline.cur_b*65536);
-		int icur_a = (int)(scanline.cur_a*65536);
-		int islope_tx = (int)(scanline.slope_tx*65536);
-		int islope_ty = (int)(scanline.slope_ty*65536);
-		int islope_r = (int)(scanline.slope_r*65536);
-		int islope_g = (int)(scanline.slope_g*65536);
-		int islope_b = (int)(scanline.slope_b*65536);
-		int islope_a = (int)(scanline.slope_a*65536);
+		PixelSpanGradients gradients;
+		get_span_gradients(scanline, gradients);
 
 		unsigned int *dest_line = dest+y*dest_width+scanline.start_x;
 		int length = scanline.end_x-scanline.start_x;
 
-		__m128i one, half;
-		BlitARGB8SSE::set_one(one);
-		BlitARGB8SSE::set_half(half);
-
-		__m128i tx = _mm_set_epi32(icur_tx, icur_tx+islope_tx, icur_tx+islope_tx*2, icur_tx+islope_tx*3);
-		__m128i ty = _mm_set_epi32(icur_ty, icur_ty+islope_ty, icur_ty+islope_ty*2, icur_ty+islope_ty*3);
-		__m128i color = _mm_set_epi32(icur_a, icur_r, icur_g, icur_b);
-		__m128i inc_tx = _mm_set1_epi32(islope_tx*4);
-		__m128i inc_ty = _mm_set1_epi32(islope_ty*4);
-		__m128i inc_color = _mm_set_epi32(islope_a, islope_r, islope_g, islope_b);
-		__m128i src_width16 = _mm_set1_epi32(src_width<<16);
-		__m128i src_height16 = _mm_set1_epi32(src_height<<16);
-
-		int sse_length = length/4;
-		sse_length *= 4;
-		for (int x = 0; x <sse_length; x+=4)
+		if (use_avx2)
 		{
-			cl_blitargb8sse_texture_repeat(tx, ty, src_width16, src_height16);
-
-			__m128i p4src, p4dest;
-			cl_blitargb8sse_sample_nearest(p4src, tx, ty, src, src_width);
-			p4dest = _mm_loadu_si128((__m128i*)(dest_line+x));
-
-			__m128i color0 = color;
-			__m128i color1 = _mm_add_epi32(color0, inc_color);
-			__m128i color2 = _mm_add_epi32(color1, inc_color);
-			__m128i color3 = _mm_add_epi32(color2, inc_color);
-			color = _mm_add_epi32(color3, inc_color);
-
-			__m128i src0, dest0, tmp_color;
-			src0 = _mm_unpacklo_epi8(p4src, _mm_setzero_si128());
-			dest0 = _mm_unpacklo_epi8(p4dest, _mm_setzero_si128());
-			tmp_color = _mm_packs_epi32(_mm_srai_epi32(color0, 8), _mm_srai_epi32(color1, 8));
-			cl_blitargb8sse_multiply_color(src0, tmp_color);
-			cl_blitargb8sse_blend_normal(dest0, src0, one, half);
-
-			__m128i src1, dest1;
-			src1 = _mm_unpackhi_epi8(p4src, _mm_setzero_si128());
-			dest1 = _mm_unpackhi_epi8(p4dest, _mm_setzero_si128());
-			tmp_color = _mm_packs_epi32(_mm_srai_epi32(color2, 8), _mm_srai_epi32(color3, 8));
-			cl_blitargb8sse_multiply_color(src1, tmp_color);
-			cl_blitargb8sse_blend_normal(dest1, src1, one, half);
-
-			p4dest = _mm_packus_epi16(dest0, dest1);
-			_mm_storeu_si128((__m128i*)(dest_line+x), p4dest);
-
-			tx = _mm_add_epi32(tx, inc_tx);
-			ty = _mm_add_epi32(ty, inc_ty);
+			PixelSpanAVX2::render_nearest(span_blend, dest_line, length, src, src_width, src_height, gradients);
 		}
-
-		if (sse_length != length)
+		else
 		{
-			unsigned int dest_last[4] = { 0,0,0,0 };
-			for (int x = sse_length; x < length; x++)
-				dest_last[x-sse_length] = dest_line[x];
-
-			cl_blitargb8sse_texture_repeat(tx, ty, src_width16, src_height16);
-
-			__m128i p4src, p4dest;
-			cl_blitargb8sse_sample_nearest(p4src, tx, ty, src, src_width);
-			p4dest = _mm_loadu_si128((__m128i*)dest_last);
-
-			__m128i color0 = color;
-			__m128i color1 = _mm_add_epi32(color0, inc_color);
-			__m128i color2 = _mm_add_epi32(color1, inc_color);
-			__m128i color3 = _mm_add_epi32(color2, inc_color);
-			color = _mm_add_epi32(color3, inc_color);
-
-			__m128i src0, dest0;
-			src0 = _mm_unpacklo_epi8(p4src, _mm_setzero_si128());
-			dest0 = _mm_unpacklo_epi8(p4dest, _mm_setzero_si128());
-			BlitARGB8SSE::multiply_color(src0, _mm_packs_epi32(_mm_srai_epi32(color0, 8), _mm_srai_epi32(color1, 8)));
-			BlitARGB8SSE::blend_normal(dest0, src0, one, half);
-
-			__m128i src1, dest1;
-			src1 = _mm_unpackhi_epi8(p4src, _mm_setzero_si128());
-			dest1 = _mm_unpackhi_epi8(p4dest, _mm_setzero_si128());
-			BlitARGB8SSE::multiply_color(src1, _mm_packs_epi32(_mm_srai_epi32(color2, 8), _mm_srai_epi32(color3, 8)));
-			BlitARGB8SSE::blend_normal(dest1, src1, one, half);
-
-			p4dest = _mm_packus_epi16(dest0, dest1);
-			_mm_storeu_si128((__m128i*) dest_last, p4dest);
-
-			tx = _mm_add_epi32(tx, inc_tx);
-			ty = _mm_add_epi32(ty, inc_ty);
-
-			for (int x = sse_length; x < length; x++)
-				dest_line[x] = dest_last[x-sse_length];
+			switch (span_blend)
+			{
+			case span_blend_normal: render_span_nearest_sse2<span_blend_normal>(dest_line, length, gradients); break;
+			case span_blend_premultiplied: render_span_nearest_sse2<span_blend_premultiplied>(dest_line, length, gradients); break;
+			case span_blend_copy: render_span_nearest_sse2<span_blend_copy>(dest_line, length, gradients); break;
+			}
 		}
 	}
 }
@@ -321,71 +232,200 @@ void PixelTriangleRenderer::render_scanline_linear(int y, const LinePoint &p0, c
 	ScanLine scanline;
 	if (prepare_scanline(y, p0, p1, scanline))
 	{
-		scanline.cur_tx *= src_width;
-		scanline.cur_ty *= src_height;
-		scanline.slope_tx *= src_width;
-		scanline.slope_ty *= src_height;
-
-		int icur_tx = (int)(scanline.cur_tx*65536);
-		int icur_ty = (int)(scanline.cur_ty*65536);
-		int icur_r = (int)(scanline.cur_r*65536);
-		int icur_g = (int)(scanline.cur_g*65536);
-		int icur_b = (int)(scanline.cur_b*65536);
-		int icur_a = (int)(scanline.cur_a*65536);
-		int islope_tx = (int)(scanline.slope_tx*65536);
-		int islope_ty = (int)(scanline.slope_ty*65536);
-		int islope_r = (int)(scanline.slope_r*65536);
-		int islope_g = (int)(scanline.slope_g*65536);
-		int islope_b = (int)(scanline.slope_b*65536);
-		int islope_a = (int)(scanline.slope_a*65536);
+		PixelSpanGradients gradients;
+		get_span_gradients(scanline, gradients);
 
 		unsigned int *dest_line = dest+y*dest_width+scanline.start_x;
 		int length = scanline.end_x-scanline.start_x;
 
-		__m128i one, half;
-		BlitARGB8SSE::set_one(one);
-		BlitARGB8SSE::set_half(half);
-
-		int src_width16 = src_width<<16;
-		int src_height16 = src_height<<16;
-
-		for (int x = 0; x <length; x++)
+		if (use_avx2)
 		{
-			while (icur_tx < 0)
-				icur_tx += src_width16;
-			while (icur_tx >= src_width16)
-				icur_tx -= src_width16;
-			while (icur_ty < 0)
-				icur_ty += src_height16;
-			while (icur_ty >= src_height16)
-				icur_ty -= src_height16;
-
-			int sx0 = icur_tx>>16;
-			int sy0 = icur_ty>>16;
-			unsigned int ifracx = ((unsigned int)icur_tx)&0xffff;
-			unsigned int ifracy = ((unsigned int)icur_ty)&0xffff;
-
-			unsigned int r0, g0, b0, a0;
-			r0 = icur_r>>8;
-			g0 = icur_g>>8;
-			b0 = icur_b>>8;
-			a0 = icur_a>>8;
-			icur_tx += islope_tx;
-			icur_ty += islope_ty;
-			icur_r += islope_r;
-			icur_g += islope_g;
-			icur_b += islope_b;
-			icur_a += islope_a;
-
-			__m128i src0, dest0, primcolor;
-			int offset = sy0*src_width+sx0;
-			BlitARGB8SSE::load_pixel_linear(src0, src[offset], src[offset+1], src[offset+src_width], src[offset+1+src_width], ifracx, ifracy);
-			BlitARGB8SSE::load_pixel(dest0, dest_line[x]);
-			BlitARGB8SSE::set_color(primcolor, r0, g0, b0, a0);
-			BlitARGB8SSE::multiply_color(src0, primcolor);
-			BlitARGB8SSE::blend_normal(dest0, src0, one, half);
-			BlitARGB8SSE::store_pixel(dest_line[x], dest0);
+			PixelSpanAVX2::render_linear(span_blend, dest_line, length, src, src_width, src_height, gradients);
 		}
+		else
+		{
+			switch (span_blend)
+			{
+			case span_blend_normal: render_span_linear_sse2<span_blend_normal>(dest_line, length, gradients); break;
+			case span_blend_premultiplied: render_span_linear_sse2<span_blend_premultiplied>(dest_line, length, gradients); break;
+			case span_blend_copy: render_span_linear_sse2<span_blend_copy>(dest_line, length, gradients); break;
+			}
+		}
+	}
+}
+
+void PixelTriangleRenderer::get_span_gradients(ScanLine &scanline, PixelSpanGradients &out_gradients)
+{
+	scanline.cur_tx *= src_width;
+	scanline.cur_ty *= src_height;
+	scanline.slope_tx *= src_width;
+	scanline.slope_ty *= src_height;
+
+	out_gradients.tx = (int)(scanline.cur_tx*65536);
+	out_gradients.ty = (int)(scanline.cur_ty*65536);
+	out_gradients.red = (int)(scanline.cur_r*65536);
+	out_gradients.green = (int)(scanline.cur_g*65536);
+	out_gradients.blue = (int)(scanline.cur_b*65536);
+	out_gradients.alpha = (int)(scanline.cur_a*65536);
+	out_gradients.dtx = (int)(scanline.slope_tx*65536);
+	out_gradients.dty = (int)(scanline.slope_ty*65536);
+	out_gradients.dred = (int)(scanline.slope_r*65536);
+	out_gradients.dgreen = (int)(scanline.slope_g*65536);
+	out_gradients.dblue = (int)(scanline.slope_b*65536);
+	out_gradients.dalpha = (int)(scanline.slope_a*65536);
+}
+
+template<PixelSpanBlend blend>
+void PixelTriangleRenderer::render_span_nearest_sse2(unsigned int *dest_line, int length, const PixelSpanGradients &gradients)
+{
+	int icur_tx = gradients.tx;
+	int icur_ty = gradients.ty;
+	int islope_tx = gradients.dtx;
+	int islope_ty = gradients.dty;
+
+	__m128i one, half;
+	BlitARGB8SSE::set_one(one);
+	BlitARGB8SSE::set_half(half);
+
+	__m128i tx = _mm_set_epi32(icur_tx, icur_tx+islope_tx, icur_tx+islope_tx*2, icur_tx+islope_tx*3);
+	__m128i ty = _mm_set_epi32(icur_ty, icur_ty+islope_ty, icur_ty+islope_ty*2, icur_ty+islope_ty*3);
+	__m128i color = _mm_set_epi32(gradients.alpha, gradients.red, gradients.green, gradients.blue);
+	__m128i inc_tx = _mm_set1_epi32(islope_tx*4);
+	__m128i inc_ty = _mm_set1_epi32(islope_ty*4);
+	__m128i inc_color = _mm_set_epi32(gradients.dalpha, gradients.dred, gradients.dgreen, gradients.dblue);
+	__m128i src_width16 = _mm_set1_epi32(src_width<<16);
+	__m128i src_height16 = _mm_set1_epi32(src_height<<16);
+
+	int sse_length = length/4;
+	sse_length *= 4;
+	for (int x = 0; x <sse_length; x+=4)
+	{
+		cl_blitargb8sse_texture_repeat(tx, ty, src_width16, src_height16);
+
+		__m128i p4src, p4dest;
+		cl_blitargb8sse_sample_nearest(p4src, tx, ty, src, src_width);
+		p4dest = _mm_loadu_si128((__m128i*)(dest_line+x));
+
+		__m128i color0 = color;
+		__m128i color1 = _mm_add_epi32(color0, inc_color);
+		__m128i color2 = _mm_add_epi32(color1, inc_color);
+		__m128i color3 = _mm_add_epi32(color2, inc_color);
+		color = _mm_add_epi32(color3, inc_color);
+
+		__m128i src0, dest0, tmp_color;
+		src0 = _mm_unpacklo_epi8(p4src, _mm_setzero_si128());
+		dest0 = _mm_unpacklo_epi8(p4dest, _mm_setzero_si128());
+		tmp_color = _mm_packs_epi32(_mm_srai_epi32(color0, 8), _mm_srai_epi32(color1, 8));
+		cl_blitargb8sse_multiply_color(src0, tmp_color);
+		pixel_span_blend_sse2<blend>(dest0, src0, one, half);
+
+		__m128i src1, dest1;
+		src1 = _mm_unpackhi_epi8(p4src, _mm_setzero_si128());
+		dest1 = _mm_unpackhi_epi8(p4dest, _mm_setzero_si128());
+		tmp_color = _mm_packs_epi32(_mm_srai_epi32(color2, 8), _mm_srai_epi32(color3, 8));
+		cl_blitargb8sse_multiply_color(src1, tmp_color);
+		pixel_span_blend_sse2<blend>(dest1, src1, one, half);
+
+		p4dest = _mm_packus_epi16(dest0, dest1);
+		_mm_storeu_si128((__m128i*)(dest_line+x), p4dest);
+
+		tx = _mm_add_epi32(tx, inc_tx);
+		ty = _mm_add_epi32(ty, inc_ty);
+	}
+
+	if (sse_length != length)
+	{
+		unsigned int dest_last[4] = { 0,0,0,0 };
+		for (int x = sse_length; x < length; x++)
+			dest_last[x-sse_length] = dest_line[x];
+
+		cl_blitargb8sse_texture_repeat(tx, ty, src_width16, src_height16);
+
+		__m128i p4src, p4dest;
+		cl_blitargb8sse_sample_nearest(p4src, tx, ty, src, src_width);
+		p4dest = _mm_loadu_si128((__m128i*)dest_last);
+
+		__m128i color0 = color;
+		__m128i color1 = _mm_add_epi32(color0, inc_color);
+		__m128i color2 = _mm_add_epi32(color1, inc_color);
+		__m128i color3 = _mm_add_epi32(color2, inc_color);
+
+		__m128i src0, dest0;
+		src0 = _mm_unpacklo_epi8(p4src, _mm_setzero_si128());
+		dest0 = _mm_unpacklo_epi8(p4dest, _mm_setzero_si128());
+		BlitARGB8SSE::multiply_color(src0, _mm_packs_epi32(_mm_srai_epi32(color0, 8), _mm_srai_epi32(color1, 8)));
+		pixel_span_blend_sse2<blend>(dest0, src0, one, half);
+
+		__m128i src1, dest1;
+		src1 = _mm_unpackhi_epi8(p4src, _mm_setzero_si128());
+		dest1 = _mm_unpackhi_epi8(p4dest, _mm_setzero_si128());
+		BlitARGB8SSE::multiply_color(src1, _mm_packs_epi32(_mm_srai_epi32(color2, 8), _mm_srai_epi32(color3, 8)));
+		pixel_span_blend_sse2<blend>(dest1, src1, one, half);
+
+		p4dest = _mm_packus_epi16(dest0, dest1);
+		_mm_storeu_si128((__m128i*) dest_last, p4dest);
+
+		for (int x = sse_length; x < length; x++)
+			dest_line[x] = dest_last[x-sse_length];
+	}
+}
+
+template<PixelSpanBlend blend>
+void PixelTriangleRenderer::render_span_linear_sse2(unsigned int *dest_line, int length, const PixelSpanGradients &gradients)
+{
+	int icur_tx = gradients.tx;
+	int icur_ty = gradients.ty;
+	int icur_r = gradients.red;
+	int icur_g = gradients.green;
+	int icur_b = gradients.blue;
+	int icur_a = gradients.alpha;
+
+	__m128i one, half;
+	BlitARGB8SSE::set_one(one);
+	BlitARGB8SSE::set_half(half);
+
+	int src_width16 = src_width<<16;
+	int src_height16 = src_height<<16;
+
+	for (int x = 0; x <length; x++)
+	{
+		while (icur_tx < 0)
+			icur_tx += src_width16;
+		while (icur_tx >= src_width16)
+			icur_tx -= src_width16;
+		while (icur_ty < 0)
+			icur_ty += src_height16;
+		while (icur_ty >= src_height16)
+			icur_ty -= src_height16;
+
+		int sx0 = icur_tx>>16;
+		int sy0 = icur_ty>>16;
+		int sx1 = (sx0+1 != src_width) ? sx0+1 : 0;
+		int sy1 = (sy0+1 != src_height) ? sy0+1 : 0;
+		unsigned int ifracx = (((unsigned int)icur_tx)&0xffff)>>9;
+		unsigned int ifracy = (((unsigned int)icur_ty)&0xffff)>>9;
+
+		unsigned int r0, g0, b0, a0;
+		r0 = icur_r>>8;
+		g0 = icur_g>>8;
+		b0 = icur_b>>8;
+		a0 = icur_a>>8;
+		icur_tx += gradients.dtx;
+		icur_ty += gradients.dty;
+		icur_r += gradients.dred;
+		icur_g += gradients.dgreen;
+		icur_b += gradients.dblue;
+		icur_a += gradients.dalpha;
+
+		__m128i src0, dest0, primcolor;
+		const unsigned int *src_line0 = src+sy0*src_width;
+		const unsigned int *src_line1 = src+sy1*src_width;
+		BlitARGB8SSE::load_pixel_linear(src0, src_line0[sx0], src_line0[sx1], src_line1[sx0], src_line1[sx1], ifracx, ifracy);
+		BlitARGB8SSE::load_pixel(dest0, dest_line[x]);
+		BlitARGB8SSE::set_color(primcolor, r0, g0, b0, a0);
+		BlitARGB8SSE::multiply_color(src0, primcolor);
+		pixel_span_blend_sse2<blend>(dest0, src0, one, half);
+		BlitARGB8SSE::store_pixel(dest_line[x], dest0);
 	}
 }
 
@@ -30,6 +30,7 @@
 
 #include "API/Core/Math/rect.h"
 #include "API/Display/Render/blend_state.h"
+#include "pixel_span.h"
 
 namespace clan
 {
@@ -83,6 +84,13 @@ private:
 	void render_scanline_linear(int y, const LinePoint &p0, const LinePoint &p1);
 	bool prepare_scanline(int y, const LinePoint &p0, const LinePoint &p1, ScanLine &out_scanline);
 	void prepare_scanline2(int y, const LinePoint &p0, const LinePoint &p1, ScanLine &out_scanline);
+	void get_span_gradients(ScanLine &scanline, PixelSpanGradients &out_gradients);
+
+	template<PixelSpanBlend blend>
+	void render_span_nearest_sse2(unsigned int *dest_line, int length, const PixelSpanGradients &gradients);
+
+	template<PixelSpanBlend blend>
+	void render_span_linear_sse2(unsigned int *dest_line, int length, const PixelSpanGradients &gradients);
 
 	unsigned int *dest;
 	int dest_width;
@@ -103,6 +111,8 @@ private:
 	Rect clip_rect;
 	int core;
 	int num_cores;
+	PixelSpanBlend span_blend;
+	bool use_avx2;
 };
 
 }
@@ -44,7 +44,7 @@
 namespace clan
 {
 
-PixelCanvas::PixelCanvas(const Size &size)
+PixelCanvas::PixelCanvas(const Size &size, bool tiled, bool occlusion_culling)
 : primary_colorbuffer0(size.width, size.height, tf_bgra8),
   framebuffer_set(false), cliprect_set(false),
   cur_blend_src(blend_src_alpha),
@@ -52,9 +52,10 @@ PixelCanvas::PixelCanvas(const Size &size)
   cur_blend_src_alpha(blend_one), 
   cur_blend_dest_alpha(blend_one_minus_src_alpha)
 {
-	pipeline.reset(new PixelPipeline());
+	pipeline.reset(new PixelPipeline(tiled, occlusion_culling));
 
 	colorbuffer0.set(primary_colorbuffer0);
+	pipeline->set_framebuffer_size(colorbuffer0.size);
 	pipeline->queue(new(pipeline.get()) PixelCommandSetFrameBuffer(colorbuffer0));
 	clip_rect = Rect(Point(0,0), size);
 	pipeline->queue(new(pipeline.get()) PixelCommandSetClipRect(clip_rect));
@@ -74,6 +75,7 @@ void PixelCanvas::resize(const Size &size)
 	{
 		pipeline->wait_for_workers();
 		colorbuffer0.set(primary_colorbuffer0);
+		pipeline->set_framebuffer_size(colorbuffer0.size);
 		pipeline->queue(new(pipeline.get()) PixelCommandSetFrameBuffer(colorbuffer0));
 		Rect rect = clip_rect;
 		clip_rect = (Point(0,0),size);
@@ -130,6 +132,7 @@ void PixelCanvas::set_framebuffer(const FrameBuffer &buffer)
 	slot_framebuffer_modified = swr_framebuffer->get_sig_changed_event().connect(this, &PixelCanvas::modified_framebuffer);
 
 	colorbuffer0.set(swr_framebuffer->get_colorbuffer0());
+	pipeline->set_framebuffer_size(colorbuffer0.size);
 	pipeline->queue(new(pipeline.get()) PixelCommandSetFrameBuffer(colorbuffer0));
 	Rect rect = clip_rect;
 	clip_rect = Rect(Point(0,0),colorbuffer0.size);
@@ -146,6 +149,7 @@ void PixelCanvas::reset_framebuffer()
 	framebuffer_set = false;
 	slot_framebuffer_modified = Slot();
 	colorbuffer0.set(primary_colorbuffer0);
+	pipeline->set_framebuffer_size(colorbuffer0.size);
 	pipeline->queue(new(pipeline.get()) PixelCommandSetFrameBuffer(colorbuffer0));
 
 	framebuffer = FrameBuffer();
@@ -218,6 +222,7 @@ void PixelCanvas::modified_framebuffer()
 	SWRenderFrameBufferProvider *swr_framebuffer = dynamic_cast<SWRenderFrameBufferProvider *>(framebuffer.get_provider());
 
 	colorbuffer0.set(swr_framebuffer->get_colorbuffer0());
+	pipeline->set_framebuffer_size(colorbuffer0.size);
 	pipeline->queue(new(pipeline.get()) PixelCommandSetFrameBuffer(colorbuffer0));
 	Rect rect = clip_rect;
 	clip_rect = Rect(Point(0,0),colorbuffer0.size);
@@ -48,7 +48,7 @@ class ProgramObject_SWRender;
 class PixelCanvas
 {
 public:
-	PixelCanvas(const Size &size);
+	PixelCanvas(const Size &size, bool tiled = false, bool occlusion_culling = false);
 	~PixelCanvas();
 
 	void resize(const Size &size);
@@ -43,6 +43,8 @@ namespace clan
 Mutex SetupSWRender_Impl::cl_swrender_mutex;
 int SetupSWRender_Impl::cl_swrender_refcount = 0;
 SWRenderTarget *SetupSWRender_Impl::cl_swrender_target = 0;
+bool SetupSWRender_Impl::cl_swrender_tiled_rendering = false;
+bool SetupSWRender_Impl::cl_swrender_occlusion_culling = false;
 
 SetupSWRender::SetupSWRender()
 {
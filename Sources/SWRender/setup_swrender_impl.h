@@ -42,6 +42,8 @@ public:
 	static Mutex cl_swrender_mutex;
 	static int cl_swrender_refcount;
 	static SWRenderTarget *cl_swrender_target;
+	static bool cl_swrender_tiled_rendering;
+	static bool cl_swrender_occlusion_culling;
 };
 
 }
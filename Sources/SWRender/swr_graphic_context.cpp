@@ -31,6 +31,7 @@
 #include "API/SWRender/pixel_command.h"
 #include "swr_graphic_context_provider.h"
 #include "Canvas/pixel_canvas.h"
+#include "Canvas/Pipeline/pixel_pipeline.h"
 
 namespace clan
 {
@@ -83,6 +84,11 @@ PixelPipeline *GraphicContext_SWRender::get_pipeline() const
 	return impl->provider->get_canvas()->get_pipeline();
 }
 
+PixelOverdrawCounters GraphicContext_SWRender::get_overdraw_counters() const
+{
+	return impl->provider->get_canvas()->get_pipeline()->get_overdraw_counters();
+}
+
 /////////////////////////////////////////////////////////////////////////////
 // GraphicContext_SWRender Operations:
 
@@ -101,6 +107,11 @@ void GraphicContext_SWRender::queue_command(std::unique_ptr<PixelCommand> &comma
 	impl->provider->queue_command(command);
 }
 
+void GraphicContext_SWRender::reset_overdraw_counters()
+{
+	impl->provider->get_canvas()->get_pipeline()->reset_overdraw_counters();
+}
+
 /////////////////////////////////////////////////////////////////////////////
 // GraphicContext_SWRender Implementation:
 }
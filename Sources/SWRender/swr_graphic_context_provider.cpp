@@ -44,6 +44,7 @@
 #include "API/Display/Font/font_metrics.h"
 #include "API/Display/Render/blend_state.h"
 #include "API/SWRender/swr_program_object.h"
+#include "API/SWRender/swr_target.h"
 #include "API/Display/Render/shared_gc_data.h"
 #include "swr_primitives_array_provider.h"
 #include "swr_uniform_buffer_provider.h"
@@ -57,7 +58,7 @@ namespace clan
 SWRenderGraphicContextProvider::SWRenderGraphicContextProvider(SWRenderDisplayWindowProvider *window)
 : window(window), current_program_provider(0), is_sprite_program(false)
 {
-	canvas.reset(new PixelCanvas(window->get_viewport().get_size()));
+	canvas.reset(new PixelCanvas(window->get_viewport().get_size(), SWRenderTarget::is_tiled_rendering(), SWRenderTarget::is_occlusion_culling()));
 	cl_software_program_standard.set_size(canvas->get_size());
 
 	program_object_standard = ProgramObject_SWRender(&cl_software_program_standard, false);
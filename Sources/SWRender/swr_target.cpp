@@ -58,6 +58,19 @@ bool SWRenderTarget::is_current()
 	SWRenderTargetProvider *provider = dynamic_cast<SWRenderTargetProvider*>(ptr);
 	return (provider != NULL);
 }
+
+bool SWRenderTarget::is_tiled_rendering()
+{
+	MutexSection mutex_lock(&SetupSWRender_Impl::cl_swrender_mutex);
+	return SetupSWRender_Impl::cl_swrender_tiled_rendering;
+}
+
+bool SWRenderTarget::is_occlusion_culling()
+{
+	MutexSection mutex_lock(&SetupSWRender_Impl::cl_swrender_mutex);
+	return SetupSWRender_Impl::cl_swrender_occlusion_culling;
+}
+
 /////////////////////////////////////////////////////////////////////////////
 // SWRenderTarget Operations:
 void SWRenderTarget::set_current()
@@ -67,6 +80,19 @@ void SWRenderTarget::set_current()
 		throw Exception("clanSWRender has not been initialised");
 	SetupSWRender_Impl::cl_swrender_target->DisplayTarget::set_current();
 }
+
+void SWRenderTarget::set_tiled_rendering(bool enable)
+{
+	MutexSection mutex_lock(&SetupSWRender_Impl::cl_swrender_mutex);
+	SetupSWRender_Impl::cl_swrender_tiled_rendering = enable;
+}
+
+void SWRenderTarget::set_occlusion_culling(bool enable)
+{
+	MutexSection mutex_lock(&SetupSWRender_Impl::cl_swrender_mutex);
+	SetupSWRender_Impl::cl_swrender_occlusion_culling = enable;
+}
+
 /////////////////////////////////////////////////////////////////////////////
 // SWRenderTarget Implementation:
 
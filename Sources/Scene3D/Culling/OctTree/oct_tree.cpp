@@ -28,23 +28,25 @@
 
 #include "Scene3D/precomp.h"
 #include "oct_tree.h"
+#include "API/Core/Math/intersection_test.h"
 
 namespace clan
 {
 
 
 OctTree::OctTree()
-: aabb(Vec3f(-300.0f), Vec3f(300.0f)), root(new OctTreeNode()), frame(0)
+: aabb(Vec3f(-300.0f), Vec3f(300.0f)), root(new OctTreeNode()), num_objects(0)
 {
 }
 
 OctTree::OctTree(const AxisAlignedBoundingBox &aabb)
-: aabb(aabb), root(new OctTreeNode()), frame(0)
+: aabb(aabb), root(new OctTreeNode()), num_objects(0)
 {
 }
 
 OctTree::~OctTree()
 {
+	work_queue.reset();
 	delete root;
 }
 
@@ -52,20 +54,22 @@ SceneCullProxy *OctTree::create_proxy(SceneItem *object, const AxisAlignedBoundi
 {
 	OctTreeObject *tree_object = new OctTreeObject(object, box);
 	root->insert(tree_object, aabb);
+	num_objects++;
 	return tree_object;
 }
 
 void OctTree::delete_proxy(SceneCullProxy *proxy)
 {
 	OctTreeObject *tree_object = static_cast<OctTreeObject*>(proxy);
-	root->remove(tree_object, aabb);
+	OctTreeNode::remove(tree_object);
 	tree_object->release();
+	num_objects--;
 }
 
 void OctTree::set_aabb(SceneCullProxy *proxy, const AxisAlignedBoundingBox &box)
 {
 	OctTreeObject *tree_object = static_cast<OctTreeObject*>(proxy);
-	root->remove(tree_object, aabb);
+	OctTreeNode::remove(tree_object);
 	tree_object->box = box;
 	root->insert(tree_object, aabb);
 }
@@ -79,16 +83,95 @@ AxisAlignedBoundingBox OctTree::get_aabb(SceneCullProxy *proxy)
 std::vector<SceneItem *> OctTree::cull(const FrustumPlanes &frustum)
 {
 	std::vector<SceneItem *> pvs;
-	root->cull(frame++, frustum, aabb, pvs);
+	cull(frustum, pvs);
 	return pvs;
 }
 
+void OctTree::cull(const FrustumPlanes &frustum, std::vector<SceneItem *> &pvs)
+{
+	pvs.clear();
+
+	// Objects not fully inside the tree are stored in the root, so they are always tested one by one
+	cull_frustum = frustum;
+	root->cull_objects(frustum, pvs);
+
+	if (num_objects < min_parallel_objects || System::get_num_cores() < 2)
+	{
+		for (int i = 0; i < 8; i++)
+		{
+			if (root->children[i])
+				root->children[i]->cull(frustum, OctTreeNode::child_aabb(i, aabb), pvs);
+		}
+		return;
+	}
+
+	if (!work_queue)
+		work_queue.reset(new WorkQueue(WorkQueue::get_shared()));
+
+	cull_jobs.clear();
+	for (int i = 0; i < 8; i++)
+	{
+		if (root->children[i])
+			create_jobs(root->children[i], OctTreeNode::child_aabb(i, aabb), 1, pvs);
+	}
+
+	int num_tasks = min((int)cull_jobs.size(), work_queue->get_num_threads() + 1);
+	if ((int)task_pvs.size() < num_tasks)
+		task_pvs.resize(num_tasks);
+
+	std::vector<WorkTask> tasks;
+	for (int task = 1; task < num_tasks; task++)
+		tasks.push_back(work_queue->run(Callback_v0(this, &OctTree::cull_task, task)));
+	if (num_tasks > 0)
+		cull_task(0);
+	for (size_t i = 0; i < tasks.size(); i++)
+		work_queue->wait_for(tasks[i]);
+
+	for (int task = 0; task < num_tasks; task++)
+		pvs.insert(pvs.end(), task_pvs[task].begin(), task_pvs[task].end());
+}
+
+void OctTree::create_jobs(OctTreeNode *node, const AxisAlignedBoundingBox &node_aabb, int depth, std::vector<SceneItem *> &pvs)
+{
+	if (depth == job_depth)
+	{
+		cull_jobs.push_back(CullJob(node, node_aabb));
+		return;
+	}
+
+	IntersectionTest::Result result = IntersectionTest::frustum_aabb(cull_frustum, node_aabb);
+	if (result == IntersectionTest::inside)
+	{
+		cull_jobs.push_back(CullJob(node, node_aabb));
+	}
+	else if (result == IntersectionTest::intersecting)
+	{
+		node->cull_objects(cull_frustum, pvs);
+		for (int i = 0; i < 8; i++)
+		{
+			if (node->children[i])
+				create_jobs(node->children[i], OctTreeNode::child_aabb(i, node_aabb), depth + 1, pvs);
+		}
+	}
+}
+
+void OctTree::cull_task(int task)
+{
+	int num_tasks = min((int)cull_jobs.size(), work_queue->get_num_threads() + 1);
+	int begin = (int)cull_jobs.size() * task / num_tasks;
+	int end = (int)cull_jobs.size() * (task + 1) / num_tasks;
+
+	std::vector<SceneItem *> &out_pvs = task_pvs[task];
+	out_pvs.clear();
+	for (int i = begin; i < end; i++)
+		cull_jobs[i].node->cull(cull_frustum, cull_jobs[i].aabb, out_pvs);
+}
+
 std::vector<SceneItem *> OctTree::cull(const Vec3f &point)
 {
 	std::vector<SceneItem *> pvs;
-	root->cull(frame++, point, aabb, pvs);
+	root->cull(point, aabb, pvs);
 	return pvs;
 }
 
 }
-
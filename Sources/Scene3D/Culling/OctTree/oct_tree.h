@@ -29,6 +29,7 @@
 #pragma once
 
 #include "API/Scene3D/scene_cull_provider.h"
+#include "API/Core/System/work_queue.h"
 #include "oct_tree_node.h"
 
 namespace clan
@@ -50,13 +51,35 @@ public:
 	AxisAlignedBoundingBox get_aabb(SceneCullProxy *proxy);
 
 	std::vector<SceneItem *> cull(const FrustumPlanes &frustum);
+	void cull(const FrustumPlanes &frustum, std::vector<SceneItem *> &out_pvs);
 	std::vector<SceneItem *> cull(const Vec3f &point);
 
 private:
+	struct CullJob
+	{
+		CullJob(OctTreeNode *node, const AxisAlignedBoundingBox &aabb) : node(node), aabb(aabb) { }
+
+		OctTreeNode *node;
+		AxisAlignedBoundingBox aabb;
+	};
+
+	void create_jobs(OctTreeNode *node, const AxisAlignedBoundingBox &node_aabb, int depth, std::vector<SceneItem *> &pvs);
+	void cull_task(int task);
+
 	AxisAlignedBoundingBox aabb;
 	OctTreeNode *root;
-	int frame;
+	int num_objects;
+
+	std::unique_ptr<WorkQueue> work_queue;
+	FrustumPlanes cull_frustum;
+	std::vector<CullJob> cull_jobs;
+	std::vector<std::vector<SceneItem *> > task_pvs;
+
+	/// \brief Trees with fewer objects are culled on the calling thread only
+	static const int min_parallel_objects = 4096;
+
+	/// \brief Depth of the subtrees distributed between the threads
+	static const int job_depth = 2;
 };
 
 }
-
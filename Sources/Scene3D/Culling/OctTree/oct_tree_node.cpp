@@ -29,13 +29,14 @@
 #include "Scene3D/precomp.h"
 #include "oct_tree_node.h"
 #include "API/Core/Math/intersection_test.h"
-#include <algorithm>
+#include <xmmintrin.h>
 
 namespace clan
 {
 
 
-OctTreeNode::OctTreeNode()
+OctTreeNode::OctTreeNode(OctTreeNode *parent)
+: parent(parent)
 {
 	for (int i = 0; i < 8; i++)
 		children[i] = 0;
@@ -44,7 +45,10 @@ OctTreeNode::OctTreeNode()
 OctTreeNode::~OctTreeNode()
 {
 	for (size_t i = 0; i < objects.size(); i++)
+	{
+		objects[i]->node = 0;
 		objects[i]->release();
+	}
 
 	for (int i = 0; i < 8; i++)
 		delete children[i];
@@ -52,86 +56,211 @@ OctTreeNode::~OctTreeNode()
 
 void OctTreeNode::insert(OctTreeObject *object, const AxisAlignedBoundingBox &aabb, int iteration)
 {
-	if (iteration == max_iterations)
-	{
-		objects.push_back(object);
-		object->add_ref();
-	}
-	else
+	if (iteration < max_iterations)
 	{
 		for (int i = 0; i < 8; i++)
 		{
 			AxisAlignedBoundingBox child_box = child_aabb(i, aabb);
-			if (IntersectionTest::aabb(object->box, child_box) == IntersectionTest::overlap)
+			bool contained =
+				object->box.aabb_min.x >= child_box.aabb_min.x && object->box.aabb_max.x <= child_box.aabb_max.x &&
+				object->box.aabb_min.y >= child_box.aabb_min.y && object->box.aabb_max.y <= child_box.aabb_max.y &&
+				object->box.aabb_min.z >= child_box.aabb_min.z && object->box.aabb_max.z <= child_box.aabb_max.z;
+			if (contained)
 			{
 				if (children[i] == 0)
-					children[i] = new OctTreeNode();
+					children[i] = new OctTreeNode(this);
 				children[i]->insert(object, child_box, iteration + 1);
+				return;
 			}
 		}
 	}
+
+	add_object(object);
 }
 
-void OctTreeNode::remove(OctTreeObject *object, const AxisAlignedBoundingBox &aabb, int iteration)
+void OctTreeNode::remove(OctTreeObject *object)
 {
-	if (iteration == max_iterations)
-	{
-		objects.erase(std::find(objects.begin(), objects.end(), object));
-		object->release();
-	}
-	else
+	OctTreeNode *node = object->node;
+	node->remove_object(object);
+
+	while (node->parent && node->is_empty())
 	{
+		OctTreeNode *parent = node->parent;
 		for (int i = 0; i < 8; i++)
 		{
-			AxisAlignedBoundingBox child_box = child_aabb(i, aabb);
-			if (IntersectionTest::aabb(object->box, child_box) == IntersectionTest::overlap)
-			{
-				children[i]->remove(object, child_box, iteration + 1);
-
-				bool empty = children[i]->objects.empty();
-				for (int j = 0; j < 8; j++)
-					empty = empty && children[i]->children[j] == 0;
-				if (empty)
-				{
-					delete children[i];
-					children[i] = 0;
-				}
-			}
+			if (parent->children[i] == node)
+				parent->children[i] = 0;
 		}
+		delete node;
+		node = parent;
 	}
 }
 
-void OctTreeNode::cull(int frame, const FrustumPlanes &frustum, const AxisAlignedBoundingBox &aabb, std::vector<SceneItem *> &pvs)
+bool OctTreeNode::is_empty() const
+{
+	bool empty = objects.empty();
+	for (int i = 0; i < 8; i++)
+		empty = empty && children[i] == 0;
+	return empty;
+}
+
+void OctTreeNode::add_object(OctTreeObject *object)
+{
+	Vec3f center = object->box.center();
+	Vec3f extents = object->box.extents();
+
+	object->node = this;
+	object->index = objects.size();
+	object->add_ref();
+
+	objects.push_back(object);
+	center_x.push_back(center.x);
+	center_y.push_back(center.y);
+	center_z.push_back(center.z);
+	extents_x.push_back(extents.x);
+	extents_y.push_back(extents.y);
+	extents_z.push_back(extents.z);
+}
+
+void OctTreeNode::remove_object(OctTreeObject *object)
+{
+	// Move the last object into the hole to keep the arrays contiguous
+	size_t index = object->index;
+	size_t last = objects.size() - 1;
+	objects[index] = objects[last];
+	objects[index]->index = index;
+	center_x[index] = center_x[last];
+	center_y[index] = center_y[last];
+	center_z[index] = center_z[last];
+	extents_x[index] = extents_x[last];
+	extents_y[index] = extents_y[last];
+	extents_z[index] = extents_z[last];
+
+	objects.pop_back();
+	center_x.pop_back();
+	center_y.pop_back();
+	center_z.pop_back();
+	extents_x.pop_back();
+	extents_y.pop_back();
+	extents_z.pop_back();
+
+	object->node = 0;
+	object->release();
+}
+
+void OctTreeNode::cull(const FrustumPlanes &frustum, const AxisAlignedBoundingBox &aabb, std::vector<SceneItem *> &pvs)
 {
 	IntersectionTest::Result result = IntersectionTest::frustum_aabb(frustum, aabb);
 	if (result == IntersectionTest::inside)
 	{
-		show(frame, pvs);
+		show(pvs);
 	}
 	else if (result == IntersectionTest::intersecting)
 	{
-		for (size_t i = 0; i < objects.size(); i++)
-		{
-			if (IntersectionTest::aabb(objects[i]->box, aabb) == IntersectionTest::overlap)
-				objects[i]->add(frame, pvs);
-		}
+		cull_objects(frustum, pvs);
 
 		for (int i = 0; i < 8; i++)
 		{
 			if (children[i])
-				children[i]->cull(frame, frustum, child_aabb(i, aabb), pvs);
+				children[i]->cull(frustum, child_aabb(i, aabb), pvs);
 		}
 	}
 }
 
-void OctTreeNode::cull(int frame, const Vec3f &point, const AxisAlignedBoundingBox &aabb, std::vector<SceneItem *> &pvs)
+void OctTreeNode::cull_objects(const FrustumPlanes &frustum, std::vector<SceneItem *> &pvs)
+{
+	// Same test as IntersectionTest::plane_aabb: a box is outside a plane if center distance plus projected extents is negative
+	__m128 plane_x[6], plane_y[6], plane_z[6], plane_w[6];
+	__m128 abs_x[6], abs_y[6], abs_z[6];
+	for (int p = 0; p < 6; p++)
+	{
+		const Vec4f &plane = frustum.planes[p];
+		plane_x[p] = _mm_set1_ps(plane.x);
+		plane_y[p] = _mm_set1_ps(plane.y);
+		plane_z[p] = _mm_set1_ps(plane.z);
+		plane_w[p] = _mm_set1_ps(plane.w);
+		abs_x[p] = _mm_set1_ps(std::abs(plane.x));
+		abs_y[p] = _mm_set1_ps(std::abs(plane.y));
+		abs_z[p] = _mm_set1_ps(std::abs(plane.z));
+	}
+	__m128 zero = _mm_setzero_ps();
+
+	size_t count = objects.size();
+	size_t i = 0;
+	float tail[6][8];
+	while (i < count)
+	{
+		const float *cx, *cy, *cz, *ex, *ey, *ez;
+		size_t block_size = count - i;
+		if (block_size >= 8)
+		{
+			block_size = 8;
+			cx = &center_x[i];
+			cy = &center_y[i];
+			cz = &center_z[i];
+			ex = &extents_x[i];
+			ey = &extents_y[i];
+			ez = &extents_z[i];
+		}
+		else
+		{
+			// Pad the last block by repeating its first box
+			for (size_t j = 0; j < 8; j++)
+			{
+				size_t k = i + (j < block_size ? j : 0);
+				tail[0][j] = center_x[k];
+				tail[1][j] = center_y[k];
+				tail[2][j] = center_z[k];
+				tail[3][j] = extents_x[k];
+				tail[4][j] = extents_y[k];
+				tail[5][j] = extents_z[k];
+			}
+			cx = tail[0];
+			cy = tail[1];
+			cz = tail[2];
+			ex = tail[3];
+			ey = tail[4];
+			ez = tail[5];
+		}
+
+		__m128 cx0 = _mm_loadu_ps(cx), cx1 = _mm_loadu_ps(cx + 4);
+		__m128 cy0 = _mm_loadu_ps(cy), cy1 = _mm_loadu_ps(cy + 4);
+		__m128 cz0 = _mm_loadu_ps(cz), cz1 = _mm_loadu_ps(cz + 4);
+		__m128 ex0 = _mm_loadu_ps(ex), ex1 = _mm_loadu_ps(ex + 4);
+		__m128 ey0 = _mm_loadu_ps(ey), ey1 = _mm_loadu_ps(ey + 4);
+		__m128 ez0 = _mm_loadu_ps(ez), ez1 = _mm_loadu_ps(ez + 4);
+
+		__m128 outside0 = _mm_setzero_ps();
+		__m128 outside1 = _mm_setzero_ps();
+		for (int p = 0; p < 6; p++)
+		{
+			__m128 s0 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx0, plane_x[p]), _mm_mul_ps(cy0, plane_y[p])), _mm_add_ps(_mm_mul_ps(cz0, plane_z[p]), plane_w[p]));
+			__m128 s1 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx1, plane_x[p]), _mm_mul_ps(cy1, plane_y[p])), _mm_add_ps(_mm_mul_ps(cz1, plane_z[p]), plane_w[p]));
+			__m128 e0 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ex0, abs_x[p]), _mm_mul_ps(ey0, abs_y[p])), _mm_mul_ps(ez0, abs_z[p]));
+			__m128 e1 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ex1, abs_x[p]), _mm_mul_ps(ey1, abs_y[p])), _mm_mul_ps(ez1, abs_z[p]));
+			outside0 = _mm_or_ps(outside0, _mm_cmplt_ps(_mm_add_ps(s0, e0), zero));
+			outside1 = _mm_or_ps(outside1, _mm_cmplt_ps(_mm_add_ps(s1, e1), zero));
+		}
+
+		int visible = ~(_mm_movemask_ps(outside0) | (_mm_movemask_ps(outside1) << 4)) & ((1 << block_size) - 1);
+		for (size_t j = 0; visible; j++, visible >>= 1)
+		{
+			if (visible & 1)
+				pvs.push_back(objects[i + j]->visible_object);
+		}
+
+		i += block_size;
+	}
+}
+
+void OctTreeNode::cull(const Vec3f &point, const AxisAlignedBoundingBox &aabb, std::vector<SceneItem *> &pvs)
 {
 	bool inside =
 		point.x >= aabb.aabb_min.x && point.x <= aabb.aabb_max.x &&
 		point.y >= aabb.aabb_min.y && point.y <= aabb.aabb_max.y &&
 		point.z >= aabb.aabb_min.z && point.z <= aabb.aabb_max.z;
 
-	if (inside)
+	if (inside || parent == 0)
 	{
 		for (size_t i = 0; i < objects.size(); i++)
 		{
@@ -141,26 +270,29 @@ void OctTreeNode::cull(int frame, const Vec3f &point, const AxisAlignedBoundingB
 				point.z >= objects[i]->box.aabb_min.z && point.z <= objects[i]->box.aabb_max.z;
 
 			if (obj_inside)
-				objects[i]->add(frame, pvs);
+				pvs.push_back(objects[i]->visible_object);
 		}
+	}
 
+	if (inside)
+	{
 		for (int i = 0; i < 8; i++)
 		{
 			if (children[i])
-				children[i]->cull(frame, point, child_aabb(i, aabb), pvs);
+				children[i]->cull(point, child_aabb(i, aabb), pvs);
 		}
 	}
 }
 
-void OctTreeNode::show(int frame, std::vector<SceneItem *> &pvs)
+void OctTreeNode::show(std::vector<SceneItem *> &pvs)
 {
 	for (size_t i = 0; i < objects.size(); i++)
-		objects[i]->add(frame, pvs);
+		pvs.push_back(objects[i]->visible_object);
 
 	for (int i = 0; i < 8; i++)
 	{
 		if (children[i])
-			children[i]->show(frame, pvs);
+			children[i]->show(pvs);
 	}
 }
 
@@ -35,10 +35,12 @@
 namespace clan
 {
 
+class OctTreeNode;
+
 class OctTreeObject : public SceneCullProxy
 {
 public:
-	OctTreeObject(SceneItem *visible_object, const AxisAlignedBoundingBox &box) : ref_count(1), visible_object(visible_object), box(box), rendered_frame(-1) { }
+	OctTreeObject(SceneItem *visible_object, const AxisAlignedBoundingBox &box) : ref_count(1), visible_object(visible_object), box(box), node(0), index(0) { }
 	void add_ref() { ref_count++; }
 	void release() { if (--ref_count == 0) delete this; }
 
@@ -46,37 +48,51 @@ public:
 	SceneItem *visible_object;
 	AxisAlignedBoundingBox box;
 
-	int rendered_frame;
-
-	void add(int frame, std::vector<SceneItem *> &pvs)
-	{
-		if (rendered_frame != frame)
-		{
-			rendered_frame = frame;
-			pvs.push_back(visible_object);
-		}
-	}
+	/// \brief Node storing the object and its position in the node arrays
+	OctTreeNode *node;
+	size_t index;
 };
 
+/// \brief Node in the oct tree
+///
+/// An object is stored in the deepest node whose box fully contains it, so it is only found once.
+/// The boxes of the objects are kept as centers and extents in structure of arrays form,
+/// allowing them to be tested against the frustum planes eight at a time.
 class OctTreeNode
 {
 public:
-	OctTreeNode();
+	OctTreeNode(OctTreeNode *parent = 0);
 	~OctTreeNode();
+
 	void insert(OctTreeObject *object, const AxisAlignedBoundingBox &aabb, int iteration = 0);
-	void remove(OctTreeObject *object, const AxisAlignedBoundingBox &aabb, int iteration = 0);
-	void cull(int frame, const FrustumPlanes &frustum, const AxisAlignedBoundingBox &aabb, std::vector<SceneItem *> &pvs);
-	void cull(int frame, const Vec3f &point, const AxisAlignedBoundingBox &aabb, std::vector<SceneItem *> &pvs);
-	void show(int frame, std::vector<SceneItem *> &pvs);
 
-private:
+	/// \brief Removes an object from the node storing it, deleting nodes left empty
+	static void remove(OctTreeObject *object);
+
+	void cull(const FrustumPlanes &frustum, const AxisAlignedBoundingBox &aabb, std::vector<SceneItem *> &pvs);
+	void cull(const Vec3f &point, const AxisAlignedBoundingBox &aabb, std::vector<SceneItem *> &pvs);
+	void show(std::vector<SceneItem *> &pvs);
+
+	/// \brief Adds the objects stored in this node that are inside or intersecting the frustum
+	void cull_objects(const FrustumPlanes &frustum, std::vector<SceneItem *> &pvs);
+
+	bool is_empty() const;
+
+	OctTreeNode *children[8];
+
 	static AxisAlignedBoundingBox child_aabb(int index, const AxisAlignedBoundingBox &aabb);
 
+private:
+	void add_object(OctTreeObject *object);
+	void remove_object(OctTreeObject *object);
+
+	OctTreeNode *parent;
 	std::vector<OctTreeObject *> objects;
-	OctTreeNode *children[8];
+	std::vector<float> center_x, center_y, center_z;
+	std::vector<float> extents_x, extents_y, extents_z;
+
 	static const Vec3f barycentric_weights[16];
 	static const int max_iterations = 3;
 };
 
 }
-
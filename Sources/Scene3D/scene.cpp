@@ -337,7 +337,7 @@ void Scene_Impl::visit(GraphicContext &gc, const Mat4f &world_to_eye, const Mat4
 
 	std::vector<Model *> models;
 
-	std::vector<SceneItem *> visible_objects = cull_provider->cull(frustum);
+	cull_provider->cull(frustum, visible_objects);
 	for (size_t i = 0; i < visible_objects.size(); i++)
 	{
 		SceneObject_Impl *object = dynamic_cast<SceneObject_Impl*>(visible_objects[i]);
@@ -383,10 +383,10 @@ void Scene_Impl::visit_lights(GraphicContext &gc, const Mat4f &world_to_eye, con
 {
 	ScopeTimeFunction();
 
-	std::vector<SceneItem *> visible_objects = cull_provider->cull(frustum);
-	for (size_t i = 0; i < visible_objects.size(); i++)
+	cull_provider->cull(frustum, visible_lights);
+	for (size_t i = 0; i < visible_lights.size(); i++)
 	{
-		SceneLight_Impl *light = dynamic_cast<SceneLight_Impl*>(visible_objects[i]);
+		SceneLight_Impl *light = dynamic_cast<SceneLight_Impl*>(visible_lights[i]);
 		if (light)
 		{
 			visitor->light(gc, world_to_eye, eye_to_projection, light);
@@ -398,10 +398,10 @@ void Scene_Impl::visit_emitters(GraphicContext &gc, const Mat4f &world_to_eye, c
 {
 	ScopeTimeFunction();
 
-	std::vector<SceneItem *> visible_objects = cull_provider->cull(frustum);
-	for (size_t i = 0; i < visible_objects.size(); i++)
+	cull_provider->cull(frustum, visible_emitters);
+	for (size_t i = 0; i < visible_emitters.size(); i++)
 	{
-		SceneParticleEmitter_Impl *emitter = dynamic_cast<SceneParticleEmitter_Impl*>(visible_objects[i]);
+		SceneParticleEmitter_Impl *emitter = dynamic_cast<SceneParticleEmitter_Impl*>(visible_emitters[i]);
 		if (emitter)
 		{
 			visitor->emitter(gc, world_to_eye, eye_to_projection, emitter);
@@ -112,6 +112,11 @@ private:
 
 	std::unique_ptr<SceneCullProvider> cull_provider;
 
+	/// \brief Potential visible sets reused between frames
+	std::vector<SceneItem *> visible_objects;
+	std::vector<SceneItem *> visible_lights;
+	std::vector<SceneItem *> visible_emitters;
+
 	SceneCamera camera;
 
 	Resource<float> camera_field_of_view;
@@ -34,6 +34,7 @@
 #include "API/Core/IOData/path_help.h"
 #include "soundprovider_vorbis_impl.h"
 #include "soundprovider_vorbis_session.h"
+#include "soundprovider_vorbis_decoder.h"
 
 namespace clan
 {
@@ -45,7 +46,7 @@ SoundProvider_Vorbis::SoundProvider_Vorbis(
 	const std::string &filename,
 	const FileSystem &fs,
 	bool stream)
-: impl(new SoundProvider_Vorbis_Impl)
+: impl(new SoundProvider_Vorbis_Impl(stream))
 {
 	IODevice input = fs.open_file(filename, File::open_existing, File::access_read, File::share_all);
 	impl->load(input);
@@ -53,7 +54,7 @@ SoundProvider_Vorbis::SoundProvider_Vorbis(
 
 SoundProvider_Vorbis::SoundProvider_Vorbis(
 	const std::string &fullname, bool stream)
-: impl(new SoundProvider_Vorbis_Impl)
+: impl(new SoundProvider_Vorbis_Impl(stream))
 {
 	std::string path = PathHelp::get_fullpath(fullname, PathHelp::path_type_file);
 	std::string filename = PathHelp::get_filename(fullname, PathHelp::path_type_file);
@@ -64,7 +65,7 @@ SoundProvider_Vorbis::SoundProvider_Vorbis(
 
 SoundProvider_Vorbis::SoundProvider_Vorbis(
 	IODevice &file, bool stream)
-: impl(new SoundProvider_Vorbis_Impl)
+: impl(new SoundProvider_Vorbis_Impl(stream))
 {
 	impl->load(file);
 }
@@ -73,9 +74,37 @@ SoundProvider_Vorbis::~SoundProvider_Vorbis()
 {
 }
 
+/////////////////////////////////////////////////////////////////////////////
+// SoundProvider_Vorbis attributes:
+
+SoundProvider_Vorbis_Stats SoundProvider_Vorbis::get_stats()
+{
+	return SoundProvider_Vorbis_Decoder::instance().get_stats();
+}
+
 /////////////////////////////////////////////////////////////////////////////
 // SoundProvider_Vorbis operations:
 
+void SoundProvider_Vorbis::set_cache_budget(int bytes)
+{
+	SoundProvider_Vorbis_Decoder::instance().set_cache_budget(bytes);
+}
+
+void SoundProvider_Vorbis::set_cache_max_clip_size(int bytes)
+{
+	SoundProvider_Vorbis_Decoder::instance().set_cache_max_clip_size(bytes);
+}
+
+void SoundProvider_Vorbis::set_prefetch_length(int samples)
+{
+	SoundProvider_Vorbis_Decoder::instance().set_prefetch_length(samples);
+}
+
+void SoundProvider_Vorbis::reset_stats()
+{
+	SoundProvider_Vorbis_Decoder::instance().reset_stats();
+}
+
 SoundProvider_Session *SoundProvider_Vorbis::begin_session()
 {
 	return new SoundProvider_Vorbis_Session(*this);
@@ -89,6 +118,11 @@ void SoundProvider_Vorbis::end_session(SoundProvider_Session *session)
 /////////////////////////////////////////////////////////////////////////////
 // SoundProvider_Vorbis implementation:
 
+SoundProvider_Vorbis_Impl::~SoundProvider_Vorbis_Impl()
+{
+	SoundProvider_Vorbis_Decoder::instance().remove_clip(this);
+}
+
 void SoundProvider_Vorbis_Impl::load(IODevice &input)
 {
 	int size = input.get_size();
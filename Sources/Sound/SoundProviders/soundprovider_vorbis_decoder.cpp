@@ -0,0 +1,426 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Magnus Norddahl
+*/
+
+#include "Sound/precomp.h"
+#include "soundprovider_vorbis_decoder.h"
+#include "soundprovider_vorbis_impl.h"
+#include "stb_vorbis.h"
+#include "API/Core/System/exception.h"
+#include "API/Core/System/system.h"
+#include "API/Core/Math/cl_math.h"
+#include <algorithm>
+
+namespace clan
+{
+
+/////////////////////////////////////////////////////////////////////////////
+// SoundProvider_Vorbis_Stream construction:
+
+SoundProvider_Vorbis_Stream::SoundProvider_Vorbis_Stream(const DataBuffer &buffer, int prefetch_length)
+: buffer(buffer), handle(0), frequency(0), num_channels(0), pcm(0), pcm_position(0), pcm_samples(0), decoded_all(false), ring_length(max(prefetch_length, 1024))
+{
+	int error = 0;
+	handle = stb_vorbis_open_memory(this->buffer.get_data<unsigned char>(), this->buffer.get_size(), &error, 0);
+	if (handle == 0)
+		throw Exception("Unable to read ogg file");
+
+	stb_vorbis_info info = stb_vorbis_get_info(handle);
+	frequency = info.sample_rate;
+	num_channels = info.channels;
+	ring.resize(ring_length * num_channels);
+}
+
+SoundProvider_Vorbis_Stream::~SoundProvider_Vorbis_Stream()
+{
+	stb_vorbis_close(handle);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// SoundProvider_Vorbis_Stream operations:
+
+bool SoundProvider_Vorbis_Stream::is_eof() const
+{
+	return end_of_stream.get() != 0 && get_available() == 0;
+}
+
+int SoundProvider_Vorbis_Stream::read(float **channels, int samples)
+{
+	int available = get_available();
+	if (available < samples && end_of_stream.get() == 0)
+	{
+		if (available == 0)
+		{
+			// The decoder thread fell behind. Decode just enough to keep playing.
+			MutexSection mutex_lock(&decode_mutex);
+			fill_ring(min(samples, ring_length));
+			mutex_lock.unlock();
+			SoundProvider_Vorbis_Decoder::instance().add_underrun();
+			available = get_available();
+		}
+	}
+
+	int count = min(samples, available);
+	unsigned int read_pos = ((unsigned int) read_count.get()) % ring_length;
+	int first = min(count, ring_length - (int) read_pos);
+	for (int channel = 0; channel < num_channels; channel++)
+	{
+		const float *src = &ring[channel * ring_length];
+		memcpy(channels[channel], src + read_pos, first * sizeof(float));
+		memcpy(channels[channel] + first, src, (count - first) * sizeof(float));
+	}
+	read_count.set((int) ((unsigned int) read_count.get() + count));
+
+	SoundProvider_Vorbis_Decoder::instance().wake_up();
+	return count;
+}
+
+void SoundProvider_Vorbis_Stream::rewind()
+{
+	MutexSection mutex_lock(&decode_mutex);
+	stb_vorbis_seek_start(handle);
+	pcm = 0;
+	pcm_position = 0;
+	pcm_samples = 0;
+	decoded_all = false;
+	end_of_stream.set(0);
+	read_count.set(write_count.get());
+	mutex_lock.unlock();
+
+	SoundProvider_Vorbis_Decoder::instance().wake_up();
+}
+
+void SoundProvider_Vorbis_Stream::prefetch()
+{
+	MutexSection mutex_lock(&decode_mutex);
+	fill_ring(ring_length);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// SoundProvider_Vorbis_Stream implementation:
+
+void SoundProvider_Vorbis_Stream::fill_ring(int min_available)
+{
+	ubyte64 start_time = 0;
+	while (true)
+	{
+		int available = get_available();
+		if (available >= min_available)
+			break;
+
+		if (pcm_position == pcm_samples)
+		{
+			if (decoded_all)
+				break;
+
+			if (start_time == 0)
+				start_time = System::get_microseconds();
+
+			int frame_channels = 0;
+			pcm_position = 0;
+			pcm_samples = stb_vorbis_get_frame_float(handle, &frame_channels, &pcm);
+			if (pcm_samples == 0)
+			{
+				decoded_all = true;
+				end_of_stream.set(1);
+				break;
+			}
+			continue;
+		}
+
+		int count = min(ring_length - available, pcm_samples - pcm_position);
+		unsigned int write_pos = ((unsigned int) write_count.get()) % ring_length;
+		int first = min(count, ring_length - (int) write_pos);
+		for (int channel = 0; channel < num_channels; channel++)
+		{
+			float *dest = &ring[channel * ring_length];
+			memcpy(dest + write_pos, pcm[channel] + pcm_position, first * sizeof(float));
+			memcpy(dest, pcm[channel] + pcm_position + first, (count - first) * sizeof(float));
+		}
+		pcm_position += count;
+		write_count.set((int) ((unsigned int) write_count.get() + count));
+	}
+
+	if (start_time != 0)
+		SoundProvider_Vorbis_Decoder::instance().add_decode_time(System::get_microseconds() - start_time);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// SoundProvider_Vorbis_Decoder construction:
+
+SoundProvider_Vorbis_Decoder::SoundProvider_Vorbis_Decoder()
+: cache_budget(16*1024*1024), cache_max_clip_size(1024*1024), prefetch_length(16384), thread_running(false), wakeup_event(false)
+{
+}
+
+SoundProvider_Vorbis_Decoder::~SoundProvider_Vorbis_Decoder()
+{
+	stop_thread();
+}
+
+SoundProvider_Vorbis_Decoder &SoundProvider_Vorbis_Decoder::instance()
+{
+	static SoundProvider_Vorbis_Decoder decoder;
+	return decoder;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// SoundProvider_Vorbis_Decoder attributes:
+
+int SoundProvider_Vorbis_Decoder::get_prefetch_length() const
+{
+	MutexSection mutex_lock(&mutex);
+	return prefetch_length;
+}
+
+SoundProvider_Vorbis_Stats SoundProvider_Vorbis_Decoder::get_stats() const
+{
+	MutexSection mutex_lock(&mutex);
+	return stats;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// SoundProvider_Vorbis_Decoder operations:
+
+std::shared_ptr<SoundProvider_Vorbis_Clip> SoundProvider_Vorbis_Decoder::find_clip(SoundProvider_Vorbis_Impl *provider)
+{
+	if (provider->stream)
+		return std::shared_ptr<SoundProvider_Vorbis_Clip>();
+
+	MutexSection mutex_lock(&mutex);
+	std::map<SoundProvider_Vorbis_Impl *, ClipList::iterator>::iterator it = clip_index.find(provider);
+	if (it != clip_index.end())
+	{
+		clips.splice(clips.begin(), clips, it->second);
+		stats.cache_hits++;
+		return clips.front().second;
+	}
+	int max_size = min(cache_max_clip_size, cache_budget);
+	mutex_lock.unlock();
+
+	// Decode outside the lock so other sessions are not held up
+	std::shared_ptr<SoundProvider_Vorbis_Clip> clip = decode_clip(provider, max_size);
+	if (!clip)
+		return clip;
+
+	mutex_lock.lock();
+	it = clip_index.find(provider);
+	if (it != clip_index.end())
+	{
+		// Another session decoded the same clip meanwhile
+		clips.splice(clips.begin(), clips, it->second);
+		stats.cache_hits++;
+		return clips.front().second;
+	}
+
+	clips.push_front(std::pair<SoundProvider_Vorbis_Impl *, std::shared_ptr<SoundProvider_Vorbis_Clip> >(provider, clip));
+	clip_index[provider] = clips.begin();
+	stats.cache_misses++;
+	stats.cache_clips++;
+	stats.cache_size += clip->get_size();
+	evict_clips();
+	return clip;
+}
+
+void SoundProvider_Vorbis_Decoder::remove_clip(SoundProvider_Vorbis_Impl *provider)
+{
+	MutexSection mutex_lock(&mutex);
+	std::map<SoundProvider_Vorbis_Impl *, ClipList::iterator>::iterator it = clip_index.find(provider);
+	if (it != clip_index.end())
+	{
+		stats.cache_clips--;
+		stats.cache_size -= it->second->second->get_size();
+		clips.erase(it->second);
+		clip_index.erase(it);
+	}
+}
+
+void SoundProvider_Vorbis_Decoder::add_stream(const std::shared_ptr<SoundProvider_Vorbis_Stream> &stream)
+{
+	MutexSection mutex_lock(&mutex);
+	streams.push_back(stream);
+	if (!thread_running)
+	{
+		stop_event.reset();
+		thread.start(this, &SoundProvider_Vorbis_Decoder::thread_main);
+		thread_running = true;
+	}
+	mutex_lock.unlock();
+	wake_up();
+}
+
+void SoundProvider_Vorbis_Decoder::remove_stream(SoundProvider_Vorbis_Stream *stream)
+{
+	MutexSection mutex_lock(&mutex);
+	for (size_t i = 0; i < streams.size(); i++)
+	{
+		if (streams[i].get() == stream)
+		{
+			streams.erase(streams.begin() + i);
+			break;
+		}
+	}
+}
+
+void SoundProvider_Vorbis_Decoder::add_decode_time(ubyte64 microseconds)
+{
+	MutexSection mutex_lock(&mutex);
+	stats.decode_time += microseconds;
+}
+
+void SoundProvider_Vorbis_Decoder::add_underrun()
+{
+	MutexSection mutex_lock(&mutex);
+	stats.underruns++;
+}
+
+void SoundProvider_Vorbis_Decoder::set_prefetch_length(int samples)
+{
+	MutexSection mutex_lock(&mutex);
+	prefetch_length = samples;
+}
+
+void SoundProvider_Vorbis_Decoder::set_cache_budget(int bytes)
+{
+	MutexSection mutex_lock(&mutex);
+	cache_budget = bytes;
+	evict_clips();
+}
+
+void SoundProvider_Vorbis_Decoder::set_cache_max_clip_size(int bytes)
+{
+	MutexSection mutex_lock(&mutex);
+	cache_max_clip_size = bytes;
+}
+
+void SoundProvider_Vorbis_Decoder::reset_stats()
+{
+	MutexSection mutex_lock(&mutex);
+	stats.cache_hits = 0;
+	stats.cache_misses = 0;
+	stats.decode_time = 0;
+	stats.underruns = 0;
+}
+
+void SoundProvider_Vorbis_Decoder::stop_thread()
+{
+	MutexSection mutex_lock(&mutex);
+	if (!thread_running)
+		return;
+	thread_running = false;
+	mutex_lock.unlock();
+
+	stop_event.set();
+	thread.join();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// SoundProvider_Vorbis_Decoder implementation:
+
+std::shared_ptr<SoundProvider_Vorbis_Clip> SoundProvider_Vorbis_Decoder::decode_clip(SoundProvider_Vorbis_Impl *provider, int max_size)
+{
+	int error = 0;
+	stb_vorbis *handle = stb_vorbis_open_memory(provider->buffer.get_data<unsigned char>(), provider->buffer.get_size(), &error, 0);
+	if (handle == 0)
+		throw Exception("Unable to read ogg file");
+
+	stb_vorbis_info info = stb_vorbis_get_info(handle);
+	unsigned int length = stb_vorbis_stream_length_in_samples(handle);
+	if (length == 0 || (ubyte64) length * info.channels * sizeof(float) > (ubyte64) max_size)
+	{
+		stb_vorbis_close(handle);
+		return std::shared_ptr<SoundProvider_Vorbis_Clip>();
+	}
+
+	ubyte64 start_time = System::get_microseconds();
+
+	std::shared_ptr<SoundProvider_Vorbis_Clip> clip(new SoundProvider_Vorbis_Clip());
+	clip->frequency = info.sample_rate;
+	clip->num_channels = info.channels;
+	clip->num_samples = length;
+	clip->samples.resize(length * info.channels);
+
+	int position = 0;
+	while (position < (int) length)
+	{
+		int num_channels = 0;
+		float **pcm = 0;
+		int samples = stb_vorbis_get_frame_float(handle, &num_channels, &pcm);
+		if (samples == 0)
+			break;
+		samples = min(samples, (int) length - position);
+		for (int channel = 0; channel < info.channels; channel++)
+			memcpy(clip->get_channel(channel) + position, pcm[channel], samples * sizeof(float));
+		position += samples;
+	}
+	stb_vorbis_close(handle);
+
+	if (position < (int) length)
+	{
+		// The stream ended before the length in the last page
+		std::vector<float> samples(position * info.channels);
+		for (int channel = 0; channel < info.channels; channel++)
+			memcpy(&samples[channel * position], clip->get_channel(channel), position * sizeof(float));
+		clip->samples.swap(samples);
+		clip->num_samples = position;
+	}
+
+	add_decode_time(System::get_microseconds() - start_time);
+	return clip;
+}
+
+void SoundProvider_Vorbis_Decoder::evict_clips()
+{
+	while (stats.cache_size > cache_budget && !clips.empty())
+	{
+		stats.cache_clips--;
+		stats.cache_size -= clips.back().second->get_size();
+		clip_index.erase(clips.back().first);
+		clips.pop_back();
+	}
+}
+
+void SoundProvider_Vorbis_Decoder::thread_main()
+{
+	std::vector<std::shared_ptr<SoundProvider_Vorbis_Stream> > active_streams;
+	while (true)
+	{
+		int wakeup_reason = Event::wait(stop_event, wakeup_event, idle_timeout);
+		if (wakeup_reason == 0)
+			break;
+
+		MutexSection mutex_lock(&mutex);
+		active_streams = streams;
+		mutex_lock.unlock();
+
+		for (size_t i = 0; i < active_streams.size(); i++)
+			active_streams[i]->prefetch();
+		active_streams.clear();
+	}
+}
+
+}
@@ -0,0 +1,190 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Magnus Norddahl
+*/
+
+#pragma once
+
+#include "API/Sound/SoundProviders/soundprovider_vorbis.h"
+#include "API/Core/System/databuffer.h"
+#include "API/Core/System/mutex.h"
+#include "API/Core/System/event.h"
+#include "API/Core/System/thread.h"
+#include "API/Core/System/interlocked_variable.h"
+#include <vector>
+#include <list>
+#include <map>
+#include <memory>
+
+struct stb_vorbis;
+
+namespace clan
+{
+
+class SoundProvider_Vorbis_Impl;
+
+/// \brief Completely decoded Ogg Vorbis sound
+class SoundProvider_Vorbis_Clip
+{
+public:
+	SoundProvider_Vorbis_Clip() : frequency(0), num_channels(0), num_samples(0) { }
+
+	float *get_channel(int channel) { return &samples[channel * num_samples]; }
+	int get_size() const { return samples.size() * sizeof(float); }
+
+	int frequency;
+	int num_channels;
+	int num_samples;
+
+	/// \brief Samples stored one channel after the other
+	std::vector<float> samples;
+};
+
+/// \brief Ogg Vorbis stream decoded ahead of the playback position into a ring buffer
+///
+/// The background decoder thread writes into the ring and the mixer thread reads from it.
+/// Decoding is protected by decode_mutex, so the mixer can decode itself if the ring runs empty.
+class SoundProvider_Vorbis_Stream
+{
+public:
+	SoundProvider_Vorbis_Stream(const DataBuffer &buffer, int prefetch_length);
+	~SoundProvider_Vorbis_Stream();
+
+	int get_frequency() const { return frequency; }
+	int get_num_channels() const { return num_channels; }
+
+	/// \brief Returns true when the whole stream has been decoded and read
+	bool is_eof() const;
+
+	/// \brief Reads prefetched samples. Mixer thread only.
+	int read(float **channels, int samples);
+
+	/// \brief Restarts the stream from the beginning. Mixer thread only.
+	void rewind();
+
+	/// \brief Decodes until the ring is full. Decoder thread only.
+	void prefetch();
+
+private:
+	SoundProvider_Vorbis_Stream(const SoundProvider_Vorbis_Stream &);
+	SoundProvider_Vorbis_Stream &operator =(const SoundProvider_Vorbis_Stream &);
+
+	int get_available() const { return (int) ((unsigned int) write_count.get() - (unsigned int) read_count.get()); }
+
+	/// \brief Decodes until at least min_available samples are in the ring. decode_mutex must be locked.
+	void fill_ring(int min_available);
+
+	Mutex decode_mutex;
+	DataBuffer buffer;
+	stb_vorbis *handle;
+	int frequency;
+	int num_channels;
+
+	/// \brief Remains of the last decoded frame that did not fit in the ring
+	float **pcm;
+	int pcm_position;
+	int pcm_samples;
+	bool decoded_all;
+
+	std::vector<float> ring;
+	int ring_length;
+	InterlockedVariable read_count;
+	InterlockedVariable write_count;
+	InterlockedVariable end_of_stream;
+};
+
+/// \brief Decoded clip cache and background decoder thread shared by all Ogg Vorbis providers
+class SoundProvider_Vorbis_Decoder
+{
+public:
+	SoundProvider_Vorbis_Decoder();
+	~SoundProvider_Vorbis_Decoder();
+
+	static SoundProvider_Vorbis_Decoder &instance();
+
+	/// \brief Returns the decoded clip for a provider, decoding it if needed
+	///
+	/// \return Null if the sound should be streamed instead
+	std::shared_ptr<SoundProvider_Vorbis_Clip> find_clip(SoundProvider_Vorbis_Impl *provider);
+
+	/// \brief Removes the clip of a provider being destroyed
+	void remove_clip(SoundProvider_Vorbis_Impl *provider);
+
+	void add_stream(const std::shared_ptr<SoundProvider_Vorbis_Stream> &stream);
+	void remove_stream(SoundProvider_Vorbis_Stream *stream);
+
+	/// \brief Tells the decoder thread that a stream has room for more samples
+	void wake_up() { wakeup_event.set(); }
+
+	void add_decode_time(ubyte64 microseconds);
+	void add_underrun();
+
+	int get_prefetch_length() const;
+	void set_prefetch_length(int samples);
+	void set_cache_budget(int bytes);
+	void set_cache_max_clip_size(int bytes);
+
+	SoundProvider_Vorbis_Stats get_stats() const;
+	void reset_stats();
+
+	/// \brief Stops the decoder thread. Called when clanSound is shut down.
+	void stop_thread();
+
+private:
+	SoundProvider_Vorbis_Decoder(const SoundProvider_Vorbis_Decoder &);
+	SoundProvider_Vorbis_Decoder &operator =(const SoundProvider_Vorbis_Decoder &);
+
+	typedef std::list<std::pair<SoundProvider_Vorbis_Impl *, std::shared_ptr<SoundProvider_Vorbis_Clip> > > ClipList;
+
+	std::shared_ptr<SoundProvider_Vorbis_Clip> decode_clip(SoundProvider_Vorbis_Impl *provider, int max_size);
+
+	/// \brief Removes the least recently used clips until the cache fits its budget. mutex must be locked.
+	void evict_clips();
+
+	void thread_main();
+
+	mutable Mutex mutex;
+
+	/// \brief Cached clips, most recently used first
+	ClipList clips;
+	std::map<SoundProvider_Vorbis_Impl *, ClipList::iterator> clip_index;
+
+	std::vector<std::shared_ptr<SoundProvider_Vorbis_Stream> > streams;
+	SoundProvider_Vorbis_Stats stats;
+	int cache_budget;
+	int cache_max_clip_size;
+	int prefetch_length;
+
+	Thread thread;
+	bool thread_running;
+	Event stop_event;
+	Event wakeup_event;
+
+	/// \brief Milliseconds the decoder thread sleeps when nobody wakes it
+	static const int idle_timeout = 50;
+};
+
+}
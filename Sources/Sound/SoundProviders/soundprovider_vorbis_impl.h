@@ -37,6 +37,13 @@ namespace clan
 
 class SoundProvider_Vorbis_Impl
 {
+/// \name Construction
+/// \{
+public:
+	SoundProvider_Vorbis_Impl(bool stream) : stream(stream) { }
+	~SoundProvider_Vorbis_Impl();
+
+/// \}
 /// \name Attributes
 /// \{
 public:
@@ -44,6 +51,9 @@ public:
 
 public:
 	DataBuffer buffer;
+
+	/// \brief Always stream the sound instead of caching the decoded samples
+	bool stream;
 /// \}
 };
 
@@ -33,6 +33,7 @@
 #include "API/Core/IOData/iodevice.h"
 #include "API/Core/IOData/iodevice_memory.h"
 #include "API/Core/System/exception.h"
+#include "API/Core/Math/cl_math.h"
 
 namespace clan
 {
@@ -41,20 +42,21 @@ namespace clan
 // SoundProvider_Vorbis_Session construction:
 
 SoundProvider_Vorbis_Session::SoundProvider_Vorbis_Session(SoundProvider_Vorbis &source) :
-	source(source), position(0), stream_eof(false), handle(0), stream_byte_offset(0), pcm(0), pcm_position(0), pcm_samples(0)
+	source(source), position(0)
 {
-	int error = 0;
-	handle = stb_vorbis_open_pushdata(source.impl->buffer.get_data<unsigned char>(), source.impl->buffer.get_size(), &stream_byte_offset, &error, 0);
-	if (handle == 0)
-		throw Exception("Unable to read ogg file");
-
-	stream_info = stb_vorbis_get_info(handle);
+	SoundProvider_Vorbis_Decoder &decoder = SoundProvider_Vorbis_Decoder::instance();
+	clip = decoder.find_clip(source.impl.get());
+	if (!clip)
+	{
+		stream = std::shared_ptr<SoundProvider_Vorbis_Stream>(new SoundProvider_Vorbis_Stream(source.impl->buffer, decoder.get_prefetch_length()));
+		decoder.add_stream(stream);
+	}
 }
 
 SoundProvider_Vorbis_Session::~SoundProvider_Vorbis_Session()
 {
-	if (handle)
-		stb_vorbis_close(handle);
+	if (stream)
+		SoundProvider_Vorbis_Decoder::instance().remove_stream(stream.get());
 }
 
 /////////////////////////////////////////////////////////////////////////////
@@ -62,17 +64,17 @@ SoundProvider_Vorbis_Session::~SoundProvider_Vorbis_Session()
 
 int SoundProvider_Vorbis_Session::get_num_samples() const
 {
-	return -1;
+	return clip ? clip->num_samples : -1;
 }
 
 int SoundProvider_Vorbis_Session::get_frequency() const
 {
-	return stream_info.sample_rate;
+	return clip ? clip->frequency : stream->get_frequency();
 }
 
 int SoundProvider_Vorbis_Session::get_num_channels() const
 {
-	return stream_info.channels;
+	return clip ? clip->num_channels : stream->get_num_channels();
 }
 
 int SoundProvider_Vorbis_Session::get_position() const
@@ -85,7 +87,7 @@ int SoundProvider_Vorbis_Session::get_position() const
 
 bool SoundProvider_Vorbis_Session::eof() const
 {
-	return stream_eof;
+	return clip ? position >= clip->num_samples : stream->is_eof();
 }
 
 void SoundProvider_Vorbis_Session::stop()
@@ -99,59 +101,40 @@ bool SoundProvider_Vorbis_Session::play()
 	
 bool SoundProvider_Vorbis_Session::set_position(int pos)
 {
-	// Currently only support seeking to beginning of stream.
-	if (pos != 0) return false;
-
-	if (handle)
-		stb_vorbis_close(handle);
-	handle = 0;
-	stream_byte_offset = 0;
+	if (clip)
+	{
+		if (pos < 0 || pos > clip->num_samples)
+			return false;
+		position = pos;
+		return true;
+	}
 
-	int error = 0;
-	handle = stb_vorbis_open_pushdata(source.impl->buffer.get_data<unsigned char>(), source.impl->buffer.get_size(), &stream_byte_offset, &error, 0);
-	if (handle == 0)
-		throw Exception("Unable to read ogg file");
+	// Streams only support seeking to beginning of stream.
+	if (pos != 0) return false;
 
-	stream_info = stb_vorbis_get_info(handle);
-	stream_eof = false;
+	stream->rewind();
+	position = 0;
 	return true;
 }
 
 int SoundProvider_Vorbis_Session::get_data(float **channels, int data_requested)
 {
-	int data_left = data_requested;
-	while (!eof() && data_left > 0)
+	int samples;
+	if (clip)
 	{
-		while (pcm_position == pcm_samples)
-		{
-			pcm = 0;
-			pcm_position = 0;
-			pcm_samples = 0;
-			int bytes_used = stb_vorbis_decode_frame_pushdata(handle, source.impl->buffer.get_data<unsigned char>() + stream_byte_offset, source.impl->buffer.get_size() - stream_byte_offset, 0, &pcm, &pcm_samples);
-			stream_byte_offset += bytes_used;
-			if (bytes_used == 0 || stream_byte_offset == source.impl->buffer.get_size())
-			{
-				stream_eof = true;
-				break;
-			}
-		}
-
-		int samples = pcm_samples - pcm_position;
-		if (samples > data_left) samples = data_left;
-
-		int buffer_pos = data_requested-data_left;
-		for (int j=0; j<stream_info.channels; j++)
+		samples = min(data_requested, clip->num_samples - position);
+		for (int j=0; j<clip->num_channels; j++)
 		{
-			memcpy(&channels[j][buffer_pos], &pcm[j][pcm_position], samples*sizeof(float));
+			memcpy(channels[j], clip->get_channel(j) + position, samples*sizeof(float));
 		}
-
-		pcm_position += samples;
-		data_left -= samples;
-
-		position += samples;
 	}
-	
-	return data_requested - data_left;
+	else
+	{
+		samples = stream->read(channels, data_requested);
+	}
+
+	position += samples;
+	return samples;
 }
 
 /////////////////////////////////////////////////////////////////////////////
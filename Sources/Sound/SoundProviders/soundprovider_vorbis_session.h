@@ -30,7 +30,8 @@
 
 #include "API/Sound/SoundProviders/soundprovider_session.h"
 #include "API/Sound/SoundProviders/soundprovider_vorbis.h"
-#include "stb_vorbis.h"
+#include "soundprovider_vorbis_decoder.h"
+#include <memory>
 
 namespace clan
 {
@@ -71,15 +72,12 @@ public:
 private:
 	SoundProvider_Vorbis source;
 	int position;
-	bool stream_eof;
 
-	stb_vorbis *handle;
-	stb_vorbis_info stream_info;
-	int stream_byte_offset;
+	/// \brief Completely decoded sound, or null when streaming
+	std::shared_ptr<SoundProvider_Vorbis_Clip> clip;
 
-	float **pcm;
-	int pcm_position;
-	int pcm_samples;
+	/// \brief Prefetching decoder used when the sound is not cached
+	std::shared_ptr<SoundProvider_Vorbis_Stream> stream;
 /// \}
 };
 
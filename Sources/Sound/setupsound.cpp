@@ -37,6 +37,7 @@
 #include "API/Core/Resources/resource_manager.h"
 #include "API/Core/Resources/xml_resource_manager.h"
 #include "Sound/Resources/xml_sound_cache.h"
+#include "Sound/SoundProviders/soundprovider_vorbis_decoder.h"
 
 #define INCLUDED_FROM_SETUPVORBIS
 #include "SoundProviders/stb_vorbis.h"
@@ -100,6 +101,8 @@ void SetupSound_Impl::deinit()
 
 	delete providertype_ogg;
 	providertype_ogg = 0;
+
+	SoundProvider_Vorbis_Decoder::instance().stop_thread();
 }
 
 void SetupSound_Impl::add_cache_factory(ResourceManager &manager, const XMLResourceDocument &doc)
@@ -0,0 +1,283 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Magnus Norddahl
+*/
+
+#include "Sound/precomp.h"
+#include "API/Sound/sound_resampler.h"
+#include "API/Sound/sound_sse.h"
+#include "API/Core/Math/cl_math.h"
+#include "sound_resampler_impl.h"
+#include <cmath>
+
+#ifndef DISABLE_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace clan
+{
+
+/////////////////////////////////////////////////////////////////////////////
+// SoundResampler construction:
+
+SoundResampler::SoundResampler(SoundResamplerMode mode)
+: impl(new SoundResampler_Impl(mode))
+{
+}
+
+SoundResampler::~SoundResampler()
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// SoundResampler attributes:
+
+SoundResamplerMode SoundResampler::get_mode() const
+{
+	return impl->mode;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// SoundResampler operations:
+
+void SoundResampler::set_mode(SoundResamplerMode mode)
+{
+	impl->mode = mode;
+}
+
+void SoundResampler::set_frequencies(float input_frequency, int output_frequency)
+{
+	if (input_frequency <= 0.0f || output_frequency <= 0)
+		throw Exception("Invalid resampler frequency");
+
+	double ratio = input_frequency / (double) output_frequency;
+	impl->step = (ubyte64) (ratio * 4294967296.0 + 0.5);
+	if (impl->step == 0)
+		impl->step = 1;
+
+	// Lower the cutoff below the output Nyquist frequency when downsampling, and leave room for the transition band
+	float cutoff = 0.95f * (float) min(1.0, 1.0 / ratio);
+	if (cutoff != impl->cutoff)
+	{
+		impl->cutoff = cutoff;
+		impl->bank.reset();
+	}
+}
+
+int SoundResampler::resample(float **input, int input_size, int num_channels, int &position, unsigned int &fraction, float **output, int output_size)
+{
+	// Find how many output samples can be made before reading past the input:
+	int last_position = input_size - 1 - input_lookahead;
+	if (position > last_position || output_size <= 0)
+		return 0;
+	ubyte64 distance = (((ubyte64) (last_position - position)) << 32) + (0xffffffff - fraction);
+	ubyte64 available = distance / impl->step + 1;
+	int count = (int) min((ubyte64) output_size, available);
+
+	if (impl->step == (((ubyte64) 1) << 32) && fraction == 0)
+	{
+		for (int channel = 0; channel < num_channels; channel++)
+			SoundSSE::copy_float(input[channel] + position, count, output[channel]);
+	}
+	else if (impl->mode == resampler_linear)
+	{
+		SoundResampler_Impl::resample_linear(input, num_channels, position, fraction, impl->step, output, count);
+	}
+	else
+	{
+		if (!impl->bank)
+			impl->bank = SoundResampler_FilterBank::get(impl->cutoff);
+
+		if (impl->use_avx)
+			SoundResamplerAVX::resample_polyphase(impl->bank->coefficients, input, num_channels, position, fraction, impl->step, output, count);
+		else
+			SoundResampler_Impl::resample_polyphase(impl->bank->coefficients, input, num_channels, position, fraction, impl->step, output, count);
+	}
+
+	ubyte64 advance = fraction + impl->step * count;
+	position += (int) (advance >> 32);
+	fraction = (unsigned int) advance;
+	return count;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// SoundResampler_Impl:
+
+SoundResampler_Impl::SoundResampler_Impl(SoundResamplerMode mode)
+: mode(mode), step(((ubyte64) 1) << 32), cutoff(0.95f), use_avx(SoundResamplerAVX::is_supported())
+{
+}
+
+void SoundResampler_Impl::resample_linear(float **input, int num_channels, int position, unsigned int fraction, ubyte64 step, float **output, int count)
+{
+	for (int channel = 0; channel < num_channels; channel++)
+	{
+		const float *src = input[channel];
+		float *dest = output[channel];
+		ubyte64 pos = (((ubyte64) position) << 32) + fraction;
+		for (int i = 0; i < count; i++)
+		{
+			int index = (int) (pos >> 32);
+			float t = ((unsigned int) pos) * (1.0f / 4294967296.0f);
+			dest[i] = src[index] + (src[index + 1] - src[index]) * t;
+			pos += step;
+		}
+	}
+}
+
+void SoundResampler_Impl::resample_polyphase(const float *coefficients, float **input, int num_channels, int position, unsigned int fraction, ubyte64 step, float **output, int count)
+{
+	const int num_taps = SoundResampler_FilterBank::num_taps;
+	const int phase_shift = 32 - SoundResampler_FilterBank::phase_bits;
+
+	ubyte64 pos = (((ubyte64) position) << 32) + fraction;
+	int i = 0;
+
+#ifndef DISABLE_SSE2
+	// Four output samples at a time. The sums are transposed so they can be added and stored together.
+	for (; i + 4 <= count; i += 4)
+	{
+		int offsets[4];
+		const float *filters[4];
+		for (int j = 0; j < 4; j++)
+		{
+			offsets[j] = (int) (pos >> 32) - SoundResampler::input_history;
+			filters[j] = coefficients + (((unsigned int) pos) >> phase_shift) * num_taps;
+			pos += step;
+		}
+
+		for (int channel = 0; channel < num_channels; channel++)
+		{
+			__m128 sums[4];
+			for (int j = 0; j < 4; j++)
+			{
+				const float *src = input[channel] + offsets[j];
+				const float *filter = filters[j];
+				__m128 sum = _mm_mul_ps(_mm_loadu_ps(src), _mm_load_ps(filter));
+				sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(src + 4), _mm_load_ps(filter + 4)));
+				sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(src + 8), _mm_load_ps(filter + 8)));
+				sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(src + 12), _mm_load_ps(filter + 12)));
+				sums[j] = sum;
+			}
+			_MM_TRANSPOSE4_PS(sums[0], sums[1], sums[2], sums[3]);
+			__m128 result = _mm_add_ps(_mm_add_ps(sums[0], sums[1]), _mm_add_ps(sums[2], sums[3]));
+			_mm_storeu_ps(output[channel] + i, result);
+		}
+	}
+#endif
+
+	for (; i < count; i++)
+	{
+		int offset = (int) (pos >> 32) - SoundResampler::input_history;
+		const float *filter = coefficients + (((unsigned int) pos) >> phase_shift) * num_taps;
+		for (int channel = 0; channel < num_channels; channel++)
+		{
+			const float *src = input[channel] + offset;
+			float sum = 0.0f;
+			for (int tap = 0; tap < num_taps; tap++)
+				sum += src[tap] * filter[tap];
+			output[channel][i] = sum;
+		}
+		pos += step;
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// SoundResampler_FilterBank:
+
+Mutex SoundResampler_FilterBank::cache_mutex;
+std::map<int, std::shared_ptr<SoundResampler_FilterBank> > SoundResampler_FilterBank::cache;
+
+SoundResampler_FilterBank::SoundResampler_FilterBank(float cutoff)
+: coefficients(0)
+{
+	const double pi = 3.14159265358979323846;
+	const double half_width = num_taps / 2;
+
+	coefficients = (float *) SoundSSE::aligned_alloc(sizeof(float) * num_taps * num_phases);
+	for (int phase = 0; phase < num_phases; phase++)
+	{
+		// Distance from the output sample to each input sample read, windowed with a Blackman window
+		double weights[num_taps];
+		double total = 0.0;
+		for (int tap = 0; tap < num_taps; tap++)
+		{
+			double x = (tap - SoundResampler::input_history) - phase / (double) num_phases;
+			double sinc = (x == 0.0) ? 1.0 : std::sin(pi * cutoff * x) / (pi * cutoff * x);
+			double window = 0.42 + 0.5 * std::cos(pi * x / half_width) + 0.08 * std::cos(2.0 * pi * x / half_width);
+			weights[tap] = cutoff * sinc * window;
+			total += weights[tap];
+		}
+
+		// Normalize so a constant signal keeps its level at every phase
+		for (int tap = 0; tap < num_taps; tap++)
+			coefficients[phase * num_taps + tap] = (float) (weights[tap] / total);
+	}
+}
+
+SoundResampler_FilterBank::~SoundResampler_FilterBank()
+{
+	SoundSSE::aligned_free(coefficients);
+}
+
+std::shared_ptr<SoundResampler_FilterBank> SoundResampler_FilterBank::get(float cutoff)
+{
+	MutexSection mutex_lock(&cache_mutex);
+	if (cache.empty())
+		add_common_banks();
+
+	int key = get_cutoff_key(cutoff);
+	std::map<int, std::shared_ptr<SoundResampler_FilterBank> >::iterator it = cache.find(key);
+	if (it != cache.end())
+		return it->second;
+
+	std::shared_ptr<SoundResampler_FilterBank> bank(new SoundResampler_FilterBank(key / 256.0f));
+	cache[key] = bank;
+	return bank;
+}
+
+int SoundResampler_FilterBank::get_cutoff_key(float cutoff)
+{
+	// Cutoffs are rounded so sessions changing frequency continuously only create a limited number of banks
+	return max(1, min(256, (int) (cutoff * 256.0f + 0.5f)));
+}
+
+void SoundResampler_FilterBank::add_common_banks()
+{
+	static const int common_frequencies[] = { 22050, 44100, 48000 };
+	for (int input = 0; input < 3; input++)
+	{
+		for (int output = 0; output < 3; output++)
+		{
+			float cutoff = 0.95f * min(1.0f, common_frequencies[output] / (float) common_frequencies[input]);
+			int key = get_cutoff_key(cutoff);
+			if (cache.find(key) == cache.end())
+				cache[key] = std::shared_ptr<SoundResampler_FilterBank>(new SoundResampler_FilterBank(key / 256.0f));
+		}
+	}
+}
+
+}
@@ -0,0 +1,121 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Magnus Norddahl
+*/
+
+#include "Sound/precomp.h"
+#include "sound_resampler_impl.h"
+#include "API/Core/System/system.h"
+
+#if defined(_MSC_VER) && _MSC_VER >= 1600 && (defined(_M_IX86) || defined(_M_X64))
+	#define CL_SOUND_AVX
+	#define cl_avx_target
+#elif (defined(__clang__) || (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)))) && (defined(__i386__) || defined(__x86_64__))
+	// Only the functions marked with the target attribute are compiled for AVX, so the rest of the library still runs on any SSE2 CPU
+	#define CL_SOUND_AVX
+	#define cl_avx_target __attribute__((target("avx")))
+#endif
+
+#ifdef CL_SOUND_AVX
+#include <immintrin.h>
+#endif
+
+namespace clan
+{
+
+#ifdef CL_SOUND_AVX
+
+cl_avx_target static void sound_resampler_polyphase_avx(const float *coefficients, float **input, int num_channels, int position, unsigned int fraction, ubyte64 step, float **output, int count)
+{
+	const int num_taps = SoundResampler_FilterBank::num_taps;
+	const int phase_shift = 32 - SoundResampler_FilterBank::phase_bits;
+
+	ubyte64 pos = (((ubyte64) position) << 32) + fraction;
+	int i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		int offsets[4];
+		const float *filters[4];
+		for (int j = 0; j < 4; j++)
+		{
+			offsets[j] = (int) (pos >> 32) - SoundResampler::input_history;
+			filters[j] = coefficients + (((unsigned int) pos) >> phase_shift) * num_taps;
+			pos += step;
+		}
+
+		for (int channel = 0; channel < num_channels; channel++)
+		{
+			__m128 sums[4];
+			for (int j = 0; j < 4; j++)
+			{
+				const float *src = input[channel] + offsets[j];
+				const float *filter = filters[j];
+				__m256 sum = _mm256_mul_ps(_mm256_loadu_ps(src), _mm256_loadu_ps(filter));
+				sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(src + 8), _mm256_loadu_ps(filter + 8)));
+				sums[j] = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+			}
+			_MM_TRANSPOSE4_PS(sums[0], sums[1], sums[2], sums[3]);
+			__m128 result = _mm_add_ps(_mm_add_ps(sums[0], sums[1]), _mm_add_ps(sums[2], sums[3]));
+			_mm_storeu_ps(output[channel] + i, result);
+		}
+	}
+
+	_mm256_zeroupper();
+
+	if (i < count)
+	{
+		position = (int) (pos >> 32);
+		fraction = (unsigned int) pos;
+		for (int channel = 0; channel < num_channels; channel++)
+		{
+			float *tail_output = output[channel] + i;
+			SoundResampler_Impl::resample_polyphase(coefficients, input + channel, 1, position, fraction, step, &tail_output, count - i);
+		}
+	}
+}
+
+#endif
+
+bool SoundResamplerAVX::is_supported()
+{
+#ifdef CL_SOUND_AVX
+	static bool supported = System::detect_cpu_extension(System::avx);
+	return supported;
+#else
+	return false;
+#endif
+}
+
+void SoundResamplerAVX::resample_polyphase(const float *coefficients, float **input, int num_channels, int position, unsigned int fraction, ubyte64 step, float **output, int count)
+{
+#ifdef CL_SOUND_AVX
+	sound_resampler_polyphase_avx(coefficients, input, num_channels, position, fraction, step, output, count);
+#else
+	SoundResampler_Impl::resample_polyphase(coefficients, input, num_channels, position, fraction, step, output, count);
+#endif
+}
+
+}
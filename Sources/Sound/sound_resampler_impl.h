@@ -0,0 +1,100 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Magnus Norddahl
+*/
+
+#pragma once
+
+#include "API/Sound/sound_resampler.h"
+#include "API/Core/System/mutex.h"
+#include "API/Core/System/cl_platform.h"
+#include <map>
+
+namespace clan
+{
+
+/// \brief Windowed sinc filter coefficients for each fractional position
+class SoundResampler_FilterBank
+{
+public:
+	/// \brief Calculates the coefficients
+	///
+	/// \param cutoff = Cutoff frequency relative to the input Nyquist frequency
+	SoundResampler_FilterBank(float cutoff);
+	~SoundResampler_FilterBank();
+
+	/// \brief Returns a shared bank for a cutoff frequency, calculating it if needed
+	static std::shared_ptr<SoundResampler_FilterBank> get(float cutoff);
+
+	/// \brief Filter taps for each phase, 16 byte aligned
+	float *coefficients;
+
+	static const int num_taps = 16;
+	static const int phase_bits = 9;
+	static const int num_phases = 1 << phase_bits;
+
+private:
+	SoundResampler_FilterBank(const SoundResampler_FilterBank &);
+	SoundResampler_FilterBank &operator =(const SoundResampler_FilterBank &);
+
+	static int get_cutoff_key(float cutoff);
+	static void add_common_banks();
+
+	static Mutex cache_mutex;
+	static std::map<int, std::shared_ptr<SoundResampler_FilterBank> > cache;
+};
+
+class SoundResampler_Impl
+{
+public:
+	SoundResampler_Impl(SoundResamplerMode mode);
+
+	SoundResamplerMode mode;
+
+	/// \brief Input samples advanced per output sample, as 32.32 fixed point
+	ubyte64 step;
+
+	float cutoff;
+
+	std::shared_ptr<SoundResampler_FilterBank> bank;
+
+	bool use_avx;
+
+	static void resample_linear(float **input, int num_channels, int position, unsigned int fraction, ubyte64 step, float **output, int count);
+	static void resample_polyphase(const float *coefficients, float **input, int num_channels, int position, unsigned int fraction, ubyte64 step, float **output, int count);
+};
+
+/// \brief AVX version of the polyphase filter, processing four output samples at a time
+class SoundResamplerAVX
+{
+public:
+	/// \brief Returns true if the compiler and the CPU both support AVX
+	static bool is_supported();
+
+	static void resample_polyphase(const float *coefficients, float **input, int num_channels, int position, unsigned int fraction, ubyte64 step, float **output, int count);
+};
+
+}
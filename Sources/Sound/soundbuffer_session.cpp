@@ -168,6 +168,19 @@ bool SoundBuffer_Session::is_playing()
 	}
 }
 
+SoundResamplerMode SoundBuffer_Session::get_resampler_mode() const
+{
+	if (impl)
+	{
+		MutexSection mutex_lock(&impl->mutex);
+		return impl->resampler.get_mode();
+	}
+	else
+	{
+		return resampler_polyphase;
+	}
+}
+
 /////////////////////////////////////////////////////////////////////////////
 // SoundBuffer_Session operations:
 
@@ -223,7 +236,15 @@ bool SoundBuffer_Session::set_position_relative(float new_pos)
 void SoundBuffer_Session::set_volume(float new_volume)
 {
 	if (impl)
+	{
+		MutexSection mutex_lock(&impl->mutex);
 		impl->volume = new_volume;
+		mutex_lock.unlock();
+		if (impl->output.impl)
+			impl->output.impl->set_session_volume(*this, new_volume);
+		else
+			impl->mixer_volume = new_volume;
+	}
 }
 
 void SoundBuffer_Session::set_frequency(int new_frequency)
@@ -232,10 +253,27 @@ void SoundBuffer_Session::set_frequency(int new_frequency)
 		impl->frequency = new_frequency;
 }
 
+void SoundBuffer_Session::set_resampler_mode(SoundResamplerMode mode)
+{
+	if (impl)
+	{
+		MutexSection mutex_lock(&impl->mutex);
+		impl->resampler.set_mode(mode);
+	}
+}
+
 void SoundBuffer_Session::set_pan(float new_pan)
 {
 	if (impl)
+	{
+		MutexSection mutex_lock(&impl->mutex);
 		impl->pan = new_pan;
+		mutex_lock.unlock();
+		if (impl->output.impl)
+			impl->output.impl->set_session_pan(*this, new_pan);
+		else
+			impl->mixer_pan = new_pan;
+	}
 }
 
 void SoundBuffer_Session::play()
@@ -259,11 +297,10 @@ void SoundBuffer_Session::stop()
 	{
 		MutexSection mutex_lock(&impl->mutex);
 		if (!impl->playing) return;
-		mutex_lock.unlock();
-		impl->output.impl->stop_session(*this);
-		mutex_lock.lock();
 		impl->playing = false;
 		impl->provider_session->stop();
+		mutex_lock.unlock();
+		impl->output.impl->stop_session(*this);
 	}
 }
 
@@ -35,6 +35,8 @@
 #include "API/Sound/SoundProviders/soundprovider.h"
 #include "API/Sound/SoundProviders/soundprovider_session.h"
 #include "API/Core/Text/logger.h"
+#include "API/Core/Math/cl_math.h"
+#include <cstring>
 
 namespace clan
 {
@@ -43,23 +45,34 @@ namespace clan
 //! Construction:
 
 SoundBuffer_Session_Impl::SoundBuffer_Session_Impl(SoundBuffer &soundbuffer, bool looping, SoundOutput &output)
-: soundbuffer(soundbuffer), provider_session(0), output(output), volume(1.0f), pan(0.0f), looping(looping), playing(false)
+: soundbuffer(soundbuffer), provider_session(0), output(output), volume(1.0f), pan(0.0f), looping(looping), playing(false), mixer_active(false)
 {
 	volume = soundbuffer.get_volume();
 	pan = soundbuffer.get_pan();
+	mixer_volume = volume;
+	mixer_pan = pan;
 	provider_session = soundbuffer.get_provider()->begin_session();
 	provider_session->set_looping(looping);
 	frequency = provider_session->get_frequency();
 
 	num_buffer_samples = 16*1024;
 	num_buffer_channels = provider_session->get_num_channels();
-	buffer_position = 0.0;
-	buffer_samples_written = 0;
+
+	// The resampler reads samples before the playback position, so start after a bit of silence
+	buffer_position = SoundResampler::input_history;
+	buffer_fraction = 0;
+	buffer_samples_written = SoundResampler::input_history;
+	end_padded = false;
 
 	float_buffer_data = new float*[num_buffer_channels];
-	for (int i=0; i<num_buffer_channels; i++) float_buffer_data[i] = new float[num_buffer_samples];
+	for (int i=0; i<num_buffer_channels; i++)
+	{
+		float_buffer_data[i] = new float[num_buffer_samples];
+		SoundSSE::set_float(float_buffer_data[i], buffer_samples_written, 0.0f);
+	}
 
 	float_buffer_data_offsetted.resize(num_buffer_channels);
+	temp_data_offsetted.resize(num_buffer_channels);
 }
 
 SoundBuffer_Session_Impl::~SoundBuffer_Session_Impl()
@@ -83,6 +96,8 @@ SoundBuffer_Session_Impl::~SoundBuffer_Session_Impl()
 bool SoundBuffer_Session_Impl::mix_to(float **sample_data, float **temp_data, int num_samples, int num_channels)
 {
 	MutexSection mutex_lock(&mutex);
+	if (!playing)
+		return false;
 	get_data_in_mixer_frequency(num_samples, temp_data);
 	run_filters(temp_data, num_samples);
 	mix_channels(num_channels, num_samples, sample_data, temp_data);
@@ -103,8 +118,8 @@ void SoundBuffer_Session_Impl::get_data()
 
 	if (num_session_channels > 0)
 	{
-		// Copy stream data to working buffer:
-		int samples_left = num_buffer_samples;
+		// Append stream data to working buffer:
+		int samples_left = num_buffer_samples - buffer_samples_written;
 		while (samples_left > 0)
 		{
 			for (int i = 0; i < num_session_channels; i++)
@@ -147,36 +162,52 @@ void SoundBuffer_Session_Impl::get_data()
 void SoundBuffer_Session_Impl::get_data_in_mixer_frequency(int num_samples, float **temp_data)
 {
 	// Convert from session frequency to mixer frequency:
-	// This is done by copying data from the temporary session buffers (buffer_data) to
-	// the temporary mixing buffers (temp_data), and if buffer_data is exhausted, calling
-	// get_data() to fill it with new data from the soundprovider session object.
-	double speed = frequency / double(output.get_mixing_frequency());
-	int sample_count;
-	for (sample_count = 0; sample_count < num_samples; sample_count++)
+	// The resampler reads from the temporary session buffers (buffer_data) into the temporary
+	// mixing buffers (temp_data). When buffer_data is exhausted, the samples the resampler still
+	// needs are moved to the start and get_data() fills the rest from the soundprovider session.
+	resampler.set_frequencies(frequency, output.get_mixing_frequency());
+
+	int sample_count = 0;
+	while (sample_count < num_samples)
 	{
-		if (buffer_position < buffer_samples_written)
-		{
-			for (int chan = 0; chan < num_buffer_channels; chan++)
-			{
-				temp_data[chan][sample_count] = float_buffer_data[chan][int(buffer_position)];
-			}
-		}
-		else
+		for (int chan = 0; chan < num_buffer_channels; chan++)
+			temp_data_offsetted[chan] = temp_data[chan] + sample_count;
+
+		sample_count += resampler.resample(float_buffer_data, buffer_samples_written, num_buffer_channels, buffer_position, buffer_fraction, &temp_data_offsetted[0], num_samples - sample_count);
+		if (sample_count == num_samples)
+			break;
+
+		// Out of data, keep the samples still needed and get more from provider:
+		int keep_start = min(buffer_position - SoundResampler::input_history, buffer_samples_written);
+		int keep_samples = buffer_samples_written - keep_start;
+		for (int chan = 0; chan < num_buffer_channels; chan++)
+			memmove(float_buffer_data[chan], float_buffer_data[chan] + keep_start, sizeof(float) * keep_samples);
+		buffer_position -= keep_start;
+		buffer_samples_written = keep_samples;
+
+		get_data();
+		if (buffer_samples_written == keep_samples)
 		{
-			if (provider_session->eof())
+			// No more data to get from provider for some reason.
+			if (!provider_session->eof())
+				break;
+
+			if (end_padded)
 			{
 				playing = false;
 				break;
 			}
 
-			// Out of data, get more from provider:
-			buffer_position -= buffer_samples_written;
-			get_data();
-			sample_count--;
-			continue;
+			// Let the last samples pass through the filter:
+			for (int chan = 0; chan < num_buffer_channels; chan++)
+				SoundSSE::set_float(float_buffer_data[chan] + buffer_samples_written, SoundResampler::input_lookahead, 0.0f);
+			buffer_samples_written += SoundResampler::input_lookahead;
+			end_padded = true;
+		}
+		else
+		{
+			end_padded = false;
 		}
-
-		buffer_position += speed;
 	}
 
 	// Clear the remaining samples (if any)
@@ -199,17 +230,18 @@ void SoundBuffer_Session_Impl::run_filters(float **temp_data, int num_samples)
 
 void SoundBuffer_Session_Impl::get_channel_volume(float *channel_volume)
 {
-	float left_pan = 1-pan;
-	float right_pan = 1+pan;
+	float left_pan = 1-mixer_pan;
+	float right_pan = 1+mixer_pan;
 	if (left_pan < 0.0f) left_pan = 0.0f;
 	if (left_pan > 1.0f) left_pan = 1.0f;
 	if (right_pan < 0.0f) right_pan = 0.0f;
 	if (right_pan > 1.0f) right_pan = 1.0f;
-	if (volume < 0.0f) volume = 0.0f;
-	if (volume > 1.0f) volume = 1.0f;
+	float mix_volume = mixer_volume;
+	if (mix_volume < 0.0f) mix_volume = 0.0f;
+	if (mix_volume > 1.0f) mix_volume = 1.0f;
 
-	float left_volume = volume * left_pan;
-	float right_volume = volume * right_pan;
+	float left_volume = mix_volume * left_pan;
+	float right_volume = mix_volume * right_pan;
 
 	channel_volume[0] = left_volume;
 	channel_volume[1] = right_volume;
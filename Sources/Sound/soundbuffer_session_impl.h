@@ -33,6 +33,7 @@
 #include "API/Sound/soundformat.h"
 #include "API/Sound/soundoutput.h"
 #include "API/Sound/soundbuffer.h"
+#include "API/Sound/sound_resampler.h"
 #include <memory>
 
 namespace clan
@@ -73,6 +74,16 @@ public:
 	std::vector<SoundFilter> filters;
 	mutable Mutex mutex;
 
+	/// \brief Volume and pan used by the mixer thread, updated through the SoundOutput command queue
+	float mixer_volume;
+	float mixer_pan;
+
+	/// \brief True while the mixer thread has the session in its list. Only accessed by the mixer thread.
+	bool mixer_active;
+
+	/// \brief Converts from the session frequency to the mixer frequency
+	SoundResampler resampler;
+
 
 /// \}
 /// \name Operations
@@ -106,6 +117,8 @@ private:
 
 	std::vector<float*> float_buffer_data_offsetted;
 
+	std::vector<float*> temp_data_offsetted;
+
 	/// \brief Size of temporary channel buffers.
 	int num_buffer_samples;
 
@@ -113,7 +126,13 @@ private:
 	int num_buffer_channels;
 
 	/// \brief Current playback position in temporary buffers.
-	double buffer_position;
+	int buffer_position;
+
+	/// \brief Fractional part of the playback position, in units of 1/2^32 samples.
+	unsigned int buffer_fraction;
+
+	/// \brief True when silence has been added after the end of the stream to flush the resampler.
+	bool end_padded;
 
 	/// \brief Number of samples currently written to buffer_data.
 	int buffer_samples_written;
@@ -159,6 +159,18 @@ float SoundOutput::get_global_pan() const
 	return impl->pan;
 }
 
+bool SoundOutput::is_parallel_mixing() const
+{
+	MutexSection mutex_lock(&impl->mutex);
+	return impl->parallel_mixing;
+}
+
+SoundOutput_MixStats SoundOutput::get_mix_stats() const
+{
+	MutexSection mutex_lock(&impl->mutex);
+	return impl->mix_stats;
+}
+
 /////////////////////////////////////////////////////////////////////////////
 // SoundOutput operations:
 
@@ -184,6 +196,26 @@ void SoundOutput::set_global_pan(float pan)
 	}
 }
 
+void SoundOutput::set_parallel_mixing(bool enable)
+{
+	if (impl)
+	{
+		MutexSection mutex_lock(&impl->mutex);
+		impl->parallel_mixing = enable;
+	}
+}
+
+void SoundOutput::reset_mix_stats()
+{
+	if (impl)
+	{
+		MutexSection mutex_lock(&impl->mutex);
+		int fragment_time = impl->mix_stats.fragment_time;
+		impl->mix_stats = SoundOutput_MixStats();
+		impl->mix_stats.fragment_time = fragment_time;
+	}
+}
+
 void SoundOutput::add_filter(SoundFilter &filter)
 {
 	if (impl)
@@ -32,10 +32,50 @@
 #include "API/Sound/soundfilter.h"
 #include <algorithm>
 #include "API/Sound/sound_sse.h"
+#include "API/Core/System/system.h"
+#include "API/Core/Math/cl_math.h"
 
 namespace clan
 {
 
+/////////////////////////////////////////////////////////////////////////////
+// SoundOutput_CommandQueue:
+
+SoundOutput_CommandQueue::~SoundOutput_CommandQueue()
+{
+	SoundOutput_Command *command = head;
+	while (command)
+	{
+		SoundOutput_Command *next = command->next;
+		delete command;
+		command = next;
+	}
+}
+
+void SoundOutput_CommandQueue::push(SoundOutput_Command *command)
+{
+	do
+	{
+		command->next = head;
+	} while (!compare_and_swap(&head, command->next, command));
+}
+
+SoundOutput_Command *SoundOutput_CommandQueue::pop_all()
+{
+	SoundOutput_Command *command = exchange(&head, 0);
+
+	// The stack has the newest command first
+	SoundOutput_Command *oldest = 0;
+	while (command)
+	{
+		SoundOutput_Command *next = command->next;
+		command->next = oldest;
+		oldest = command;
+		command = next;
+	}
+	return oldest;
+}
+
 Mutex SoundOutput_Impl::singleton_mutex;
 SoundOutput_Impl *SoundOutput_Impl::instance = 0;
 
@@ -44,7 +84,7 @@ SoundOutput_Impl *SoundOutput_Impl::instance = 0;
 
 SoundOutput_Impl::SoundOutput_Impl(int mixing_frequency, int latency)
 : mixing_frequency(mixing_frequency), mixing_latency(latency), volume(1.0f),
-  pan(0.0f), mix_buffer_size(0)
+  pan(0.0f), parallel_mixing(false), mix_buffer_size(0), num_mix_groups(0)
 {
  	mix_buffers[0] = 0;
 	mix_buffers[1] = 0;
@@ -66,6 +106,7 @@ SoundOutput_Impl::~SoundOutput_Impl()
 	SoundSSE::aligned_free(mix_buffers[1]);
 	SoundSSE::aligned_free(temp_buffers[0]);
 	SoundSSE::aligned_free(temp_buffers[1]);
+	free_mix_groups();
 
 	MutexSection lock(&singleton_mutex);
 	instance = NULL;
@@ -80,22 +121,22 @@ SoundOutput_Impl::~SoundOutput_Impl()
 
 void SoundOutput_Impl::play_session(SoundBuffer_Session &session)
 {
-	MutexSection mutex_lock(&mutex);
-	sessions.push_back(session);
+	commands.push(new SoundOutput_Command(SoundOutput_Command::type_play, session));
 }
 
 void SoundOutput_Impl::stop_session(SoundBuffer_Session &session)
 {
-	MutexSection mutex_lock(&mutex);
+	commands.push(new SoundOutput_Command(SoundOutput_Command::type_stop, session));
+}
 
-	for (std::vector<SoundBuffer_Session>::iterator it = sessions.begin(); it != sessions.end(); ++it)
-	{
-		if (session.impl.get() == it->impl.get())
-		{
-			sessions.erase(it);
-			break;
-		}
-	}
+void SoundOutput_Impl::set_session_volume(SoundBuffer_Session &session, float volume)
+{
+	commands.push(new SoundOutput_Command(SoundOutput_Command::type_volume, session, volume));
+}
+
+void SoundOutput_Impl::set_session_pan(SoundBuffer_Session &session, float pan)
+{
+	commands.push(new SoundOutput_Command(SoundOutput_Command::type_pan, session, pan));
 }
 
 void SoundOutput_Impl::start_mixer_thread()
@@ -115,13 +156,22 @@ void SoundOutput_Impl::stop_mixer_thread()
 
 void SoundOutput_Impl::mix_fragment()
 {
+	ubyte64 start_time = System::get_microseconds();
+
+	MutexSection mutex_lock(&mutex);
+	bool parallel = parallel_mixing;
+	mutex_lock.unlock();
+
 	resize_mix_buffers();
+	apply_commands();
 	clear_mix_buffers();
-	fill_mix_buffers();
+	fill_mix_buffers(parallel);
 	filter_mix_buffers();
 	apply_master_volume_on_mix_buffers();
 	clamp_mix_buffers();
 	SoundSSE::pack_float_stereo(mix_buffers, mix_buffer_size, stereo_buffer);
+
+	update_mix_stats((int)(System::get_microseconds() - start_time));
 }
 
 /////////////////////////////////////////////////////////////////////////////
@@ -164,6 +214,7 @@ void SoundOutput_Impl::resize_mix_buffers()
 		SoundSSE::aligned_free(mix_buffers[1]); mix_buffers[1] = 0;
 		SoundSSE::aligned_free(temp_buffers[0]); temp_buffers[0] = 0;
 		SoundSSE::aligned_free(temp_buffers[1]); temp_buffers[1] = 0;
+		free_mix_groups();
 
 		mix_buffer_size = get_fragment_size();
 		//if (mix_buffer_size & 3)
@@ -178,6 +229,62 @@ void SoundOutput_Impl::resize_mix_buffers()
 	}
 }
 
+void SoundOutput_Impl::free_mix_groups()
+{
+	for (size_t i = 0; i < mix_groups.size(); i++)
+	{
+		for (int chan = 0; chan < 2; chan++)
+		{
+			SoundSSE::aligned_free(mix_groups[i].mix_buffers[chan]);
+			SoundSSE::aligned_free(mix_groups[i].temp_buffers[chan]);
+		}
+	}
+	mix_groups.clear();
+}
+
+void SoundOutput_Impl::apply_commands()
+{
+	SoundOutput_Command *command = commands.pop_all();
+	while (command)
+	{
+		SoundBuffer_Session_Impl *session_impl = command->session.impl.get();
+		switch (command->type)
+		{
+		case SoundOutput_Command::type_play:
+			if (!session_impl->mixer_active)
+			{
+				session_impl->mixer_active = true;
+				sessions.push_back(command->session);
+			}
+			break;
+		case SoundOutput_Command::type_stop:
+			if (session_impl->mixer_active)
+			{
+				session_impl->mixer_active = false;
+				for (std::vector<SoundBuffer_Session>::iterator it = sessions.begin(); it != sessions.end(); ++it)
+				{
+					if (it->impl.get() == session_impl)
+					{
+						sessions.erase(it);
+						break;
+					}
+				}
+			}
+			break;
+		case SoundOutput_Command::type_volume:
+			session_impl->mixer_volume = command->value;
+			break;
+		case SoundOutput_Command::type_pan:
+			session_impl->mixer_pan = command->value;
+			break;
+		}
+
+		SoundOutput_Command *next = command->next;
+		delete command;
+		command = next;
+	}
+}
+
 void SoundOutput_Impl::clear_mix_buffers()
 {
 	// Clear channel mixing buffers:
@@ -185,21 +292,87 @@ void SoundOutput_Impl::clear_mix_buffers()
 	SoundSSE::set_float(mix_buffers[1], mix_buffer_size, 0.0f);
 }
 
-void SoundOutput_Impl::fill_mix_buffers()
+void SoundOutput_Impl::fill_mix_buffers(bool parallel)
 {
-	MutexSection mutex_lock(&mutex);
-	std::vector< SoundBuffer_Session > ended_sessions;
-	std::vector< SoundBuffer_Session >::iterator it;
-	for (it = sessions.begin(); it != sessions.end(); ++it)
+	int num_sessions = sessions.size();
+	sessions_playing.resize(num_sessions);
+
+	num_mix_groups = 1;
+	if (parallel)
+	{
+		if (!work_queue)
+			work_queue.reset(new WorkQueue(WorkQueue::get_shared()));
+		num_mix_groups = max(1, min(num_sessions / min_group_sessions, work_queue->get_num_threads() + 1));
+	}
+
+	if (num_mix_groups > 1)
+	{
+		while ((int)mix_groups.size() < num_mix_groups)
+		{
+			SoundOutput_MixGroup group;
+			for (int chan = 0; chan < 2; chan++)
+			{
+				group.mix_buffers[chan] = (float *) SoundSSE::aligned_alloc(sizeof(float) * mix_buffer_size);
+				group.temp_buffers[chan] = (float *) SoundSSE::aligned_alloc(sizeof(float) * mix_buffer_size);
+			}
+			mix_groups.push_back(group);
+		}
+
+		std::vector<WorkTask> tasks;
+		for (int group = 1; group < num_mix_groups; group++)
+			tasks.push_back(work_queue->run(Callback_v0(this, &SoundOutput_Impl::mix_group, group)));
+		mix_group(0);
+		for (size_t i = 0; i < tasks.size(); i++)
+			work_queue->wait_for(tasks[i]);
+
+		// Add the group results to the mixing buffers:
+		for (int group = 1; group < num_mix_groups; group++)
+		{
+			for (int chan = 0; chan < 2; chan++)
+				SoundSSE::mix_one_to_one(mix_groups[group].mix_buffers[chan], mix_buffer_size, mix_buffers[chan], 1.0f);
+		}
+	}
+	else
 	{
-		SoundBuffer_Session session = *it;
-		bool playing = session.impl->mix_to(mix_buffers, temp_buffers, mix_buffer_size, 2);
-		if (!playing) ended_sessions.push_back(session);
+		mix_group(0);
 	}
 
-	// Release any sessions pending for removal:
-	int size_ended_sessions = ended_sessions.size();
-	for (int i = 0; i < size_ended_sessions; i++) stop_session(ended_sessions[i]);
+	// Release any sessions that ended:
+	int num_playing = 0;
+	for (int i = 0; i < num_sessions; i++)
+	{
+		if (sessions_playing[i])
+		{
+			if (num_playing != i)
+				sessions[num_playing] = sessions[i];
+			num_playing++;
+		}
+		else
+		{
+			sessions[i].impl->mixer_active = false;
+		}
+	}
+	sessions.resize(num_playing, SoundBuffer_Session());
+}
+
+void SoundOutput_Impl::mix_group(int group)
+{
+	int num_sessions = sessions.size();
+	int begin = num_sessions * group / num_mix_groups;
+	int end = num_sessions * (group + 1) / num_mix_groups;
+
+	float **group_mix_buffers = mix_buffers;
+	float **group_temp_buffers = temp_buffers;
+	if (group != 0)
+	{
+		group_mix_buffers = mix_groups[group].mix_buffers;
+		group_temp_buffers = mix_groups[group].temp_buffers;
+		SoundSSE::set_float(group_mix_buffers[0], mix_buffer_size, 0.0f);
+		SoundSSE::set_float(group_mix_buffers[1], mix_buffer_size, 0.0f);
+	}
+
+	for (int i = begin; i < end; i++)
+		sessions_playing[i] = sessions[i].impl->mix_to(group_mix_buffers, group_temp_buffers, mix_buffer_size, 2) ? 1 : 0;
 }
 
 void SoundOutput_Impl::filter_mix_buffers()
@@ -233,6 +406,18 @@ void SoundOutput_Impl::apply_master_volume_on_mix_buffers()
 	SoundSSE::multiply_float(mix_buffers[1], mix_buffer_size, right_volume);
 }
 
+void SoundOutput_Impl::update_mix_stats(int mix_time)
+{
+	MutexSection mutex_lock(&mutex);
+	mix_stats.fragments_mixed++;
+	mix_stats.active_sessions = sessions.size();
+	mix_stats.last_mix_time = mix_time;
+	mix_stats.max_mix_time = max(mix_stats.max_mix_time, mix_time);
+	mix_stats.fragment_time = (int)(mix_buffer_size * (ubyte64)1000000 / mixing_frequency);
+	if (mix_time > mix_stats.fragment_time)
+		mix_stats.underruns++;
+}
+
 void SoundOutput_Impl::clamp_mix_buffers()
 {
 	// Make sure values stay inside 16 bit range:
@@ -33,14 +33,81 @@
 #include "API/Core/System/thread.h"
 #include "API/Core/System/mutex.h"
 #include "API/Core/System/event.h"
+#include "API/Core/System/work_queue.h"
+#include "API/Sound/soundoutput.h"
+#include "API/Sound/soundbuffer_session.h"
 #include <memory>
 
+#ifdef WIN32
+#include <windows.h>
+#endif
+
 namespace clan
 {
 
 class SoundFilter;
 class SoundBuffer_Session_Impl;
-class SoundBuffer_Session;
+
+/// \brief Session change sent to the mixer thread
+class SoundOutput_Command
+{
+public:
+	enum Type
+	{
+		type_play,
+		type_stop,
+		type_volume,
+		type_pan
+	};
+
+	SoundOutput_Command(Type type, const SoundBuffer_Session &session, float value = 0.0f) : type(type), session(session), value(value), next(0) { }
+
+	Type type;
+	SoundBuffer_Session session;
+	float value;
+	SoundOutput_Command *next;
+};
+
+/// \brief Lock free queue of commands from any thread to the mixer thread
+///
+/// Producers push onto a linked stack with compare and swap. The mixer
+/// takes the whole stack in one exchange and reverses it, so there is no
+/// ABA problem and commands are applied in the order they were pushed.
+class SoundOutput_CommandQueue
+{
+public:
+	SoundOutput_CommandQueue() : head(0) { }
+	~SoundOutput_CommandQueue();
+
+	/// \brief Queues a command, transferring ownership. Any thread.
+	void push(SoundOutput_Command *command);
+
+	/// \brief Removes all queued commands, oldest first. Mixer thread only.
+	SoundOutput_Command *pop_all();
+
+private:
+	SoundOutput_CommandQueue(const SoundOutput_CommandQueue &);
+	SoundOutput_CommandQueue &operator =(const SoundOutput_CommandQueue &);
+
+#ifdef WIN32
+	static bool compare_and_swap(SoundOutput_Command * volatile *value, SoundOutput_Command *expected_value, SoundOutput_Command *new_value) { return InterlockedCompareExchangePointer((PVOID volatile *) value, new_value, expected_value) == expected_value; }
+	static SoundOutput_Command *exchange(SoundOutput_Command * volatile *value, SoundOutput_Command *new_value) { return (SoundOutput_Command *) InterlockedExchangePointer((PVOID volatile *) value, new_value); }
+#else
+	static bool compare_and_swap(SoundOutput_Command * volatile *value, SoundOutput_Command *expected_value, SoundOutput_Command *new_value) { return __sync_bool_compare_and_swap(value, expected_value, new_value); }
+	static SoundOutput_Command *exchange(SoundOutput_Command * volatile *value, SoundOutput_Command *new_value) { SoundOutput_Command *old_value = __sync_lock_test_and_set(value, new_value); __sync_synchronize(); return old_value; }
+#endif
+
+	SoundOutput_Command * volatile head;
+};
+
+/// \brief Buffers a group of sessions is mixed into on a worker thread
+struct SoundOutput_MixGroup
+{
+	SoundOutput_MixGroup() { mix_buffers[0] = mix_buffers[1] = 0; temp_buffers[0] = temp_buffers[1] = 0; }
+
+	float *mix_buffers[2];
+	float *temp_buffers[2];
+};
 
 class SoundOutput_Impl
 {
@@ -74,10 +141,18 @@ public:
 
 	Event stop_mixer;
 
+	/// \brief Sessions being mixed. Only accessed by the mixer thread.
 	std::vector< SoundBuffer_Session > sessions;
 
+	/// \brief Session changes not yet seen by the mixer thread
+	SoundOutput_CommandQueue commands;
+
 	mutable Mutex mutex;
 
+	bool parallel_mixing;
+
+	SoundOutput_MixStats mix_stats;
+
 	int mix_buffer_size;
 
 	float *mix_buffers[2];
@@ -97,6 +172,10 @@ public:
 
 	void stop_session(SoundBuffer_Session &session);
 
+	void set_session_volume(SoundBuffer_Session &session, float volume);
+
+	void set_session_pan(SoundBuffer_Session &session, float pan);
+
 protected:
 	/// \brief Called when we have no samples to play - and wants to tell the soundcard
 	/// \brief about this possible event.
@@ -140,11 +219,23 @@ private:
 	/// \brief Ensures the mixing buffers match the fragment size
 	void resize_mix_buffers();
 
+	/// \brief Frees the buffers of the worker thread mixing groups
+	void free_mix_groups();
+
+	/// \brief Applies the queued session changes
+	void apply_commands();
+
 	/// \brief Clears the content of the mixing buffers
 	void clear_mix_buffers();
 
 	/// \brief Mixes soundbuffer sessions into the mixing buffers
-	void fill_mix_buffers();
+	void fill_mix_buffers(bool parallel);
+
+	/// \brief Mixes a group of sessions. Group 0 mixes directly into the mixing buffers.
+	void mix_group(int group);
+
+	/// \brief Updates the statistics after a fragment has been mixed
+	void update_mix_stats(int mix_time);
 
 	/// \brief Applies filters to the mixing buffers
 	void filter_mix_buffers();
@@ -155,6 +246,18 @@ private:
 	/// \brief Clamp mixing buffer values to the -1 to 1 range
 	void clamp_mix_buffers();
 
+	std::unique_ptr<WorkQueue> work_queue;
+
+	std::vector<SoundOutput_MixGroup> mix_groups;
+
+	int num_mix_groups;
+
+	/// \brief Result of mix_to for each session in the last fragment
+	std::vector<char> sessions_playing;
+
+	/// \brief Fewest sessions worth mixing on a separate thread
+	static const int min_group_sessions = 16;
+
 	static Mutex singleton_mutex;
 	static SoundOutput_Impl *instance;
 /// \}
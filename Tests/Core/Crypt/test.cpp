@@ -67,18 +67,30 @@ int TestApp::main(const std::vector<std::string> &args)
 #endif
 		Console::write_line("Directory: API/Core/Math");
 
-		test_md5();
-		test_rsa();
-		test_aes128();
-		test_aes192();
-		test_aes256();
-		test_sha1();
-		test_sha224();
-		test_sha256();
-		test_sha384();
-		test_sha512();
-		test_sha512_224();
-		test_sha512_256();
+		// Run the tests for both the CPU specific and the portable implementations
+		for (int pass = 0; pass < 2; pass++)
+		{
+			CryptoAcceleration::set_enabled(pass == 0);
+			Console::write_line(pass == 0 ? "Crypto acceleration: enabled" : "Crypto acceleration: disabled");
+
+			test_md5();
+			test_rsa();
+			test_aes128();
+			test_aes192();
+			test_aes256();
+			test_aes_gcm();
+			test_sha1();
+			test_sha224();
+			test_sha256();
+			test_sha384();
+			test_sha512();
+			test_sha512_224();
+			test_sha512_256();
+		}
+		CryptoAcceleration::set_enabled(true);
+
+		test_acceleration();
+		test_benchmark();
 
 		Console::write_line("All Tests Complete");
 		console.display_close_message();
@@ -70,6 +70,7 @@ private:
 	void test_aes256();
 	void test_aes256_helper(const char *key_ptr, const char *iv_ptr, const char *plaintext_ptr, const char *ciphertext_ptr);
 	void convert_ascii(const char *src, std::vector<unsigned char> &dest);
+	void test_aes_gcm();
 
 	void test_rsa();
 	void test_md5();
@@ -88,6 +89,8 @@ private:
 	void test_hash(const SHA512_224 &sha512_224, const char *hash_text);
 	void test_sha512_256();
 	void test_hash(const SHA512_256 &sha512_256, const char *hash_text);
+	void test_acceleration();
+	void test_benchmark();
 public:
 	void fail() const;
 
@@ -0,0 +1,90 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Mark Page
+**    (if your name is missing here, please add it)
+*/
+
+#include "test.h"
+
+// AES_GCM is internal to clanCore, it is only used by the TLS record layer
+#include "Core/Crypto/aes_gcm.h"
+
+void TestApp::test_aes_gcm()
+{
+	Console::write_line(" Header: aes_gcm.h");
+	Console::write_line(string_format("  Class: AES_GCM (%1)",
+		CryptoAcceleration::is_enabled() && CryptoAcceleration::is_pclmul_supported() ? "PCLMULQDQ" : "portable"));
+
+	// Test case 4 from http://csrc.nist.gov/groups/ST/toolkit/BCM/documents/proposedmodes/gcm/gcm-revised-spec.pdf
+	std::vector<unsigned char> key, iv, aad, plaintext, ciphertext, tag;
+	convert_ascii("FEFFE9928665731C6D6A8F9467308308", key);
+	convert_ascii("CAFEBABEFACEDBADDECAF888", iv);
+	convert_ascii("FEEDFACEDEADBEEFFEEDFACEDEADBEEFABADDAD2", aad);
+	convert_ascii(
+		"D9313225F88406E5A55909C5AFF5269A"
+		"86A7A9531534F7DA2E4C303D8A318A72"
+		"1C3C0C95956809532FCF0E2449A6B525"
+		"B16AEDF5AA0DE657BA637B39", plaintext);
+	convert_ascii(
+		"42831EC2217774244B7221B784D0D49C"
+		"E3AA212F2C02A4E035C17E2329ACA12E"
+		"21D514B25466931C7D8F6A5AAC84AA05"
+		"1BA30B396A0AAC973D58E091", ciphertext);
+	convert_ascii("5BC94FBC3221A5DB94FAE95AE7121A47", tag);
+
+	AES_GCM aes_gcm;
+	aes_gcm.set_key(&key[0], key.size());
+
+	std::vector<unsigned char> data = plaintext;
+	unsigned char calculated_tag[AES_GCM::tag_size];
+	aes_gcm.encrypt(&iv[0], &aad[0], aad.size(), &data[0], data.size(), calculated_tag);
+	if (data != ciphertext)
+		fail();
+	if (memcmp(calculated_tag, &tag[0], AES_GCM::tag_size))
+		fail();
+
+	if (!aes_gcm.decrypt(&iv[0], &aad[0], aad.size(), &data[0], data.size(), &tag[0]))
+		fail();
+	if (data != plaintext)
+		fail();
+
+	// A tampered tag, ciphertext or additional data must be rejected, leaving the data encrypted
+	data = ciphertext;
+	calculated_tag[AES_GCM::tag_size - 1] ^= 1;
+	if (aes_gcm.decrypt(&iv[0], &aad[0], aad.size(), &data[0], data.size(), calculated_tag))
+		fail();
+	if (data != ciphertext)
+		fail();
+
+	data[0] ^= 1;
+	if (aes_gcm.decrypt(&iv[0], &aad[0], aad.size(), &data[0], data.size(), &tag[0]))
+		fail();
+	data[0] ^= 1;
+
+	aad[0] ^= 1;
+	if (aes_gcm.decrypt(&iv[0], &aad[0], aad.size(), &data[0], data.size(), &tag[0]))
+		fail();
+}
@@ -0,0 +1,268 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Magnus Norddahl
+*/
+
+#include "test.h"
+
+namespace
+{
+	void fill_test_data(std::vector<unsigned char> &data, int size)
+	{
+		data.resize(size);
+		unsigned int seed = 0x12345678;
+		for (int cnt = 0; cnt < size; cnt++)
+		{
+			seed = seed * 1103515245 + 12345;
+			data[cnt] = (unsigned char) (seed >> 16);
+		}
+	}
+
+	// Adds the data in irregular pieces, so both the buffered and the bulk code paths are used
+	template<typename Type>
+	void add_in_pieces(Type &type, const std::vector<unsigned char> &data)
+	{
+		static const int piece_sizes[] = { 1, 15, 16, 17, 64, 63, 100, 1024, 3, 4096 };
+		int pos = 0;
+		for (int cnt = 0; pos < (int) data.size(); cnt++)
+		{
+			int size = min(piece_sizes[cnt % 10], (int) data.size() - pos);
+			type.add(&data[pos], size);
+			pos += size;
+		}
+	}
+
+	template<typename Encrypt, typename Decrypt>
+	DataBuffer aes_roundtrip(const unsigned char *key, const std::vector<unsigned char> &data, bool padding)
+	{
+		unsigned char iv[16];
+		for (int cnt = 0; cnt < 16; cnt++)
+			iv[cnt] = (unsigned char) (cnt * 7);
+
+		Encrypt encrypt;
+		encrypt.set_iv(iv);
+		encrypt.set_key(key);
+		encrypt.set_padding(padding);
+		add_in_pieces(encrypt, data);
+		encrypt.calculate();
+		DataBuffer encrypted = encrypt.get_data();
+
+		Decrypt decrypt;
+		decrypt.set_iv(iv);
+		decrypt.set_key(key);
+		decrypt.set_padding(padding);
+		std::vector<unsigned char> encrypted_data(encrypted.get_data(), encrypted.get_data() + encrypted.get_size());
+		add_in_pieces(decrypt, encrypted_data);
+		if (!decrypt.calculate())
+			throw Exception("Failed Test");
+		DataBuffer decrypted = decrypt.get_data();
+		if (decrypted.get_size() != data.size() || memcmp(decrypted.get_data(), &data[0], data.size()))
+			throw Exception("Failed Test");
+
+		return encrypted;
+	}
+
+	template<typename Encrypt, typename Decrypt>
+	void compare_aes(const std::vector<unsigned char> &data)
+	{
+		unsigned char key[32];
+		for (int cnt = 0; cnt < 32; cnt++)
+			key[cnt] = (unsigned char) (cnt * 13 + 1);
+
+		for (int padding = 0; padding < 2; padding++)
+		{
+			CryptoAcceleration::set_enabled(true);
+			DataBuffer accelerated = aes_roundtrip<Encrypt, Decrypt>(key, data, padding != 0);
+			CryptoAcceleration::set_enabled(false);
+			DataBuffer portable = aes_roundtrip<Encrypt, Decrypt>(key, data, padding != 0);
+			if (accelerated.get_size() != portable.get_size() || memcmp(accelerated.get_data(), portable.get_data(), portable.get_size()))
+				throw Exception("Failed Test");
+		}
+	}
+
+	template<typename Hash>
+	std::string hash_in_pieces(const std::vector<unsigned char> &data)
+	{
+		Hash hash;
+		add_in_pieces(hash, data);
+		hash.calculate();
+		return hash.get_hash();
+	}
+
+	template<typename Hash>
+	void compare_hash(const std::vector<unsigned char> &data)
+	{
+		CryptoAcceleration::set_enabled(true);
+		std::string accelerated = hash_in_pieces<Hash>(data);
+		CryptoAcceleration::set_enabled(false);
+		std::string portable = hash_in_pieces<Hash>(data);
+		if (accelerated != portable)
+			throw Exception("Failed Test");
+	}
+
+	void write_result(const std::string &name, int size, ubyte64 microseconds)
+	{
+		double megabytes_per_second = size / (double) max(microseconds, (ubyte64) 1);
+		Console::write_line(string_format("   %1: %2 MB/s", name, StringHelp::int_to_text((int) megabytes_per_second)));
+	}
+
+	template<typename Encrypt, typename Decrypt>
+	void benchmark_aes(const std::string &name, const std::vector<unsigned char> &data)
+	{
+		unsigned char key[32] = { 0 };
+		unsigned char iv[16] = { 0 };
+
+		Encrypt encrypt;
+		encrypt.set_iv(iv);
+		encrypt.set_key(key);
+		encrypt.set_padding(false);
+		ubyte64 start_time = System::get_microseconds();
+		encrypt.add(&data[0], data.size());
+		encrypt.calculate();
+		write_result(name + " CBC encrypt", data.size(), System::get_microseconds() - start_time);
+
+		DataBuffer encrypted = encrypt.get_data();
+		Decrypt decrypt;
+		decrypt.set_iv(iv);
+		decrypt.set_key(key);
+		decrypt.set_padding(false);
+		start_time = System::get_microseconds();
+		decrypt.add(encrypted.get_data(), encrypted.get_size());
+		decrypt.calculate();
+		write_result(name + " CBC decrypt", data.size(), System::get_microseconds() - start_time);
+	}
+
+	template<typename Hash>
+	void benchmark_hash(const std::string &name, const std::vector<unsigned char> &data)
+	{
+		Hash hash;
+		ubyte64 start_time = System::get_microseconds();
+		hash.add(&data[0], data.size());
+		hash.calculate();
+		write_result(name, data.size(), System::get_microseconds() - start_time);
+	}
+
+	void benchmark_rsa(int key_size_in_bits)
+	{
+		Random random;
+		Secret private_exponent, prime1, prime2, exponent1, exponent2, coefficient;
+		DataBuffer public_exponent, modulus;
+		ubyte64 start_time = System::get_microseconds();
+		RSA::create_keypair(random, private_exponent, public_exponent, modulus, prime1, prime2, exponent1, exponent2, coefficient, key_size_in_bits);
+		ubyte64 keygen_time = System::get_microseconds() - start_time;
+
+		Secret digest(20);
+		random.get_random_bytes(digest.get_data(), digest.get_size());
+
+		// Signing encrypts with the private exponent (block type 1), verifying decrypts with the public exponent
+		DataBuffer private_exponent_buffer(private_exponent.get_data(), private_exponent.get_size());
+		Secret public_exponent_secret(public_exponent.get_size());
+		memcpy(public_exponent_secret.get_data(), public_exponent.get_data(), public_exponent.get_size());
+
+		const int iterations = 4096 * 1024 / key_size_in_bits / key_size_in_bits * 64 + 4;
+		DataBuffer signature;
+		start_time = System::get_microseconds();
+		for (int cnt = 0; cnt < iterations; cnt++)
+			signature = RSA::encrypt(1, random, private_exponent_buffer, modulus, digest);
+		ubyte64 sign_time = System::get_microseconds() - start_time;
+
+		// The same signature using the Chinese remainder theorem
+		start_time = System::get_microseconds();
+		for (int cnt = 0; cnt < iterations; cnt++)
+			signature = RSA::encrypt(1, random, prime1, prime2, exponent1, exponent2, coefficient, modulus, digest);
+		ubyte64 sign_crt_time = System::get_microseconds() - start_time;
+
+		start_time = System::get_microseconds();
+		for (int cnt = 0; cnt < iterations; cnt++)
+		{
+			Secret verified = RSA::decrypt(public_exponent_secret, modulus, signature);
+			if (verified.get_size() != digest.get_size() || memcmp(verified.get_data(), digest.get_data(), digest.get_size()))
+				throw Exception("Failed Test");
+		}
+		ubyte64 verify_time = System::get_microseconds() - start_time;
+
+		Console::write_line(string_format("   RSA-%1: key generation %2 ms, sign %3/s, sign with CRT %4/s, verify %5/s",
+			key_size_in_bits,
+			(int) (keygen_time / 1000),
+			(int) (iterations * 1000000.0 / max(sign_time, (ubyte64) 1)),
+			(int) (iterations * 1000000.0 / max(sign_crt_time, (ubyte64) 1)),
+			(int) (iterations * 1000000.0 / max(verify_time, (ubyte64) 1))));
+	}
+}
+
+void TestApp::test_acceleration()
+{
+	Console::write_line(" Header: crypto_acceleration.h");
+	Console::write_line("  Class: CryptoAcceleration");
+
+	Console::write_line(string_format("   AES-NI supported: %1", CryptoAcceleration::is_aes_supported() ? "yes" : "no"));
+	Console::write_line(string_format("   SHA extensions supported: %1", CryptoAcceleration::is_sha_supported() ? "yes" : "no"));
+
+	// The accelerated and portable code paths must produce identical output for any length
+	std::vector<unsigned char> data;
+	const int lengths[] = { 16, 64, 160, 1000, 4096, 65536 + 48, 100003 };
+	for (int cnt = 0; cnt < 7; cnt++)
+	{
+		fill_test_data(data, lengths[cnt]);
+		if (lengths[cnt] % 16 == 0)
+		{
+			compare_aes<AES128_Encrypt, AES128_Decrypt>(data);
+			compare_aes<AES192_Encrypt, AES192_Decrypt>(data);
+			compare_aes<AES256_Encrypt, AES256_Decrypt>(data);
+		}
+		compare_hash<SHA1>(data);
+		compare_hash<SHA224>(data);
+		compare_hash<SHA256>(data);
+	}
+
+	CryptoAcceleration::set_enabled(true);
+}
+
+void TestApp::test_benchmark()
+{
+	Console::write_line(" Benchmark: bulk throughput");
+
+	std::vector<unsigned char> data;
+	fill_test_data(data, 16*1024*1024);
+
+	for (int pass = 0; pass < 2; pass++)
+	{
+		CryptoAcceleration::set_enabled(pass == 0);
+		Console::write_line(pass == 0 ? "  Accelerated:" : "  Portable:");
+
+		benchmark_aes<AES128_Encrypt, AES128_Decrypt>("AES-128", data);
+		benchmark_aes<AES192_Encrypt, AES192_Decrypt>("AES-192", data);
+		benchmark_aes<AES256_Encrypt, AES256_Decrypt>("AES-256", data);
+		benchmark_hash<SHA1>("SHA-1", data);
+		benchmark_hash<SHA256>("SHA-256", data);
+	}
+
+	CryptoAcceleration::set_enabled(true);
+
+	Console::write_line(" Benchmark: RSA");
+	benchmark_rsa(1024);
+	benchmark_rsa(2048);
+}
@@ -118,6 +118,36 @@ void TestApp::test_rsa()
 	if (memcmp(server.m_CryptKey.get_data(), client.m_CryptKey.get_data(), server.m_CryptKey.get_size()))
 		fail();
 
-}
+	Console::write_line("   ... Decrypting with the primes");
+
+	Random random;
+	Secret private_exponent, prime1, prime2, exponent1, exponent2, coefficient;
+	DataBuffer public_exponent, modulus;
+	RSA::create_keypair(random, private_exponent, public_exponent, modulus, prime1, prime2, exponent1, exponent2, coefficient, 1024);
+
+	Secret message(32);
+	random.get_random_bytes(message.get_data(), message.get_size());
+	DataBuffer encrypted = RSA::encrypt(2, random, public_exponent, modulus, message);
+
+	Secret decrypted = RSA::decrypt(private_exponent, modulus, encrypted);
+	Secret decrypted_crt = RSA::decrypt(prime1, prime2, exponent1, exponent2, coefficient, modulus, encrypted);
+	if (decrypted.get_size() != message.get_size() || decrypted_crt.get_size() != message.get_size())
+		fail();
+	if (memcmp(decrypted.get_data(), message.get_data(), message.get_size()) || memcmp(decrypted_crt.get_data(), message.get_data(), message.get_size()))
+		fail();
+
+	Console::write_line("   ... Signing with the primes");
 
+	// Block type 1 padding is deterministic, so both ways of signing must give the same bytes
+	DataBuffer private_exponent_buffer(private_exponent.get_data(), private_exponent.get_size());
+	DataBuffer signature = RSA::encrypt(1, random, private_exponent_buffer, modulus, message);
+	DataBuffer signature_crt = RSA::encrypt(1, random, prime1, prime2, exponent1, exponent2, coefficient, modulus, message);
+	if (signature.get_size() != signature_crt.get_size() || memcmp(signature.get_data(), signature_crt.get_data(), signature.get_size()))
+		fail();
 
+	Secret public_exponent_secret(public_exponent.get_size());
+	memcpy(public_exponent_secret.get_data(), public_exponent.get_data(), public_exponent.get_size());
+	Secret verified = RSA::decrypt(public_exponent_secret, modulus, signature_crt);
+	if (verified.get_size() != message.get_size() || memcmp(verified.get_data(), message.get_data(), message.get_size()))
+		fail();
+}
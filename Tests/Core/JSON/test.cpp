@@ -0,0 +1,475 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Magnus Norddahl
+*/
+
+#include "test.h"
+#include <clocale>
+
+// This is the Program class that is called by Application
+class Program
+{
+public:
+	static int main(const std::vector<std::string> &args)
+	{
+		// Initialize ClanLib base components
+		SetupCore setup_core;
+
+		// Start the Application
+		TestApp app;
+		int retval = app.main(args);
+		return retval;
+	}
+};
+
+// Instantiate Application, informing it where the Program is located
+Application app(&Program::main);
+
+int TestApp::main(const std::vector<std::string> &args)
+{
+	ConsoleWindow console("Console");
+
+	try
+	{
+		Console::write_line("ClanLib Test Suite:");
+		Console::write_line("-------------------");
+		Console::write_line("Directory: API/Core/JSON");
+
+		test_reader();
+		test_writer();
+		test_locale();
+		test_document();
+		run_benchmark();
+
+		Console::write_line("All Tests Complete");
+		console.display_close_message();
+	}
+	catch(Exception error)
+	{
+		Console::write_line("Unhandled exception: %1", error.message);
+		console.display_close_message();
+		return -1;
+	}
+
+	return 0;
+}
+
+void TestApp::fail()
+{
+	throw Exception("Failed Test");
+}
+
+namespace
+{
+	const char *test_json = " { \"name\" : \"ClanLib\", \"escaped\": \"a\\\"b\\\\c\\n\\u00e6\\ud83d\\ude00\", \"list\": [1, -2.5, 3e2, true, false, null, [], {}], \"empty\": \"\" } ";
+
+	/// \brief Reads every token and writes the token types and values to a string
+	std::string dump_tokens(JsonReader &reader)
+	{
+		std::string result;
+		while (true)
+		{
+			JsonReader::Token token = reader.next();
+			switch (token)
+			{
+			case JsonReader::token_end: return result;
+			case JsonReader::token_begin_object: result += "{"; break;
+			case JsonReader::token_end_object: result += "}"; break;
+			case JsonReader::token_begin_array: result += "["; break;
+			case JsonReader::token_end_array: result += "]"; break;
+			case JsonReader::token_member_name: result += "N(" + reader.get_string().to_string() + ")"; break;
+			case JsonReader::token_string: result += "S(" + reader.get_string().to_string() + ")"; break;
+			case JsonReader::token_number: result += string_format("D(%1)", (int)(reader.get_number() * 10)); break;
+			case JsonReader::token_boolean: result += reader.get_boolean() ? "T" : "F"; break;
+			case JsonReader::token_null: result += "0"; break;
+			}
+		}
+	}
+
+	bool throws_json_exception(const std::string &json)
+	{
+		try
+		{
+			JsonReader reader(json.data(), json.length());
+			while (reader.next() != JsonReader::token_end);
+		}
+		catch (JsonException &)
+		{
+			return true;
+		}
+		return false;
+	}
+
+	/// \brief Telemetry style test data
+	std::string create_benchmark_json(int num_records)
+	{
+		std::string json = "{\"version\":3,\"source\":\"benchmark\",\"records\":[";
+		for (int i = 0; i < num_records; i++)
+		{
+			if (i > 0)
+				json += ",";
+			json += string_format("{\"id\":%1,\"time\":%2.25,\"name\":\"entity_%3\",\"position\":[%4.5,%5.125,-%6.75],\"active\":%7,\"tags\":[\"alpha\",\"beta\"],\"note\":\"line\\nbreak\"}",
+				i, i * 16, i % 1000, i % 200, i % 300, i % 400, (i % 3) ? "true" : "false");
+		}
+		json += "]}";
+		return json;
+	}
+}
+
+void TestApp::test_reader()
+{
+	Console::write_line(" Header: json_reader.h");
+	Console::write_line("  Class: JsonReader");
+
+	std::string expected = "{N(name)S(ClanLib)N(escaped)S(a\"b\\c\n\xc3\xa6\xf0\x9f\x98\x80)N(list)[D(10)D(-25)D(3000)TF0[]{}]N(empty)S()}";
+
+	Console::write_line("   Function: JsonReader(const void *data, size_t size)");
+	{
+		JsonReader reader(test_json, strlen(test_json));
+		if (dump_tokens(reader) != expected)
+			fail();
+		if (reader.next() != JsonReader::token_end)
+			fail();
+	}
+
+	Console::write_line("   Function: JsonReader(IODevice &device, int buffer_size)");
+	{
+		// A tiny buffer makes every token cross a buffer boundary
+		DataBuffer data(test_json, strlen(test_json));
+		IODevice_Memory device(data);
+		JsonReader reader(device, 1);
+		if (dump_tokens(reader) != expected)
+			fail();
+	}
+
+	Console::write_line("   Function: JsonStringView get_string()");
+	{
+		JsonReader reader(test_json, strlen(test_json));
+		reader.next();
+		reader.next();
+		if (reader.get_string() != "name" || !reader.is_string_in_source())
+			fail();
+		if (reader.get_string().data != strstr(test_json, "name"))
+			fail();
+		reader.next();
+		reader.next();
+		reader.next();
+		if (reader.is_string_in_source())
+			fail();
+	}
+
+	Console::write_line("   Function: void skip()");
+	{
+		JsonReader reader(test_json, strlen(test_json));
+		reader.next();
+		while (reader.next() == JsonReader::token_member_name && reader.get_string() != "list")
+			reader.next();
+		if (reader.next() != JsonReader::token_begin_array || reader.get_depth() != 1)
+			fail();
+		reader.skip();
+		if (reader.get_token() != JsonReader::token_end_array)
+			fail();
+		if (reader.next() != JsonReader::token_member_name || reader.get_string() != "empty")
+			fail();
+	}
+
+	Console::write_line("   Malformed JSON");
+	{
+		if (!throws_json_exception(""))
+			fail();
+		if (!throws_json_exception("{\"a\" 1}"))
+			fail();
+		if (!throws_json_exception("[1,2"))
+			fail();
+		if (!throws_json_exception("[1,}"))
+			fail();
+		if (!throws_json_exception("\"abc"))
+			fail();
+		if (!throws_json_exception("{} {}"))
+			fail();
+		if (!throws_json_exception("[tru]"))
+			fail();
+		if (!throws_json_exception("[1]\f"))
+			fail();
+		if (!throws_json_exception("\"tab\there\""))
+			fail();
+		if (!throws_json_exception("\"\\udc00\""))
+			fail();
+		if (throws_json_exception(" [ 1 , { \"a\" : null } ] "))
+			fail();
+	}
+}
+
+void TestApp::test_locale()
+{
+	Console::write_line(" Numbers with a decimal comma locale");
+
+	// Locale names differ between platforms, and the locale may not be installed
+	const char *locale_names[] = { "de_DE.UTF-8", "de_DE.utf8", "de_DE", "German_Germany", 0 };
+	std::string old_locale = setlocale(LC_NUMERIC, 0);
+	const char *locale_name = 0;
+	for (int i = 0; locale_names[i] && !locale_name; i++)
+	{
+		if (setlocale(LC_NUMERIC, locale_names[i]))
+			locale_name = locale_names[i];
+	}
+	if (!locale_name)
+	{
+		Console::write_line("   No decimal comma locale installed, skipped");
+		return;
+	}
+
+	std::string json = "[0.5,1.25e2]";
+	JsonReader reader(json.data(), json.length());
+	reader.next();
+	bool numbers_read = reader.next() == JsonReader::token_number && reader.get_number() == 0.5 &&
+		reader.next() == JsonReader::token_number && reader.get_number() == 125.0;
+
+	IODevice_Memory device;
+	{
+		JsonWriter writer(device);
+		writer.write_number(0.5);
+	}
+	std::string written(device.get_data().get_data(), device.get_data().get_size());
+
+	setlocale(LC_NUMERIC, old_locale.c_str());
+	if (!numbers_read || written != "0.5")
+		fail();
+}
+
+void TestApp::test_writer()
+{
+	Console::write_line(" Header: json_writer.h");
+	Console::write_line("  Class: JsonWriter");
+
+	Console::write_line("   Function: JsonWriter(IODevice &device, int buffer_size)");
+	{
+		IODevice_Memory device;
+		{
+			JsonWriter writer(device, 8);
+			writer.begin_object();
+			writer.write_member_name("text");
+			writer.write_string("quote\" backslash\\ newline\n tab\t control\x01");
+			writer.write_member_name("numbers");
+			writer.begin_array();
+			writer.write_number(42);
+			writer.write_number(0.5);
+			writer.write_number(-3.0);
+			writer.end_array();
+			writer.write_member_name("flags");
+			writer.begin_array();
+			writer.write_boolean(true);
+			writer.write_boolean(false);
+			writer.write_null();
+			writer.end_array();
+			writer.write_member_name("empty");
+			writer.begin_object();
+			writer.end_object();
+			writer.end_object();
+		}
+
+		DataBuffer &data = device.get_data();
+		std::string json(data.get_data(), data.get_size());
+		if (json != "{\"text\":\"quote\\\" backslash\\\\ newline\\n tab\\t control\\u0001\",\"numbers\":[42,0.5,-3],\"flags\":[true,false,null],\"empty\":{}}")
+			fail();
+
+		// Read it back
+		JsonReader reader(json.data(), json.length());
+		reader.next();
+		reader.next();
+		reader.next();
+		if (reader.get_string() != "quote\" backslash\\ newline\n tab\t control\x01")
+			fail();
+	}
+
+	Console::write_line("   Function: void write_value(const JsonValue &value)");
+	{
+		JsonValue value = JsonValue::object();
+		value["a"] = JsonValue::array();
+		value["a"].get_items().push_back(JsonValue::number(1));
+		value["a"].get_items().push_back(JsonValue::string("x"));
+		value["b"] = JsonValue::boolean(true);
+
+		IODevice_Memory device;
+		{
+			JsonWriter writer(device);
+			writer.write_value(value);
+		}
+		DataBuffer &data = device.get_data();
+		if (std::string(data.get_data(), data.get_size()) != value.to_json())
+			fail();
+	}
+
+	Console::write_line("   Invalid use");
+	{
+		IODevice_Memory device;
+		JsonWriter writer(device);
+		writer.begin_object();
+		bool exception_thrown = false;
+		try
+		{
+			writer.write_number(1);
+		}
+		catch (JsonException &)
+		{
+			exception_thrown = true;
+		}
+		if (!exception_thrown)
+			fail();
+	}
+}
+
+void TestApp::test_document()
+{
+	Console::write_line(" Header: json_document.h");
+	Console::write_line("  Class: JsonDocument");
+
+	Console::write_line("   Function: JsonDocument(const void *data, size_t size)");
+	{
+		JsonDocument document(test_json, strlen(test_json));
+		JsonElement root = document.get_root();
+		if (!root.is_object() || root.get_size() != 4)
+			fail();
+		if (root["name"].to_string() != "ClanLib")
+			fail();
+		if (root["name"].get_string().data != strstr(test_json, "ClanLib"))
+			fail();
+		if (root["escaped"].to_string() != "a\"b\\c\n\xc3\xa6\xf0\x9f\x98\x80")
+			fail();
+		if (root.get_member_name(2) != "list" || root.get_member_value(2).get_size() != 8)
+			fail();
+
+		JsonElement list = root["list"];
+		if (list[0].to_int() != 1 || list[1].to_double() != -2.5 || list[2].to_int() != 300)
+			fail();
+		if (!list[3].to_boolean() || list[4].to_boolean() || !list[5].is_null())
+			fail();
+		if (!list[6].is_array() || list[6].get_size() != 0 || !list[7].is_object())
+			fail();
+		if (root["empty"].to_string() != "")
+			fail();
+		if (root.has_member("missing") || !root["missing"].is_null())
+			fail();
+	}
+
+	Console::write_line("   Function: JsonDocument(IODevice &device)");
+	{
+		DataBuffer data(test_json, strlen(test_json));
+		IODevice_Memory device(data);
+		JsonDocument document(device);
+		JsonValue value = document.get_root().to_value();
+		if (value["name"].to_string() != "ClanLib" || value["escaped"].to_string() != "a\"b\\c\n\xc3\xa6\xf0\x9f\x98\x80")
+			fail();
+		if (value["list"].get_size() != 8 || value["list"][1].to_double() != -2.5 || !value["list"][5].is_null())
+			fail();
+	}
+
+	Console::write_line("   Function: static JsonDocument from_json(const std::string &json)");
+	{
+		JsonDocument document = JsonDocument::from_json("[[1,[2,[3]]],{\"x\":[4]}]");
+		JsonElement root = document.get_root();
+		if (root[0][1][1][0].to_int() != 3 || root[1]["x"][0].to_int() != 4)
+			fail();
+	}
+}
+
+void TestApp::run_benchmark()
+{
+	Console::write_line("   Benchmark: parsing");
+
+	std::string json = create_benchmark_json(200000);
+	double megabytes = json.length() / (1024.0 * 1024.0);
+	Console::write_line(string_format("    %1 MB of JSON", (int)megabytes));
+
+	// JsonValue::from_json cannot parse null, so the test data has none
+	ubyte64 start_time = System::get_microseconds();
+	{
+		JsonValue value = JsonValue::from_json(json);
+		if (value["records"].get_size() != 200000)
+			fail();
+	}
+	ubyte64 value_time = System::get_microseconds() - start_time;
+
+	start_time = System::get_microseconds();
+	{
+		JsonReader reader(json.data(), json.length());
+		int num_numbers = 0;
+		while (reader.next() != JsonReader::token_end)
+		{
+			if (reader.get_token() == JsonReader::token_number)
+				num_numbers++;
+		}
+		if (num_numbers != 200000 * 5 + 1)
+			fail();
+	}
+	ubyte64 reader_time = System::get_microseconds() - start_time;
+
+	DataBuffer data(json.data(), json.length());
+	start_time = System::get_microseconds();
+	{
+		IODevice_Memory device(data);
+		JsonReader reader(device);
+		while (reader.next() != JsonReader::token_end);
+	}
+	ubyte64 device_reader_time = System::get_microseconds() - start_time;
+
+	size_t document_memory = 0;
+	start_time = System::get_microseconds();
+	{
+		JsonDocument document(json.data(), json.length());
+		if (document.get_root()["records"].get_size() != 200000)
+			fail();
+		document_memory = document.get_memory_usage();
+	}
+	ubyte64 document_time = System::get_microseconds() - start_time;
+
+	Console::write_line(string_format("    JsonValue::from_json: %1 MB/s", (int)(megabytes * 1000000.0 / value_time)));
+	Console::write_line(string_format("    JsonReader from memory: %1 MB/s", (int)(megabytes * 1000000.0 / reader_time)));
+	Console::write_line(string_format("    JsonReader from IODevice: %1 MB/s", (int)(megabytes * 1000000.0 / device_reader_time)));
+	Console::write_line(string_format("    JsonDocument: %1 MB/s, %2 MB used", (int)(megabytes * 1000000.0 / document_time), (int)(document_memory / (1024 * 1024))));
+
+	Console::write_line("   Benchmark: writing");
+	{
+		JsonValue value = JsonValue::from_json(json);
+
+		start_time = System::get_microseconds();
+		std::string result = value.to_json();
+		ubyte64 to_json_time = System::get_microseconds() - start_time;
+
+		// IODevice_Memory grows its buffer exactly, so give it room up front
+		DataBuffer output(result.length() * 2);
+		IODevice_Memory device(output);
+		start_time = System::get_microseconds();
+		{
+			JsonWriter writer(device);
+			writer.write_value(value);
+		}
+		ubyte64 writer_time = System::get_microseconds() - start_time;
+
+		Console::write_line(string_format("    JsonValue::to_json: %1 MB/s", (int)(result.length() / (1024.0 * 1024.0) * 1000000.0 / to_json_time)));
+		Console::write_line(string_format("    JsonWriter::write_value: %1 MB/s", (int)(device.get_position() / (1024.0 * 1024.0) * 1000000.0 / writer_time)));
+	}
+}
@@ -69,6 +69,9 @@ int TestApp::main(const std::vector<std::string> &args)
 
 		test_datetime();
 		test_interlock();
+		test_event_set();
+		test_work_queue();
+		test_logger();
 		
 		Console::write_line("All Tests Complete");
 		console.display_close_message();
@@ -73,6 +73,9 @@ public:
 private:
 	void test_datetime();
 	void test_interlock();
+	void test_event_set();
+	void test_work_queue();
+	void test_logger();
 
 	std::string convert_time(DateTime &datetime);
 	void fail(void);
@@ -0,0 +1,219 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Mark Page
+**    (if your name is missing here, please add it)
+*/
+
+#include "test.h"
+#include <algorithm>
+
+#ifndef WIN32
+#include <sys/socket.h>
+#include <sys/resource.h>
+
+class TestEventProvider_Fd : public EventProvider
+{
+public:
+	TestEventProvider_Fd(int handle) : handle(handle) { }
+	EventType get_event_type(int index) { return type_fd_read; }
+	int get_event_handle(int index) { return handle; }
+	int get_num_event_handles() { return 1; }
+
+	int handle;
+};
+#endif
+
+void TestApp::test_event_set()
+{
+	Console::write_line(" Header: event_set.h");
+	Console::write_line("  Class: EventSet");
+
+	Console::write_line("   Function: void add(const Event &event, int id, bool edge_triggered)");
+	{
+		EventSet event_set;
+		Event event1(true, false);
+		Event event2(true, false);
+		event_set.add(event1, 1);
+		event_set.add(event2, 2);
+		if (event_set.get_size() != 2)
+			fail();
+	}
+
+	Console::write_line("   Function: int wait(std::vector<int> &out_flagged_ids, int timeout)");
+	{
+		EventSet event_set;
+		Event event1(true, false);
+		Event event2(true, false);
+		Event event3(true, false);
+		event_set.add(event1, 1);
+		event_set.add(event2, 2);
+		event_set.add(event3, 3);
+
+		std::vector<int> flagged_ids;
+		if (event_set.wait(flagged_ids, 0) != 0)
+			fail();
+		if (!flagged_ids.empty())
+			fail();
+
+		event2.set();
+		if (event_set.wait(flagged_ids, 1000) != 1)
+			fail();
+		if (flagged_ids.size() != 1 || flagged_ids[0] != 2)
+			fail();
+
+		event3.set();
+		if (event_set.wait(flagged_ids, 1000) != 2)
+			fail();
+		std::sort(flagged_ids.begin(), flagged_ids.end());
+		if (flagged_ids[0] != 2 || flagged_ids[1] != 3)
+			fail();
+	}
+
+	Console::write_line("   Function: void remove(const Event &event)");
+	{
+		EventSet event_set;
+		Event event1(true, true);
+		Event event2(true, false);
+		event_set.add(event1, 1);
+		event_set.add(event2, 2);
+		event_set.remove(event1);
+		if (event_set.get_size() != 1)
+			fail();
+
+		std::vector<int> flagged_ids;
+		if (event_set.wait(flagged_ids, 0) != 0)
+			fail();
+
+		event_set.clear();
+		if (event_set.get_size() != 0)
+			fail();
+	}
+
+#ifndef WIN32
+	Console::write_line("   Function: void add(const Event &event, int id, bool edge_triggered) (reused descriptor)");
+	{
+		// A descriptor closed without being removed and reopened under the same number
+		EventSet event_set;
+		int fds1[2];
+		if (pipe(fds1) != 0)
+			fail();
+		Event event1(new TestEventProvider_Fd(fds1[0]));
+		event_set.add(event1, 1);
+		close(fds1[0]);
+		close(fds1[1]);
+
+		int fds2[2];
+		if (pipe(fds2) != 0)
+			fail();
+		if (fds2[0] != fds1[0])
+			fail();
+		Event event2(new TestEventProvider_Fd(fds2[0]));
+		event_set.add(event2, 2);
+
+		char c = 0;
+		if (write(fds2[1], &c, 1) != 1)
+			fail();
+		std::vector<int> flagged_ids;
+		event_set.wait(flagged_ids, 1000);
+		if (std::find(flagged_ids.begin(), flagged_ids.end(), 2) == flagged_ids.end())
+			fail();
+
+		event_set.remove(event1);
+		event_set.remove(event2);
+		close(fds2[0]);
+		close(fds2[1]);
+	}
+#endif
+
+#ifndef WIN32
+	// Other platforms fall back to Event::wait, so there is nothing to compare there
+	Console::write_line("   Benchmark: EventSet::wait vs Event::wait");
+	{
+		// Many idle sockets and one with data waiting, like a server with mostly quiet connections
+		int num_idle_sockets = 10000;
+		const int num_iterations = 1000;
+
+		rlimit limit;
+		if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < (rlim_t) num_idle_sockets + 64)
+		{
+			limit.rlim_cur = std::min(limit.rlim_max, (rlim_t) num_idle_sockets + 64);
+			setrlimit(RLIMIT_NOFILE, &limit);
+			getrlimit(RLIMIT_NOFILE, &limit);
+			num_idle_sockets = std::min(num_idle_sockets, (int) limit.rlim_cur - 64);
+		}
+
+		std::vector<int> sockets;
+		std::vector<Event> events;
+		EventSet event_set;
+		for (int i = 0; i < num_idle_sockets; i++)
+		{
+			int handle = socket(AF_INET, SOCK_DGRAM, 0);
+			if (handle == -1)
+				fail();
+			sockets.push_back(handle);
+			events.push_back(Event(new TestEventProvider_Fd(handle)));
+			event_set.add(events.back(), i);
+		}
+
+		int active_sockets[2];
+		if (socketpair(AF_UNIX, SOCK_STREAM, 0, active_sockets) != 0)
+			fail();
+		char c = 0;
+		if (write(active_sockets[1], &c, 1) != 1)
+			fail();
+		Event active_event(new TestEventProvider_Fd(active_sockets[0]));
+		events.push_back(active_event);
+		event_set.add(active_event, num_idle_sockets);
+
+		ubyte64 start_time = System::get_microseconds();
+		for (int i = 0; i < num_iterations; i++)
+		{
+			if (Event::wait(events, 0) != num_idle_sockets)
+				fail();
+		}
+		ubyte64 event_wait_time = System::get_microseconds() - start_time;
+
+		std::vector<int> flagged_ids;
+		start_time = System::get_microseconds();
+		for (int i = 0; i < num_iterations; i++)
+		{
+			if (event_set.wait(flagged_ids, 0) != 1)
+				fail();
+		}
+		ubyte64 event_set_wait_time = System::get_microseconds() - start_time;
+
+		Console::write_line(string_format("    %1 idle sockets, %2 waits: Event::wait %3 us, EventSet::wait %4 us",
+			num_idle_sockets, num_iterations, (int) event_wait_time, (int) event_set_wait_time));
+
+		event_set.clear();
+		events.clear();
+		for (size_t i = 0; i < sockets.size(); i++)
+			close(sockets[i]);
+		close(active_sockets[0]);
+		close(active_sockets[1]);
+	}
+#endif
+}
@@ -0,0 +1,200 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Mark Page
+**    (if your name is missing here, please add it)
+*/
+
+#include "test.h"
+
+namespace
+{
+	const int logger_num_threads = 16;
+
+	/// \brief Checks that the records of each thread arrive in order
+	class CheckLogger : public Logger
+	{
+	public:
+		CheckLogger() : num_records(0), num_flushes(0), num_dropped_notices(0), out_of_order(false), next_index(logger_num_threads, 0) { }
+
+		void log(const std::string &type, const std::string &text)
+		{
+			if (type == "log")
+			{
+				num_dropped_notices++;
+				return;
+			}
+
+			int thread_index = StringHelp::text_to_int(type);
+			int index = StringHelp::text_to_int(text);
+			if (index < next_index[thread_index])
+				out_of_order = true;
+			next_index[thread_index] = index + 1;
+			num_records++;
+		}
+
+		void flush()
+		{
+			num_flushes++;
+		}
+
+		int num_records;
+		int num_flushes;
+		int num_dropped_notices;
+		bool out_of_order;
+		std::vector<int> next_index;
+	};
+
+	class LogThread
+	{
+	public:
+		LogThread() : thread_index(0), num_records(0), total_latency(0), max_latency(0) { }
+
+		void start(int new_thread_index, int new_num_records)
+		{
+			thread_index = new_thread_index;
+			num_records = new_num_records;
+			thread.start(this, &LogThread::thread_main);
+		}
+
+		void join()
+		{
+			thread.join();
+		}
+
+		void thread_main()
+		{
+			std::string type = StringHelp::int_to_text(thread_index);
+			for (int i = 0; i < num_records; i++)
+			{
+				ubyte64 start_time = System::get_microseconds();
+				log_event(type, StringHelp::int_to_text(i));
+				ubyte64 latency = System::get_microseconds() - start_time;
+				total_latency += latency;
+				if (latency > max_latency)
+					max_latency = latency;
+			}
+		}
+
+		Thread thread;
+		int thread_index;
+		int num_records;
+		ubyte64 total_latency;
+		ubyte64 max_latency;
+	};
+
+	void run_log_threads(const std::string &description, int records_per_thread, bool async)
+	{
+		if (async)
+			Logger::enable_async();
+
+		std::vector<LogThread> threads(logger_num_threads);
+		ubyte64 start_time = System::get_microseconds();
+		for (int i = 0; i < logger_num_threads; i++)
+			threads[i].start(i, records_per_thread);
+		for (int i = 0; i < logger_num_threads; i++)
+			threads[i].join();
+		ubyte64 caller_time = System::get_microseconds() - start_time;
+
+		if (async)
+			Logger::disable_async();
+		ubyte64 elapsed = System::get_microseconds() - start_time;
+
+		ubyte64 total_latency = 0;
+		ubyte64 max_latency = 0;
+		for (int i = 0; i < logger_num_threads; i++)
+		{
+			total_latency += threads[i].total_latency;
+			if (threads[i].max_latency > max_latency)
+				max_latency = threads[i].max_latency;
+		}
+		int num_records = logger_num_threads * records_per_thread;
+
+		Console::write_line(string_format("    %1: %2 records/s, %3 records/s until written, latency %4 ns average, %5 us max",
+			description,
+			(int) (num_records * 1000000.0 / caller_time),
+			(int) (num_records * 1000000.0 / elapsed),
+			(int) (total_latency * 1000 / num_records),
+			(int) max_latency));
+	}
+}
+
+void TestApp::test_logger()
+{
+	Console::write_line(" Header: logger.h");
+	Console::write_line("  Class: Logger");
+
+	Console::write_line("   Function: void log_event(const std::string &type, const std::string &text)");
+	{
+		CheckLogger logger;
+		for (int i = 0; i < 10; i++)
+			log_event("0", StringHelp::int_to_text(i));
+		if (logger.num_records != 10 || logger.out_of_order)
+			fail();
+	}
+
+	Console::write_line("   Function: static void enable_async(OverflowPolicy policy, int queue_size)");
+	{
+		CheckLogger logger;
+		Logger::enable_async(Logger::overflow_block, 64);
+		std::vector<LogThread> threads(logger_num_threads);
+		for (int i = 0; i < logger_num_threads; i++)
+			threads[i].start(i, 1000);
+		for (int i = 0; i < logger_num_threads; i++)
+			threads[i].join();
+		Logger::disable_async();
+
+		if (logger.num_records != logger_num_threads * 1000 || logger.out_of_order || logger.num_flushes == 0)
+			fail();
+	}
+
+	Console::write_line("   Function: static void enable_async(overflow_drop)");
+	{
+		CheckLogger logger;
+		Logger::enable_async(Logger::overflow_drop, 16);
+		std::vector<LogThread> threads(logger_num_threads);
+		for (int i = 0; i < logger_num_threads; i++)
+			threads[i].start(i, 1000);
+		for (int i = 0; i < logger_num_threads; i++)
+			threads[i].join();
+		Logger::disable_async();
+
+		if (logger.num_records > logger_num_threads * 1000 || logger.out_of_order)
+			fail();
+		if (logger.num_records < logger_num_threads * 1000 && logger.num_dropped_notices == 0)
+			fail();
+	}
+
+	Console::write_line("   Benchmark: 16 threads logging to a FileLogger");
+	{
+		std::string filename = "test_logger.log";
+		{
+			FileLogger logger(filename);
+			run_log_threads("synchronous", 10000, false);
+			run_log_threads("asynchronous", 10000, true);
+		}
+		FileHelp::delete_file(filename);
+	}
+}
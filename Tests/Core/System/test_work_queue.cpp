@@ -0,0 +1,252 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Mark Page
+**    (if your name is missing here, please add it)
+*/
+
+#include "test.h"
+
+namespace
+{
+	InterlockedVariable work_queue_counter;
+	InterlockedVariable work_items_deleted;
+
+	void empty_task()
+	{
+	}
+
+	void count_task()
+	{
+		work_queue_counter.increment();
+	}
+
+	void slow_task()
+	{
+		System::sleep(50);
+	}
+
+	void throwing_task()
+	{
+		throw Exception("Task failed");
+	}
+
+	class CountItem : public WorkItem
+	{
+	public:
+		CountItem(int *completed) : completed(completed) { }
+		~CountItem() { work_items_deleted.increment(); }
+		void process_work() { work_queue_counter.increment(); }
+		void work_completed() { (*completed)++; }
+		int *completed;
+	};
+
+	class TaskBatch
+	{
+	public:
+		TaskBatch(WorkQueue *queue, int size) : queue(queue), size(size) { }
+
+		void run()
+		{
+			std::vector<WorkTask> tasks;
+			tasks.reserve(size);
+			for (int i = 0; i < size; i++)
+				tasks.push_back(queue->run(Callback_v0(&empty_task)));
+			for (int i = 0; i < size; i++)
+				queue->wait_for(tasks[i]);
+		}
+
+		WorkQueue *queue;
+		int size;
+	};
+}
+
+void TestApp::test_work_queue()
+{
+	Console::write_line(" Header: work_queue.h");
+	Console::write_line("  Class: WorkQueue");
+
+	WorkQueue queue(4);
+
+	Console::write_line("   Function: WorkTask run(const Callback_v0 &func)");
+	{
+		work_queue_counter.set(0);
+		std::vector<WorkTask> tasks;
+		for (int i = 0; i < 1000; i++)
+			tasks.push_back(queue.run(Callback_v0(&count_task)));
+		for (size_t i = 0; i < tasks.size(); i++)
+			queue.wait_for(tasks[i]);
+		if (work_queue_counter.get() != 1000)
+			fail();
+		if (!tasks[0].is_finished())
+			fail();
+	}
+
+	Console::write_line("   Function: WorkTask run_child(const WorkTask &parent, const Callback_v0 &func)");
+	{
+		work_queue_counter.set(0);
+		WorkTask parent = queue.run(Callback_v0(&slow_task));
+		for (int i = 0; i < 10; i++)
+			queue.run_child(parent, Callback_v0(&count_task));
+		queue.wait_for(parent);
+		if (work_queue_counter.get() != 10)
+			fail();
+
+		bool exception_thrown = false;
+		try
+		{
+			queue.run_child(parent, Callback_v0(&count_task));
+		}
+		catch (Exception &)
+		{
+			exception_thrown = true;
+		}
+		if (!exception_thrown)
+			fail();
+	}
+
+	Console::write_line("   Function: WorkTask run_after(const std::vector<WorkTask> &tasks, const Callback_v0 &func)");
+	{
+		work_queue_counter.set(0);
+		std::vector<WorkTask> tasks;
+		for (int i = 0; i < 100; i++)
+			tasks.push_back(queue.run(Callback_v0(&count_task)));
+		tasks.push_back(WorkTask());
+		WorkTask join = queue.run_after(tasks, Callback_v0(&count_task));
+		WorkTask continuation = queue.run_after(join, Callback_v0(&count_task));
+		queue.wait_for(continuation);
+		if (work_queue_counter.get() != 102)
+			fail();
+		if (!join.is_finished())
+			fail();
+	}
+
+	Console::write_line("   Function: void wait_for(const WorkTask &task) (throwing task)");
+	{
+		int exceptions_caught = 0;
+		try
+		{
+			queue.wait_for(queue.run(Callback_v0(&throwing_task)));
+		}
+		catch (Exception &e)
+		{
+			if (e.message == "Task failed")
+				exceptions_caught++;
+		}
+
+		// A child's exception is rethrown when waiting for its parent
+		work_queue_counter.set(0);
+		WorkTask parent = queue.run(Callback_v0(&slow_task));
+		queue.run_child(parent, Callback_v0(&throwing_task));
+		queue.run_child(parent, Callback_v0(&count_task));
+		try
+		{
+			queue.wait_for(parent);
+		}
+		catch (Exception &)
+		{
+			exceptions_caught++;
+		}
+		if (exceptions_caught != 2 || work_queue_counter.get() != 1 || !parent.is_finished())
+			fail();
+	}
+
+	Console::write_line("   Function: static WorkQueue get_shared()");
+	{
+		work_queue_counter.set(0);
+		WorkQueue shared = WorkQueue::get_shared();
+		WorkTask task = shared.run(Callback_v0(&count_task));
+		WorkQueue::get_shared().wait_for(task);
+		if (work_queue_counter.get() != 1)
+			fail();
+		if (WorkQueue::get_shared().get_num_threads() != shared.get_num_threads())
+			fail();
+	}
+
+	Console::write_line("   Function: void queue(WorkItem *item)");
+	{
+		work_queue_counter.set(0);
+		int completed = 0;
+		for (int i = 0; i < 10; i++)
+			queue.queue(new CountItem(&completed));
+		ubyte64 start_time = System::get_time();
+		while (completed < 10 && System::get_time() - start_time < 5000)
+			KeepAlive::process(10);
+		if (completed != 10 || work_queue_counter.get() != 10)
+			fail();
+	}
+
+	Console::write_line("   Function: ~WorkQueue()");
+	{
+		// Items still queued when the queue is destroyed are deleted too
+		work_items_deleted.set(0);
+		int completed = 0;
+		{
+			WorkQueue pending_queue(1);
+			pending_queue.run(Callback_v0(&slow_task));
+			for (int i = 0; i < 10; i++)
+				pending_queue.queue(new CountItem(&completed));
+		}
+		if (work_items_deleted.get() != 10)
+			fail();
+	}
+
+	Console::write_line("   Benchmark: 1M empty tasks");
+	{
+		const int num_batches = 1000;
+		const int batch_size = 1000;
+		std::vector<TaskBatch> batches(num_batches, TaskBatch(&queue, batch_size));
+
+		ubyte64 start_time = System::get_microseconds();
+		std::vector<WorkTask> tasks;
+		for (int i = 0; i < num_batches; i++)
+			tasks.push_back(queue.run(Callback_v0(&batches[i], &TaskBatch::run)));
+		for (int i = 0; i < num_batches; i++)
+			queue.wait_for(tasks[i]);
+		ubyte64 elapsed = System::get_microseconds() - start_time;
+
+		Console::write_line(string_format("    %1 threads: %2 ms, %3 tasks/s",
+			queue.get_num_threads(), (int) (elapsed / 1000), (int) (num_batches * (double) batch_size * 1000000.0 / elapsed)));
+	}
+
+	Console::write_line("   Benchmark: fan-out/fan-in");
+	{
+		const int num_rounds = 1000;
+		const int fan_out = 64;
+
+		ubyte64 start_time = System::get_microseconds();
+		for (int round = 0; round < num_rounds; round++)
+		{
+			std::vector<WorkTask> tasks;
+			for (int i = 0; i < fan_out; i++)
+				tasks.push_back(queue.run(Callback_v0(&empty_task)));
+			queue.wait_for(queue.run_after(tasks, Callback_v0(&empty_task)));
+		}
+		ubyte64 elapsed = System::get_microseconds() - start_time;
+
+		Console::write_line(string_format("    %1 rounds of %2 tasks: %3 ms, %4 us per round",
+			num_rounds, fan_out, (int) (elapsed / 1000), (int) (elapsed / num_rounds)));
+	}
+}
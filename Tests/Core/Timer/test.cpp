@@ -65,6 +65,8 @@ int TestApp::main(const std::vector<std::string> &args)
 		Console::write_line("Directory: API/Display/Window");
 
 		test_timer();
+		test_timer_batch();
+		test_timer_benchmark();
 		
 		Console::write_line("All Tests Complete");
 		console.display_close_message();
@@ -37,6 +37,8 @@ public:
 	virtual int main(const std::vector<std::string> &args);
 private:
 	void test_timer(void);
+	void test_timer_batch(void);
+	void test_timer_benchmark(void);
 	void fail(void);
 	void funx_timer_1();
 	void funx_timer_2();
@@ -127,6 +127,139 @@ void TestApp::test_timer(void)
 	}
 	if (g_TimerValue1 != 1) fail();
 
+	Console::write_line("   Function: is_repeating() and get_timeout()");
+	timer_1.start(250, true);
+	if (!timer_1.is_repeating()) fail();
+	if (timer_1.get_timeout() != 250) fail();
+	timer_1.start(300, false);
+	if (timer_1.is_repeating()) fail();
+	if (timer_1.get_timeout() != 300) fail();
+	timer_1.stop();
+}
+
+void TestApp::test_timer_batch(void)
+{
+	Console::write_line("   Function: stop() (a group of timers)");
+
+	g_TimerValue1 = 0;
+	g_TimerValue2 = 0;
+
+	std::vector<Timer> stopped_timers(100);
+	std::vector<Timer> running_timers(10);
+	for (size_t i = 0; i < stopped_timers.size(); i++)
+	{
+		stopped_timers[i].func_expired().set(this, &TestApp::funx_timer_1);
+		stopped_timers[i].start(200 + i, false);
+	}
+	for (size_t i = 0; i < running_timers.size(); i++)
+	{
+		running_timers[i].func_expired().set(this, &TestApp::funx_timer_2);
+		running_timers[i].start(300 - i, false);
+	}
+
+	Timer::stop(stopped_timers);
+
+	clan::ubyte64 start_time = System::get_time();
+	while (System::get_time() - start_time < 500)
+		KeepAlive::process(10);
+
+	if (g_TimerValue1 != 0) fail();
+	if (g_TimerValue2 != 10) fail();
+}
+
+static const int benchmark_num_timers = 100000;
+static int benchmark_expired_count = 0;
+static std::vector<clan::ubyte64> benchmark_due_time;
+static std::vector<clan::ubyte64> benchmark_expired_time;
+static clan::ubyte64 benchmark_wakeup_time = 0;
+
+static void benchmark_expired(int index)
+{
+	benchmark_expired_time[index] = System::get_microseconds();
+	if (benchmark_wakeup_time == 0)
+		benchmark_wakeup_time = benchmark_expired_time[index];
+	benchmark_expired_count++;
+}
+
+void TestApp::test_timer_benchmark(void)
+{
+	Console::write_line("   Benchmark: 100000 timers");
+
+	benchmark_expired_count = 0;
+	benchmark_due_time.assign(benchmark_num_timers, 0);
+	benchmark_expired_time.assign(benchmark_num_timers, 0);
+
+	std::vector<Timer> timers(benchmark_num_timers);
+	for (int i = 0; i < benchmark_num_timers; i++)
+		timers[i].func_expired().set(&benchmark_expired, i);
+
+	// Spread the timers over one second
+	clan::ubyte64 start_time = System::get_microseconds();
+	for (int i = 0; i < benchmark_num_timers; i++)
+	{
+		unsigned int timeout = 200 + (i * 7919) % 1000;
+		benchmark_due_time[i] = System::get_microseconds() + timeout * 1000;
+		timers[i].start(timeout, false);
+	}
+	clan::ubyte64 start_cost = System::get_microseconds() - start_time;
+
+	clan::ubyte64 process_cost = 0;
+	int num_wakeups = 0;
+	clan::ubyte64 loop_start = System::get_microseconds();
+	while (benchmark_expired_count < benchmark_num_timers)
+	{
+		if (System::get_microseconds() - loop_start > 10000000)
+			fail();
+
+		// Measured from the first callback of a wakeup until KeepAlive::process returns
+		benchmark_wakeup_time = 0;
+		KeepAlive::process(10);
+		if (benchmark_wakeup_time != 0)
+		{
+			process_cost += System::get_microseconds() - benchmark_wakeup_time;
+			num_wakeups++;
+		}
+	}
+
+	clan::ubyte64 total_late = 0;
+	clan::ubyte64 max_late = 0;
+	for (int i = 0; i < benchmark_num_timers; i++)
+	{
+		// Timers are allowed to trigger up to 1 ms early
+		clan::ubyte64 late = benchmark_expired_time[i] + 1000 > benchmark_due_time[i] ? benchmark_expired_time[i] + 1000 - benchmark_due_time[i] : 0;
+		total_late += late;
+		if (late > max_late)
+			max_late = late;
+	}
+
+	Console::write_line("    start: %1 ns per timer", (int)(start_cost * 1000 / benchmark_num_timers));
+	Console::write_line("    expire: %1 wakeups, %2 ns per timer", num_wakeups, (int)(process_cost * 1000 / benchmark_num_timers));
+	Console::write_line("    jitter: %1 us average, %2 us max", (int)(total_late / benchmark_num_timers), (int)max_late);
+
+	// Pushing running timers further out, as an idle timeout does
+	for (int i = 0; i < benchmark_num_timers; i++)
+		timers[i].start(60000 + i % 1000, false);
+	start_time = System::get_microseconds();
+	for (int pass = 0; pass < 10; pass++)
+	{
+		for (int i = 0; i < benchmark_num_timers; i++)
+			timers[i].start(61000 + pass * 1000 + i % 1000, false);
+	}
+	clan::ubyte64 rearm_cost = System::get_microseconds() - start_time;
+	Console::write_line("    re-arm: %1 ns per timer", (int)(rearm_cost * 100 / benchmark_num_timers));
+
+	start_time = System::get_microseconds();
+	for (int i = 0; i < benchmark_num_timers / 2; i++)
+		timers[i].stop();
+	clan::ubyte64 stop_cost = System::get_microseconds() - start_time;
+
+	start_time = System::get_microseconds();
+	Timer::stop(timers);
+	clan::ubyte64 batch_stop_cost = System::get_microseconds() - start_time;
+
+	Console::write_line("    stop: %1 ns per timer, %2 ns per timer in a group", (int)(stop_cost * 2000 / benchmark_num_timers), (int)(batch_stop_cost * 2000 / benchmark_num_timers));
+	if (benchmark_expired_count != benchmark_num_timers)
+		fail();
 }
 
 void TestApp::funx_timer_1()
@@ -25,10 +25,73 @@ void TestXMLFile(const std::string &filename)
 	Console::write_line("");
 }
 
+void TestXMLLoad()
+{
+	Console::write_line("Load test");
+
+	std::string xml =
+		"<root xmlns=\"urn:default\" xmlns:a=\"urn:a\" a:x=\"1\" y=\"&lt;2&gt;\">"
+		"<a:child a:k=\"v\">text &quot;q&quot; &amp; more</a:child>"
+		"<![CDATA[raw &amp;]]><!-- note --><empty/>"
+		"</root>";
+	DataBuffer buffer(xml.data(), xml.length());
+	IODevice_Memory input(buffer);
+
+	DomDocument document;
+	std::vector<DomNode> nodes = document.load(input);
+
+	DomElement root = document.get_document_element();
+	DomElement child = root.get_first_child().to_element();
+	bool passed =
+		nodes.size() == 1 &&
+		root.get_namespace_uri() == "urn:default" &&
+		root.get_attribute_ns("urn:a", "x") == "1" &&
+		root.get_attribute("y") == "<2>" &&
+		child.get_local_name() == "child" &&
+		child.get_namespace_uri() == "urn:a" &&
+		child.get_attribute_ns("urn:a", "k") == "v" &&
+		child.get_text() == "text \"q\" & more" &&
+		child.get_next_sibling().get_node_value() == "raw &amp;" &&
+		child.get_next_sibling().get_next_sibling().get_node_value() == "note" &&
+		root.get_last_child().get_namespace_uri() == "urn:default";
+
+	Console::write_line(passed ? "Passed" : "Failed");
+	Console::write_line("");
+}
+
+void TestXMLLoadPerformance()
+{
+	Console::write_line("Load performance test");
+
+	std::string xml = "<catalog xmlns=\"urn:catalog\">";
+	for (int i = 0; xml.length() < 20 * 1024 * 1024; i++)
+	{
+		xml += string_format(
+			"<item id=\"%1\" category=\"cat%2\"><name>Item number %1</name><description>Text for item %1 with &amp; an entity</description></item>\n",
+			i, i % 50);
+	}
+	xml += "</catalog>";
+
+	DataBuffer buffer(xml.data(), xml.length());
+	IODevice_Memory input(buffer);
+
+	ubyte64 start_time = System::get_microseconds();
+	DomDocument document;
+	document.load(input);
+	ubyte64 end_time = System::get_microseconds();
+
+	int time_ms = (int) ((end_time - start_time) / 1000);
+	Console::write_line("Loaded %1 MB in %2 ms", (int) (xml.length() / (1024 * 1024)), time_ms);
+	Console::write_line("");
+}
+
 int main(int, char**)
 {
 	SetupCore setup_core;
 
+	TestXMLLoad();
+	TestXMLLoadPerformance();
+
 	TestXMLFile("test-emeditor-utf8-iso-8859-1.xml");
 	TestXMLFile("test-emeditor-utf8-withoutsignature.xml");
 	TestXMLFile("test-emeditor-utf8-withsignature.xml");
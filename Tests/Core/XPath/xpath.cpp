@@ -39,60 +39,256 @@ void evaluate(const std::string &xpath, const DomDocument &document)
 	Console::write_line("");
 }
 
+void benchmark(const std::string &filename)
+{
+	File file(filename, File::open_existing, File::access_read);
+	DomDocument document;
+	document.load(file);
+
+	static const char *expressions[] =
+	{
+		"/root/child/childchild",
+		"child::root/child::child[@foo]/child::childchild",
+		"child::root/child::child[child::foobar]/child::childchild",
+		"root//childchild",
+		"root/child[@foo=\"barism\"]/childchild",
+		"root/child[childchild=\"Test6\"]/foobar",
+		"root/child[@age>27]/foobar",
+		"root/child[last()-3]/foobar",
+		"count(root/child[position() mod 2 = 0])",
+		"count(root/child::*[local-name()='child'])",
+		"root/*[local-name()='child' and (@age=10 or namespace-uri()='fisk')]/foobar",
+		"root/child[last()]/foobar | root/child[not(@foo) and not(@age)]/foobar",
+		"sum(root/child[@type='numbers']/number)",
+		"(root/*[local-name()='child'])[1]",
+		"//childchild[1]",
+		"//child/attribute::type",
+		0
+	};
+	const int iterations = 2000;
+
+	XPathEvaluator evaluator;
+	ubyte64 start_time = System::get_microseconds();
+	for (int i = 0; i < iterations; i++)
+	{
+		for (int j = 0; expressions[j]; j++)
+			evaluator.evaluate(expressions[j], document);
+	}
+	ubyte64 end_time = System::get_microseconds();
+	Console::write_line("%1: XPathEvaluator %2 ms", filename, (int) ((end_time - start_time) / 1000));
+
+	std::vector<XPathExpression> compiled_expressions;
+	for (int j = 0; expressions[j]; j++)
+		compiled_expressions.push_back(XPathExpression(expressions[j]));
+
+	start_time = System::get_microseconds();
+	for (int i = 0; i < iterations; i++)
+	{
+		for (std::vector<XPathExpression>::size_type j = 0; j < compiled_expressions.size(); j++)
+			compiled_expressions[j].evaluate(document);
+	}
+	end_time = System::get_microseconds();
+	Console::write_line("%1: XPathExpression %2 ms", filename, (int) ((end_time - start_time) / 1000));
+	Console::write_line("");
+}
+
+void check_count(const std::string &xpath, const DomNode &context, int expected_count)
+{
+	int count = (int) XPathEvaluator().evaluate(xpath, context).get_node_set().size();
+	if (count != expected_count)
+		throw Exception(string_format("'%1' returned %2 nodes, expected %3", xpath, count, expected_count));
+}
+
+std::string node_text(const DomNode &node)
+{
+	return node.is_element() ? node.to_element().get_text() : node.get_node_value();
+}
+
+// Compares the node-set text, with the nodes separated by '|'
+void check_nodes(const std::string &xpath, const DomNode &context, const std::string &expected)
+{
+	std::vector<DomNode> nodes = XPathEvaluator().evaluate(xpath, context).get_node_set();
+	std::string text;
+	for (std::vector<DomNode>::size_type i = 0; i < nodes.size(); i++)
+		text += (i > 0 ? "|" : "") + node_text(nodes[i]);
+	if (text != expected)
+		throw Exception(string_format("'%1' returned '%2', expected '%3'", xpath, text, expected));
+}
+
+void check_string(const std::string &xpath, const DomNode &context, const std::string &expected)
+{
+	XPathObject result = XPathEvaluator().evaluate(xpath, context);
+	if (result.get_type() != XPathObject::type_string || result.get_string() != expected)
+		throw Exception(string_format("'%1' did not return the string '%2'", xpath, expected));
+}
+
+void check_number(const std::string &xpath, const DomNode &context, double expected)
+{
+	XPathObject result = XPathEvaluator().evaluate(xpath, context);
+	if (result.get_type() != XPathObject::type_number || result.get_number() != expected)
+		throw Exception(string_format("'%1' did not return the number %2", xpath, expected));
+}
+
+void check_throws(const std::string &xpath, const DomNode &context)
+{
+	bool exception_thrown = false;
+	try
+	{
+		XPathEvaluator().evaluate(xpath, context);
+	}
+	catch (Exception &)
+	{
+		exception_thrown = true;
+	}
+	if (!exception_thrown)
+		throw Exception(string_format("'%1' did not throw", xpath));
+}
+
+void test_expressions(DomDocument &document)
+{
+	const std::string all_childchild = "Test|Test2|Test3|Test4|Test5|Test4.1|Test5.1|Test6|Test7|Test6.1|Test7.1|Test6.2|Test7.2";
+
+	check_nodes("/root/child/childchild", document, all_childchild);
+	check_nodes("/child::root/child::child/child::childchild", document, all_childchild);
+	check_nodes("child::root/child::child/child::childchild", document, all_childchild);
+	check_nodes("child::root/child::child[@foo]/child::childchild", document, "Test4|Test5|Test4.1|Test5.1");
+	check_nodes("child::root/child::child[child::foobar]/child::childchild", document, "Test6|Test7|Test6.1|Test7.1|Test6.2|Test7.2");
+	check_nodes("child::root/child::child[2]/child::childchild", document, "Test4|Test5");
+	check_nodes("root//childchild", document, all_childchild);
+	check_nodes("root/child[@foo]/childchild", document, "Test4|Test5|Test4.1|Test5.1");
+	check_nodes("root/child[@foo=\"barism\"]/childchild", document, "Test4.1|Test5.1");
+	check_nodes("root/child[childchild=\"Test6\"]/foobar", document, "Muh!");
+	check_nodes("root/child[@age!=10]/foobar", document, "Age over 27");
+	check_nodes("root/child[@age>27]/foobar", document, "Age over 27");
+	check_nodes("root/child[last()-3]/foobar", document, "Age under 27");
+	check_nodes("root/child[1]/childchild[2]", document, "Test2");
+	check_nodes("root/*[local-name()='child' and (@age=10 or namespace-uri()='fisk')]/foobar", document, "Age under 27|To foobar!!");
+	check_nodes("root/child[last()]/foobar", document, "");
+	check_nodes("root/child[not(@foo) and not(@age)]/foobar", document, "Muh!");
+	check_nodes("root/child[last()]/foobar | root/child[not(@foo) and not(@age)]/foobar", document, "Muh!");
+	check_nodes("root/*[local-name()='child'][last()]/foobar | root/child[not(@foo) and not(@age)]/foobar", document, "Muh!");
+	check_nodes("/root/child[1]/childchild[1]/text()", document, "Test");
+	check_nodes("(root/*[local-name()='child'])[1]", document, "NS Child");
+	check_nodes("root/*[local-name()='child'][1]", document, "NS Child");
+	check_nodes("//childchild[1]", document, "Test|Test4|Test4.1|Test6|Test6.1|Test6.2");
+	check_nodes("//child/attribute::type", document, "numbers");
+	check_nodes("root/child[7]/following::*", document, "child id Test");
+	check_nodes("root/com:child/foobar", document, "To foobar!!");
+	check_nodes("id(/root/child[1]/childchild[1])", document, "child id Test");
+	check_count("root/child[1]/childchild[2]/preceding::*", document, 4);
+
+	check_number("6 mod 4", document, 2);
+	check_number("count(root/child[position() mod 2 = 0])", document, 4);
+	check_number("count(root/child::*[local-name()='child'])", document, 10);
+	check_number("sum(root/child[@type='numbers']/number)", document, 45);
+	check_number("string-length(root/*[local-name()='child'][position()=last()-2]/foobar)", document, 11);
+
+	check_string("translate('bare', 'abr', 'AB')", document, "BAe");
+	check_string("substring-before('1999/04/01','/')", document, "1999");
+	check_string("substring-after('1999/04/01','/')", document, "04/01");
+	check_string("substring('12345', 2)", document, "2345");
+	check_string("substring('12345', 2, 3)", document, "234");
+	check_string("normalize-space('\tchild    \tname\n  \t  thingie\n')", document, "child name thingie");
+	check_string("namespace-uri(root/*[local-name()='child'][1])", document, "fisk");
+	check_string("namespace-uri(root/com:child)", document, "fisk");
+	check_string("local-name(root/com:child)", document, "child");
+	check_string("local-name(/root/child[1])", document, "child");
+
+	DomElement root = document.get_document_element();
+	DomNode first_child = XPathEvaluator().evaluate("root/child[1]", document).get_node_set()[0];
+	DomNode second_child = XPathEvaluator().evaluate("root/child[2]", document).get_node_set()[0];
+
+	// 'a//b' is relative to the context node, not '//b' from the document root
+	check_nodes("self::*//childchild", second_child, "Test4|Test5");
+	check_nodes("child//childchild", root, all_childchild);
+
+	// following-sibling axis
+	check_nodes("following-sibling::child[1]/childchild", first_child, "Test4|Test5");
+	check_number("count(root/dummy/following-sibling::*)", document, 10);
+
+	// descendant-or-self stays within the subtree of the context node
+	check_nodes("descendant-or-self::childchild", first_child, "Test|Test2|Test3");
+	check_count("descendant-or-self::*", second_child, 3);
+
+	// Filters accept several predicates, and later steps apply to every filtered node
+	check_nodes("(root/child)[@foo][2]/childchild", document, "Test4.1|Test5.1");
+	check_nodes("(root/child[@foo])/childchild", document, "Test4|Test5|Test4.1|Test5.1");
+
+	check_throws("1 | root", document);
+
+	Console::write_line("Expression tests passed");
+	Console::write_line("");
+}
+
+void test_mutations()
+{
+	std::string xml = "<r><a/><b><a/></b></r>";
+	DataBuffer data(xml.data(), xml.length());
+	IODevice_Memory device(data);
+	DomDocument document;
+	document.load(device);
+
+	DomElement root = document.get_document_element();
+	check_count("//a", document, 2);
+
+	DomElement c = document.create_element("a");
+	root.append_child(c);
+	check_count("//a", document, 3);
+
+	DomElement x = document.create_element("x");
+	DomNode last_child = root.get_last_child();
+	root.replace_child(x, last_child);
+	check_count("//a", document, 2);
+	check_count("/r/*", document, 3);
+	check_count("/r/x/preceding-sibling::*", document, 2);
+
+	DomNode b = root.named_item("b");
+	root.remove_child(b);
+	check_count("//a", document, 1);
+	check_count("/r/a/following-sibling::x", document, 1);
+
+	DomElement d = document.create_element("a");
+	root.insert_before(d, x);
+	check_count("//a", document, 2);
+	check_count("/r/a[2]/following-sibling::*", document, 1);
+
+	// Storage outgrown by one value is handed to the next value that fits
+	DomText first = document.create_text_node("first");
+	DomText second = document.create_text_node("");
+	x.append_child(first);
+	x.append_child(second);
+	std::string first_value = "first";
+	for (int i = 0; i < 100; i++)
+	{
+		first_value += "+";
+		first.set_node_value(first_value);
+		second.set_node_value(std::string(i, 'x'));
+		if (second.get_node_value() != std::string(i, 'x'))
+			throw Exception("Second text value was not stored correctly");
+	}
+	if (first.get_node_value() != first_value)
+		throw Exception("Released value storage overwrote a live value");
+	check_count("/r/x[string-length(text()[1]) = 105]", document, 1);
+
+	Console::write_line("Mutation tests passed");
+	Console::write_line("");
+}
+
 int main(int, char**)
 {
 	SetupCore setup_core;
 	try
 	{
+		test_mutations();
+		benchmark("test.xml");
+		benchmark("test2.xml");
+
 		File file("test.xml", File::open_existing, File::access_read);
-// 		File file("test2.xml", File::open_existing, File::access_read);
 		DomDocument document;
 		document.load(file);
 
-// 		evaluate("root/child/child[2]/following::*", document);
-// 		evaluate("root/child/child[2]/childchild[2]/preceding::*", document);
+		test_expressions(document);
 		evaluate("//child/attribute::type", document);
-
-// 		evaluate("6 mod 4", document);
-// 		evaluate("/root/child/childchild", document);
-// 		evaluate("/child::root/child::child/child::childchild", document);
-// 		evaluate("child::root/child::child/child::childchild", document);
-// 		evaluate("child::root/child::child[@foo]/child::childchild", document);
-// 		evaluate("child::root/child::child[child::foobar]/child::childchild", document);
-// 		evaluate("child::root/child::child[2]/child::childchild", document);
-// 		evaluate("root//childchild", document);
-// 		evaluate("root/child[@foo]/childchild", document);
-// 		evaluate("root/child[@foo=\"barism\"]/childchild", document);
-// 		evaluate("root/child[childchild=\"Test6\"]/foobar", document);
-// 		evaluate("root/child[@age!=10]/foobar", document);
-// 		evaluate("root/child[@age>27]/foobar", document);
-// 		evaluate("root/com:child/foobar", document);
-// 		evaluate("root/child[last()-3]/foobar", document);
-// 		evaluate("root/child[1]/childchild[2]", document);
-// 		evaluate("translate('bare', 'abr', 'AB')", document);
-// 		evaluate("substring-before('1999/04/01','/')", document);
-// 		evaluate("substring-after('1999/04/01','/')", document);
-// 		evaluate("substring('12345', 2)", document);
-// 		evaluate("substring('12345', 2, 3)", document);
-// 		evaluate("count(root/child[position() mod 2 = 0])", document);
-// 		evaluate("namespace-uri(root/com:child)", document);
-// 		evaluate("local-name(root/com:child)", document);
-// 		evaluate("count(root/child::*[local-name()='child'])", document);
-// 		evaluate("normalize-space('\tchild    \tname\n  \t  thingie\n')", document);
-// 		evaluate("string-length(root/*[local-name()='child'][position()=last()-2]/foobar)", document);
-// 		evaluate("root/*[local-name()='child' and (@age=10 or namespace-uri()='fisk')]/foobar", document);
-// 		evaluate("root/child[last()]/foobar", document);
-// 		evaluate("root/child[not(@foo) and not(@age)]/foobar", document);
-// 		evaluate("root/child[last()]/foobar | root/child[not(@foo) and not(@age)]/foobar", document);
-// 		evaluate("root/*[local-name()='child'][last()]/foobar | root/child[not(@foo) and not(@age)]/foobar", document);
-// 		evaluate("sum(root/child[@type='numbers']/number)", document);
-// 		evaluate("/root/child[1]/childchild[1]/text()", document);
-// 		evaluate("(root/*[local-name()='child'])[1]", document);
-// 		evaluate("root/*[local-name()='child'][1]", document);
-// 		evaluate("namespace-uri(root/*[local-name()='child'][1])", document);
-// 		evaluate("local-name(/root/child[1])", document);
-// 		evaluate("id(/root/child[1]/childchild[1])", document);
-// 		evaluate("//childchild[1]", document);
 	}
 	catch(Exception &error)
 	{
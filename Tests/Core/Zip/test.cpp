@@ -27,6 +27,10 @@
 */
 
 #include "test.h"
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 // This is the Program class that is called by Application
 class Program
@@ -54,6 +58,7 @@ int TestApp::main(const std::vector<std::string> &args)
 	try
 	{
 		run_test();
+		run_benchmark();
 		console.display_close_message();
 	}
 	catch(Exception error)
@@ -99,3 +104,120 @@ void TestApp::run_test()
 		Console::write_line("Contents: %1", StringHelp::utf8_to_text(str8));
 	}
 }
+
+// Contents of a file in the benchmark archive
+std::string benchmark_file_contents(int index)
+{
+	std::string contents = string_format("Asset %1\n", index);
+	while (contents.size() < 1024 + index % 1024)
+		contents += string_format("%1 %2 %3\n", index, contents.size(), index * contents.size());
+	return contents;
+}
+
+// Evicts a file from the OS file cache, so the next open reads it from disk
+void drop_file_cache(const std::string &filename)
+{
+#ifdef __linux__
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd != -1)
+	{
+		fdatasync(fd);
+		posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+		close(fd);
+	}
+#endif
+}
+
+void TestApp::run_benchmark()
+{
+	const int num_files = 50000;
+	const std::string filename = "ZipBenchmark.zip";
+
+	Console::write_line("");
+	Console::write_line("Creating %1 with %2 files, every other file compressed", filename, num_files);
+
+	std::vector<std::string> filenames;
+	File file(filename, File::create_always, File::access_write);
+	ZipWriter zip_writer(file);
+	for (int i = 0; i < num_files; i++)
+	{
+		filenames.push_back(string_format("Assets/%1/asset%2.txt", i / 1000, i));
+		std::string contents = benchmark_file_contents(i);
+		zip_writer.begin_file(filenames.back(), i % 2 == 1);
+		zip_writer.write_file_data(contents.data(), contents.size());
+		zip_writer.end_file();
+	}
+	zip_writer.write_toc();
+	file.close();
+
+	// The archive is large, so it is deleted again even if a check fails
+	try
+	{
+		benchmark_archives(filename, filenames);
+	}
+	catch (...)
+	{
+		FileHelp::delete_file(filename);
+		throw;
+	}
+	FileHelp::delete_file(filename);
+}
+
+void TestApp::benchmark_archives(const std::string &filename, const std::vector<std::string> &filenames)
+{
+	WorkQueue work_queue;
+
+	Console::write_line("Cold start (archive not in the file cache):");
+	drop_file_cache(filename);
+	benchmark_archive(filename, filenames, false, work_queue);
+	drop_file_cache(filename);
+	benchmark_archive(filename, filenames, true, work_queue);
+
+	Console::write_line("Warm start:");
+	benchmark_archive(filename, filenames, false, work_queue);
+	benchmark_archive(filename, filenames, true, work_queue);
+
+	// Stored files are views into the mapped archive
+	ZipArchive archive(filename, true);
+	const void *data = 0;
+	int size = 0;
+	if (!archive.get_file_view(filenames[0], data, size) || std::string((const char *) data, size) != benchmark_file_contents(0))
+		throw Exception("get_file_view failed");
+	if (archive.get_file_view(filenames[1], data, size))
+		throw Exception("get_file_view returned a compressed file");
+}
+
+void TestApp::benchmark_archive(const std::string &filename, const std::vector<std::string> &filenames, bool memory_map, WorkQueue &work_queue)
+{
+	ubyte64 start_time = System::get_microseconds();
+	ZipArchive archive(filename, memory_map);
+	ubyte64 open_time = System::get_microseconds();
+
+	ubyte64 total_size = 0;
+	DataBuffer buffer(64*1024);
+	for (size_t i = 0; i < filenames.size(); i++)
+	{
+		IODevice device = archive.open_file(filenames[i]);
+		int size = device.read(buffer.get_data(), buffer.get_size());
+		total_size += size;
+		if (i % 997 == 0 && std::string(buffer.get_data(), size) != benchmark_file_contents(i))
+			throw Exception(string_format("open_file returned the wrong contents for %1", filenames[i]));
+	}
+	ubyte64 open_file_time = System::get_microseconds();
+
+	std::vector<DataBuffer> files = archive.load_files(filenames, work_queue);
+	ubyte64 load_files_time = System::get_microseconds();
+
+	for (size_t i = 0; i < files.size(); i++)
+	{
+		if (i % 997 == 0 && std::string(files[i].get_data(), files[i].get_size()) != benchmark_file_contents(i))
+			throw Exception(string_format("load_files returned the wrong contents for %1", filenames[i]));
+	}
+
+	Console::write_line(" %1: open %2 ms, open_file on every file %3 ms, load_files %4 ms (%5 MB)",
+		memory_map ? "Memory mapped" : "Streamed",
+		(int) ((open_time - start_time) / 1000),
+		(int) ((open_file_time - open_time) / 1000),
+		(int) ((load_files_time - open_file_time) / 1000),
+		(int) (total_size / (1024 * 1024)));
+}
@@ -40,6 +40,11 @@ public:
 
 private:
 	void run_test();
+
+	void run_benchmark();
+
+	void benchmark_archives(const std::string &filename, const std::vector<std::string> &filenames);
+	void benchmark_archive(const std::string &filename, const std::vector<std::string> &filenames, bool memory_map, WorkQueue &work_queue);
 };
 
 #endif
@@ -2,6 +2,7 @@
 #include <ClanLib/application.h>
 #include <ClanLib/display.h>
 #include <ClanLib/gl.h>
+#include <algorithm>
 using namespace clan;
 
 // This is the Application class (That is instantiated by the Program Class)
@@ -13,6 +14,7 @@ public:
 private:
 	void on_input_up(const InputEvent &key);
 	void on_window_close();
+	void run_benchmark(DisplayWindow &window, Canvas &canvas);
 
 private:
 	bool quit;
@@ -59,6 +61,13 @@ int App::start(const std::vector<std::string> &args)
 	// Create the canvas
 	Canvas canvas(window);
 
+	// Run with "benchmark" as argument to measure draw_text throughput with a large glyph set
+	if (std::find(args.begin(), args.end(), "benchmark") != args.end())
+	{
+		run_benchmark(window, canvas);
+		return 0;
+	}
+
 	// Load some fonts from the resource file
 	ResourceManager resources = clan::XMLResourceManager::create(clan::XMLResourceDocument("font.xml"));
 	Font font1 = Font::resource(canvas, FontDescription("Font1"), resources);
@@ -86,6 +95,63 @@ int App::start(const std::vector<std::string> &args)
 	return 0;
 }
 
+void App::run_benchmark(DisplayWindow &window, Canvas &canvas)
+{
+	const unsigned int first_glyph = 0x4E00;	// CJK Unified Ideographs
+	const unsigned int num_glyphs = 10000;
+	const int glyphs_per_line = 100;
+	const int num_frames = 100;
+
+	// Build lines of text covering every glyph in the range
+	std::vector<std::string> lines;
+	for (unsigned int line_start = 0; line_start < num_glyphs; line_start += glyphs_per_line)
+	{
+		std::string line;
+		for (unsigned int glyph = line_start; glyph < line_start + glyphs_per_line && glyph < num_glyphs; glyph++)
+		{
+			line += StringHelp::unicode_to_utf8(first_glyph + glyph);
+		}
+		lines.push_back(line);
+	}
+
+	FontDescription desc;
+	desc.set_typeface_name("Sans");
+	desc.set_height(16);
+
+	// Glyphs inserted on demand while drawing
+	Font font_on_demand(canvas, desc);
+	ubyte64 start_time = System::get_microseconds();
+	for (std::vector<std::string>::size_type i = 0; i < lines.size(); i++)
+		font_on_demand.draw_text(canvas, 0, 16, lines[i]);
+	canvas.flush();
+	ubyte64 on_demand_time = System::get_microseconds() - start_time;
+
+	// Glyphs inserted in one batch
+	Font font_prewarmed(canvas, desc);
+	start_time = System::get_microseconds();
+	font_prewarmed.prewarm(canvas, first_glyph, first_glyph + num_glyphs - 1);
+	ubyte64 prewarm_time = System::get_microseconds() - start_time;
+
+	// Steady state throughput with every glyph in the cache
+	start_time = System::get_microseconds();
+	for (int frame = 0; frame < num_frames; frame++)
+	{
+		canvas.clear(Colorf::black);
+		for (std::vector<std::string>::size_type i = 0; i < lines.size(); i++)
+			font_prewarmed.draw_text(canvas, 0, 16 + (i % 30) * 16, lines[i]);
+		window.flip(0);
+		KeepAlive::process();
+	}
+	ubyte64 draw_time = System::get_microseconds() - start_time;
+
+	double glyphs_per_second = (double) num_glyphs * num_frames / (draw_time / 1000000.0);
+
+	Console::write_line("Glyph cache benchmark (%1 distinct glyphs):", (int) num_glyphs);
+	Console::write_line("  First draw (insert on demand): %1 ms", (int) (on_demand_time / 1000));
+	Console::write_line("  Prewarm: %1 ms", (int) (prewarm_time / 1000));
+	Console::write_line("  draw_text: %1 ms per frame, %2 glyphs/second", (int) (draw_time / 1000 / num_frames), (int) glyphs_per_second);
+}
+
 // A key was pressed
 void App::on_input_up(const InputEvent &key)
 {
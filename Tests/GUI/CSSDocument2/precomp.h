@@ -2,7 +2,9 @@
 #pragma once
 
 #include <vector>
+#include <algorithm>
 #include <ClanLib/core.h>
 #include <ClanLib/display.h>
 #include <ClanLib/gl.h>
 #include <ClanLib/gui.h>
+#include <ClanLib/csslayout.h>
@@ -11,6 +11,14 @@ Application clanapp(&Program::main);
 int Program::main(const std::vector<std::string> &args)
 {
 	SetupCore setup_core;
+
+	// Run with "benchmark" as argument to measure style resolution on a large generated document
+	if (std::find(args.begin(), args.end(), "benchmark") != args.end())
+	{
+		style_benchmark();
+		return 0;
+	}
+
 	SetupDisplay setup_display;
 	SetupGL setup_gl;
 	SetupGUI setup_gui;
@@ -279,6 +287,67 @@ void Program::create_imageview_test(GUIComponent *root)
 	image_view_fixedwidth_fixedheight_scaletofit->set_class("fixedwidth fixedheight odd", true);
 }
 
+void Program::style_benchmark()
+{
+	const int num_rules = 4000;
+	const int num_rows = 5000;
+	const int num_iterations = 5;
+
+	// Generate a theme with a mix of id, class, tag and descendant selectors
+	std::string css;
+	for (int i = 0; i < num_rules; i++)
+	{
+		switch (i % 4)
+		{
+		case 0: css += string_format("#item%1 { width: %2px }\n", i, i % 100); break;
+		case 1: css += string_format(".class%1 { height: %2px }\n", i % 500, i % 100); break;
+		case 2: css += string_format("list .class%1 label { margin-left: %2px }\n", i % 500, i % 100); break;
+		case 3: css += string_format("row%1 > label.class%2 { margin-top: %3px }\n", i % 50, i % 500, i % 100); break;
+		}
+	}
+
+	// Generate a list document, similar to a long ListView
+	std::string xml = "<list>";
+	for (int i = 0; i < num_rows; i++)
+	{
+		xml += string_format("<row class=\"class%1\" id=\"item%2\"><label class=\"class%3\">Row</label><label>Column</label></row>", i % 500, i, (i + 1) % 500);
+	}
+	xml += "</list>";
+
+	DataBuffer css_data(css.data(), css.length());
+	IODevice_Memory css_device(css_data);
+	CSSDocument document;
+	document.add_sheet(author_sheet_origin, css_device, std::string());
+
+	DataBuffer xml_data(xml.data(), xml.length());
+	IODevice_Memory xml_device(xml_data);
+	DomDocument dom(xml_device);
+
+	std::vector<DomElement> elements;
+	std::vector<DomElement> stack;
+	stack.push_back(dom.get_document_element());
+	while (!stack.empty())
+	{
+		DomElement element = stack.back();
+		stack.pop_back();
+		elements.push_back(element);
+		for (DomElement child = element.get_first_child_element(); !child.is_null(); child = child.get_next_sibling_element())
+			stack.push_back(child);
+	}
+
+	size_t num_values = 0;
+	ubyte64 start_time = System::get_microseconds();
+	for (int iteration = 0; iteration < num_iterations; iteration++)
+	{
+		for (size_t i = 0; i < elements.size(); i++)
+			num_values += document.select(elements[i]).get_values().size();
+	}
+	ubyte64 total_time = System::get_microseconds() - start_time;
+
+	Console::write_line("Style resolution: %1 rules, %2 elements", num_rules, (int)elements.size());
+	Console::write_line("  %1 ms per pass, %2 us per element, %3 values matched", (int)(total_time / 1000 / num_iterations), (float)total_time / num_iterations / elements.size(), (int)(num_values / num_iterations));
+}
+
 bool Program::on_close(GUIComponent *component)
 {
 	component->exit_with_code(0);
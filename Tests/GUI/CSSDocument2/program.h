@@ -12,5 +12,7 @@ private:
 	static void create_component(clan::DomElement xml_element, clan::GUIComponent *parent);
 	static void create_imageview_test(clan::GUIComponent *root);
 
+	static void style_benchmark();
+
 	static void gui_fps(clan::DisplayWindow &window, clan::GUIWindowManagerTexture &wm, clan::GUIComponent *root);
 };
@@ -0,0 +1,232 @@
+#include <ClanLib/core.h>
+#include <ClanLib/network.h>
+#include <algorithm>
+using namespace clan;
+
+// Loopback load test for HTTPServer.
+//
+// Usage: httpserver [clients] [requests per client] [worker threads]
+//
+// Runs the same load against the thread per connection server and the event
+// loop server and reports requests/sec and p99 latency for each.
+
+class HelloHandler : public HTTPRequestHandlerProvider
+{
+public:
+	bool is_handling_request(const std::string &type, const std::string &url, const std::string &headers)
+	{
+		return url == "/hello";
+	}
+
+	void handle_request(HTTPServerConnection &connection)
+	{
+		std::string body("Hello World");
+		connection.write_response_status(200, "OK");
+		connection.write_response_headers("Content-Type: text/plain");
+		connection.write_response_data(DataBuffer(body.data(), body.length()));
+	}
+};
+
+class LoadClient
+{
+public:
+	LoadClient() : num_requests(0), keep_alive(false), pipeline_depth(1), failed(false) { }
+
+	void run();
+
+	SocketName server;
+	int num_requests;
+	bool keep_alive;
+	int pipeline_depth;
+	bool failed;
+	std::vector<ubyte64> latencies;
+
+private:
+	void read_response(TCPConnection &connection, std::string &buffer);
+};
+
+void LoadClient::run()
+{
+	try
+	{
+		std::string request;
+		if (keep_alive)
+			request = "GET /hello HTTP/1.1\r\nHost: localhost\r\n\r\n";
+		else
+			request = "GET /hello HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n";
+
+		TCPConnection connection;
+		if (keep_alive)
+		{
+			connection = TCPConnection(server);
+			connection.set_nodelay(true);
+		}
+
+		std::string buffer;
+		int requests_done = 0;
+		while (requests_done < num_requests)
+		{
+			int batch = keep_alive ? std::min(pipeline_depth, num_requests - requests_done) : 1;
+			if (!keep_alive)
+			{
+				connection = TCPConnection(server);
+				connection.set_nodelay(true);
+				buffer.clear();
+			}
+
+			std::string batch_request;
+			for (int i = 0; i < batch; i++)
+				batch_request += request;
+
+			ubyte64 start_time = System::get_microseconds();
+			connection.write(batch_request.data(), batch_request.length(), true);
+			for (int i = 0; i < batch; i++)
+			{
+				read_response(connection, buffer);
+				latencies.push_back(System::get_microseconds() - start_time);
+			}
+			requests_done += batch;
+
+			if (!keep_alive)
+				connection.disconnect_abortive();
+		}
+	}
+	catch (Exception &e)
+	{
+		Console::write_line("Client failed: %1", e.message);
+		failed = true;
+	}
+}
+
+void LoadClient::read_response(TCPConnection &connection, std::string &buffer)
+{
+	std::string::size_type header_end = std::string::npos;
+	int content_length = -1;
+	while (true)
+	{
+		if (header_end == std::string::npos)
+		{
+			header_end = buffer.find("\r\n\r\n");
+			if (header_end != std::string::npos)
+			{
+				std::string::size_type length_pos = buffer.find("Content-Length: ");
+				if (length_pos == std::string::npos || length_pos > header_end)
+					throw Exception("Response has no Content-Length");
+				content_length = StringHelp::local8_to_int(buffer.substr(length_pos + 16, buffer.find("\r\n", length_pos) - length_pos - 16));
+			}
+		}
+
+		if (header_end != std::string::npos && buffer.length() >= header_end + 4 + content_length)
+		{
+			if (buffer.compare(0, 12, "HTTP/1.1 200") != 0)
+				throw Exception("Unexpected response status");
+			buffer.erase(0, header_end + 4 + content_length);
+			return;
+		}
+
+		char data[4096];
+		if (!connection.get_read_event().wait(15000))
+			throw Exception("Response timed out");
+		int received = connection.read(data, 4096, false);
+		if (received <= 0)
+			throw Exception("Connection closed by server");
+		buffer.append(data, received);
+	}
+}
+
+void run_load(const std::string &title, int num_clients, int num_requests, bool keep_alive, int pipeline_depth)
+{
+	std::vector<LoadClient> clients(num_clients);
+	std::vector<Thread> threads(num_clients);
+
+	ubyte64 start_time = System::get_microseconds();
+	for (int i = 0; i < num_clients; i++)
+	{
+		clients[i].server = SocketName("127.0.0.1", "8123");
+		clients[i].num_requests = num_requests;
+		clients[i].keep_alive = keep_alive;
+		clients[i].pipeline_depth = pipeline_depth;
+		threads[i].start(&clients[i], &LoadClient::run);
+	}
+	for (int i = 0; i < num_clients; i++)
+		threads[i].join();
+	ubyte64 total_time = System::get_microseconds() - start_time;
+
+	std::vector<ubyte64> latencies;
+	bool failed = false;
+	for (int i = 0; i < num_clients; i++)
+	{
+		latencies.insert(latencies.end(), clients[i].latencies.begin(), clients[i].latencies.end());
+		failed = failed || clients[i].failed;
+	}
+	std::sort(latencies.begin(), latencies.end());
+
+	ubyte64 p99 = latencies.empty() ? 0 : latencies[(latencies.size() - 1) * 99 / 100];
+	double requests_per_second = latencies.size() * 1000000.0 / std::max(total_time, (ubyte64) 1);
+	Console::write_line("%1: %2 requests, %3 req/s, p99 %4 us%5",
+		title, (int) latencies.size(), (int) requests_per_second, (int) p99, failed ? " (FAILED)" : "");
+}
+
+void check_request_size_limit()
+{
+	TCPConnection connection(SocketName("127.0.0.1", "8123"));
+	std::string request = "POST /hello HTTP/1.1\r\nHost: localhost\r\nContent-Length: 1000000000\r\n\r\n";
+	connection.write(request.data(), request.length(), true);
+
+	std::string response;
+	while (response.find("\r\n") == std::string::npos)
+	{
+		char data[4096];
+		if (!connection.get_read_event().wait(15000))
+			throw Exception("Response timed out");
+		int received = connection.read(data, 4096, false);
+		if (received <= 0)
+			break;
+		response.append(data, received);
+	}
+	if (response.compare(0, 12, "HTTP/1.1 413") != 0)
+		throw Exception("Oversized request was not rejected");
+	Console::write_line("Event loop, oversized request: rejected with 413");
+}
+
+int main(int argc, char **argv)
+{
+	SetupCore setup_core;
+	SetupNetwork setup_network;
+
+	int num_clients = argc > 1 ? StringHelp::local8_to_int(argv[1]) : 16;
+	int num_requests = argc > 2 ? StringHelp::local8_to_int(argv[2]) : 500;
+	int num_workers = argc > 3 ? StringHelp::local8_to_int(argv[3]) : 4;
+
+	try
+	{
+		HTTPRequestHandler handler(new HelloHandler());
+
+		Console::write_line("%1 clients, %2 requests each", num_clients, num_requests);
+		{
+			HTTPServer server;
+			server.add_handler(handler);
+			server.bind(SocketName("8123"));
+			System::sleep(100);
+			run_load("Thread per connection", num_clients, num_requests, false, 1);
+		}
+		{
+			HTTPServer server(num_workers);
+			server.add_handler(handler);
+			server.bind(SocketName("8123"));
+			System::sleep(100);
+			run_load("Event loop, new connections", num_clients, num_requests, false, 1);
+			run_load("Event loop, keep-alive", num_clients, num_requests, true, 1);
+			run_load("Event loop, pipelined x8", num_clients, num_requests, true, 8);
+
+			server.set_max_request_size(64*1024);
+			check_request_size_limit();
+		}
+	}
+	catch (Exception &e)
+	{
+		Console::write_line(e.message);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,288 @@
+#include <ClanLib/core.h>
+#include <ClanLib/network.h>
+#include <cstdlib>
+#include <cmath>
+using namespace clan;
+
+// Headless replication simulation for NetGameReplicator.
+//
+// Usage: netgamereplication [objects] [clients] [ticks]
+//
+// Moves objects around a world replicated to loopback clients with a view circle
+// each. When the simulation stops, every client must have exactly the objects in
+// its view with the same field values as the server.
+
+enum ObjectField
+{
+	field_x,
+	field_y,
+	field_health,
+	field_name,
+	num_object_fields
+};
+
+class SimulationClient
+{
+public:
+	SimulationClient() : connected(false) { }
+
+	void on_connected() { connected = true; }
+	void on_event_received(const NetGameEvent &e) { replica.process_event(e, client); }
+
+	NetGameClient client;
+	NetGameReplica replica;
+	SlotContainer slots;
+	bool connected;
+};
+
+class Simulation
+{
+public:
+	Simulation(int num_objects, int num_clients, int num_ticks);
+
+	bool run();
+
+private:
+	void on_client_connected(NetGameConnection *connection);
+	void on_client_disconnected(NetGameConnection *connection, const std::string &reason);
+	void on_event_received(NetGameConnection *connection, const NetGameEvent &e);
+
+	void move_objects();
+	void process_events(int milliseconds);
+	bool verify();
+
+	float random(float max_value) { return (rand() / (float) RAND_MAX) * max_value; }
+
+	static const int port = 27601;
+	static const float world_size;
+	static const float view_radius;
+
+	int num_objects;
+	int num_clients;
+	int num_ticks;
+
+	NetGameServer server;
+	NetGameReplicator replicator;
+	SlotContainer slots;
+
+	std::vector<int> objects;
+	std::vector<Pointf> object_positions;
+	std::vector<NetGameConnection *> connections;
+	std::vector<Pointf> view_positions;
+	std::vector<SimulationClient *> clients;
+};
+
+const float Simulation::world_size = 4096.0f;
+const float Simulation::view_radius = 256.0f;
+
+int main(int argc, char **argv)
+{
+	SetupCore setup_core;
+	SetupNetwork setup_network;
+
+	int num_objects = argc > 1 ? atoi(argv[1]) : 5000;
+	int num_clients = argc > 2 ? atoi(argv[2]) : 200;
+	int num_ticks = argc > 3 ? atoi(argv[3]) : 30;
+
+	try
+	{
+		Simulation simulation(num_objects, num_clients, num_ticks);
+		if (!simulation.run())
+		{
+			Console::write_line("Test failed");
+			return 1;
+		}
+		Console::write_line("All tests passed");
+		return 0;
+	}
+	catch (Exception &e)
+	{
+		Console::write_line("Exception: %1", e.message);
+		return 1;
+	}
+}
+
+Simulation::Simulation(int num_objects, int num_clients, int num_ticks)
+: num_objects(num_objects), num_clients(num_clients), num_ticks(num_ticks), replicator(128.0f)
+{
+}
+
+bool Simulation::run()
+{
+	srand(1);
+
+	for (int i = 0; i < num_objects; i++)
+	{
+		Pointf position(random(world_size), random(world_size));
+		int object_id = replicator.create_object(i % 4, num_object_fields, position);
+		replicator.set_field(object_id, field_x, NetGameEventValue(position.x));
+		replicator.set_field(object_id, field_y, NetGameEventValue(position.y));
+		replicator.set_field(object_id, field_health, NetGameEventValue(100));
+		replicator.set_field(object_id, field_name, NetGameEventValue(string_format("object%1", i)));
+		objects.push_back(object_id);
+		object_positions.push_back(position);
+	}
+
+	slots.connect(server.sig_client_connected(), this, &Simulation::on_client_connected);
+	slots.connect(server.sig_client_disconnected(), this, &Simulation::on_client_disconnected);
+	slots.connect(server.sig_event_received(), this, &Simulation::on_event_received);
+	server.start(StringHelp::int_to_text(port));
+
+	for (int i = 0; i < num_clients; i++)
+	{
+		SimulationClient *client = new SimulationClient();
+		client->slots.connect(client->client.sig_connected(), client, &SimulationClient::on_connected);
+		client->slots.connect(client->client.sig_event_received(), client, &SimulationClient::on_event_received);
+		client->client.connect("localhost", StringHelp::int_to_text(port));
+		clients.push_back(client);
+
+		// Connect one client at a time to stay within the listen queue of the server
+		ubyte64 connect_start = System::get_time();
+		while ((int) connections.size() <= i && System::get_time() - connect_start < 5000)
+			process_events(1);
+		if ((int) connections.size() <= i)
+		{
+			Console::write_line("Only %1 of %2 clients connected", (int) connections.size(), num_clients);
+			return false;
+		}
+	}
+	Console::write_line("%1 objects, %2 clients, %3 ticks", num_objects, num_clients, num_ticks);
+
+	ubyte64 total_update_time = 0;
+	ubyte64 total_bytes = 0;
+	ubyte64 total_visible = 0;
+	for (int tick = 0; tick < num_ticks; tick++)
+	{
+		move_objects();
+		replicator.update();
+		NetGameReplicatorStats stats = replicator.get_stats();
+		total_update_time += stats.update_time;
+		total_bytes += stats.bytes_sent;
+		total_visible += stats.visible_objects;
+		process_events(10);
+	}
+
+	// Let the last changes and acknowledgements arrive
+	for (int i = 0; i < 20; i++)
+	{
+		replicator.update();
+		process_events(50);
+	}
+
+	Console::write_line("Average update time: %1 ms", (int) (total_update_time / num_ticks / 1000));
+	Console::write_line("Average visible objects per client: %1", (int) (total_visible / num_ticks / num_clients));
+	Console::write_line("Average bytes per client per tick: %1", (int) (total_bytes / num_ticks / num_clients));
+
+	bool result = verify();
+
+	for (size_t i = 0; i < clients.size(); i++)
+	{
+		clients[i]->client.disconnect();
+		delete clients[i];
+	}
+	clients.clear();
+	server.stop();
+	return result;
+}
+
+void Simulation::on_client_connected(NetGameConnection *connection)
+{
+	Pointf view_position(random(world_size), random(world_size));
+	replicator.add_client(connection);
+	replicator.set_client_view(connection, view_position, view_radius);
+	connections.push_back(connection);
+	view_positions.push_back(view_position);
+}
+
+void Simulation::on_client_disconnected(NetGameConnection *connection, const std::string &reason)
+{
+	replicator.remove_client(connection);
+}
+
+void Simulation::on_event_received(NetGameConnection *connection, const NetGameEvent &e)
+{
+	replicator.process_event(connection, e);
+}
+
+void Simulation::move_objects()
+{
+	for (int i = 0; i < num_objects; i++)
+	{
+		if (rand() % 10 == 0)
+		{
+			Pointf &position = object_positions[i];
+			position.x = max(0.0f, min(world_size, position.x + random(64.0f) - 32.0f));
+			position.y = max(0.0f, min(world_size, position.y + random(64.0f) - 32.0f));
+			replicator.set_position(objects[i], position);
+			replicator.set_field(objects[i], field_x, NetGameEventValue(position.x));
+			replicator.set_field(objects[i], field_y, NetGameEventValue(position.y));
+		}
+		if (rand() % 50 == 0)
+			replicator.set_field(objects[i], field_health, NetGameEventValue(rand() % 100));
+	}
+}
+
+void Simulation::process_events(int milliseconds)
+{
+	ubyte64 end_time = System::get_time() + milliseconds;
+	do
+	{
+		server.process_events();
+		for (size_t i = 0; i < clients.size(); i++)
+			clients[i]->client.process_events();
+		System::sleep(1);
+	} while (System::get_time() < end_time);
+}
+
+bool Simulation::verify()
+{
+	int num_failed = 0;
+	for (int client_index = 0; client_index < num_clients; client_index++)
+	{
+		// The connection order on the server is not the client order. Match them by the objects seen.
+		NetGameReplica &replica = clients[client_index]->replica;
+		std::vector<int> object_ids = replica.get_object_ids();
+
+		int best_connection = -1;
+		for (size_t i = 0; i < connections.size() && best_connection == -1; i++)
+		{
+			int num_expected = 0;
+			bool match = true;
+			for (int j = 0; j < num_objects && match; j++)
+			{
+				float dx = object_positions[j].x - view_positions[i].x;
+				float dy = object_positions[j].y - view_positions[i].y;
+				bool expected = dx * dx + dy * dy <= view_radius * view_radius;
+				if (expected)
+					num_expected++;
+				if (expected != replica.has_object(objects[j]))
+					match = false;
+			}
+			if (match && num_expected == (int) object_ids.size())
+				best_connection = i;
+		}
+
+		if (best_connection == -1)
+		{
+			num_failed++;
+			continue;
+		}
+
+		for (size_t i = 0; i < object_ids.size(); i++)
+		{
+			int object_id = object_ids[i];
+			if (replica.get_field_count(object_id) != num_object_fields ||
+				replica.get_field(object_id, field_x).to_number() != replicator.get_field(object_id, field_x).to_number() ||
+				replica.get_field(object_id, field_y).to_number() != replicator.get_field(object_id, field_y).to_number() ||
+				replica.get_field(object_id, field_health).to_integer() != replicator.get_field(object_id, field_health).to_integer() ||
+				replica.get_field(object_id, field_name).to_string() != replicator.get_field(object_id, field_name).to_string())
+			{
+				num_failed++;
+				break;
+			}
+		}
+	}
+
+	Console::write_line("%1 of %2 clients match the server", num_clients - num_failed, num_clients);
+	return num_failed == 0;
+}
@@ -0,0 +1,553 @@
+#include <ClanLib/core.h>
+#include <ClanLib/network.h>
+#include <algorithm>
+#include <deque>
+#include <cstdlib>
+using namespace clan;
+
+// Loopback test of the UDP NetGame transport over a simulated lossy link.
+//
+// Usage: netgameudp [latency ms] [loss percent] [pings]
+//
+// A client sends timestamped pings the server echoes back. The pings pass through
+// a proxy that delays every datagram by the latency and drops the given percentage.
+// The same is done for a TCP connection, where a dropped segment is modelled as
+// delivered late by a retransmit delay that also holds back everything after it.
+// Round trip percentiles are printed for TCP and each UDP channel.
+
+class LinkRandom
+{
+public:
+	LinkRandom(unsigned int seed) : state(seed) { }
+	int percent() { state = state * 1103515245 + 12345; return (state >> 16) % 100; }
+
+private:
+	unsigned int state;
+};
+
+// Forwards datagrams between a client and the server with added latency and loss
+class UDPLink
+{
+public:
+	UDPLink(int port, int server_port, int latency, int loss_percent)
+	: socket(SocketName(StringHelp::int_to_text(port))), server_name("127.0.0.1", StringHelp::int_to_text(server_port)),
+	  latency(latency), loss_percent(loss_percent), random(1), datagrams_from_client(0)
+	{
+		thread.start(this, &UDPLink::thread_main);
+	}
+
+	~UDPLink()
+	{
+		stop_event.set();
+		thread.join();
+	}
+
+	int get_datagrams_from_client() { MutexSection mutex_lock(&mutex); return datagrams_from_client; }
+
+private:
+	struct DelayedPacket
+	{
+		ubyte64 due_time;
+		DataBuffer data;
+		SocketName to;
+	};
+
+	void thread_main()
+	{
+		std::vector<char> buffer(2048);
+		while (true)
+		{
+			ubyte64 time = System::get_time();
+			int timeout = queue.empty() ? 10 : (int) (queue.front().due_time > time ? queue.front().due_time - time : 0);
+			Event read_event = socket.get_read_event();
+			if (Event::wait(stop_event, read_event, timeout) == 0)
+				break;
+
+			time = System::get_time();
+			while (Event::wait(read_event, 0) == 0)
+			{
+				SocketName from;
+				int size = 0;
+				try
+				{
+					size = socket.receive(&buffer[0], buffer.size(), from);
+				}
+				catch (const Exception &)
+				{
+					continue;
+				}
+
+				DelayedPacket packet;
+				if (from == server_name)
+				{
+					packet.to = client_name;
+				}
+				else
+				{
+					client_name = from;
+					packet.to = server_name;
+					MutexSection mutex_lock(&mutex);
+					datagrams_from_client++;
+				}
+
+				if (random.percent() < loss_percent)
+					continue;
+
+				packet.due_time = time + latency;
+				packet.data = DataBuffer(&buffer[0], size);
+				queue.push_back(packet);
+			}
+
+			while (!queue.empty() && queue.front().due_time <= time)
+			{
+				socket.send(queue.front().data.get_data(), queue.front().data.get_size(), queue.front().to);
+				queue.pop_front();
+			}
+		}
+	}
+
+	UDPSocket socket;
+	SocketName server_name, client_name;
+	int latency, loss_percent;
+	LinkRandom random;
+	std::deque<DelayedPacket> queue;
+	Thread thread;
+	Event stop_event;
+	Mutex mutex;
+	int datagrams_from_client;
+};
+
+// Forwards a TCP stream with added latency. A lost segment arrives after the retransmit delay instead.
+class TCPLink
+{
+public:
+	TCPLink(int port, int server_port, int latency, int loss_percent, int retransmit_delay)
+	: listen(SocketName(StringHelp::int_to_text(port))), server_name("127.0.0.1", StringHelp::int_to_text(server_port)),
+	  latency(latency), loss_percent(loss_percent), retransmit_delay(retransmit_delay), random(2)
+	{
+		thread.start(this, &TCPLink::thread_main);
+	}
+
+	~TCPLink()
+	{
+		stop_event.set();
+		thread.join();
+	}
+
+private:
+	struct DelayedData
+	{
+		ubyte64 due_time;
+		DataBuffer data;
+	};
+
+	struct Direction
+	{
+		Direction() : last_due_time(0) { }
+		std::deque<DelayedData> queue;
+		ubyte64 last_due_time;
+	};
+
+	void thread_main()
+	{
+		try
+		{
+			Event accept_event = listen.get_accept_event();
+			if (Event::wait(stop_event, accept_event) != 1)
+				return;
+			TCPConnection connections[2];
+			connections[0] = listen.accept();
+			connections[1] = TCPConnection(server_name);
+			connections[0].set_nodelay(true);
+			connections[1].set_nodelay(true);
+
+			Direction directions[2];
+			std::vector<char> buffer(16 * 1024);
+			while (true)
+			{
+				ubyte64 time = System::get_time();
+				int timeout = 10;
+				for (int i = 0; i < 2; i++)
+				{
+					if (!directions[i].queue.empty())
+						timeout = min(timeout, (int) (directions[i].queue.front().due_time > time ? directions[i].queue.front().due_time - time : 0));
+				}
+
+				Event read_event0 = connections[0].get_read_event();
+				Event read_event1 = connections[1].get_read_event();
+				int wakeup_reason = Event::wait(stop_event, read_event0, read_event1, timeout);
+				if (wakeup_reason == 0)
+					break;
+
+				time = System::get_time();
+				if (wakeup_reason == 1 || wakeup_reason == 2)
+				{
+					int from = wakeup_reason - 1;
+					int size = connections[from].read(&buffer[0], buffer.size(), false);
+					if (size <= 0)
+						break;
+
+					// The stream is in order, so a retransmitted segment delays all data after it too
+					Direction &direction = directions[from];
+					DelayedData data;
+					data.due_time = time + latency;
+					if (random.percent() < loss_percent)
+						data.due_time += retransmit_delay;
+					data.due_time = max(data.due_time, direction.last_due_time);
+					data.data = DataBuffer(&buffer[0], size);
+					direction.last_due_time = data.due_time;
+					direction.queue.push_back(data);
+				}
+
+				for (int i = 0; i < 2; i++)
+				{
+					while (!directions[i].queue.empty() && directions[i].queue.front().due_time <= time)
+					{
+						connections[1 - i].send(directions[i].queue.front().data.get_data(), directions[i].queue.front().data.get_size(), true);
+						directions[i].queue.pop_front();
+					}
+				}
+			}
+		}
+		catch (const Exception &)
+		{
+		}
+	}
+
+	TCPListen listen;
+	SocketName server_name;
+	int latency, loss_percent, retransmit_delay;
+	LinkRandom random;
+	Thread thread;
+	Event stop_event;
+};
+
+struct PingResult
+{
+	PingResult() : sent(0), received(0), out_of_order(0) { }
+
+	int sent;
+	int received;
+	int out_of_order;
+	std::vector<int> round_trip_times;
+
+	int percentile(int percent) const
+	{
+		if (round_trip_times.empty())
+			return -1;
+		std::vector<int> sorted = round_trip_times;
+		std::sort(sorted.begin(), sorted.end());
+		return sorted[min((int) sorted.size() - 1, (int) sorted.size() * percent / 100)];
+	}
+};
+
+class LinkTest
+{
+public:
+	LinkTest(int latency, int loss_percent, int num_pings);
+
+	PingResult run_pings(NetGameTransport transport, NetGameChannel channel);
+	bool run_delivery();
+	bool run_disconnect();
+
+private:
+	void on_client_connected() { connected = true; }
+	void on_client_disconnected() { disconnected = true; }
+	void on_client_event(const NetGameEvent &e);
+	void on_server_event(NetGameConnection *connection, const NetGameEvent &e);
+
+	void connect(NetGameServer &server, NetGameClient &client, NetGameTransport transport, SlotContainer &slots);
+	void process_events(NetGameServer &server, NetGameClient &client, int milliseconds);
+
+	int get_time() const { return (int) (System::get_microseconds() - start_time); }
+
+	static const int server_port = 27610;
+	static const int link_port = 27611;
+	static const int burst_size = 100;
+
+	int latency;
+	int loss_percent;
+	int num_pings;
+	ubyte64 start_time;
+
+	bool connected;
+	bool disconnected;
+	PingResult result;
+	int last_ping;
+
+	std::vector<int> unordered_received;
+	std::vector<int> ordered_received;
+	DataBuffer large_received;
+};
+
+int main(int argc, char **argv)
+{
+	SetupCore setup_core;
+	SetupNetwork setup_network;
+
+	int latency = argc > 1 ? atoi(argv[1]) : 20;
+	int loss_percent = argc > 2 ? atoi(argv[2]) : 5;
+	int num_pings = argc > 3 ? atoi(argv[3]) : 300;
+
+	try
+	{
+		Console::write_line("Link: %1 ms latency, %2%% loss, %3 pings", latency, loss_percent, num_pings);
+
+		LinkTest test(latency, loss_percent, num_pings);
+		const char *names[] = { "TCP", "UDP reliable ordered", "UDP reliable unordered", "UDP unreliable sequenced" };
+		PingResult results[4];
+		results[0] = test.run_pings(netgame_transport_tcp, netgame_channel_reliable_ordered);
+		results[1] = test.run_pings(netgame_transport_udp, netgame_channel_reliable_ordered);
+		results[2] = test.run_pings(netgame_transport_udp, netgame_channel_reliable_unordered);
+		results[3] = test.run_pings(netgame_transport_udp, netgame_channel_unreliable_sequenced);
+
+		bool passed = true;
+		for (int i = 0; i < 4; i++)
+		{
+			const PingResult &r = results[i];
+			Console::write_line("%1: %2 of %3 pings, p50 %4 ms, p90 %5 ms, p99 %6 ms, max %7 ms",
+				names[i], r.received, r.sent, r.percentile(50) / 1000, r.percentile(90) / 1000, r.percentile(99) / 1000, r.percentile(100) / 1000);
+
+			bool reliable = (i != 3);
+			if ((reliable && r.received != r.sent) || (i != 2 && r.out_of_order != 0))
+			{
+				Console::write_line("  Failed: pings lost or out of order");
+				passed = false;
+			}
+		}
+
+		// Losing a datagram must not hold back the events after it like a TCP segment does
+		if (loss_percent > 0 && results[3].percentile(99) >= results[0].percentile(99))
+		{
+			Console::write_line("Failed: unreliable sequenced p99 is not below TCP");
+			passed = false;
+		}
+
+		if (!test.run_delivery())
+			passed = false;
+		if (!test.run_disconnect())
+			passed = false;
+
+		if (!passed)
+		{
+			Console::write_line("Test failed");
+			return 1;
+		}
+		Console::write_line("All tests passed");
+		return 0;
+	}
+	catch (Exception &e)
+	{
+		Console::write_line("Exception: %1", e.message);
+		return 1;
+	}
+}
+
+LinkTest::LinkTest(int latency, int loss_percent, int num_pings)
+: latency(latency), loss_percent(loss_percent), num_pings(num_pings), start_time(System::get_microseconds()), connected(false), disconnected(false), last_ping(-1)
+{
+}
+
+PingResult LinkTest::run_pings(NetGameTransport transport, NetGameChannel channel)
+{
+	result = PingResult();
+	last_ping = -1;
+
+	NetGameServer server;
+	NetGameClient client;
+	std::unique_ptr<UDPLink> udp_link;
+	std::unique_ptr<TCPLink> tcp_link;
+	if (transport == netgame_transport_udp)
+		udp_link.reset(new UDPLink(link_port, server_port, latency, loss_percent));
+	else
+		tcp_link.reset(new TCPLink(link_port, server_port, latency, loss_percent, 2 * latency + 30));
+
+	SlotContainer slots;
+	connect(server, client, transport, slots);
+
+	for (int i = 0; i < num_pings; i++)
+	{
+		client.send_event(NetGameEvent("ping", i, get_time(), (int) channel), channel);
+		result.sent++;
+		process_events(server, client, 10);
+	}
+
+	ubyte64 wait_start = System::get_time();
+	while (result.received < result.sent && System::get_time() - wait_start < 2000)
+		process_events(server, client, 10);
+
+	client.disconnect();
+	server.stop();
+	return result;
+}
+
+bool LinkTest::run_delivery()
+{
+	unordered_received.clear();
+	ordered_received.clear();
+	large_received = DataBuffer();
+
+	NetGameServer server;
+	NetGameClient client;
+	UDPLink udp_link(link_port, server_port, latency, loss_percent);
+	SlotContainer slots;
+	connect(server, client, netgame_transport_udp, slots);
+
+	// A large event is split into fragments that all have to arrive
+	DataBuffer large(20000);
+	for (unsigned int i = 0; i < large.get_size(); i++)
+		large.get_data()[i] = (char) (i * 7);
+
+	// Events sent together are coalesced into shared datagrams
+	const int num_events = 200;
+	int datagrams_before = udp_link.get_datagrams_from_client();
+	for (int i = 0; i < num_events; i++)
+	{
+		client.send_event(NetGameEvent("ordered", i), netgame_channel_reliable_ordered);
+		client.send_event(NetGameEvent("unordered", i), netgame_channel_reliable_unordered);
+	}
+	client.send_event(NetGameEvent("large", large), netgame_channel_reliable_ordered);
+
+	ubyte64 wait_start = System::get_time();
+	while ((ordered_received.size() < num_events || unordered_received.size() < num_events || large_received.is_null()) && System::get_time() - wait_start < 5000)
+		process_events(server, client, 10);
+
+	int datagrams = udp_link.get_datagrams_from_client() - datagrams_before;
+	client.disconnect();
+	server.stop();
+
+	std::sort(unordered_received.begin(), unordered_received.end());
+	bool ordered_ok = ordered_received.size() == num_events;
+	bool unordered_ok = unordered_received.size() == num_events;
+	for (int i = 0; i < num_events; i++)
+	{
+		ordered_ok = ordered_ok && ordered_received[i] == i;
+		unordered_ok = unordered_ok && unordered_received[i] == i;
+	}
+	bool large_ok = large_received.get_size() == large.get_size() && memcmp(large_received.get_data(), large.get_data(), large.get_size()) == 0;
+	bool coalesced = datagrams < num_events;
+
+	Console::write_line("Delivery: %1 events and a %2 byte event sent in %3 datagrams", num_events * 2, (int) large.get_size(), datagrams);
+	if (!ordered_ok || !unordered_ok || !large_ok || !coalesced)
+	{
+		Console::write_line("  Failed: ordered %1, unordered %2, large %3, coalesced %4", ordered_ok, unordered_ok, large_ok, coalesced);
+		return false;
+	}
+	return true;
+}
+
+bool LinkTest::run_disconnect()
+{
+	ordered_received.clear();
+
+	NetGameServer server;
+	NetGameClient client;
+	UDPLink udp_link(link_port, server_port, latency, loss_percent);
+	SlotContainer slots;
+	connect(server, client, netgame_transport_udp, slots);
+	slots.connect(client.sig_disconnected(), this, &LinkTest::on_client_disconnected);
+
+	// An event larger than a NetGame packet throws to the sender instead of failing on the host thread
+	bool too_big_thrown = false;
+	try
+	{
+		client.send_event(NetGameEvent("large", DataBuffer(40000)), netgame_channel_reliable_ordered);
+	}
+	catch (const Exception &)
+	{
+		too_big_thrown = true;
+	}
+
+	// The server answers with a burst of events and disconnects right away. They must all arrive first.
+	client.send_event(NetGameEvent("burst"), netgame_channel_reliable_ordered);
+
+	ubyte64 wait_start = System::get_time();
+	while (!disconnected && System::get_time() - wait_start < 5000)
+		process_events(server, client, 10);
+
+	client.disconnect();
+	server.stop();
+
+	bool burst_ok = ordered_received.size() == burst_size;
+	for (unsigned int i = 0; burst_ok && i < ordered_received.size(); i++)
+		burst_ok = ordered_received[i] == (int) i;
+
+	Console::write_line("Disconnect: %1 of %2 events before the disconnect", (int) ordered_received.size(), burst_size);
+	if (!too_big_thrown || !burst_ok || !disconnected)
+	{
+		Console::write_line("  Failed: too big thrown %1, burst %2, disconnected %3", too_big_thrown, burst_ok, disconnected);
+		return false;
+	}
+	return true;
+}
+
+void LinkTest::connect(NetGameServer &server, NetGameClient &client, NetGameTransport transport, SlotContainer &slots)
+{
+	connected = false;
+	disconnected = false;
+	slots.connect(server.sig_event_received(), this, &LinkTest::on_server_event);
+	slots.connect(client.sig_connected(), this, &LinkTest::on_client_connected);
+	slots.connect(client.sig_event_received(), this, &LinkTest::on_client_event);
+	server.start(StringHelp::int_to_text(server_port), transport);
+	client.connect("localhost", StringHelp::int_to_text(link_port), transport);
+
+	ubyte64 connect_start = System::get_time();
+	while (!connected && System::get_time() - connect_start < 5000)
+		process_events(server, client, 1);
+	if (!connected)
+		throw Exception("Could not connect");
+}
+
+void LinkTest::process_events(NetGameServer &server, NetGameClient &client, int milliseconds)
+{
+	ubyte64 end_time = System::get_time() + milliseconds;
+	do
+	{
+		server.process_events();
+		client.process_events();
+		System::sleep(1);
+	} while (System::get_time() < end_time);
+}
+
+void LinkTest::on_server_event(NetGameConnection *connection, const NetGameEvent &e)
+{
+	if (e.get_name() == "ping")
+	{
+		connection->send_event(NetGameEvent("pong", e.get_argument(0), e.get_argument(1)), (NetGameChannel) e.get_argument(2).to_integer());
+	}
+	else if (e.get_name() == "ordered")
+	{
+		ordered_received.push_back(e.get_argument(0).to_integer());
+	}
+	else if (e.get_name() == "unordered")
+	{
+		unordered_received.push_back(e.get_argument(0).to_integer());
+	}
+	else if (e.get_name() == "large")
+	{
+		large_received = e.get_argument(0).to_binary();
+	}
+	else if (e.get_name() == "burst")
+	{
+		for (int i = 0; i < burst_size; i++)
+			connection->send_event(NetGameEvent("burst", i), netgame_channel_reliable_ordered);
+		connection->disconnect();
+	}
+}
+
+void LinkTest::on_client_event(const NetGameEvent &e)
+{
+	if (e.get_name() == "pong")
+	{
+		int ping = e.get_argument(0).to_integer();
+		if (ping < last_ping)
+			result.out_of_order++;
+		last_ping = max(last_ping, ping);
+		result.received++;
+		result.round_trip_times.push_back(get_time() - e.get_argument(1).to_integer());
+	}
+	else if (e.get_name() == "burst")
+	{
+		ordered_received.push_back(e.get_argument(0).to_integer());
+	}
+}
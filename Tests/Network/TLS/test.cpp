@@ -7,14 +7,26 @@ using namespace clan;
 
 void test();
 void test2();
+void benchmark(const std::string &host, const std::string &port, const std::string &file);
 
-int main(int, char**)
+// Usage: tls [host port [file]]
+//
+// Without arguments a page is fetched from encrypted.google.com. With a host and port
+// the handshake rate and throughput against a local test server are measured instead:
+//
+//   openssl s_server -accept 4433 -cert cert.pem -key key.pem -WWW
+//   tls 127.0.0.1 4433 big.bin
+
+int main(int argc, char** argv)
 {
 	SetupCore setup_core;
 	SetupNetwork setup_network;
 	try
 	{
-		test2();
+		if (argc >= 3)
+			benchmark(argv[1], argv[2], argc >= 4 ? argv[3] : "");
+		else
+			test2();
 
 	}
 	catch (Exception e)
@@ -140,3 +152,70 @@ void test2()
 
 	// window.display_close_message();
 }
+
+// Fetches a file from the server over a new connection. Returns the number of bytes received.
+ubyte64 fetch(const SocketName &socket_name, const std::string &file, bool &out_resumed)
+{
+	TCPConnection tcp_connection(socket_name);
+	tcp_connection.set_nodelay(true);
+	TLSConnection tls_connection(tcp_connection);
+
+	std::string request = string_format("GET /%1 HTTP/1.0\r\n\r\n", file);
+	tls_connection.send(request.data(), request.length(), true);
+
+	ubyte64 total = 0;
+	DataBuffer response(64*1024);
+	while (true)
+	{
+		int received = tls_connection.receive(response.get_data(), response.get_size(), false);
+		if (received == 0)
+			break;
+		total += received;
+	}
+	out_resumed = tls_connection.is_session_resumed();
+	return total;
+}
+
+void benchmark_handshakes(const SocketName &socket_name, bool resume)
+{
+	const int num_handshakes = 200;
+	bool resumed = false;
+	int num_resumed = 0;
+
+	TLSClient::clear_session_cache();
+	fetch(socket_name, "", resumed);	// Warm up, and a session to resume
+
+	ubyte64 start_time = System::get_microseconds();
+	for (int cnt = 0; cnt < num_handshakes; cnt++)
+	{
+		if (!resume)
+			TLSClient::clear_session_cache();
+		fetch(socket_name, "", resumed);
+		if (resumed)
+			num_resumed++;
+	}
+	ubyte64 elapsed = System::get_microseconds() - start_time;
+
+	Console::write_line("%1 handshakes: %2 per second (%3 of %4 resumed)", resume ? "Resumed" : "Full", (int) (num_handshakes * 1000000.0 / elapsed), num_resumed, num_handshakes);
+}
+
+void benchmark_throughput(const SocketName &socket_name, const std::string &file)
+{
+	bool resumed = false;
+	ubyte64 start_time = System::get_microseconds();
+	ubyte64 total = fetch(socket_name, file, resumed);
+	ubyte64 elapsed = System::get_microseconds() - start_time;
+
+	Console::write_line("Received %1 bytes of %2: %3 MB/s", (int) total, file, (int) (total / (elapsed / 1000000.0) / (1024 * 1024)));
+}
+
+void benchmark(const std::string &host, const std::string &port, const std::string &file)
+{
+	SocketName socket_name(host, port);
+
+	benchmark_handshakes(socket_name, false);
+	benchmark_handshakes(socket_name, true);
+
+	if (!file.empty())
+		benchmark_throughput(socket_name, file);
+}
@@ -66,6 +66,7 @@ int TestApp::main(const std::vector<std::string> &args)
 		Console::write_line("For clanSound SSE functions");
 
 		do_test();
+		test_resampler();
 		
 		Console::write_line("All Tests Complete");
 		console.display_close_message();
@@ -40,6 +40,7 @@ public:
 
 private:
 	void do_test();
+	void test_resampler();
 
 	static void unpack_16bit_stereo(short *input, int size, float *output[2]);
 	static void unpack_16bit_mono(short *input, int size, float *output);
@@ -0,0 +1,162 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Magnus Norddahl
+*/
+
+#include "test.h"
+
+namespace
+{
+	const double pi = 3.14159265358979323846;
+
+	/// \brief Fills a channel with a sine wave, leaving the silence the resampler reads before the first sample
+	void fill_sine(std::vector<float> &channel, int length, double frequency, double sample_rate)
+	{
+		channel.assign(SoundResampler::input_history + length + SoundResampler::input_lookahead, 0.0f);
+		for (int i = 0; i < length; i++)
+			channel[SoundResampler::input_history + i] = (float) (0.5 * std::sin(2.0 * pi * frequency * i / sample_rate));
+	}
+}
+
+void TestApp::test_resampler()
+{
+	Console::write_line(" Header: sound_resampler.h");
+	Console::write_line("  Class: SoundResampler");
+
+	Console::write_line("   Function: int resample() with equal frequencies");
+	{
+		std::vector<float> input;
+		fill_sine(input, 1000, 440.0, 44100.0);
+		std::vector<float> output(1000);
+		float *input_channels[1] = { &input[0] };
+		float *output_channels[1] = { &output[0] };
+
+		SoundResampler resampler;
+		resampler.set_frequencies(44100.0f, 44100);
+		int position = SoundResampler::input_history;
+		unsigned int fraction = 0;
+		int written = resampler.resample(input_channels, input.size(), 1, position, fraction, output_channels, output.size());
+		if (written != 1000 || position != SoundResampler::input_history + 1000 || fraction != 0)
+			fail();
+		for (int i = 0; i < 1000; i++)
+		{
+			if (output[i] != input[SoundResampler::input_history + i])
+				fail();
+		}
+	}
+
+	Console::write_line("   Function: int resample() converting a sine wave");
+	{
+		const int source_rates[] = { 22050, 44100, 48000 };
+		const int target_rates[] = { 48000, 48000, 44100 };
+		for (int test = 0; test < 3; test++)
+		{
+			for (int mode = 0; mode < 2; mode++)
+			{
+				const int length = 4000;
+				std::vector<float> left, right;
+				fill_sine(left, length, 1000.0, source_rates[test]);
+				fill_sine(right, length, 300.0, source_rates[test]);
+				float *input_channels[2] = { &left[0], &right[0] };
+
+				std::vector<float> output_left(length * 3), output_right(length * 3);
+				float *output_channels[2] = { &output_left[0], &output_right[0] };
+
+				SoundResampler resampler(mode == 0 ? resampler_linear : resampler_polyphase);
+				resampler.set_frequencies((float) source_rates[test], target_rates[test]);
+
+				// Resample in blocks of odd sizes to cover the block and tail paths
+				int position = SoundResampler::input_history;
+				unsigned int fraction = 0;
+				int written = 0;
+				while (true)
+				{
+					float *block_channels[2] = { output_channels[0] + written, output_channels[1] + written };
+					int block_written = resampler.resample(input_channels, left.size(), 2, position, fraction, block_channels, 37);
+					if (block_written == 0)
+						break;
+					written += block_written;
+				}
+
+				int expected = length * target_rates[test] / source_rates[test];
+				if (written < expected - 2 || written > expected + 2)
+					fail();
+
+				// The polyphase filter delays nothing, so the output matches the sine at the target rate. Skip the filter edges.
+				float tolerance = (mode == 0) ? 0.01f : 0.002f;
+				for (int i = 16; i < written - 16; i++)
+				{
+					float expected_left = (float) (0.5 * std::sin(2.0 * pi * 1000.0 * i / target_rates[test]));
+					float expected_right = (float) (0.5 * std::sin(2.0 * pi * 300.0 * i / target_rates[test]));
+					if (std::abs(output_left[i] - expected_left) > tolerance || std::abs(output_right[i] - expected_right) > tolerance)
+						fail();
+				}
+			}
+		}
+	}
+
+	Console::write_line("   Benchmark: stereo voices per core at 48 kHz");
+	{
+		const int fragment_size = 1024;
+		const int num_fragments = 2000;
+		const int source_rates[] = { 22050, 44100, 48000 };
+		for (int test = 0; test < 3; test++)
+		{
+			for (int mode = 0; mode < 2; mode++)
+			{
+				int source_length = fragment_size * source_rates[test] / 48000 + 64;
+				std::vector<float> left, right;
+				fill_sine(left, source_length, 1000.0, source_rates[test]);
+				fill_sine(right, source_length, 300.0, source_rates[test]);
+				float *input_channels[2] = { &left[0], &right[0] };
+
+				std::vector<float> temp_left(fragment_size), temp_right(fragment_size);
+				float *temp_channels[2] = { &temp_left[0], &temp_right[0] };
+				std::vector<float> mix_left(fragment_size), mix_right(fragment_size);
+
+				SoundResampler resampler(mode == 0 ? resampler_linear : resampler_polyphase);
+				resampler.set_frequencies((float) source_rates[test], 48000);
+
+				// Each fragment is resampled and mixed the way SoundBuffer_Session_Impl does it
+				ubyte64 start_time = System::get_microseconds();
+				for (int fragment = 0; fragment < num_fragments; fragment++)
+				{
+					int position = SoundResampler::input_history;
+					unsigned int fraction = 0;
+					resampler.resample(input_channels, left.size(), 2, position, fraction, temp_channels, fragment_size);
+					SoundSSE::mix_one_to_one(temp_channels[0], fragment_size, &mix_left[0], 0.5f);
+					SoundSSE::mix_one_to_one(temp_channels[1], fragment_size, &mix_right[0], 0.5f);
+				}
+				ubyte64 elapsed = System::get_microseconds() - start_time;
+
+				double audio_seconds = num_fragments * (double) fragment_size / 48000.0;
+				double cpu_seconds = elapsed / 1000000.0;
+				Console::write_line(string_format("    %1 Hz, %2: %3 voices",
+					source_rates[test], mode == 0 ? "linear" : "polyphase", (int) (audio_seconds / cpu_seconds)));
+			}
+		}
+	}
+}